@@ -945,6 +945,17 @@ typedef NS_ENUM(NSInteger, MaplyThreadMode) {
 /// @brief Turn on/off performance output (goes to the log periodically).
 @property (nonatomic,assign) bool performanceOutput;
 
+/** @brief Turn on/off recording a trace of what the renderer and layer threads are doing.
+    @details Timing stats are always kept.  With this on, the most recent events on each thread are kept as well, to be written out with writeTelemetryTrace:.
+ */
+@property (nonatomic,assign) bool telemetryTracing;
+
+/** @brief Write the recorded trace out as Chrome trace JSON.
+    @details Open the file in chrome://tracing or Perfetto.  Turn on telemetryTracing first.
+    @return true if the file was written.
+ */
+- (bool)writeTelemetryTrace:(NSString *__nonnull)fileName;
+
 /** @brief See derived class method.
  */
 - (void)requirePanGestureRecognizerToFailForGesture:(UIGestureRecognizer *__nullable)other;
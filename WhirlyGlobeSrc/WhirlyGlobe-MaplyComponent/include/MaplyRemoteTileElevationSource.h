@@ -40,6 +40,8 @@
 
 @property (nonatomic, strong,nullable) NSString *cacheDir;
 
+@property (nonatomic) long long cacheSize;
+
 @property (nonatomic) int cachedFileLifetime;
 
 @property (nonatomic,strong,nullable) NSString *queryStr;
@@ -55,6 +57,10 @@
 
 - (bool)tileIsLocal:(MaplyTileID)tileID frame:(int)frame;
 
+- (nullable NSData *)readFromCache:(MaplyTileID)tileID;
+
+- (void)writeToCache:(MaplyTileID)tileID tileData:(NSData *__nonnull)tileData;
+
 
 @end
 
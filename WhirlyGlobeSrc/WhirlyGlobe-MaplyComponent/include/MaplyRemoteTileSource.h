@@ -175,12 +175,19 @@
 /** @brief The cache directory for image tiles.
  @details In general, we want to cache.  The globe, in particular,
     is going to fetch the same tiles over and over, quite a lot.
- The cacheing behavior is a little dumb.  It will just write
- files to the given directory forever.  If you're interacting
- with a giant image pyramid, that could be problematic.
+ Tiles are packed into a few large files in a subdirectory named
+ after the extension.  Tile sources using the same directory share
+ the cache.  It's kept under cacheSize by throwing out the tiles
+ that haven't been used in a while.
  */
 @property (nonatomic, strong,nullable) NSString *cacheDir;
 
+/** @brief The most space the tile cache will take up, in bytes.
+ @details 256MB by default.  Set this before the first tile is fetched.
+ If other tile sources share the cacheDir, the first one to use the cache sets this.
+ */
+@property (nonatomic) long long cacheSize;
+
 /** @brief The maximum age of a cached file in seconds.
       @details If set, tiles in the cache older than this number of
       seconds will not be used; rather, a new copy of the tile will be
@@ -217,9 +224,9 @@
  */
 - (nullable NSURLRequest *)requestForTile:(MaplyTileID)tileID;
 
-/** @brief The full path for a cached tile.
- @details This returns the full path to where a tile is or where a tile would be if it were cached.
- @details We don't check if the tile is there or not.
+/** @brief The full path for a cached tile in the old one file per tile cache.
+ @details This returns the full path to where a tile would be if it were cached the old way.
+ @details Tiles aren't written there anymore, so this is only of use for looking at old caches.
  @param tileID The tile we need the filename for.
  */
 - (nullable NSString *)fileNameForTile:(MaplyTileID)tileID;
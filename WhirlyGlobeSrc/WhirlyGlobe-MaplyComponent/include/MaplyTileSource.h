@@ -145,6 +145,15 @@ NSString *__nonnull MaplyTileIDString(MaplyTileID tileID);
   */
 - (void)startFetchLayer:(id __nonnull)layer tile:(MaplyTileID)tileID frame:(int)frame;
 
+/** @brief Start fetching the given tile or frame, knowing how important it is.
+    @details If this is filled in the layer will call it instead of startFetchLayer:tile: or startFetchLayer:tile:frame:.  Bigger importance means the tile takes up more of the screen, so it ought to show up sooner.
+    @param layer This is probably a MaplyQuadImageTilesLayer, but others use this protocol as well.  Your tile source should know.
+    @param tileID The tile you should start fetching.
+    @param frame The individual frame (of an animation) to fetch or -1 for all of them.
+    @param importance How important the tile is compared to the others being fetched.
+  */
+- (void)startFetchLayer:(id __nonnull)layer tile:(MaplyTileID)tileID frame:(int)frame importance:(double)importance;
+
 /** @brief Called when the tile is disabled by the renderer.
     @details Normally you won't get called when an image or vector tile is disabled from display.  If you set this, you will.
     @details You're not required to do anything, but you can disable your own data if you like.
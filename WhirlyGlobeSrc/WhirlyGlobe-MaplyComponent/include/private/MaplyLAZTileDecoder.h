@@ -0,0 +1,63 @@
+//
+//  MaplyLAZTileDecoder.h
+//  WhirlyGlobe-MaplyComponent
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright © 2026 mousebird consulting. All rights reserved.
+//
+
+#ifndef MaplyLAZTileDecoder_h
+#define MaplyLAZTileDecoder_h
+
+#include <vector>
+#include "laszip_api.h"
+
+/** Points for a single LAZ tile, decoded into flat arrays.
+    Positions are in the source coordinate system, with the Z offset applied.
+    Elevation is just z, so the shader attribute can be filled from that.
+  */
+class MaplyLAZPointBuffer
+{
+public:
+    MaplyLAZPointBuffer() : hasColors(false), minZ(0.0), maxZ(0.0) { }
+
+    // Empty out the arrays, but keep the memory around
+    void clear();
+
+    // Size all the arrays for the given number of points
+    void resize(int numPoints);
+
+    int size() const { return (int)x.size(); }
+
+    std::vector<double> x,y,z;
+    // Colors are only filled in if hasColors is set, scaled to [0,1]
+    std::vector<float> red,green,blue;
+    bool hasColors;
+    double minZ,maxZ;
+};
+
+/** Decodes runs of points from a LAZ reader.
+    The points for a tile are contiguous, so we seek once to the start of the run
+    and then read sequentially.  Seeking in laszip restarts decompression for the
+    whole chunk, so seeking per point is quadratic in the chunk size.
+    Not thread safe.  If a reader is shared, callers need to lock around decode().
+  */
+class MaplyLAZTileDecoder
+{
+public:
+    MaplyLAZTileDecoder(laszip_POINTER reader);
+
+    // Decode count points starting at start.  We only seek if the reader isn't already there.
+    bool decode(long long start,int count,double zOffset,double colorScale,MaplyLAZPointBuffer &points);
+
+    // Number of seeks we've done.  Mostly for the benchmark.
+    int getNumSeeks() { return numSeeks; }
+
+protected:
+    laszip_POINTER reader;
+    // Index of the next point the reader will return, or -1 if we don't know
+    long long position;
+    int numSeeks;
+};
+
+#endif /* MaplyLAZTileDecoder_h */
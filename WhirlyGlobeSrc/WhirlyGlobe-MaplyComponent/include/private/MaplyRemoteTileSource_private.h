@@ -20,6 +20,7 @@
 
 #import <vector>
 #import <set>
+#import "MaplyTileFetcher.h"
 
 namespace Maply
 {
@@ -27,7 +28,7 @@ namespace Maply
 class TileFetchOp
 {
 public:
-    TileFetchOp(MaplyTileID tileID) : tileID(tileID), task(nil) { }
+    TileFetchOp(MaplyTileID tileID) : tileID(tileID), requestID(0) { }
     
     bool operator < (const TileFetchOp &that) const
     {
@@ -36,13 +37,13 @@ public:
             if (tileID.x == that.tileID.x)
                 return tileID.y < that.tileID.y;
             else
-                return tileID.x < that.tileID.y;
+                return tileID.x < that.tileID.x;
         } else
             return tileID.level < that.tileID.level;
     }
     
     MaplyTileID tileID;
-    NSURLSessionDataTask * __weak task;
+    MaplyFetchRequestID requestID;
 };
 typedef std::set<TileFetchOp> TileFetchOpSet;
 }
@@ -0,0 +1,57 @@
+/*
+ *  MaplyTileFetcher.h
+ *  WhirlyGlobe-MaplyComponent
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <Foundation/Foundation.h>
+
+/// Identifies a fetch request so it can be cancelled.  0 is never used.
+typedef unsigned long long MaplyFetchRequestID;
+
+/** @brief Does the network fetches for all the remote tile sources.
+    @details Tile sources asking for the same URL share one fetch.  Fetches go out most important first, with only so many out to any one host or overall.  Requests that are cancelled come out of the queue, and a fetch that's already out gets cancelled once no one wants it.
+  */
+@interface MaplyTileFetcher : NSObject
+
+/// @brief The fetcher everyone shares
++ (MaplyTileFetcher *__nonnull)sharedFetcher;
+
+/// @brief Most fetches we'll have out to a single host.  6 by default.
+@property (nonatomic) int maxConnectionsPerHost;
+
+/// @brief Most fetches we'll have out overall.  16 by default.
+@property (nonatomic) int maxConnections;
+
+/** @brief Fetch the given URL.
+    @details The completion block is called on a global queue with the data or an error, unless the request is cancelled first.
+    @param urlReq What to fetch.  Requests are considered the same if their URLs are.
+    @param importance Bigger goes first.
+    @return ID to cancel the request with.
+  */
+- (MaplyFetchRequestID)fetchRequest:(NSURLRequest *__nonnull)urlReq importance:(double)importance completion:(void (^__nonnull)(NSData *__nullable data,NSError *__nullable error))completion;
+
+/// @brief Not interested in the result anymore.  The completion block won't be called.
+- (void)cancelRequest:(MaplyFetchRequestID)requestID;
+
+/// @brief Change the importance of a request that hasn't gone out yet
+- (void)setImportance:(double)importance forRequest:(MaplyFetchRequestID)requestID;
+
+/// @brief Median and 99th percentile seconds from asking for a tile to getting it, over recent requests
+- (void)getTimeToTileMedian:(double *__nonnull)median p99:(double *__nonnull)p99;
+
+@end
@@ -417,6 +417,21 @@ static const float PerfOutputDelay = 15.0;
     return _performanceOutput;
 }
 
+- (void)setTelemetryTracing:(bool)telemetryTracing
+{
+    Telemetry::setTracing(telemetryTracing);
+}
+
+- (bool)telemetryTracing
+{
+    return Telemetry::isTracing();
+}
+
+- (bool)writeTelemetryTrace:(NSString *)fileName
+{
+    return Telemetry::writeChromeTrace([fileName UTF8String]);
+}
+
 // Build an array of lights and send them down all at once
 - (void)updateLights
 {
@@ -24,6 +24,7 @@
 #import "sqlite3.h"
 #import "FMDatabase.h"
 #import "FMDatabaseQueue.h"
+#import "QuadKey.h"
 
 @implementation MaplyElevationDatabase
 {
@@ -104,17 +105,14 @@
 {
     // Put together the precalculated quad index.  This is faster
     //  than x,y,level
-    int quadIdx = 0;
-    for (int iq=0;iq<tileID.level;iq++)
-        quadIdx += (1<<iq)*(1<<iq);
-    quadIdx += tileID.y*(1<<tileID.level)+tileID.x;
+    long long quadIdx = WhirlyKit::QuadKey(tileID.x,tileID.y,tileID.level).quadIndex();
 
     NSData * __block uncompressedData=nil;
     bool __block tilePresent = false;
     // Note: Need to sort this out
     [queue inDatabase:^(FMDatabase *theDb) {
         // Now look for the tile
-        FMResultSet *res = [theDb executeQuery:[NSString stringWithFormat:@"SELECT data FROM elevationtiles WHERE quadindex=%d;",quadIdx]];
+        FMResultSet *res = [theDb executeQuery:[NSString stringWithFormat:@"SELECT data FROM elevationtiles WHERE quadindex=%lld;",quadIdx]];
         NSData *data = nil;
         if ([res next])
         {
@@ -54,12 +54,10 @@ VectorTrianglesRef MaplyLAZMeshBuilder::makeSimpleMesh(MaplyBaseViewController *
     pts[2] = Point3d(ur.x(),ur.y(),minZ);
     pts[3] = Point3d(ll.x(),ur.y(),minZ);
     
+    CoordSystemConvert3d(srcCoordSys->coordSystem, coordAdapter->getCoordSystem(), pts, pts, 4);
+    coordAdapter->localToDisplay(pts, pts, 4);
     for (unsigned int ii=0;ii<4;ii++)
-    {
-        Point3d localPt = CoordSystemConvert3d(srcCoordSys->coordSystem, coordAdapter->getCoordSystem(), pts[ii]);
-        Point3d dispPt = coordAdapter->localToDisplay(localPt);
-        mesh->pts.push_back(Point3f(dispPt.x(),dispPt.y(),dispPt.z()));
-    }
+        mesh->pts.push_back(Point3f(pts[ii].x(),pts[ii].y(),pts[ii].z()));
     
     VectorTriangles::Triangle tri;
     tri.pts[0] = 0;
@@ -96,7 +94,8 @@ VectorTrianglesRef MaplyLAZMeshBuilder::makeMesh(MaplyBaseViewController *viewC)
 
     // Generate the points
     Point2d span2((ur.x()-ll.x())/sizeX,(ur.y()-ll.y())/sizeY);
-    mesh->pts.reserve((sizeX+1)*(sizeY+1));
+    std::vector<Point3d> gridPts;
+    gridPts.reserve((sizeX+1)*(sizeY+1));
     for (int iy=0;iy<=sizeY;iy++)
     {
         for (int ix=0;ix<=sizeX;ix++)
@@ -105,11 +104,17 @@ VectorTrianglesRef MaplyLAZMeshBuilder::makeMesh(MaplyBaseViewController *viewC)
             int whichX = std::max(ix,sizeX-1);
             int whichY = std::max(iy,sizeY-1);
             double z = minZs[whichY*sizeX+whichX];
-            Point3d localPt = CoordSystemConvert3d(srcCoordSys->coordSystem, coordAdapter->getCoordSystem(), Point3d(pt.x(),pt.y(),z));
-            Point3d dispPt = coordAdapter->localToDisplay(localPt);
-            mesh->pts.push_back(Point3f(dispPt.x(),dispPt.y(),dispPt.z()));
+            gridPts.push_back(Point3d(pt.x(),pt.y(),z));
         }
     }
+    
+    // Convert the whole grid at once
+    int numPts = (int)gridPts.size();
+    CoordSystemConvert3d(srcCoordSys->coordSystem, coordAdapter->getCoordSystem(), &gridPts[0], &gridPts[0], numPts);
+    coordAdapter->localToDisplay(&gridPts[0], &gridPts[0], numPts);
+    mesh->pts.reserve(numPts);
+    for (const Point3d &dispPt : gridPts)
+        mesh->pts.push_back(Point3f(dispPt.x(),dispPt.y(),dispPt.z()));
 
     // Generate the triangles
     mesh->tris.reserve(sizeX*sizeY);
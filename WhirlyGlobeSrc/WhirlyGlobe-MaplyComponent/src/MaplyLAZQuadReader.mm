@@ -12,6 +12,7 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <mutex>
 
 #import "MaplyLAZQuadReader.h"
 #import "MaplyLAZShader.h"
@@ -21,6 +22,7 @@
 #import "laszip_api.h"
 #import "WhirlyGlobe.h"
 #import "MaplyLAZMeshBuilder.h"
+#import "MaplyLAZTileDecoder.h"
 #import "private/WhirlyGlobeViewController_private.h"
 #import "private/MaplyCoordinateSystem_private.h"
 
@@ -74,12 +76,33 @@ public:
 
 typedef std::set<TileBoundsInfo> TileBoundsSet;
 
+// Convert a whole tile's worth of points into display space, relative to the given center.
+// We go to the coordinate systems directly rather than through the view controller for every point.
+static void LAZPointsToDisplay(CoordSystem *srcSys,CoordSystemDisplayAdapter *coordAdapter,const MaplyLAZPointBuffer &points,const Point3d &dispCenter,std::vector<Point3d> &dispPts)
+{
+    int numPts = points.size();
+    dispPts.resize(numPts);
+    if (numPts == 0)
+        return;
+    for (int ii=0;ii<numPts;ii++)
+        dispPts[ii] = Point3d(points.x[ii],points.y[ii],points.z[ii]);
+    
+    // Both conversions run over the whole tile in place
+    CoordSystemConvert3d(srcSys,coordAdapter->getCoordSystem(),&dispPts[0],&dispPts[0],numPts);
+    coordAdapter->localToDisplay(&dispPts[0],&dispPts[0],numPts);
+    for (int ii=0;ii<numPts;ii++)
+        dispPts[ii] -= dispCenter;
+}
+
 @implementation MaplyLAZQuadReader
 {
     FMDatabase *db;
     FMDatabaseQueue *queue;
     std::ifstream *ifs;
     laszip_POINTER lazReader;
+    // The shared reader can only be used by one tile at a time
+    MaplyLAZTileDecoder *lazDecoder;
+    std::mutex lazReaderLock;
     TileBoundsSet tileSizes;
     int pointType;
     double colorScale;
@@ -198,6 +221,8 @@ typedef std::set<TileBoundsInfo> TileBoundsSet;
     {
         delete ifs;
     }
+    if (lazDecoder)
+        delete lazDecoder;
 }
 
 - (bool)hasColor
@@ -379,10 +404,7 @@ typedef std::set<TileBoundsInfo> TileBoundsSet;
    ^{
        // Put together the precalculated quad index.  This is faster
        //  than x,y,level
-       int quadIdx = 0;
-       for (int iq=0;iq<tileID.level;iq++)
-           quadIdx += (1<<iq)*(1<<iq);
-       quadIdx += tileID.y*(1<<tileID.level)+tileID.x;
+       long long quadIdx = QuadKey(tileID.x,tileID.y,tileID.level).quadIndex();
 
        // Information set up from the database or from the global file
        laszip_POINTER __block thisReader = NULL;
@@ -391,15 +413,14 @@ typedef std::set<TileBoundsInfo> TileBoundsSet;
        NSData * __block data = nil;
        long long __block pointStart = 0;
        int __block count = 0;
-       bool __block hasColors = false;
        
        // We're either using the index with an external LAZ files or we're grabbing the raw data itself
        [queue inDatabase:^(FMDatabase *theDb) {
            FMResultSet *res = nil;
            if (lazReader)
-               res = [db executeQuery:[NSString stringWithFormat:@"SELECT start,count FROM tileaddress WHERE quadindex=%d;",quadIdx]];
+               res = [db executeQuery:[NSString stringWithFormat:@"SELECT start,count FROM tileaddress WHERE quadindex=%lld;",quadIdx]];
            else
-               res = [db executeQuery:[NSString stringWithFormat:@"SELECT data FROM lidartiles WHERE quadindex=%d;",quadIdx]];
+               res = [db executeQuery:[NSString stringWithFormat:@"SELECT data FROM lidartiles WHERE quadindex=%lld;",quadIdx]];
            if ([res next])
            {
                if (lazReader)
@@ -407,9 +428,6 @@ typedef std::set<TileBoundsInfo> TileBoundsSet;
                    pointStart = [res longLongIntForColumn:@"start"];
                    count = [res intForColumn:@"count"];
                    thisReader = lazReader;
-                   laszip_header_struct *header;
-                   laszip_get_header_pointer(thisReader,&header);
-                   hasColors = header->point_data_format > 1;
                } else {
                    data = [res dataForColumn:@"data"];
                    tileStream = new std::stringstream();
@@ -420,7 +438,6 @@ typedef std::set<TileBoundsInfo> TileBoundsSet;
                    laszip_open_stream_reader(thisReader,tileStream,&is_compressed);
                    laszip_header_struct *header;
                    laszip_get_header_pointer(thisReader,&header);
-                   hasColors = header->point_data_format > 1;
                    count = header->number_of_point_records;
                }
 
@@ -428,69 +445,61 @@ typedef std::set<TileBoundsInfo> TileBoundsSet;
            }
        }];
        
+       laszip_header_struct *header = NULL;
+       MaplyLAZPointBuffer lazPoints;
+       bool decoded = false;
        if (thisReader)
+       {
+           laszip_get_header_pointer(thisReader,&header);
+
+           // Decode the whole run of points at once.  Points for a tile are contiguous, so that's one seek at most.
+           if (lazReader)
+           {
+               std::lock_guard<std::mutex> lock(lazReaderLock);
+               if (!lazDecoder)
+                   lazDecoder = new MaplyLAZTileDecoder(lazReader);
+               decoded = lazDecoder->decode(pointStart, count, _zOffset, colorScale, lazPoints);
+           } else {
+               MaplyLAZTileDecoder decoder(thisReader);
+               decoded = decoder.decode(pointStart, count, _zOffset, colorScale, lazPoints);
+           }
+           if (!decoded)
+               NSLog(@"MaplyLAZQuadReader: Failed to decode tile %d: (%d,%d)",tileID.level,tileID.x,tileID.y);
+       }
+
+       if (thisReader && decoded)
        {
            MaplyPoints *points = [[MaplyPoints alloc] initWithNumPoints:count];
            int elevID = [points addAttributeType:@"a_elev" type:MaplyShaderAttrTypeFloat];
            
            // Center the coordinates around the tile center
            MaplyCoordinate3dD tileCenter;
-           laszip_header_struct *header;
-           laszip_get_header_pointer(thisReader,&header);
            tileCenter.x = (header->min_x+header->max_x)/2.0;
            tileCenter.y = (header->min_y+header->max_y)/2.0;
            tileCenter.z = 0.0;
            MaplyCoordinate3dD tileCenterDisp = [layer.viewC displayCoordD:tileCenter fromSystem:_coordSys];
            points.transform = [[MaplyMatrix alloc] initWithTranslateX:tileCenterDisp.x y:tileCenterDisp.y z:tileCenterDisp.z];
            
+           // Convert to display coordinates in one pass
+           std::vector<Point3d> dispPts;
+           LAZPointsToDisplay(_coordSys->coordSystem, layer.viewC->visualView.coordAdapter, lazPoints, Point3d(tileCenterDisp.x,tileCenterDisp.y,tileCenterDisp.z), dispPts);
+
            // We generate a triangle mesh underneath a given tile to provide something to grab
            MaplyLAZMeshBuilder meshBuilder(10,10,Point2d(header->min_x,header->min_y),Point2d(header->max_x,header->max_y),self.coordSys);
            
-           long long which = 0;
-           double minZ=MAXFLOAT,maxZ=-MAXFLOAT;
-           while (which < count)
+           for (int which=0;which<lazPoints.size();which++)
            {
-               // Get the point and convert to geocentric
-               if (lazReader)
-               {
-                   laszip_seek_point(thisReader,(which+pointStart));
-                   laszip_read_point(thisReader);
-               } else {
-                   laszip_seek_point(thisReader,(which+pointStart));
-                   laszip_read_point(thisReader);
-               }
-               laszip_point_struct *p;
-               laszip_get_point_pointer(thisReader, &p);
-               //                double x,y,z;
-               //                x = p.GetX(), y = p.GetY(); z = p.GetZ();
-               //                trans->TransformEx(1, &x, &y, &z);
-               MaplyCoordinate3dD coord;
-               coord.x = p->X * header->x_scale_factor + header->x_offset;
-               coord.y = p->Y * header->y_scale_factor + header->y_offset;
-               coord.z = p->Z * header->z_scale_factor + header->z_offset;
-               coord.z += _zOffset;
-               
-               minZ = std::min(coord.z,minZ);
-               maxZ = std::max(coord.z,maxZ);
-
-               MaplyCoordinate3dD dispCoord = [layer.viewC displayCoordD:coord fromSystem:_coordSys];
-               MaplyCoordinate3dD dispCoordCenter = MaplyCoordinate3dDMake(dispCoord.x-tileCenterDisp.x, dispCoord.y-tileCenterDisp.y, dispCoord.z-tileCenterDisp.z);
-               
-               float red = 1.0,green = 1.0, blue = 1.0;
-               if (hasColors)
-               {
-                   red = p->rgb[0] / colorScale;
-                   green = p->rgb[1] / colorScale;
-                   blue = p->rgb[2] / colorScale;
-               }
-               [points addDispCoordDoubleX:dispCoordCenter.x y:dispCoordCenter.y z:dispCoordCenter.z];
-               [points addColorR:red g:green b:blue a:1.0];
-               [points addAttribute:elevID fVal:coord.z];
-               
-               meshBuilder.addPoint(Point3d(coord.x,coord.y,coord.z));
+               const Point3d &dispPt = dispPts[which];
+               [points addDispCoordDoubleX:dispPt.x() y:dispPt.y() z:dispPt.z()];
+               if (lazPoints.hasColors)
+                   [points addColorR:lazPoints.red[which] g:lazPoints.green[which] b:lazPoints.blue[which] a:1.0];
+               else
+                   [points addColorR:1.0 g:1.0 b:1.0 a:1.0];
+               [points addAttribute:elevID fVal:lazPoints.z[which]];
                
-               which++;
+               meshBuilder.addPoint(Point3d(lazPoints.x[which],lazPoints.y[which],lazPoints.z[which]));
            }
+           double minZ = lazPoints.minZ, maxZ = lazPoints.maxZ;
            
            // Keep track of tile size
            if (minZ == maxZ)
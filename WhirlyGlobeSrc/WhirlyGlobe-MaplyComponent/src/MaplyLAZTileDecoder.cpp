@@ -0,0 +1,90 @@
+//
+//  MaplyLAZTileDecoder.cpp
+//  WhirlyGlobe-MaplyComponent
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright © 2026 mousebird consulting. All rights reserved.
+//
+
+#include "MaplyLAZTileDecoder.h"
+#include <algorithm>
+#include <float.h>
+
+void MaplyLAZPointBuffer::clear()
+{
+    x.clear();  y.clear();  z.clear();
+    red.clear();  green.clear();  blue.clear();
+    hasColors = false;
+    minZ = 0.0;  maxZ = 0.0;
+}
+
+void MaplyLAZPointBuffer::resize(int numPoints)
+{
+    x.resize(numPoints);  y.resize(numPoints);  z.resize(numPoints);
+    if (hasColors)
+    {
+        red.resize(numPoints);  green.resize(numPoints);  blue.resize(numPoints);
+    } else {
+        red.clear();  green.clear();  blue.clear();
+    }
+}
+
+MaplyLAZTileDecoder::MaplyLAZTileDecoder(laszip_POINTER reader)
+: reader(reader), position(0), numSeeks(0)
+{
+}
+
+bool MaplyLAZTileDecoder::decode(long long start,int count,double zOffset,double colorScale,MaplyLAZPointBuffer &points)
+{
+    laszip_header_struct *header = NULL;
+    laszip_point_struct *p = NULL;
+    if (laszip_get_header_pointer(reader,&header) || laszip_get_point_pointer(reader,&p))
+        return false;
+
+    points.hasColors = header->point_data_format > 1;
+    points.resize(std::max(count,0));
+    points.minZ = DBL_MAX;  points.maxZ = -DBL_MAX;
+    if (count <= 0)
+        return true;
+
+    if (start != position)
+    {
+        position = -1;
+        if (laszip_seek_point(reader,start))
+            return false;
+        numSeeks++;
+        position = start;
+    }
+
+    // Pull these out so the loop doesn't go back through the header
+    const double xScale = header->x_scale_factor, yScale = header->y_scale_factor, zScale = header->z_scale_factor;
+    const double xOff = header->x_offset, yOff = header->y_offset, zOff = header->z_offset + zOffset;
+    const float colorNorm = 1.0 / colorScale;
+    double *xs = &points.x[0], *ys = &points.y[0], *zs = &points.z[0];
+    double minZ = DBL_MAX, maxZ = -DBL_MAX;
+    for (int ii=0;ii<count;ii++)
+    {
+        if (laszip_read_point(reader))
+        {
+            position = -1;
+            return false;
+        }
+
+        xs[ii] = p->X * xScale + xOff;
+        ys[ii] = p->Y * yScale + yOff;
+        zs[ii] = p->Z * zScale + zOff;
+        minZ = std::min(zs[ii],minZ);
+        maxZ = std::max(zs[ii],maxZ);
+
+        if (points.hasColors)
+        {
+            points.red[ii] = p->rgb[0] * colorNorm;
+            points.green[ii] = p->rgb[1] * colorNorm;
+            points.blue[ii] = p->rgb[2] * colorNorm;
+        }
+    }
+    position = start + count;
+    points.minZ = minZ;  points.maxZ = maxZ;
+
+    return true;
+}
@@ -22,6 +22,7 @@
 #import <set>
 #import "MaplyMultiplexTileSource.h"
 #import "MaplyQuadImageTilesLayer.h"
+#import "MaplyTileFetcher.h"
 
 namespace Maply
 {
@@ -29,8 +30,8 @@ namespace Maply
 class TileFetch
 {
 public:
-    TileFetch(int which,NSURLSessionDataTask *task) : which(which), task(task) { }
-    TileFetch() : which(-1), task(nil) { }
+    TileFetch(int which,MaplyFetchRequestID requestID) : which(which), requestID(requestID) { }
+    TileFetch() : which(-1), requestID(0) { }
     
     bool operator < (const TileFetch &that) const
     {
@@ -38,7 +39,7 @@ public:
     }
     
     int which;
-    NSURLSessionDataTask * __weak task;
+    MaplyFetchRequestID requestID;
 };
 typedef std::set<TileFetch> TileFetchSet;
     
@@ -68,23 +69,27 @@ public:
             return tileID.level < that.tileID.level;
     }
     
-    // Kill any outstanding fetches
-    void cancelAll()
+    // Kill any outstanding fetches.  Returns the number we killed.
+    int cancelAll()
     {
+        int numCancelled = (int)fetches.size();
         TileFetchSet::iterator it;
         for (it = fetches.begin();
              it != fetches.end(); ++it)
         {
-            [it->task cancel];
+            [[MaplyTileFetcher sharedFetcher] cancelRequest:it->requestID];
         }
 
         fetches.clear();
         tileData.clear();
+        
+        return numCancelled;
     }
 
-    // Kill a specific outstanding fetch
-    void cancel(int frame)
+    // Kill a specific outstanding fetch.  Returns the number we killed.
+    int cancel(int frame)
     {
+        int numCancelled = 0;
         int which = (frame == -1 ? 0 : frame);
         
         TileFetchSet::iterator it;
@@ -98,11 +103,14 @@ public:
         }
         if (it != fetches.end())
         {
-            [it->task cancel];
+            [[MaplyTileFetcher sharedFetcher] cancelRequest:it->requestID];
             fetches.erase(it);
+            numCancelled++;
         }
         
         tileData[which] = nil;
+        
+        return numCancelled;
     }
     
     // Clear the fetch for a given frame
@@ -189,7 +197,7 @@ static bool trackConnections = false;
              it != sortedTiles.end(); ++it)
         {
             Maply::SortedTile tile = *it;
-            tile.cancelAll();
+            [self untrackConnections:tile.cancelAll()];
         }
         sortedTiles.clear();
     }
@@ -205,6 +213,16 @@ static bool trackConnections = false;
     return numConnections;
 }
 
+// Cancelled fetches don't come back, so they have to come off the count here
+- (void)untrackConnections:(int)numCancelled
+{
+    if (trackConnections && numCancelled > 0)
+        @synchronized([MaplyMultiplexTileSource class])
+    {
+        numConnections -= numCancelled;
+    }
+}
+
 - (int)minZoom
 {
     return _minZoom;
@@ -270,13 +288,28 @@ static bool trackConnections = false;
         if (it != sortedTiles.end())
         {
             Maply::SortedTile tile = *it;
-            tile.cancel(frame);
+            [self untrackConnections:tile.cancel(frame)];
             sortedTiles.erase(it);
             sortedTiles.insert(tile);
         }
     }
 }
 
+// The layer is done with the tile, so don't bother finishing its fetches
+- (void)tileUnloaded:(MaplyTileID)tileID
+{
+    @synchronized(self)
+    {
+        Maply::SortedTileSet::iterator it = sortedTiles.find(Maply::SortedTile(tileID));
+        if (it != sortedTiles.end())
+        {
+            Maply::SortedTile tile = *it;
+            [self untrackConnections:tile.cancelAll()];
+            sortedTiles.erase(it);
+        }
+    }
+}
+
 // If we're accepting errors for tiles, we do a last minute check of the data right here
 - (NSError *)marshalDataArray:(NSMutableArray *)dataArray
 {
@@ -425,6 +458,11 @@ static bool trackConnections = false;
 }
 
 - (void)startFetchLayer:(id)layer tile:(MaplyTileID)tileID frame:(int)frame
+{
+    [self startFetchLayer:layer tile:tileID frame:frame importance:0.0];
+}
+
+- (void)startFetchLayer:(id)layer tile:(MaplyTileID)tileID frame:(int)frame importance:(double)importance
 {
 //    NSLog(@"Starting fetch for tile: %d: (%d,%d) %d",tileID.level,tileID.x,tileID.y,frame);
     
@@ -438,12 +476,13 @@ static bool trackConnections = false;
         {
             newTile = *it;
             sortedTiles.erase(it);
-            newTile.cancel(frame);
+            [self untrackConnections:newTile.cancel(frame)];
         }
     }
     newTile.singleFetch = (frame !=-1);
     // Don't think about this one too hard.
     std::vector<void (^)()> workBlocks;
+    std::vector<std::pair<int,MaplyFetchRequestID (^)()> > fetchBlocks;
 
     MaplyMultiplexTileSource __weak *weakSelf = self;
 
@@ -490,11 +529,11 @@ static bool trackConnections = false;
                     numConnections++;
                 }
 
-                // Kick off an async request for the data
-                NSURLSession *session = [NSURLSession sharedSession];
-                NSURLSessionDataTask *task = [session dataTaskWithRequest:urlReq completionHandler:
-                ^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
-                    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                // We'll ask for the data once the tile is in the set.  Sources with the same URL share a fetch.
+                MaplyFetchRequestID (^fetchBlock)() =
+                ^{
+                    return [[MaplyTileFetcher sharedFetcher] fetchRequest:urlReq importance:importance completion:
+                    ^(NSData * _Nullable data, NSError * _Nullable error) {
 
                         if (!error) {
                             if (weakSelf)
@@ -522,11 +561,9 @@ static bool trackConnections = false;
                             }
 
                         }
-
-                    });
-                }];
-                
-                newTile.fetches.insert(Maply::TileFetch(which, task));
+                    }];
+                };
+                fetchBlocks.push_back(std::pair<int,MaplyFetchRequestID (^)()>(which,fetchBlock));
 
             } else {
                 [weakSelf failedToGetTile:tileID frame:frame error:nil layer:layer];
@@ -535,15 +572,13 @@ static bool trackConnections = false;
         which++;
     }
 
-    // Kick off the operations after we have the tile data in our set.
+    // Kick off the operations while we hold the lock and put the tile in the set.
     // Otherwise these can come back before we've defined all of this
     @synchronized(self)
     {
+        for (unsigned int ii=0;ii<fetchBlocks.size();ii++)
+            newTile.fetches.insert(Maply::TileFetch(fetchBlocks[ii].first, fetchBlocks[ii].second()));
         sortedTiles.insert(newTile);
-        // Kick off the fetch operations
-        for (Maply::TileFetchSet::iterator it = newTile.fetches.begin();
-             it != newTile.fetches.end(); ++it)
-            [it->task resume];
     }
     // Run the work blocks that fetch local data
     for (unsigned int ii=0;ii<workBlocks.size();ii++)
@@ -82,6 +82,7 @@ using namespace WhirlyKit;
     int minZoom,maxZoom;
     int tileSize;
     bool sourceWantsAsync;
+    bool sourceWantsImportance;
     ActiveImageUpdater *imageUpdater;
     SimpleIdentity _customShader;
     float _minElev,_maxElev;
@@ -148,6 +149,7 @@ using namespace WhirlyKit;
     
     // See if we're letting the source do the async calls or what
     sourceWantsAsync = [_tileSource respondsToSelector:@selector(startFetchLayer:tile:)];
+    sourceWantsImportance = [_tileSource respondsToSelector:@selector(startFetchLayer:tile:frame:importance:)];
     
     // See if the delegate is doing variable sized tiles (kill me)
     variableSizeTiles = [_tileSource respondsToSelector:@selector(tileSizeForTile:)];
@@ -847,6 +849,27 @@ using namespace WhirlyKit;
     return import;
 }
 
+/// Importance for a batch of tiles.  The plain screen importance case runs in parallel.
+- (void)importanceForTiles:(std::vector<WhirlyKit::Quadtree::ImportanceRequest> &)requests viewInfo:(WhirlyKitViewState *)viewState frameSize:(WhirlyKit::Point2f)frameSize
+{
+    // Anything that calls out to the tile source or uses heights goes one at a time
+    if (canDoValidTiles || (canShortCircuitImportance && maxShortCircuitLevel != -1) || variableSizeTiles || elevDelegate)
+    {
+        for (Quadtree::ImportanceRequest &request : requests)
+            request.importance = [self importanceForTile:request.ident mbr:request.mbr viewInfo:viewState frameSize:frameSize attrs:request.attrs];
+        return;
+    }
+    
+    ScreenImportance(viewState, frameSize, tileSize, [coordSys getCoordSystem], scene->getCoordAdapter(), requests);
+    for (Quadtree::ImportanceRequest &request : requests)
+    {
+        if (request.ident.level == 0)
+            request.importance = MAXFLOAT;
+        else
+            request.importance *= _importanceScale;
+    }
+}
+
 /// Called when the layer is shutting down.  Clean up any drawable data and clear out caches.
 - (void)teardown
 {
@@ -926,19 +949,26 @@ using namespace WhirlyKit;
     // The tile source wants to do all the async management
     if (sourceWantsAsync)
     {
+        double importance = [attrs[kWKTileImportance] doubleValue];
+        int fetchFrame = canFetchFrames ? frame : -1;
+
         // Tile sources often do work in the startFetch so let's spin that off
         if (_asyncFetching)
         {
             dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
                            ^{
-                               if (frame != -1 && canFetchFrames)
+                               if (sourceWantsImportance)
+                                   [_tileSource startFetchLayer:self tile:tileID frame:fetchFrame importance:importance];
+                               else if (frame != -1 && canFetchFrames)
                                    [_tileSource startFetchLayer:self tile:tileID frame:frame];
                                else
                                    [_tileSource startFetchLayer:self tile:tileID];
                            }
                            );
         } else {
-            if (frame != -1 && canFetchFrames)
+            if (sourceWantsImportance)
+                [_tileSource startFetchLayer:self tile:tileID frame:fetchFrame importance:importance];
+            else if (frame != -1 && canFetchFrames)
                 [_tileSource startFetchLayer:self tile:tileID frame:frame];
             else
                 [_tileSource startFetchLayer:self tile:tileID];
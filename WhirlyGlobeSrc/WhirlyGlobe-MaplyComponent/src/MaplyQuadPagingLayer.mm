@@ -136,13 +136,7 @@ typedef struct
     /// Comparison operator based on node identifier
     bool operator() (const QuadPagingLoadedTile *a,const QuadPagingLoadedTile *b)
     {
-        if (a->nodeIdent.level == b->nodeIdent.level)
-        {
-            if (a->nodeIdent.x == b->nodeIdent.x)
-                return a->nodeIdent.y < b->nodeIdent.y;
-            return a->nodeIdent.x < b->nodeIdent.x;
-        } else
-            return a->nodeIdent.level < b->nodeIdent.level;
+        return QuadKey(a->nodeIdent.x,a->nodeIdent.y,a->nodeIdent.level) < QuadKey(b->nodeIdent.x,b->nodeIdent.y,b->nodeIdent.level);
     }
 } QuadPagingLoadedTileSorter;
 
@@ -23,6 +23,8 @@
 #import "MaplyCoordinateSystem_private.h"
 #import "MaplyQuadImageTilesLayer.h"
 #import "MaplyRemoteTileSource_private.h"
+#import "MaplyTileFetcher.h"
+#import "PackedTileCache.h"
 
 using namespace Eigen;
 using namespace WhirlyKit;
@@ -42,6 +44,10 @@ using namespace WhirlyKit;
     bool cacheInit;
 
     int _minZoom,_maxZoom;
+
+    // Tiles are kept in here, under cacheDir
+    bool tileCacheInit;
+    std::shared_ptr<PackedTileCache> tileCache;
 }
 
 - (instancetype)initWithBaseURL:(NSString *)baseURL ext:(NSString *)ext minZoom:(int)minZoom maxZoom:(int)maxZoom
@@ -56,6 +62,7 @@ using namespace WhirlyKit;
     _maxZoom = maxZoom;
     _timeOut = 0.0;
 	_pixelsPerSide = 256;
+    _cacheSize = PackedTileCache::DefaultMaxBytes;
     _coordSys = [[MaplySphericalMercator alloc] initWebStandard];
     
     return self;
@@ -81,35 +88,60 @@ using namespace WhirlyKit;
     return localName;
 }
 
-- (bool)tileIsLocal:(MaplyTileID)tileID frame:(int)frame
+- (void)setCacheDir:(NSString *)cacheDir
 {
-    if (!_cacheDir)
-        return false;
-    
-    NSString *fileName = [self fileNameForTile:tileID];
-    if ([[NSFileManager defaultManager] fileExistsAtPath:fileName])
+    @synchronized(self)
     {
-        // If the file is out of date, treat it as if it were not local, as it will have to be fetched.
-        if (self.cachedFileLifetime != 0)
-        {
-            NSDate *fileTimestamp = [MaplyRemoteTileElevationInfo dateForFile:fileName];
-            int ageOfFile = (int) [[NSDate date] timeIntervalSinceDate:fileTimestamp];
-            if (ageOfFile <= self.cachedFileLifetime)
-            {
-                return true;
-            }
-//            else
-//            {
-//                NSLog(@"TileIsLocal returned false due to tile age: %d: (%d,%d)",tileID.level,tileID.x,tileID.y);
-//            }
-        }
-        else // no lifetime set for cached files
+        _cacheDir = cacheDir;
+        cacheInit = false;
+        tileCacheInit = false;
+        tileCache.reset();
+    }
+}
+
+// The packed cache for our kind of tile, opened the first time we need it
+- (std::shared_ptr<PackedTileCache>)getTileCache
+{
+    @synchronized(self)
+    {
+        if (!tileCacheInit && _cacheDir)
         {
-            return true;
+            NSString *tileCacheDir = [_cacheDir stringByAppendingPathComponent:_ext];
+            tileCache = PackedTileCache::cacheForDir([tileCacheDir UTF8String],(size_t)_cacheSize);
+            tileCacheInit = true;
         }
+        return tileCache;
     }
+}
+
+- (bool)tileIsLocal:(MaplyTileID)tileID frame:(int)frame
+{
+    std::shared_ptr<PackedTileCache> cache = [self getTileCache];
+    if (!cache)
+        return false;
+    
+    // If the tile is out of date, treat it as if it were not local, as it will have to be fetched.
+    return cache->contains(tileID.level,tileID.x,tileID.y,_cachedFileLifetime);
+}
+
+- (NSData *)readFromCache:(MaplyTileID)tileID
+{
+    std::shared_ptr<PackedTileCache> cache = [self getTileCache];
+    std::vector<unsigned char> data;
+    if (!cache || !cache->read(tileID.level,tileID.x,tileID.y,data,_cachedFileLifetime))
+        return nil;
+    
+    return [NSData dataWithBytes:data.data() length:data.size()];
+}
+
+- (void)writeToCache:(MaplyTileID)tileID tileData:(NSData *)tileData
+{
+    std::shared_ptr<PackedTileCache> cache = [self getTileCache];
+    if (!cache)
+        return;
     
-    return false;
+    if (!cache->write(tileID.level,tileID.x,tileID.y,[tileData bytes],[tileData length]))
+        NSLog(@"Failed to cache elevation tile: %d: (%d,%d)",tileID.level,tileID.x,tileID.y);
 }
 
 + (NSDate *)dateForFile:(NSString *)fileName
@@ -166,10 +198,7 @@ using namespace WhirlyKit;
     {
         for (Maply::TileFetchOpSet::iterator it = tileSet.begin();
              it != tileSet.end(); ++it)
-        {
-            Maply::TileFetchOp tile = *it;
-            [tile.task cancel];
-        }
+            [[MaplyTileFetcher sharedFetcher] cancelRequest:it->requestID];
         tileSet.clear();
     }
 }
@@ -211,6 +240,17 @@ using namespace WhirlyKit;
 
 - (void)tileUnloaded:(MaplyTileID)tileID
 {
+    // No point in finishing a fetch for it
+    @synchronized(self)
+    {
+        Maply::TileFetchOpSet::iterator it = tileSet.find(Maply::TileFetchOp(tileID));
+        if (it != tileSet.end())
+        {
+            [[MaplyTileFetcher sharedFetcher] cancelRequest:it->requestID];
+            tileSet.erase(it);
+        }
+    }
+
     if ([_delegate respondsToSelector:@selector(remoteTileElevationSource:tileUnloaded:)])
         [_delegate remoteTileElevationSource:self tileUnloaded:tileID];
 }
@@ -228,38 +268,21 @@ using namespace WhirlyKit;
 
 - (MaplyElevationChunk *)elevForTile:(MaplyTileID)tileID
 {
-    if ([_tileInfo tileIsLocal:tileID frame:-1])
+    // readFromCache checks the age
+    NSData *cacheData = [_tileInfo readFromCache:tileID];
+    if (cacheData)
     {
-        bool doLoad = true;
-        NSString *fileName = [_tileInfo fileNameForTile:tileID];
-        if (_tileInfo.cachedFileLifetime > 0)
-        {
-            NSDate *timeStamp = [MaplyRemoteTileElevationInfo dateForFile:fileName];
-            if (timeStamp)
-            {
-                int ageOfFile = (int) [[NSDate date] timeIntervalSinceDate:timeStamp];
-                if (ageOfFile > _tileInfo.cachedFileLifetime)
-                    doLoad = false;
-            }
-        }
-        if (doLoad)
-        {
-            NSData *tileData = [NSData dataWithContentsOfFile:fileName];
-            if (tileData)
-            {
-				MaplyElevationChunk *elevChunk = [self decodeElevationData:tileData];
+        MaplyElevationChunk *elevChunk = [self decodeElevationData:cacheData];
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wundeclared-selector"
-                if ([_delegate respondsToSelector:@selector(remoteTileSource:modifyElevReturn:forTile:)])
-                {
-
-                    elevChunk = [_delegate remoteTileElevationSource:self modifyElevReturn:elevChunk forTile:tileID];
-                }
+        if ([_delegate respondsToSelector:@selector(remoteTileSource:modifyElevReturn:forTile:)])
+        {
 
-				//TODO(JM) is this return missing in MaplyRemoteTileElevationSource::imageForTile??
-				return elevChunk;
-            }
+            elevChunk = [_delegate remoteTileElevationSource:self modifyElevReturn:elevChunk forTile:tileID];
         }
+
+        //TODO(JM) is this return missing in MaplyRemoteTileElevationSource::imageForTile??
+        return elevChunk;
     }
     
     NSURLRequest *urlReq = [_tileInfo requestForTile:tileID];
@@ -281,7 +304,7 @@ using namespace WhirlyKit;
             // Let's also write it back out for the cache.
             // We're already on another thread.  No need to do that in the background.
             if (_tileInfo.cacheDir && tileData)
-                [tileData writeToFile:[_tileInfo fileNameForTile:tileID] atomically:YES];
+                [_tileInfo writeToCache:tileID tileData:tileData];
 
             elevChunk = [self decodeElevationData:tileData];
 
@@ -308,11 +331,9 @@ using namespace WhirlyKit;
 - (void)startFetchLayer:(MaplyQuadImageTilesLayer *)layer tile:(MaplyTileID)tileID
 {
     MaplyElevationChunk *elevChunk = nil;
-    NSString *fileName = nil;
     // Look for the image in the cache first
     if (_tileInfo.cacheDir)
     {
-        fileName = [_tileInfo fileNameForTile:tileID];
         if ([_tileInfo tileIsLocal:tileID frame:-1])
         {
             elevChunk = [self elevForTile:tileID];
@@ -340,57 +361,54 @@ using namespace WhirlyKit;
             return;
         }
         
-        // Kick off an async request for the data
+        // Kick off an async request for the data.  The fetcher shares it with anyone else after the same URL.
         MaplyRemoteTileElevationSource __weak *weakSelf = self;
-        NSURLSession *session = [NSURLSession sharedSession];
-        NSURLSessionDataTask *task = [session dataTaskWithRequest:urlReq completionHandler:
-        ^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
-            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-                if (!error) {
-                    if (weakSelf)
-                    {
-                        NSData *elevData = data;
-
-                        // Let the delegate know we loaded successfully
-                        if (weakSelf.delegate && [weakSelf.delegate respondsToSelector:@selector(remoteTileSource:tileDidLoad:)])
-                            [weakSelf.delegate remoteTileElevationSource:weakSelf tileDidLoad:tileID];
-
-                        // Let's also write it back out for the cache
-                        if (weakSelf.tileInfo.cacheDir)
-                            //TODO(JM) is it worth to delegate this write to a different worker thread?
-                            [elevData writeToFile:fileName atomically:YES];
-
-                        MaplyElevationChunk *elevChunk = [weakSelf decodeElevationData:elevData];
-
-                        if ([_delegate respondsToSelector:@selector(remoteTileElevationSource:modifyTileReturn:forTile:)])
-                            elevChunk = [_delegate remoteTileElevationSource:self modifyElevReturn:elevChunk forTile:tileID];
-
-                        // Let the paging layer know about it
-                        [layer loadedElevation:elevChunk forTile:tileID];
-
-                        [weakSelf clearTile:tileID];
-                    }
-
-                } else {
-                    if (weakSelf)
-                    {
-                        // Unsucessful load
-                        [layer loadError:error forTile:tileID];
-                        if (weakSelf.delegate && [weakSelf.delegate respondsToSelector:@selector(remoteTileSource:tileDidNotLoad:error:)])
-                            [weakSelf.delegate remoteTileElevationSource:weakSelf tileDidNotLoad:tileID error:error];
-                        [weakSelf clearTile:tileID];
-                    }
+        void (^completion)(NSData *data,NSError *error) =
+        ^(NSData * _Nullable data, NSError * _Nullable error) {
+            if (!error) {
+                if (weakSelf)
+                {
+                    NSData *elevData = data;
+
+                    // Let the delegate know we loaded successfully
+                    if (weakSelf.delegate && [weakSelf.delegate respondsToSelector:@selector(remoteTileSource:tileDidLoad:)])
+                        [weakSelf.delegate remoteTileElevationSource:weakSelf tileDidLoad:tileID];
+
+                    // Let's also write it back out for the cache
+                    if (weakSelf.tileInfo.cacheDir)
+                        //TODO(JM) is it worth to delegate this write to a different worker thread?
+                        [weakSelf.tileInfo writeToCache:tileID tileData:elevData];
+
+                    MaplyElevationChunk *elevChunk = [weakSelf decodeElevationData:elevData];
+
+                    if ([_delegate respondsToSelector:@selector(remoteTileElevationSource:modifyTileReturn:forTile:)])
+                        elevChunk = [_delegate remoteTileElevationSource:self modifyElevReturn:elevChunk forTile:tileID];
+
+                    // Let the paging layer know about it
+                    [layer loadedElevation:elevChunk forTile:tileID];
+
+                    [weakSelf clearTile:tileID];
                 }
-            });
-        }];
 
-        Maply::TileFetchOp fetchOp(tileID);
-        fetchOp.task = task;
+            } else {
+                if (weakSelf)
+                {
+                    // Unsucessful load
+                    [layer loadError:error forTile:tileID];
+                    if (weakSelf.delegate && [weakSelf.delegate respondsToSelector:@selector(remoteTileSource:tileDidNotLoad:error:)])
+                        [weakSelf.delegate remoteTileElevationSource:weakSelf tileDidNotLoad:tileID error:error];
+                    [weakSelf clearTile:tileID];
+                }
+            }
+        };
+
+        // Hold the lock so the completion can't clear the tile before we've recorded it
         @synchronized(self)
         {
+            Maply::TileFetchOp fetchOp(tileID);
+            fetchOp.requestID = [[MaplyTileFetcher sharedFetcher] fetchRequest:urlReq importance:0.0 completion:completion];
             tileSet.insert(fetchOp);
         }
-        [task resume];
     }
 }
 
@@ -23,6 +23,8 @@
 #import "MaplyCoordinateSystem_private.h"
 #import "MaplyQuadImageTilesLayer.h"
 #import "MaplyRemoteTileSource_private.h"
+#import "MaplyTileFetcher.h"
+#import "PackedTileCache.h"
 
 using namespace Eigen;
 using namespace WhirlyKit;
@@ -40,6 +42,9 @@ static bool trackConnections = false;
     int _minZoom,_maxZoom;
     int _pixelsPerSide;
     std::vector<Mbr> mbrs;
+    // Tiles are kept in here, under cacheDir
+    bool tileCacheInit;
+    std::shared_ptr<PackedTileCache> tileCache;
 }
 
 - (instancetype)initWithBaseURL:(NSString *)baseURL ext:(NSString *)ext minZoom:(int)minZoom maxZoom:(int)maxZoom
@@ -54,6 +59,7 @@ static bool trackConnections = false;
     _maxZoom = maxZoom;
     _pixelsPerSide = 256;
     _timeOut = 0.0;
+    _cacheSize = PackedTileCache::DefaultMaxBytes;
     _coordSys = [[MaplySphericalMercator alloc] initWebStandard];
     _replaceURL = [baseURL containsString:@"{y}"] && [baseURL containsString:@"{x}"]; // && [baseURL containsString:@"{z}"];
     
@@ -92,6 +98,7 @@ static bool trackConnections = false;
     _maxZoom = [jsonDict[@"maxzoom"] intValue];
     
     _pixelsPerSide = 256;
+    _cacheSize = PackedTileCache::DefaultMaxBytes;
     
     return self;
 }
@@ -166,35 +173,40 @@ static bool trackConnections = false;
     return localName;
 }
 
-- (bool)tileIsLocal:(MaplyTileID)tileID frame:(int)frame
+- (void)setCacheDir:(NSString *)cacheDir
 {
-    if (!_cacheDir)
-        return false;
-    
-    NSString *fileName = [self fileNameForTile:tileID];
-    if ([[NSFileManager defaultManager] fileExistsAtPath:fileName])
+    @synchronized(self)
     {
-        // If the file is out of date, treat it as if it were not local, as it will have to be fetched.
-        if (self.cachedFileLifetime != 0)
-        {
-            NSDate *fileTimestamp = [MaplyRemoteTileInfo dateForFile:fileName];
-            int ageOfFile = (int) [[NSDate date] timeIntervalSinceDate:fileTimestamp];
-            if (ageOfFile <= self.cachedFileLifetime)
-            {
-                return true;
-            }
-//            else
-//            {
-//                NSLog(@"TileIsLocal returned false due to tile age: %d: (%d,%d)",tileID.level,tileID.x,tileID.y);
-//            }
-        }
-        else // no lifetime set for cached files
+        _cacheDir = cacheDir;
+        cacheInit = false;
+        tileCacheInit = false;
+        tileCache.reset();
+    }
+}
+
+// The packed cache for our kind of tile, opened the first time we need it
+- (std::shared_ptr<PackedTileCache>)getTileCache
+{
+    @synchronized(self)
+    {
+        if (!tileCacheInit && _cacheDir)
         {
-            return true;
+            NSString *tileCacheDir = [_cacheDir stringByAppendingPathComponent:(_ext ? _ext : @"unk")];
+            tileCache = PackedTileCache::cacheForDir([tileCacheDir UTF8String],(size_t)_cacheSize);
+            tileCacheInit = true;
         }
+        return tileCache;
     }
+}
+
+- (bool)tileIsLocal:(MaplyTileID)tileID frame:(int)frame
+{
+    std::shared_ptr<PackedTileCache> cache = [self getTileCache];
+    if (!cache)
+        return false;
     
-    return false;
+    // If the tile is out of date, treat it as if it were not local, as it will have to be fetched.
+    return cache->contains(tileID.level,tileID.x,tileID.y,_cachedFileLifetime);
 }
 
 + (NSDate *)dateForFile:(NSString *)fileName
@@ -207,22 +219,22 @@ static bool trackConnections = false;
 
 - (NSData *)readFromCache:(MaplyTileID)tileID
 {
-    if (!_cacheDir)
+    std::shared_ptr<PackedTileCache> cache = [self getTileCache];
+    std::vector<unsigned char> data;
+    if (!cache || !cache->read(tileID.level,tileID.x,tileID.y,data,_cachedFileLifetime))
         return nil;
     
-    NSString *fileName = [self fileNameForTile:tileID];
-    return [NSData dataWithContentsOfFile:fileName];
+    return [NSData dataWithBytes:data.data() length:data.size()];
 }
 
 - (void)writeToCache:(MaplyTileID)tileID tileData:(NSData * _Nonnull)tileData
 {
-    if (!_cacheDir)
+    std::shared_ptr<PackedTileCache> cache = [self getTileCache];
+    if (!cache)
         return;
     
-    NSString *fileName = [self fileNameForTile:tileID];
-    
-    if (fileName)
-        [tileData writeToFile:fileName atomically:YES];
+    if (!cache->write(tileID.level,tileID.x,tileID.y,[tileData bytes],[tileData length]))
+        NSLog(@"Failed to cache tile: %d: (%d,%d)",tileID.level,tileID.x,tileID.y);
 }
 
 - (NSURLRequest *)requestForTile:(MaplyTileID)tileID
@@ -320,10 +332,7 @@ static bool trackConnections = false;
     {
         for (Maply::TileFetchOpSet::iterator it = tileSet.begin();
              it != tileSet.end(); ++it)
-        {
-            Maply::TileFetchOp tile = *it;
-            [tile.task cancel];
-        }
+            [[MaplyTileFetcher sharedFetcher] cancelRequest:it->requestID];
         tileSet.clear();
     }
 }
@@ -394,6 +403,22 @@ static bool trackConnections = false;
 
 - (void)tileUnloaded:(MaplyTileID)tileID
 {
+    // No point in finishing a fetch for it
+    @synchronized(self)
+    {
+        Maply::TileFetchOpSet::iterator it = tileSet.find(Maply::TileFetchOp(tileID));
+        if (it != tileSet.end())
+        {
+            [[MaplyTileFetcher sharedFetcher] cancelRequest:it->requestID];
+            tileSet.erase(it);
+            if (trackConnections)
+                @synchronized([MaplyRemoteTileSource class])
+            {
+                numConnections--;
+            }
+        }
+    }
+
     if ([_delegate respondsToSelector:@selector(remoteTileSource:tileUnloaded:)])
         [_delegate remoteTileSource:self tileUnloaded:tileID];
 }
@@ -493,6 +518,11 @@ static bool trackConnections = false;
 }
 
 - (void)startFetchLayer:(MaplyQuadImageTilesLayer *)layer tile:(MaplyTileID)tileID
+{
+    [self startFetchLayer:layer tile:tileID frame:-1 importance:0.0];
+}
+
+- (void)startFetchLayer:(MaplyQuadImageTilesLayer *)layer tile:(MaplyTileID)tileID frame:(int)frame importance:(double)importance
 {
     if (trackConnections)
         @synchronized([MaplyRemoteTileSource class])
@@ -538,73 +568,70 @@ static bool trackConnections = false;
             return;
         }
         
-        // Kick off an async request for the data
+        // Kick off an async request for the data.  The fetcher shares it with anyone else after the same URL.
         MaplyRemoteTileSource __weak *weakSelf = self;
 
-        NSURLSession *session = [NSURLSession sharedSession];
-        NSURLSessionDataTask *task = [session dataTaskWithRequest:urlReq completionHandler:
-        ^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
-            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-                if (!error) {
-                    if (weakSelf)
-                    {
-                        NSData *imgData = data;
-                        
-                        if ([_delegate respondsToSelector:@selector(remoteTileSource:modifyTileReturn:forTile:)])
-                            imgData = [_delegate remoteTileSource:self modifyTileReturn:imgData forTile:tileID];
-
-                        // Let the paging layer know about it
-                        bool convertSuccess = [layer loadedImages:imgData forTile:tileID];
-
-                        // Let the delegate know we loaded successfully
-                        if (weakSelf.delegate && [weakSelf.delegate respondsToSelector:@selector(remoteTileSource:tileDidLoad:)])
-                        {
-                            if (convertSuccess)
-                                [weakSelf.delegate remoteTileSource:weakSelf tileDidLoad:tileID];
-                            else
-                                if ([weakSelf.delegate respondsToSelector:@selector(remoteTileSource:tileDidNotLoad:error:)])
-                                    [weakSelf.delegate remoteTileSource:weakSelf tileDidNotLoad:tileID error:nil];
-                        }
-
-                        // Let's also write it back out for the cache
-                        if (convertSuccess)
-                            [weakSelf.tileInfo writeToCache:tileID tileData:imgData];
+        void (^completion)(NSData *data,NSError *error) =
+        ^(NSData * _Nullable data, NSError * _Nullable error) {
+            if (!error) {
+                if (weakSelf)
+                {
+                    NSData *imgData = data;
+                    
+                    if ([_delegate respondsToSelector:@selector(remoteTileSource:modifyTileReturn:forTile:)])
+                        imgData = [_delegate remoteTileSource:self modifyTileReturn:imgData forTile:tileID];
 
-                        [weakSelf clearTile:tileID];
-                    }
+                    // Let the paging layer know about it
+                    bool convertSuccess = [layer loadedImages:imgData forTile:tileID];
 
-                    if (trackConnections)
-                        @synchronized([MaplyRemoteTileSource class])
+                    // Let the delegate know we loaded successfully
+                    if (weakSelf.delegate && [weakSelf.delegate respondsToSelector:@selector(remoteTileSource:tileDidLoad:)])
                     {
-                        numConnections--;
+                        if (convertSuccess)
+                            [weakSelf.delegate remoteTileSource:weakSelf tileDidLoad:tileID];
+                        else
+                            if ([weakSelf.delegate respondsToSelector:@selector(remoteTileSource:tileDidNotLoad:error:)])
+                                [weakSelf.delegate remoteTileSource:weakSelf tileDidNotLoad:tileID error:nil];
                     }
 
-                } else {
-                    if (weakSelf)
-                    {
-                        // Unsucessful load
-                        [layer loadError:error forTile:tileID];
-                        if (weakSelf.delegate && [weakSelf.delegate respondsToSelector:@selector(remoteTileSource:tileDidNotLoad:error:)])
-                            [weakSelf.delegate remoteTileSource:weakSelf tileDidNotLoad:tileID error:error];
-                        [weakSelf clearTile:tileID];
-                    }
+                    // Let's also write it back out for the cache
+                    if (convertSuccess)
+                        [weakSelf.tileInfo writeToCache:tileID tileData:imgData];
 
-                    if (trackConnections)
-                        @synchronized([MaplyRemoteTileSource class])
-                    {
-                        numConnections--;
-                    }
+                    [weakSelf clearTile:tileID];
+                }
+
+                if (trackConnections)
+                    @synchronized([MaplyRemoteTileSource class])
+                {
+                    numConnections--;
+                }
+
+            } else {
+                if (weakSelf)
+                {
+                    // Unsucessful load
+                    [layer loadError:error forTile:tileID];
+                    if (weakSelf.delegate && [weakSelf.delegate respondsToSelector:@selector(remoteTileSource:tileDidNotLoad:error:)])
+                        [weakSelf.delegate remoteTileSource:weakSelf tileDidNotLoad:tileID error:error];
+                    [weakSelf clearTile:tileID];
                 }
-            });
-        }];
 
-        Maply::TileFetchOp fetchOp(tileID);
-        fetchOp.task = task;
+                if (trackConnections)
+                    @synchronized([MaplyRemoteTileSource class])
+                {
+                    numConnections--;
+                }
+            }
+        };
+
+        // Hold the lock so the completion can't clear the tile before we've recorded it
         @synchronized(self)
         {
+            Maply::TileFetchOp fetchOp(tileID);
+            fetchOp.requestID = [[MaplyTileFetcher sharedFetcher] fetchRequest:urlReq importance:importance completion:completion];
             tileSet.insert(fetchOp);
         }
-        [task resume];
     }
 }
 
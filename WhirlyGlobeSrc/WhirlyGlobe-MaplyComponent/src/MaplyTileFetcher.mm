@@ -0,0 +1,186 @@
+/*
+ *  MaplyTileFetcher.mm
+ *  WhirlyGlobe-MaplyComponent
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import "MaplyTileFetcher.h"
+#import "FetchScheduler.h"
+#import <map>
+#import <set>
+
+using namespace WhirlyKit;
+
+// The data is an NSData on success and an NSError on failure
+typedef FetchScheduler<id> TileFetchScheduler;
+
+@implementation MaplyTileFetcher
+{
+    TileFetchScheduler *scheduler;
+    NSURLSession *session;
+    // Tasks for fetches that are out
+    std::map<TileFetchScheduler::FetchID,NSURLSessionDataTask *> tasks;
+    // Fetches cancelled before their task got going
+    std::set<TileFetchScheduler::FetchID> cancelled;
+}
+
++ (MaplyTileFetcher *)sharedFetcher
+{
+    static MaplyTileFetcher *sharedFetcher = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedFetcher = [[MaplyTileFetcher alloc] init];
+    });
+
+    return sharedFetcher;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (!self)
+        return nil;
+
+    _maxConnectionsPerHost = 6;
+    _maxConnections = 16;
+    scheduler = new TileFetchScheduler(_maxConnectionsPerHost,_maxConnections);
+
+    // The scheduler does the limiting, so don't let the session hold anything back
+    NSURLSessionConfiguration *config = [NSURLSessionConfiguration defaultSessionConfiguration];
+    config.HTTPMaximumConnectionsPerHost = _maxConnections;
+    session = [NSURLSession sessionWithConfiguration:config];
+
+    MaplyTileFetcher __weak *weakSelf = self;
+    scheduler->setCancelFunc([weakSelf](TileFetchScheduler::FetchID fetchID)
+                             {
+                                 [weakSelf cancelFetch:fetchID];
+                             });
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [session invalidateAndCancel];
+    delete scheduler;
+}
+
+- (void)setMaxConnectionsPerHost:(int)maxConnectionsPerHost
+{
+    _maxConnectionsPerHost = maxConnectionsPerHost;
+    scheduler->setLimits(_maxConnectionsPerHost,_maxConnections);
+}
+
+- (void)setMaxConnections:(int)maxConnections
+{
+    _maxConnections = maxConnections;
+    scheduler->setLimits(_maxConnectionsPerHost,_maxConnections);
+}
+
+- (MaplyFetchRequestID)fetchRequest:(NSURLRequest *)urlReq importance:(double)importance completion:(void (^)(NSData *data,NSError *error))completion
+{
+    NSString *urlStr = urlReq.URL.absoluteString;
+    NSString *host = urlReq.URL.host;
+    std::string url = urlStr ? [urlStr UTF8String] : "";
+    std::string hostStr = host ? [host UTF8String] : "";
+    void (^theCompletion)(NSData *data,NSError *error) = [completion copy];
+
+    MaplyTileFetcher __weak *weakSelf = self;
+    return scheduler->request(url, hostStr, importance,
+                              [weakSelf,urlReq](TileFetchScheduler::FetchID fetchID)
+                              {
+                                  [weakSelf startFetch:fetchID request:urlReq];
+                              },
+                              [theCompletion](bool success,id result)
+                              {
+                                  dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
+                                  ^{
+                                      if (success)
+                                          theCompletion(result,nil);
+                                      else
+                                          theCompletion(nil,result);
+                                  });
+                              });
+}
+
+- (void)cancelRequest:(MaplyFetchRequestID)requestID
+{
+    scheduler->cancel(requestID);
+}
+
+- (void)setImportance:(double)importance forRequest:(MaplyFetchRequestID)requestID
+{
+    scheduler->setImportance(requestID, importance);
+}
+
+- (void)getTimeToTileMedian:(double *)median p99:(double *)p99
+{
+    *median = scheduler->getTimeToData(0.5);
+    *p99 = scheduler->getTimeToData(0.99);
+}
+
+// Called by the scheduler when it's time for a fetch to go out
+- (void)startFetch:(TileFetchScheduler::FetchID)fetchID request:(NSURLRequest *)urlReq
+{
+    MaplyTileFetcher __weak *weakSelf = self;
+    NSURLSessionDataTask *task = [session dataTaskWithRequest:urlReq completionHandler:
+    ^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
+        MaplyTileFetcher *strongSelf = weakSelf;
+        if (!strongSelf)
+            return;
+        @synchronized(strongSelf)
+        {
+            strongSelf->tasks.erase(fetchID);
+        }
+        if (error)
+            strongSelf->scheduler->finish(fetchID, false, error);
+        else
+            strongSelf->scheduler->finish(fetchID, true, data);
+        @synchronized(strongSelf)
+        {
+            strongSelf->cancelled.erase(fetchID);
+        }
+    }];
+
+    @synchronized(self)
+    {
+        // It may have been cancelled before we got here
+        if (cancelled.erase(fetchID))
+            return;
+        tasks[fetchID] = task;
+    }
+    [task resume];
+}
+
+// Called by the scheduler when no one wants a fetch that's out
+- (void)cancelFetch:(TileFetchScheduler::FetchID)fetchID
+{
+    NSURLSessionDataTask *task = nil;
+    @synchronized(self)
+    {
+        auto it = tasks.find(fetchID);
+        if (it != tasks.end())
+        {
+            task = it->second;
+            tasks.erase(it);
+        } else
+            cancelled.insert(fetchID);
+    }
+    [task cancel];
+}
+
+@end
@@ -22,6 +22,7 @@
 #import "sqlite3.h"
 #import "FMDatabase.h"
 #import "FMDatabaseQueue.h"
+#import "QuadKey.h"
 #import "NSData+Zlib.h"
 #import "MaplyVectorObject_private.h"
 #import "MaplyScreenLabel.h"
@@ -30,6 +31,8 @@
 #import "MaplyVectorTileMarkerStyle.h"
 #import "MaplyVectorTilePolygonStyle.h"
 #import "MaplyVectorTileTextStyle.h"
+#import "PackedTileCache.h"
+#import "MaplyTileFetcher.h"
 #import <string>
 #import <map>
 #import <vector>
@@ -54,6 +57,9 @@ typedef std::map<std::string,MaplyVectorTileStyle *> StyleMap;
     
     // If we're fetching remotely, the tile URLs
     NSArray *tileURLs;
+    
+    // Fetched tiles are kept in here, under cacheDir
+    std::shared_ptr<WhirlyKit::PackedTileCache> tileCache;
 }
 
 + ( void)StartRemoteVectorTiles:(NSString *)jsonURL cacheDir:(NSString *)cacheDir viewC:(MaplyBaseViewController *)viewC block:(void (^)(MaplyVectorTiles *vecTiles))callbackBlock
@@ -335,10 +341,11 @@ typedef std::map<std::string,MaplyVectorTileStyle *> StyleMap;
 - (void)setCacheDir:(NSString *)cacheDir
 {
     _cacheDir = cacheDir;
-    // Make sure it exists
-    NSError *error = nil;
-    if (![[NSFileManager defaultManager] fileExistsAtPath:cacheDir])
-        [[NSFileManager defaultManager] createDirectoryAtPath:cacheDir withIntermediateDirectories:YES attributes:nil error:&error];
+    // This makes the directory if it's not there
+    if (cacheDir)
+        tileCache = WhirlyKit::PackedTileCache::cacheForDir([[cacheDir stringByAppendingPathComponent:@"vector"] UTF8String],WhirlyKit::PackedTileCache::DefaultMaxBytes);
+    else
+        tileCache.reset();
 }
 
 // Return or create the object which will create the given style
@@ -410,17 +417,14 @@ typedef std::map<std::string,MaplyVectorTileStyle *> StyleMap;
     {
         // Put together the precalculated quad index.  This is faster
         //  than x,y,level
-        int quadIdx = 0;
-        for (int iq=0;iq<tileID.level;iq++)
-            quadIdx += (1<<iq)*(1<<iq);
-        quadIdx += tileID.y*(1<<tileID.level)+tileID.x;
+        long long quadIdx = WhirlyKit::QuadKey(tileID.x,tileID.y,tileID.level).quadIndex();
         
         NSData * __block uncompressedData=nil;
         bool __block tilePresent = false;
         // Note: Need to sort this out
         [queue inDatabase:^(FMDatabase *theDb) {
             // Now look for the tile
-            FMResultSet *res = [theDb executeQuery:[NSString stringWithFormat:@"SELECT data FROM %@_table WHERE quadindex=%d;",layerName,quadIdx]];
+            FMResultSet *res = [theDb executeQuery:[NSString stringWithFormat:@"SELECT data FROM %@_table WHERE quadindex=%lld;",layerName,quadIdx]];
             NSData *data = nil;
             if ([res next])
             {
@@ -540,13 +544,11 @@ typedef std::map<std::string,NSMutableArray *> VecsForStyles;
            if (tileURLs)
            {
                // See if it's in the cache first
-               NSString *cacheFileName = nil;
+               std::shared_ptr<WhirlyKit::PackedTileCache> cache = tileCache;
                NSData *cacheData = nil;
-               if (_cacheDir)
-               {
-                   cacheFileName = [NSString stringWithFormat:@"%@/tile%d_%d_%d",_cacheDir,tileID.level,tileID.x,tileID.y];
-                   cacheData = [NSData dataWithContentsOfFile:cacheFileName];
-               }
+               std::vector<unsigned char> tileData;
+               if (cache && cache->read(tileID.level,tileID.x,tileID.y,tileData))
+                   cacheData = [NSData dataWithBytes:tileData.data() length:tileData.size()];
                
                if (cacheData)
                {
@@ -571,36 +573,33 @@ typedef std::map<std::string,NSMutableArray *> VecsForStyles;
                    NSMutableURLRequest *urlReq = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:fullURLStr]];
                    urlReq.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
                    // Note: Should set the timeout
-                   NSURLSession *session = [NSURLSession sharedSession];
-                   NSURLSessionDataTask *task = [session dataTaskWithRequest:urlReq completionHandler:
-                    ^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
-                        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-                            if (!error) {
-                                // Uncompress the data
-                                NSData *uncompressedData = [data uncompressGZip];
-                                MaplyVectorObject *vecObj = nil;
-                                if ([uncompressedData length] > 0)
-                                    vecObj = [MaplyVectorObject VectorObjectFromVectorDBRaw:uncompressedData];
-                                if (vecObj)
-                                    [self processLayers:tileID layerData:@[vecObj] layer:layer];
-                                //NSLog(@"Loaded tile: %d: (%d,%d)",tileID.level,tileID.x,tileID.y);
-                                // Save out to the cache
-                                if (cacheFileName)
-                                    if (![data writeToFile:cacheFileName atomically:YES])
-                                        NSLog(@"Failed to write tile: %d: (%d,%d)",tileID.level,tileID.x,tileID.y);
-
-                                [layer tileDidLoad:tileID];
-
-                            } else {
-                                //NSLog(@"Failed to fetch vector tile for %d: (%d,%d)\n%@",tileID.level,tileID.x,tileID.y,error);
-                                // Note: We have to do this because we're missing tiles in the middle
-                                [layer tileDidLoad:tileID];
-                                //                    [layer tileFailedToLoad:tileID];
-
-                            }
-                        });
+                   // The paging layer doesn't tell us how important the tile is, so these go out in order
+                   [[MaplyTileFetcher sharedFetcher] fetchRequest:urlReq importance:0.0 completion:
+                    ^(NSData * _Nullable data, NSError * _Nullable error) {
+                        if (!error) {
+                            // Uncompress the data
+                            NSData *uncompressedData = [data uncompressGZip];
+                            MaplyVectorObject *vecObj = nil;
+                            if ([uncompressedData length] > 0)
+                                vecObj = [MaplyVectorObject VectorObjectFromVectorDBRaw:uncompressedData];
+                            if (vecObj)
+                                [self processLayers:tileID layerData:@[vecObj] layer:layer];
+                            //NSLog(@"Loaded tile: %d: (%d,%d)",tileID.level,tileID.x,tileID.y);
+                            // Save out to the cache
+                            if (cache)
+                                if (!cache->write(tileID.level,tileID.x,tileID.y,[data bytes],[data length]))
+                                    NSLog(@"Failed to write tile: %d: (%d,%d)",tileID.level,tileID.x,tileID.y);
+
+                            [layer tileDidLoad:tileID];
+
+                        } else {
+                            //NSLog(@"Failed to fetch vector tile for %d: (%d,%d)\n%@",tileID.level,tileID.x,tileID.y,error);
+                            // Note: We have to do this because we're missing tiles in the middle
+                            [layer tileDidLoad:tileID];
+                            //                    [layer tileFailedToLoad:tileID];
+
+                        }
                     }];
-                   [task resume];
 
                }
            } else {
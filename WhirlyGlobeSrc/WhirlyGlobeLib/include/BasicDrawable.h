@@ -181,6 +181,9 @@ public:
     virtual unsigned int addPoint(const Point3f &pt);
     virtual unsigned int addPoint(const Point3d &pt);
     
+    /// Add a run of points at once.  Returns the index of the first one.
+    virtual unsigned int addPoints(const Point3f *pts,int count);
+    
     /// Return a given point
     virtual Point3f getPoint(int which);
     
@@ -188,6 +191,9 @@ public:
     ///  texture coordinate to all the available texture coordinate sets
     virtual void addTexCoord(int which,TexCoord coord);
     
+    /// Add a run of texture coordinates.  -1 works the same as for addTexCoord()
+    virtual void addTexCoords(int which,const TexCoord *coords,int count);
+    
     /// Add a color
     virtual void addColor(RGBAColor color);
     
@@ -195,6 +201,9 @@ public:
     virtual void addNormal(const Point3f &norm);
     virtual void addNormal(const Point3d &norm);
     
+    /// Add a run of normals
+    virtual void addNormals(const Point3f *norms,int count);
+    
     /// Decide if the given list of vertex attributes is the same as the one we have
     bool compareVertexAttributes(const SingleVertexAttributeSet &attrs);
     
@@ -222,9 +231,15 @@ public:
     /// Add a triangle.  Should point to the vertex IDs.
     virtual void addTriangle(Triangle tri);
     
+    /// Add a run of triangles.  Should point to the vertex IDs.
+    virtual void addTriangles(const Triangle *inTris,int count);
+    
     /// Return the texture ID
     virtual SimpleIdentity getTexId(unsigned int which);
     
+    /// The first texture is the one we group by
+    virtual SimpleIdentity getMainTexture() const;
+    
     /// Texture ID and pointer to vertex attribute info
     class TexInfo
     {
@@ -301,6 +316,9 @@ public:
     /// Add a single point to the GL Buffer.
     /// Override this to add your own data to interleaved vertex buffers.
     virtual void addPointToBuffer(unsigned char *basePtr,int which,const Point3d *center);
+    /// Add the first numVerts points to the GL buffer, one attribute at a time.
+    /// This is what setupGL() uses.  If you override addPointToBuffer(), override this too.
+    virtual void addPointsToBuffer(unsigned char *basePtr,int numVerts,const Point3d *center);
     /// Called while a new VAO is bound.  Set up your VAO-related state here.
     virtual void setupAdditionalVAO(OpenGLES2Program *prog,GLuint vertArrayObj) { }
     /// Called after the drawable has bound all its various data, but before it actually
@@ -58,6 +58,9 @@ public:
     /// For OpenGLES2, this is the program to use to render this drawable.
     virtual SimpleIdentity getProgram() const;
     
+    /// Texture from the master drawable
+    virtual SimpleIdentity getMainTexture() const;
+    
     /// Set the shader program
     void setProgram(SimpleIdentity progID) { programID = progID; }
     
@@ -0,0 +1,264 @@
+/*
+ *  ChangeQueue.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <atomic>
+#import <vector>
+#import <algorithm>
+#import <math.h>
+
+namespace WhirlyKit
+{
+
+/** Multiple producer, single consumer queue.
+    Any number of threads can push without ever blocking or taking a lock.
+    Only one thread at a time may pop.
+    This is Vyukov's intrusive MPSC queue with a stub node.  A push is one atomic
+    exchange and one store.  If a producer is caught between those two, pop() will
+    report empty and the item shows up on the next pop.
+    This is plain C++ so the benchmarks can use it too.
+  */
+template<typename T>
+class MPSCQueue
+{
+public:
+    MPSCQueue() : head(&stub), tail(&stub), numPushed(0), numPopped(0) { stub.next.store(nullptr,std::memory_order_relaxed); }
+    ~MPSCQueue()
+    {
+        T value;
+        while (pop(value)) { }
+    }
+
+    /// Add to the end.  Safe from any thread.
+    void push(const T &value)
+    {
+        Node *node = new Node();
+        node->value = value;
+        pushNode(node);
+        numPushed.fetch_add(1,std::memory_order_release);
+    }
+
+    /// Take from the front.  Only the consumer thread may call this.
+    /// Returns false if there's nothing (finished) to take.
+    bool pop(T &value)
+    {
+        Node *theTail = tail;
+        Node *next = theTail->next.load(std::memory_order_acquire);
+        // Skip over the stub
+        if (theTail == &stub)
+        {
+            if (!next)
+                return false;
+            tail = next;
+            theTail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next)
+        {
+            tail = next;
+            value = std::move(theTail->value);
+            delete theTail;
+            numPopped++;
+            return true;
+        }
+        // A producer is partway through a push
+        if (theTail != head.load(std::memory_order_acquire))
+            return false;
+        // Last real node.  Put the stub back behind it so we can take it.
+        pushNode(&stub);
+        next = theTail->next.load(std::memory_order_acquire);
+        if (next)
+        {
+            tail = next;
+            value = std::move(theTail->value);
+            delete theTail;
+            numPopped++;
+            return true;
+        }
+        return false;
+    }
+
+    /// Take what had been pushed when we were called, but nothing that shows up while we're at it.
+    /// Looping on pop() can keep the consumer busy for as long as the producers keep pushing.
+    /// Only the consumer thread may call this.  Returns the number we took.
+    size_t popAvailable(std::vector<T> &out)
+    {
+        size_t avail = numPushed.load(std::memory_order_acquire) - numPopped;
+        size_t taken = 0;
+        T value;
+        while (taken < avail && pop(value))
+        {
+            out.push_back(std::move(value));
+            taken++;
+        }
+        return taken;
+    }
+
+    /// True if there's nothing to pop.  Only the consumer should call this.
+    bool empty() const
+    {
+        return tail == &stub && !stub.next.load(std::memory_order_acquire);
+    }
+
+protected:
+    class Node
+    {
+    public:
+        std::atomic<Node *> next;
+        T value;
+    };
+
+    void pushNode(Node *node)
+    {
+        node->next.store(nullptr,std::memory_order_relaxed);
+        Node *prev = head.exchange(node,std::memory_order_acq_rel);
+        prev->next.store(node,std::memory_order_release);
+    }
+
+    // Producers swap themselves in here
+    std::atomic<Node *> head;
+    // Only the consumer touches this
+    Node *tail;
+    Node stub;
+    // Finished pushes and the pops to go with them, so popAvailable() knows where to stop
+    std::atomic<size_t> numPushed;
+    size_t numPopped;
+};
+
+/** Hashed timer wheel for things that should happen at a given time.
+    Times are absolute seconds.  Each slot covers resolution seconds and the wheel
+    wraps after numSlots of them.  Items further out than that just sit in their
+    slot until their turn comes around.
+    Not thread safe.  The scene only touches this on the rendering thread.
+  */
+template<typename T>
+class TimerWheel
+{
+public:
+    TimerWheel(double resolution = 1.0/60.0,int numSlots = 256)
+    : resolution(resolution), slots(numSlots), lastTick(0), started(false), count(0) { }
+
+    /// Add an item to go off at the given time
+    void insert(double when,const T &item)
+    {
+        long long tick = tickFor(when);
+        // Anything in the past goes in the slot we'll look at next
+        if (started && tick < lastTick)
+            tick = lastTick;
+        slots[tick % slots.size()].push_back(Entry(when,item));
+        count++;
+    }
+
+    /// Append everything due at or before now to the output, in time order
+    void advance(double now,std::vector<T> &out)
+    {
+        if (count == 0)
+        {
+            lastTick = tickFor(now);
+            started = true;
+            return;
+        }
+
+        std::vector<Entry> due;
+        long long nowTick = tickFor(now);
+        if (!started || nowTick - lastTick >= (long long)slots.size())
+        {
+            for (unsigned int ii=0;ii<slots.size();ii++)
+                takeDue(slots[ii],now,due);
+        } else {
+            for (long long tick=lastTick;tick<=nowTick;tick++)
+                takeDue(slots[tick % slots.size()],now,due);
+        }
+        lastTick = std::max(lastTick,nowTick);
+        started = true;
+
+        std::stable_sort(due.begin(),due.end(),[](const Entry &a,const Entry &b) { return a.when < b.when; });
+        for (const Entry &entry : due)
+            out.push_back(entry.item);
+    }
+
+    /// True if advance() would return something
+    bool hasDue(double now) const
+    {
+        if (count == 0)
+            return false;
+        long long nowTick = tickFor(now);
+        if (!started || nowTick - lastTick >= (long long)slots.size())
+        {
+            for (unsigned int ii=0;ii<slots.size();ii++)
+                if (anyDue(slots[ii],now))
+                    return true;
+        } else {
+            for (long long tick=lastTick;tick<=nowTick;tick++)
+                if (anyDue(slots[tick % slots.size()],now))
+                    return true;
+        }
+        return false;
+    }
+
+    /// Take everything out, due or not
+    void takeAll(std::vector<T> &out)
+    {
+        for (std::vector<Entry> &slot : slots)
+        {
+            for (const Entry &entry : slot)
+                out.push_back(entry.item);
+            slot.clear();
+        }
+        count = 0;
+    }
+
+    /// Number of items waiting
+    size_t size() const { return count; }
+
+protected:
+    class Entry
+    {
+    public:
+        Entry(double when,const T &item) : when(when), item(item) { }
+        double when;
+        T item;
+    };
+
+    long long tickFor(double when) const { return (long long)floor(when / resolution); }
+
+    void takeDue(std::vector<Entry> &slot,double now,std::vector<Entry> &due)
+    {
+        auto it = std::stable_partition(slot.begin(),slot.end(),[now](const Entry &entry) { return entry.when > now; });
+        due.insert(due.end(),it,slot.end());
+        count -= slot.end() - it;
+        slot.erase(it,slot.end());
+    }
+
+    static bool anyDue(const std::vector<Entry> &slot,double now)
+    {
+        for (const Entry &entry : slot)
+            if (entry.when <= now)
+                return true;
+        return false;
+    }
+
+    double resolution;
+    std::vector<std::vector<Entry> > slots;
+    long long lastTick;
+    bool started;
+    size_t count;
+};
+
+}
@@ -0,0 +1,295 @@
+/*
+ *  ClusterIndex.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import <unordered_map>
+#import <algorithm>
+#import <limits>
+#import <math.h>
+#import <Eigen/Eigen>
+
+namespace WhirlyKit
+{
+
+/** Hierarchical clustering of points, worked out once ahead of time.
+    Level 0 is the coarsest.  Each level down halves the cluster radius, starting
+    from the extent of all the points.  Going from the finest level up, each point
+    or cluster pulls in everything within that level's radius that hasn't been
+    taken yet, same as supercluster does for map tiles.
+    Clusters that don't change between levels are only stored once, so the whole
+    thing is a tree of at most twice as many nodes as there are points.  A query
+    walks down from the roots, skipping anything outside the area of interest, so
+    it costs about as much as the number of clusters it returns.
+    This is plain C++.
+  */
+template<typename T>
+class ClusterIndex
+{
+public:
+    /// A cluster or a single point
+    class Node
+    {
+    public:
+        /// Average location in the index's 2D space, weighted by point
+        Eigen::Vector2d center;
+        /// Average of the 3D locations passed in for the points
+        Eigen::Vector3d dispCenter;
+        /// Bounding box of all the points underneath, in 2D
+        Eigen::Vector2d ll,ur;
+        /// Coarsest and finest level this node shows up at
+        int minLevel,maxLevel;
+        /// The points underneath are leaves [leafStart,leafEnd)
+        int leafStart,leafEnd;
+        /// Nodes this one was made from
+        std::vector<int> children;
+
+        /// Number of points in the cluster
+        int getCount() const { return leafEnd - leafStart; }
+    };
+
+    ClusterIndex(int numLevels = 20) : numLevels(numLevels), rootRadius(1.0) { }
+
+    /// Build from scratch.  pts are where things are in a flat 2D space, dispPts are
+    /// carried along for the caller to place clusters with.  The order of the input
+    /// decides ties, so the same input always gives the same clusters.
+    void build(const std::vector<Eigen::Vector2d> &pts,const std::vector<Eigen::Vector3d> &dispPts,const std::vector<T> &items)
+    {
+        nodes.clear();
+        roots.clear();
+        leaves.clear();
+        if (pts.empty())
+            return;
+
+        Eigen::Vector2d ll = pts[0], ur = pts[0];
+        for (const Eigen::Vector2d &pt : pts)
+        {
+            ll = ll.cwiseMin(pt);
+            ur = ur.cwiseMax(pt);
+        }
+        rootRadius = std::max(ur.x()-ll.x(),ur.y()-ll.y());
+        if (rootRadius <= 0.0)
+            rootRadius = 1.0;
+
+        // Leaves live in the finest level and below
+        nodes.reserve(2*pts.size());
+        std::vector<int> current(pts.size());
+        for (unsigned int ii=0;ii<pts.size();ii++)
+        {
+            Node node;
+            node.center = pts[ii];
+            node.dispCenter = dispPts[ii];
+            node.ll = node.ur = pts[ii];
+            node.minLevel = 0;
+            node.maxLevel = numLevels;
+            node.leafStart = ii;
+            node.leafEnd = ii+1;
+            nodes.push_back(node);
+            current[ii] = ii;
+        }
+
+        // Work our way up, merging things that are close enough at each level
+        std::vector<int> next;
+        std::vector<bool> taken;
+        std::unordered_map<long long,std::vector<int> > cells;
+        for (int level=numLevels-1;level>=0;level--)
+        {
+            double radius = getRadius(level);
+            cells.clear();
+            for (unsigned int ii=0;ii<current.size();ii++)
+                cells[cellKey(nodes[current[ii]].center,radius,0,0)].push_back(ii);
+
+            taken.assign(current.size(),false);
+            next.clear();
+            for (unsigned int ii=0;ii<current.size();ii++)
+            {
+                if (taken[ii])
+                    continue;
+                taken[ii] = true;
+                Eigen::Vector2d center = nodes[current[ii]].center;
+
+                // Everything nearby that's still loose
+                std::vector<int> merge(1,current[ii]);
+                for (int dy=-1;dy<=1;dy++)
+                    for (int dx=-1;dx<=1;dx++)
+                    {
+                        auto it = cells.find(cellKey(center,radius,dx,dy));
+                        if (it == cells.end())
+                            continue;
+                        for (int which : it->second)
+                            if (!taken[which] && (nodes[current[which]].center - center).squaredNorm() <= radius*radius)
+                            {
+                                taken[which] = true;
+                                merge.push_back(current[which]);
+                            }
+                    }
+
+                if (merge.size() == 1)
+                {
+                    next.push_back(current[ii]);
+                    continue;
+                }
+
+                // Keep the children in input order
+                std::sort(merge.begin()+1,merge.end());
+                Node node;
+                node.center = Eigen::Vector2d(0,0);
+                node.dispCenter = Eigen::Vector3d(0,0,0);
+                node.ll = nodes[merge[0]].ll;
+                node.ur = nodes[merge[0]].ur;
+                int count = 0;
+                for (int which : merge)
+                {
+                    Node &child = nodes[which];
+                    int childCount = child.getCount();
+                    node.center += child.center * childCount;
+                    node.dispCenter += child.dispCenter * childCount;
+                    node.ll = node.ll.cwiseMin(child.ll);
+                    node.ur = node.ur.cwiseMax(child.ur);
+                    count += childCount;
+                    child.minLevel = level+1;
+                }
+                node.center /= count;
+                node.dispCenter /= count;
+                node.minLevel = 0;
+                node.maxLevel = level;
+                node.leafStart = 0;
+                node.leafEnd = count;
+                node.children = merge;
+                next.push_back((int)nodes.size());
+                nodes.push_back(node);
+            }
+            current.swap(next);
+        }
+        roots = current;
+
+        // Lay out the leaves so every node's points are next to each other
+        leaves.reserve(items.size());
+        for (int root : roots)
+            placeLeaves(root,items);
+    }
+
+    /// Number of levels, not counting the leaves
+    int getNumLevels() const { return numLevels; }
+
+    /// Radius things were clustered with at the given level
+    double getRadius(int level) const { return rootRadius / (double)(1LL << level); }
+
+    /// Finest level whose radius is at least the given size.
+    /// Returns getNumLevels() if there is none, which gets you the individual points.
+    int levelForRadius(double radius) const
+    {
+        if (radius <= 0.0)
+            return numLevels;
+        if (radius >= rootRadius)
+            return 0;
+        return std::min(numLevels,(int)floor(log2(rootRadius / radius)));
+    }
+
+    /// Call visit with each node at the given level that might touch the box
+    template<typename VisitType>
+    void query(int level,const Eigen::Vector2d &ll,const Eigen::Vector2d &ur,VisitType visit) const
+    {
+        std::vector<int> stack(roots.rbegin(),roots.rend());
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.ur.x() < ll.x() || node.ll.x() > ur.x() || node.ur.y() < ll.y() || node.ll.y() > ur.y())
+                continue;
+            if (level <= node.maxLevel)
+                visit(node);
+            else
+                stack.insert(stack.end(),node.children.rbegin(),node.children.rend());
+        }
+    }
+
+    /// Call visit with every node at the given level
+    template<typename VisitType>
+    void queryAll(int level,VisitType visit) const
+    {
+        double inf = std::numeric_limits<double>::infinity();
+        query(level,Eigen::Vector2d(-inf,-inf),Eigen::Vector2d(inf,inf),visit);
+    }
+
+    /// One of the items passed in, by leaf index
+    const T &getLeaf(int which) const { return leaves[which]; }
+
+    /// Number of points we were built with
+    int getNumLeaves() const { return (int)leaves.size(); }
+
+    /// Total number of nodes, including the leaves
+    int getNumNodes() const { return (int)nodes.size(); }
+
+protected:
+    // Hash for the grid cell a point falls in, offset by some number of cells
+    static long long cellKey(const Eigen::Vector2d &pt,double cellSize,int dx,int dy)
+    {
+        long long cx = (long long)floor(pt.x() / cellSize) + dx;
+        long long cy = (long long)floor(pt.y() / cellSize) + dy;
+        return (cx * 73856093LL) ^ (cy * 19349663LL);
+    }
+
+    // Assign the leaves under a node in order
+    void placeLeaves(int which,const std::vector<T> &items)
+    {
+        std::vector<int> stack(1,which);
+        while (!stack.empty())
+        {
+            Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.children.empty())
+            {
+                int item = node.leafStart;
+                node.leafStart = (int)leaves.size();
+                node.leafEnd = node.leafStart+1;
+                leaves.push_back(items[item]);
+            } else
+                stack.insert(stack.end(),node.children.rbegin(),node.children.rend());
+        }
+
+        // Now the ranges for the clusters, which always come after their children
+        fixRanges(which);
+    }
+
+    void fixRanges(int which)
+    {
+        Node &node = nodes[which];
+        if (node.children.empty())
+            return;
+        int start = -1, end = -1;
+        for (int child : node.children)
+        {
+            fixRanges(child);
+            if (start < 0)
+                start = nodes[child].leafStart;
+            end = nodes[child].leafEnd;
+        }
+        node.leafStart = start;
+        node.leafEnd = end;
+    }
+
+    int numLevels;
+    double rootRadius;
+    std::vector<Node> nodes;
+    std::vector<int> roots;
+    std::vector<T> leaves;
+};
+
+}
@@ -70,13 +70,48 @@ public:
     virtual WhirlyKit::Point3f geocentricToLocal(WhirlyKit::Point3f) = 0;
     virtual WhirlyKit::Point3d geocentricToLocal(WhirlyKit::Point3d) = 0;
     
+    /// Batch versions of the conversions above.  These do count points in one go,
+    ///  which is a lot cheaper than a virtual call (or a proj.4 call) per point.
+    /// The defaults just loop over the single point versions.
+    /// Input and output can be the same array when the types match.
+    virtual void localToGeographic(const Point3d *inPts,Point2d *outPts,int count);
+    virtual void geographicToLocal(const Point2d *inPts,Point3d *outPts,int count);
+    virtual void localToGeocentric(const Point3d *inPts,Point3d *outPts,int count);
+    virtual void geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count);
+    
     /// Return true if the given coordinate system is the same as the one passed in
     virtual bool isSameAs(CoordSystem *coordSys) { return false; }
+    
+    /// Return true if this system gets to geocentric by way of WGS84 lat/lon plus height.
+    /// Batch conversions between two of these can skip geocentric entirely.
+    virtual bool geocentricViaGeographic() { return false; }
 };
     
 /// Convert a point from one coordinate system to another
 Point3f CoordSystemConvert(CoordSystem *inSystem,CoordSystem *outSystem,Point3f inCoord);
 Point3d CoordSystemConvert3d(CoordSystem *inSystem,CoordSystem *outSystem,Point3d inCoord);
+/// Convert an array of points from one coordinate system to another.  In and out can be the same.
+void CoordSystemConvert3d(CoordSystem *inSystem,CoordSystem *outSystem,const Point3d *inCoords,Point3d *outCoords,int count);
+
+/// Multiply each point by scale and add offset, in place or from one array to another.
+/// This is the inner loop for the flat display adapters, written so the compiler can vectorize it.
+template<typename T>
+void ScaleOffsetPoints(const Eigen::Matrix<T,3,1> *inPts,Eigen::Matrix<T,3,1> *outPts,int count,const Eigen::Matrix<T,3,1> &scale,const Eigen::Matrix<T,3,1> &offset)
+{
+    if (count <= 0)
+        return;
+    const T sx = scale.x(), sy = scale.y(), sz = scale.z();
+    const T ox = offset.x(), oy = offset.y(), oz = offset.z();
+    const T *in = inPts[0].data();
+    T *out = outPts[0].data();
+    for (int ii=0;ii<count;ii++,in+=3,out+=3)
+    {
+        T x = in[0], y = in[1], z = in[2];
+        out[0] = x*sx + ox;
+        out[1] = y*sy + oy;
+        out[2] = z*sz + oz;
+    }
+}
     
 /** The Coordinate System Display Adapter handles the task of
     converting coordinates in the native system to data values we
@@ -116,6 +151,12 @@ public:
     virtual WhirlyKit::Point3f displayToLocal(WhirlyKit::Point3f) = 0;
     virtual WhirlyKit::Point3d displayToLocal(WhirlyKit::Point3d) = 0;
     
+    /// Batch versions of localToDisplay() and displayToLocal().
+    /// The defaults loop over the single point versions.  In and out can be the same array.
+    virtual void localToDisplay(const Point3f *inPts,Point3f *outPts,int count);
+    virtual void localToDisplay(const Point3d *inPts,Point3d *outPts,int count);
+    virtual void displayToLocal(const Point3d *inPts,Point3d *outPts,int count);
+    
     /// For flat systems the normal is Z up.  For the globe, it's based on the location.
     virtual Point3f normalForLocal(Point3f) = 0;
     virtual Point3d normalForLocal(Point3d) = 0;
@@ -160,6 +201,11 @@ public:
     WhirlyKit::Point3f displayToLocal(WhirlyKit::Point3f);
     WhirlyKit::Point3d displayToLocal(WhirlyKit::Point3d);
     
+    /// Batch versions
+    void localToDisplay(const Point3f *inPts,Point3f *outPts,int count);
+    void localToDisplay(const Point3d *inPts,Point3d *outPts,int count);
+    void displayToLocal(const Point3d *inPts,Point3d *outPts,int count);
+    
     /// For flat systems the normal is Z up.
     Point3f normalForLocal(Point3f) { return Point3f(0,0,1); }
     Point3d normalForLocal(Point3d) { return Point3d(0,0,1); }
@@ -18,106 +18,147 @@
  *
  */
 
-#import "BasicDrawable.h"
+#import <vector>
+#import "WhirlyVector.h"
 #import "CoordSystem.h"
 
 namespace WhirlyKit
-{	
-    
-class Cullable;
+{
+
+/// Number of "corners" we used to define things in world space.
+#define WhirlyKitCullableCorners 8
+/// Number of normals we'll consider for backface culling calculations.
+#define WhirlyKitCullableCornerNorms 4
 
-/** This is the top level of the culling tree, represented by Cullables.
-    In general, you should see this.  It's used by the Scene represented
+/** What we need to know about the view to cull for a frame.
+    Cull tree nodes are projected to the screen the same way WhirlyGlobeView's
+    pointOnScreenFromSphere does it, but the setup is done once here.
+  */
+class CullView
+{
+public:
+    /// Set up with the model transform, the frustum (from calcFrustumWidth), the frame size and the eye vector.
+    /// Nodes have to overlap the screen MBR to be drawn.
+    CullView(const Eigen::Matrix4d &modelTrans,double nearPlane,const Point2d &frustLL,const Point2d &frustUR,
+             const Point2f &frameSize,const Mbr &screenMbr,const Eigen::Vector3f &eyeVec);
+
+    /// Model transform rows for X, Y and Z, relative to the origin
+    float rows[3][3];
+    /// Where the rows land for the origin
+    float rowOrigin[3];
+    /// Near the eye, so the projection doesn't lose precision close in
+    float origin[3];
+    /// Screen is scale * X/Z + offset
+    float scaleX,offsetX,scaleY,offsetY;
+    Mbr screenMbr;
+    Eigen::Vector3f eyeVec;
+};
+
+/** This is the top level of the culling tree.  It's used by the Scene
     for scenegraph culling.
+    Nodes are cubes in local space.  The four children of a node are allocated
+    together and their corners and normals are kept side by side, so a node's
+    children can be tested against the view all at once.
+    Drawables are referred to by their slot in the scene's draw list.
   */
 class CullTree
-{ 
-    friend class Cullable;
+{
 public:
     CullTree(WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth,int maxDrawPerNode = 8);
     ~CullTree();
     
-    Cullable *getTopCullable() { return topCullable; }
-    int getCount() { return numCullables; }
+    /// Add the drawable in the given draw list slot with its bounding box.
+    /// Drawables that can move (because they have a matrix) stay at the top.
+    /// The same drawable can be added more than once with different bounding boxes.
+    void addDrawable(int slot,const Mbr &localMbr,bool canMove);
     
-    /// Print stats out to the log
-    void dumpStats();
+    /// Remove everything we have for the given draw list slot
+    void remDrawable(int slot);
     
-protected:
-    CoordSystemDisplayAdapter *coordAdapter;
-    Cullable *topCullable;
-    int depth;
-    int maxDrawPerNode;
-    int numCullables;
-};
+    /// Find the draw list slots for the drawables that might be visible.
+    /// Each drawable shows up once.
+    /// The number of drawables looked at is added to considered.
+    void findDrawables(const CullView &view,std::vector<int> &slots,int *considered);
     
-/// Number of "corners" we used to define things in world space.
-#define WhirlyKitCullableCorners 8
-/// Number of normals we'll consider for backface culling calculations.
-#define WhirlyKitCullableCornerNorms 4
-
-/** This is a representation of cullable geometry.  It has
-    geometry/direction info and a list of associated
-    Drawables.
-    Cullables are always cubes in local space.
-    In general, users shouldn't use these.  Your drawables
-     will be sorted into them behind the scenes.
- */
-class Cullable : public Identifiable
-{
-public:
-    /// Construct recursively down to the given depth
-	Cullable(CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth);
-    ~Cullable();
-	
-	/// Add the given drawable to our set or the appropriate children
-	void addDrawable(CullTree *cullTree,Mbr localMbr,DrawableRef drawable);
-	
-	/// Remove a given drawable if it's there
-	void remDrawable(CullTree *cullTree,Mbr localMbr,DrawableRef drawable);
-	
-    /// Get the set of drawables associated with the cullable
-	const std::set<DrawableRef,IdentifiableRefSorter> &getDrawables() const { return drawables; }
+    /// Every draw list slot we have, visible or not
+    void getAllDrawables(std::vector<int> &slots);
     
-    /// Get the set of drawables for all the children.
-    /// We cache them in the parent nodes for speed
-	const std::set<DrawableRef,IdentifiableRefSorter> &getChildDrawables() const { return childDrawables; }
+    /// Number of nodes in use
+    int getCount() { return numNodes; }
     
-    /// Return true if there are any children
-    bool hasChildren() { return children[0] || children[1] || children[2] || children[3]; }
+protected:
+    /// Corners and normals for four sibling nodes
+    class NodeBlock
+    {
+    public:
+        float minX[4],minY[4],minZ[4];
+        float maxX[4],maxY[4],maxZ[4];
+        float normX[WhirlyKitCullableCornerNorms][4],normY[WhirlyKitCullableCornerNorms][4],normZ[WhirlyKitCullableCornerNorms][4];
+    };
     
-    /// Return true if there are no drawables here (or in children)
-    bool isEmpty() { return drawables.empty() && childDrawables.empty(); }
+    class Node
+    {
+    public:
+        /// Local coordinates for bounding box
+        Mbr localMbr;
+        /// Opposite of depth.  0 means go no lower
+        int height;
+        /// -1 for the top
+        int parent;
+        /// Block the children are in, or -1 if there are none
+        int childBlock;
+        /// Entries here and in all the children
+        int count;
+        /// Draw list slots for the entries here, along with the entries themselves
+        std::vector<int> slots;
+        std::vector<int> entries;
+    };
     
-    /// Return the Nth child.  Might be null.
-    Cullable *getChild(int which) { return children[which]; }
+    /// A drawable (or one of its bounding boxes) living in a node
+    class Entry
+    {
+    public:
+        int slot;
+        /// -1 if the entry is free
+        int node;
+        /// Position within the node's lists
+        int pos;
+        /// Next entry for the same slot
+        int next;
+        Mbr localMbr;
+        bool canMove;
+    };
     
-    /// Get the bounding box for this cullable
-	Mbr getMbr() const { return localMbr; }
-        
-    /// Count the number of nodes at and below this level
-    int countNodes() const;
-        
-public:	
-    Cullable *getOrAddChild(int which,CullTree *tree);
-    void possibleRemoveChild(int which,CullTree *tree);
-    void addDrawableToChildren(CullTree *cullTree,Mbr drawLocalMbr,DrawableRef draw);
-    void split(CullTree *);
+    int addBlock(int parent);
+    void setupBlock(int block);
+    void freeBlock(int block);
+    int newEntry(int slot,const Mbr &localMbr,bool canMove);
+    void freeEntry(int entry);
+    void attachEntry(int entry,int node);
+    void detachEntry(int entry);
+    void addEntry(int entry,int node);
+    void split(int node);
+    void collapse(int node);
+    void checkCollapse(int node);
+    static void testBlock(const NodeBlock &block,const CullView &view,bool checkBackfaces,bool inView[4],float area[4]);
+    void startMarks();
+    void addSlots(const Node &theNode,std::vector<int> &slots,int *considered);
+    void addSubtree(int node,std::vector<int> &slots,int *considered);
+    void findInChildren(int node,const CullView &view,bool checkBackfaces,float screenArea,std::vector<int> &slots,int *considered);
     
-    /// 3D locations (in model space) of the corners
-	Point3f cornerPoints[WhirlyKitCullableCorners];
-	/// Normal vectors (in model space) for the corners
-    Eigen::Vector3f cornerNorms[WhirlyKitCullableCornerNorms];
-    /// Opposite of depth.  0 means go no lower
-    int height;
-    /// Local coordinates for bounding box
-    Mbr localMbr;
-    /// Bounding boxes for each of the children
-    Mbr childMbr[4];
-	
-    Cullable *children[4];
-	std::set<DrawableRef,IdentifiableRefSorter> drawables;
-    std::set<DrawableRef,IdentifiableRefSorter> childDrawables;
+    CoordSystemDisplayAdapter *coordAdapter;
+    int maxDrawPerNode;
+    int numNodes;
+    std::vector<NodeBlock> blocks;
+    std::vector<Node> nodes;
+    std::vector<int> freeBlocks;
+    std::vector<Entry> entryList;
+    std::vector<int> freeEntries;
+    /// First entry for each draw list slot
+    std::vector<int> slotEntries;
+    /// Last time we collected each draw list slot
+    std::vector<unsigned int> slotMarks;
+    unsigned int curMark;
 };
 
 }
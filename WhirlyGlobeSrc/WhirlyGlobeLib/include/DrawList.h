@@ -0,0 +1,154 @@
+/*
+ *  DrawList.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <stdint.h>
+#import <vector>
+#import "Identifiable.h"
+
+namespace WhirlyKit
+{
+
+class Drawable;
+
+/** All the drawables in the scene, kept in the order we draw them.
+    Drawables are sorted on a key that packs in the draw priority, the z buffer
+    request, the program and the texture, so drawables that share state draw
+    next to each other.  The order is patched up as drawables come and go and
+    left alone on frames where nothing changed.
+    Each frame the renderer marks what's visible and we hand back the visible
+    drawables in order.  There's no set to build and nothing to sort.
+    We never look inside the drawables.  The keys and alpha come from the caller.
+    This isn't thread safe.  Use it on the rendering thread.
+  */
+class DrawList
+{
+public:
+    DrawList();
+
+    /// Pack up what we sort by.  Lower keys draw first.
+    /// The program and texture only group drawables within a priority, so we keep just the low bits of their IDs.
+    static uint64_t makeKey(unsigned int drawPriority,bool requestZBuffer,SimpleIdentity programID,SimpleIdentity texID);
+
+    /// Add a drawable with its key.  Returns the slot the drawable should hang on to.
+    int addDrawable(Drawable *draw,uint64_t key);
+
+    /// Remove the drawable in the given slot
+    void removeDrawable(int slot);
+
+    /// Forget everything
+    void clear();
+
+    /// Number of drawables we're keeping track of
+    int getNumDrawables() { return numDrawables; }
+
+    /// Return the drawable in the given slot, if there is one
+    Drawable *getDrawable(int slot) { return (slot >= 0 && (size_t)slot < slots.size()) ? slots[slot].draw : NULL; }
+
+    /// Start a new frame.  Nothing is visible until it's marked.
+    void startFrame();
+
+    /// Mark the drawable in the given slot as visible this frame.
+    /// A drawable can be visible once per pass, where a pass is usually one offset matrix.
+    /// The renderer's container for the drawable comes back in getDrawOrder().
+    /// The key is checked against the one we have and the drawable is moved if it changed.
+    /// Returns false if the drawable was already visible in this pass.
+    bool addVisible(int slot,int pass,uint64_t key,bool hasAlpha,int container);
+
+    /// Add a container for something that isn't in the list, like a generated drawable.  Just for this frame.
+    void addExtra(uint64_t key,bool hasAlpha,int container);
+
+    /// Return the containers marked this frame in draw order.
+    /// If alphaToEnd is set, everything with alpha comes after everything without.
+    void getDrawOrder(bool alphaToEnd,std::vector<int> &containers);
+
+protected:
+    class Slot
+    {
+    public:
+        Drawable *draw;
+        uint64_t key;
+        // Bumped whenever the key changes so we can spot old entries
+        unsigned int version;
+        // Last frame and pass we were visible in
+        unsigned int frame;
+        int pass;
+        bool hasAlpha;
+        // Chain of visible containers for this frame
+        int firstVisible,lastVisible;
+    };
+
+    class Entry
+    {
+    public:
+        Entry() { }
+        Entry(uint64_t key,int slot,unsigned int version) : key(key), slot(slot), version(version) { }
+        bool operator < (const Entry &that) const
+        {
+            if (key != that.key)
+                return key < that.key;
+            return slot < that.slot;
+        }
+        uint64_t key;
+        int slot;
+        unsigned int version;
+    };
+
+    class Visible
+    {
+    public:
+        int container;
+        int next;
+    };
+
+    class Extra
+    {
+    public:
+        bool operator < (const Extra &that) const
+        {
+            if (key != that.key)
+                return key < that.key;
+            return container < that.container;
+        }
+        uint64_t key;
+        bool hasAlpha;
+        int container;
+    };
+
+    bool isCurrent(const Entry &entry) const;
+    bool orderNeedsUpdate() const;
+    void updateOrder();
+    void appendVisible(bool checkAlpha,bool alpha,std::vector<int> &containers);
+
+    std::vector<Slot> slots;
+    std::vector<int> freeSlots;
+    // Sorted, though some entries may be out of date
+    std::vector<Entry> order;
+    // Entries that haven't been merged into the order yet
+    std::vector<Entry> added;
+    size_t numStale;
+    int numDrawables;
+    unsigned int frame;
+    // Slots marked visible this frame, put in draw order by getDrawOrder()
+    std::vector<int> visibleSlots;
+    std::vector<Visible> visible;
+    std::vector<Extra> extras;
+};
+
+}
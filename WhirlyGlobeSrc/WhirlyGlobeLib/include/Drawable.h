@@ -120,12 +120,16 @@ typedef std::map<SimpleIdentity,SimpleIdentity> TextureIDMap;
 class ChangeRequest
 {
 public:
-    ChangeRequest() : when(0.0) { }
+    ChangeRequest() : when(0.0), queueTime(0.0) { }
 	virtual ~ChangeRequest() { }
 		
     /// Return true if this change requires a GL Flush in the thread it was executed in
     virtual bool needsFlush() { return false; }
     
+    /// Rough number of bytes this will hand over to OpenGL when it runs.
+    /// The scene uses this to spread big batches over several frames.
+    virtual size_t estimatedSize() { return 0; }
+    
     /// Fill this in to set up whatever resources we need on the GL side
     virtual void setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *memManager) { };
 		
@@ -134,6 +138,9 @@ public:
     
     /// If non-zero we'll execute this request after the given absolute time
     NSTimeInterval when;
+    
+    /// When the scene queued this up.  Used for latency stats.
+    NSTimeInterval queueTime;
 };
     
 /// Representation of a list of changes.  Might get more complex in the future.
@@ -172,7 +179,7 @@ class Drawable : public Identifiable
 {
 protected:
     /// Used in special cases
-    Drawable() { }
+    Drawable() : drawListSlot(-1) { }
 public:
     /// Construct empty
 	Drawable(const std::string &name);
@@ -216,6 +223,18 @@ public:
     /// Check if we're supposed to write to the z buffer
     virtual bool getWriteZbuffer() const { return true; }
     
+    /// Texture this draws with, if any.  We use this to group drawables.
+    virtual SimpleIdentity getMainTexture() const { return EmptyIdentity; }
+    
+    /// Key the scene's draw list sorts this drawable on
+    uint64_t getDrawListKey() const;
+    
+    /// Where we are in the scene's draw list.  -1 if we're not in it.
+    int getDrawListSlot() const { return drawListSlot; }
+    
+    /// Set by the scene when we're added to the draw list
+    void setDrawListSlot(int slot) { drawListSlot = slot; }
+    
     /// Update anything associated with the renderer.  Probably renderUntil.
     virtual void updateRenderer(WhirlyKitSceneRendererES *renderer) = 0;
     
@@ -231,6 +250,7 @@ public:
 protected:
     std::string name;
     DrawableTweakerRefSet tweakers;
+    int drawListSlot;
 };
 
 /// Reference counted Drawable pointer
@@ -271,6 +291,16 @@ class SubTexture;
 
 /// Data types we'll accept for attributes
 typedef enum {BDFloat4Type,BDFloat3Type,BDChar4Type,BDFloat2Type,BDFloatType,BDIntType,BDDataTypeMax} BDAttributeDataType;
+
+/// The attribute data type a C++ type is stored as.  Only the types we store are filled in.
+template<typename T> class VertexAttributeType;
+template<> class VertexAttributeType<Eigen::Vector4f> { public: static const BDAttributeDataType dataType = BDFloat4Type; };
+template<> class VertexAttributeType<Eigen::Vector3f> { public: static const BDAttributeDataType dataType = BDFloat3Type; };
+template<> class VertexAttributeType<RGBAColor> { public: static const BDAttributeDataType dataType = BDChar4Type; };
+template<> class VertexAttributeType<Eigen::Vector2f> { public: static const BDAttributeDataType dataType = BDFloat2Type; };
+template<> class VertexAttributeType<TexCoord> { public: static const BDAttributeDataType dataType = BDFloat2Type; };
+template<> class VertexAttributeType<float> { public: static const BDAttributeDataType dataType = BDFloatType; };
+template<> class VertexAttributeType<int> { public: static const BDAttributeDataType dataType = BDIntType; };
     
     
 /// Used to keep track of attributes (other than points)
@@ -308,8 +338,14 @@ public:
     void addFloat(float val);
     /// Convenience routine to add an int (if the type matches)
     void addInt(int val);
-    
-    /// Reserve size in the data array
+    /// Add a run of 2D vectors at once (if the type matches)
+    void addVector2fs(const Eigen::Vector2f *vecs,int count);
+    /// Add a run of 3D vectors at once (if the type matches)
+    void addVector3fs(const Eigen::Vector3f *vecs,int count);
+    /// Add a run of values already in our data type.  count is in elements, not bytes.
+    void addValues(const void *vals,int count);
+    
+    /// Reserve size in the data array.  The memory comes out of a shared arena.
     void reserve(int size);
     
     /// Number of elements in our array
@@ -324,6 +360,20 @@ public:
     /// Return a pointer to the given element
     void *addressForElement(int which);
     
+    /// The data as an array of T.  Returns NULL if T isn't what we store or there's no data.
+    template<typename T> T *elements()
+    {
+        if (VertexAttributeType<T>::dataType != dataType || data.empty())
+            return NULL;
+        return (T *)&data[0];
+    }
+    template<typename T> const T *elements() const
+    {
+        if (VertexAttributeType<T>::dataType != dataType || data.empty())
+            return NULL;
+        return (const T *)&data[0];
+    }
+    
     /// Return the number of components as needed by glVertexAttribPointer
     GLuint glEntryComponents() const;
     
@@ -350,8 +400,11 @@ public:
         unsigned char color[4];
         int intVal;
     } defaultData;
-    /// std::vector of attribute data.  Type is known by the caller.
-    void *data;
+    /// Attribute data as bytes, one element after another, size() bytes each.
+    /// This is a separate array per attribute, recycled through an arena.  The
+    ///  attributes are only interleaved when they're copied into OpenGL.
+    /// Use elements() to get at it as the real type.
+    std::vector<unsigned char> data;
     /// Buffer offset within interleaved vertex
     GLuint buffer;
 };
@@ -0,0 +1,405 @@
+/*
+ *  FetchScheduler.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <string>
+#import <vector>
+#import <set>
+#import <map>
+#import <unordered_map>
+#import <functional>
+#import <mutex>
+#import <chrono>
+#import <algorithm>
+
+namespace WhirlyKit
+{
+
+/** Decides which network fetches go out and when.
+    Everyone asking for the same URL shares one fetch.  Fetches wait in a queue for
+    their host, most important first, and only so many can be out at once for any
+    one host or overall.  When no one wants a fetch anymore it comes out of the
+    queue, or gets cancelled if it's already out.
+    The scheduler doesn't do any networking itself.  It calls the start function it
+    was given when it's time for a fetch to go out, and the caller reports back with finish().
+    Thread safe.  None of the callbacks are called with the lock held.  This is plain C++.
+  */
+template<typename DataType>
+class FetchScheduler
+{
+public:
+    /// Handed back for each request.  0 is never used.
+    typedef unsigned long long RequestID;
+    /// One per distinct fetch, shared by the requests for the same URL
+    typedef unsigned long long FetchID;
+    /// Kick off the fetch.  Call finish() with the ID when it's done, from any thread.
+    typedef std::function<void (FetchID fetchID)> StartFunc;
+    /// Stop a fetch that's out.  Anything passed to finish() for it afterward is ignored.
+    typedef std::function<void (FetchID fetchID)> CancelFunc;
+    /// Called for each request when its fetch is done
+    typedef std::function<void (bool success,const DataType &data)> DoneFunc;
+
+    /// Counts since we were created
+    class Stats
+    {
+    public:
+        Stats() : numRequests(0), numFetches(0), numCoalesced(0), numCancelled(0), numQueued(0), numActive(0) { }
+        /// Requests made and fetches that actually went out
+        int numRequests,numFetches;
+        /// Requests that shared a fetch with an earlier one
+        int numCoalesced;
+        /// Requests that were cancelled before they finished
+        int numCancelled;
+        /// Fetches waiting and fetches out right now
+        int numQueued,numActive;
+    };
+
+    FetchScheduler(int maxPerHost = 6,int maxActive = 16)
+    : maxPerHost(maxPerHost), maxActive(maxActive), numActive(0), lastRequestID(0), lastFetchID(0), nextSeq(0), nextSample(0)
+    {
+    }
+
+    /// Called when a fetch that's already out isn't wanted anymore
+    void setCancelFunc(CancelFunc inCancelFunc)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelFunc = inCancelFunc;
+    }
+
+    /// Change how many fetches can be out at once
+    void setLimits(int inMaxPerHost,int inMaxActive)
+    {
+        std::vector<std::pair<FetchID,StartFunc> > toStart;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            maxPerHost = std::max(inMaxPerHost,1);
+            maxActive = std::max(inMaxActive,1);
+            dispatch(toStart);
+        }
+        runStarts(toStart);
+    }
+
+    /// Ask for a URL.  The start function is only used if no one else is already after the same URL.
+    /// Bigger importance goes first.
+    RequestID request(const std::string &url,const std::string &host,double importance,StartFunc start,DoneFunc done)
+    {
+        std::vector<std::pair<FetchID,StartFunc> > toStart;
+        RequestID requestID;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requestID = ++lastRequestID;
+            stats.numRequests++;
+
+            Fetch *fetch = NULL;
+            auto it = fetchesByURL.find(url);
+            if (it != fetchesByURL.end())
+            {
+                fetch = &fetches[it->second];
+                stats.numCoalesced++;
+            } else {
+                FetchID fetchID = ++lastFetchID;
+                fetch = &fetches[fetchID];
+                fetch->fetchID = fetchID;
+                fetch->url = url;
+                fetch->host = host;
+                fetch->start = start;
+                fetch->seq = nextSeq++;
+                fetch->importance = importance;
+                fetch->active = false;
+                fetchesByURL[url] = fetchID;
+                hosts[host].queue.insert(QueueEntry(fetch));
+            }
+
+            Waiter waiter;
+            waiter.requestID = requestID;
+            waiter.importance = importance;
+            waiter.done = done;
+            waiter.startTime = Clock::now();
+            fetch->waiters.push_back(waiter);
+            requests[requestID] = fetch->fetchID;
+            updateImportance(fetch);
+
+            dispatch(toStart);
+        }
+        runStarts(toStart);
+
+        return requestID;
+    }
+
+    /// Change the importance of a request that's waiting
+    bool setImportance(RequestID requestID,double importance)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Fetch *fetch = findFetch(requestID);
+        if (!fetch)
+            return false;
+        for (Waiter &waiter : fetch->waiters)
+            if (waiter.requestID == requestID)
+                waiter.importance = importance;
+        updateImportance(fetch);
+
+        return true;
+    }
+
+    /// Not interested in the answer anymore.  The done function won't be called.
+    bool cancel(RequestID requestID)
+    {
+        std::vector<std::pair<FetchID,StartFunc> > toStart;
+        CancelFunc theCancelFunc;
+        FetchID cancelID = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Fetch *fetch = findFetch(requestID);
+            if (!fetch)
+                return false;
+            requests.erase(requestID);
+            stats.numCancelled++;
+            for (auto it = fetch->waiters.begin();it != fetch->waiters.end();++it)
+                if (it->requestID == requestID)
+                {
+                    fetch->waiters.erase(it);
+                    break;
+                }
+
+            if (!fetch->waiters.empty())
+                updateImportance(fetch);
+            else {
+                // No one wants it, so get rid of it
+                if (fetch->active)
+                {
+                    cancelID = fetch->fetchID;
+                    theCancelFunc = cancelFunc;
+                }
+                removeFetch(fetch);
+                dispatch(toStart);
+            }
+        }
+        if (cancelID && theCancelFunc)
+            theCancelFunc(cancelID);
+        runStarts(toStart);
+
+        return true;
+    }
+
+    /// Report a fetch as done.  Everyone waiting on it gets the data.
+    void finish(FetchID fetchID,bool success,const DataType &data)
+    {
+        std::vector<std::pair<FetchID,StartFunc> > toStart;
+        std::vector<DoneFunc> toCall;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = fetches.find(fetchID);
+            if (it == fetches.end())
+                return;
+            Fetch *fetch = &it->second;
+            Clock::time_point now = Clock::now();
+            for (Waiter &waiter : fetch->waiters)
+            {
+                requests.erase(waiter.requestID);
+                toCall.push_back(waiter.done);
+                addSample(std::chrono::duration<double>(now - waiter.startTime).count());
+            }
+            removeFetch(fetch);
+            dispatch(toStart);
+        }
+        // Get the next ones going before we do anything else
+        runStarts(toStart);
+        for (DoneFunc &done : toCall)
+            done(success,data);
+    }
+
+    /// Counts so far
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Stats ret = stats;
+        ret.numActive = numActive;
+        ret.numQueued = (int)fetches.size() - numActive;
+        return ret;
+    }
+
+    /// Seconds between asking for something and getting it back.  fraction is 0.5 for the median, 0.99 for
+    /// the 99th percentile.  This covers the most recent requests.
+    double getTimeToData(double fraction)
+    {
+        std::vector<double> sorted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            sorted = samples;
+        }
+        if (sorted.empty())
+            return 0.0;
+        size_t which = std::min((size_t)(fraction * sorted.size()),sorted.size()-1);
+        std::nth_element(sorted.begin(),sorted.begin()+which,sorted.end());
+        return sorted[which];
+    }
+
+protected:
+    typedef std::chrono::steady_clock Clock;
+    // We keep track of time to data for this many requests
+    static const int MaxSamples = 4096;
+
+    // Someone waiting on a fetch
+    class Waiter
+    {
+    public:
+        RequestID requestID;
+        double importance;
+        DoneFunc done;
+        Clock::time_point startTime;
+    };
+
+    class Fetch
+    {
+    public:
+        FetchID fetchID;
+        std::string url,host;
+        StartFunc start;
+        std::vector<Waiter> waiters;
+        // Most important of the waiters
+        double importance;
+        // Order we got it in, to break ties
+        unsigned long long seq;
+        bool active;
+    };
+
+    // Sorts the most important to the front, then first come first served
+    class QueueEntry
+    {
+    public:
+        QueueEntry(const Fetch *fetch) : importance(fetch->importance), seq(fetch->seq), fetchID(fetch->fetchID) { }
+        bool operator < (const QueueEntry &that) const
+        {
+            if (importance != that.importance)
+                return importance > that.importance;
+            return seq < that.seq;
+        }
+        double importance;
+        unsigned long long seq;
+        FetchID fetchID;
+    };
+
+    class Host
+    {
+    public:
+        Host() : numActive(0) { }
+        int numActive;
+        std::set<QueueEntry> queue;
+    };
+
+    Fetch *findFetch(RequestID requestID)
+    {
+        auto it = requests.find(requestID);
+        if (it == requests.end())
+            return NULL;
+        auto fit = fetches.find(it->second);
+        return fit == fetches.end() ? NULL : &fit->second;
+    }
+
+    // Importance comes from the most important waiter.  Move it in the queue if it's waiting.
+    void updateImportance(Fetch *fetch)
+    {
+        double importance = fetch->waiters.empty() ? fetch->importance : fetch->waiters[0].importance;
+        for (const Waiter &waiter : fetch->waiters)
+            importance = std::max(importance,waiter.importance);
+        if (importance == fetch->importance)
+            return;
+        if (!fetch->active)
+        {
+            Host &host = hosts[fetch->host];
+            host.queue.erase(QueueEntry(fetch));
+            fetch->importance = importance;
+            host.queue.insert(QueueEntry(fetch));
+        } else
+            fetch->importance = importance;
+    }
+
+    void removeFetch(Fetch *fetch)
+    {
+        auto hit = hosts.find(fetch->host);
+        if (fetch->active)
+        {
+            numActive--;
+            hit->second.numActive--;
+        } else
+            hit->second.queue.erase(QueueEntry(fetch));
+        if (hit->second.numActive == 0 && hit->second.queue.empty())
+            hosts.erase(hit);
+        fetchesByURL.erase(fetch->url);
+        fetches.erase(fetch->fetchID);
+    }
+
+    // Send out as many fetches as the limits allow, most important first
+    void dispatch(std::vector<std::pair<FetchID,StartFunc> > &toStart)
+    {
+        while (numActive < maxActive)
+        {
+            Host *bestHost = NULL;
+            for (auto &it : hosts)
+            {
+                Host &host = it.second;
+                if (host.queue.empty() || host.numActive >= maxPerHost)
+                    continue;
+                if (!bestHost || *host.queue.begin() < *bestHost->queue.begin())
+                    bestHost = &host;
+            }
+            if (!bestHost)
+                break;
+
+            Fetch &fetch = fetches[bestHost->queue.begin()->fetchID];
+            bestHost->queue.erase(bestHost->queue.begin());
+            bestHost->numActive++;
+            numActive++;
+            fetch.active = true;
+            stats.numFetches++;
+            toStart.push_back(std::pair<FetchID,StartFunc>(fetch.fetchID,fetch.start));
+        }
+    }
+
+    void runStarts(std::vector<std::pair<FetchID,StartFunc> > &toStart)
+    {
+        for (auto &start : toStart)
+            start.second(start.first);
+    }
+
+    void addSample(double sample)
+    {
+        if (samples.size() < MaxSamples)
+            samples.push_back(sample);
+        else
+            samples[nextSample] = sample;
+        nextSample = (nextSample+1) % MaxSamples;
+    }
+
+    std::mutex mutex;
+    int maxPerHost,maxActive,numActive;
+    RequestID lastRequestID;
+    FetchID lastFetchID;
+    unsigned long long nextSeq;
+    CancelFunc cancelFunc;
+    std::unordered_map<FetchID,Fetch> fetches;
+    std::unordered_map<std::string,FetchID> fetchesByURL;
+    std::unordered_map<RequestID,FetchID> requests;
+    std::map<std::string,Host> hosts;
+    Stats stats;
+    std::vector<double> samples;
+    int nextSample;
+};
+
+}
@@ -46,9 +46,18 @@ public:
     /// Convert from WGS84 geocentric to local coordinates
     Point3f geocentricToLocal(Point3f);
     Point3d geocentricToLocal(Point3d);
+    
+    /// Batch versions
+    void localToGeographic(const Point3d *inPts,Point2d *outPts,int count);
+    void geographicToLocal(const Point2d *inPts,Point3d *outPts,int count);
+    void localToGeocentric(const Point3d *inPts,Point3d *outPts,int count);
+    void geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count);
         
     /// Return true if the other coordinate system is also Plate Carree
     bool isSameAs(CoordSystem *coordSys);
+    
+    /// Plate Carree is just lat/lon in radians
+    bool geocentricViaGeographic() { return true; }
 };
     
 /** Flat Earth refers to the MultiGen flat earth coordinate system.
@@ -75,8 +84,17 @@ public:
     Point3f geocentricToLocal(Point3f);
     Point3d geocentricToLocal(Point3d);
     
+    /// Batch versions
+    void localToGeographic(const Point3d *inPts,Point2d *outPts,int count);
+    void geographicToLocal(const Point2d *inPts,Point3d *outPts,int count);
+    void localToGeocentric(const Point3d *inPts,Point3d *outPts,int count);
+    void geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count);
+    
     /// Return true if the other coordinate system is Flat Earth with the same origin
     bool isSameAs(CoordSystem *coordSys);
+    
+    /// Flat Earth is an offset and scaled lat/lon
+    bool geocentricViaGeographic() { return true; }
 
     /// Return the origin
     GeoCoord getOrigin() const;
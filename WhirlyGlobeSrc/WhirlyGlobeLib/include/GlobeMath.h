@@ -45,18 +45,31 @@ public:
     /// Static version for convenience
     static Point3f LocalToGeocentric(Point3f);
     static Point3d LocalToGeocentric(Point3d);
+    /// Static batch version.  This is a single proj.4 call.  In and out can be the same.
+    static void LocalToGeocentric(const Point3d *inPts,Point3d *outPts,int count);
     /// Convert from WGS84 geocentric to local coordinates
     Point3f geocentricToLocal(Point3f);
     Point3d geocentricToLocal(Point3d);
     /// Static version for convenience
     static Point3f GeocentricToLocal(Point3f);
     static Point3d GeocentricToLocal(Point3d);
+    /// Static batch version.  This is a single proj.4 call.  In and out can be the same.
+    static void GeocentricToLocal(const Point3d *inPts,Point3d *outPts,int count);
+    
+    /// Batch versions
+    void localToGeographic(const Point3d *inPts,Point2d *outPts,int count);
+    void geographicToLocal(const Point2d *inPts,Point3d *outPts,int count);
+    void localToGeocentric(const Point3d *inPts,Point3d *outPts,int count);
+    void geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count);
     
     /// Convenience routine to convert a whole MBR to local coordinates
     static Mbr GeographicMbrToLocal(GeoMbr);
 
     /// Return true if the other coordinate system is also Geographic
     bool isSameAs(CoordSystem *coordSys);
+    
+    /// This is lat/lon, so it's trivially true
+    bool geocentricViaGeographic() { return true; }
 };
 
 /** The Fake Geocentric Display Adapter is used by WhirlyGlobe to represent
@@ -88,6 +101,11 @@ public:
     static Point3f DisplayToLocal(Point3f);
     static Point3d DisplayToLocal(Point3d);
     
+    /// Batch versions
+    virtual void localToDisplay(const Point3f *inPts,Point3f *outPts,int count);
+    virtual void localToDisplay(const Point3d *inPts,Point3d *outPts,int count);
+    virtual void displayToLocal(const Point3d *inPts,Point3d *outPts,int count);
+    
     /// Return a normal for the given point
     virtual Point3f normalForLocal(Point3f);
     virtual Point3d normalForLocal(Point3d);
@@ -129,6 +147,11 @@ public:
     static Point3f DisplayToLocal(Point3f);
     static Point3d DisplayToLocal(Point3d);
     
+    /// Batch versions
+    virtual void localToDisplay(const Point3f *inPts,Point3f *outPts,int count);
+    virtual void localToDisplay(const Point3d *inPts,Point3d *outPts,int count);
+    virtual void displayToLocal(const Point3d *inPts,Point3d *outPts,int count);
+    
     /// Return a normal for the given point
     virtual Point3f normalForLocal(Point3f);
     virtual Point3d normalForLocal(Point3d);
@@ -29,6 +29,7 @@
 #import "ScreenSpaceBuilder.h"
 #import "SelectionManager.h"
 #import "OverlapHelper.h"
+#import "ClusterIndex.h"
 
 namespace WhirlyKit
 {
@@ -103,6 +104,11 @@ public:
     WhirlyKit::Point2d offset;
     // Set if we changed something during evaluation
     bool changed;
+    
+    // Set if it passed the visibility checks on this round
+    bool visible;
+    // Where it was laid out and what the overlap pass decided, kept from round to round
+    LayoutPlacement placement;
 };
 
 typedef std::set<LayoutObjectEntry *,IdentifiableSorter> LayoutEntrySet;
@@ -159,6 +165,16 @@ public:
     we want to be drawn and it will figure out which ones should be visible
     and which shouldn't.
  
+    Objects in a cluster group go into a ClusterIndex for that group when they're
+    added or removed.  Each round we pick the level that matches the view and the
+    cluster marker size and ask for the clusters we can see.
+ 
+    Projection and culling run in parallel, as do the cluster groups.  Objects that
+    haven't moved more than a pixel or so keep the screen position they were laid out
+    with.  The overlap pass runs in importance order and reuses last round's answers
+    up to the first object that moved or changed, so the result only depends on
+    that order and where things are.
+ 
     This manager is entirely thread safe except for destruction.
   */
 class LayoutManager : public SceneManager
@@ -188,6 +204,9 @@ public:
     /// True if we've got changes since the last update
     bool hasChanges();
     
+    /// Changes every time the objects or their layout do
+    unsigned int getGeneration();
+    
     /// Return the active objects in a form the selection manager can handle
     void getScreenSpaceObjects(const SelectionManager::PlacementInfo &pInfo,std::vector<ScreenSpaceObjectLocation> &screenSpaceObjs);
     
@@ -195,8 +214,7 @@ public:
     void addClusterGenerator(ClusterGenerator *clusterGen);
     
 protected:
-    bool calcScreenPt(CGPoint &objPt,LayoutObjectEntry *layoutObj,WhirlyKitViewState *viewState,const Mbr &screenMbr,const Point2f &frameBufferSize);
-    Eigen::Matrix2d calcScreenRot(float &screenRot,WhirlyKitViewState *viewState,WhirlyGlobeViewState *globeViewState,ScreenSpaceObject *ssObj,const CGPoint &objPt,const Eigen::Matrix4d &modelTrans,const Eigen::Matrix4d &normalMat,const Point2f &frameBufferSize);
+    void buildClusterIndexes();
     bool runLayoutRules(WhirlyKitViewState *viewState,std::vector<ClusterEntry> &clusterEntries,std::vector<ClusterGenerator::ClusterClassParams> &clusterParams);
     
     pthread_mutex_t layoutLock;
@@ -204,6 +222,8 @@ protected:
     int maxDisplayObjects;
     /// If there were updates since the last layout
     bool hasUpdates;
+    /// Bumped whenever the objects or their layout change
+    unsigned int generation;
     /// Objects we're controlling the placement for
     LayoutEntrySet layoutObjects;
     /// Drawables created on the last round
@@ -214,6 +234,15 @@ protected:
     std::vector<ClusterGenerator::ClusterClassParams> clusterParams;
     /// Cluster generators
     ClusterGenerator *clusterGen;
+    /// Clustering index for each cluster group
+    std::map<int,ClusterIndex<LayoutObjectEntry *> > clusterIndexes;
+    /// Cluster groups that changed since we built their index
+    std::set<int> dirtyClusterGroups;
+    /// Order the overlap pass saw the objects in last time
+    std::vector<LayoutPlacement *> lastLayoutOrder;
+    /// Frame buffer size and scale from last time.  If these change we start over.
+    Point2f lastFrameBufferSize;
+    float lastResScale;
 };
 
 }
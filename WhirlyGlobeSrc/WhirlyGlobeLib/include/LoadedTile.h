@@ -123,6 +123,24 @@ typedef enum {WKTileScaleUp,WKTileScaleDown,WKTileScaleFixed,WKTileScaleNone} Wh
 namespace WhirlyKit
 {
     
+/** The parts of a tile's grid that only depend on the tessellation.
+    Every tile with the same sampling shares the same triangles and the
+    same texture coordinates (before scale and offset), so we build them once.
+  */
+class TileGridTemplate
+{
+public:
+    TileGridTemplate(int tessX,int tessY);
+    
+    /// Number of cells in each direction
+    int tessX,tessY;
+    /// Position of each vertex within the tile, [0,1] from the lower left, row major
+    std::vector<TexCoord> unitCoords;
+    /// Two triangles per cell
+    std::vector<BasicDrawable::Triangle> tris;
+};
+typedef std::shared_ptr<TileGridTemplate> TileGridTemplateRef;
+    
 /** The Tile Builder stores data needed to build individual tiles.
     This includes the texture and drawable atlases.
   */
@@ -144,6 +162,9 @@ public:
     // Build the edge matching skirt
     void buildSkirt(BasicDrawable *draw,std::vector<Point3d> &pts,std::vector<TexCoord> &texCoords,float skirtFactor,bool haveElev,const Point3d &theCenter);
     
+    // Return the shared grid for the given tessellation, building it if need be
+    TileGridTemplateRef getGridTemplate(int tessX,int tessY);
+    
     // Generate drawables for a no-elevation tile
     void generateDrawables(WhirlyKit::ElevationDrawInfo *drawInfo,BasicDrawable **draw,BasicDrawable **skirtDraw,BasicDrawable **poleDraw);
     
@@ -248,6 +269,10 @@ public:
     
     // Set if we're in single level mode.  That is, we're only trying to display a single level.
     bool singleLevel;
+    
+    // Grid templates, by tessellation
+    pthread_mutex_t gridTemplateLock;
+    std::map<std::pair<int,int>,TileGridTemplateRef> gridTemplates;
 };
     
 /** The Loaded Tile is used to track tiles that have been
@@ -329,13 +354,14 @@ public:
 };
 
 /// This is a comparison operator for sorting loaded tile pointers by
-/// Quadtree node identifier.
+/// Quadtree node identifier.  Tiles are kept in Morton order so
+/// a tile and everything under it are next to each other.
 typedef struct
 {
     /// Comparison operator based on node identifier
     bool operator() (const LoadedTile *a,const LoadedTile *b)
     {
-        return a->nodeInfo.ident < b->nodeInfo.ident;
+        return a->nodeInfo.ident.key() < b->nodeInfo.ident.key();
     }
 } LoadedTileSorter;
 
@@ -19,20 +19,11 @@
  */
 
 #import <math.h>
-#import <set>
-#import <map>
-#import "Identifiable.h"
-#import "BasicDrawable.h"
-#import "Scene.h"
-#import "SceneRendererES.h"
-#import "GlobeLayerViewWatcher.h"
-#import "ScreenSpaceBuilder.h"
-#import "SelectionManager.h"
+#import <vector>
+#import "WhirlyVector.h"
 
 namespace WhirlyKit
 {
-class LayoutObjectEntry;
-class LayoutObject;
     
 // We use this to avoid overlapping labels
 class OverlapHelper
@@ -43,7 +34,13 @@ public:
     // Try to add an object.  Might fail (kind of the whole point).
     bool addObject(const std::vector<Point2d> &pts);
     
+    // Add an object we already know fits, such as one laid out the same way last time
+    void placeObject(const std::vector<Point2d> &pts);
+    
 protected:
+    // Range of cells the given object covers
+    void calcCells(const std::vector<Point2d> &pts,int &sx,int &sy,int &ex,int &ey);
+    
     // Object and its bounds
     class BoundedObject
     {
@@ -59,69 +56,52 @@ protected:
     std::vector<std::vector<int> > grid;
 };
 
-// Used to figure out what clusters
-class ClusterHelper
+/** Where a layout object was on the screen when we laid it out and what the overlap
+    pass decided for it.  The layout manager keeps one of these per object from round
+    to round.  Plain C++, so layout_bench can run the same pass.
+  */
+class LayoutPlacement
 {
 public:
-    ClusterHelper(const Mbr &mbr,int sizeX, int sizeY, float resScale, const Point2d &clusterMarkerSize);
-    
-    // Add an object, possibly forming a group
-    void addObject(LayoutObjectEntry *objEntry,const std::vector<Point2d> &pts);
-
-    // Deal with cluster to cluster overlap
-    void resolveClusters();
+    LayoutPlacement();
     
-    // Single object with its bounds
-    class ObjectWithBounds
-    {
-    public:
-        ObjectWithBounds();
-        std::vector<Point2d> pts;
-        Point2d center;
-    };
+    /// Note where the object is this round.  If it's within a pixel or so of where it was
+    ///  laid out, we keep the old spot so the answer comes out the same.  Sets moved.
+    void update(const Point2d &newScreenPt,float newScreenRot,bool newInside,bool startOver);
     
-    // Simple object we're trying to cluster
-    class SimpleObject : public ObjectWithBounds
-    {
-    public:
-        SimpleObject();
-        LayoutObjectEntry *objEntry;
-        int parentObject;
-    };
+    /// It's not visible, so whatever we had doesn't count
+    void invalidate();
     
-    // Object we create when there are overlaps
-    class ClusterObject : public ObjectWithBounds
-    {
-    public:
-        ClusterObject();
-        std::vector<int> children;
-    };
-    
-    // List of objects for this cluster
-    void objectsForCluster(ClusterObject &cluster,std::vector<LayoutObjectEntry *> &layoutObjs);
-
-    // Add the given index to the cells it covers
-    void addToCells(const Mbr &mbr,int index);
-    
-    // Remove the given index from the cells it covers
-    void removeFromCells(const Mbr &mbr,int index);
-    
-    // Return all the objects within the overlap
-    void findObjectsWithin(const Mbr &mbr,std::set<int> &objSet);
-    
-    void calcCells(const Mbr &mbr,int &sx,int &sy,int &ex,int &ey);
-
-    Point2d clusterMarkerSize;
-    
-    Mbr mbr;
-    std::vector<SimpleObject> simpleObjects;
-    std::vector<ClusterObject> clusterObjects;
+    // Where it was on the screen (and if it was on the screen) the last time we laid it out
+    Point2d screenPt;
+    float screenRot;
+    bool inside;
+    bool valid;
+    // Set if it moved far enough since the last round that we have to lay it out again
+    bool moved;
+    // What the overlap pass decided, the offset it picked and the footprint it took up if it was on
+    bool active;
+    Point2d offset;
+    std::vector<Point2d> footprint;
+};
 
-    // Grid we're sorting into for fast lookup
-    int sizeX,sizeY;
-    float resScale;
-    Point2d cellSize;
-    std::vector<std::set<int> > grid;
+/// What the overlap pass needs to know about one object
+class LayoutOverlapObject
+{
+public:
+    LayoutPlacement *placement;
+    // Size and offset to use for laying out.  Empty means it takes up no room.
+    const std::vector<Point2d> *layoutPts;
+    // WhirlyKitLayoutPlacement flags
+    int acceptablePlacement;
 };
+
+/** Run the overlap checks over objects in importance order, filling in each one's active and offset.
+    Until we hit an object that moved or wasn't in the same spot in lastOrder, the answers are the
+    same as last round's, so we put those down without checking them.  Pass reuse as false to check
+    everything.  lastOrder is set to this round's order on the way out.
+  */
+void LayoutOverlapPass(const std::vector<LayoutOverlapObject> &order,std::vector<LayoutPlacement *> &lastOrder,bool reuse,
+                       int maxDisplayObjects,float resScale,const Mbr &screenMbr,int sampleX,int sampleY);
     
 }
@@ -0,0 +1,175 @@
+/*
+ *  PackedTileCache.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <stdint.h>
+#import <string>
+#import <vector>
+#import <map>
+#import <memory>
+#import <mutex>
+
+namespace WhirlyKit
+{
+
+/** On disk cache for tile data, packed into a handful of big files.
+    Tiles are appended to segment files, each of which tops out at around segmentSize.
+    Where each tile lives is kept in an index file we map into memory.  It's a hash
+    table keyed on the tile's level and the Morton code of its x and y, so a lookup
+    never touches the disk.  Each tile carries the time it was written, so checking
+    its age doesn't need a stat.
+    When the segments go over the byte budget we throw out the oldest segment.
+    Tiles in there that have been read since the last time around get copied
+    forward first, which gets us close enough to least recently used.
+    If we weren't shut down cleanly, the index is rebuilt from the segments.
+    Thread safe.  This is plain C++ on top of POSIX.
+  */
+class PackedTileCache
+{
+public:
+    PackedTileCache();
+    ~PackedTileCache();
+
+    /// Segments roll over at this size unless told otherwise
+    static const size_t DefaultSegmentSize = 16*1024*1024;
+
+    /// Byte budget the tile sources use unless told otherwise
+    static const size_t DefaultMaxBytes = 256*1024*1024;
+
+    /// Open or create a cache in the given directory.  We'll keep the segments under maxBytes.
+    bool open(const std::string &dir,size_t maxBytes,size_t segmentSize = DefaultSegmentSize);
+
+    /// Write everything out and close the files
+    void close();
+
+    /// True if open() worked
+    bool isOpen();
+
+    /// Return the cache for the given directory, opening it if no one else has.
+    /// Only one cache can safely use a directory, so tile sources should share through here.
+    static std::shared_ptr<PackedTileCache> cacheForDir(const std::string &dir,size_t maxBytes);
+
+    /// True if we've got the tile and it's no older than maxAge seconds (0 for any age)
+    bool contains(int level,int x,int y,double maxAge = 0.0);
+
+    /// Read a tile into data.  Returns false if it's missing or older than maxAge seconds (0 for any age).
+    bool read(int level,int x,int y,std::vector<unsigned char> &data,double maxAge = 0.0);
+
+    /// Add a tile, replacing what was there
+    bool write(int level,int x,int y,const void *data,size_t size);
+
+    /// Forget about a tile
+    bool remove(int level,int x,int y);
+
+    /// Push the index out to disk and mark it as good
+    void flush();
+
+    /// Number of tiles we can find
+    size_t getNumTiles();
+
+    /// Bytes in the segment files, including space for tiles that have since been replaced
+    size_t getNumBytes();
+
+    /// Level in the top bits, then x and y interleaved
+    static uint64_t tileKey(int level,int x,int y);
+
+    /// Seconds since 1970, which is what the tiles are stamped with
+    static double currentTime();
+
+protected:
+    // One slot in the index
+    typedef struct
+    {
+        uint64_t key;
+        double timeStamp;
+        uint32_t segment;
+        uint32_t offset;
+        uint32_t size;
+        uint32_t flags;
+    } IndexEntry;
+
+    // Start of the index file
+    typedef struct
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t capacity;
+        uint32_t count;
+        uint32_t removed;
+        uint32_t clean;
+        uint32_t pad[10];
+    } IndexHeader;
+
+    // In front of each tile in a segment
+    typedef struct
+    {
+        uint32_t magic;
+        uint32_t size;
+        uint64_t key;
+        double timeStamp;
+    } RecordHeader;
+
+    // Open segment file.  Readers hang on to this so the file stays open while they use it.
+    class SegmentFile
+    {
+    public:
+        SegmentFile(int fd) : fd(fd) { }
+        ~SegmentFile();
+        int fd;
+    };
+    typedef std::shared_ptr<SegmentFile> SegmentFileRef;
+
+    class Segment
+    {
+    public:
+        Segment() : size(0) { }
+        SegmentFileRef file;
+        size_t size;
+    };
+
+    std::string segmentName(uint32_t which);
+    bool openSegments();
+    bool addSegment();
+    bool mapIndex(const std::string &fileName,uint32_t capacity,bool create);
+    void unmapIndex();
+    bool rebuildIndex();
+    bool reserveEntry();
+    bool resizeIndex(uint32_t capacity);
+    IndexEntry *findEntry(uint64_t key);
+    IndexEntry *addEntry(uint64_t key);
+    void removeEntry(IndexEntry *entry);
+    bool appendRecord(uint64_t key,double timeStamp,const void *data,uint32_t size,uint32_t &segment,uint32_t &offset);
+    bool addRecord(uint64_t key,double timeStamp,const void *data,uint32_t size);
+    void evict();
+    void markDirty();
+    void flushLocked();
+
+    std::mutex mutex;
+    std::string dir;
+    size_t maxBytes,segmentSize,numBytes;
+    int writesSinceFlush;
+    std::map<uint32_t,Segment> segments;
+    int indexFD;
+    void *indexMap;
+    size_t indexMapSize;
+    IndexHeader *header;
+    IndexEntry *entries;
+};
+
+}
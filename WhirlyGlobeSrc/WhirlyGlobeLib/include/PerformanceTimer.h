@@ -18,17 +18,25 @@
  *
  */
 
-#import <Foundation/Foundation.h>
 #import <string>
 #import <map>
+#import <vector>
+#import <chrono>
+#import "Telemetry.h"
 
 namespace WhirlyKit
 {
     
-/// Simple performance timing class
+/// Simple performance timing class.
+/// This is plain C++ so it can time things off the device too.
+/// Timings and counts by TelemetryID also go to Telemetry and skip the string lookups.
 class PerformanceTimer
 {
 public:
+    /// Seconds, like NSTimeInterval
+    typedef double TimeInterval;
+    
+
     /// Used to track a category of timing
     class TimeEntry
     {
@@ -37,10 +45,10 @@ public:
         TimeEntry & operator = (const TimeEntry &that);
         bool operator < (const TimeEntry &that) const;
         
-        void addTime(NSTimeInterval dur);
+        void addTime(TimeInterval dur);
         
         std::string name;
-        NSTimeInterval minDur,maxDur,avgDur;
+        TimeInterval minDur,maxDur,avgDur;
         int numRuns;
     };
     
@@ -67,16 +75,38 @@ public:
     /// Add a count for a particular instance
     void addCount(const std::string &what,int count);
     
+    /// Start timing a span registered with Telemetry
+    void startTiming(TelemetryID spanID);
+    
+    /// Stop timing a span and record it here and with Telemetry
+    void stopTiming(TelemetryID spanID);
+    
+    /// Add a count for a counter registered with Telemetry
+    void addCount(TelemetryID counterID,int count);
+    
     /// Clean out existing timings
     void clear();
     
-    /// Write out the timings to NSLog
+    /// Write out the timings to NSLog (or stdout, off the device)
     void log();
     
+    /// Timings we've got, sorted by average duration, longest first
+    void getTimeEntries(std::vector<TimeEntry> &entries);
+    
+    /// Counts we've got, sorted by name
+    void getCountEntries(std::vector<CountEntry> &entries);
+    
 protected:
-    std::map<std::string,NSTimeInterval> actives;
+    /// Seconds from a steady clock
+    static TimeInterval getTime();
+    
+    std::map<std::string,TimeInterval> actives;
     std::map<std::string,TimeEntry> timeEntries;
     std::map<std::string,CountEntry> countEntries;
+    // Indexed by TelemetryID, start of zero means it's not running
+    std::vector<uint64_t> idStarts;
+    std::vector<TimeEntry> idTimeEntries;
+    std::vector<CountEntry> idCountEntries;
 };
     
 }
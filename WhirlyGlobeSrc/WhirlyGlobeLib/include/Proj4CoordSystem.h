@@ -48,6 +48,12 @@ public:
     Point3f geocentricToLocal(Point3f);
     Point3d geocentricToLocal(Point3d);
     
+    /// Batch versions.  Each of these is a single proj.4 call.
+    void localToGeographic(const Point3d *inPts,Point2d *outPts,int count);
+    void geographicToLocal(const Point2d *inPts,Point3d *outPts,int count);
+    void localToGeocentric(const Point3d *inPts,Point3d *outPts,int count);
+    void geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count);
+    
     /// True if the other system is Spherical Mercator with the same origin
     virtual bool isSameAs(CoordSystem *coordSys);
     
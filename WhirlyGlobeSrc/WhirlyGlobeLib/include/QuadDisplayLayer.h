@@ -87,6 +87,11 @@ public:
 /// Called when the view state changes.  If you're caching info, do it here.
 - (void)newViewState:(WhirlyKitViewState *)viewState;
 
+/// Fill in the importance for a batch of tiles.  Each should be the same as
+/// importanceForTile:mbr:viewInfo:frameSize:attrs: would return.
+/// Implement this if you can do a batch faster, with the batch version of ScreenImportance for instance.
+- (void)importanceForTiles:(std::vector<WhirlyKit::Quadtree::ImportanceRequest> &)requests viewInfo:(WhirlyKitViewState *)viewState frameSize:(WhirlyKit::Point2f)frameSize;
+
 @end
 
 /** Loader protocol for quad tree changes.  Fill this in to be
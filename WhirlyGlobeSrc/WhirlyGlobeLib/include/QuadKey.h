@@ -0,0 +1,142 @@
+/*
+ *  QuadKey.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <stdint.h>
+#import <stddef.h>
+
+namespace WhirlyKit
+{
+
+/** A quad tree tile (x,y,level) packed into a single 64 bit value.
+    The x and y bits are interleaved (Morton order) starting from the top of the
+    word, followed by a single marker bit.  The position of the marker gives the level.
+    Sorting on the value keeps every subtree in one contiguous range, with the
+    parent in the middle of its children.
+    This is plain C++ so the offline tools can use it too.
+  */
+class QuadKey
+{
+public:
+    /// Deepest level we can represent
+    static const int MaxLevel = 30;
+
+    /// Constructs an invalid key
+    constexpr QuadKey() : value(0) { }
+    /// Construct from a value returned by getValue()
+    explicit constexpr QuadKey(uint64_t value) : value(value) { }
+    /// Construct with the cell coordinates and level.  Level 0 is the top.
+    constexpr QuadKey(int x,int y,int level)
+        : value((interleave((uint32_t)x,(uint32_t)y) << (2*(MaxLevel-level)+1)) | lsbForLevel(level)) { }
+
+    /// The raw 64 bit value.  This is what we store and compare.
+    constexpr uint64_t getValue() const { return value; }
+    /// True unless this was default constructed or came from an invalid neighbor()
+    constexpr bool isValid() const { return value != 0; }
+
+    /// Level of detail, 0 at the top
+    constexpr int level() const { return MaxLevel - (int)(__builtin_ctzll(value) >> 1); }
+    /// Cell along the X axis
+    constexpr int x() const { return (int)compact(morton()); }
+    /// Cell along the Y axis
+    constexpr int y() const { return (int)compact(morton() >> 1); }
+
+    /// The tile one level up.  Don't call this on level 0.
+    constexpr QuadKey parent() const { return QuadKey((value & (~(lsb() << 2) + 1)) | (lsb() << 2)); }
+    /// One of the four tiles one level down.  Child i is (2x + (i&1), 2y + (i>>1)).
+    constexpr QuadKey child(int which) const { return QuadKey(value - lsb() + (2*(uint64_t)which+1) * (lsb() >> 2)); }
+    /// Tile one level down by relative position (0 or 1 in each direction)
+    constexpr QuadKey child(int dx,int dy) const { return child(dx + 2*dy); }
+    /// Tile on the same level offset by dx,dy.  Returns an invalid key if that's off the edge.
+    constexpr QuadKey neighbor(int dx,int dy) const
+    {
+        return (x()+dx < 0 || y()+dy < 0 || x()+dx >= (1<<level()) || y()+dy >= (1<<level())) ? QuadKey() : QuadKey(x()+dx,y()+dy,level());
+    }
+
+    /// Smallest value of anything in this subtree
+    constexpr uint64_t rangeMin() const { return value - lsb() + 1; }
+    /// Largest value of anything in this subtree
+    constexpr uint64_t rangeMax() const { return value + lsb() - 1; }
+    /// True if the given tile is this one or underneath it
+    constexpr bool contains(const QuadKey &that) const { return that.value >= rangeMin() && that.value <= rangeMax(); }
+
+    /// Well mixed hash for open addressing and unordered containers
+    constexpr uint64_t hash() const { return mixStep(mixStep(mixStep(value,33) * 0xFF51AFD7ED558CCDULL,33) * 0xC4CEB9FE1A85EC53ULL,33); }
+
+    /// Index used by the quadindex columns in our sqlite tile stores.
+    /// That's every tile above this level, then row major within the level.
+    constexpr long long quadIndex() const
+    {
+        return (long long)((((uint64_t)1 << 2*level()) - 1) / 3) + (long long)y() * (1LL << level()) + x();
+    }
+    /// Go the other way from a quadindex column
+    static QuadKey fromQuadIndex(long long quadIndex)
+    {
+        int level = 0;
+        long long levelSize = 1;
+        while (level < MaxLevel && quadIndex >= levelSize)
+        {
+            quadIndex -= levelSize;
+            levelSize *= 4;
+            level++;
+        }
+        long long rowSize = 1LL << level;
+        return QuadKey((int)(quadIndex % rowSize),(int)(quadIndex / rowSize),level);
+    }
+
+    constexpr bool operator == (const QuadKey &that) const { return value == that.value; }
+    constexpr bool operator != (const QuadKey &that) const { return value != that.value; }
+    constexpr bool operator < (const QuadKey &that) const { return value < that.value; }
+    constexpr bool operator > (const QuadKey &that) const { return value > that.value; }
+    constexpr bool operator <= (const QuadKey &that) const { return value <= that.value; }
+    constexpr bool operator >= (const QuadKey &that) const { return value >= that.value; }
+
+    /// Hash functor for std::unordered_map and friends
+    typedef struct
+    {
+        size_t operator() (const QuadKey &key) const { return (size_t)key.hash(); }
+    } Hasher;
+
+protected:
+    // Lowest set bit, which is the level marker
+    constexpr uint64_t lsb() const { return value & (~value + 1); }
+    // Just the interleaved x,y bits, right aligned
+    constexpr uint64_t morton() const { return value >> (__builtin_ctzll(value) + 1); }
+
+    static constexpr uint64_t lsbForLevel(int level) { return (uint64_t)1 << 2*(MaxLevel-level); }
+    static constexpr uint64_t interleave(uint32_t x,uint32_t y) { return spread(x) | (spread(y) << 1); }
+    // Move the low 32 bits to the even bits
+    static constexpr uint64_t spread(uint64_t v)
+    {
+        return spreadStep(spreadStep(spreadStep(spreadStep(spreadStep(v & 0xFFFFFFFFULL,16,0x0000FFFF0000FFFFULL),8,0x00FF00FF00FF00FFULL),4,0x0F0F0F0F0F0F0F0FULL),2,0x3333333333333333ULL),1,0x5555555555555555ULL);
+    }
+    static constexpr uint64_t spreadStep(uint64_t v,int shift,uint64_t mask) { return (v | (v << shift)) & mask; }
+    // Gather the even bits back into the low 32
+    static constexpr uint64_t compact(uint64_t v)
+    {
+        return compactStep(compactStep(compactStep(compactStep(compactStep(v & 0x5555555555555555ULL,1,0x3333333333333333ULL),2,0x0F0F0F0F0F0F0F0FULL),4,0x00FF00FF00FF00FFULL),8,0x0000FFFF0000FFFFULL),16,0x00000000FFFFFFFFULL);
+    }
+    static constexpr uint64_t compactStep(uint64_t v,int shift,uint64_t mask) { return (v | (v >> shift)) & mask; }
+    // Murmur3 finalizer step
+    static constexpr uint64_t mixStep(uint64_t v,int shift) { return v ^ (v >> shift); }
+
+    uint64_t value;
+};
+
+}
@@ -20,6 +20,7 @@
 
 #import <Foundation/Foundation.h>
 #import "WhirlyVector.h"
+#import "QuadKey.h"
 #import <set>
 
 /// @cond
@@ -57,6 +58,9 @@ public:
         /// Quality operator
         bool operator == (const Identifier &that) const;
         
+        /// Morton coded version, which is what we hash and sort on
+        QuadKey key() const { return QuadKey(x,y,level); }
+        
         /// Spatial subdivision along the X axis relative to the space
         int x;
         /// Spatial subdivision along tye Y axis relative to the space
@@ -65,15 +69,13 @@ public:
         int level;
     };
 
-    /// Quad tree node with bounding box and importance, which is possibly screen size
+    /// Quad tree node with bounding box and importance, which is possibly screen size.
+    /// This is plain data and cheap to copy.  Per-tile attributes live with the node, see getAttrs().
     class NodeInfo
     {
     public:
-        NodeInfo() { attrs = [NSMutableDictionary dictionary]; phantom = false;  importance = 0; frameLoadingFlags = 0; childrenLoading = 0; childrenEval = 0; eval = false; failed = false; childCoverage = false; frameFlags = 0;}
-        NodeInfo(const NodeInfo &that) : ident(that.ident), mbr(that.mbr), importance(that.importance),phantom(that.phantom),frameLoadingFlags(that.frameLoadingFlags),childrenLoading(that.childrenLoading),eval(that.eval), failed(that.failed), childrenEval(that.childrenEval), childCoverage(that.childCoverage), frameFlags(that.frameFlags) { attrs = nil; if (that.attrs) attrs = [NSMutableDictionary dictionaryWithDictionary:that.attrs]; }
-        NodeInfo(const Identifier &ident) : ident(ident), importance(0.0), phantom(false), frameLoadingFlags(0), eval(false), failed(false), childrenLoading(0), childrenEval(0), childCoverage(false), frameFlags(0) { attrs = nil; }
-        NodeInfo & operator = (const NodeInfo &that) { ident = that.ident;  mbr = that.mbr;  importance = that.importance;  phantom = that.phantom; frameLoadingFlags = that.frameLoadingFlags; eval = that.eval;  failed = that.failed; childrenLoading = that.childrenLoading; childrenEval = that.childrenEval;  childCoverage = that.childCoverage; frameFlags = that.frameFlags; attrs = nil; if (that.attrs) attrs = [NSMutableDictionary dictionaryWithDictionary:that.attrs]; return *this; }
-        ~NodeInfo() { attrs = nil; }
+        NodeInfo() : importance(0.0), phantom(false), eval(false), failed(false), childrenLoading(0), childrenEval(0), childCoverage(false), frameFlags(0), frameLoadingFlags(0) { }
+        NodeInfo(const Identifier &ident) : ident(ident), importance(0.0), phantom(false), eval(false), failed(false), childrenLoading(0), childrenEval(0), childCoverage(false), frameFlags(0), frameLoadingFlags(0) { }
         
         /// Compare based on importance.  Used for sorting
         bool operator < (const NodeInfo &that) const;
@@ -109,10 +111,22 @@ public:
         long long frameFlags;
         /// 64 bits of frame loading flags
         long long frameLoadingFlags;
-
-        /// Put any attributes you'd like to keep track of here.
-        /// There are things you might calculate for a given tile over and over.
+    };
+    
+    /// A tile to be scored.  These go to the importance delegate in batches.
+    class ImportanceRequest
+    {
+    public:
+        ImportanceRequest() : importance(0.0) { }
+        
+        /// Tile we want the importance for
+        Identifier ident;
+        /// Its bounding box
+        Mbr mbr;
+        /// Attributes kept with the node, same as for a single tile
         NSMutableDictionary *attrs;
+        /// Filled in by the delegate
+        double importance;
     };
 
     /// Check if the given tile is already present
@@ -175,19 +189,31 @@ public:
     /// Look for children of this tile being evaluated
     bool childrenEvaluating(const Identifier &ident);
     
-    /// Recalculate the importance of everything.  This calls the callback.
-    void reevaluateNodes();
+    /// Recalculate the importance of everything.  This calls the delegate, all in one batch if it can take one.
+    /// If nothing the importance depends on has changed, pass false to keep the existing
+    /// importance and just rebuild the sorting and coverage.
+    void reevaluateNodes(bool rescore=true);
     
     /// Given an identifier, fill out the node info such as
-    /// MBR and importance.
-    NodeInfo generateNode(const Identifier &ident);
+    /// MBR and importance.  The attributes are handed to the importance delegate.
+    /// If you don't pass any in, it gets a scratch dictionary.
+    NodeInfo generateNode(const Identifier &ident,NSMutableDictionary *attrs=nil);
     
     /// Return the node info for a given node
     const NodeInfo *getNodeInfo(const Identifier &ident);
     
+    /// Attributes you'd like to keep track of for a given node.
+    /// There are things you might calculate for a given tile over and over.
+    /// These last as long as the node does.  Returns nil if the node isn't here.
+    NSMutableDictionary *getAttrs(const Identifier &ident);
+    
     /// Add the given tile, without looking for any to remove.  This is probably a phantom.
     const Quadtree::NodeInfo *addTile(const Identifier &ident,bool newEval,bool checkImportance,std::vector<Identifier> &newlyCoveredTiles);
     
+    /// Add a group of tiles, in order.  Same as calling addTile() on each,
+    /// but the new ones are scored together in one batch.
+    void addTiles(const std::vector<Identifier> &idents,bool newEval,bool checkImportance,std::vector<Identifier> &newlyCoveredTiles);
+    
     /// Explicitly remove a given tile
     void removeTile(const Identifier &which);
     
@@ -239,35 +265,95 @@ public:
 protected:
     class Node;
 
-    // Sorter based on id
-    typedef struct
+    /** Open addressing hash table from identifier to node.
+        Linear probing with backward shift deletion, so there are no tombstones.
+      */
+    class NodeTable
     {
-        bool operator() (const Node *a,const Node *b)
+    public:
+        NodeTable();
+        
+        /// Look for the node with the given identifier
+        Node *find(const Identifier &ident) const;
+        /// Add a node.  Returns false if it was already there.
+        bool insert(Node *node);
+        /// Remove the node with the given identifier, if it's there
+        void erase(const Identifier &ident);
+        /// Forget everything.  Doesn't delete the nodes.
+        void clear();
+        
+        /// Number of nodes in the table
+        int size() const { return count; }
+        bool empty() const { return count == 0; }
+        
+        /// Walk the slots to visit every node.  Empty slots are NULL.
+        int numSlots() const { return (int)slots.size(); }
+        Node *slot(int which) const { return slots[which].node; }
+        
+    protected:
+        typedef struct
         {
-            return a->nodeInfo.ident < b->nodeInfo.ident;
-        }
-    } NodeIdentSorter;
+            uint64_t key;
+            Node *node;
+        } Slot;
+        
+        void grow();
+
+        std::vector<Slot> slots;
+        unsigned int mask;
+        int count;
+    };
 
-    // Sorter based on node importance
-    typedef struct
+    /** Binary heap of nodes sorted on importance (then identifier).
+        Each node remembers its own position, so we can take it out or check for it
+        without a search.  Nodes can be in the heap at most once.
+      */
+    class NodeHeap
     {
-        bool operator() (const Node *a,const Node *b)
-        {
-            if (a->nodeInfo.importance == b->nodeInfo.importance)
-                return a->nodeInfo.ident < b->nodeInfo.ident;
-            return a->nodeInfo.importance < b->nodeInfo.importance;
-        }
-    } NodeSizeSorter;
+    public:
+        /// Position is tracked in the given Node field.  The top is either the smallest or largest node.
+        NodeHeap(int Node::*posField,bool largestFirst);
+        
+        bool empty() const { return nodes.empty(); }
+        int size() const { return (int)nodes.size(); }
+        bool contains(const Node *node) const;
+        
+        /// The first node in the sort order.  Don't call this if it's empty.
+        Node *top() const { return nodes[0]; }
+        /// Node at the given heap position.  Children of ii are at 2*ii+1 and 2*ii+2.
+        Node *at(int which) const { return nodes[which]; }
+        /// True if a comes before b in the sort order
+        bool before(const Node *a,const Node *b) const;
+        
+        /// Add a node if it isn't already there
+        void insert(Node *node);
+        /// Remove a node if it's there
+        void erase(Node *node);
+        /// Remove everything
+        void clear();
+        
+        /// Add a node without sorting.  Call rebuild() after a batch of these.
+        void append(Node *node);
+        /// Put the heap back in order, all at once
+        void rebuild();
+        
+    protected:
+        void place(int which,Node *node);
+        void siftUp(int which);
+        void siftDown(int which);
 
-    typedef std::set<Node *,NodeIdentSorter> NodesByIdentType;
-    typedef std::set<Node *,NodeSizeSorter> NodesBySizeType;
+        std::vector<Node *> nodes;
+        int Node::*posField;
+        bool largestFirst;
+    };
 
     /// Single quad tree node with pointer to parent and children
     class Node
     {
         friend class Quadtree;
+        friend class NodeHeap;
     public:
-        Node(Quadtree *tree);
+        Node();
         
         NodeInfo nodeInfo;
         
@@ -281,16 +367,22 @@ protected:
         bool recalcCoverage();
         
     protected:
-        NodesByIdentType::iterator identPos;
-        NodesBySizeType::iterator sizePos;
-        NodesBySizeType::iterator evalPos;
+        // Position in nodesBySize and evalNodes, or -1
+        int sizePos;
+        int evalPos;
         Node *parent;
         Node *children[4];
         bool childOffscreen[4];
+        /// Attributes the delegates keep for this node
+        NSMutableDictionary *attrs;
     };
         
     Node *getNode(const Identifier &ident);
     void removeNode(Node *);
+    /// Add a tile.  If it's new and already scored, pass in the score.
+    const NodeInfo *addTile(const Identifier &ident,bool newEval,bool checkImportance,std::vector<Identifier> &newlyCoveredTiles,const ImportanceRequest *scored);
+    /// Fill in the importance for a batch of tiles, through the delegate
+    void scoreTiles(std::vector<ImportanceRequest> &requests);
     /// Recalculate child coverage for a node and its parents
     void recalcCoverage(Node *node);
     /// Add an entry for the given flag index
@@ -305,14 +397,20 @@ protected:
     int numPhantomNodes;
     /// Used to calculate importance for a particular 
     NSObject<WhirlyKitQuadTreeImportanceDelegate> * __weak importDelegate;
-    
-    // All nodes, sorted by ID
-    NodesByIdentType nodesByIdent;
-    // Child nodes, sorted by importance
-    NodesBySizeType nodesBySize;
-    // Nodes we're evaluating
-    NodesBySizeType evalNodes;
+    /// Set if the delegate can score tiles in batches
+    bool batchImportance;
+    
+    // All nodes, by ID
+    NodeTable nodesByIdent;
+    // Child nodes, least important on top
+    NodeHeap nodesBySize;
+    // Nodes we're evaluating, most important on top
+    NodeHeap evalNodes;
     std::vector<int> frameLoadCounts;
+    // Scratch space for walking nodesBySize in order
+    std::vector<int> walkHeap;
+    // Scratch space for scoring
+    std::vector<ImportanceRequest> importRequests;
 };
 
 }
@@ -322,5 +420,10 @@ protected:
 /// Return a number signifying importance.  MAXFLOAT is very important, 0 is not at all.
 /// 0 also means the tile is off screen
 - (double)importanceForTile:(WhirlyKit::Quadtree::Identifier)ident mbr:(WhirlyKit::Mbr)mbr tree:(WhirlyKit::Quadtree *)tree attrs:(NSMutableDictionary *)attrs;
+
+@optional
+/// Fill in the importance for a whole batch of tiles at once.
+/// Each one should come out the same as importanceForTile:mbr:tree:attrs: would give it.
+- (void)importanceForTiles:(std::vector<WhirlyKit::Quadtree::ImportanceRequest> &)requests tree:(WhirlyKit::Quadtree *)tree;
 @end
 
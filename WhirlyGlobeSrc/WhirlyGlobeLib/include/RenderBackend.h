@@ -0,0 +1,155 @@
+/*
+ *  RenderBackend.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <stddef.h>
+#import <stdint.h>
+#import <unordered_map>
+#import "Identifiable.h"
+
+namespace WhirlyKit
+{
+
+/// Primitives we can draw
+typedef enum {RenderTriangles,RenderTriangleStrip,RenderLines,RenderPoints} RenderPrimitiveType;
+
+/** What the renderer needs from the graphics API to get a frame out.
+    Buffers and textures are referred to by the IDs the backend hands back.
+    Nothing in the library draws through this yet.  The OpenGL ES renderers
+    still talk to GL directly.  It's for tools like scene_driver that time
+    the plain C++ parts of the frame without a GPU.
+  */
+class RenderBackend
+{
+public:
+    virtual ~RenderBackend() { }
+
+    /// Start a frame of the given size
+    virtual void startFrame(int width,int height) = 0;
+
+    /// Make a buffer with size bytes of data.  The data can be NULL.
+    virtual unsigned int createBuffer(const void *data,size_t size) = 0;
+
+    /// Replace part of an existing buffer
+    virtual void updateBuffer(unsigned int bufID,size_t offset,const void *data,size_t size) = 0;
+
+    /// Get rid of a buffer
+    virtual void deleteBuffer(unsigned int bufID) = 0;
+
+    /// Make a texture.  The data can be NULL.
+    virtual unsigned int createTexture(int width,int height,int bytesPerPixel,const void *data) = 0;
+
+    /// Replace part of an existing texture
+    virtual void updateTexture(unsigned int texID,int x,int y,int width,int height,int bytesPerPixel,const void *data) = 0;
+
+    /// Get rid of a texture
+    virtual void deleteTexture(unsigned int texID) = 0;
+
+    /// Switch to the given shader program
+    virtual void useProgram(SimpleIdentity programID) = 0;
+
+    /// Bind a texture to a texture unit
+    virtual void bindTexture(int unit,unsigned int texID) = 0;
+
+    /// Draw count vertices (or elements, if there's an element buffer) from the given buffers.
+    /// Pass 0 for no element buffer.  One instance is a normal draw.
+    virtual void draw(RenderPrimitiveType type,unsigned int vertBuf,unsigned int elementBuf,int count,int numInstances) = 0;
+
+    /// Done with the frame
+    virtual void present() = 0;
+};
+
+/// What a render backend was asked to do
+class RenderBackendStats
+{
+public:
+    RenderBackendStats();
+
+    /// Zero everything out
+    void clear();
+
+    /// Add in another set of stats
+    void add(const RenderBackendStats &that);
+
+    int buffersCreated,buffersDeleted;
+    /// Bytes handed over for buffers, on creation or update
+    uint64_t bufferBytes;
+    int texturesCreated,texturesDeleted;
+    /// Bytes handed over for textures, on creation or update
+    uint64_t textureBytes;
+    int programChanges,textureBinds;
+    int drawCalls;
+    /// Triangles, line segments or points drawn, counting instances
+    uint64_t primitives;
+    /// Calls with IDs we didn't hand out (or already deleted)
+    int badIDs;
+};
+
+/** A backend that doesn't draw anything.
+    It keeps track of buffer and texture uploads and draw calls and checks
+    that the IDs it's given are live.  Use it to run and time the frame
+    without a GPU.
+  */
+class NullRenderBackend : public RenderBackend
+{
+public:
+    NullRenderBackend();
+    virtual ~NullRenderBackend();
+
+    virtual void startFrame(int width,int height);
+    virtual unsigned int createBuffer(const void *data,size_t size);
+    virtual void updateBuffer(unsigned int bufID,size_t offset,const void *data,size_t size);
+    virtual void deleteBuffer(unsigned int bufID);
+    virtual unsigned int createTexture(int width,int height,int bytesPerPixel,const void *data);
+    virtual void updateTexture(unsigned int texID,int x,int y,int width,int height,int bytesPerPixel,const void *data);
+    virtual void deleteTexture(unsigned int texID);
+    virtual void useProgram(SimpleIdentity programID);
+    virtual void bindTexture(int unit,unsigned int texID);
+    virtual void draw(RenderPrimitiveType type,unsigned int vertBuf,unsigned int elementBuf,int count,int numInstances);
+    virtual void present();
+
+    /// Stats since startFrame()
+    const RenderBackendStats &getFrameStats() { return frameStats; }
+
+    /// Stats for all the frames we've presented
+    const RenderBackendStats &getTotalStats() { return totalStats; }
+
+    /// Number of frames presented
+    int getNumFrames() { return numFrames; }
+
+    /// Buffers and textures that haven't been deleted
+    int getNumLiveBuffers() { return (int)buffers.size(); }
+    int getNumLiveTextures() { return (int)textures.size(); }
+
+    /// Bytes in the buffers and textures that haven't been deleted
+    uint64_t getLiveBufferBytes() { return liveBufferBytes; }
+    uint64_t getLiveTextureBytes() { return liveTextureBytes; }
+
+protected:
+    unsigned int nextID;
+    // Size of the live buffers and textures
+    std::unordered_map<unsigned int,size_t> buffers;
+    std::unordered_map<unsigned int,size_t> textures;
+    uint64_t liveBufferBytes,liveTextureBytes;
+    SimpleIdentity curProgram;
+    int numFrames;
+    RenderBackendStats frameStats,totalStats;
+};
+
+}
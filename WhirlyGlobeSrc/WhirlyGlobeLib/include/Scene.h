@@ -28,6 +28,9 @@
 
 #import <vector>
 #import <set>
+#import <deque>
+#import <typeindex>
+#import "Telemetry.h"
 #import "WhirlyVector.h"
 #import "Texture.h"
 #import "Cullable.h"
@@ -36,6 +39,8 @@
 #import "ActiveModel.h"
 #import "CoordSystem.h"
 #import "OpenGLES2Program.h"
+#import "ChangeQueue.h"
+#import "DrawList.h"
 
 /// How the scene refers to the default triangle shader (and how you replace it)
 #define kSceneDefaultTriShader "Default Triangle Shader"
@@ -71,6 +76,9 @@ public:
     
     /// Create the texture on its native thread
     virtual void setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *memManager) { if (tex) tex->createInGL(memManager); };
+    
+    /// Texture size, if we still have to create it
+    virtual size_t estimatedSize();
 
 	/// Add to the renderer.  Never call this.
 	void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view);
@@ -112,6 +120,9 @@ public:
     
     /// Create the drawable on its native thread
     virtual void setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *memManager) { if (drawable) drawable->setupGL(setupInfo, memManager); };
+    
+    /// Size of the vertex and element data we'll copy into buffers
+    virtual size_t estimatedSize();
 
 	/// Add to the renderer.  Never call this
 	void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view);	
@@ -279,10 +290,10 @@ public:
     /// This is not thread safe, so do this in the main thread
     SimpleIdentity getGeneratorIDByName(const std::string &name);
 
-	/// Add a single change request.  You can call this from any thread, it locks.
+	/// Add a single change request.  You can call this from any thread, it doesn't lock.
     /// If you have more than one, don't iterate, use the other version.
 	void addChangeRequest(ChangeRequest *newChange);
-    /// Add a list of change requets.  You can call this from any thread.
+    /// Add a list of change requets.  You can call this from any thread, it doesn't lock.
     /// This is the faster option if you have more than one change request
 	void addChangeRequests(const ChangeSet &newchanges);
 	
@@ -297,6 +308,38 @@ public:
     /// True if there are pending updates
     bool hasChanges(NSTimeInterval now);
     
+    /// Limit how much change request work processChanges() does in one frame.
+    /// Requests run in the order they arrived until we've spent maxTime seconds or handed
+    ///  roughly maxBytes over to OpenGL.  Whatever's left runs on the next frame.
+    /// A set of requests added with addChangeRequests() always runs in the same frame,
+    ///  so things that depend on each other show up together.
+    /// Zero for either means no limit, which is the default.
+    void setChangeBudget(NSTimeInterval maxTime,size_t maxBytes);
+    
+    /// Number of change requests waiting to run, including the timed ones
+    int getNumPendingChanges() { return numPendingChanges.load(std::memory_order_relaxed); }
+    
+    /// Counters for one type of change request
+    class ChangeStats
+    {
+    public:
+        ChangeStats() : numRun(0), numPending(0), totalLatency(0.0), maxLatency(0.0), spanID(EmptyTelemetryID) { }
+        
+        /// Class name of the change request
+        std::string name;
+        /// Number of these that have run
+        int numRun;
+        /// Number waiting in the queue
+        int numPending;
+        /// Time from being added to being run
+        NSTimeInterval totalLatency,maxLatency;
+        /// Telemetry span for running this type, registered the first time one runs
+        TelemetryID spanID;
+    };
+    
+    /// Return the counters for each type of change request we've seen.  Thread safe.
+    void getChangeStats(std::vector<ChangeStats> &stats);
+    
     /// Add sub texture mappings.
     /// These are mappings from images to parts of texture atlases.
     /// They're here so we can use SimpleIdentity's to point into larger
@@ -346,6 +389,9 @@ public:
     /// Return the top level cullable
     CullTree *getCullTree() { return cullTree; }
     
+    /// All the drawables in the order we draw them.  Only use this on the rendering thread.
+    DrawList *getDrawList() { return &drawList; }
+    
     /// Explicitly tear everything down in OpenGL ES.
     /// We're assuming the context has been set.
     void teardownGL();
@@ -391,6 +437,9 @@ public:
 
     /// Top level of Cullable quad tree
     CullTree *cullTree;
+    
+    /// Drawables sorted for rendering
+    DrawList drawList;
 	
 	/// All the drawables we've been handed, sorted by ID
 	DrawableRefSet drawables;
@@ -402,11 +451,21 @@ public:
     /// Mutex for accessing textures
     pthread_mutex_t textureLock;
 	
+	/// Held while processing changes or reading the stats.
+	/// The threads adding change requests never take this.
 	pthread_mutex_t changeRequestLock;
-	/// We keep a list of change requests to execute
-	/// This can be accessed in multiple threads, so we lock it
-	ChangeSet changeRequests;
-    SortedChangeSet timedChangeRequests;
+	/// Change requests come in here from any thread, grouped the way they were added
+	MPSCQueue<ChangeSet> changeQueue;
+	/// Groups we've taken off the queue, but haven't run yet
+	std::deque<ChangeSet> changeRequests;
+    std::atomic<int> numPendingChanges;
+    /// Change requests waiting for their time to come
+    TimerWheel<ChangeRequest *> timedChangeRequests;
+    /// Per frame limits for processChanges()
+    NSTimeInterval changeTimeBudget;
+    size_t changeByteBudget;
+    /// Queue depth and latency by change request type
+    std::map<std::type_index,ChangeStats> changeStats;
     
     pthread_mutex_t subTexLock;
     typedef std::set<SubTexture> SubTextureSet;
@@ -274,8 +274,8 @@ typedef enum {zBufferOn,zBufferOff,zBufferOffDefault} WhirlyKitSceneRendererZBuf
 /// Use this to set the clear color for the screen.  Defaults to black
 - (void)setClearColor:(UIColor *)inClearColor;
 
-/// Used by the subclasses for culling
-- (void)findDrawables:(WhirlyKit::Cullable *)cullable view:(WhirlyGlobeView *)globeView frameSize:(WhirlyKit::Point2f)frameSize modelTrans:(Eigen::Matrix4d *)modelTrans eyeVec:(Eigen::Vector3f)eyeVec frameInfo:(WhirlyKitRendererFrameInfo *)frameInfo screenMbr:(WhirlyKit::Mbr)screenMbr topLevel:(bool)isTopLevel toDraw:(std::set<WhirlyKit::DrawableRef> *) toDraw considered:(int *)drawablesConsidered;
+/// Used by the subclasses for culling.  Adds the draw list slots of anything that might be visible.
+- (void)findDrawables:(WhirlyKit::CullTree *)cullTree view:(WhirlyGlobeView *)globeView frameSize:(WhirlyKit::Point2f)frameSize modelTrans:(Eigen::Matrix4d *)modelTrans eyeVec:(Eigen::Vector3f)eyeVec screenMbr:(WhirlyKit::Mbr)screenMbr toDraw:(std::vector<int> *)toDraw considered:(int *)drawablesConsidered;
 
 /// Used by the subclasses to determine if the view changed and needs to be updated
 - (bool) viewDidChange;
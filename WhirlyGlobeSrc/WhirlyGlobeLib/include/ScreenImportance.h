@@ -45,6 +45,10 @@ double ScreenImportance(WhirlyKitViewState *viewState,WhirlyKit::Point2f frameSi
 /// This version takes a min/max height and is optimized for volumes.
 double ScreenImportance(WhirlyKitViewState *viewState,WhirlyKit::Point2f frameSize,int pixelsSquare,WhirlyKit::CoordSystem *srcSystem,WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,WhirlyKit::Mbr nodeMbr, double minZ,double maxZ, WhirlyKit::Quadtree::Identifier &nodeIdent,NSMutableDictionary *attrs);
 
+/// Screen importance for a batch of tiles, the same as calling the first version on each.
+/// The tiles are scored in parallel, so this is much faster for big batches.
+void ScreenImportance(WhirlyKitViewState *viewState,WhirlyKit::Point2f frameSize,int pixelsSquare,WhirlyKit::CoordSystem *srcSystem,WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,std::vector<WhirlyKit::Quadtree::ImportanceRequest> &requests);
+
 }
 
 /// A solid volume used to describe the display space a tile takes up.
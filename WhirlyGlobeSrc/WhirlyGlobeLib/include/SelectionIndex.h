@@ -0,0 +1,447 @@
+/*
+ *  SelectionIndex.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import <algorithm>
+#import <math.h>
+#import <Eigen/Eigen>
+
+namespace WhirlyKit
+{
+
+/** The part of the view a touch could select.
+    This is the view frustum cut down to a rectangle on the screen, as four planes
+    in display space.  Anything in front of the eye that projects into that rectangle
+    is inside all four.  The planes come straight out of the projection matrix, no
+    inverse needed.
+    This is plain C++ so the benchmarks can use it too.
+  */
+class PickFrustum
+{
+public:
+    /// Pass in the projection times the model/view matrix, the frame size and a screen rectangle.
+    /// Screen coordinates run from the upper left, the same as pointOnScreenFromSphere.
+    PickFrustum(const Eigen::Matrix4d &projModelView,const Eigen::Vector2d &frameSize,const Eigen::Vector2d &ll,const Eigen::Vector2d &ur)
+    {
+        // Screen rectangle to normalized device coordinates.  y flips.
+        double minX = 2.0 * ll.x() / frameSize.x() - 1.0, maxX = 2.0 * ur.x() / frameSize.x() - 1.0;
+        double minY = 1.0 - 2.0 * ur.y() / frameSize.y(), maxY = 1.0 - 2.0 * ll.y() / frameSize.y();
+
+        // x/w >= minX is x - minX*w >= 0 for anything in front of us.  Same for the rest.
+        Eigen::Matrix<double,1,4> rowX = projModelView.row(0), rowY = projModelView.row(1), rowW = projModelView.row(3);
+        planes[0] = rowX - minX * rowW;
+        planes[1] = maxX * rowW - rowX;
+        planes[2] = rowY - minY * rowW;
+        planes[3] = maxY * rowW - rowY;
+    }
+
+    /// True if any of the box might be inside
+    bool overlaps(const Eigen::Vector3d &ll,const Eigen::Vector3d &ur) const
+    {
+        for (unsigned int ii=0;ii<4;ii++)
+        {
+            const Eigen::Matrix<double,1,4> &plane = planes[ii];
+            // The corner furthest along the plane normal
+            double dist = plane(3);
+            for (unsigned int jj=0;jj<3;jj++)
+                dist += plane(jj) * (plane(jj) >= 0.0 ? ur(jj) : ll(jj));
+            if (dist < 0.0)
+                return false;
+        }
+
+        return true;
+    }
+
+protected:
+    Eigen::Matrix<double,1,4> planes[4];
+};
+
+/** A bounding volume hierarchy over 3D boxes that's updated one box at a time.
+    This is the dynamic AABB tree physics engines use for their broad phase.  New boxes
+    go next to whichever sibling grows the tree's surface area the least and the tree
+    is rebalanced on the way back up, so inserts, removes and queries are all logarithmic.
+    The handle returned by insert() is how you refer to a box later.
+    Not thread safe.
+  */
+template<typename T>
+class BoxTree
+{
+public:
+    BoxTree() : root(-1), freeList(-1), count(0) { }
+
+    /// Add a box with its item.  Returns the handle.
+    int insert(const Eigen::Vector3d &ll,const Eigen::Vector3d &ur,const T &item)
+    {
+        int leaf = allocNode();
+        Node &node = nodes[leaf];
+        node.ll = ll;  node.ur = ur;
+        node.item = item;
+        node.height = 0;
+        insertLeaf(leaf);
+        count++;
+
+        return leaf;
+    }
+
+    /// Remove the box with the given handle
+    void remove(int which)
+    {
+        if (which < 0 || which >= (int)nodes.size() || nodes[which].height != 0)
+            return;
+        removeLeaf(which);
+        freeNode(which);
+        count--;
+    }
+
+    /// Item for the given handle
+    const T &getItem(int which) const { return nodes[which].item; }
+
+    /// Call visit(item) for every box test(ll,ur) accepts.
+    /// The test is also run on the interior boxes to skip whole branches.
+    template<typename Test,typename Visit>
+    void query(const Test &test,const Visit &visit) const
+    {
+        if (root < 0)
+            return;
+        std::vector<int> stack;
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (!test(node.ll,node.ur))
+                continue;
+            if (node.isLeaf())
+                visit(node.item);
+            else {
+                stack.push_back(node.child0);
+                stack.push_back(node.child1);
+            }
+        }
+    }
+
+    /// Number of boxes
+    int size() const { return count; }
+
+    /// Height of the tree, for debugging
+    int getHeight() const { return root < 0 ? 0 : nodes[root].height; }
+
+    /// Clear everything out
+    void clear()
+    {
+        nodes.clear();
+        root = freeList = -1;
+        count = 0;
+    }
+
+protected:
+    class Node
+    {
+    public:
+        bool isLeaf() const { return child0 < 0; }
+
+        Eigen::Vector3d ll,ur;
+        // Parent in the tree or next in the free list
+        int parent;
+        int child0,child1;
+        // Leaves are 0, free nodes are -1
+        int height;
+        T item;
+    };
+
+    // Surface area, more or less.  It's what we minimize when we insert.
+    static double area(const Eigen::Vector3d &ll,const Eigen::Vector3d &ur)
+    {
+        Eigen::Vector3d size = ur - ll;
+        return size.x()*size.y() + size.y()*size.z() + size.z()*size.x();
+    }
+
+    static double unionArea(const Node &a,const Node &b)
+    {
+        return area(a.ll.cwiseMin(b.ll),a.ur.cwiseMax(b.ur));
+    }
+
+    // Recalculate an interior node's box and height from its children
+    void refit(int which)
+    {
+        Node &node = nodes[which];
+        const Node &child0 = nodes[node.child0], &child1 = nodes[node.child1];
+        node.ll = child0.ll.cwiseMin(child1.ll);
+        node.ur = child0.ur.cwiseMax(child1.ur);
+        node.height = 1 + std::max(child0.height,child1.height);
+    }
+
+    int allocNode()
+    {
+        int which;
+        if (freeList >= 0)
+        {
+            which = freeList;
+            freeList = nodes[which].parent;
+        } else {
+            which = (int)nodes.size();
+            nodes.resize(nodes.size()+1);
+        }
+        Node &node = nodes[which];
+        node.parent = node.child0 = node.child1 = -1;
+        node.height = 0;
+
+        return which;
+    }
+
+    void freeNode(int which)
+    {
+        Node &node = nodes[which];
+        node.item = T();
+        node.height = -1;
+        node.parent = freeList;
+        freeList = which;
+    }
+
+    void insertLeaf(int leaf)
+    {
+        if (root < 0)
+        {
+            root = leaf;
+            nodes[leaf].parent = -1;
+            return;
+        }
+
+        // Walk down to the best sibling
+        int which = root;
+        while (!nodes[which].isLeaf())
+        {
+            const Node &node = nodes[which], &leafNode = nodes[leaf];
+            double nodeArea = area(node.ll,node.ur);
+            double combinedArea = unionArea(node,leafNode);
+            // Cost of making a new parent for this node and the leaf
+            double cost = 2.0 * combinedArea;
+            // Everything below here grows by this much
+            double inheritCost = 2.0 * (combinedArea - nodeArea);
+
+            double childCost[2];
+            int children[2] = {node.child0,node.child1};
+            for (unsigned int ii=0;ii<2;ii++)
+            {
+                const Node &child = nodes[children[ii]];
+                if (child.isLeaf())
+                    childCost[ii] = unionArea(child,leafNode) + inheritCost;
+                else
+                    childCost[ii] = unionArea(child,leafNode) - area(child.ll,child.ur) + inheritCost;
+            }
+
+            if (cost < childCost[0] && cost < childCost[1])
+                break;
+            which = childCost[0] < childCost[1] ? children[0] : children[1];
+        }
+        int sibling = which;
+
+        // New parent for the sibling and the leaf
+        int newParent = allocNode();
+        int oldParent = nodes[sibling].parent;
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].child0 = sibling;
+        nodes[newParent].child1 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+        if (oldParent >= 0)
+        {
+            if (nodes[oldParent].child0 == sibling)
+                nodes[oldParent].child0 = newParent;
+            else
+                nodes[oldParent].child1 = newParent;
+        } else
+            root = newParent;
+
+        fixUpwards(newParent);
+    }
+
+    void removeLeaf(int leaf)
+    {
+        if (leaf == root)
+        {
+            root = -1;
+            return;
+        }
+
+        int parent = nodes[leaf].parent;
+        int grandParent = nodes[parent].parent;
+        int sibling = nodes[parent].child0 == leaf ? nodes[parent].child1 : nodes[parent].child0;
+
+        // The sibling takes the parent's place
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        if (grandParent >= 0)
+        {
+            if (nodes[grandParent].child0 == parent)
+                nodes[grandParent].child0 = sibling;
+            else
+                nodes[grandParent].child1 = sibling;
+            fixUpwards(grandParent);
+        } else
+            root = sibling;
+    }
+
+    // Rebalance and refit from here to the root
+    void fixUpwards(int which)
+    {
+        while (which >= 0)
+        {
+            which = balance(which);
+            refit(which);
+            which = nodes[which].parent;
+        }
+    }
+
+    // If one side of a is more than one taller than the other, rotate it up.
+    // Returns whatever is now in a's place.
+    int balance(int a)
+    {
+        if (nodes[a].isLeaf() || nodes[a].height < 2)
+            return a;
+
+        int b = nodes[a].child0, c = nodes[a].child1;
+        int diff = nodes[c].height - nodes[b].height;
+        if (diff > 1)
+            return rotateUp(a,c,false);
+        if (diff < -1)
+            return rotateUp(a,b,true);
+
+        return a;
+    }
+
+    // Move up into a's place.  up is a's child0 if upIsChild0, child1 otherwise.
+    int rotateUp(int a,int up,bool upIsChild0)
+    {
+        int f = nodes[up].child0, g = nodes[up].child1;
+
+        // up takes a's place under a's parent
+        nodes[up].child0 = a;
+        nodes[up].parent = nodes[a].parent;
+        nodes[a].parent = up;
+        int upParent = nodes[up].parent;
+        if (upParent >= 0)
+        {
+            if (nodes[upParent].child0 == a)
+                nodes[upParent].child0 = up;
+            else
+                nodes[upParent].child1 = up;
+        } else
+            root = up;
+
+        // The taller of up's children stays with up, the shorter goes to a
+        int keep = f, give = g;
+        if (nodes[g].height > nodes[f].height)
+        {
+            keep = g;  give = f;
+        }
+        nodes[up].child1 = keep;
+        if (upIsChild0)
+            nodes[a].child0 = give;
+        else
+            nodes[a].child1 = give;
+        nodes[give].parent = a;
+
+        refit(a);
+        refit(up);
+
+        return up;
+    }
+
+    std::vector<Node> nodes;
+    int root;
+    int freeList;
+    int count;
+};
+
+/** A uniform grid over the screen.
+    Objects go in every cell their box touches and a query hands back
+    everything in the cells a rectangle touches.  Anything off the edge of the
+    grid lands in the edge cells.
+    Not thread safe.
+  */
+class ScreenGrid
+{
+public:
+    ScreenGrid() : sizeX(0), sizeY(0), cellSize(1.0) { }
+
+    /// Start over covering the given area with cells of about the given size
+    void reset(const Eigen::Vector2d &inLL,const Eigen::Vector2d &inUR,double inCellSize)
+    {
+        ll = inLL;
+        cellSize = std::max(inCellSize,1e-6);
+        Eigen::Vector2d size = inUR - inLL;
+        sizeX = std::max(1,std::min(1024,(int)ceil(size.x() / cellSize)));
+        sizeY = std::max(1,std::min(1024,(int)ceil(size.y() / cellSize)));
+        cells.clear();
+        cells.resize(sizeX*sizeY);
+    }
+
+    /// Add an object, by index, covering the given box
+    void add(int which,const Eigen::Vector2d &objLL,const Eigen::Vector2d &objUR)
+    {
+        int sx,sy,ex,ey;
+        cellRange(objLL,objUR,sx,sy,ex,ey);
+        for (int iy=sy;iy<=ey;iy++)
+            for (int ix=sx;ix<=ex;ix++)
+                cells[iy*sizeX+ix].push_back(which);
+    }
+
+    /// Everything that might overlap the given box, sorted with no duplicates
+    void query(const Eigen::Vector2d &queryLL,const Eigen::Vector2d &queryUR,std::vector<int> &found) const
+    {
+        found.clear();
+        if (cells.empty())
+            return;
+        int sx,sy,ex,ey;
+        cellRange(queryLL,queryUR,sx,sy,ex,ey);
+        for (int iy=sy;iy<=ey;iy++)
+            for (int ix=sx;ix<=ex;ix++)
+            {
+                const std::vector<int> &cell = cells[iy*sizeX+ix];
+                found.insert(found.end(),cell.begin(),cell.end());
+            }
+        std::sort(found.begin(),found.end());
+        found.erase(std::unique(found.begin(),found.end()),found.end());
+    }
+
+protected:
+    int clampCell(double val,int size) const
+    {
+        if (!(val >= 0.0))
+            return 0;
+        return std::min((int)val,size-1);
+    }
+
+    void cellRange(const Eigen::Vector2d &boxLL,const Eigen::Vector2d &boxUR,int &sx,int &sy,int &ex,int &ey) const
+    {
+        sx = clampCell((boxLL.x() - ll.x()) / cellSize,sizeX);
+        sy = clampCell((boxLL.y() - ll.y()) / cellSize,sizeY);
+        ex = clampCell((boxUR.x() - ll.x()) / cellSize,sizeX);
+        ey = clampCell((boxUR.y() - ll.y()) / cellSize,sizeY);
+    }
+
+    Eigen::Vector2d ll;
+    int sizeX,sizeY;
+    double cellSize;
+    std::vector<std::vector<int> > cells;
+};
+
+}
@@ -27,6 +27,7 @@
 #import "MaplyView.h"
 #import "Scene.h"
 #import "ScreenSpaceBuilder.h"
+#import "SelectionIndex.h"
 
 @class WhirlyKitSceneRendererES;
 @class WhirlyGlobeViewState;
@@ -37,6 +38,7 @@ namespace WhirlyKit
     
 class Scene;
 class SceneManager;
+class LayoutManager;
 
 /// Base class for selectable geometry
 class Selectable
@@ -175,7 +177,9 @@ typedef std::set<WhirlyKit::BillboardSelectable> BillboardSelectableSet;
      when the caller uses pickObject.
  
     All objects are currently being projected to the 2D screen and
-     evaluated for distance there.
+     evaluated for distance there.  The world space objects are kept in a
+     box tree so we only project the ones near the touch.  The screen space
+     objects are projected once per view and kept in a screen grid.
  
     The selection manager is entirely thread safe except for destruction.
  */
@@ -277,7 +281,13 @@ protected:
     // Projects a world coordinate to one or more points on the screen (wrapping)
     void projectWorldPointToScreen(const Point3d &worldLoc,const PlacementInfo &pInfo,std::vector<Point2d> &screenPts,float scale);
     // Convert rect selectables into more generic screen space objects
-    void getScreenSpaceObjects(const PlacementInfo &pInfo,std::vector<ScreenSpaceObjectLocation> &screenObjs,NSTimeInterval now);
+    void getScreenSpaceObjects(const PlacementInfo &pInfo,std::vector<ScreenSpaceObjectLocation> &screenObjs);
+    // Same for the moving rect selectables, which depend on the time
+    void getMovingScreenSpaceObjects(const PlacementInfo &pInfo,std::vector<ScreenSpaceObjectLocation> &screenObjs,NSTimeInterval now);
+    // Check a screen space object against the touch at each of its projected locations
+    void pickScreenSpaceObject(Point2f touchPt,float maxDist2,ScreenSpaceObjectLocation &screenObj,const std::vector<Point2d> &projPts,const PlacementInfo &pInfo,const Eigen::Matrix4d &modelTrans,const Eigen::Matrix4d &normalMat,const Point2f &frameBufferSize,std::vector<SelectedObject> &selObjs);
+    // Reproject the screen space objects if the view or the objects have changed
+    void updateScreenSpaceCache(const PlacementInfo &pInfo,LayoutManager *layoutManager);
     // Internal object picking method
     void pickObjects(Point2f touchPt,float maxDist,WhirlyKitView *theView,bool multi,std::vector<SelectedObject> &selObjs);
 
@@ -292,6 +302,52 @@ protected:
     WhirlyKit::MovingPolytopeSelectableSet movingPolytopeSelectables;
     WhirlyKit::LinearSelectableSet linearSelectables;
     WhirlyKit::BillboardSelectableSet billboardSelectables;
+    
+    /// Types of selectables we keep in the world space index
+    typedef enum {IndexRect3D,IndexPolytope,IndexLinear,IndexBillboard,IndexTypeMax} IndexType;
+    
+    /// What we keep in the world space index for a selectable
+    class IndexEntry
+    {
+    public:
+        IndexEntry() : type(IndexRect3D), selectID(EmptyIdentity) { }
+        IndexEntry(IndexType type,SimpleIdentity selectID) : type(type), selectID(selectID) { }
+        bool operator < (const IndexEntry &that) const { return (type == that.type) ? (selectID < that.selectID) : (type < that.type); }
+        
+        IndexType type;
+        SimpleIdentity selectID;
+    };
+    
+    // Add a selectable's display space bounding box to the index
+    void addToIndex(IndexType type,SimpleIdentity selectID,const Point3d &ll,const Point3d &ur);
+    // Remove a selectable from the index, whatever type it is
+    void removeFromIndex(SimpleIdentity selectID);
+    
+    /// Bounding boxes of the world space selectables (except the moving ones)
+    BoxTree<IndexEntry> selectIndex;
+    /// Index handles for the selectables
+    std::map<IndexEntry,int> selectIndexHandles;
+    
+    /// Screen space objects, projected for a particular view
+    class ScreenSpaceCache
+    {
+    public:
+        ScreenSpaceCache() : valid(false), heightAboveSurface(0.0), generation(0), layoutGeneration(0) { }
+        
+        bool valid;
+        Eigen::Matrix4d viewMat,modelMat,projMat;
+        Point2f frameSize;
+        double heightAboveSurface;
+        unsigned int generation,layoutGeneration;
+        /// The objects and where they land on the screen (more than once if the map wraps)
+        std::vector<ScreenSpaceObjectLocation> objs;
+        std::vector<std::vector<Point2d> > projPts;
+        /// Grid over the screen with the objects in it
+        ScreenGrid grid;
+    };
+    ScreenSpaceCache screenCache;
+    /// Changes whenever the screen space selectables do
+    unsigned int screenGeneration;
 };
  
 }
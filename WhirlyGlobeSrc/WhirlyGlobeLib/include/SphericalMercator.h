@@ -51,8 +51,17 @@ public:
     Point3f geocentricToLocal(Point3f);
     Point3d geocentricToLocal(Point3d);
     
+    /// Batch versions
+    void localToGeographic(const Point3d *inPts,Point2d *outPts,int count);
+    void geographicToLocal(const Point2d *inPts,Point3d *outPts,int count);
+    void localToGeocentric(const Point3d *inPts,Point3d *outPts,int count);
+    void geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count);
+    
     /// True if the other system is Spherical Mercator with the same origin
     virtual bool isSameAs(CoordSystem *coordSys);
+    
+    /// Mercator is a function of lat/lon only
+    bool geocentricViaGeographic() { return true; }
         
 protected:
     double originLon;
@@ -84,6 +93,11 @@ public:
     virtual WhirlyKit::Point3f displayToLocal(WhirlyKit::Point3f);
     virtual WhirlyKit::Point3d displayToLocal(WhirlyKit::Point3d);
     
+    /// Batch versions
+    virtual void localToDisplay(const Point3f *inPts,Point3f *outPts,int count);
+    virtual void localToDisplay(const Point3d *inPts,Point3d *outPts,int count);
+    virtual void displayToLocal(const Point3d *inPts,Point3d *outPts,int count);
+    
     /// For flat systems the normal is Z up.  For the globe, it's based on the location.
     virtual Point3f normalForLocal(Point3f);
     virtual Point3d normalForLocal(Point3d);
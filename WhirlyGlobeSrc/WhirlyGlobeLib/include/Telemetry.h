@@ -0,0 +1,158 @@
+/*
+ *  Telemetry.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <stdint.h>
+#import <atomic>
+#import <string>
+#import <vector>
+
+namespace WhirlyKit
+{
+
+/// Spans and counters are registered up front and referred to by these
+typedef int TelemetryID;
+
+/// Not a valid span or counter
+static const TelemetryID EmptyTelemetryID = -1;
+
+/** HDR histogram of 64 bit values.
+    Buckets are exact below 32 and cover 1/32 of a power of two above that,
+    so any value comes back within about 3%.
+    Only one thread writes to a given histogram.  Others can read it at
+    the same time and get a slightly stale answer.
+  */
+class TelemetryHistogram
+{
+public:
+    static const int SubBucketBits = 5;
+    static const int NumSubBuckets = 1<<SubBucketBits;
+    static const int NumBuckets = (64-SubBucketBits+1)*NumSubBuckets;
+
+    TelemetryHistogram();
+
+    /// Add a value.  Only the owning thread calls this.
+    void record(uint64_t value);
+
+    /// Zero it out
+    void clear();
+
+    /// Add in everything from another histogram.  Only the owning thread calls this.
+    void add(const TelemetryHistogram &other);
+
+    /// Bucket a value falls in
+    static int bucketForValue(uint64_t value);
+
+    /// Middle of a bucket
+    static uint64_t valueForBucket(int bucket);
+
+    std::atomic<uint64_t> buckets[NumBuckets];
+    std::atomic<uint64_t> count,sum,minValue,maxValue;
+};
+
+/// Summary for one span or counter over all the threads
+class TelemetryStats
+{
+public:
+    TelemetryStats();
+
+    TelemetryID telemetryID;
+    std::string name;
+    /// Spans are timed, in nanoseconds.  Counters are whatever was recorded.
+    bool isSpan;
+    uint64_t count;
+    uint64_t minValue,maxValue;
+    double mean;
+    /// Percentiles from the histogram
+    uint64_t p50,p99,p999;
+};
+
+/** Low overhead instrumentation for the whole toolkit.
+    Spans (things we time) and counters (values we sample) are registered
+    by name once and recorded by ID after that.  Each thread records into
+    its own histograms, so recording never takes a lock and never touches
+    a string.  Stats and traces are put together from all the threads when
+    someone asks.
+    With tracing turned on, each thread also keeps its most recent events,
+    which can be written out as Chrome trace JSON.
+  */
+class Telemetry
+{
+public:
+    /// Most spans and counters we'll keep track of
+    static const int MaxIDs = 1024;
+
+    /// Events each thread keeps when tracing
+    static const int MaxTraceEvents = 1<<15;
+
+    /// Register a span by name.  The same name gets the same ID back.
+    static TelemetryID registerSpan(const std::string &name);
+
+    /// Register a counter by name.  The same name gets the same ID back.
+    static TelemetryID registerCounter(const std::string &name);
+
+    /// Name a span or counter was registered with
+    static std::string getName(TelemetryID telemetryID);
+
+    /// Nanoseconds from a steady clock
+    static uint64_t now();
+
+    /// Add a span that ran from start to end (from now())
+    static void recordSpan(TelemetryID spanID,uint64_t start,uint64_t end);
+
+    /// Add a value for a counter
+    static void recordValue(TelemetryID counterID,uint64_t value);
+
+    /// Name the calling thread in traces
+    static void setThreadName(const std::string &name);
+
+    /// Turn event tracing on or off.  It's off by default.
+    static void setTracing(bool tracing);
+    static bool isTracing();
+
+    /// Stats for one span or counter.  Returns false if there's nothing recorded.
+    static bool getStats(TelemetryID telemetryID,TelemetryStats &stats);
+
+    /// Stats for everything that's had something recorded
+    static void getAllStats(std::vector<TelemetryStats> &stats);
+
+    /// Zero out the stats and traced events.
+    /// Anything recorded while this runs may or may not survive.
+    static void clear();
+
+    /// Write the traced events out as Chrome trace JSON (for chrome://tracing or Perfetto)
+    static bool writeChromeTrace(const std::string &fileName);
+
+    /// Write the stats out to NSLog (or stdout, off the device)
+    static void log();
+};
+
+/// Times a span from construction to destruction
+class TelemetrySpan
+{
+public:
+    TelemetrySpan(TelemetryID spanID) : spanID(spanID), start(Telemetry::now()) { }
+    ~TelemetrySpan() { Telemetry::recordSpan(spanID,start,Telemetry::now()); }
+
+protected:
+    TelemetryID spanID;
+    uint64_t start;
+};
+
+}
@@ -34,6 +34,10 @@
 #import "ElevationChunk.h"
 #import "LoadedTile.h"
 
+/// The attrs handed to startFetchForLevel: hold the tile's importance under this key as an NSNumber.
+/// Data sources that fetch over the network can use it to decide what goes out first.
+#define kWKTileImportance @"WKTileImportance"
+
 /// @cond
 @class WhirlyKitQuadTileLoader;
 @protocol WhirlyKitQuadTileImageDataSource;
@@ -0,0 +1,114 @@
+/*
+ *  VertexArena.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import <map>
+#import <mutex>
+#import <algorithm>
+
+namespace WhirlyKit
+{
+
+/** Recycles the arrays drawables are built in.
+    These are the same separate arrays as always (points, triangles and one byte array
+    per attribute), just handed around instead of freed.  Nothing here interleaves them.
+    The builders make drawables of about the same size, tile after tile.  Once a drawable
+    is done with its arrays (usually when they've been copied into OpenGL) they come back
+    here, capacity and all, and the next drawable that needs room picks them up.
+    Thread safe.  This is plain C++.
+  */
+template<typename T>
+class VertexArena
+{
+public:
+    /// We'll hold on to at most this many bytes of spare arrays
+    VertexArena(size_t maxBytes) : maxBytes(maxBytes), numBytes(0) { }
+
+    /// Make sure vec can hold at least minSize elements.
+    /// If it has to grow we'll use a spare array if we have one that fits and give the old one back.
+    void grow(std::vector<T> &vec,size_t minSize)
+    {
+        if (vec.capacity() >= minSize)
+            return;
+        // Grow geometrically, like the vector would
+        size_t wantSize = std::max(minSize,std::max(2*vec.capacity(),(size_t)64));
+
+        std::vector<T> spare;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // Anything more than four times too big would be a waste
+            auto it = spares.lower_bound(minSize);
+            if (it != spares.end() && it->first <= 4*wantSize)
+            {
+                spare.swap(it->second);
+                numBytes -= it->first * sizeof(T);
+                spares.erase(it);
+            }
+        }
+
+        if (spare.capacity() == 0)
+        {
+            vec.reserve(wantSize);
+            return;
+        }
+        spare.insert(spare.end(),vec.begin(),vec.end());
+        vec.swap(spare);
+        give(spare);
+    }
+
+    /// Hand back the memory in vec.  vec is left empty with nothing allocated.
+    void give(std::vector<T> &vec)
+    {
+        size_t capacity = vec.capacity();
+        if (capacity == 0)
+            return;
+        // Not worth keeping track of the little ones
+        if (capacity < 64)
+        {
+            std::vector<T>().swap(vec);
+            return;
+        }
+
+        std::vector<T> spare;
+        spare.swap(vec);
+        spare.clear();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (numBytes + capacity * sizeof(T) > maxBytes)
+            return;
+        numBytes += capacity * sizeof(T);
+        spares.insert(std::pair<size_t,std::vector<T> >(capacity,std::vector<T>()))->second.swap(spare);
+    }
+
+    /// Bytes of spare arrays we're holding on to
+    size_t getNumBytes()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return numBytes;
+    }
+
+protected:
+    std::mutex mutex;
+    size_t maxBytes,numBytes;
+    // Spare arrays sorted by capacity
+    std::multimap<size_t,std::vector<T> > spares;
+};
+
+}
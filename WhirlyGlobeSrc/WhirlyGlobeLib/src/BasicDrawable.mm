@@ -25,6 +25,7 @@
 #import "UIImage+Stuff.h"
 #import "SceneRendererES.h"
 #import "TextureAtlas.h"
+#import "VertexArena.h"
 
 using namespace Eigen;
 
@@ -68,6 +69,10 @@ void BasicDrawable::basicDrawableInit()
     hasMatrix = false;
 }
 
+// Point and triangle arrays are recycled through these once they've gone to OpenGL
+static VertexArena<Eigen::Vector3f> pointArena(16*1024*1024);
+static VertexArena<BasicDrawable::Triangle> triArena(8*1024*1024);
+
 BasicDrawable::BasicDrawable(const std::string &name)
 : Drawable(name)
 {
@@ -81,8 +86,8 @@ BasicDrawable::BasicDrawable(const std::string &name,unsigned int numVert,unsign
 {
     basicDrawableInit();
     
-    points.reserve(numVert);
-    tris.reserve(numTri);
+    pointArena.grow(points,numVert);
+    triArena.grow(tris,numTri);
     setupStandardAttributes(numVert);
 }
 
@@ -91,6 +96,8 @@ BasicDrawable::~BasicDrawable()
     for (unsigned int ii=0;ii<vertexAttributes.size();ii++)
         delete vertexAttributes[ii];
     vertexAttributes.clear();
+    pointArena.give(points);
+    triArena.give(tris);
 }
 
 void BasicDrawable::setupTexCoordEntry(int which,int numReserve)
@@ -355,16 +362,27 @@ bool BasicDrawable::getWriteZbuffer() const
 
 unsigned int BasicDrawable::addPoint(const Point3f &pt)
 {
+    if (points.size() == points.capacity())
+        pointArena.grow(points,points.size()+1);
     points.push_back(pt);
     return (unsigned int)(points.size()-1);
 }
 
 unsigned int BasicDrawable::addPoint(const Point3d &pt)
 {
+    if (points.size() == points.capacity())
+        pointArena.grow(points,points.size()+1);
     points.push_back(Point3f(pt.x(),pt.y(),pt.z()));
     return (unsigned int)(points.size()-1);
 }
 
+unsigned int BasicDrawable::addPoints(const Point3f *pts,int count)
+{
+    unsigned int start = (unsigned int)points.size();
+    pointArena.grow(points,points.size()+count);
+    points.insert(points.end(),pts,pts+count);
+    return start;
+}
 
 Point3f BasicDrawable::getPoint(int which)
 {
@@ -387,6 +405,18 @@ void BasicDrawable::addTexCoord(int which,TexCoord coord)
     }
 }
 
+void BasicDrawable::addTexCoords(int which,const TexCoord *coords,int count)
+{
+    if (which == -1)
+    {
+        for (unsigned int ii=0;ii<texInfo.size();ii++)
+            vertexAttributes[texInfo[ii].texCoordEntry]->addVector2fs(coords,count);
+    } else {
+        setupTexCoordEntry(which, count);
+        vertexAttributes[texInfo[which].texCoordEntry]->addVector2fs(coords,count);
+    }
+}
+
 void BasicDrawable::addColor(RGBAColor color)
 { vertexAttributes[colorEntry]->addColor(color); }
 
@@ -396,6 +426,9 @@ void BasicDrawable::addNormal(const Point3f &norm)
 void BasicDrawable::addNormal(const Point3d &norm)
 { vertexAttributes[normalEntry]->addVector3f(Point3f(norm.x(),norm.y(),norm.z())); }
 
+void BasicDrawable::addNormals(const Point3f *norms,int count)
+{ vertexAttributes[normalEntry]->addVector3fs(norms,count); }
+
 void BasicDrawable::addAttributeValue(int attrId,Eigen::Vector2f vec)
 { vertexAttributes[attrId]->addVector2f(vec); }
 
@@ -507,7 +540,17 @@ void BasicDrawable::addVertexAttributes(const SingleVertexAttributeSet &attrs)
 }
 
 void BasicDrawable::addTriangle(Triangle tri)
-{ tris.push_back(tri); }
+{
+    if (tris.size() == tris.capacity())
+        triArena.grow(tris,tris.size()+1);
+    tris.push_back(tri);
+}
+
+void BasicDrawable::addTriangles(const Triangle *inTris,int count)
+{
+    triArena.grow(tris,tris.size()+count);
+    tris.insert(tris.end(),inTris,inTris+count);
+}
 
 SimpleIdentity BasicDrawable::getTexId(unsigned int which)
 {
@@ -517,6 +560,14 @@ SimpleIdentity BasicDrawable::getTexId(unsigned int which)
     
     return texId;
 }
+    
+SimpleIdentity BasicDrawable::getMainTexture() const
+{
+    if (texInfo.empty())
+        return EmptyIdentity;
+    
+    return texInfo[0].texId;
+}
 
 // If we're fading in or out, update the rendering window
 void BasicDrawable::updateRenderer(WhirlyKitSceneRendererES *renderer)
@@ -547,12 +598,14 @@ void BasicDrawable::applySubTexture(int which,SubTexture subTex,int startingAt)
         
         TexInfo &thisTexInfo = texInfo[which];
         thisTexInfo.texId = subTex.texId;
-        std::vector<TexCoord> *texCoords = (std::vector<TexCoord> *)vertexAttributes[thisTexInfo.texCoordEntry]->data;
+        VertexAttribute *texAttr = vertexAttributes[thisTexInfo.texCoordEntry];
+        int numCoords = texAttr->numElements();
+        TexCoord *tcs = texAttr->elements<TexCoord>();
         
-        for (unsigned int ii=startingAt;ii<texCoords->size();ii++)
+        for (int ii=startingAt;tcs && ii<numCoords;ii++)
         {
-            Point2f tc = (*texCoords)[ii];
-            (*texCoords)[ii] = subTex.processTexCoord(TexCoord(tc.x(),tc.y()));
+            TexCoord &tc = tcs[ii];
+            tc = subTex.processTexCoord(TexCoord(tc.x(),tc.y()));
         }
     }
 }
@@ -574,10 +627,10 @@ unsigned int BasicDrawable::getNumTris() const
 { return (unsigned int)tris.size(); }
 
 void BasicDrawable::reserveNumPoints(int numPoints)
-{ points.reserve(points.size()+numPoints); }
+{ pointArena.grow(points,points.size()+numPoints); }
 
 void BasicDrawable::reserveNumTris(int numTris)
-{ tris.reserve(tris.size()+numTris); }
+{ triArena.grow(tris,tris.size()+numTris); }
 
 void BasicDrawable::reserveNumTexCoords(unsigned int which,int numCoords)
 {
@@ -662,6 +715,43 @@ void BasicDrawable::addPointToBuffer(unsigned char *basePtr,int which,const Poin
     }
 }
 
+// Interleave all the vertices in one pass per attribute
+void BasicDrawable::addPointsToBuffer(unsigned char *basePtr,int numVerts,const Point3d *center)
+{
+    if (!points.empty())
+    {
+        unsigned char *ptr = basePtr+pointBuffer;
+        if (center)
+        {
+            for (int ii=0;ii<numVerts;ii++,ptr+=vertexSize)
+            {
+                const Point3f &pt = points[ii];
+                Vector4d pt3d;
+                if (hasMatrix)
+                    pt3d = mat * Vector4d(pt.x(),pt.y(),pt.z(),1.0);
+                else
+                    pt3d = Vector4d(pt.x(),pt.y(),pt.z(),1.0);
+                Point3f newPt(pt3d.x()-center->x(),pt3d.y()-center->y(),pt3d.z()-center->z());
+                memcpy(ptr, &newPt.x(), 3*sizeof(GLfloat));
+            }
+        } else {
+            for (int ii=0;ii<numVerts;ii++,ptr+=vertexSize)
+                memcpy(ptr, &points[ii].x(), 3*sizeof(GLfloat));
+        }
+    }
+    
+    for (VertexAttribute *attr : vertexAttributes)
+    {
+        if (attr->numElements() == 0)
+            continue;
+        int attrSize = attr->size();
+        const unsigned char *src = (const unsigned char *)attr->addressForElement(0);
+        unsigned char *ptr = basePtr+attr->buffer;
+        for (int ii=0;ii<numVerts;ii++,ptr+=vertexSize,src+=attrSize)
+            memcpy(ptr, src, attrSize);
+    }
+}
+
 void BasicDrawable::setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *memManager)
 {
     setupGL(setupInfo,memManager,0,0);
@@ -680,9 +770,9 @@ void BasicDrawable::setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *me
     if (drawOffset != 0 && (points.size() == vertexAttributes[normalEntry]->numElements()))
     {
         float scale = setupInfo->minZres*drawOffset;
-        std::vector<Point3f> &norms = *(std::vector<Point3f> *)vertexAttributes[normalEntry]->data;
+        const Point3f *norms = vertexAttributes[normalEntry]->elements<Point3f>();
         
-        for (unsigned int ii=0;ii<points.size();ii++)
+        for (unsigned int ii=0;norms && ii<points.size();ii++)
         {
             Vector3f pt = points[ii];
             points[ii] = norms[ii] * scale + pt;
@@ -726,16 +816,14 @@ void BasicDrawable::setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *me
     else
         glMem = glMapBufferRange(GL_ARRAY_BUFFER, 0, bufferSize, GL_MAP_WRITE_BIT);
     unsigned char *basePtr = (unsigned char *)glMem + sharedBufferOffset;
-    for (unsigned int ii=0;ii<numVerts;ii++,basePtr+=vertexSize)
-        addPointToBuffer(basePtr,ii,NULL);
+    addPointsToBuffer(basePtr,numVerts,NULL);
     
     // And copy in the element buffer
     if (tris.size())
     {
         triBuffer = vertexSize*numVerts;
         unsigned char *basePtr = (unsigned char *)glMem + triBuffer + sharedBufferOffset;
-        for (unsigned int ii=0;ii<tris.size();ii++,basePtr+=sizeof(Triangle))
-            memcpy(basePtr, &tris[ii], sizeof(Triangle));
+        memcpy(basePtr, &tris[0], tris.size()*sizeof(Triangle));
     }
     if (context.API < kEAGLRenderingAPIOpenGLES3)
         glUnmapBufferOES(GL_ARRAY_BUFFER);
@@ -744,11 +832,12 @@ void BasicDrawable::setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *me
     
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     
-    // Clear out the arrays, since we won't need them again
+    // Clear out the arrays, since we won't need them again.
+    // The memory goes back to the arenas for the next drawable.
     numPoints = (int)points.size();
-    points.clear();
+    pointArena.give(points);
     numTris = (int)tris.size();
-    tris.clear();
+    triArena.give(tris);
     for (unsigned int ii=0;ii<vertexAttributes.size();ii++)
         vertexAttributes[ii]->clear();
     
@@ -787,8 +876,8 @@ NSData *BasicDrawable::asData(bool dupStart,bool dupEnd)
             addPointToBuffer(basePtr, 0, NULL);
             basePtr += vertexSize;
         }
-        for (unsigned int ii=0;ii<points.size();ii++,basePtr+=vertexSize)
-            addPointToBuffer(basePtr, ii, NULL);
+        addPointsToBuffer(basePtr, (int)points.size(), NULL);
+        basePtr += vertexSize*points.size();
         if (dupEnd)
         {
             addPointToBuffer(basePtr, (int)(points.size()-1), NULL);
@@ -825,8 +914,7 @@ void BasicDrawable::asVertexAndElementData(NSMutableData **retVertData,NSMutable
     int numVerts = (int)points.size();
     NSMutableData *vertData = [[NSMutableData alloc] initWithBytesNoCopy:(malloc(vertexSize * numVerts)) length:vertexSize*numVerts freeWhenDone:YES];
     unsigned char *basePtr = (unsigned char *)[vertData mutableBytes];
-    for (unsigned int ii=0;ii<points.size();ii++,basePtr+=vertexSize)
-        addPointToBuffer(basePtr, ii, center);
+    addPointsToBuffer(basePtr, numVerts, center);
     
     // Build up the triangles
     int triSize = singleElementSize * 3;
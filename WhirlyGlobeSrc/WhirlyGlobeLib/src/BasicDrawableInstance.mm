@@ -55,6 +55,11 @@ SimpleIdentity BasicDrawableInstance::getProgram() const
     return basicDraw->getProgram();
 }
 
+SimpleIdentity BasicDrawableInstance::getMainTexture() const
+{
+    return basicDraw->getMainTexture();
+}
+
 bool BasicDrawableInstance::isOn(WhirlyKitRendererFrameInfo *frameInfo) const
 {
     if (startEnable != endEnable)
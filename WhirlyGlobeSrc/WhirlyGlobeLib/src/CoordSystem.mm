@@ -49,6 +49,80 @@ Point3d CoordSystemConvert3d(CoordSystem *inSystem,CoordSystem *outSystem,Point3
     return outPt;
 }
     
+void CoordSystemConvert3d(CoordSystem *inSystem,CoordSystem *outSystem,const Point3d *inCoords,Point3d *outCoords,int count)
+{
+    if (count <= 0)
+        return;
+    
+    if (inSystem->isSameAs(outSystem))
+    {
+        if (inCoords != outCoords)
+            std::copy(inCoords,inCoords+count,outCoords);
+        return;
+    }
+    
+    // If both sides get to geocentric through lat/lon, we can go through lat/lon instead
+    //  and skip the round trip.  The height passes straight through either way.
+    if (inSystem->geocentricViaGeographic() && outSystem->geocentricViaGeographic())
+    {
+        std::vector<Point2d> geoPts(count);
+        std::vector<double> heights(count);
+        for (int ii=0;ii<count;ii++)
+            heights[ii] = inCoords[ii].z();
+        inSystem->localToGeographic(inCoords,&geoPts[0],count);
+        outSystem->geographicToLocal(&geoPts[0],outCoords,count);
+        for (int ii=0;ii<count;ii++)
+            outCoords[ii].z() = heights[ii];
+        return;
+    }
+    
+    // Same route as the single point version, but each system gets the whole array
+    inSystem->localToGeocentric(inCoords,outCoords,count);
+    outSystem->geocentricToLocal(outCoords,outCoords,count);
+}
+    
+void CoordSystem::localToGeographic(const Point3d *inPts,Point2d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = localToGeographicD(inPts[ii]);
+}
+
+void CoordSystem::geographicToLocal(const Point2d *inPts,Point3d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = geographicToLocal(inPts[ii]);
+}
+
+void CoordSystem::localToGeocentric(const Point3d *inPts,Point3d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = localToGeocentric(inPts[ii]);
+}
+
+void CoordSystem::geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = geocentricToLocal(inPts[ii]);
+}
+    
+void CoordSystemDisplayAdapter::localToDisplay(const Point3f *inPts,Point3f *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = localToDisplay(inPts[ii]);
+}
+
+void CoordSystemDisplayAdapter::localToDisplay(const Point3d *inPts,Point3d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = localToDisplay(inPts[ii]);
+}
+
+void CoordSystemDisplayAdapter::displayToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = displayToLocal(inPts[ii]);
+}
+    
 void CoordSystemDisplayAdapter::setScale(const Point3d &newScale)
 {
     scale = newScale;
@@ -120,4 +194,19 @@ WhirlyKit::Point3d GeneralCoordSystemDisplayAdapter::displayToLocal(WhirlyKit::P
     return localPt;
 }
     
+void GeneralCoordSystemDisplayAdapter::localToDisplay(const Point3f *inPts,Point3f *outPts,int count)
+{
+    ScaleOffsetPoints(inPts,outPts,count,Point3f(scale.x(),scale.y(),scale.z()),Point3f(-center.x(),-center.y(),-center.z()));
+}
+
+void GeneralCoordSystemDisplayAdapter::localToDisplay(const Point3d *inPts,Point3d *outPts,int count)
+{
+    ScaleOffsetPoints(inPts,outPts,count,scale,Point3d(-center));
+}
+
+void GeneralCoordSystemDisplayAdapter::displayToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    ScaleOffsetPoints(inPts,outPts,count,Point3d(1.0/scale.x(),1.0/scale.y(),1.0/scale.z()),center);
+}
+    
 }
@@ -18,228 +18,536 @@
  *
  */
 
-#import "GlobeScene.h"
-#import "GlobeMath.h"
+#import <string.h>
+#import <algorithm>
+#import <limits>
+#import "Cullable.h"
 
 namespace WhirlyKit
 {
     
+CullView::CullView(const Eigen::Matrix4d &modelTrans,double nearPlane,const Point2d &frustLL,const Point2d &frustUR,
+                   const Point2f &frameSize,const Mbr &screenMbr,const Eigen::Vector3f &eyeVec)
+    : screenMbr(screenMbr), eyeVec(eyeVec)
+{
+    // Project relative to the eye so we're not subtracting big numbers close in
+    Eigen::Vector4d eyePos = modelTrans.inverse() * Eigen::Vector4d(0.0,0.0,0.0,1.0);
+    for (unsigned int ii=0;ii<3;ii++)
+        origin[ii] = eyePos[ii] / eyePos.w();
+    for (unsigned int row=0;row<3;row++)
+    {
+        for (unsigned int col=0;col<3;col++)
+            rows[row][col] = modelTrans(row,col);
+        rowOrigin[row] = modelTrans(row,0) * origin[0] + modelTrans(row,1) * origin[1] + modelTrans(row,2) * origin[2] + modelTrans(row,3);
+    }
+    
+    // Intersect with the near plane and scale to the frame, as pointOnScreenFromSphere does
+    double width = frustUR.x() - frustLL.x(), height = frustUR.y() - frustLL.y();
+    scaleX = -nearPlane * frameSize.x() / width;
+    offsetX = -frustLL.x() * frameSize.x() / width;
+    scaleY = nearPlane * frameSize.y() / height;
+    offsetY = frameSize.y() + frustLL.y() * frameSize.y() / height;
+}
+
 CullTree::CullTree(WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth,int maxDrawPerNode)
-    : coordAdapter(coordAdapter), depth(depth), numCullables(0), maxDrawPerNode(maxDrawPerNode)
+    : coordAdapter(coordAdapter), maxDrawPerNode(maxDrawPerNode), numNodes(1), curMark(0)
 {
-    topCullable = new Cullable(coordAdapter,localMbr,depth);
+    // The top lives by itself in the first block
+    blocks.resize(1);
+    nodes.resize(4);
+    for (unsigned int ii=0;ii<4;ii++)
+    {
+        Node &node = nodes[ii];
+        node.height = -1;
+        node.parent = -1;
+        node.childBlock = -1;
+        node.count = 0;
+    }
+    nodes[0].localMbr = localMbr;
+    nodes[0].height = depth;
+    setupBlock(0);
 }
     
 CullTree::~CullTree()
 {
-    delete topCullable;
 }
 
-   void CullTree::dumpStats()
+// Work out the corners and normals for the nodes in a block
+void CullTree::setupBlock(int block)
 {
-    NSLog(@"CullTree: %d nodes",topCullable->countNodes());
+    NodeBlock &theBlock = blocks[block];
+    memset(&theBlock,0,sizeof(NodeBlock));
+    
+    // Put together the extreme points for all of them and convert in one go
+    Point3f pts[4*8];
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        const Mbr &localMbr = nodes[block*4+lane].localMbr;
+        Point3f *nodePts = &pts[lane*8];
+        Point2f halfBot = (localMbr.ll() + Point2f(localMbr.ur().x(),localMbr.ll().y()))/2.0;
+        Point2f halfTop = (Point2f(localMbr.ll().x(),localMbr.ur().y()) + localMbr.ur())/2.0;
+        Point2f halfLeft = (localMbr.ll() + Point2f(localMbr.ll().x(),localMbr.ur().y()))/2.0;
+        Point2f halfRight = (Point2f(localMbr.ur().x(),localMbr.ll().y()) + localMbr.ur())/2.0;
+        nodePts[0] = Point3f(localMbr.ll().x(),localMbr.ll().y(),0.0);
+        nodePts[1] = Point3f(localMbr.ur().x(),localMbr.ll().y(),0.0);
+        nodePts[2] = Point3f(localMbr.ur().x(),localMbr.ur().y(),0.0);
+        nodePts[3] = Point3f(localMbr.ll().x(),localMbr.ur().y(),0.0);
+        nodePts[4] = Point3f(halfBot.x(),halfBot.y(),0.0);
+        nodePts[5] = Point3f(halfTop.x(),halfTop.y(),0.0);
+        nodePts[6] = Point3f(halfLeft.x(),halfLeft.y(),0.0);
+        nodePts[7] = Point3f(halfRight.x(),halfRight.y(),0.0);
+    }
+    coordAdapter->localToDisplay(pts,pts,4*8);
+    
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        if (nodes[block*4+lane].height < 0)
+            continue;
+        const Point3f *nodePts = &pts[lane*8];
+        
+        // Bounding box in 3-space
+        Point3f minPt,maxPt;
+        minPt = maxPt = nodePts[0];
+        for (unsigned int ii=1;ii<8;ii++)
+        {
+            const Point3f &pt = nodePts[ii];
+            minPt.x() = std::min(minPt.x(),pt.x());
+            minPt.y() = std::min(minPt.y(),pt.y());
+            minPt.z() = std::min(minPt.z(),pt.z());
+            maxPt.x() = std::max(maxPt.x(),pt.x());
+            maxPt.y() = std::max(maxPt.y(),pt.y());
+            maxPt.z() = std::max(maxPt.z(),pt.z());
+        }
+        theBlock.minX[lane] = minPt.x();  theBlock.minY[lane] = minPt.y();  theBlock.minZ[lane] = minPt.z();
+        theBlock.maxX[lane] = maxPt.x();  theBlock.maxY[lane] = maxPt.y();  theBlock.maxZ[lane] = maxPt.z();
+        
+        // Use just 4 of the normals
+        for (unsigned int ii=0;ii<WhirlyKitCullableCornerNorms;ii++)
+        {
+            theBlock.normX[ii][lane] = nodePts[ii].x();
+            theBlock.normY[ii][lane] = nodePts[ii].y();
+            theBlock.normZ[ii][lane] = nodePts[ii].z();
+        }
+    }
 }
     
-Cullable::Cullable(WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth)
-    : localMbr(localMbr)
+// Make the four children for a node
+int CullTree::addBlock(int parent)
 {
-    height = depth;
+    int block;
+    if (freeBlocks.empty())
+    {
+        block = (int)blocks.size();
+        blocks.resize(blocks.size()+1);
+        nodes.resize(nodes.size()+4);
+    } else {
+        block = freeBlocks.back();
+        freeBlocks.pop_back();
+    }
     
-    for (unsigned int ii=0;ii<4;ii++)
-        children[ii] = NULL;
-    
-    // Put together the extreme points
-    Point3f pts[8];
-    pts[0] = coordAdapter->localToDisplay(Point3f(localMbr.ll().x(),localMbr.ll().y(),0.0));
-    pts[1] = coordAdapter->localToDisplay(Point3f(localMbr.ur().x(),localMbr.ll().y(),0.0));
-    pts[2] = coordAdapter->localToDisplay(Point3f(localMbr.ur().x(),localMbr.ur().y(),0.0));
-    pts[3] = coordAdapter->localToDisplay(Point3f(localMbr.ll().x(),localMbr.ur().y(),0.0));
-    Point2f halfBot = (localMbr.ll() + Point2f(localMbr.ur().x(),localMbr.ll().y()))/2.0;
-    pts[4] = coordAdapter->localToDisplay(Point3f(halfBot.x(),halfBot.y(),0.0));
-    Point2f halfTop = (Point2f(localMbr.ll().x(),localMbr.ur().y()) + localMbr.ur())/2.0;
-    pts[5] = coordAdapter->localToDisplay(Point3f(halfTop.x(),halfTop.y(),0.0));
-    Point2f halfLeft = (localMbr.ll() + Point2f(localMbr.ll().x(),localMbr.ur().y()))/2.0;
-    pts[6] = coordAdapter->localToDisplay(Point3f(halfLeft.x(),halfLeft.y(),0.0));
-    Point2f halfRight = (Point2f(localMbr.ur().x(),localMbr.ll().y()) + localMbr.ur())/2.0;
-    pts[7] = coordAdapter->localToDisplay(Point3f(halfRight.x(),halfRight.y(),0.0));
-    
-    // Now get the bounding box in 3-space
-    Point3f minPt,maxPt;
-    minPt = maxPt = pts[0];
-    for (unsigned int ii=1;ii<8;ii++)
-    {
-        const Point3f &pt = pts[ii];
-        minPt.x() = std::min(minPt.x(),pt.x());
-        minPt.y() = std::min(minPt.y(),pt.y());
-        minPt.z() = std::min(minPt.z(),pt.z());
-        maxPt.x() = std::max(maxPt.x(),pt.x());
-        maxPt.y() = std::max(maxPt.y(),pt.y());
-        maxPt.z() = std::max(maxPt.z(),pt.z());
-    }
-//    Point3f midPt = (minPt+maxPt)/2.0;
-//    minPt += 0.1 * (minPt - midPt);
-//    maxPt += 0.1 * (maxPt - midPt);
-    
-    // Turn this into a cube for evaluation by the culling logic
-    cornerPoints[0] = Point3f(minPt.x(),minPt.y(),minPt.z());
-    cornerPoints[1] = Point3f(maxPt.x(),minPt.y(),minPt.z());
-    cornerPoints[2] = Point3f(maxPt.x(),maxPt.y(),minPt.z());
-    cornerPoints[3] = Point3f(minPt.x(),maxPt.y(),minPt.z());
-    cornerPoints[4] = Point3f(minPt.x(),minPt.y(),maxPt.z());
-    cornerPoints[5] = Point3f(maxPt.x(),minPt.y(),maxPt.z());
-    cornerPoints[6] = Point3f(maxPt.x(),maxPt.y(),maxPt.z());
-    cornerPoints[7] = Point3f(minPt.x(),maxPt.y(),maxPt.z());
-    
-    // Use just 4 of the normals
-    for (unsigned int ii=0;ii<4;ii++)
-        cornerNorms[ii] = pts[ii];
+    const Mbr parentMbr = nodes[parent].localMbr;
+    Point2f mid = (parentMbr.ur()+parentMbr.ll())/2.0;
+    Mbr childMbr[4];
+    childMbr[0] = Mbr(parentMbr.ll(),mid);
+    childMbr[1] = Mbr(Point2f(mid.x(),parentMbr.ll().y()),Point2f(parentMbr.ur().x(),mid.y()));
+    childMbr[2] = Mbr(Point2f(parentMbr.ll().x(),mid.y()),Point2f(mid.x(),parentMbr.ur().y()));
+    childMbr[3] = Mbr(mid,parentMbr.ur());
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        Node &node = nodes[block*4+lane];
+        node.localMbr = childMbr[lane];
+        node.height = nodes[parent].height-1;
+        node.parent = parent;
+        node.childBlock = -1;
+        node.count = 0;
+        node.slots.clear();
+        node.entries.clear();
+    }
+    setupBlock(block);
+    numNodes += 4;
     
-    // Set the child bounding boxes as well
-    // We use these to check for overlap without creating a child
-    Point2f mid = (localMbr.ur()+localMbr.ll())/2.0;
-    childMbr[0] = Mbr(localMbr.ll(),mid);
-    childMbr[1] = Mbr(Point2f(mid.x(),localMbr.ll().y()),Point2f(localMbr.ur().x(),mid.y()));
-    childMbr[2] = Mbr(Point2f(localMbr.ll().x(),mid.y()),Point2f(mid.x(),localMbr.ur().y()));
-    childMbr[3] = Mbr(mid,localMbr.ur());
+    return block;
 }
     
-Cullable::~Cullable()
+void CullTree::freeBlock(int block)
 {
-    for (unsigned int ii=0;ii<4;ii++)
-        if (children[ii])
-            delete children[ii];
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        Node &node = nodes[block*4+lane];
+        if (node.childBlock >= 0)
+            freeBlock(node.childBlock);
+        node.childBlock = -1;
+        node.height = -1;
+        node.count = 0;
+        node.slots.clear();
+        node.entries.clear();
+    }
+    freeBlocks.push_back(block);
+    numNodes -= 4;
 }
     
-// Return an existing child if it's there or make a new one
-Cullable *Cullable::getOrAddChild(int which, CullTree *cullTree)
+int CullTree::newEntry(int slot,const Mbr &localMbr,bool canMove)
 {
-    if (height == 0)
-        return NULL;
+    int entry;
+    if (freeEntries.empty())
+    {
+        entry = (int)entryList.size();
+        entryList.resize(entryList.size()+1);
+    } else {
+        entry = freeEntries.back();
+        freeEntries.pop_back();
+    }
+    
+    if ((size_t)slot >= slotEntries.size())
+        slotEntries.resize(slot+1,-1);
+    Entry &theEntry = entryList[entry];
+    theEntry.slot = slot;
+    theEntry.node = -1;
+    theEntry.pos = -1;
+    theEntry.localMbr = localMbr;
+    theEntry.canMove = canMove;
+    theEntry.next = slotEntries[slot];
+    slotEntries[slot] = entry;
+    
+    return entry;
+}
     
-    if (children[which])
-        return children[which];
+void CullTree::freeEntry(int entry)
+{
+    int slot = entryList[entry].slot;
+    int *prev = &slotEntries[slot];
+    while (*prev != entry)
+        prev = &entryList[*prev].next;
+    *prev = entryList[entry].next;
     
-    children[which] = new Cullable(cullTree->coordAdapter,childMbr[which],height-1);
-    cullTree->numCullables++;
+    entryList[entry].node = -1;
+    freeEntries.push_back(entry);
+}
     
-    return children[which];
+void CullTree::attachEntry(int entry,int node)
+{
+    Node &theNode = nodes[node];
+    Entry &theEntry = entryList[entry];
+    theEntry.node = node;
+    theEntry.pos = (int)theNode.slots.size();
+    theNode.slots.push_back(theEntry.slot);
+    theNode.entries.push_back(entry);
+    for (int which = node;which >= 0;which = nodes[which].parent)
+        nodes[which].count++;
 }
     
-// Remove a child if it's empty
-void Cullable::possibleRemoveChild(int which, CullTree *cullTree)
+void CullTree::detachEntry(int entry)
 {
-    if (children[which])
+    Entry &theEntry = entryList[entry];
+    Node &theNode = nodes[theEntry.node];
+    int last = (int)theNode.slots.size()-1;
+    if (theEntry.pos != last)
     {
-        if (!children[which]->hasChildren() && children[which]->isEmpty())
-        {
-            delete children[which];
-            children[which] = NULL;
-            cullTree->numCullables--;
-        }
+        theNode.slots[theEntry.pos] = theNode.slots[last];
+        theNode.entries[theEntry.pos] = theNode.entries[last];
+        entryList[theNode.entries[last]].pos = theEntry.pos;
     }
+    theNode.slots.pop_back();
+    theNode.entries.pop_back();
+    for (int which = theEntry.node;which >= 0;which = nodes[which].parent)
+        nodes[which].count--;
+    theEntry.node = -1;
 }
-    
-// Split the existing node into 4 and sort all the drawables
-void Cullable::split(CullTree *cullTree)
+
+// Put an entry in the given node or sort it into the children
+void CullTree::addEntry(int entry,int node)
 {
-    for (std::set<DrawableRef,IdentifiableRefSorter>::iterator it = drawables.begin();
-         it != drawables.end(); ++it)
     {
-        DrawableRef draw = *it;
-        // Note: This doesn't take the geographic case into account
-        Mbr localMbr = draw->getLocalMbr();
+        const Entry &theEntry = entryList[entry];
+        const Node &theNode = nodes[node];
+        
+        // If it's got a matrix, that can be changed and we have no clue where it might end up
+        // Same for drawables without a valid local MBR
+        // And if the drawable is as big as a child, it just goes here.  Otherwise big ones would end up in every leaf they touch.
+        if (theEntry.canMove || !theEntry.localMbr.valid() || theNode.height <= 0 ||
+            Mbr(theNode.localMbr).contained(theEntry.localMbr) ||
+            2*(theEntry.localMbr.ur().x()-theEntry.localMbr.ll().x()) >= theNode.localMbr.ur().x()-theNode.localMbr.ll().x() ||
+            2*(theEntry.localMbr.ur().y()-theEntry.localMbr.ll().y()) >= theNode.localMbr.ur().y()-theNode.localMbr.ll().y())
+        {
+            attachEntry(entry,node);
+            return;
+        }
         
-        addDrawableToChildren(cullTree,localMbr,draw);
+        // Might need to split it
+        if (theNode.childBlock < 0)
+        {
+            if (theNode.slots.size() < (size_t)maxDrawPerNode)
+            {
+                attachEntry(entry,node);
+                return;
+            }
+            split(node);
+        }
     }
+
+    // It gets an entry in each child it overlaps
+    int block = nodes[node].childBlock;
+    int slot = entryList[entry].slot;
+    Mbr localMbr = entryList[entry].localMbr;
+    bool canMove = entryList[entry].canMove;
+    bool placed = false;
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        if (nodes[block*4+lane].localMbr.overlaps(localMbr))
+        {
+            addEntry(placed ? newEntry(slot,localMbr,canMove) : entry,block*4+lane);
+            placed = true;
+        }
+    }
+    if (!placed)
+        attachEntry(entry,node);
+}
+
+// Split the existing node into 4 and sort the drawables into them
+void CullTree::split(int node)
+{
+    int block = addBlock(node);
+    nodes[node].childBlock = block;
     
-    drawables.clear();
+    std::vector<int> entries = nodes[node].entries;
+    for (int entry : entries)
+    {
+        detachEntry(entry);
+        addEntry(entry,node);
+    }
 }
     
-void Cullable::addDrawableToChildren(CullTree *cullTree,Mbr drawLocalMbr,DrawableRef draw)
+// Pull everything in the children back into the node and get rid of them
+void CullTree::collapse(int node)
 {
-    for (unsigned int ii=0;ii<4;ii++)
+    int block = nodes[node].childBlock;
+    if (block < 0)
+        return;
+    
+    for (unsigned int lane=0;lane<4;lane++)
     {
-        if (childMbr[ii].overlaps(drawLocalMbr))
+        int child = block*4+lane;
+        collapse(child);
+        std::vector<int> entries = nodes[child].entries;
+        for (int entry : entries)
         {
-            Cullable *child = getOrAddChild(ii, cullTree);
-            child->addDrawable(cullTree,drawLocalMbr,draw);            
+            detachEntry(entry);
+            
+            // The same bounding box may have gone into more than one child
+            const Entry &theEntry = entryList[entry];
+            bool dup = false;
+            for (int other : nodes[node].entries)
+            {
+                const Entry &otherEntry = entryList[other];
+                if (otherEntry.slot == theEntry.slot &&
+                    otherEntry.localMbr.ll() == theEntry.localMbr.ll() && otherEntry.localMbr.ur() == theEntry.localMbr.ur())
+                {
+                    dup = true;
+                    break;
+                }
+            }
+            if (dup)
+                freeEntry(entry);
+            else
+                attachEntry(entry,node);
         }
     }
+    
+    freeBlock(block);
+    nodes[node].childBlock = -1;
 }
+
+// Prune the children if they fall below a certain threshold
+void CullTree::checkCollapse(int node)
+{
+    int toCollapse = -1;
+    for (int which = node;which >= 0;which = nodes[which].parent)
+        if (nodes[which].childBlock >= 0 && nodes[which].count < maxDrawPerNode)
+            toCollapse = which;
     
-void Cullable::addDrawable(CullTree *cullTree,Mbr drawLocalMbr,DrawableRef draw)
+    if (toCollapse >= 0)
+        collapse(toCollapse);
+}
+    
+void CullTree::addDrawable(int slot,const Mbr &localMbr,bool canMove)
 {
-    // Will be present in the children (or here)
-    childDrawables.insert(draw);
+    if (slot < 0)
+        return;
     
-    // If it's got a matrix, that can be changed and we have no clue where it might end up
-    // Same for drawables without a valid local MBR
-    if (draw->getMatrix() || !drawLocalMbr.valid())
-    {
-        drawables.insert(draw);
+    addEntry(newEntry(slot,localMbr,canMove),0);
+}
+    
+void CullTree::remDrawable(int slot)
+{
+    if (slot < 0 || (size_t)slot >= slotEntries.size())
         return;
+    
+    std::vector<int> entries;
+    for (int entry = slotEntries[slot];entry >= 0;entry = entryList[entry].next)
+        entries.push_back(entry);
+    
+    for (int entry : entries)
+    {
+        // May have been merged into another one when the tree collapsed
+        int node = entryList[entry].node;
+        if (node < 0)
+            continue;
+        detachEntry(entry);
+        freeEntry(entry);
+        checkCollapse(node);
     }
-
-    // Might need to split it
-    if (drawables.size() > cullTree->maxDrawPerNode && height > 0)
+}
+    
+// Test all four nodes in a block against the view.
+// These are written lane by lane so they turn into vector instructions.
+void CullTree::testBlock(const NodeBlock &block,const CullView &view,bool checkBackfaces,bool inView[4],float area[4])
+{
+    // Check the four corners of the cullable to see if they're pointed away
+    // But just for the globe case
+    if (checkBackfaces)
+    {
+        for (unsigned int lane=0;lane<4;lane++)
+            inView[lane] = false;
+        for (unsigned int ii=0;ii<WhirlyKitCullableCornerNorms;ii++)
+            for (unsigned int lane=0;lane<4;lane++)
+            {
+                float dot = block.normX[ii][lane] * view.eyeVec.x() + block.normY[ii][lane] * view.eyeVec.y() + block.normZ[ii][lane] * view.eyeVec.z();
+                inView[lane] = inView[lane] || (dot > 0.0);
+            }
+    } else {
+        for (unsigned int lane=0;lane<4;lane++)
+            inView[lane] = true;
+    }
+    
+    // What each side of the box adds to X, Y and Z
+    float sideX[3][2][4],sideY[3][2][4],sideZ[3][2][4];
+    for (unsigned int row=0;row<3;row++)
+        for (unsigned int lane=0;lane<4;lane++)
+        {
+            sideX[row][0][lane] = view.rows[row][0] * (block.minX[lane] - view.origin[0]);
+            sideX[row][1][lane] = view.rows[row][0] * (block.maxX[lane] - view.origin[0]);
+            sideY[row][0][lane] = view.rows[row][1] * (block.minY[lane] - view.origin[1]);
+            sideY[row][1][lane] = view.rows[row][1] * (block.maxY[lane] - view.origin[1]);
+            sideZ[row][0][lane] = view.rows[row][2] * (block.minZ[lane] - view.origin[2]);
+            sideZ[row][1][lane] = view.rows[row][2] * (block.maxZ[lane] - view.origin[2]);
+        }
+    
+    // Project the eight corners and take the bounding box on the screen
+    float minSX[4],minSY[4],maxSX[4],maxSY[4];
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        minSX[lane] = minSY[lane] = std::numeric_limits<float>::max();
+        maxSX[lane] = maxSY[lane] = -std::numeric_limits<float>::max();
+    }
+    for (unsigned int corner=0;corner<WhirlyKitCullableCorners;corner++)
     {
-        drawables.insert(draw);
-        split(cullTree);
+        unsigned int ix = corner & 1, iy = (corner >> 1) & 1, iz = (corner >> 2) & 1;
+        for (unsigned int lane=0;lane<4;lane++)
+        {
+            float x = view.rowOrigin[0] + sideX[0][ix][lane] + sideY[0][iy][lane] + sideZ[0][iz][lane];
+            float y = view.rowOrigin[1] + sideX[1][ix][lane] + sideY[1][iy][lane] + sideZ[1][iz][lane];
+            float z = view.rowOrigin[2] + sideX[2][ix][lane] + sideY[2][iy][lane] + sideZ[2][iz][lane];
+            float sx = view.scaleX * x / z + view.offsetX;
+            float sy = view.scaleY * y / z + view.offsetY;
+            minSX[lane] = std::min(minSX[lane],sx);  maxSX[lane] = std::max(maxSX[lane],sx);
+            minSY[lane] = std::min(minSY[lane],sy);  maxSY[lane] = std::max(maxSY[lane],sy);
+        }
     }
     
-    // The drawable is bigger than this node, so just stick it here
-    if (localMbr.contained(drawLocalMbr))
-        drawables.insert(draw);
-    else {
-        // If there are children, sort it into those, maybe
-        if (hasChildren())
-            addDrawableToChildren(cullTree, drawLocalMbr, draw);
-        else
-            // This is where it nominally lives
-            drawables.insert(draw);
+    // If this doesn't overlap what we're viewing, we're done
+    const Point2f &screenLL = view.screenMbr.ll(), &screenUR = view.screenMbr.ur();
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        bool overlaps = minSX[lane] <= screenUR.x() && screenLL.x() <= maxSX[lane] && minSY[lane] <= screenUR.y() && screenLL.y() <= maxSY[lane];
+        inView[lane] = inView[lane] && overlaps;
+        area[lane] = (maxSX[lane] - minSX[lane]) * (maxSY[lane] - minSY[lane]);
     }
 }
     
-void Cullable::remDrawable(CullTree *cullTree,Mbr drawLocalMbr,DrawableRef draw)
+// Drawables can be in more than one node, so we mark them as we go
+void CullTree::addSlots(const Node &theNode,std::vector<int> &slots,int *considered)
 {
-    // Remove it from here
-    childDrawables.erase(draw);
-    drawables.erase(draw);
-    
-    // Remove from the appropriate children
-    if (height > 0)
-    {
-        for (unsigned int ii=0;ii<4;ii++)
+    *considered += theNode.slots.size();
+    for (int slot : theNode.slots)
+        if (slotMarks[slot] != curMark)
         {
-            if (children[ii] && childMbr[ii].overlaps(drawLocalMbr))
-            {
-                children[ii]->remDrawable(cullTree,drawLocalMbr,draw);            
-                possibleRemoveChild(ii, cullTree);
-            }
+            slotMarks[slot] = curMark;
+            slots.push_back(slot);
         }
+}
+
+void CullTree::startMarks()
+{
+    if (slotMarks.size() < slotEntries.size())
+        slotMarks.resize(slotEntries.size(),curMark);
+    curMark++;
+    if (curMark == 0)
+    {
+        std::fill(slotMarks.begin(),slotMarks.end(),0);
+        curMark = 1;
     }
+}
+
+void CullTree::addSubtree(int node,std::vector<int> &slots,int *considered)
+{
+    const Node &theNode = nodes[node];
+    addSlots(theNode,slots,considered);
+    if (theNode.childBlock >= 0)
+        for (unsigned int lane=0;lane<4;lane++)
+        {
+            int child = theNode.childBlock*4+lane;
+            if (nodes[child].count > 0)
+                addSubtree(child,slots,considered);
+        }
+}
+    
+void CullTree::findInChildren(int node,const CullView &view,bool checkBackfaces,float screenArea,std::vector<int> &slots,int *considered)
+{
+    int block = nodes[node].childBlock;
+    if (block < 0)
+        return;
     
-    // Prune the children if they fall below a certain threshold
-    if (childDrawables.size() < cullTree->maxDrawPerNode)
+    bool inView[4];
+    float area[4];
+    testBlock(blocks[block],view,checkBackfaces,inView,area);
+    for (unsigned int lane=0;lane<4;lane++)
     {
-        drawables = childDrawables;
-        for (unsigned int ii=0;ii<4;ii++)
-            if (children[ii])
-            {
-                delete children[ii];
-                children[ii] = NULL;
-            }
+        int child = block*4+lane;
+        const Node &theNode = nodes[child];
+        if (!inView[lane] || theNode.count == 0)
+            continue;
+        
+        // If the footprint of this level on the screen is larger than
+        //  the screen area, keep going down (if we can).
+        if (area[lane] > screenArea/4 && theNode.childBlock >= 0)
+        {
+            addSlots(theNode,slots,considered);
+            findInChildren(child,view,checkBackfaces,screenArea,slots,considered);
+        } else
+            // If not, then just return what we found here
+            addSubtree(child,slots,considered);
     }
 }
 
-int Cullable::countNodes() const
+void CullTree::findDrawables(const CullView &view,std::vector<int> &slots,int *considered)
 {
-    int count = 1;
-    for (unsigned int ii=0;ii<4;ii++)
-        if (children[ii])
-            count += children[ii]->countNodes();
+    // The top level is never backface culled, but it does have to be on the screen
+    bool inView[4];
+    float area[4];
+    testBlock(blocks[0],view,false,inView,area);
+    if (!inView[0] || nodes[0].count == 0)
+        return;
     
-    return count;
+    startMarks();
+    addSlots(nodes[0],slots,considered);
+    findInChildren(0,view,!coordAdapter->isFlat(),view.screenMbr.area(),slots,considered);
+}
+    
+void CullTree::getAllDrawables(std::vector<int> &slots)
+{
+    int considered = 0;
+    startMarks();
+    addSubtree(0,slots,&considered);
 }
 
 }
@@ -0,0 +1,271 @@
+/*
+ *  DrawList.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <algorithm>
+#import "DrawList.h"
+
+namespace WhirlyKit
+{
+
+// Bits of the program and texture IDs we keep in the key
+static const int ProgramBits = 15;
+static const int TextureBits = 16;
+
+DrawList::DrawList()
+    : numStale(0), numDrawables(0), frame(0)
+{
+}
+
+uint64_t DrawList::makeKey(unsigned int drawPriority,bool requestZBuffer,SimpleIdentity programID,SimpleIdentity texID)
+{
+    uint64_t key = (uint64_t)drawPriority << 32;
+    if (requestZBuffer)
+        key |= (uint64_t)1 << (ProgramBits+TextureBits);
+    key |= (uint64_t)(programID & ((1<<ProgramBits)-1)) << TextureBits;
+    key |= (uint64_t)(texID & ((1<<TextureBits)-1));
+
+    return key;
+}
+
+int DrawList::addDrawable(Drawable *draw,uint64_t key)
+{
+    int slot;
+    if (freeSlots.empty())
+    {
+        slot = (int)slots.size();
+        slots.resize(slots.size()+1);
+        Slot &newSlot = slots[slot];
+        newSlot.version = 0;
+    } else {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+
+    Slot &theSlot = slots[slot];
+    theSlot.draw = draw;
+    theSlot.key = key;
+    theSlot.version++;
+    theSlot.frame = frame-1;
+    theSlot.pass = -1;
+    theSlot.hasAlpha = false;
+    theSlot.firstVisible = theSlot.lastVisible = -1;
+    added.push_back(Entry(key,slot,theSlot.version));
+    numDrawables++;
+
+    return slot;
+}
+
+void DrawList::removeDrawable(int slot)
+{
+    if (slot < 0 || (size_t)slot >= slots.size() || !slots[slot].draw)
+        return;
+
+    // Bumping the version leaves the entry in the order out of date, so the slot can be reused right away
+    Slot &theSlot = slots[slot];
+    theSlot.draw = NULL;
+    theSlot.version++;
+    theSlot.frame = frame-1;
+    freeSlots.push_back(slot);
+    numStale++;
+    numDrawables--;
+}
+
+void DrawList::clear()
+{
+    slots.clear();
+    freeSlots.clear();
+    order.clear();
+    added.clear();
+    visibleSlots.clear();
+    visible.clear();
+    extras.clear();
+    numStale = 0;
+    numDrawables = 0;
+}
+
+void DrawList::startFrame()
+{
+    frame++;
+    visibleSlots.clear();
+    visible.clear();
+    extras.clear();
+}
+
+bool DrawList::addVisible(int slot,int pass,uint64_t key,bool hasAlpha,int container)
+{
+    if (slot < 0 || (size_t)slot >= slots.size() || !slots[slot].draw)
+        return false;
+
+    Slot &theSlot = slots[slot];
+    if (theSlot.frame != frame)
+    {
+        theSlot.frame = frame;
+        theSlot.firstVisible = theSlot.lastVisible = -1;
+        visibleSlots.push_back(slot);
+    } else if (theSlot.pass == pass)
+        return false;
+    theSlot.pass = pass;
+    theSlot.hasAlpha = hasAlpha;
+
+    // Priority or program changed, so it moves
+    if (theSlot.key != key)
+    {
+        theSlot.key = key;
+        theSlot.version++;
+        added.push_back(Entry(key,slot,theSlot.version));
+        numStale++;
+    }
+
+    Visible vis;
+    vis.container = container;
+    vis.next = -1;
+    int which = (int)visible.size();
+    visible.push_back(vis);
+    if (theSlot.lastVisible >= 0)
+        visible[theSlot.lastVisible].next = which;
+    else
+        theSlot.firstVisible = which;
+    theSlot.lastVisible = which;
+
+    return true;
+}
+
+void DrawList::addExtra(uint64_t key,bool hasAlpha,int container)
+{
+    Extra extra;
+    extra.key = key;
+    extra.hasAlpha = hasAlpha;
+    extra.container = container;
+    extras.push_back(extra);
+}
+
+bool DrawList::isCurrent(const Entry &entry) const
+{
+    const Slot &theSlot = slots[entry.slot];
+    return theSlot.draw && theSlot.version == entry.version;
+}
+
+// Entries we'll put up with before merging or compacting, even if we're not walking the order
+static const size_t MinPendingEntries = 256;
+
+bool DrawList::orderNeedsUpdate() const
+{
+    return added.size() + numStale > std::max(order.size()/8,MinPendingEntries);
+}
+
+void DrawList::updateOrder()
+{
+    // Out of date entries are skipped on the way through, so we only clean them up once there are enough of them
+    bool compact = numStale > 0 && (!added.empty() || numStale*8 > order.size());
+    if (compact)
+    {
+        std::vector<Entry>::iterator newEnd = order.begin();
+        for (std::vector<Entry>::iterator it = order.begin(); it != order.end(); ++it)
+            if (isCurrent(*it))
+                *newEnd++ = *it;
+        order.erase(newEnd,order.end());
+        numStale = 0;
+    }
+
+    if (!added.empty())
+    {
+        // A drawable can be re-keyed more than once between merges
+        std::vector<Entry>::iterator newEnd = added.begin();
+        for (std::vector<Entry>::iterator it = added.begin(); it != added.end(); ++it)
+            if (isCurrent(*it))
+                *newEnd++ = *it;
+        added.erase(newEnd,added.end());
+
+        std::sort(added.begin(),added.end());
+        size_t oldSize = order.size();
+        order.insert(order.end(),added.begin(),added.end());
+        std::inplace_merge(order.begin(),order.begin()+oldSize,order.end());
+        added.clear();
+    }
+}
+
+void DrawList::appendVisible(bool checkAlpha,bool alpha,std::vector<int> &containers)
+{
+    unsigned int whichExtra = 0;
+    for (unsigned int ii=0;ii<visibleSlots.size();ii++)
+    {
+        const Slot &theSlot = slots[visibleSlots[ii]];
+        if (checkAlpha && theSlot.hasAlpha != alpha)
+            continue;
+
+        // Anything extra that goes first
+        for (;whichExtra < extras.size() && extras[whichExtra].key < theSlot.key;whichExtra++)
+            if (!checkAlpha || extras[whichExtra].hasAlpha == alpha)
+                containers.push_back(extras[whichExtra].container);
+
+        for (int which = theSlot.firstVisible;which >= 0;which = visible[which].next)
+            containers.push_back(visible[which].container);
+    }
+
+    for (;whichExtra < extras.size();whichExtra++)
+        if (!checkAlpha || extras[whichExtra].hasAlpha == alpha)
+            containers.push_back(extras[whichExtra].container);
+}
+
+void DrawList::getDrawOrder(bool alphaToEnd,std::vector<int> &containers)
+{
+    containers.clear();
+    containers.reserve(visible.size()+extras.size());
+
+    // When only a few things are visible it's cheaper to sort them than to walk everything
+    if (visibleSlots.size()*16 < (size_t)numDrawables)
+    {
+        // The order isn't used here, but new and re-keyed entries still pile up.
+        // Merge them in once there are enough that it would cost us later.
+        if (orderNeedsUpdate())
+            updateOrder();
+
+        // Same order as the entries
+        const std::vector<Slot> &theSlots = slots;
+        std::sort(visibleSlots.begin(),visibleSlots.end(),
+                  [&theSlots](int a,int b)
+                  {
+                      if (theSlots[a].key != theSlots[b].key)
+                          return theSlots[a].key < theSlots[b].key;
+                      return a < b;
+                  });
+    } else {
+        updateOrder();
+        visibleSlots.clear();
+        for (std::vector<Entry>::iterator it = order.begin(); it != order.end(); ++it)
+        {
+            const Slot &theSlot = slots[it->slot];
+            if (theSlot.frame == frame && theSlot.draw && theSlot.version == it->version)
+                visibleSlots.push_back(it->slot);
+        }
+    }
+
+    if (!extras.empty())
+        std::sort(extras.begin(),extras.end());
+
+    if (alphaToEnd)
+    {
+        appendVisible(true,false,containers);
+        appendVisible(true,true,containers);
+    } else
+        appendVisible(false,false,containers);
+}
+
+}
@@ -24,6 +24,7 @@
 #import "UIImage+Stuff.h"
 #import "SceneRendererES.h"
 #import "TextureAtlas.h"
+#import "VertexArena.h"
 
 using namespace Eigen;
 
@@ -213,7 +214,7 @@ void OpenGLMemManager::unlock()
 
 		
 Drawable::Drawable(const std::string &name)
-    : name(name)
+    : name(name), drawListSlot(-1)
 {
 }
 	
@@ -221,6 +222,11 @@ Drawable::~Drawable()
 {
 }
     
+uint64_t Drawable::getDrawListKey() const
+{
+    return DrawList::makeKey(getDrawPriority(),getRequestZBuffer(),getProgram(),getMainTexture());
+}
+    
 void Drawable::runTweakers(WhirlyKitRendererFrameInfo *frame)
 {
     for (DrawableTweakerRefSet::iterator it = tweakers.begin();
@@ -235,8 +241,11 @@ void DrawableChangeRequest::execute(Scene *scene,WhirlyKitSceneRendererES *rende
 		execute2(scene,renderer,theDrawable);
 }
     
+// Attribute arrays are recycled through here once they've gone to OpenGL
+static VertexArena<unsigned char> attrArena(16*1024*1024);
+
 VertexAttribute::VertexAttribute(BDAttributeDataType dataType,const std::string &name)
-    : dataType(dataType), name(name), data(NULL), buffer(0)
+    : dataType(dataType), name(name), buffer(0)
 {
     defaultData.vec3[0] = 0.0;
     defaultData.vec3[1] = 0.0;
@@ -250,7 +259,7 @@ VertexAttribute::~VertexAttribute()
 }
     
 VertexAttribute::VertexAttribute(const VertexAttribute &that)
-    : dataType(that.dataType), name(that.name), data(NULL), buffer(that.buffer), defaultData(that.defaultData)
+    : dataType(that.dataType), name(that.name), buffer(that.buffer), defaultData(that.defaultData)
 {
 }
     
@@ -296,10 +305,8 @@ void VertexAttribute::addColor(const RGBAColor &color)
     if (dataType != BDChar4Type)
         return;
     
-    if (!data)
-        data = new std::vector<RGBAColor>();
-    std::vector<RGBAColor> *colors = (std::vector<RGBAColor> *)data;
-    (*colors).push_back(color);
+    unsigned char vals[4] = {color.r,color.g,color.b,color.a};
+    addValues(vals,1);
 }
 
 void VertexAttribute::addVector2f(const Eigen::Vector2f &vec)
@@ -307,10 +314,7 @@ void VertexAttribute::addVector2f(const Eigen::Vector2f &vec)
     if (dataType != BDFloat2Type)
         return;
     
-    if (!data)
-        data = new std::vector<Vector2f>();
-    std::vector<Vector2f> *vecs = (std::vector<Vector2f> *)data;
-    (*vecs).push_back(vec);
+    addValues(vec.data(),1);
 }
 
 void VertexAttribute::addVector3f(const Eigen::Vector3f &vec)
@@ -318,10 +322,7 @@ void VertexAttribute::addVector3f(const Eigen::Vector3f &vec)
     if (dataType != BDFloat3Type)
         return;
     
-    if (!data)
-        data = new std::vector<Vector3f>();
-    std::vector<Vector3f> *vecs = (std::vector<Vector3f> *)data;
-    (*vecs).push_back(vec);
+    addValues(vec.data(),1);
 }
 
 void VertexAttribute::addVector4f(const Eigen::Vector4f &vec)
@@ -329,10 +330,7 @@ void VertexAttribute::addVector4f(const Eigen::Vector4f &vec)
     if (dataType != BDFloat4Type)
         return;
     
-    if (!data)
-        data = new std::vector<Vector4f>();
-    std::vector<Vector4f> *vecs = (std::vector<Vector4f> *)data;
-    (*vecs).push_back(vec);
+    addValues(vec.data(),1);
 }
 
 void VertexAttribute::addFloat(float val)
@@ -340,10 +338,7 @@ void VertexAttribute::addFloat(float val)
     if (dataType != BDFloatType)
         return;
     
-    if (!data)
-        data = new std::vector<float>();
-    std::vector<float> *floats = (std::vector<float> *)data;
-    (*floats).push_back(val);
+    addValues(&val,1);
 }
     
 void VertexAttribute::addInt(int val)
@@ -351,117 +346,51 @@ void VertexAttribute::addInt(int val)
     if (dataType != BDIntType)
         return;
 
-    if (!data)
-        data = new std::vector<int>();
-    std::vector<int> *ints = (std::vector<int> *)data;
-    (*ints).push_back(val);
+    addValues(&val,1);
+}
+
+void VertexAttribute::addVector2fs(const Eigen::Vector2f *vecs,int count)
+{
+    if (dataType != BDFloat2Type || count <= 0)
+        return;
+    
+    addValues(vecs[0].data(),count);
+}
+
+void VertexAttribute::addVector3fs(const Eigen::Vector3f *vecs,int count)
+{
+    if (dataType != BDFloat3Type || count <= 0)
+        return;
+    
+    addValues(vecs[0].data(),count);
+}
+    
+void VertexAttribute::addValues(const void *vals,int count)
+{
+    if (count <= 0)
+        return;
+    
+    size_t numBytes = count * size();
+    if (data.size() + numBytes > data.capacity())
+        attrArena.grow(data,data.size() + numBytes);
+    const unsigned char *bytes = (const unsigned char *)vals;
+    data.insert(data.end(),bytes,bytes+numBytes);
 }
     
 /// Reserve size in the data array
-void VertexAttribute::reserve(int size)
+void VertexAttribute::reserve(int count)
 {
-    switch (dataType)
-    {
-        case BDFloat4Type:
-        {
-            if (!data)
-                data = new std::vector<Vector4f>();
-            std::vector<Vector4f> *vecs = (std::vector<Vector4f> *)data;
-            vecs->reserve(size);
-        }
-            break;
-        case BDFloat3Type:
-        {
-            if (!data)
-                data = new std::vector<Vector3f>();
-            std::vector<Vector3f> *vecs = (std::vector<Vector3f> *)data;
-            vecs->reserve(size);
-        }
-            break;
-        case BDFloat2Type:
-        {
-            if (!data)
-                data = new std::vector<Vector2f>();
-            std::vector<Vector2f> *vecs = (std::vector<Vector2f> *)data;
-            vecs->reserve(size);
-        }
-            break;
-        case BDChar4Type:
-        {
-            if (!data)
-                data = new std::vector<RGBAColor>();
-            std::vector<RGBAColor> *colors = (std::vector<RGBAColor> *)data;
-            colors->reserve(size);
-        }
-            break;
-        case BDFloatType:
-        {
-            if (!data)
-                data = new std::vector<float>();
-            std::vector<float> *floats = (std::vector<float> *)data;
-            floats->reserve(size);
-        }
-            break;
-        case BDIntType:
-        {
-            if (!data)
-                data = new std::vector<int>();
-            std::vector<int> *ints = (std::vector<int> *)data;
-            ints->reserve(size);
-        }
-            break;
-        case BDDataTypeMax:
-            break;
-    }
+    attrArena.grow(data,count * size());
 }
 
 /// Number of elements in our array
 int VertexAttribute::numElements() const
 {
-    if (!data)
+    int elSize = size();
+    if (elSize == 0)
         return 0;
     
-    switch (dataType)
-    {
-        case BDFloat4Type:
-        {
-            std::vector<Vector4f> *vecs = (std::vector<Vector4f> *)data;
-            return (int)vecs->size();
-        }
-            break;
-        case BDFloat3Type:
-        {
-            std::vector<Vector3f> *vecs = (std::vector<Vector3f> *)data;
-            return (int)vecs->size();
-        }
-            break;
-        case BDFloat2Type:
-        {
-            std::vector<Vector2f> *vecs = (std::vector<Vector2f> *)data;
-            return (int)vecs->size();
-        }
-            break;
-        case BDChar4Type:
-        {
-            std::vector<RGBAColor> *colors = (std::vector<RGBAColor> *)data;
-            return (int)colors->size();
-        }
-            break;
-        case BDFloatType:
-        {
-            std::vector<float> *floats = (std::vector<float> *)data;
-            return (int)floats->size();
-        }
-            break;
-        case BDIntType:
-        {
-            std::vector<int> *ints = (std::vector<int> *)data;
-            return ints->size();
-        }
-        case BDDataTypeMax:
-            return 0;
-            break;
-    }
+    return (int)(data.size() / elSize);
 }
 
 /// Return the size of a single element
@@ -524,100 +453,16 @@ int SingleVertexAttributeInfo::size() const
 /// Clean out the data array
 void VertexAttribute::clear()
 {
-    if (data)
-    {
-        switch (dataType)
-        {
-            case BDFloat4Type:
-            {
-                std::vector<Vector4f> *vecs = (std::vector<Vector4f> *)data;
-                delete vecs;
-            }
-                break;
-            case BDFloat3Type:
-            {
-                std::vector<Vector3f> *vecs = (std::vector<Vector3f> *)data;
-                delete vecs;
-            }
-                break;
-            case BDFloat2Type:
-            {
-                std::vector<Vector2f> *vecs = (std::vector<Vector2f> *)data;
-                delete vecs;
-            }
-                break;
-            case BDChar4Type:
-            {
-                std::vector<RGBAColor> *colors = (std::vector<RGBAColor> *)data;
-                delete colors;
-            }
-                break;
-            case BDFloatType:
-            {
-                std::vector<float> *floats = (std::vector<float> *)data;
-                delete floats;
-            }
-                break;
-            case BDIntType:
-            {
-                std::vector<int> *ints = (std::vector<int> *)data;
-                delete ints;
-            }
-                break;
-            case BDDataTypeMax:
-                break;
-        }
-    }
-    data = NULL;    
+    attrArena.give(data);
 }
 
 /// Return a pointer to the given element
 void *VertexAttribute::addressForElement(int which)
 {
-    switch (dataType)
-    {
-        case BDFloat4Type:
-        {
-            std::vector<Vector4f> *vecs = (std::vector<Vector4f> *)data;
-            return &(*vecs)[which];;
-        }
-            break;
-        case BDFloat3Type:
-        {
-            std::vector<Vector3f> *vecs = (std::vector<Vector3f> *)data;
-            return &(*vecs)[which];;
-        }
-            break;
-        case BDFloat2Type:
-        {
-            std::vector<Vector2f> *vecs = (std::vector<Vector2f> *)data;
-            return &(*vecs)[which];
-        }
-            break;
-        case BDChar4Type:
-        {
-            std::vector<RGBAColor> *colors = (std::vector<RGBAColor> *)data;
-            return &(*colors)[which];
-        }
-            break;
-        case BDFloatType:
-        {
-            std::vector<float> *floats = (std::vector<float> *)data;
-            return &(*floats)[which];
-        }
-            break;
-        case BDIntType:
-        {
-            std::vector<int> *ints = (std::vector<int> *)data;
-            return &(*ints)[which];
-        }
-            break;
-        case BDDataTypeMax:
-            return NULL;
-            break;
-    }
+    if (data.empty())
+        return NULL;
     
-    return NULL;
+    return &data[which * size()];
 }
 
 /// Return the number of components as needed by glVertexAttribPointer
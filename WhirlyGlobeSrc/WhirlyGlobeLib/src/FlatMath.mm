@@ -75,6 +75,28 @@ Point3d PlateCarreeCoordSystem::geocentricToLocal(Point3d geocPt)
     return GeoCoordSystem::GeocentricToLocal(geocPt);
 }
     
+void PlateCarreeCoordSystem::localToGeographic(const Point3d *inPts,Point2d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = Point2d(inPts[ii].x(),inPts[ii].y());
+}
+
+void PlateCarreeCoordSystem::geographicToLocal(const Point2d *inPts,Point3d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = Point3d(inPts[ii].x(),inPts[ii].y(),0.0);
+}
+
+void PlateCarreeCoordSystem::localToGeocentric(const Point3d *inPts,Point3d *outPts,int count)
+{
+    GeoCoordSystem::LocalToGeocentric(inPts,outPts,count);
+}
+
+void PlateCarreeCoordSystem::geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    GeoCoordSystem::GeocentricToLocal(inPts,outPts,count);
+}
+    
 bool PlateCarreeCoordSystem::isSameAs(CoordSystem *coordSys)
 {
     PlateCarreeCoordSystem *other = dynamic_cast<PlateCarreeCoordSystem *>(coordSys);
@@ -177,6 +199,33 @@ Point3d FlatEarthCoordSystem::geocentricToLocal(Point3d geocPt)
     return Point3d(localPt.x(),localPt.y(),geoCoordPlus.z());
 }
     
+void FlatEarthCoordSystem::localToGeographic(const Point3d *inPts,Point2d *outPts,int count)
+{
+    double lonScale = 1.0 / (MetersPerRadian * converge), latScale = 1.0 / MetersPerRadian;
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = Point2d(inPts[ii].x() * lonScale + origin.lon(),inPts[ii].y() * latScale + origin.lat());
+}
+
+void FlatEarthCoordSystem::geographicToLocal(const Point2d *inPts,Point3d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = Point3d((inPts[ii].x() - origin.lon()) * converge * MetersPerRadian,(inPts[ii].y() - origin.lat()) * MetersPerRadian,0.0);
+}
+
+void FlatEarthCoordSystem::localToGeocentric(const Point3d *inPts,Point3d *outPts,int count)
+{
+    // Over to geographic, keeping the height, then one call for the rest
+    double lonScale = 1.0 / (MetersPerRadian * converge), latScale = 1.0 / MetersPerRadian;
+    ScaleOffsetPoints(inPts,outPts,count,Point3d(lonScale,latScale,1.0),Point3d(origin.lon(),origin.lat(),0.0));
+    GeoCoordSystem::LocalToGeocentric(outPts,outPts,count);
+}
+
+void FlatEarthCoordSystem::geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    GeoCoordSystem::GeocentricToLocal(inPts,outPts,count);
+    ScaleOffsetPoints(outPts,outPts,count,Point3d(converge * MetersPerRadian,MetersPerRadian,1.0),Point3d(-origin.lon() * converge * MetersPerRadian,-origin.lat() * MetersPerRadian,0.0));
+}
+    
 bool FlatEarthCoordSystem::isSameAs(CoordSystem *coordSys)
 {
     FlatEarthCoordSystem *other = dynamic_cast<FlatEarthCoordSystem *>(coordSys);
@@ -19,7 +19,7 @@
  */
 
 
-#import <UIKit/UIKit.h>
+#import <mutex>
 #import "GlobeMath.h"
 #import "FlatMath.h"
 #import "proj_api.h"
@@ -37,8 +37,9 @@ namespace WhirlyKit
 // Initialize the Proj-4 objects
 void InitProj4()
 {
-    static dispatch_once_t once=0;
-    dispatch_once(&once, ^ {
+    // Plain C++ so the coordinate systems can be built on their own (see coordsys_bench)
+    static std::once_flag once;
+    std::call_once(once, [] {
         if (!pj_latlon || !pj_geocentric)
         {
             pj_latlon = pj_init_plus("+proj=latlong +datum=WGS84");
@@ -141,6 +142,51 @@ Point3d GeoCoordSystem::geocentricToLocal(Point3d geocPt)
     return GeocentricToLocal(geocPt);
 }
     
+void GeoCoordSystem::LocalToGeocentric(const Point3d *inPts,Point3d *outPts,int count)
+{
+    if (count <= 0)
+        return;
+    InitProj4();
+    
+    // proj.4 takes a stride, so it can work directly on the points
+    if (inPts != outPts)
+        std::copy(inPts,inPts+count,outPts);
+    pj_transform(pj_latlon, pj_geocentric, count, 3, &outPts[0].x(), &outPts[0].y(), &outPts[0].z());
+}
+
+void GeoCoordSystem::GeocentricToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    if (count <= 0)
+        return;
+    InitProj4();
+    
+    if (inPts != outPts)
+        std::copy(inPts,inPts+count,outPts);
+    pj_transform(pj_geocentric, pj_latlon, count, 3, &outPts[0].x(), &outPts[0].y(), &outPts[0].z());
+}
+    
+void GeoCoordSystem::localToGeographic(const Point3d *inPts,Point2d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = Point2d(inPts[ii].x(),inPts[ii].y());
+}
+
+void GeoCoordSystem::geographicToLocal(const Point2d *inPts,Point3d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = Point3d(inPts[ii].x(),inPts[ii].y(),0.0);
+}
+
+void GeoCoordSystem::localToGeocentric(const Point3d *inPts,Point3d *outPts,int count)
+{
+    LocalToGeocentric(inPts,outPts,count);
+}
+
+void GeoCoordSystem::geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    GeocentricToLocal(inPts,outPts,count);
+}
+    
 
 Mbr GeoCoordSystem::GeographicMbrToLocal(GeoMbr geoMbr)
 {
@@ -194,6 +240,44 @@ Point3d FakeGeocentricDisplayAdapter::localToDisplay(Point3d geoPt)
     return LocalToDisplay(geoPt);
 }
     
+// Same math as LocalToDisplay(), but in a tight loop with no branches.
+// A height of zero scales by exactly 1.0, so the result matches.
+void FakeGeocentricDisplayAdapter::localToDisplay(const Point3f *inPts,Point3f *outPts,int count)
+{
+    if (count <= 0)
+        return;
+    const float *in = inPts[0].data();
+    float *out = outPts[0].data();
+    for (int ii=0;ii<count;ii++,in+=3,out+=3)
+    {
+        float lon = in[0], lat = in[1], height = in[2];
+        float z = sinf(lat);
+        float rad = sqrtf(1.0-z*z);
+        float heightScale = 1.0 + height / EarthRadius;
+        out[0] = rad*cosf(lon)*heightScale;
+        out[1] = rad*sinf(lon)*heightScale;
+        out[2] = z*heightScale;
+    }
+}
+
+void FakeGeocentricDisplayAdapter::localToDisplay(const Point3d *inPts,Point3d *outPts,int count)
+{
+    if (count <= 0)
+        return;
+    const double *in = inPts[0].data();
+    double *out = outPts[0].data();
+    for (int ii=0;ii<count;ii++,in+=3,out+=3)
+    {
+        double lon = in[0], lat = in[1], height = in[2];
+        double z = sin(lat);
+        double rad = sqrt(1.0-z*z);
+        double heightScale = 1.0 + height / EarthRadius;
+        out[0] = rad*cos(lon)*heightScale;
+        out[1] = rad*sin(lon)*heightScale;
+        out[2] = z*heightScale;
+    }
+}
+    
 Point3f FakeGeocentricDisplayAdapter::DisplayToLocal(Point3f pt)
 {
     pt.normalize();
@@ -233,6 +317,12 @@ Point3d FakeGeocentricDisplayAdapter::displayToLocal(Point3d pt)
     return DisplayToLocal(pt);
 }
     
+void FakeGeocentricDisplayAdapter::displayToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = DisplayToLocal(inPts[ii]);
+}
+    
 Point3f FakeGeocentricDisplayAdapter::normalForLocal(Point3f pt)
 {
     return LocalToDisplay(pt);
@@ -265,6 +355,25 @@ Point3d GeocentricDisplayAdapter::localToDisplay(Point3d geoPt)
 {
     return LocalToDisplay(geoPt);
 }
+    
+void GeocentricDisplayAdapter::localToDisplay(const Point3f *inPts,Point3f *outPts,int count)
+{
+    if (count <= 0)
+        return;
+    std::vector<Point3d> geoCpts(count);
+    for (int ii=0;ii<count;ii++)
+        geoCpts[ii] = Point3d(inPts[ii].x(),inPts[ii].y(),inPts[ii].z());
+    GeoCoordSystem::LocalToGeocentric(&geoCpts[0],&geoCpts[0],count);
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = Point3f(geoCpts[ii].x()/EarthRadius,geoCpts[ii].y()/EarthRadius,geoCpts[ii].z()/EarthRadius);
+}
+
+void GeocentricDisplayAdapter::localToDisplay(const Point3d *inPts,Point3d *outPts,int count)
+{
+    GeoCoordSystem::LocalToGeocentric(inPts,outPts,count);
+    double scale = 1.0/EarthRadius;
+    ScaleOffsetPoints(outPts,outPts,count,Point3d(scale,scale,scale),Point3d(0,0,0));
+}
 
 Point3f GeocentricDisplayAdapter::DisplayToLocal(Point3f pt)
 {
@@ -287,6 +396,12 @@ Point3d GeocentricDisplayAdapter::displayToLocal(Point3d pt)
 {
     return DisplayToLocal(pt);
 }
+    
+void GeocentricDisplayAdapter::displayToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    ScaleOffsetPoints(inPts,outPts,count,Point3d(EarthRadius,EarthRadius,EarthRadius),Point3d(0,0,0));
+    GeoCoordSystem::GeocentricToLocal(outPts,outPts,count);
+}
 
 Point3f GeocentricDisplayAdapter::normalForLocal(Point3f pt)
 {
@@ -40,9 +40,11 @@ GlobeScene::~GlobeScene()
 void GlobeScene::addDrawable(DrawableRef draw)
 {
     drawables.insert(draw);
+    draw->setDrawListSlot(drawList.addDrawable(draw.get(),draw->getDrawListKey()));
 
     // Account for the geo coordinate wrapping
     Mbr localMbr = draw->getLocalMbr();
+    bool canMove = draw->getMatrix() != NULL;
     if (localMbr.valid())
     {
         GeoMbr geoMbr(GeoCoord(localMbr.ll().x(),localMbr.ll().y()),GeoCoord(localMbr.ur().x(),localMbr.ur().y()));
@@ -50,21 +52,17 @@ void GlobeScene::addDrawable(DrawableRef draw)
         geoMbr.splitIntoMbrs(localMbrs);
         
         for (unsigned int ii=0;ii<localMbrs.size();ii++)
-            cullTree->getTopCullable()->addDrawable(cullTree,localMbrs[ii],draw);
+            cullTree->addDrawable(draw->getDrawListSlot(),localMbrs[ii],canMove);
     } else
-        cullTree->getTopCullable()->addDrawable(cullTree, localMbr, draw);
+        cullTree->addDrawable(draw->getDrawListSlot(),localMbr,canMove);
 }
 
 void GlobeScene::remDrawable(DrawableRef draw)
 {
-    Mbr localMbr = draw->getLocalMbr();
-    GeoMbr geoMbr(GeoCoord(localMbr.ll().x(),localMbr.ll().y()),GeoCoord(localMbr.ur().x(),localMbr.ur().y()));
-    std::vector<Mbr> localMbrs;
-    geoMbr.splitIntoMbrs(localMbrs);
-    
-    for (unsigned int ii=0;ii<localMbrs.size();ii++)
-        cullTree->getTopCullable()->remDrawable(cullTree,localMbrs[ii],draw);
+    cullTree->remDrawable(draw->getDrawListSlot());
 
+    drawList.removeDrawable(draw->getDrawListSlot());
+    draw->setDrawListSlot(-1);
     drawables.erase(draw);
 }
 
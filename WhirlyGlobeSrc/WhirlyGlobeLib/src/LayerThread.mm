@@ -27,6 +27,10 @@
 
 using namespace WhirlyKit;
 
+// Setting up the GL side of changes before they go to the scene
+static const TelemetryID SetupChangesSpan = Telemetry::registerSpan("Layer thread - setup changes");
+static const TelemetryID FlushSpan = Telemetry::registerSpan("Layer thread - flush");
+
 @implementation WhirlyKitLayerThread
 {
     WhirlyKitGLSetupInfo *glSetupInfo;
@@ -194,6 +198,7 @@ using namespace WhirlyKit;
     bool requiresFlush = false;
     // Set up anything that needs to be set up
     ChangeSet changesToAdd;
+    uint64_t setupStart = Telemetry::now();
     for (unsigned int ii=0;ii<changesToProcess.size();ii++)
     {
         ChangeRequest *change = changesToProcess[ii];
@@ -206,11 +211,15 @@ using namespace WhirlyKit;
             // A NULL change request is just a flush request
             requiresFlush = true;
     }
+    Telemetry::recordSpan(SetupChangesSpan,setupStart,Telemetry::now());
     
     // If anything needed a flush after that, let's do it
     if (requiresFlush && _allowFlush)
     {
-        glFlush();
+        {
+            TelemetrySpan span(FlushSpan);
+            glFlush();
+        }
         
         // If there were no changes to add we probably still want to poke the scene
         // Otherwise texture changes don't show up
@@ -246,6 +255,7 @@ using namespace WhirlyKit;
     
     // This should be the default context.  If you change it yourself, change it back
     [EAGLContext setCurrentContext:_glContext];
+    Telemetry::setThreadName("Layer thread");
 
     @autoreleasepool {
         _runLoop = [NSRunLoop currentRunLoop];
@@ -69,10 +69,11 @@ LayoutObjectEntry::LayoutObjectEntry(SimpleIdentity theId)
     currentCluster = newCluster = -1;
     offset = Point2d(MAXFLOAT,MAXFLOAT);
     changed = true;
+    visible = false;
 }
     
 LayoutManager::LayoutManager()
-    : maxDisplayObjects(0), hasUpdates(false), clusterGen(NULL)
+    : maxDisplayObjects(0), hasUpdates(false), generation(0), clusterGen(NULL), lastFrameBufferSize(0,0), lastResScale(0.0)
 {
     pthread_mutex_init(&layoutLock, NULL);
 }
@@ -92,6 +93,8 @@ void LayoutManager::setMaxDisplayObjects(int numObjects)
     pthread_mutex_lock(&layoutLock);
 
     maxDisplayObjects = numObjects;
+    // Last round's answers assumed the old limit
+    lastLayoutOrder.clear();
 
     pthread_mutex_unlock(&layoutLock);
 }
@@ -106,8 +109,11 @@ void LayoutManager::addLayoutObjects(const std::vector<LayoutObject> &newObjects
         LayoutObjectEntry *entry = new LayoutObjectEntry(layoutObj.getId());
         entry->obj = newObjects[ii];
         layoutObjects.insert(entry);
+        if (layoutObj.clusterGroup > -1)
+            dirtyClusterGroups.insert(layoutObj.clusterGroup);
     }
     hasUpdates = true;
+    generation++;
 
     pthread_mutex_unlock(&layoutLock);
 }
@@ -122,8 +128,11 @@ void LayoutManager::addLayoutObjects(const std::vector<LayoutObject *> &newObjec
         LayoutObjectEntry *entry = new LayoutObjectEntry(layoutObj->getId());
         entry->obj = *(newObjects[ii]);
         layoutObjects.insert(entry);
+        if (layoutObj->clusterGroup > -1)
+            dirtyClusterGroups.insert(layoutObj->clusterGroup);
     }
     hasUpdates = true;
+    generation++;
     
     pthread_mutex_unlock(&layoutLock);
 }
@@ -141,7 +150,8 @@ void LayoutManager::enableLayoutObjects(const SimpleIDSet &theObjects,bool enabl
         if (eit != layoutObjects.end())
             (*eit)->obj.enable = enable;
     }
-    hasUpdates = true;    
+    hasUpdates = true;
+    generation++;
 
     pthread_mutex_unlock(&layoutLock);
 }
@@ -157,11 +167,15 @@ void LayoutManager::removeLayoutObjects(const SimpleIDSet &oldObjects)
         LayoutEntrySet::iterator eit = layoutObjects.find(&entry);
         if (eit != layoutObjects.end())
         {
+            // The index points at this, so it'll have to be rebuilt
+            if ((*eit)->obj.clusterGroup > -1)
+                dirtyClusterGroups.insert((*eit)->obj.clusterGroup);
             delete *eit;
             layoutObjects.erase(eit);
         }
     }
     hasUpdates = true;
+    generation++;
 
     pthread_mutex_unlock(&layoutLock);
 }
@@ -179,13 +193,25 @@ bool LayoutManager::hasChanges()
     return ret;
 }
     
-// Sort more important things to the front
+unsigned int LayoutManager::getGeneration()
+{
+    pthread_mutex_lock(&layoutLock);
+    
+    unsigned int ret = generation;
+    
+    pthread_mutex_unlock(&layoutLock);
+    
+    return ret;
+}
+    
+// Sort more important things to the front.
+// Ties go by ID so the order doesn't depend on where things landed in memory.
 typedef struct
 {
     bool operator () (const LayoutObjectEntry *a,const LayoutObjectEntry *b)
     {
         if (a->obj.importance == b->obj.importance)
-            return a > b;
+            return a->obj.getId() > b->obj.getId();
         return a->obj.importance > b->obj.importance;
     }
 } LayoutEntrySorter;
@@ -242,29 +268,6 @@ void LayoutManager::addClusterGenerator(ClusterGenerator *inClusterGen)
     pthread_mutex_unlock(&layoutLock);
 }
 
-// Collection of objects we'll cluster together
-class ClusteredObjects
-{
-public:
-    ClusteredObjects() { }
-    ClusteredObjects(int clusterID) : clusterID(clusterID) { }
-    
-    int clusterID;
-    
-    LayoutSortingSet layoutObjects;
-};
-    
-struct ClusteredObjectsSorter
-{
-    // Comparison operator
-    bool operator () (const ClusteredObjects *lhs,const ClusteredObjects *rhs) const
-    {
-        return lhs->clusterID < rhs->clusterID;
-    }
-};
-    
-typedef std::set<ClusteredObjects *,ClusteredObjectsSorter> ClusteredObjectsSet;
-
 // Size of the overlap sampler
 static const int OverlapSampleX = 10;
 static const int OverlapSampleY = 60;
@@ -272,15 +275,49 @@ static const int OverlapSampleY = 60;
 // Now much around the screen we'll take into account
 static const float ScreenBuffer = 0.1;
     
-bool LayoutManager::calcScreenPt(CGPoint &objPt,LayoutObjectEntry *layoutObj,WhirlyKitViewState *viewState,const Mbr &screenMbr,const Point2f &frameBufferSize)
+// Number of objects each worker projects at once
+static const int LayoutChunkSize = 256;
+    
+// Distance (in pixels) we step to see how big a pixel is in the clustering space
+static const double ClusterPixelStep = 10.0;
+// Number of points along each side of the screen we check to see what area is visible
+static const int ClusterExtentSamples = 5;
+    
+// What the layout workers need to know about the view.
+// We pull this out of the view state so nobody messages it from another thread.
+class LayoutViewInfo
+{
+public:
+    std::vector<Matrix4d> fullMatrices;
+    Matrix4d normalMat;
+    Matrix4f fullMatrix4f,fullNormalMatrix4f;
+    Point2d ll,ur;
+    double nearPlane;
+    Point2f frameBufferSize;
+    Mbr screenMbr;
+    bool isGlobe;
+    double heightAboveSurface;
+};
+    
+// Project to the screen the same way the view state does, trying each of the wrapped matrices
+static bool CalcScreenPt(Point2d &objPt,const Point3d &worldLoc,const LayoutViewInfo &viewInfo)
 {
     // Figure out where this will land
     bool isInside = false;
-    for (unsigned int offi=0;offi<viewState.viewMatrices.size();offi++)
+    for (const Matrix4d &modelTrans : viewInfo.fullMatrices)
     {
-        Eigen::Matrix4d modelTrans = viewState.fullMatrices[offi];
-        CGPoint thisObjPt = [viewState pointOnScreenFromDisplay:layoutObj->obj.worldLoc transform:&modelTrans frameSize:frameBufferSize];
-        if (screenMbr.inside(Point2f(thisObjPt.x,thisObjPt.y)))
+        Vector4d screenPt = modelTrans * Vector4d(worldLoc.x(),worldLoc.y(),worldLoc.z(),1.0);
+        Vector3d ray(screenPt.x() / screenPt.w(),screenPt.y() / screenPt.w(),screenPt.z() / screenPt.w());
+        ray *= -viewInfo.nearPlane/ray.z();
+        
+        Point2d thisObjPt(-100000,-100000);
+        if (ray.z() < 0.0)
+        {
+            double u = (ray.x() - viewInfo.ll.x()) / (viewInfo.ur.x() - viewInfo.ll.x());
+            double v = 1.0 - (ray.y() - viewInfo.ll.y()) / (viewInfo.ur.y() - viewInfo.ll.y());
+            thisObjPt = Point2d(u * viewInfo.frameBufferSize.x(),v * viewInfo.frameBufferSize.y());
+        }
+        if (viewInfo.screenMbr.inside(Point2f(thisObjPt.x(),thisObjPt.y())))
         {
             isInside = true;
             objPt = thisObjPt;
@@ -290,13 +327,14 @@ bool LayoutManager::calcScreenPt(CGPoint &objPt,LayoutObjectEntry *layoutObj,Whi
     return isInside;
 }
 
-Matrix2d LayoutManager::calcScreenRot(float &screenRot,WhirlyKitViewState *viewState,WhirlyGlobeViewState *globeViewState,ScreenSpaceObject *ssObj,const CGPoint &objPt,const Matrix4d &modelTrans,const Matrix4d &normalMat,const Point2f &frameBufferSize)
+// Work out the rotation of an object on the screen
+static float CalcScreenRot(const LayoutViewInfo &viewInfo,const ScreenSpaceObject *ssObj)
 {
     // Switch from counter-clockwise to clockwise
     double rot = 2*M_PI-ssObj->rotation;
     
     Point3d upVec,northVec,eastVec;
-    if (!globeViewState)
+    if (!viewInfo.isGlobe)
     {
         upVec = Point3d(0,0,1);
         northVec = Point3d(0,1,0);
@@ -314,18 +352,110 @@ Matrix2d LayoutManager::calcScreenRot(float &screenRot,WhirlyKitViewState *viewS
     Point3d rotVec = eastVec * sin(rot) + northVec * cos(rot);
     
     // Project down into screen space
-    Vector4d projRot = normalMat * Vector4d(rotVec.x(),rotVec.y(),rotVec.z(),0.0);
+    Vector4d projRot = viewInfo.normalMat * Vector4d(rotVec.x(),rotVec.y(),rotVec.z(),0.0);
     
     // Use the resulting x & y
-    screenRot = atan2(projRot.y(),projRot.x())-M_PI/2.0;
+    float screenRot = atan2(projRot.y(),projRot.x())-M_PI/2.0;
     // Keep the labels upright
     if (ssObj->keepUpright)
         if (screenRot > M_PI/2 && screenRot < 3*M_PI/2)
             screenRot = screenRot + M_PI;
-    Matrix2d screenRotMat;
-    screenRotMat = Eigen::Rotation2Dd(screenRot);
     
-    return screenRotMat;
+    return screenRot;
+}
+    
+// Figure out if an object is visible and where it is on the screen.
+// This runs on a worker thread and only touches the entry it's given.
+static void ProjectLayoutObject(LayoutObjectEntry *entry,const LayoutViewInfo &viewInfo,bool startOver)
+{
+    const LayoutObject &obj = entry->obj;
+    entry->visible = obj.state.minVis == DrawVisibleInvalid || obj.state.maxVis == DrawVisibleInvalid ||
+                     (obj.state.minVis < viewInfo.heightAboveSurface && viewInfo.heightAboveSurface < obj.state.maxVis);
+    // Make sure this one is facing toward the viewer
+    if (entry->visible && viewInfo.isGlobe)
+        entry->visible = CheckPointAndNormFacing(Vector3dToVector3f(obj.worldLoc),Vector3dToVector3f(obj.worldLoc.normalized()),viewInfo.fullMatrix4f,viewInfo.fullNormalMatrix4f) > 0.0;
+    if (!entry->visible)
+    {
+        entry->placement.invalidate();
+        return;
+    }
+    
+    Point2d objPt(0,0);
+    bool isInside = CalcScreenPt(objPt,obj.worldLoc,viewInfo);
+    float screenRot = 0.0;
+    if (isInside && obj.rotation != 0.0)
+        screenRot = CalcScreenRot(viewInfo,&obj);
+    
+    // If it's about where it was, lay it out from there so we get the same answer as last time
+    entry->placement.update(objPt,screenRot,isInside,startOver);
+}
+
+// Latitude limit for the clustering space on the globe
+static const double ClusterMaxLat = 85.05113 / 180.0 * M_PI;
+
+// Where a point on the globe lands in the clustering space.
+// That's spherical mercator scaled to [0,1], so distances are about what they look like on the screen.
+static Point2d ClusterPointFromDisplay(const Point3d &dispPt)
+{
+    Point3d norm = dispPt.normalized();
+    double lon = atan2(norm.y(),norm.x());
+    double lat = std::min(ClusterMaxLat,std::max(-ClusterMaxLat,asin(std::min(1.0,std::max(-1.0,norm.z())))));
+    return Point2d((lon + M_PI) / (2.0*M_PI),(1.0 - log(tan(M_PI/4.0 + lat/2.0)) / M_PI) / 2.0);
+}
+
+// What we found in the cluster index for one group on this round
+class ClusterGroupResults
+{
+public:
+    // A cluster we'll need a marker for
+    class Cluster
+    {
+    public:
+        Point3d dispCenter;
+        std::vector<LayoutObjectEntry *> objs;
+    };
+    
+    std::vector<LayoutObjectEntry *> simpleObjs;
+    std::vector<Cluster> clusters;
+};
+
+// Rebuild the index for any cluster group that changed
+void LayoutManager::buildClusterIndexes()
+{
+    if (dirtyClusterGroups.empty())
+        return;
+    
+    bool isFlat = scene->getCoordAdapter()->isFlat();
+    
+    std::map<int,std::vector<LayoutObjectEntry *> > groupEntries;
+    for (LayoutEntrySet::iterator it = layoutObjects.begin();
+         it != layoutObjects.end(); ++it)
+    {
+        int clusterGroup = (*it)->obj.clusterGroup;
+        if (clusterGroup > -1 && dirtyClusterGroups.find(clusterGroup) != dirtyClusterGroups.end())
+            groupEntries[clusterGroup].push_back(*it);
+    }
+    
+    for (int clusterGroup : dirtyClusterGroups)
+    {
+        const std::vector<LayoutObjectEntry *> &entries = groupEntries[clusterGroup];
+        if (entries.empty())
+        {
+            clusterIndexes.erase(clusterGroup);
+            continue;
+        }
+        
+        std::vector<Point2d> pts(entries.size());
+        std::vector<Point3d> dispPts(entries.size());
+        for (unsigned int ii=0;ii<entries.size();ii++)
+        {
+            const Point3d &worldLoc = entries[ii]->obj.worldLoc;
+            dispPts[ii] = worldLoc;
+            pts[ii] = isFlat ? Point2d(worldLoc.x(),worldLoc.y()) : ClusterPointFromDisplay(worldLoc);
+        }
+        clusterIndexes[clusterGroup].build(pts,dispPts,entries);
+    }
+    dirtyClusterGroups.clear();
 }
 
 // Do the actual layout logic.  We'll modify the offset and on value in place.
@@ -336,7 +466,6 @@ bool LayoutManager::runLayoutRules(WhirlyKitViewState *viewState,std::vector<Clu
     
     bool hadChanges = false;
     
-    ClusteredObjectsSet clusterObjs;
     LayoutSortingSet layoutObjs;
     
     // The globe has some special requirements
@@ -347,355 +476,305 @@ bool LayoutManager::runLayoutRules(WhirlyKitViewState *viewState,std::vector<Clu
     else
         mapViewState = (MaplyViewState *)viewState;
 
+    // Extents for the layout helpers
+    Point2f frameBufferSize;
+    frameBufferSize.x() = renderer.framebufferWidth;
+    frameBufferSize.y() = renderer.framebufferHeight;
+    Mbr screenMbr(Point2f(-ScreenBuffer * frameBufferSize.x(),-ScreenBuffer * frameBufferSize.y()),frameBufferSize * (1.0 + ScreenBuffer));
+
+    // Need to scale for retina displays
+    float resScale = renderer.scale;
+    
+    // If the frame changed, nothing from last time is any good
+    bool startOver = false;
+    if (frameBufferSize != lastFrameBufferSize || resScale != lastResScale)
+    {
+        startOver = true;
+        lastLayoutOrder.clear();
+        lastFrameBufferSize = frameBufferSize;
+        lastResScale = resScale;
+    }
+
     // View related matrix stuff
+    if (viewState.ll.x() == viewState.ur.x())
+        [viewState calcFrustumWidth:frameBufferSize.x() height:frameBufferSize.y()];
     Matrix4d modelTrans = viewState.fullMatrices[0];
-    Matrix4f fullMatrix4f = Matrix4dToMatrix4f(viewState.fullMatrices[0]);
-    Matrix4f fullNormalMatrix4f = Matrix4dToMatrix4f(viewState.fullNormalMatrices[0]);
-    Matrix4d normalMat = viewState.fullMatrices[0].inverse().transpose();
-    
-    // Turn everything off and sort by importance
+    LayoutViewInfo viewInfo;
+    viewInfo.fullMatrices = viewState.fullMatrices;
+    viewInfo.normalMat = viewState.fullMatrices[0].inverse().transpose();
+    viewInfo.fullMatrix4f = Matrix4dToMatrix4f(viewState.fullMatrices[0]);
+    viewInfo.fullNormalMatrix4f = Matrix4dToMatrix4f(viewState.fullNormalMatrices[0]);
+    viewInfo.ll = viewState.ll;
+    viewInfo.ur = viewState.ur;
+    viewInfo.nearPlane = viewState.nearPlane;
+    viewInfo.frameBufferSize = frameBufferSize;
+    viewInfo.screenMbr = screenMbr;
+    viewInfo.isGlobe = globeViewState != nil;
+    viewInfo.heightAboveSurface = globeViewState ? globeViewState.heightAboveGlobe : mapViewState.heightAboveSurface;
+    
+    // Project and cull everything that's turned on.  Each entry is only touched by one worker.
+    std::vector<LayoutObjectEntry *> candidates;
+    candidates.reserve(layoutObjects.size());
     for (LayoutEntrySet::iterator it = layoutObjects.begin();
          it != layoutObjects.end(); ++it)
+        if ((*it)->obj.enable)
+            candidates.push_back(*it);
+    LayoutObjectEntry **candidatePtrs = candidates.data();
+    const LayoutViewInfo *viewInfoPtr = &viewInfo;
+    size_t numCandidates = candidates.size();
+    size_t numChunks = (numCandidates + LayoutChunkSize - 1) / LayoutChunkSize;
+    dispatch_apply(numChunks, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
+                   ^(size_t chunk)
+                   {
+                       size_t end = std::min((chunk+1) * LayoutChunkSize,numCandidates);
+                       for (size_t ii=chunk * LayoutChunkSize;ii<end;ii++)
+                           ProjectLayoutObject(candidatePtrs[ii],*viewInfoPtr,startOver);
+                   });
+    
+    // Turn everything off and sort by importance
+    std::set<int> visibleClusterGroups;
+    for (LayoutObjectEntry *obj : candidates)
     {
-        LayoutObjectEntry *layoutObj = *it;
-        if (layoutObj->obj.enable)
+        bool use = obj->visible;
+        obj->newCluster = -1;
+        if (use)
         {
-            LayoutObjectEntry *obj = *it;
-            bool use = false;
-            if (globeViewState)
+            if (obj->obj.clusterGroup > -1)
             {
-                if (obj->obj.state.minVis == DrawVisibleInvalid || obj->obj.state.maxVis == DrawVisibleInvalid ||
-                    (obj->obj.state.minVis < globeViewState.heightAboveGlobe && globeViewState.heightAboveGlobe < obj->obj.state.maxVis))
-                    use = true;
-            } else {
-                if (obj->obj.state.minVis == DrawVisibleInvalid || obj->obj.state.maxVis == DrawVisibleInvalid ||
-                    (obj->obj.state.minVis < mapViewState.heightAboveSurface && mapViewState.heightAboveSurface < obj->obj.state.maxVis))
-                    use = true;
-            }
-            if (use) {
-                // Make sure this one isn't behind the globe
-                if (globeViewState)
-                {
-                    // Make sure this one is facing toward the viewer
-                    use = CheckPointAndNormFacing(Vector3dToVector3f(layoutObj->obj.worldLoc),Vector3dToVector3f(layoutObj->obj.worldLoc.normalized()),fullMatrix4f,fullNormalMatrix4f) > 0.0;
-                }
-
-                if (use)
-                {
-                    obj->newCluster = -1;
-                    if (obj->obj.clusterGroup > -1)
-                    {
-                        // Put the entry in the right cluster
-                        ClusteredObjects findClusterObj(obj->obj.clusterGroup);
-                        ClusteredObjects *thisClusterObj = NULL;
-                        auto cit = clusterObjs.find(&findClusterObj);
-                        if (cit == clusterObjs.end())
-                        {
-                            // Create a new cluster object
-                            thisClusterObj = new ClusteredObjects(obj->obj.clusterGroup);
-                            clusterObjs.insert(thisClusterObj);
-
-                            hadChanges = true;
-                        } else
-                            thisClusterObj = *cit;
-                        
-                        thisClusterObj->layoutObjects.insert(layoutObj);
-                        
-                        obj->newEnable = false;
-                        obj->newCluster = -1;
-                    } else {
-                        // Not a cluster
-                        layoutObjs.insert(layoutObj);
-                    }
-                } else {
-                    obj->newEnable = false;
-                    obj->newCluster = -1;
-                }
-            } else {
+                // The cluster index will sort this one out
+                visibleClusterGroups.insert(obj->obj.clusterGroup);
                 obj->newEnable = false;
-                obj->newCluster = -1;
+            } else {
+                // Not a cluster
+                layoutObjs.insert(obj);
             }
-            // Note: Update this for clusters
-            if ((use && !obj->currentEnable) || (!use && obj->currentEnable))
-                hadChanges = true;
-        }
+        } else
+            obj->newEnable = false;
+        // Note: Update this for clusters
+        if (use != obj->currentEnable)
+            hadChanges = true;
     }
     
-    // Extents for the layout helpers
-    Point2f frameBufferSize;
-    frameBufferSize.x() = renderer.framebufferWidth;
-    frameBufferSize.y() = renderer.framebufferHeight;
-    Mbr screenMbr(Point2f(-ScreenBuffer * frameBufferSize.x(),-ScreenBuffer * frameBufferSize.y()),frameBufferSize * (1.0 + ScreenBuffer));
-
-    // Need to scale for retina displays
-    float resScale = renderer.scale;
-
     if (clusterGen)
     {
+        buildClusterIndexes();
+        
         clusterGen->startLayoutObjects();
         
-        // Lay out the clusters in order
-        for (ClusteredObjectsSet::iterator it = clusterObjs.begin(); it != clusterObjs.end(); ++it)
+        // The generator isn't necessarily thread safe, so ask for all the parameters up front
+        std::vector<int> clusterList;
+        std::vector<const ClusterIndex<LayoutObjectEntry *> *> clusterIndexList;
+        for (int clusterGroup : visibleClusterGroups)
         {
-            ClusteredObjects *cluster = *it;
-            clusterParams.resize(clusterParams.size()+1);
-            ClusterGenerator::ClusterClassParams &params = clusterParams.back();
-            clusterGen->paramsForClusterClass(cluster->clusterID,params);
-
-            ClusterHelper clusterHelper(screenMbr,OverlapSampleX,OverlapSampleY,resScale,params.clusterSize);
-            
-            // Add all the various objects to the cluster and figure out overlaps
-            for (LayoutSortingSet::iterator sit = cluster->layoutObjects.begin(); sit != cluster->layoutObjects.end(); ++sit)
+            auto it = clusterIndexes.find(clusterGroup);
+            if (it != clusterIndexes.end())
             {
-                LayoutObjectEntry *entry = *sit;
-                
-                // Project the point and figure out the rotation
-                bool isActive = true;
-                CGPoint objPt;
-                bool isInside = calcScreenPt(objPt,entry,viewState,screenMbr,frameBufferSize);
-                
-                isActive &= isInside;
-                
-                if (isActive)
-                {
-                    // Deal with the rotation
-                    float screenRot = 0.0;
-                    Matrix2d screenRotMat;
-                    if (entry->obj.rotation != 0.0)
-                        screenRotMat = calcScreenRot(screenRot,viewState,globeViewState,&entry->obj,objPt,modelTrans,normalMat,frameBufferSize);
-                    
-                    // Rotate the rectangle
-                    std::vector<Point2d> objPts(4);
-                    if (screenRot == 0.0)
-                    {
-                        for (unsigned int ii=0;ii<4;ii++)
-                            objPts[ii] = Point2d(objPt.x,objPt.y) + entry->obj.layoutPts[ii] * resScale;
-                    } else {
-                        Point2d center(objPt.x,objPt.y);
-                        for (unsigned int ii=0;ii<4;ii++)
-                        {
-                            Point2d thisObjPt = entry->obj.layoutPts[ii];
-                            Point2d offPt = screenRotMat * Point2d(thisObjPt.x()*resScale,thisObjPt.y()*resScale);
-                            objPts[ii] = Point2d(offPt.x(),-offPt.y()) + center;
-                        }
-                    }
-
-                    
-                    clusterHelper.addObject(entry,objPts);
+                clusterList.push_back(clusterGroup);
+                clusterIndexList.push_back(&it->second);
+            }
+        }
+        int firstParamID = (int)clusterParams.size();
+        clusterParams.resize(firstParamID + clusterList.size());
+        for (unsigned int ci=0;ci<clusterList.size();ci++)
+            clusterGen->paramsForClusterClass(clusterList[ci],clusterParams[firstParamID+ci]);
+        
+        // Size of a pixel in the clustering space and the part of that space we can see
+        bool isFlat = scene->getCoordAdapter()->isFlat();
+        auto screenToCluster = [&](const Point2d &screenPt,Point2d &clusterPt) -> bool
+        {
+            Point3d hit;
+            bool valid = false;
+            if (globeViewState)
+                valid = [globeViewState pointOnSphereFromScreen:CGPointMake(screenPt.x(),screenPt.y()) transform:&modelTrans frameSize:frameBufferSize hit:&hit];
+            else
+                valid = [mapViewState pointOnPlaneFromScreen:CGPointMake(screenPt.x(),screenPt.y()) transform:&modelTrans frameSize:frameBufferSize hit:&hit clip:false];
+            if (valid)
+                clusterPt = isFlat ? Point2d(hit.x(),hit.y()) : ClusterPointFromDisplay(hit);
+            return valid;
+        };
+        double pixelSize = 0.0;
+        Point2d screenCenter(frameBufferSize.x()/2.0,frameBufferSize.y()/2.0);
+        Point2d centerPt,rightPt,downPt;
+        if (screenToCluster(screenCenter,centerPt) && screenToCluster(screenCenter + Point2d(ClusterPixelStep,0.0),rightPt) &&
+            screenToCluster(screenCenter + Point2d(0.0,ClusterPixelStep),downPt))
+        {
+            Point2d rightDiff = rightPt - centerPt, downDiff = downPt - centerPt;
+            // Across the date line, the long way around isn't what we want
+            if (!isFlat)
+            {
+                if (fabs(rightDiff.x()) > 0.5)  rightDiff.x() = 1.0 - fabs(rightDiff.x());
+                if (fabs(downDiff.x()) > 0.5)  downDiff.x() = 1.0 - fabs(downDiff.x());
+            }
+            pixelSize = std::max(rightDiff.norm(),downDiff.norm()) / ClusterPixelStep;
+        }
+        // If we can see the whole screen's worth of surface, that's the area to look in.
+        // Otherwise (the globe's edge is showing or the map wraps) we look at everything.
+        bool haveExtent = pixelSize > 0.0 && viewInfo.fullMatrices.size() == 1;
+        Point2d extentLL(0,0),extentUR(0,0);
+        for (int iy=0;iy<ClusterExtentSamples && haveExtent;iy++)
+            for (int ix=0;ix<ClusterExtentSamples && haveExtent;ix++)
+            {
+                Point2d screenPt(screenMbr.ll().x() + (screenMbr.ur().x()-screenMbr.ll().x()) * ix / (ClusterExtentSamples-1),
+                                 screenMbr.ll().y() + (screenMbr.ur().y()-screenMbr.ll().y()) * iy / (ClusterExtentSamples-1));
+                Point2d clusterPt;
+                if (!screenToCluster(screenPt,clusterPt))
+                    haveExtent = false;
+                else if (ix == 0 && iy == 0)
+                    extentLL = extentUR = clusterPt;
+                else {
+                    extentLL = extentLL.cwiseMin(clusterPt);
+                    extentUR = extentUR.cwiseMax(clusterPt);
                 }
             }
-            
-            // Deal with the clusters and their own overlaps
-            clusterHelper.resolveClusters();
+        
+        // Cluster groups don't interact, so look them up in parallel
+        std::vector<ClusterGroupResults> groupResults(clusterList.size());
+        const ClusterIndex<LayoutObjectEntry *> **clusterIndexPtrs = clusterIndexList.data();
+        ClusterGroupResults *groupResultPtrs = groupResults.data();
+        const ClusterGenerator::ClusterClassParams *paramsPtrs = clusterParams.data() + firstParamID;
+        dispatch_apply(clusterList.size(), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
+                       ^(size_t ci)
+                       {
+                           const ClusterIndex<LayoutObjectEntry *> &clusterIndex = *clusterIndexPtrs[ci];
+                           ClusterGroupResults &results = groupResultPtrs[ci];
+                           
+                           // Clusters closer than a marker's width would overlap
+                           const Point2d &clusterSize = paramsPtrs[ci].clusterSize;
+                           int level = 0;
+                           if (pixelSize > 0.0)
+                               level = clusterIndex.levelForRadius(std::max(clusterSize.x(),clusterSize.y()) * resScale * pixelSize);
+                           
+                           auto visit = [&](const ClusterIndex<LayoutObjectEntry *>::Node &node)
+                           {
+                               // Some of what's in there might not be visible right now
+                               std::vector<LayoutObjectEntry *> objs;
+                               for (int li=node.leafStart;li<node.leafEnd;li++)
+                               {
+                                   LayoutObjectEntry *entry = clusterIndex.getLeaf(li);
+                                   if (entry->obj.enable && entry->visible)
+                                       objs.push_back(entry);
+                               }
+                               if (objs.size() == 1)
+                               {
+                                   results.simpleObjs.push_back(objs[0]);
+                               } else if (objs.size() > 1)
+                               {
+                                   ClusterGroupResults::Cluster cluster;
+                                   cluster.dispCenter = node.dispCenter;
+                                   if (!isFlat)
+                                       cluster.dispCenter.normalize();
+                                   Point2d screenPt;
+                                   if (!CalcScreenPt(screenPt,cluster.dispCenter,*viewInfoPtr))
+                                   {
+                                       // The middle of the whole cluster can be off screen or around the
+                                       //  back of the globe when some of it isn't.  Try the middle of what we can see.
+                                       bool placed = false;
+                                       if ((int)objs.size() < node.getCount())
+                                       {
+                                           cluster.dispCenter = Point3d(0,0,0);
+                                           for (LayoutObjectEntry *entry : objs)
+                                               cluster.dispCenter += entry->obj.worldLoc;
+                                           cluster.dispCenter /= (double)objs.size();
+                                           if (!isFlat)
+                                               cluster.dispCenter.normalize();
+                                           placed = CalcScreenPt(screenPt,cluster.dispCenter,*viewInfoPtr);
+                                       }
+                                       // Nowhere to put the cluster, so they'll have to fend for themselves
+                                       if (!placed)
+                                       {
+                                           results.simpleObjs.insert(results.simpleObjs.end(),objs.begin(),objs.end());
+                                           return;
+                                       }
+                                   }
+                                   cluster.objs.swap(objs);
+                                   results.clusters.push_back(cluster);
+                               }
+                           };
+                           if (haveExtent)
+                               clusterIndex.query(level,extentLL,extentUR,visit);
+                           else
+                               clusterIndex.queryAll(level,visit);
+                       });
+
+        // Now sort out the results in order
+        for (unsigned int ci=0;ci<clusterList.size();ci++)
+        {
+            int clusterID = clusterList[ci];
+            ClusterGroupResults &results = groupResults[ci];
+            int clusterParamID = firstParamID + ci;
+            ClusterGenerator::ClusterClassParams &params = clusterParams[clusterParamID];
 
             // Toss the unaffected layout objects into the mix
-            for (auto obj : clusterHelper.simpleObjects)
-                if (obj.parentObject < 0)
-                {
-                    layoutObjs.insert(obj.objEntry);
-                    obj.objEntry->newEnable = true;
-                    obj.objEntry->newCluster = -1;
-                }
+            for (LayoutObjectEntry *obj : results.simpleObjs)
+            {
+                layoutObjs.insert(obj);
+                obj->newEnable = true;
+                obj->newCluster = -1;
+            }
             
             // Create new objects for the clusters
-            for (auto clusterObj : clusterHelper.clusterObjects)
+            for (ClusterGroupResults::Cluster &cluster : results.clusters)
             {
-                std::vector<LayoutObjectEntry *> objsForCluster;
-                clusterHelper.objectsForCluster(clusterObj,objsForCluster);
+                std::vector<LayoutObjectEntry *> &objsForCluster = cluster.objs;
                 
-                if (!objsForCluster.empty())
+                int clusterEntryID = clusterEntries.size();
+                clusterEntries.resize(clusterEntryID+1);
+                ClusterEntry &clusterEntry = clusterEntries[clusterEntryID];
+
+                clusterEntry.layoutObj.worldLoc = cluster.dispCenter;
+                for (auto thisObj : objsForCluster)
+                    clusterEntry.objectIDs.push_back(thisObj->obj.getId());
+                clusterGen->makeLayoutObject(clusterID, objsForCluster, clusterEntry.layoutObj);
+                if (!params.selectable)
+                    clusterEntry.layoutObj.selectPts.clear();
+                clusterEntry.clusterParamID = clusterParamID;
+
+                // Figure out if all the objects in this new cluster come from the same old cluster
+                //  and assign the new cluster ID
+                int whichOldCluster = -1;
+                for (auto obj : objsForCluster)
                 {
-                    int clusterEntryID = clusterEntries.size();
-                    clusterEntries.resize(clusterEntryID+1);
-                    ClusterEntry &clusterEntry = clusterEntries[clusterEntryID];
-
-                    // Project the cluster back into a geolocation so we can place it.
-                    Point3d dispPt;
-                    bool dispPtValid = false;
-                    if (globeViewState)
+                    if (obj->currentCluster > -1 && whichOldCluster != -2)
                     {
-                        dispPtValid = [globeViewState pointOnSphereFromScreen:CGPointMake(clusterObj.center.x(),clusterObj.center.y()) transform:&modelTrans frameSize:frameBufferSize hit:&dispPt];
-                    } else {
-                        dispPtValid = [mapViewState pointOnPlaneFromScreen:CGPointMake(clusterObj.center.x(),clusterObj.center.y()) transform:&modelTrans frameSize:frameBufferSize hit:&dispPt clip:false];
-                    }
-
-                    // Note: What happens if the display point isn't valid?
-                    if (dispPtValid)
-                    {
-                        clusterEntry.layoutObj.worldLoc = dispPt;
-                        for (auto thisObj : objsForCluster)
-                            clusterEntry.objectIDs.push_back(thisObj->obj.getId());
-                        clusterGen->makeLayoutObject(cluster->clusterID, objsForCluster, clusterEntry.layoutObj);
-                        if (!params.selectable)
-                            clusterEntry.layoutObj.selectPts.clear();
-                    }
-                    clusterEntry.clusterParamID = clusterParams.size()-1;
-
-                    // Figure out if all the objects in this new cluster come from the same old cluster
-                    //  and assign the new cluster ID
-                    int whichOldCluster = -1;
-                    for (auto obj : objsForCluster)
-                    {
-                        if (obj->currentCluster > -1 && whichOldCluster != -2)
-                        {
-                            if (whichOldCluster == -1)
-                                whichOldCluster = obj->currentCluster;
-                            else {
-                                if (whichOldCluster != obj->currentCluster)
-                                    whichOldCluster = -2;
-                            }
+                        if (whichOldCluster == -1)
+                            whichOldCluster = obj->currentCluster;
+                        else {
+                            if (whichOldCluster != obj->currentCluster)
+                                whichOldCluster = -2;
                         }
-                        obj->newCluster = clusterEntryID;
                     }
-                    
-                    // If the children all agree about the old cluster, let's reflect that
-                    clusterEntry.childOfCluster = (whichOldCluster == -2) ? -1 : whichOldCluster;
+                    obj->newCluster = clusterEntryID;
                 }
+                
+                // If the children all agree about the old cluster, let's reflect that
+                clusterEntry.childOfCluster = (whichOldCluster == -2) ? -1 : whichOldCluster;
             }
         }
         
-        // Tear down the clusters
-        for (ClusteredObjectsSet::iterator it = clusterObjs.begin(); it != clusterObjs.end(); ++it)
-            delete *it;
-        clusterObjs.clear();
-        
         clusterGen->endLayoutObjects();
     }
     
 //    NSLog(@"----Starting Layout----");
     
-    // Set up the overlap sampler
-    OverlapHelper overlapMan(screenMbr,OverlapSampleX,OverlapSampleY);
+    // Lay out the various objects that are active, in importance order
+    std::vector<LayoutObjectEntry *> layoutOrder(layoutObjs.begin(),layoutObjs.end());
+    std::vector<LayoutOverlapObject> overlapOrder(layoutOrder.size());
+    for (unsigned int ii=0;ii<layoutOrder.size();ii++)
+    {
+        overlapOrder[ii].placement = &layoutOrder[ii]->placement;
+        overlapOrder[ii].layoutPts = &layoutOrder[ii]->obj.layoutPts;
+        overlapOrder[ii].acceptablePlacement = layoutOrder[ii]->obj.acceptablePlacement;
+    }
+    LayoutOverlapPass(overlapOrder,lastLayoutOrder,!startOver,maxDisplayObjects,resScale,screenMbr,OverlapSampleX,OverlapSampleY);
     
-    // Lay out the various objects that are active
-    int numSoFar = 0;
-    for (LayoutSortingSet::iterator it = layoutObjs.begin();
-         it != layoutObjs.end(); ++it)
+    for (LayoutObjectEntry *layoutObj : layoutOrder)
     {
-        LayoutObjectEntry *layoutObj = *it;
-        bool isActive;
-        Point2d objOffset(0.0,0.0);
-        std::vector<Point2d> objPts(4);
-        
-        // Start with a max objects check
-        isActive = true;
-        if (maxDisplayObjects != 0 && (numSoFar >= maxDisplayObjects))
-            isActive = false;
-        
-        // Figure out the rotation situation
-        float screenRot = 0.0;
-        Matrix2d screenRotMat;
-        if (isActive)
-        {
-            CGPoint objPt;
-            bool isInside = calcScreenPt(objPt,layoutObj,viewState,screenMbr,frameBufferSize);
-            
-            isActive &= isInside;
-            
-            // Deal with the rotation
-            if (layoutObj->obj.rotation != 0.0)
-                screenRotMat = calcScreenRot(screenRot,viewState,globeViewState,&layoutObj->obj,objPt,modelTrans,normalMat,frameBufferSize);
-            
-            // Now for the overlap checks
-            if (isActive)
-            {
-                // Try the four different orientations
-                if (!layoutObj->obj.layoutPts.empty())
-                {
-                    bool validOrient = false;
-                    for (unsigned int orient=0;orient<6;orient++)
-                    {
-                        // May only want to be placed certain ways.  Fair enough.
-                        if (!(layoutObj->obj.acceptablePlacement & (1<<orient)))
-                            continue;
-                        const std::vector<Point2d> &layoutPts = layoutObj->obj.layoutPts;
-                        Mbr layoutMbr;
-                        for (unsigned int li=0;li<layoutPts.size();li++)
-                            layoutMbr.addPoint(layoutPts[li]);
-                        Point2f layoutSpan(layoutMbr.ur().x()-layoutMbr.ll().x(),layoutMbr.ur().y()-layoutMbr.ll().y());
-                        Point2d layoutOrg(layoutMbr.ll().x(),layoutMbr.ll().y());
-                        
-                        // Set up the offset for this orientation
-                        switch (orient)
-                        {
-                            // Don't move at all
-                            case 0:
-                                objOffset = Point2d(0,0);
-                                break;
-                            // Center
-                            case 1:
-                                objOffset = Point2d(-layoutSpan.x()/2.0,layoutSpan.y()/2.0);
-                                break;
-                            // Right
-                            case 2:
-                                objOffset = Point2d(0.0,layoutSpan.y()/2.0);
-                                break;
-                            // Left
-                            case 3:
-                                objOffset = Point2d(-(layoutSpan.x()),layoutSpan.y()/2.0);
-                                break;
-                            // Above
-                            case 4:
-                                objOffset = Point2d(-layoutSpan.x()/2.0,0);
-                                break;
-                            // Below
-                            case 5:
-                                objOffset = Point2d(-layoutSpan.x()/2.0,layoutSpan.y());
-                                break;
-                        }
-                        
-                        // Rotate the rectangle
-                        if (screenRot == 0.0) 
-                        {
-                            objPts[0] = Point2d(objPt.x,objPt.y) + (objOffset + layoutOrg)*resScale;
-                            objPts[1] = objPts[0] + Point2d(layoutSpan.x()*resScale,0.0);
-                            objPts[2] = objPts[0] + Point2d(layoutSpan.x()*resScale,layoutSpan.y()*resScale);
-                            objPts[3] = objPts[0] + Point2d(0.0,layoutSpan.y()*resScale);
-                        } else {
-                            Point2d center(objPt.x,objPt.y);
-                            objPts[0] = Point2d(objOffset.x(),-objOffset.y()) + layoutOrg;
-                            objPts[1] = Point2d(objOffset.x(),-objOffset.y()) + layoutOrg + Point2d(layoutSpan.x(),0.0);
-                            objPts[2] = Point2d(objOffset.x(),-objOffset.y()) + layoutOrg + Point2d(layoutSpan.x(),layoutSpan.y());
-                            objPts[3] = Point2d(objOffset.x(),-objOffset.y()) + layoutOrg + Point2d(0.0,layoutSpan.y());
-                            for (unsigned int oi=0;oi<4;oi++)
-                            {
-                                Point2d &thisObjPt = objPts[oi];
-                                Point2d offPt = screenRotMat * Point2d(thisObjPt.x()*resScale,thisObjPt.y()*resScale);
-                                thisObjPt = Point2d(offPt.x(),-offPt.y()) + center;
-                            }
-                        }
-                        
-//                        NSLog(@"Center pt = (%f,%f), orient = %d",objPt.x,objPt.y,orient);
-//                        NSLog(@"Layout Pts");
-//                        for (unsigned int xx=0;xx<objPts.size();xx++)
-//                           NSLog(@"  (%f,%f)\n",objPts[xx].x(),objPts[xx].y());
-                        
-                        // Now try it
-                        if (overlapMan.addObject(objPts))
-                        {
-                            validOrient = true;
-                            break;
-                        }
-                    }
-                    
-                    isActive = validOrient;
-                }
-            }
-
-//            NSLog(@" Valid (%s): %@, pos = (%f,%f), size = (%f, %f), offset = (%f,%f)",(isActive ? "yes" : "no"),layoutObj->obj.hint,objPt.x,objPt.y,layoutObj->obj.size.x(),layoutObj->obj.size.y(),
-//                  layoutObj->offset.x(),layoutObj->offset.y());
-        }
-        
-        if (isActive)
-            numSoFar++;
+        bool isActive = layoutObj->placement.active;
+        const Point2d &objOffset = layoutObj->placement.offset;
         
         // See if we've changed any of the state
-        layoutObj->changed = (layoutObj->currentEnable != isActive);
-        if (!layoutObj->changed && (layoutObj->newEnable ||
-            (layoutObj->offset.x() != objOffset.x() || layoutObj->offset.y() != -objOffset.y())))
-        {
-            layoutObj->changed = true;
-        }
+        bool offsetChanged = layoutObj->offset.x() != objOffset.x() || layoutObj->offset.y() != -objOffset.y();
+        layoutObj->changed = (layoutObj->currentEnable != isActive) || (isActive && offsetChanged);
         hadChanges |= layoutObj->changed;
         layoutObj->newEnable = isActive;
         layoutObj->newCluster = -1;
@@ -731,9 +810,14 @@ void LayoutManager::updateLayout(WhirlyKitViewState *viewState,ChangeSet &change
     // Compare old and new clusters
     if (!layoutChanges && clusters.size() != oldClusters.size())
         layoutChanges = true;
+    // The cluster images are made fresh every round and the old ones go away, so redo the drawables
+    if (!clusters.empty())
+        layoutChanges = true;
     
     if (hasUpdates || layoutChanges)
     {
+        generation++;
+        
         // Get rid of the last set of drawables
         for (SimpleIDSet::iterator it = drawIDs.begin(); it != drawIDs.end(); ++it)
             changes.push_back(new RemDrawableReq(*it));
@@ -260,6 +260,34 @@ void TileBuilder::textureSize(int width, int height,int *destWidth,int *destHeig
     }
 }
 
+TileGridTemplate::TileGridTemplate(int tessX,int tessY)
+    : tessX(tessX), tessY(tessY)
+{
+    // Same increments the tile builder used to calculate per tile
+    TexCoord texIncr(1.0/(float)tessX,1.0/(float)tessY);
+    unitCoords.reserve((tessX+1)*(tessY+1));
+    for (unsigned int iy=0;iy<tessY+1;iy++)
+        for (unsigned int ix=0;ix<tessX+1;ix++)
+            unitCoords.push_back(TexCoord(ix*texIncr.x(),iy*texIncr.y()));
+    
+    tris.reserve(2*tessX*tessY);
+    for (unsigned int iy=0;iy<tessY;iy++)
+    {
+        for (unsigned int ix=0;ix<tessX;ix++)
+        {
+            BasicDrawable::Triangle triA,triB;
+            triA.verts[0] = (iy+1)*(tessX+1)+ix;
+            triA.verts[1] = iy*(tessX+1)+ix;
+            triA.verts[2] = (iy+1)*(tessX+1)+(ix+1);
+            triB.verts[0] = triA.verts[2];
+            triB.verts[1] = triA.verts[1];
+            triB.verts[2] = iy*(tessX+1)+(ix+1);
+            tris.push_back(triA);
+            tris.push_back(triB);
+        }
+    }
+}
+
 TileBuilder::TileBuilder(CoordSystem *coordSys,Mbr mbr,WhirlyKit::Quadtree *quadTree)
     : coordSys(coordSys), mbr(mbr), tree(quadTree),
     tileScale(WKTileScaleNone), fixedTileSize(128),
@@ -287,6 +315,7 @@ TileBuilder::TileBuilder(CoordSystem *coordSys,Mbr mbr,WhirlyKit::Quadtree *quad
     useTileCenters(true)
 {
     pthread_mutex_init(&texAtlasMappingLock, NULL);
+    pthread_mutex_init(&gridTemplateLock, NULL);
 }
 
 TileBuilder::~TileBuilder()
@@ -295,6 +324,7 @@ TileBuilder::~TileBuilder()
     texAtlasMappings.clear();
     pthread_mutex_unlock(&texAtlasMappingLock);
     pthread_mutex_destroy(&texAtlasMappingLock);
+    pthread_mutex_destroy(&gridTemplateLock);
     
     if (texAtlas)
     {
@@ -411,6 +441,23 @@ void TileBuilder::buildSkirt(BasicDrawable *draw,std::vector<Point3d> &pts,std::
     }
 }
     
+TileGridTemplateRef TileBuilder::getGridTemplate(int tessX,int tessY)
+{
+    TileGridTemplateRef gridTemplate;
+    
+    pthread_mutex_lock(&gridTemplateLock);
+    auto it = gridTemplates.find(std::pair<int,int>(tessX,tessY));
+    if (it == gridTemplates.end())
+    {
+        gridTemplate = TileGridTemplateRef(new TileGridTemplate(tessX,tessY));
+        gridTemplates[std::pair<int,int>(tessX,tessY)] = gridTemplate;
+    } else
+        gridTemplate = it->second;
+    pthread_mutex_unlock(&gridTemplateLock);
+    
+    return gridTemplate;
+}
+    
 void TileBuilder::generateDrawables(WhirlyKit::ElevationDrawInfo *drawInfo,BasicDrawable **draw,BasicDrawable **skirtDraw,BasicDrawable **poleDraw)
 {
     // Size of each chunk
@@ -480,6 +527,32 @@ void TileBuilder::generateDrawables(WhirlyKit::ElevationDrawInfo *drawInfo,Basic
     } else
         poleChunk = chunk;
     
+    TileGridTemplateRef gridTemplate = getGridTemplate(sphereTessX,sphereTessY);
+    int numGridPts = (sphereTessX+1)*(sphereTessY+1);
+    
+    // Convert the whole grid to display coordinates in one go
+    std::vector<Point3d> locs(numGridPts);
+    if (drawInfo->coordAdapter->isFlat() && coordSys->isSameAs(sceneCoordSys))
+    {
+        // The flat display adapters are just a scale and offset, so we only need the corners
+        Point3d dispCorners[2];
+        dispCorners[0] = Point3d(chunkLL.x(),chunkLL.y(),0.0);
+        dispCorners[1] = Point3d(chunkUR.x(),chunkUR.y(),0.0);
+        drawInfo->coordAdapter->localToDisplay(dispCorners,dispCorners,2);
+        Point3d dispSize = dispCorners[1] - dispCorners[0];
+        for (unsigned int ii=0;ii<numGridPts;ii++)
+        {
+            const TexCoord &unitCoord = gridTemplate->unitCoords[ii];
+            locs[ii] = Point3d(dispCorners[0].x()+unitCoord.x()*dispSize.x(),dispCorners[0].y()+unitCoord.y()*dispSize.y(),dispCorners[0].z());
+        }
+    } else {
+        for (unsigned int iy=0;iy<sphereTessY+1;iy++)
+            for (unsigned int ix=0;ix<sphereTessX+1;ix++)
+                locs[iy*(sphereTessX+1)+ix] = Point3d(chunkLL.x()+ix*incr.x(),chunkLL.y()+iy*incr.y(),0.0);
+        CoordSystemConvert3d(coordSys,sceneCoordSys,&locs[0],&locs[0],numGridPts);
+        drawInfo->coordAdapter->localToDisplay(&locs[0],&locs[0],numGridPts);
+    }
+    
     // We're in line mode or the texture didn't load
     if (lineMode || (drawInfo->texs && !(drawInfo->texs)->empty() && !((*(drawInfo->texs))[0])))
     {
@@ -489,9 +562,9 @@ void TileBuilder::generateDrawables(WhirlyKit::ElevationDrawInfo *drawInfo,Basic
         for (unsigned int iy=0;iy<sphereTessY;iy++)
             for (unsigned int ix=0;ix<sphereTessX;ix++)
             {
-                Point3d org3D = drawInfo->coordAdapter->localToDisplay(CoordSystemConvert3d(coordSys,sceneCoordSys,Point3d(chunkLL.x()+ix*incr.x(),chunkLL.y()+iy*incr.y(),0.0)));
-                Point3d ptA_3D = drawInfo->coordAdapter->localToDisplay(CoordSystemConvert3d(coordSys,sceneCoordSys,Point3d(chunkLL.x()+(ix+1)*incr.x(),chunkLL.y()+iy*incr.y(),0.0)));
-                Point3d ptB_3D = drawInfo->coordAdapter->localToDisplay(CoordSystemConvert3d(coordSys,sceneCoordSys,Point3d(chunkLL.x()+ix*incr.x(),chunkLL.y()+(iy+1)*incr.y(),0.0)));
+                const Point3d &org3D = locs[iy*(sphereTessX+1)+ix];
+                const Point3d &ptA_3D = locs[iy*(sphereTessX+1)+ix+1];
+                const Point3d &ptB_3D = locs[(iy+1)*(sphereTessX+1)+ix];
                 
                 TexCoord texCoord(ix*texIncr.x()*drawInfo->texScale.x()+drawInfo->texOffset.x(),1.0-(iy*texIncr.y()*drawInfo->texScale.y()+drawInfo->texOffset.y()));
                 
@@ -511,71 +584,34 @@ void TileBuilder::generateDrawables(WhirlyKit::ElevationDrawInfo *drawInfo,Basic
             }
     } else {
         chunk->setType(GL_TRIANGLES);
-        // Generate point, texture coords, and normals
-        std::vector<Point3d> locs((sphereTessX+1)*(sphereTessY+1));
-        std::vector<float> elevs;
-        if (includeElev || useElevAsZ)
-            elevs.resize((sphereTessX+1)*(sphereTessY+1));
-        std::vector<TexCoord> texCoords((sphereTessX+1)*(sphereTessY+1));
-        for (unsigned int iy=0;iy<sphereTessY+1;iy++)
-        {
-            for (unsigned int ix=0;ix<sphereTessX+1;ix++)
-            {
-                float locZ = 0.0;
-                Point3d loc3D = drawInfo->coordAdapter->localToDisplay(CoordSystemConvert3d(coordSys,sceneCoordSys,Point3d(chunkLL.x()+ix*incr.x(),chunkLL.y()+iy*incr.y(),locZ)));
-                if (drawInfo->coordAdapter->isFlat())
-                    loc3D.z() = locZ;
-                
-                // Use Z priority to sort the levels
-                //                    if (singleLevel != -1)
-                //                        loc3D.z() = (drawPriority + nodeInfo->ident.level * 0.01)/10000;
-                
-                locs[iy*(sphereTessX+1)+ix] = loc3D;
-                
-                // Do the texture coordinate seperately
-                TexCoord texCoord(ix*texIncr.x()*drawInfo->texScale.x()+drawInfo->texOffset.x(),1.0-(iy*texIncr.y()*drawInfo->texScale.y()+drawInfo->texOffset.y()));
-                texCoords[iy*(sphereTessX+1)+ix] = texCoord;
-            }
-        }
+        bool isFlat = drawInfo->coordAdapter->isFlat();
         
-        // Without elevation data we can share the vertices
-        for (unsigned int iy=0;iy<sphereTessY+1;iy++)
+        // Texture coordinates are the template's, scaled and offset for this tile
+        std::vector<TexCoord> texCoords(numGridPts);
+        for (unsigned int ii=0;ii<numGridPts;ii++)
         {
-            for (unsigned int ix=0;ix<sphereTessX+1;ix++)
-            {
-                Point3d &loc3D = locs[iy*(sphereTessX+1)+ix];
-                
-                // And the normal
-                Point3d norm3D;
-                if (drawInfo->coordAdapter->isFlat())
-                    norm3D = drawInfo->coordAdapter->normalForLocal(loc3D);
-                else
-                    norm3D = loc3D;
-                
-                TexCoord &texCoord = texCoords[iy*(sphereTessX+1)+ix];
-                
-                chunk->addPoint(Point3d(loc3D-drawInfo->chunkMidDisp));
-                chunk->addNormal(norm3D);
-                chunk->addTexCoord(-1,texCoord);
-            }
+            const TexCoord &unitCoord = gridTemplate->unitCoords[ii];
+            texCoords[ii] = TexCoord(unitCoord.x()*drawInfo->texScale.x()+drawInfo->texOffset.x(),1.0-(unitCoord.y()*drawInfo->texScale.y()+drawInfo->texOffset.y()));
         }
         
-        // Two triangles per cell
-        for (unsigned int iy=0;iy<sphereTessY;iy++)
+        // Without elevation data we can share the vertices
+        std::vector<Point3f> pts(numGridPts),norms(numGridPts);
+        Point3f flatNorm(0,0,1);
+        if (isFlat)
+            flatNorm = drawInfo->coordAdapter->normalForLocal(flatNorm);
+        for (unsigned int ii=0;ii<numGridPts;ii++)
         {
-            for (unsigned int ix=0;ix<sphereTessX;ix++)
-            {
-                BasicDrawable::Triangle triA,triB;
-                triA.verts[0] = (iy+1)*(sphereTessX+1)+ix;
-                triA.verts[1] = iy*(sphereTessX+1)+ix;
-                triA.verts[2] = (iy+1)*(sphereTessX+1)+(ix+1);
-                triB.verts[0] = triA.verts[2];
-                triB.verts[1] = triA.verts[1];
-                triB.verts[2] = iy*(sphereTessX+1)+(ix+1);
-                chunk->addTriangle(triA);
-                chunk->addTriangle(triB);
-            }
+            Point3d &loc3D = locs[ii];
+            if (isFlat)
+                loc3D.z() = 0.0;
+            Point3d pt = loc3D-drawInfo->chunkMidDisp;
+            pts[ii] = Point3f(pt.x(),pt.y(),pt.z());
+            norms[ii] = isFlat ? flatNorm : Point3f(loc3D.x(),loc3D.y(),loc3D.z());
         }
+        chunk->addPoints(&pts[0],numGridPts);
+        chunk->addNormals(&norms[0],numGridPts);
+        chunk->addTexCoords(-1,&texCoords[0],numGridPts);
+        chunk->addTriangles(&gridTemplate->tris[0],(int)gridTemplate->tris.size());
         
         if (!drawInfo->ignoreEdgeMatching && !drawInfo->coordAdapter->isFlat() && skirtDraw)
         {
@@ -244,6 +244,12 @@ public:
             drawable->setRequestZBuffer(polyInfo->readZBuffer);
             drawable->setWriteZBuffer(polyInfo->writeZBuffer);
         }
+        // Make room for what's coming, out of the shared vertex arenas
+        if (numToAdd > 0)
+        {
+            drawable->reserveNumPoints(numToAdd);
+            drawable->reserveNumNorms(drawable->getNumPoints()+numToAdd);
+        }
     }
     
     // Add a triangle, keeping track of limits
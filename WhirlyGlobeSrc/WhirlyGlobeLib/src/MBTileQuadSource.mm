@@ -146,6 +146,15 @@ using namespace WhirlyKit;
     return import;
 }
 
+- (void)importanceForTiles:(std::vector<WhirlyKit::Quadtree::ImportanceRequest> &)requests viewInfo:(WhirlyKitViewState *)viewState frameSize:(WhirlyKit::Point2f)frameSize
+{
+    ScreenImportance(viewState, frameSize, _pixelsPerTile, _coordSys, viewState.coordAdapter, requests);
+    // Everything at the top is loaded in
+    for (Quadtree::ImportanceRequest &request : requests)
+        if (request.ident.level == _minZoom)
+            request.importance = MAXFLOAT;
+}
+
 // Just one fetch at a time
 - (int)maxSimultaneousFetches
 {
@@ -33,18 +33,20 @@ MapScene::MapScene(WhirlyKit::CoordSystemDisplayAdapter *coordAdapter)
 void MapScene::addDrawable(DrawableRef draw)
 {
     drawables.insert(draw);
+    draw->setDrawListSlot(drawList.addDrawable(draw.get(),draw->getDrawListKey()));
     
     // Dump it in the top level for now
     Mbr localMbr = draw->getLocalMbr();
-    cullTree->getTopCullable()->addDrawable(cullTree, localMbr, draw);
+    cullTree->addDrawable(draw->getDrawListSlot(), localMbr, draw->getMatrix() != NULL);
 }
 
 void MapScene::remDrawable(DrawableRef draw)
 {
     // We're expecting it to just be at the top level
-    Mbr localMbr = draw->getLocalMbr();
-    cullTree->getTopCullable()->remDrawable(cullTree, localMbr, draw);
+    cullTree->remDrawable(draw->getDrawListSlot());
     
+    drawList.removeDrawable(draw->getDrawListSlot());
+    draw->setDrawListSlot(-1);
     drawables.erase(draw);
 }
     
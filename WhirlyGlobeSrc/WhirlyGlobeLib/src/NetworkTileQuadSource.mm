@@ -85,6 +85,15 @@ using namespace WhirlyKit;
     return ScreenImportance(viewState, frameSize, viewState.eyeVec, pixelsPerTile, coordSys, viewState.coordAdapter, tileMbr, ident, attrs);
 }
 
+- (void)importanceForTiles:(std::vector<WhirlyKit::Quadtree::ImportanceRequest> &)requests viewInfo:(WhirlyKitViewState *)viewState frameSize:(WhirlyKit::Point2f)frameSize
+{
+    ScreenImportance(viewState, frameSize, pixelsPerTile, coordSys, viewState.coordAdapter, requests);
+    // Everything at the top is loaded in
+    for (Quadtree::ImportanceRequest &request : requests)
+        if (request.ident.level == minZoom)
+            request.importance = MAXFLOAT;
+}
+
 @end
 
 @implementation WhirlyKitNetworkTileQuadSource
@@ -19,8 +19,7 @@
  */
 
 #import "OverlapHelper.h"
-#import "LayoutManager.h"
-#import "VectorData.h"
+#import "WhirlyGeometry.h"
 
 using namespace Eigen;
 
@@ -34,20 +33,27 @@ OverlapHelper::OverlapHelper(const Mbr &mbr,int sizeX,int sizeY)
     cellSize = Point2f((mbr.ur().x()-mbr.ll().x())/sizeX,(mbr.ur().y()-mbr.ll().y())/sizeY);
 }
 
-// Try to add an object.  Might fail (kind of the whole point).
-bool OverlapHelper::addObject(const std::vector<Point2d> &pts)
+// Range of cells the given object covers
+void OverlapHelper::calcCells(const std::vector<Point2d> &pts,int &sx,int &sy,int &ex,int &ey)
 {
     Mbr objMbr;
     for (unsigned int ii=0;ii<pts.size();ii++)
         objMbr.addPoint(pts[ii]);
-    int sx = floorf((objMbr.ll().x()-mbr.ll().x())/cellSize.x());
+    sx = floorf((objMbr.ll().x()-mbr.ll().x())/cellSize.x());
     if (sx < 0) sx = 0;
-    int sy = floorf((objMbr.ll().y()-mbr.ll().y())/cellSize.y());
+    sy = floorf((objMbr.ll().y()-mbr.ll().y())/cellSize.y());
     if (sy < 0) sy = 0;
-    int ex = ceilf((objMbr.ur().x()-mbr.ll().x())/cellSize.x());
+    ex = ceilf((objMbr.ur().x()-mbr.ll().x())/cellSize.x());
     if (ex >= sizeX)  ex = sizeX-1;
-    int ey = ceilf((objMbr.ur().y()-mbr.ll().y())/cellSize.y());
+    ey = ceilf((objMbr.ur().y()-mbr.ll().y())/cellSize.y());
     if (ey >= sizeY)  ey = sizeY-1;
+}
+
+// Try to add an object.  Might fail (kind of the whole point).
+bool OverlapHelper::addObject(const std::vector<Point2d> &pts)
+{
+    int sx,sy,ex,ey;
+    calcCells(pts,sx,sy,ex,ey);
     for (int ix=sx;ix<=ex;ix++)
         for (int iy=sy;iy<=ey;iy++)
         {
@@ -62,6 +68,17 @@ bool OverlapHelper::addObject(const std::vector<Point2d> &pts)
         }
     
     // Okay, so it doesn't overlap.  Let's add it where needed.
+    placeObject(pts);
+    
+    return true;
+}
+    
+// Add an object without checking it against the others
+void OverlapHelper::placeObject(const std::vector<Point2d> &pts)
+{
+    int sx,sy,ex,ey;
+    calcCells(pts,sx,sy,ex,ey);
+
     objects.resize(objects.size()+1);
     int newId = (int)(objects.size()-1);
     BoundedObject &newObj = objects[newId];
@@ -72,227 +89,178 @@ bool OverlapHelper::addObject(const std::vector<Point2d> &pts)
             std::vector<int> &objList = grid[iy*sizeX + ix];
             objList.push_back(newId);
         }
-    
-    return true;
 }
     
-ClusterHelper::ObjectWithBounds::ObjectWithBounds()
-{
-}
+// Objects that move less than this (in pixels) keep the position they were laid out with
+static const double LayoutMoveThreshold = 1.0;
+// Same for rotation, in radians
+static const double LayoutRotThreshold = 0.01;
 
-ClusterHelper::SimpleObject::SimpleObject()
-    : objEntry(NULL), parentObject(-1)
+LayoutPlacement::LayoutPlacement()
+    : screenPt(0,0), screenRot(0.0), inside(false), valid(false), moved(true), active(false), offset(0,0)
 {
 }
 
-ClusterHelper::ClusterObject::ClusterObject()
+void LayoutPlacement::update(const Point2d &newScreenPt,float newScreenRot,bool newInside,bool startOver)
 {
-    
-}
-
-ClusterHelper::ClusterHelper(const Mbr &mbr,int sizeX,int sizeY,float resScale,const Point2d &clusterMarkerSize)
-: mbr(mbr), sizeX(sizeX), sizeY(sizeY), resScale(resScale), clusterMarkerSize(clusterMarkerSize)
-{
-    grid.resize(sizeX*sizeY);
-    cellSize = Point2d((mbr.ur().x()-mbr.ll().x())/sizeX,(mbr.ur().y()-mbr.ll().y())/sizeY);
-}
-    
-void ClusterHelper::calcCells(const Mbr &checkMbr,int &sx,int &sy,int &ex,int &ey)
-{
-    sx = floorf((checkMbr.ll().x()-mbr.ll().x())/cellSize.x());
-    if (sx < 0) sx = 0;
-    sy = floorf((checkMbr.ll().y()-mbr.ll().y())/cellSize.y());
-    if (sy < 0) sy = 0;
-    ex = ceilf((checkMbr.ur().x()-mbr.ll().x())/cellSize.x());
-    if (ex >= sizeX)  ex = sizeX-1;
-    ey = ceilf((checkMbr.ur().y()-mbr.ll().y())/cellSize.y());
-    if (ey >= sizeY)  ey = sizeY-1;
+    moved = startOver || !valid || newInside != inside ||
+            (newInside && ((newScreenPt - screenPt).norm() > LayoutMoveThreshold ||
+                           fabs(newScreenRot - screenRot) > LayoutRotThreshold));
+    if (moved)
+    {
+        screenPt = newScreenPt;
+        screenRot = newScreenRot;
+        inside = newInside;
+        valid = true;
+    }
 }
-    
-void ClusterHelper::addToCells(const Mbr &mbr,int index)
-{
-    int sx,sy,ex,ey;
-    calcCells(mbr,sx,sy,ex,ey);
 
-    // Add the new object to the grid
-    for (int ix=sx;ix<=ex;ix++)
-        for (int iy=sy;iy<=ey;iy++)
-        {
-            std::set<int> &objSet = grid[iy*sizeX + ix];
-            objSet.insert(index);
-        }
-}
-    
-void ClusterHelper::removeFromCells(const Mbr &mbr,int index)
-{
-    int sx,sy,ex,ey;
-    calcCells(mbr,sx,sy,ex,ey);
-    
-    // Add the new object to the grid
-    for (int ix=sx;ix<=ex;ix++)
-        for (int iy=sy;iy<=ey;iy++)
-        {
-            std::set<int> &objSet = grid[iy*sizeX + ix];
-            objSet.erase(index);
-        }
-}
-    
-void ClusterHelper::findObjectsWithin(const Mbr &mbr,std::set<int> &objSet)
+void LayoutPlacement::invalidate()
 {
-    int sx,sy,ex,ey;
-    calcCells(mbr,sx,sy,ex,ey);
-
-    for (int ix=sx;ix<=ex;ix++)
-    {
-        for (int iy=sy;iy<=ey;iy++)
-        {
-            std::set<int> &thisGridSet = grid[iy*sizeX + ix];
-            objSet.insert(thisGridSet.begin(),thisGridSet.end());
-        }
-    }
+    valid = false;
+    moved = true;
 }
 
-// Try to add an object.  Might fail (kind of the whole point).
-void ClusterHelper::addObject(LayoutObjectEntry *objEntry,const std::vector<Point2d> &pts)
+void LayoutOverlapPass(const std::vector<LayoutOverlapObject> &order,std::vector<LayoutPlacement *> &lastOrder,bool reuse,
+                       int maxDisplayObjects,float resScale,const Mbr &screenMbr,int sampleX,int sampleY)
 {
-    // We'll add this one way or another
-    simpleObjects.resize(simpleObjects.size()+1);
-    int newID = (int)(simpleObjects.size()-1);
-    SimpleObject &newObj = simpleObjects[newID];
-    newObj.objEntry = objEntry;
-    newObj.center = CalcCenterOfMass(pts);
-    newObj.pts = pts;
-    Mbr mbr;  mbr.addPoints(pts);
-    
-    // All the things we might overlap
-    std::set<int> objSet;
-    findObjectsWithin(mbr,objSet);
+    OverlapHelper overlapMan(screenMbr,sampleX,sampleY);
     
-    // Look for overlaps
-    bool found = false;
-    for (auto which : objSet)
+    bool reuseLast = reuse;
+    int numSoFar = 0;
+    std::vector<Point2d> objPts(4);
+    for (unsigned int whichObj=0;whichObj<order.size();whichObj++)
     {
-        ObjectWithBounds *testObj = NULL;
-        SimpleObject *simpleObj = NULL;
-        ClusterObject *clusterObj = NULL;
-        if (which >= 0)
-        {
-            simpleObj = &simpleObjects[which];
-            testObj = simpleObj;
-        } else {
-            clusterObj = &clusterObjects[-(which+1)];
-            testObj = clusterObj;
-        }
+        const LayoutOverlapObject &layoutObj = order[whichObj];
+        LayoutPlacement *placement = layoutObj.placement;
         
-        if (ConvexPolyIntersect(testObj->pts,newObj.pts))
+        if (reuseLast && (whichObj >= lastOrder.size() || lastOrder[whichObj] != placement || placement->moved))
+            reuseLast = false;
+        
+        if (reuseLast)
         {
-            int clusterID;
+            if (placement->active && !placement->footprint.empty())
+                overlapMan.placeObject(placement->footprint);
+        } else {
+            // Start with a max objects check
+            bool isActive = true;
+            Point2d objOffset(0.0,0.0);
+            if (maxDisplayObjects != 0 && (numSoFar >= maxDisplayObjects))
+                isActive = false;
             
-            if (clusterObj)
+            // Figure out the rotation situation
+            float screenRot = 0.0;
+            Matrix2d screenRotMat;
+            bool placed = false;
+            if (isActive)
             {
-                Mbr clusterOldMbr;  clusterOldMbr.addPoints(clusterObj->pts);
-                removeFromCells(clusterOldMbr, which);
-
-                // Hit a cluster, so merge this new object in
-                clusterObj->children.push_back(newID);
-                clusterObj->center = (clusterObj->center * (clusterObj->children.size() - 1) + newObj.center)/clusterObj->children.size();
-                clusterObj->pts.clear();
-                clusterID = -(which+1);
-            } else {
-                // Hit another test object.  Remove it from the grid
-                Mbr testMbr;  testMbr.addPoints(testObj->pts);
-                removeFromCells(testMbr, which);
+                Point2d objPt = placement->screenPt;
+                isActive &= placement->inside;
                 
-                // Make up a cluster for the two of them.
-                clusterID = clusterObjects.size();
-                clusterObjects.resize(clusterObjects.size()+1);
-                clusterObj = &clusterObjects[clusterID];
-                clusterObj->children.push_back(which);
-                clusterObj->children.push_back(newID);
-                clusterObj->center = (newObj.center + testObj->center)/2.0;
-
-                simpleObj->parentObject = clusterID;
-            }
-
-            newObj.parentObject = clusterID;
-            clusterObj->pts.reserve(4);
-            clusterObj->pts.push_back(clusterObj->center + Point2d(-clusterMarkerSize.x()*resScale/2.0,-clusterMarkerSize.y()*resScale/2.0));
-            clusterObj->pts.push_back(clusterObj->center + Point2d(clusterMarkerSize.x()*resScale/2.0,-clusterMarkerSize.y()*resScale/2.0));
-            clusterObj->pts.push_back(clusterObj->center + Point2d(clusterMarkerSize.x()*resScale/2.0,clusterMarkerSize.y()*resScale/2.0));
-            clusterObj->pts.push_back(clusterObj->center + Point2d(-clusterMarkerSize.x()*resScale/2.0,clusterMarkerSize.y()*resScale/2.0));
-            Mbr clusterMbr;  clusterMbr.addPoints(clusterObj->pts);
-            addToCells(clusterMbr,-(clusterID+1));
-            
-            found = true;
-            break;
-        }
-    }
-    
-    // This object stands alone, so add it to the grid
-    if (!found)
-        addToCells(mbr, newID);
-}
-
-void ClusterHelper::resolveClusters()
-{
-    // Find single objects that overlap existing clusters.
-    // We won't move the clusters here to keep it simpler
-    for (int so=0;so<simpleObjects.size();so++)
-    {
-        SimpleObject *simpleObj = &simpleObjects[so];
-        if (simpleObj->parentObject < 0)
-        {
-            Mbr simpleMbr;  simpleMbr.addPoints(simpleObj->pts);
-            std::set<int> testObjs;
-            findObjectsWithin(simpleMbr, testObjs);
-            for (auto which : testObjs)
-            {
-                // Only care about the clusters
-                if (which < 0)
-                {
-                    ClusterObject *clusterObj = &clusterObjects[-(which+1)];
-
-                    if (ConvexPolyIntersect(simpleObj->pts,clusterObj->pts))
-                    {
-                        simpleObj->parentObject = -(which + 1);
-                        clusterObj->children.push_back(so);
-                        break;
-                    }
-                }
-            }
-        }
-    }
-    
-    // Look for clusters that overlap one another
-    for (int ci=0;ci<clusterObjects.size();ci++)
-    {
-        ClusterObject *clusterObj = &clusterObjects[ci];
-        if (!clusterObj->children.empty())
-        {
-            Mbr thisMbr;  thisMbr.addPoints(clusterObj->pts);
-            std::set<int> testObjs;
-            findObjectsWithin(thisMbr, testObjs);
-            for (auto which : testObjs)
-            {
-                if (which < 0 && ci != -(which + 1))
+                // Deal with the rotation
+                screenRot = placement->screenRot;
+                if (screenRot != 0.0)
+                    screenRotMat = Eigen::Rotation2Dd(screenRot);
+                
+                // Now for the overlap checks
+                if (isActive)
                 {
-                    ClusterObject *otherClusterObj = &clusterObjects[-(which+1)];
-                    
-                    if (!otherClusterObj->children.empty() && ConvexPolyIntersect(clusterObj->pts,otherClusterObj->pts))
+                    // Try the four different orientations
+                    if (!layoutObj.layoutPts->empty())
                     {
-                        clusterObj->children.insert(clusterObj->children.begin(),otherClusterObj->children.begin(), otherClusterObj->children.end());
-                        otherClusterObj->children.clear();
+                        bool validOrient = false;
+                        for (unsigned int orient=0;orient<6;orient++)
+                        {
+                            // May only want to be placed certain ways.  Fair enough.
+                            if (!(layoutObj.acceptablePlacement & (1<<orient)))
+                                continue;
+                            const std::vector<Point2d> &layoutPts = *layoutObj.layoutPts;
+                            Mbr layoutMbr;
+                            for (unsigned int li=0;li<layoutPts.size();li++)
+                                layoutMbr.addPoint(layoutPts[li]);
+                            Point2f layoutSpan(layoutMbr.ur().x()-layoutMbr.ll().x(),layoutMbr.ur().y()-layoutMbr.ll().y());
+                            Point2d layoutOrg(layoutMbr.ll().x(),layoutMbr.ll().y());
+                            
+                            // Set up the offset for this orientation
+                            switch (orient)
+                            {
+                                // Don't move at all
+                                case 0:
+                                    objOffset = Point2d(0,0);
+                                    break;
+                                // Center
+                                case 1:
+                                    objOffset = Point2d(-layoutSpan.x()/2.0,layoutSpan.y()/2.0);
+                                    break;
+                                // Right
+                                case 2:
+                                    objOffset = Point2d(0.0,layoutSpan.y()/2.0);
+                                    break;
+                                // Left
+                                case 3:
+                                    objOffset = Point2d(-(layoutSpan.x()),layoutSpan.y()/2.0);
+                                    break;
+                                // Above
+                                case 4:
+                                    objOffset = Point2d(-layoutSpan.x()/2.0,0);
+                                    break;
+                                // Below
+                                case 5:
+                                    objOffset = Point2d(-layoutSpan.x()/2.0,layoutSpan.y());
+                                    break;
+                            }
+                            
+                            // Rotate the rectangle
+                            if (screenRot == 0.0)
+                            {
+                                objPts[0] = objPt + (objOffset + layoutOrg)*resScale;
+                                objPts[1] = objPts[0] + Point2d(layoutSpan.x()*resScale,0.0);
+                                objPts[2] = objPts[0] + Point2d(layoutSpan.x()*resScale,layoutSpan.y()*resScale);
+                                objPts[3] = objPts[0] + Point2d(0.0,layoutSpan.y()*resScale);
+                            } else {
+                                Point2d center = objPt;
+                                objPts[0] = Point2d(objOffset.x(),-objOffset.y()) + layoutOrg;
+                                objPts[1] = Point2d(objOffset.x(),-objOffset.y()) + layoutOrg + Point2d(layoutSpan.x(),0.0);
+                                objPts[2] = Point2d(objOffset.x(),-objOffset.y()) + layoutOrg + Point2d(layoutSpan.x(),layoutSpan.y());
+                                objPts[3] = Point2d(objOffset.x(),-objOffset.y()) + layoutOrg + Point2d(0.0,layoutSpan.y());
+                                for (unsigned int oi=0;oi<4;oi++)
+                                {
+                                    Point2d &thisObjPt = objPts[oi];
+                                    Point2d offPt = screenRotMat * Point2d(thisObjPt.x()*resScale,thisObjPt.y()*resScale);
+                                    thisObjPt = Point2d(offPt.x(),-offPt.y()) + center;
+                                }
+                            }
+                            
+                            // Now try it
+                            if (overlapMan.addObject(objPts))
+                            {
+                                validOrient = true;
+                                break;
+                            }
+                        }
+                        
+                        isActive = validOrient;
+                        placed = validOrient;
                     }
                 }
             }
+            
+            // Remember what we decided in case it comes out the same next time
+            placement->active = isActive;
+            placement->offset = objOffset;
+            if (placed)
+                placement->footprint = objPts;
+            else
+                placement->footprint.clear();
         }
+        
+        if (placement->active)
+            numSoFar++;
     }
-}
     
-void ClusterHelper::objectsForCluster(ClusterObject &cluster,std::vector<LayoutObjectEntry *> &layoutObjs)
-{
-    for (int child : cluster.children)
-        layoutObjs.push_back(simpleObjects[child].objEntry);
+    lastOrder.resize(order.size());
+    for (unsigned int ii=0;ii<order.size();ii++)
+        lastOrder[ii] = order[ii].placement;
 }
     
 }
@@ -0,0 +1,739 @@
+/*
+ *  PackedTileCache.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <stdio.h>
+#import <string.h>
+#import <errno.h>
+#import <fcntl.h>
+#import <unistd.h>
+#import <dirent.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <sys/time.h>
+#import "PackedTileCache.h"
+
+namespace WhirlyKit
+{
+
+static const uint32_t IndexMagic = 0x57474958;    // WGIX
+static const uint32_t IndexVersion = 1;
+static const uint32_t RecordMagic = 0x57475452;   // WGTR
+// Record size we use to say a tile was removed
+static const uint32_t RemovedSize = 0xffffffff;
+// Index slots that were never used or were used and emptied
+static const uint64_t EmptyKey = 0;
+static const uint64_t RemovedKey = ~(uint64_t)0;
+// Set when a tile is read, cleared when its segment comes up for eviction
+static const uint32_t ReferencedFlag = 1<<0;
+// Size of a new index, in slots
+static const uint32_t InitialCapacity = 4096;
+// Sync the index to disk after this many writes
+static const int FlushWrites = 256;
+// Segments smaller than this aren't worth the files
+static const size_t MinSegmentSize = 64*1024;
+
+// Make the directory and anything above it
+static bool MakeDirs(const std::string &dir)
+{
+    for (size_t pos = 1;pos <= dir.size();pos++)
+    {
+        if (pos < dir.size() && dir[pos] != '/')
+            continue;
+        std::string subDir = dir.substr(0,pos);
+        if (mkdir(subDir.c_str(),0755) != 0 && errno != EEXIST)
+            return false;
+    }
+    return true;
+}
+
+// Spread the key bits around the table
+static uint64_t HashKey(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+// Spread the low 29 bits of val out to every other bit
+static uint64_t SpreadBits(uint64_t val)
+{
+    val &= 0x1fffffff;
+    val = (val | (val << 16)) & 0x0000ffff0000ffffULL;
+    val = (val | (val << 8)) & 0x00ff00ff00ff00ffULL;
+    val = (val | (val << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    val = (val | (val << 2)) & 0x3333333333333333ULL;
+    val = (val | (val << 1)) & 0x5555555555555555ULL;
+    return val;
+}
+
+PackedTileCache::SegmentFile::~SegmentFile()
+{
+    ::close(fd);
+}
+
+PackedTileCache::PackedTileCache()
+    : maxBytes(0), segmentSize(DefaultSegmentSize), numBytes(0), writesSinceFlush(0),
+      indexFD(-1), indexMap(NULL), indexMapSize(0), header(NULL), entries(NULL)
+{
+}
+
+PackedTileCache::~PackedTileCache()
+{
+    close();
+}
+
+uint64_t PackedTileCache::tileKey(int level,int x,int y)
+{
+    if (level < 0 || level > 29 || x < 0 || y < 0)
+        return EmptyKey;
+    return ((uint64_t)(level+1) << 58) | SpreadBits(x) | (SpreadBits(y) << 1);
+}
+
+double PackedTileCache::currentTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+bool PackedTileCache::open(const std::string &inDir,size_t inMaxBytes,size_t inSegmentSize)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (indexMap)
+    {
+        fprintf(stderr,"PackedTileCache: Already open on %s\n",dir.c_str());
+        return false;
+    }
+    dir = inDir;
+    maxBytes = inMaxBytes;
+    // Evicting a whole segment shouldn't throw out too much of the cache
+    segmentSize = std::max(std::min(inSegmentSize,maxBytes/4),MinSegmentSize);
+    segmentSize = std::min(segmentSize,(size_t)0x7fffffff);
+
+    if (!MakeDirs(dir))
+    {
+        fprintf(stderr,"PackedTileCache: Couldn't make directory %s\n",dir.c_str());
+        return false;
+    }
+    if (!openSegments())
+    {
+        segments.clear();
+        return false;
+    }
+
+    // Use the index if it was closed properly, otherwise work it out again
+    if (!mapIndex(dir + "/index",0,false) || !header->clean)
+    {
+        unmapIndex();
+        if (!rebuildIndex())
+        {
+            unmapIndex();
+            segments.clear();
+            return false;
+        }
+    }
+    if (segments.empty() && !addSegment())
+    {
+        unmapIndex();
+        return false;
+    }
+    evict();
+
+    return true;
+}
+
+void PackedTileCache::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!indexMap)
+        return;
+    flushLocked();
+    unmapIndex();
+    segments.clear();
+    numBytes = 0;
+}
+
+bool PackedTileCache::isOpen()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return indexMap != NULL;
+}
+
+// Only one of these per directory
+static std::mutex cacheRegistryLock;
+static std::map<std::string,std::weak_ptr<PackedTileCache> > cacheRegistry;
+
+std::shared_ptr<PackedTileCache> PackedTileCache::cacheForDir(const std::string &dir,size_t maxBytes)
+{
+    std::lock_guard<std::mutex> lock(cacheRegistryLock);
+
+    auto it = cacheRegistry.find(dir);
+    if (it != cacheRegistry.end())
+    {
+        std::shared_ptr<PackedTileCache> cache = it->second.lock();
+        if (cache)
+            return cache;
+    }
+
+    std::shared_ptr<PackedTileCache> cache = std::make_shared<PackedTileCache>();
+    if (!cache->open(dir,maxBytes))
+        return std::shared_ptr<PackedTileCache>();
+    cacheRegistry[dir] = cache;
+
+    return cache;
+}
+
+bool PackedTileCache::contains(int level,int x,int y,double maxAge)
+{
+    uint64_t key = tileKey(level,x,y);
+    if (key == EmptyKey)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!entries)
+        return false;
+    IndexEntry *entry = findEntry(key);
+    if (!entry)
+        return false;
+
+    return maxAge <= 0.0 || currentTime() - entry->timeStamp <= maxAge;
+}
+
+bool PackedTileCache::read(int level,int x,int y,std::vector<unsigned char> &data,double maxAge)
+{
+    data.clear();
+    uint64_t key = tileKey(level,x,y);
+    if (key == EmptyKey)
+        return false;
+
+    // Find it with the lock, but do the read without
+    SegmentFileRef file;
+    uint32_t offset,size;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!entries)
+            return false;
+        IndexEntry *entry = findEntry(key);
+        if (!entry)
+            return false;
+        if (maxAge > 0.0 && currentTime() - entry->timeStamp > maxAge)
+            return false;
+        auto it = segments.find(entry->segment);
+        if (it == segments.end())
+        {
+            markDirty();
+            removeEntry(entry);
+            return false;
+        }
+        entry->flags |= ReferencedFlag;
+        file = it->second.file;
+        offset = entry->offset;
+        size = entry->size;
+    }
+
+    data.resize(sizeof(RecordHeader)+size);
+    if (pread(file->fd,&data[0],data.size(),offset) != (ssize_t)data.size())
+    {
+        fprintf(stderr,"PackedTileCache: Failed to read tile %d: (%d,%d)\n",level,x,y);
+        data.clear();
+        return false;
+    }
+    RecordHeader rec;
+    memcpy(&rec,&data[0],sizeof(rec));
+    if (rec.magic != RecordMagic || rec.key != key || rec.size != size)
+    {
+        fprintf(stderr,"PackedTileCache: Bad record for tile %d: (%d,%d)\n",level,x,y);
+        data.clear();
+        return false;
+    }
+    data.erase(data.begin(),data.begin()+sizeof(rec));
+
+    return true;
+}
+
+bool PackedTileCache::write(int level,int x,int y,const void *data,size_t size)
+{
+    uint64_t key = tileKey(level,x,y);
+    if (key == EmptyKey || size >= segmentSize)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!entries)
+        return false;
+    markDirty();
+    if (!addRecord(key,currentTime(),data,(uint32_t)size))
+        return false;
+    evict();
+
+    if (++writesSinceFlush >= FlushWrites)
+        flushLocked();
+
+    return true;
+}
+
+bool PackedTileCache::remove(int level,int x,int y)
+{
+    uint64_t key = tileKey(level,x,y);
+    if (key == EmptyKey)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!entries)
+        return false;
+    IndexEntry *entry = findEntry(key);
+    if (!entry)
+        return false;
+
+    // Leave a note in the segments so a rebuild doesn't bring it back
+    markDirty();
+    uint32_t segment,offset;
+    appendRecord(key,currentTime(),NULL,RemovedSize,segment,offset);
+    removeEntry(entry);
+
+    return true;
+}
+
+void PackedTileCache::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (indexMap)
+        flushLocked();
+}
+
+size_t PackedTileCache::getNumTiles()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return header ? header->count : 0;
+}
+
+size_t PackedTileCache::getNumBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return numBytes;
+}
+
+std::string PackedTileCache::segmentName(uint32_t which)
+{
+    char name[32];
+    snprintf(name,sizeof(name),"/%08x.tiles",which);
+    return dir + name;
+}
+
+bool PackedTileCache::openSegments()
+{
+    DIR *dirP = opendir(dir.c_str());
+    if (!dirP)
+    {
+        fprintf(stderr,"PackedTileCache: Couldn't read directory %s\n",dir.c_str());
+        return false;
+    }
+
+    numBytes = 0;
+    struct dirent *dirEnt;
+    while ((dirEnt = readdir(dirP)))
+    {
+        unsigned int which;
+        char ext[8];
+        if (strlen(dirEnt->d_name) != 14 || sscanf(dirEnt->d_name,"%8x.%5s",&which,ext) != 2 || strcmp(ext,"tiles"))
+            continue;
+        std::string fileName = segmentName(which);
+        int fd = ::open(fileName.c_str(),O_RDWR);
+        struct stat statBuf;
+        if (fd < 0 || fstat(fd,&statBuf) != 0)
+        {
+            fprintf(stderr,"PackedTileCache: Couldn't open segment %s\n",fileName.c_str());
+            if (fd >= 0)
+                ::close(fd);
+            continue;
+        }
+        Segment &segment = segments[which];
+        segment.file = SegmentFileRef(new SegmentFile(fd));
+        segment.size = statBuf.st_size;
+        numBytes += segment.size;
+    }
+    closedir(dirP);
+
+    return true;
+}
+
+bool PackedTileCache::addSegment()
+{
+    uint32_t which = segments.empty() ? 1 : segments.rbegin()->first+1;
+    std::string fileName = segmentName(which);
+    int fd = ::open(fileName.c_str(),O_RDWR | O_CREAT | O_TRUNC,0644);
+    if (fd < 0)
+    {
+        fprintf(stderr,"PackedTileCache: Couldn't create segment %s\n",fileName.c_str());
+        return false;
+    }
+    segments[which].file = SegmentFileRef(new SegmentFile(fd));
+
+    return true;
+}
+
+bool PackedTileCache::mapIndex(const std::string &fileName,uint32_t capacity,bool create)
+{
+    int fd = ::open(fileName.c_str(),create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR,0644);
+    if (fd < 0)
+    {
+        if (create)
+            fprintf(stderr,"PackedTileCache: Couldn't create index %s\n",fileName.c_str());
+        return false;
+    }
+
+    size_t mapSize = 0;
+    if (create)
+    {
+        mapSize = sizeof(IndexHeader) + (size_t)capacity * sizeof(IndexEntry);
+        if (ftruncate(fd,mapSize) != 0)
+        {
+            fprintf(stderr,"PackedTileCache: Couldn't size index %s\n",fileName.c_str());
+            ::close(fd);
+            return false;
+        }
+    } else {
+        struct stat statBuf;
+        if (fstat(fd,&statBuf) != 0 || statBuf.st_size < (off_t)sizeof(IndexHeader))
+        {
+            ::close(fd);
+            return false;
+        }
+        mapSize = statBuf.st_size;
+    }
+
+    void *map = mmap(NULL,mapSize,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr,"PackedTileCache: Couldn't map index %s\n",fileName.c_str());
+        ::close(fd);
+        return false;
+    }
+    IndexHeader *newHeader = (IndexHeader *)map;
+    if (create)
+    {
+        newHeader->magic = IndexMagic;
+        newHeader->version = IndexVersion;
+        newHeader->capacity = capacity;
+    } else if (newHeader->magic != IndexMagic || newHeader->version != IndexVersion ||
+               newHeader->capacity == 0 || (newHeader->capacity & (newHeader->capacity-1)) ||
+               mapSize != sizeof(IndexHeader) + (size_t)newHeader->capacity * sizeof(IndexEntry))
+    {
+        fprintf(stderr,"PackedTileCache: Index %s doesn't look right.  Rebuilding.\n",fileName.c_str());
+        munmap(map,mapSize);
+        ::close(fd);
+        return false;
+    }
+
+    indexFD = fd;
+    indexMap = map;
+    indexMapSize = mapSize;
+    header = newHeader;
+    entries = (IndexEntry *)((char *)map + sizeof(IndexHeader));
+
+    return true;
+}
+
+void PackedTileCache::unmapIndex()
+{
+    if (indexMap)
+        munmap(indexMap,indexMapSize);
+    if (indexFD >= 0)
+        ::close(indexFD);
+    indexFD = -1;
+    indexMap = NULL;
+    indexMapSize = 0;
+    header = NULL;
+    entries = NULL;
+}
+
+bool PackedTileCache::rebuildIndex()
+{
+    if (!mapIndex(dir + "/index",InitialCapacity,true))
+        return false;
+
+    // Go through the segments in order.  Later records replace earlier ones.
+    numBytes = 0;
+    for (auto &it : segments)
+    {
+        Segment &segment = it.second;
+        size_t pos = 0;
+        while (pos + sizeof(RecordHeader) <= segment.size)
+        {
+            RecordHeader rec;
+            if (pread(segment.file->fd,&rec,sizeof(rec),pos) != sizeof(rec) || rec.magic != RecordMagic)
+                break;
+            size_t dataSize = (rec.size == RemovedSize) ? 0 : rec.size;
+            if (pos + sizeof(rec) + dataSize > segment.size)
+                break;
+
+            IndexEntry *entry = findEntry(rec.key);
+            if (rec.size == RemovedSize)
+            {
+                if (entry)
+                    removeEntry(entry);
+            } else {
+                if (!entry)
+                {
+                    if (!reserveEntry())
+                        return false;
+                    entry = addEntry(rec.key);
+                }
+                entry->timeStamp = rec.timeStamp;
+                entry->segment = it.first;
+                entry->offset = (uint32_t)pos;
+                entry->size = rec.size;
+                entry->flags = 0;
+            }
+            pos += sizeof(rec) + dataSize;
+        }
+
+        // Whatever was being written when we went down is no good
+        if (pos < segment.size)
+        {
+            fprintf(stderr,"PackedTileCache: Dropping %d bytes from the end of %s\n",(int)(segment.size-pos),segmentName(it.first).c_str());
+            if (ftruncate(segment.file->fd,pos) == 0)
+                segment.size = pos;
+        }
+        numBytes += segment.size;
+    }
+    header->clean = 0;
+
+    return true;
+}
+
+bool PackedTileCache::reserveEntry()
+{
+    // Keep the table under three quarters full, counting removed slots
+    if ((header->count + header->removed + 1) * 4 <= header->capacity * 3)
+        return true;
+
+    uint32_t capacity = header->capacity;
+    while ((header->count + 1) * 2 > capacity)
+        capacity *= 2;
+    return resizeIndex(capacity);
+}
+
+bool PackedTileCache::resizeIndex(uint32_t capacity)
+{
+    int oldFD = indexFD;
+    void *oldMap = indexMap;
+    size_t oldMapSize = indexMapSize;
+    IndexHeader *oldHeader = header;
+    IndexEntry *oldEntries = entries;
+
+    // Build the new one off to the side, then swap it in
+    std::string tmpName = dir + "/index.tmp";
+    if (!mapIndex(tmpName,capacity,true))
+        return false;
+    for (uint32_t ii=0;ii<oldHeader->capacity;ii++)
+    {
+        const IndexEntry &oldEntry = oldEntries[ii];
+        if (oldEntry.key == EmptyKey || oldEntry.key == RemovedKey)
+            continue;
+        *addEntry(oldEntry.key) = oldEntry;
+    }
+    munmap(oldMap,oldMapSize);
+    ::close(oldFD);
+
+    if (rename(tmpName.c_str(),(dir + "/index").c_str()) != 0)
+    {
+        fprintf(stderr,"PackedTileCache: Couldn't replace index in %s\n",dir.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+PackedTileCache::IndexEntry *PackedTileCache::findEntry(uint64_t key)
+{
+    uint32_t mask = header->capacity-1;
+    uint32_t slot = (uint32_t)HashKey(key) & mask;
+    for (uint32_t ii=0;ii<header->capacity;ii++)
+    {
+        IndexEntry *entry = &entries[slot];
+        if (entry->key == key)
+            return entry;
+        if (entry->key == EmptyKey)
+            return NULL;
+        slot = (slot+1) & mask;
+    }
+
+    return NULL;
+}
+
+PackedTileCache::IndexEntry *PackedTileCache::addEntry(uint64_t key)
+{
+    uint32_t mask = header->capacity-1;
+    uint32_t slot = (uint32_t)HashKey(key) & mask;
+    IndexEntry *reuse = NULL;
+    for (uint32_t ii=0;ii<header->capacity;ii++)
+    {
+        IndexEntry *entry = &entries[slot];
+        if (entry->key == EmptyKey)
+        {
+            if (!reuse)
+                reuse = entry;
+            break;
+        }
+        if (entry->key == RemovedKey && !reuse)
+            reuse = entry;
+        slot = (slot+1) & mask;
+    }
+
+    if (reuse->key == RemovedKey)
+        header->removed--;
+    header->count++;
+    memset(reuse,0,sizeof(IndexEntry));
+    reuse->key = key;
+
+    return reuse;
+}
+
+void PackedTileCache::removeEntry(IndexEntry *entry)
+{
+    entry->key = RemovedKey;
+    header->count--;
+    header->removed++;
+}
+
+bool PackedTileCache::appendRecord(uint64_t key,double timeStamp,const void *data,uint32_t size,uint32_t &segmentID,uint32_t &offset)
+{
+    size_t dataSize = (size == RemovedSize) ? 0 : size;
+    size_t recSize = sizeof(RecordHeader) + dataSize;
+    if (segments.rbegin()->second.size > 0 && segments.rbegin()->second.size + recSize > segmentSize)
+    {
+        fsync(segments.rbegin()->second.file->fd);
+        if (!addSegment())
+            return false;
+    }
+
+    segmentID = segments.rbegin()->first;
+    Segment &segment = segments.rbegin()->second;
+    offset = (uint32_t)segment.size;
+
+    RecordHeader rec;
+    rec.magic = RecordMagic;
+    rec.size = size;
+    rec.key = key;
+    rec.timeStamp = timeStamp;
+    if (pwrite(segment.file->fd,&rec,sizeof(rec),offset) != sizeof(rec) ||
+        (dataSize > 0 && pwrite(segment.file->fd,data,dataSize,offset+sizeof(rec)) != (ssize_t)dataSize))
+    {
+        fprintf(stderr,"PackedTileCache: Failed to write to %s\n",segmentName(segmentID).c_str());
+        if (ftruncate(segment.file->fd,segment.size) != 0)
+            fprintf(stderr,"PackedTileCache: Couldn't fix up %s\n",segmentName(segmentID).c_str());
+        return false;
+    }
+    segment.size += recSize;
+    numBytes += recSize;
+
+    return true;
+}
+
+bool PackedTileCache::addRecord(uint64_t key,double timeStamp,const void *data,uint32_t size)
+{
+    if (!reserveEntry())
+        return false;
+
+    uint32_t segmentID,offset;
+    if (!appendRecord(key,timeStamp,data,size,segmentID,offset))
+        return false;
+    IndexEntry *entry = findEntry(key);
+    if (!entry)
+        entry = addEntry(key);
+    entry->timeStamp = timeStamp;
+    entry->segment = segmentID;
+    entry->offset = offset;
+    entry->size = size;
+    entry->flags = 0;
+
+    return true;
+}
+
+void PackedTileCache::evict()
+{
+    std::vector<uint32_t> keep;
+    std::vector<unsigned char> data;
+    while (numBytes > maxBytes && segments.size() > 1)
+    {
+        markDirty();
+        uint32_t which = segments.begin()->first;
+        Segment oldest = segments.begin()->second;
+        segments.erase(segments.begin());
+        numBytes -= oldest.size;
+
+        // Anything read since we last came around gets another chance
+        keep.clear();
+        for (uint32_t ii=0;ii<header->capacity;ii++)
+        {
+            IndexEntry &entry = entries[ii];
+            if (entry.key == EmptyKey || entry.key == RemovedKey || entry.segment != which)
+                continue;
+            if (entry.flags & ReferencedFlag)
+                keep.push_back(ii);
+            else
+                removeEntry(&entry);
+        }
+
+        for (uint32_t slot : keep)
+        {
+            IndexEntry &entry = entries[slot];
+            data.resize(entry.size);
+            uint32_t segmentID,offset;
+            if (pread(oldest.file->fd,data.data(),entry.size,entry.offset+sizeof(RecordHeader)) != (ssize_t)entry.size ||
+                !appendRecord(entry.key,entry.timeStamp,data.data(),entry.size,segmentID,offset))
+            {
+                removeEntry(&entry);
+                continue;
+            }
+            entry.segment = segmentID;
+            entry.offset = offset;
+            entry.flags = 0;
+        }
+
+        unlink(segmentName(which).c_str());
+    }
+}
+
+void PackedTileCache::markDirty()
+{
+    if (!header->clean)
+        return;
+    header->clean = 0;
+    msync(indexMap,sizeof(IndexHeader),MS_SYNC);
+}
+
+void PackedTileCache::flushLocked()
+{
+    // Tiles go out first, then the index that points to them
+    if (!segments.empty())
+        fsync(segments.rbegin()->second.file->fd);
+    msync(indexMap,indexMapSize,MS_SYNC);
+    header->clean = 1;
+    msync(indexMap,sizeof(IndexHeader),MS_SYNC);
+    writesSinceFlush = 0;
+}
+
+}
@@ -20,6 +20,13 @@
 
 #import "PerformanceTimer.h"
 #import <vector>
+#import <algorithm>
+#import <float.h>
+#ifdef __OBJC__
+#import <Foundation/Foundation.h>
+#else
+#import <stdio.h>
+#endif
 
 namespace WhirlyKit
 {
@@ -27,7 +34,7 @@ namespace WhirlyKit
 PerformanceTimer::TimeEntry::TimeEntry()
 {
     name = "";
-    minDur = MAXFLOAT;
+    minDur = DBL_MAX;
     maxDur = 0.0;
     avgDur = 0.0;
     numRuns = 0;
@@ -50,7 +57,7 @@ bool PerformanceTimer::TimeEntry::operator<(const WhirlyKit::PerformanceTimer::T
     return name < that.name;
 }
 
-void PerformanceTimer::TimeEntry::addTime(NSTimeInterval dur)
+void PerformanceTimer::TimeEntry::addTime(TimeInterval dur)
 {
     minDur = std::min(minDur,dur);
     maxDur = std::max(maxDur,dur);
@@ -80,25 +87,30 @@ void PerformanceTimer::CountEntry::addCount(int count)
     numRuns++;
 }
 
+PerformanceTimer::TimeInterval PerformanceTimer::getTime()
+{
+    return std::chrono::duration<TimeInterval>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void PerformanceTimer::startTiming(const std::string &what)
 {
-    actives[what] = CFAbsoluteTimeGetCurrent();
+    actives[what] = getTime();
 }
 
 void PerformanceTimer::stopTiming(const std::string &what)
 {
-    std::map<std::string,NSTimeInterval>::iterator it = actives.find(what);
+    std::map<std::string,TimeInterval>::iterator it = actives.find(what);
     if (it == actives.end())
         return;
-    NSTimeInterval start = it->second;
+    TimeInterval start = it->second;
     actives.erase(it);
     
     std::map<std::string,TimeEntry>::iterator eit = timeEntries.find(what);
     if (eit != timeEntries.end())
-        eit->second.addTime(CFAbsoluteTimeGetCurrent()-start);
+        eit->second.addTime(getTime()-start);
     else {
         TimeEntry newEntry;
-        newEntry.addTime(CFAbsoluteTimeGetCurrent()-start);
+        newEntry.addTime(getTime()-start);
         newEntry.name = what;
         timeEntries[what] = newEntry;
     }
@@ -117,11 +129,54 @@ void PerformanceTimer::addCount(const std::string &what,int count)
     }
 }
 
+void PerformanceTimer::startTiming(TelemetryID spanID)
+{
+    if (spanID < 0)
+        return;
+    if ((size_t)spanID >= idStarts.size())
+        idStarts.resize(spanID+1,0);
+    idStarts[spanID] = Telemetry::now();
+}
+
+void PerformanceTimer::stopTiming(TelemetryID spanID)
+{
+    if (spanID < 0 || (size_t)spanID >= idStarts.size() || idStarts[spanID] == 0)
+        return;
+    uint64_t start = idStarts[spanID];
+    uint64_t end = Telemetry::now();
+    idStarts[spanID] = 0;
+    Telemetry::recordSpan(spanID,start,end);
+    
+    if ((size_t)spanID >= idTimeEntries.size())
+        idTimeEntries.resize(spanID+1);
+    TimeEntry &entry = idTimeEntries[spanID];
+    if (entry.numRuns == 0)
+        entry.name = Telemetry::getName(spanID);
+    entry.addTime((end-start) / 1e9);
+}
+
+void PerformanceTimer::addCount(TelemetryID counterID,int count)
+{
+    if (counterID < 0)
+        return;
+    Telemetry::recordValue(counterID,count);
+    
+    if ((size_t)counterID >= idCountEntries.size())
+        idCountEntries.resize(counterID+1);
+    CountEntry &entry = idCountEntries[counterID];
+    if (entry.numRuns == 0)
+        entry.name = Telemetry::getName(counterID);
+    entry.addCount(count);
+}
+
 void PerformanceTimer::clear()
 {
     actives.clear();
     timeEntries.clear();
     countEntries.clear();
+    idStarts.clear();
+    idTimeEntries.clear();
+    idCountEntries.clear();
 }
 
 static bool TimeEntryByMax (const PerformanceTimer::TimeEntry &a,const PerformanceTimer::TimeEntry &b)
@@ -129,27 +184,54 @@ static bool TimeEntryByMax (const PerformanceTimer::TimeEntry &a,const Performan
     return a.avgDur > b.avgDur;
 }
     
-void PerformanceTimer::log()
+void PerformanceTimer::getTimeEntries(std::vector<TimeEntry> &entries)
 {
-    std::vector<TimeEntry> sortedEntries;
-    sortedEntries.reserve(timeEntries.size());
+    entries.reserve(entries.size()+timeEntries.size());
     
     for (std::map<std::string,TimeEntry>::iterator it = timeEntries.begin();
          it != timeEntries.end(); ++it)
-        sortedEntries.push_back(it->second);
-    std::sort(sortedEntries.begin(),sortedEntries.end(),TimeEntryByMax);
+        entries.push_back(it->second);
+    for (const TimeEntry &entry : idTimeEntries)
+        if (entry.numRuns > 0)
+            entries.push_back(entry);
+    std::sort(entries.begin(),entries.end(),TimeEntryByMax);
+}
+
+void PerformanceTimer::getCountEntries(std::vector<CountEntry> &entries)
+{
+    for (std::map<std::string,CountEntry>::iterator it = countEntries.begin();
+         it != countEntries.end(); ++it)
+        entries.push_back(it->second);
+    for (const CountEntry &entry : idCountEntries)
+        if (entry.numRuns > 0)
+            entries.push_back(entry);
+    std::sort(entries.begin(),entries.end());
+}
+
+// NSLog on the device, stdout elsewhere
+#ifdef __OBJC__
+#define TimerLog(fmt,...) NSLog(@fmt,__VA_ARGS__)
+#else
+#define TimerLog(fmt,...) printf(fmt "\n",__VA_ARGS__)
+#endif
+    
+void PerformanceTimer::log()
+{
+    std::vector<TimeEntry> sortedEntries;
+    getTimeEntries(sortedEntries);
     for (unsigned int ii=0;ii<sortedEntries.size();ii++)
     {
         TimeEntry &entry = sortedEntries[ii];
         if (entry.numRuns > 0)
-            NSLog(@"  %s: min, max, avg = (%.2f,%.2f,%.2f) ms",entry.name.c_str(),1000*entry.minDur,1000*entry.maxDur,1000*entry.avgDur / entry.numRuns);
+            TimerLog("  %s: min, max, avg = (%.2f,%.2f,%.2f) ms",entry.name.c_str(),1000*entry.minDur,1000*entry.maxDur,1000*entry.avgDur / entry.numRuns);
     }
-    for (std::map<std::string,CountEntry>::iterator it = countEntries.begin();
-         it != countEntries.end(); ++it)
+    std::vector<CountEntry> counts;
+    getCountEntries(counts);
+    for (unsigned int ii=0;ii<counts.size();ii++)
     {
-        CountEntry &entry = it->second;
+        CountEntry &entry = counts[ii];
         if (entry.numRuns > 0)
-            NSLog(@"  %s: min, max, avg = (%d,%d,%2.f,  %d) count",entry.name.c_str(),entry.minCount,entry.maxCount,(float)entry.avgCount / (float)entry.numRuns,entry.avgCount);
+            TimerLog("  %s: min, max, avg = (%d,%d,%2.f,  %d) count",entry.name.c_str(),entry.minCount,entry.maxCount,(float)entry.avgCount / (float)entry.numRuns,entry.avgCount);
     }
 }
     
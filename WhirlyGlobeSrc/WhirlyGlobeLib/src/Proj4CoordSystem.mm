@@ -145,6 +145,44 @@ Point3d Proj4CoordSystem::geocentricToLocal(Point3d geocPt)
     return coord;
 }
 
+// proj.4 takes a stride, so the batch versions work directly on the points
+void Proj4CoordSystem::localToGeographic(const Point3d *inPts,Point2d *outPts,int count)
+{
+    if (count <= 0)
+        return;
+    std::vector<Point3d> pts(inPts,inPts+count);
+    pj_transform(pj, pj_latlon, count, 3, &pts[0].x(), &pts[0].y(), &pts[0].z());
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = Point2d(pts[ii].x(),pts[ii].y());
+}
+
+void Proj4CoordSystem::geographicToLocal(const Point2d *inPts,Point3d *outPts,int count)
+{
+    if (count <= 0)
+        return;
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = Point3d(inPts[ii].x(),inPts[ii].y(),0.0);
+    pj_transform(pj_latlon, pj, count, 3, &outPts[0].x(), &outPts[0].y(), &outPts[0].z());
+}
+
+void Proj4CoordSystem::localToGeocentric(const Point3d *inPts,Point3d *outPts,int count)
+{
+    if (count <= 0)
+        return;
+    if (inPts != outPts)
+        std::copy(inPts,inPts+count,outPts);
+    pj_transform(pj, pj_geocentric, count, 3, &outPts[0].x(), &outPts[0].y(), &outPts[0].z());
+}
+
+void Proj4CoordSystem::geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    if (count <= 0)
+        return;
+    if (inPts != outPts)
+        std::copy(inPts,inPts+count,outPts);
+    pj_transform(pj_geocentric, pj, count, 3, &outPts[0].x(), &outPts[0].y(), &outPts[0].z());
+}
+
 bool Proj4CoordSystem::isSameAs(CoordSystem *coordSys)
 {
     Proj4CoordSystem *other = dynamic_cast<Proj4CoordSystem *>(coordSys);
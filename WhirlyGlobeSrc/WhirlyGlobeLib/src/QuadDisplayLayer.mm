@@ -32,6 +32,11 @@
 using namespace Eigen;
 using namespace WhirlyKit;
 
+static const TelemetryID EvalStepSpan = Telemetry::registerSpan("Quad display - eval step");
+static const TelemetryID ReevaluateSpan = Telemetry::registerSpan("Quad display - reevaluate");
+// Level of each tile as it finishes loading
+static const TelemetryID TileLoadedCounter = Telemetry::registerCounter("Quad display - tile loaded level");
+
 @implementation WhirlyKitQuadDisplayLayer
 {
     /// [minZoom,maxZoom] range
@@ -47,6 +52,10 @@ using namespace WhirlyKit;
     /// State of the view the last time we were called
     WhirlyKitViewState *viewState;
     
+    /// View and frame size the loaded tiles were last scored for
+    WhirlyKitViewState *scoredViewState;
+    Point2f scoredFrameSize;
+    
     /// Frame times for metered mode
     NSTimeInterval frameStart,frameInterval,frameEndTime;
     
@@ -319,7 +328,16 @@ using namespace WhirlyKit;
 {
     _quadtree->clearEvals();
     toPhantom.clear();
-    _quadtree->reevaluateNodes();
+    
+    // Importance only depends on the view, so if that hasn't changed the scores are still good
+    Point2f frameSize(_renderer.framebufferWidth,_renderer.framebufferHeight);
+    bool rescore = !scoredViewState || frameSize != scoredFrameSize || ![viewState isSameAs:scoredViewState];
+    {
+        TelemetrySpan span(ReevaluateSpan);
+        _quadtree->reevaluateNodes(rescore);
+    }
+    scoredViewState = viewState;
+    scoredFrameSize = frameSize;
     
     std::vector<Quadtree::Identifier> newlyCoveredTiles;
     // Add everything at the minLevel back in
@@ -371,6 +389,7 @@ static const NSTimeInterval AvailableFrame = 4.0/5.0;
 // Run the evaluation step for outstanding nodes
 - (void)evalStep:(id)Sender
 {
+    TelemetrySpan span(EvalStepSpan);
     bool didSomething = false;
     
     // Might have been turned off
@@ -463,7 +482,7 @@ static const NSTimeInterval AvailableFrame = 4.0/5.0;
                         {
                             addChildren = true;
                             if (nodeInfo.childCoverage || singleTargetLevel)
-                                makePhantom = !_quadtree->childrenEvaluating(nodeInfo.ident) && !_quadtree->childrenLoading(nodeInfo.ident);
+                                makePhantom = !nodeInfo.childrenEval && !nodeInfo.childrenLoading;
                             else
                                 shouldLoad = shouldLoadFrame && !nodeInfo.isFrameLoading(curFrame);
                         }
@@ -477,12 +496,13 @@ static const NSTimeInterval AvailableFrame = 4.0/5.0;
 #ifdef TILELOGGING
                 NSLog(@"Adding children for tile: %d: (%d,%d)",nodeInfo.ident.level,nodeInfo.ident.x,nodeInfo.ident.y);
 #endif
-                std::vector<Quadtree::Identifier> childNodes;
+                std::vector<Quadtree::Identifier> childNodes,childrenToAdd;
                 _quadtree->childrenForNode(nodeInfo.ident, childNodes);
-                std::vector<Quadtree::Identifier> newlyCoveredTiles;
                 for (unsigned int ic=0;ic<childNodes.size();ic++)
                     if (!_quadtree->didFail(childNodes[ic]))
-                        _quadtree->addTile(childNodes[ic], true, true, newlyCoveredTiles);
+                        childrenToAdd.push_back(childNodes[ic]);
+                std::vector<Quadtree::Identifier> newlyCoveredTiles;
+                _quadtree->addTiles(childrenToAdd, true, true, newlyCoveredTiles);
                 
                 // By adding a tile we may have realized it's actually off screen and we've got a new batch of tiles we can turn phantom
                 if (!_targetLevels.empty())
@@ -708,6 +728,7 @@ static const NSTimeInterval AvailableFrame = 4.0/5.0;
     if (!node)
         return;
     
+    Telemetry::recordValue(TileLoadedCounter,tileIdent.level);
     _quadtree->didLoad(tileIdent,frame);
 
     // Update the parent coverage and then make those tiles phantoms if
@@ -885,6 +906,8 @@ static const NSTimeInterval AvailableFrame = 4.0/5.0;
         return;
     }
 
+    // Something other than the view may have changed, so score everything again
+    scoredViewState = nil;
     [self viewUpdate:viewState];
 }
 
@@ -914,5 +937,19 @@ static const NSTimeInterval AvailableFrame = 4.0/5.0;
     return import;
 }
 
+- (void)importanceForTiles:(std::vector<WhirlyKit::Quadtree::ImportanceRequest> &)requests tree:(WhirlyKit::Quadtree *)tree
+{
+    Point2f frameSize(_renderer.framebufferWidth,_renderer.framebufferHeight);
+    if ([_dataStructure respondsToSelector:@selector(importanceForTiles:viewInfo:frameSize:)])
+        [_dataStructure importanceForTiles:requests viewInfo:viewState frameSize:frameSize];
+    else
+        for (Quadtree::ImportanceRequest &request : requests)
+            request.importance = [_dataStructure importanceForTile:request.ident mbr:request.mbr viewInfo:viewState frameSize:frameSize attrs:request.attrs];
+#ifdef TILELOGGING
+    for (const Quadtree::ImportanceRequest &request : requests)
+        NSLog(@"importance %d: (%d,%d) %lf",request.ident.level,request.ident.x,request.ident.y,request.importance);
+#endif
+}
+
 @end
 
@@ -19,6 +19,7 @@
  */
 
 #import "Quadtree.h"
+#import <algorithm>
 
 namespace WhirlyKit
 {
@@ -78,7 +79,215 @@ void Quadtree::NodeInfo::setFrameLoading(int theFrame,bool val)
     }
 }
     
-Quadtree::Node::Node(Quadtree *tree)
+Quadtree::NodeTable::NodeTable()
+    : mask(0), count(0)
+{
+}
+    
+Quadtree::Node *Quadtree::NodeTable::find(const Identifier &ident) const
+{
+    if (count == 0)
+        return NULL;
+    
+    QuadKey key = ident.key();
+    for (unsigned int pos = (unsigned int)key.hash() & mask;;pos = (pos+1) & mask)
+    {
+        const Slot &slot = slots[pos];
+        if (!slot.node)
+            return NULL;
+        if (slot.key == key.getValue())
+            return slot.node;
+    }
+}
+    
+bool Quadtree::NodeTable::insert(Node *node)
+{
+    // Keep it at most half full so the probes stay short
+    if (2*(count+1) > (int)slots.size())
+        grow();
+    
+    QuadKey key = node->nodeInfo.ident.key();
+    unsigned int pos = (unsigned int)key.hash() & mask;
+    for (;;pos = (pos+1) & mask)
+    {
+        Slot &slot = slots[pos];
+        if (!slot.node)
+            break;
+        if (slot.key == key.getValue())
+            return false;
+    }
+    
+    Slot &slot = slots[pos];
+    slot.key = key.getValue();
+    slot.node = node;
+    count++;
+    
+    return true;
+}
+    
+void Quadtree::NodeTable::erase(const Identifier &ident)
+{
+    if (count == 0)
+        return;
+    
+    QuadKey key = ident.key();
+    unsigned int pos = (unsigned int)key.hash() & mask;
+    for (;;pos = (pos+1) & mask)
+    {
+        const Slot &slot = slots[pos];
+        if (!slot.node)
+            return;
+        if (slot.key == key.getValue())
+            break;
+    }
+    
+    // Pull back any entries in the same run that would be stranded by the hole
+    unsigned int hole = pos;
+    for (unsigned int next = (hole+1) & mask;slots[next].node;next = (next+1) & mask)
+    {
+        const Slot &slot = slots[next];
+        unsigned int home = (unsigned int)QuadKey(slot.key).hash() & mask;
+        // Can only move if home isn't cyclically in (hole,next]
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            slots[hole] = slot;
+            hole = next;
+        }
+    }
+    slots[hole].node = NULL;
+    count--;
+}
+    
+void Quadtree::NodeTable::clear()
+{
+    for (Slot &slot : slots)
+        slot.node = NULL;
+    count = 0;
+}
+    
+void Quadtree::NodeTable::grow()
+{
+    std::vector<Slot> oldSlots;
+    oldSlots.swap(slots);
+    
+    Slot empty;
+    empty.key = 0;  empty.node = NULL;
+    slots.resize(oldSlots.empty() ? 64 : 2*oldSlots.size(),empty);
+    mask = (unsigned int)slots.size()-1;
+    count = 0;
+    
+    for (const Slot &slot : oldSlots)
+        if (slot.node)
+            insert(slot.node);
+}
+    
+Quadtree::NodeHeap::NodeHeap(int Node::*posField,bool largestFirst)
+    : posField(posField), largestFirst(largestFirst)
+{
+}
+    
+bool Quadtree::NodeHeap::contains(const Node *node) const
+{
+    return node->*posField >= 0;
+}
+
+bool Quadtree::NodeHeap::before(const Node *a,const Node *b) const
+{
+    // Same order as the node info, importance and then identifier
+    if (largestFirst)
+        return b->nodeInfo < a->nodeInfo;
+    return a->nodeInfo < b->nodeInfo;
+}
+    
+void Quadtree::NodeHeap::place(int which,Node *node)
+{
+    nodes[which] = node;
+    node->*posField = which;
+}
+    
+void Quadtree::NodeHeap::siftUp(int which)
+{
+    Node *node = nodes[which];
+    while (which > 0)
+    {
+        int parent = (which-1)/2;
+        if (!before(node,nodes[parent]))
+            break;
+        place(which,nodes[parent]);
+        which = parent;
+    }
+    place(which,node);
+}
+    
+void Quadtree::NodeHeap::siftDown(int which)
+{
+    int num = (int)nodes.size();
+    Node *node = nodes[which];
+    for (;;)
+    {
+        int child = 2*which+1;
+        if (child >= num)
+            break;
+        if (child+1 < num && before(nodes[child+1],nodes[child]))
+            child++;
+        if (!before(nodes[child],node))
+            break;
+        place(which,nodes[child]);
+        which = child;
+    }
+    place(which,node);
+}
+    
+void Quadtree::NodeHeap::insert(Node *node)
+{
+    if (contains(node))
+        return;
+    nodes.push_back(node);
+    siftUp((int)nodes.size()-1);
+}
+    
+void Quadtree::NodeHeap::erase(Node *node)
+{
+    int which = node->*posField;
+    if (which < 0)
+        return;
+    node->*posField = -1;
+    
+    Node *last = nodes.back();
+    nodes.pop_back();
+    if (last == node)
+        return;
+    
+    // Move the last one into the hole and let it find its level
+    place(which,last);
+    if (which > 0 && before(last,nodes[(which-1)/2]))
+        siftUp(which);
+    else
+        siftDown(which);
+}
+    
+void Quadtree::NodeHeap::clear()
+{
+    for (Node *node : nodes)
+        node->*posField = -1;
+    nodes.clear();
+}
+    
+void Quadtree::NodeHeap::append(Node *node)
+{
+    if (contains(node))
+        return;
+    node->*posField = (int)nodes.size();
+    nodes.push_back(node);
+}
+    
+void Quadtree::NodeHeap::rebuild()
+{
+    for (int ii=(int)nodes.size()/2-1;ii>=0;ii--)
+        siftDown(ii);
+}
+    
+Quadtree::Node::Node()
 {
     parent = NULL;
     for (unsigned int ii=0;ii<4;ii++)
@@ -86,17 +295,14 @@ Quadtree::Node::Node(Quadtree *tree)
         children[ii] = NULL;
         childOffscreen[ii] = false;
     }
-    identPos = tree->nodesByIdent.end();
-    sizePos = tree->nodesBySize.end();
+    sizePos = -1;
+    evalPos = -1;
+    attrs = nil;
 }
     
 void Quadtree::Node::addChild(Quadtree *tree,Node *child)
 {
-    // Note: The iterators don't appear to be safe
-    NodesBySizeType::iterator it = tree->nodesBySize.find(this);
-    if (it != tree->nodesBySize.end())
-        tree->nodesBySize.erase(it);
-    sizePos = tree->nodesBySize.end();
+    tree->nodesBySize.erase(this);
 
     int ix = child->nodeInfo.ident.x - nodeInfo.ident.x*2;
     int iy = child->nodeInfo.ident.y - nodeInfo.ident.y*2;
@@ -113,7 +319,7 @@ void Quadtree::Node::removeChild(Quadtree *tree, Node *child)
         hasChildren |= (children[ii] != NULL);
     }
     if (!hasChildren)
-        sizePos = tree->nodesBySize.insert(this).first;
+        tree->nodesBySize.insert(this);
 }
     
 bool Quadtree::Node::hasChildren()
@@ -161,27 +367,25 @@ void Quadtree::Node::Print()
 }
 
 Quadtree::Quadtree(Mbr mbr,int minLevel,int maxLevel,int maxNodes,float minImportance,NSObject<WhirlyKitQuadTreeImportanceDelegate> *importDelegate)
-    : mbr(mbr), minLevel(minLevel), maxLevel(maxLevel), maxNodes(maxNodes), minImportance(minImportance), numPhantomNodes(0)
+    : mbr(mbr), minLevel(minLevel), maxLevel(maxLevel), maxNodes(maxNodes), minImportance(minImportance), numPhantomNodes(0),
+    nodesBySize(&Node::sizePos,false), evalNodes(&Node::evalPos,true)
 {
     this->importDelegate = importDelegate;
+    batchImportance = [importDelegate respondsToSelector:@selector(importanceForTiles:tree:)];
 }
     
 Quadtree::~Quadtree()
 {
-    for (NodesByIdentType::iterator it = nodesByIdent.begin();
-         it != nodesByIdent.end(); ++it)
-        delete *it;
-    nodesByIdent.clear();
     nodesBySize.clear();
+    evalNodes.clear();
+    for (int ii=0;ii<nodesByIdent.numSlots();ii++)
+        delete nodesByIdent.slot(ii);
+    nodesByIdent.clear();
 }
     
 bool Quadtree::isTilePresent(const Identifier &ident)
 {
-    Node dummyNode(this);
-    dummyNode.nodeInfo.ident = ident;
-    
-    NodesBySizeType::iterator it = nodesByIdent.find(&dummyNode);
-    return it != nodesByIdent.end();
+    return nodesByIdent.find(ident) != NULL;
 }
     
 bool Quadtree::isFull()
@@ -215,26 +419,21 @@ bool Quadtree::shouldLoadTile(const Identifier &ident,int frame)
         return true;
     
     // Otherwise, this one needs to be more important
-    NodesBySizeType::iterator it = nodesBySize.begin();
     // Should never happen
-    if (it == nodesBySize.end())
+    if (nodesBySize.empty())
         return false;
-    Node *compNode = *it;
+    Node *compNode = nodesBySize.top();
     
     return compNode->nodeInfo.importance < node->nodeInfo.importance;
 }
     
 bool Quadtree::isPhantom(const Identifier &ident)
 {
-    Node dummyNode(this);
-    dummyNode.nodeInfo.ident = ident;
-    
-    NodesByIdentType::iterator it = nodesByIdent.find(&dummyNode);
-    if (it == nodesByIdent.end())
+    Node *node = getNode(ident);
+    if (!node)
         return false;
 
-    bool phantom = (*it)->nodeInfo.phantom;
-    return phantom;
+    return node->nodeInfo.phantom;
 }
     
     
@@ -338,14 +537,9 @@ void Quadtree::recalcCoverage(Node *node)
     
 void Quadtree::setPhantom(const Identifier &ident,bool newPhantom)
 {
-    Node dummyNode(this);
-    dummyNode.nodeInfo.ident = ident;
-
-    Node *node = NULL;
-    NodesByIdentType::iterator it = nodesByIdent.find(&dummyNode);
-    if (it != nodesByIdent.end())
+    Node *node = getNode(ident);
+    if (node)
     {
-        node = *it;
         bool wasPhantom = node->nodeInfo.phantom;
         node->nodeInfo.phantom = newPhantom;
         if (wasPhantom)
@@ -356,49 +550,39 @@ void Quadtree::setPhantom(const Identifier &ident,bool newPhantom)
         // Haven't heard of it
         return;
 
-    NodesBySizeType::iterator sit = nodesBySize.find(&dummyNode);
     // Clean it out of the nodes by size if it's a phantom
     if (newPhantom)
     {
         clearFlagCounts(node->nodeInfo.frameFlags);
         node->nodeInfo.frameFlags = 0;
-        if (sit != nodesBySize.end())
-            nodesBySize.erase(sit);
+        nodesBySize.erase(node);
     } else {
         // Add it in if it's no longer a phantom
-        if (sit == nodesBySize.end())
-            nodesBySize.insert(*it);
+        nodesBySize.insert(node);
     }
 }
 
 bool Quadtree::isLoading(const Identifier &ident,int frame)
 {
-    Node dummyNode(this);
-    dummyNode.nodeInfo.ident = ident;
-    
-    NodesByIdentType::iterator it = nodesByIdent.find(&dummyNode);
-    if (it == nodesByIdent.end())
+    Node *node = getNode(ident);
+    if (!node)
         return false;
     
-    bool loading = (*it)->nodeInfo.isFrameLoading(frame);
-    return loading;
+    return node->nodeInfo.isFrameLoading(frame);
 }
 
 void Quadtree::setLoading(const Identifier &ident,int frame,bool newLoading)
 {
-    Node dummyNode(this);
-    dummyNode.nodeInfo.ident = ident;
-    
-    NodesByIdentType::iterator it = nodesByIdent.find(&dummyNode);
-    if (it != nodesByIdent.end())
+    Node *node = getNode(ident);
+    if (node)
     {
-        bool wasLoading = (*it)->nodeInfo.isFrameLoading(frame);
-        (*it)->nodeInfo.setFrameLoading(frame,newLoading);
+        bool wasLoading = node->nodeInfo.isFrameLoading(frame);
+        node->nodeInfo.setFrameLoading(frame,newLoading);
         
         // Let the parents know
         if (wasLoading && !newLoading)
         {
-            Node *parent = (*it)->parent;
+            Node *parent = node->parent;
             while (parent)
             {
                 parent->nodeInfo.childrenLoading--;
@@ -406,7 +590,7 @@ void Quadtree::setLoading(const Identifier &ident,int frame,bool newLoading)
             }
         } else if (!wasLoading && newLoading)
         {
-            Node *parent = (*it)->parent;
+            Node *parent = node->parent;
             while (parent)
             {
                 parent->nodeInfo.childrenLoading++;
@@ -440,27 +624,19 @@ void Quadtree::didLoad(const Identifier &tileIdent,int frame)
     
 bool Quadtree::isEvaluating(const Identifier &ident)
 {
-    Node dummyNode(this);
-    dummyNode.nodeInfo.ident = ident;
-    
-    NodesByIdentType::iterator it = nodesByIdent.find(&dummyNode);
-    if (it == nodesByIdent.end())
+    Node *node = getNode(ident);
+    if (!node)
         return false;
     
-    bool eval = (*it)->nodeInfo.eval;
-    return eval;
+    return node->nodeInfo.eval;
 }
 
 void Quadtree::setEvaluating(const Identifier &ident,bool newEval)
 {
-    Node dummyNode(this);
-    dummyNode.nodeInfo.ident = ident;
-    
-    NodesByIdentType::iterator it = nodesByIdent.find(&dummyNode);
-    if (it != nodesByIdent.end())
+    Node *node = getNode(ident);
+    if (node)
     {
-        bool wasEval = (*it)->nodeInfo.eval;
-        Node *node = *it;
+        bool wasEval = node->nodeInfo.eval;
         node->nodeInfo.eval = newEval;
         
         // Let the parents know
@@ -475,8 +651,7 @@ void Quadtree::setEvaluating(const Identifier &ident,bool newEval)
                 parent = parent->parent;
             }
             
-            evalNodes.erase(node->evalPos);
-            node->evalPos = evalNodes.end();
+            evalNodes.erase(node);
         } else if (!wasEval && newEval)
         {
             Node *parent = node->parent;
@@ -486,7 +661,7 @@ void Quadtree::setEvaluating(const Identifier &ident,bool newEval)
                 parent = parent->parent;
             }
             
-            node->evalPos = evalNodes.insert(node).first;
+            evalNodes.insert(node);
         }
     } else
         // Haven't heard of it
@@ -505,14 +680,9 @@ bool Quadtree::didFail(const Quadtree::Identifier &ident)
     
 void Quadtree::setFailed(const Identifier &ident,bool newFail)
 {
-    Node dummyNode(this);
-    dummyNode.nodeInfo.ident = ident;
-    
-    NodesByIdentType::iterator it = nodesByIdent.find(&dummyNode);
-    if (it != nodesByIdent.end())
-    {
-        (*it)->nodeInfo.failed = newFail;
-    }
+    Node *node = getNode(ident);
+    if (node)
+        node->nodeInfo.failed = newFail;
 }
 
 bool Quadtree::childFailed(const Identifier &ident)
@@ -535,26 +705,27 @@ int Quadtree::numEvals()
     
 void Quadtree::clearEvals()
 {
-    for (NodesByIdentType::iterator it = nodesByIdent.begin();it != nodesByIdent.end(); ++it)
+    evalNodes.clear();
+    for (int ii=0;ii<nodesByIdent.numSlots();ii++)
     {
-        Node *node = *it;
-        node->evalPos = evalNodes.end();
+        Node *node = nodesByIdent.slot(ii);
+        if (!node)
+            continue;
         node->nodeInfo.eval = false;
 //        node->nodeInfo.loading = false;
 //        node->nodeInfo.childrenLoading = 0;
         node->nodeInfo.childrenEval = 0;
         node->nodeInfo.failed = false;
     }
-    
-    evalNodes.clear();
 }
     
 void Quadtree::clearFails()
 {
-    for (NodesByIdentType::iterator it = nodesByIdent.begin();it != nodesByIdent.end(); ++it)
+    for (int ii=0;ii<nodesByIdent.numSlots();ii++)
     {
-        Node *node = *it;
-        node->nodeInfo.failed = false;
+        Node *node = nodesByIdent.slot(ii);
+        if (node)
+            node->nodeInfo.failed = false;
     }
 }
     
@@ -562,10 +733,8 @@ bool Quadtree::popLastEval(NodeInfo &retNodeInfo)
 {
     if (evalNodes.empty())
         return false;
-    NodesBySizeType::iterator it = evalNodes.end();
-    it--;
-    Node *node = *it;
-    evalNodes.erase(it);
+    Node *node = evalNodes.top();
+    evalNodes.erase(node);
     node->nodeInfo.eval = false;
     
     // Remove children eval
@@ -584,32 +753,35 @@ bool Quadtree::popLastEval(NodeInfo &retNodeInfo)
     
 bool Quadtree::childrenLoading(const Identifier &ident)
 {
-    Node dummyNode(this);
-    dummyNode.nodeInfo.ident = ident;
-    
-    NodesByIdentType::iterator it = nodesByIdent.find(&dummyNode);
-    if (it != nodesByIdent.end())
-    {
-        return (*it)->nodeInfo.childrenLoading;
-    } else
+    Node *node = getNode(ident);
+    if (node)
+        return node->nodeInfo.childrenLoading;
+    else
         return false;
 }
     
 bool Quadtree::childrenEvaluating(const Identifier &ident)
 {
-    Node dummyNode(this);
-    dummyNode.nodeInfo.ident = ident;
-    
-    NodesByIdentType::iterator it = nodesByIdent.find(&dummyNode);
-    if (it != nodesByIdent.end())
-    {
-        int numEval = (*it)->nodeInfo.childrenEval;
-        return numEval;
-    } else
+    Node *node = getNode(ident);
+    if (node)
+        return node->nodeInfo.childrenEval;
+    else
         return false;
 }
     
-void Quadtree::reevaluateNodes()
+void Quadtree::scoreTiles(std::vector<ImportanceRequest> &requests)
+{
+    if (requests.empty())
+        return;
+    
+    if (batchImportance)
+        [importDelegate importanceForTiles:requests tree:this];
+    else
+        for (ImportanceRequest &request : requests)
+            request.importance = [importDelegate importanceForTile:request.ident mbr:request.mbr tree:this attrs:request.attrs];
+}
+    
+void Quadtree::reevaluateNodes(bool rescore)
 {
     nodesBySize.clear();
     evalNodes.clear();
@@ -617,13 +789,40 @@ void Quadtree::reevaluateNodes()
     if (nodesByIdent.empty())
         return;
     
-    for (NodesByIdentType::iterator it = nodesByIdent.begin();
-         it != nodesByIdent.end(); ++it)
+    // Importance changes for everything, so we refill the heaps in one go at the end
+    std::vector<Node *> nodes;
+    nodes.reserve(nodesByIdent.size());
+    for (int ii=0;ii<nodesByIdent.numSlots();ii++)
+    {
+        Node *node = nodesByIdent.slot(ii);
+        if (!node)
+            continue;
+        nodes.push_back(node);
+        for (unsigned int ic=0;ic<4;ic++)
+            node->childOffscreen[ic] = false;
+    }
+    
+    // Score everything in one go
+    if (rescore)
+    {
+        std::vector<ImportanceRequest> &requests = importRequests;
+        requests.resize(nodes.size());
+        for (unsigned int ii=0;ii<nodes.size();ii++)
+        {
+            ImportanceRequest &request = requests[ii];
+            request.ident = nodes[ii]->nodeInfo.ident;
+            request.mbr = nodes[ii]->nodeInfo.mbr;
+            request.attrs = nodes[ii]->attrs;
+            request.importance = 0.0;
+        }
+        scoreTiles(requests);
+        for (unsigned int ii=0;ii<nodes.size();ii++)
+            nodes[ii]->nodeInfo.importance = requests[ii].importance;
+        requests.clear();
+    }
+    
+    for (Node *node : nodes)
     {
-        Node *node = *it;
-        for (unsigned int ii=0;ii<4;ii++)
-            node->childOffscreen[ii] = false;
-        node->nodeInfo.importance = [importDelegate importanceForTile:node->nodeInfo.ident mbr:node->nodeInfo.mbr tree:this attrs:node->nodeInfo.attrs];
         // Let the parent know this node is offscreen
         if (node->nodeInfo.importance == 0)
         {
@@ -638,21 +837,52 @@ void Quadtree::reevaluateNodes()
             }
         }
         if (!node->hasChildren())
-            node->sizePos = nodesBySize.insert(node).first;
-        node->evalPos = evalNodes.insert(node).first;
+            nodesBySize.append(node);
+        evalNodes.append(node);
     }
-    
-    // Recalculate the coverage for children
-    NodesByIdentType::iterator it = nodesByIdent.end();
-    --it;
-    do {
-        (*it)->recalcCoverage();
-        if (it != nodesByIdent.begin())
-            --it;
-    } while (it != nodesByIdent.begin());
+    nodesBySize.rebuild();
+    evalNodes.rebuild();
+    
+    // Recalculate the coverage for children, bottom level first
+    std::sort(nodes.begin(),nodes.end(),
+              [](const Node *a,const Node *b) { return a->nodeInfo.ident.level > b->nodeInfo.ident.level; });
+    for (Node *node : nodes)
+        node->recalcCoverage();
 }
     
 const Quadtree::NodeInfo *Quadtree::addTile(const Identifier &ident,bool newEval,bool checkImportance,std::vector<Identifier> &newlyCoveredTiles)
+{
+    return addTile(ident,newEval,checkImportance,newlyCoveredTiles,NULL);
+}
+    
+void Quadtree::addTiles(const std::vector<Identifier> &idents,bool newEval,bool checkImportance,std::vector<Identifier> &newlyCoveredTiles)
+{
+    // Score the ones we don't have yet, all together
+    std::vector<ImportanceRequest> requests;
+    requests.reserve(idents.size());
+    for (const Identifier &ident : idents)
+        if (!getNode(ident))
+        {
+            ImportanceRequest request;
+            request.ident = ident;
+            request.mbr = generateMbrForNode(ident);
+            request.attrs = [NSMutableDictionary dictionary];
+            requests.push_back(request);
+        }
+    scoreTiles(requests);
+    
+    // Then add them in order, just like one at a time
+    unsigned int which = 0;
+    for (const Identifier &ident : idents)
+    {
+        const ImportanceRequest *scored = NULL;
+        if (which < requests.size() && requests[which].ident == ident)
+            scored = &requests[which++];
+        addTile(ident,newEval,checkImportance,newlyCoveredTiles,scored);
+    }
+}
+    
+const Quadtree::NodeInfo *Quadtree::addTile(const Identifier &ident,bool newEval,bool checkImportance,std::vector<Identifier> &newlyCoveredTiles,const ImportanceRequest *scored)
 {
     bool oldEval = false;
     bool oldLoading = false;
@@ -670,7 +900,19 @@ const Quadtree::NodeInfo *Quadtree::addTile(const Identifier &ident,bool newEval
         }
         
         // Check that the importance is more than our minimum before adding the tile
-        NodeInfo nodeInfo = generateNode(ident);
+        // The attributes go with the node, so anything the delegate caches is kept
+        NSMutableDictionary *attrs = nil;
+        NodeInfo nodeInfo;
+        if (scored)
+        {
+            attrs = scored->attrs;
+            nodeInfo.ident = ident;
+            nodeInfo.mbr = scored->mbr;
+            nodeInfo.importance = scored->importance;
+        } else {
+            attrs = [NSMutableDictionary dictionary];
+            nodeInfo = generateNode(ident,attrs);
+        }
         
         if (checkImportance && nodeInfo.importance < minImportance)
         {
@@ -687,8 +929,9 @@ const Quadtree::NodeInfo *Quadtree::addTile(const Identifier &ident,bool newEval
         }
         
         // Set up the node first, so we don't remove the parent
-        node = new Node(this);
+        node = new Node();
         node->nodeInfo = nodeInfo;
+        node->attrs = attrs;
         node->parent = parent;
         node->nodeInfo.phantom = true;
         node->nodeInfo.frameLoadingFlags = 0;
@@ -704,9 +947,9 @@ const Quadtree::NodeInfo *Quadtree::addTile(const Identifier &ident,bool newEval
     }
 
     // Add the new node into the lists here, so we don't remove it immediately
-    node->identPos = nodesByIdent.insert(node).first;
+    nodesByIdent.insert(node);
     if (!node->nodeInfo.phantom)
-        node->sizePos = nodesBySize.insert(node).first;
+        nodesBySize.insert(node);
     
     // Let the parents know
     if (!oldEval && newEval)
@@ -717,7 +960,7 @@ const Quadtree::NodeInfo *Quadtree::addTile(const Identifier &ident,bool newEval
             parent->nodeInfo.childrenEval++;
             parent = parent->parent;
         }
-        node->evalPos = evalNodes.insert(node).first;
+        evalNodes.insert(node);
     } else if (oldEval && !newEval)
     {
         Node *parent = node->parent;
@@ -728,9 +971,7 @@ const Quadtree::NodeInfo *Quadtree::addTile(const Identifier &ident,bool newEval
                 parent->nodeInfo.childrenEval = 0;
             parent = parent->parent;
         }
-        NodesBySizeType::iterator it = evalNodes.find(node);
-        if (it != evalNodes.end())
-            evalNodes.erase(it);
+        evalNodes.erase(node);
     }
     
     if (!oldLoading && node->nodeInfo.isFrameLoading(-1))
@@ -778,12 +1019,23 @@ const Quadtree::NodeInfo *Quadtree::getNodeInfo(const Identifier &ident)
     return &node->nodeInfo;
 }
     
-Quadtree::NodeInfo Quadtree::generateNode(const Identifier &ident)
+NSMutableDictionary *Quadtree::getAttrs(const Identifier &ident)
+{
+    Node *node = getNode(ident);
+    if (!node)
+        return nil;
+    
+    return node->attrs;
+}
+    
+Quadtree::NodeInfo Quadtree::generateNode(const Identifier &ident,NSMutableDictionary *attrs)
 {
     NodeInfo nodeInfo;
     nodeInfo.ident = ident;
     nodeInfo.mbr = generateMbrForNode(ident);
-    nodeInfo.importance = [importDelegate importanceForTile:nodeInfo.ident mbr:nodeInfo.mbr tree:this attrs:nodeInfo.attrs];
+    if (!attrs)
+        attrs = [NSMutableDictionary dictionary];
+    nodeInfo.importance = [importDelegate importanceForTile:nodeInfo.ident mbr:nodeInfo.mbr tree:this attrs:attrs];
     
     return nodeInfo;
 }
@@ -813,11 +1065,24 @@ void Quadtree::generateMbrForNode(const Identifier &ident,Point2d &ll,Point2d &u
     
 bool Quadtree::leastImportantNode(NodeInfo &nodeInfo,bool force)
 {
+    if (nodesBySize.empty())
+        return false;
+    
+    // Walk the heap from least to most important without disturbing it.
+    // We keep a small heap of the positions we might visit next, starting at the top.
+    std::vector<int> &toVisit = walkHeap;
+    toVisit.clear();
+    toVisit.push_back(0);
+    auto visitLater = [this](int a,int b) { return nodesBySize.before(nodesBySize.at(b),nodesBySize.at(a)); };
+    
     // Look for the most unimportant node that isn't therwise engaged
-    for (NodesBySizeType::iterator it = nodesBySize.begin();
-         it != nodesBySize.end(); ++it)
+    while (!toVisit.empty())
     {
-        Node *node = *it;
+        std::pop_heap(toVisit.begin(),toVisit.end(),visitLater);
+        int which = toVisit.back();
+        toVisit.pop_back();
+        Node *node = nodesBySize.at(which);
+        
         if (force || node->nodeInfo.importance == 0.0 || ((node->nodeInfo.importance < minImportance && node->nodeInfo.ident.level > minLevel) &&
                                  !node->parentLoading() && node->nodeInfo.childrenLoading == 0 && node->hasNonPhantomParent()))
         {
@@ -830,6 +1095,16 @@ bool Quadtree::leastImportantNode(NodeInfo &nodeInfo,bool force)
                 nodeInfo = node->nodeInfo;
                 return true;
             }
+        } else if (node->nodeInfo.importance > 0.0 && node->nodeInfo.importance >= minImportance)
+        {
+            // Everything under this one is at least as important, so none of it will qualify either
+            continue;
+        }
+        
+        for (int child = 2*which+1;child <= 2*which+2 && child < nodesBySize.size();child++)
+        {
+            toVisit.push_back(child);
+            std::push_heap(toVisit.begin(),toVisit.end(),visitLater);
         }
     }
     
@@ -875,23 +1150,20 @@ bool Quadtree::hasParent(const Quadtree::Identifier &ident,Quadtree::Identifier
 void Quadtree::Print()
 {
     NSLog(@"***QuadTree Dump***");
-    for (NodesByIdentType::iterator it = nodesByIdent.begin();
-         it != nodesByIdent.end(); ++it)
-    {
-        Node *node = *it;
+    std::vector<Node *> nodes;
+    for (int ii=0;ii<nodesByIdent.numSlots();ii++)
+        if (nodesByIdent.slot(ii))
+            nodes.push_back(nodesByIdent.slot(ii));
+    std::sort(nodes.begin(),nodes.end(),
+              [](const Node *a,const Node *b) { return a->nodeInfo.ident < b->nodeInfo.ident; });
+    for (Node *node : nodes)
         node->Print();
-    }
     NSLog(@"******");
 }
 
 Quadtree::Node *Quadtree::getNode(const Identifier &ident)
 {
-    Node dummyNode(this);
-    dummyNode.nodeInfo.ident = ident;
-    NodesByIdentType::iterator it = nodesByIdent.find(&dummyNode);
-    if (it == nodesByIdent.end())
-        return NULL;
-    return *it;
+    return nodesByIdent.find(ident);
 }
     
 void Quadtree::removeNode(Node *node)
@@ -923,16 +1195,9 @@ void Quadtree::removeNode(Node *node)
         }
     }
     
-    // Note: Iterators don't seem to be safe
-    NodesByIdentType::iterator iit = nodesByIdent.find(node);
-    if (iit != nodesByIdent.end())
-        nodesByIdent.erase(iit);
-    NodesBySizeType::iterator sit = nodesBySize.find(node);
-    if (sit != nodesBySize.end())
-        nodesBySize.erase(sit);
-    NodesBySizeType::iterator eit = evalNodes.find(node);
-    if (eit != evalNodes.end())
-        evalNodes.erase(eit);
+    nodesByIdent.erase(node->nodeInfo.ident);
+    nodesBySize.erase(node);
+    evalNodes.erase(node);
     
     // Note: Shouldn't happen, but just in case
     for (unsigned int ii=0;ii<4;ii++)
@@ -0,0 +1,198 @@
+/*
+ *  RenderBackend.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import "RenderBackend.h"
+
+namespace WhirlyKit
+{
+
+RenderBackendStats::RenderBackendStats()
+{
+    clear();
+}
+
+void RenderBackendStats::clear()
+{
+    buffersCreated = buffersDeleted = 0;
+    bufferBytes = 0;
+    texturesCreated = texturesDeleted = 0;
+    textureBytes = 0;
+    programChanges = textureBinds = 0;
+    drawCalls = 0;
+    primitives = 0;
+    badIDs = 0;
+}
+
+void RenderBackendStats::add(const RenderBackendStats &that)
+{
+    buffersCreated += that.buffersCreated;
+    buffersDeleted += that.buffersDeleted;
+    bufferBytes += that.bufferBytes;
+    texturesCreated += that.texturesCreated;
+    texturesDeleted += that.texturesDeleted;
+    textureBytes += that.textureBytes;
+    programChanges += that.programChanges;
+    textureBinds += that.textureBinds;
+    drawCalls += that.drawCalls;
+    primitives += that.primitives;
+    badIDs += that.badIDs;
+}
+
+NullRenderBackend::NullRenderBackend()
+    : nextID(1), liveBufferBytes(0), liveTextureBytes(0), curProgram(EmptyIdentity), numFrames(0)
+{
+}
+
+NullRenderBackend::~NullRenderBackend()
+{
+}
+
+void NullRenderBackend::startFrame(int /*width*/,int /*height*/)
+{
+    frameStats.clear();
+    curProgram = EmptyIdentity;
+}
+
+unsigned int NullRenderBackend::createBuffer(const void *data,size_t size)
+{
+    unsigned int bufID = nextID++;
+    buffers[bufID] = size;
+    liveBufferBytes += size;
+    frameStats.buffersCreated++;
+    if (data)
+        frameStats.bufferBytes += size;
+
+    return bufID;
+}
+
+void NullRenderBackend::updateBuffer(unsigned int bufID,size_t offset,const void * /*data*/,size_t size)
+{
+    std::unordered_map<unsigned int,size_t>::iterator it = buffers.find(bufID);
+    if (it == buffers.end() || offset+size > it->second)
+    {
+        frameStats.badIDs++;
+        return;
+    }
+    frameStats.bufferBytes += size;
+}
+
+void NullRenderBackend::deleteBuffer(unsigned int bufID)
+{
+    std::unordered_map<unsigned int,size_t>::iterator it = buffers.find(bufID);
+    if (it == buffers.end())
+    {
+        frameStats.badIDs++;
+        return;
+    }
+    liveBufferBytes -= it->second;
+    buffers.erase(it);
+    frameStats.buffersDeleted++;
+}
+
+unsigned int NullRenderBackend::createTexture(int width,int height,int bytesPerPixel,const void *data)
+{
+    unsigned int texID = nextID++;
+    size_t size = (size_t)width * height * bytesPerPixel;
+    textures[texID] = size;
+    liveTextureBytes += size;
+    frameStats.texturesCreated++;
+    if (data)
+        frameStats.textureBytes += size;
+
+    return texID;
+}
+
+void NullRenderBackend::updateTexture(unsigned int texID,int /*x*/,int /*y*/,int width,int height,int bytesPerPixel,const void * /*data*/)
+{
+    size_t size = (size_t)width * height * bytesPerPixel;
+    std::unordered_map<unsigned int,size_t>::iterator it = textures.find(texID);
+    if (it == textures.end() || size > it->second)
+    {
+        frameStats.badIDs++;
+        return;
+    }
+    frameStats.textureBytes += size;
+}
+
+void NullRenderBackend::deleteTexture(unsigned int texID)
+{
+    std::unordered_map<unsigned int,size_t>::iterator it = textures.find(texID);
+    if (it == textures.end())
+    {
+        frameStats.badIDs++;
+        return;
+    }
+    liveTextureBytes -= it->second;
+    textures.erase(it);
+    frameStats.texturesDeleted++;
+}
+
+void NullRenderBackend::useProgram(SimpleIdentity programID)
+{
+    // Same as the renderer, we only count real changes
+    if (programID == curProgram)
+        return;
+    curProgram = programID;
+    frameStats.programChanges++;
+}
+
+void NullRenderBackend::bindTexture(int /*unit*/,unsigned int texID)
+{
+    if (texID != 0 && textures.find(texID) == textures.end())
+        frameStats.badIDs++;
+    frameStats.textureBinds++;
+}
+
+void NullRenderBackend::draw(RenderPrimitiveType type,unsigned int vertBuf,unsigned int elementBuf,int count,int numInstances)
+{
+    if (buffers.find(vertBuf) == buffers.end() ||
+        (elementBuf != 0 && buffers.find(elementBuf) == buffers.end()))
+    {
+        frameStats.badIDs++;
+        return;
+    }
+
+    uint64_t prims = 0;
+    switch (type)
+    {
+        case RenderTriangles:
+            prims = count / 3;
+            break;
+        case RenderTriangleStrip:
+            prims = count > 2 ? count-2 : 0;
+            break;
+        case RenderLines:
+            prims = count / 2;
+            break;
+        case RenderPoints:
+            prims = count;
+            break;
+    }
+    frameStats.drawCalls++;
+    frameStats.primitives += prims * numInstances;
+}
+
+void NullRenderBackend::present()
+{
+    totalStats.add(frameStats);
+    numFrames++;
+}
+
+}
@@ -18,6 +18,7 @@
  *
  */
 
+#import <cxxabi.h>
 #import "Scene.h"
 #import "GlobeView.h"
 #import "GlobeMath.h"
@@ -55,6 +56,10 @@ void Scene::Init(WhirlyKit::CoordSystemDisplayAdapter *adapter,Mbr localMbr,unsi
     pthread_mutex_init(&generatorLock,NULL);
     pthread_mutex_init(&programLock,NULL);
     pthread_mutex_init(&managerLock,NULL);
+    
+    numPendingChanges.store(0);
+    changeTimeBudget = 0.0;
+    changeByteBudget = 0;
 
     ssGen = NULL;
     
@@ -128,13 +133,18 @@ Scene::~Scene()
     pthread_mutex_destroy(&generatorLock);
     pthread_mutex_destroy(&programLock);
     
-    auto theChangeRuquests = changeRequests;
+    // Note: Tear down change requests?
+    ChangeSet changeGroup;
+    while (changeQueue.pop(changeGroup))
+        changeRequests.push_back(changeGroup);
+    for (const ChangeSet &theChangeGroup : changeRequests)
+        for (ChangeRequest *change : theChangeGroup)
+            delete change;
     changeRequests.clear();
-    for (unsigned int ii=0;ii<theChangeRuquests.size();ii++)
-    {
-        // Note: Tear down change requests?
-        delete theChangeRuquests[ii];
-    }
+    std::vector<ChangeRequest *> timedChanges;
+    timedChangeRequests.takeAll(timedChanges);
+    for (ChangeRequest *change : timedChanges)
+        delete change;
     
     activeModels = nil;
     
@@ -181,32 +191,55 @@ SimpleIdentity Scene::getGeneratorIDByName(const std::string &name)
     return retId;
 }
 
-// Add change requests to our list
+// Add change requests to our list.
+// The rendering thread sorts out the timed ones when it picks them up.
 void Scene::addChangeRequests(const ChangeSet &newChanges)
 {
-    pthread_mutex_lock(&changeRequestLock);
+    if (newChanges.empty())
+        return;
     
+    NSTimeInterval now = CFAbsoluteTimeGetCurrent();
     for (ChangeRequest *change : newChanges)
-    {
-        if (change && change->when > 0.0)
-            timedChangeRequests.insert(change);
-        else
-            changeRequests.push_back(change);
-    }
+        if (change)
+            change->queueTime = now;
     
-    pthread_mutex_unlock(&changeRequestLock);
+    numPendingChanges.fetch_add((int)newChanges.size(),std::memory_order_relaxed);
+    changeQueue.push(newChanges);
 }
 
 // Add a single change request
 void Scene::addChangeRequest(ChangeRequest *newChange)
+{
+    addChangeRequests(ChangeSet(1,newChange));
+}
+
+void Scene::setChangeBudget(NSTimeInterval maxTime,size_t maxBytes)
 {
     pthread_mutex_lock(&changeRequestLock);
-    
-    if (newChange && newChange->when > 0.0)
-        timedChangeRequests.insert(newChange);
-    else
-        changeRequests.push_back(newChange);
-    
+    changeTimeBudget = maxTime;
+    changeByteBudget = maxBytes;
+    pthread_mutex_unlock(&changeRequestLock);
+}
+
+// Readable class name for a change request type
+static std::string ChangeTypeName(const std::type_index &type)
+{
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(type.name(),NULL,NULL,&status);
+    std::string name = (demangled && status == 0) ? demangled : type.name();
+    free(demangled);
+    return name;
+}
+
+void Scene::getChangeStats(std::vector<ChangeStats> &stats)
+{
+    pthread_mutex_lock(&changeRequestLock);
+    for (auto it : changeStats)
+    {
+        ChangeStats typeStats = it.second;
+        typeStats.name = ChangeTypeName(it.first);
+        stats.push_back(typeStats);
+    }
     pthread_mutex_unlock(&changeRequestLock);
 }
 
@@ -327,6 +360,10 @@ void Scene::teardownGL()
         delete cullTree;
         cullTree = NULL;
     }
+    for (DrawableRefSet::iterator it = drawables.begin();
+         it != drawables.end(); ++it)
+        (*it)->setDrawListSlot(-1);
+    drawList.clear();
     drawables.clear();
     for (TextureSet::iterator it = textures.begin();
          it != textures.end(); ++it)
@@ -365,33 +402,79 @@ const DrawableRefSet &Scene::getDrawables()
 // We'll grab the lock and we're only expecting to be called in the rendering thread
 void Scene::processChanges(WhirlyKitView *view,WhirlyKitSceneRendererES *renderer,NSTimeInterval now)
 {
-    // We're not willing to wait in the rendering thread
+    // Only another call to this will hold the lock, never the threads adding changes
     if (!pthread_mutex_trylock(&changeRequestLock))
     {
-        // See if any of the timed changes are ready
-        std::vector<ChangeRequest *> toMove;
-        for (ChangeRequest *req : timedChangeRequests)
+        // Pick up everything added since last time.  Timed changes wait in the timer wheel.
+        // Anything added while we're doing this waits for the next frame.
+        std::vector<ChangeSet> newGroups;
+        changeQueue.popAvailable(newGroups);
+        for (ChangeSet &newGroup : newGroups)
         {
-            if (now >= req->when)
-                toMove.push_back(req);
-            else
-                break;
+            ChangeSet changeGroup;
+            changeGroup.reserve(newGroup.size());
+            for (ChangeRequest *req : newGroup)
+            {
+                if (req)
+                    changeStats[std::type_index(typeid(*req))].numPending++;
+                if (req && req->when > 0.0)
+                    timedChangeRequests.insert(req->when,req);
+                else
+                    changeGroup.push_back(req);
+            }
+            if (!changeGroup.empty())
+                changeRequests.push_back(changeGroup);
         }
-        for (ChangeRequest *req : toMove)
+        
+        // See if any of the timed changes are ready
+        std::vector<ChangeRequest *> dueChanges;
+        timedChangeRequests.advance(now,dueChanges);
+        for (ChangeRequest *req : dueChanges)
         {
-            timedChangeRequests.erase(req);
-            changeRequests.push_back(req);
+            req->queueTime = req->when;
+            changeRequests.push_back(ChangeSet(1,req));
         }
         
-        for (unsigned int ii=0;ii<changeRequests.size();ii++)
+        // Run whole groups in order until we're over budget, but always run at least one
+        NSTimeInterval startTime = CFAbsoluteTimeGetCurrent();
+        size_t bytesRun = 0;
+        bool firstGroup = true;
+        while (!changeRequests.empty())
         {
-            ChangeRequest *req = changeRequests[ii];
-            if (req) {
-                req->execute(this,renderer,view);
-                delete req;
+            if (!firstGroup)
+            {
+                if (changeByteBudget > 0 && bytesRun >= changeByteBudget)
+                    break;
+                if (changeTimeBudget > 0.0 && CFAbsoluteTimeGetCurrent() - startTime >= changeTimeBudget)
+                    break;
             }
+            firstGroup = false;
+            
+            ChangeSet &changeGroup = changeRequests.front();
+            for (ChangeRequest *req : changeGroup)
+            {
+                if (req) {
+                    std::type_index reqType(typeid(*req));
+                    ChangeStats &typeStats = changeStats[reqType];
+                    if (typeStats.spanID == EmptyTelemetryID)
+                        typeStats.spanID = Telemetry::registerSpan("Change: " + ChangeTypeName(reqType));
+                    NSTimeInterval latency = std::max(now - req->queueTime,0.0);
+                    typeStats.numPending--;
+                    typeStats.numRun++;
+                    typeStats.totalLatency += latency;
+                    typeStats.maxLatency = std::max(typeStats.maxLatency,latency);
+                    
+                    bytesRun += req->estimatedSize();
+                    {
+                        TelemetrySpan span(typeStats.spanID);
+                        req->execute(this,renderer,view);
+                    }
+                    delete req;
+                }
+            }
+            numPendingChanges.fetch_sub((int)changeGroup.size(),std::memory_order_relaxed);
+            changeRequests.pop_front();
         }
-        changeRequests.clear();
         
         pthread_mutex_unlock(&changeRequestLock);
     }
@@ -402,11 +485,7 @@ bool Scene::hasChanges(NSTimeInterval now)
     bool changes = false;
     if (!pthread_mutex_trylock(&changeRequestLock))
     {
-        changes = !changeRequests.empty();
-        
-        if (!changes)
-            if (timedChangeRequests.size() > 0)
-                changes = now >= (*timedChangeRequests.begin())->when;
+        changes = !changeRequests.empty() || !changeQueue.empty() || timedChangeRequests.hasDue(now);
         
         pthread_mutex_unlock(&changeRequestLock);            
     }        
@@ -479,7 +558,7 @@ void Scene::dumpStats()
     NSLog(@"Scene: %ld generators",generators.size());
     NSLog(@"Scene: %ld textures",textures.size());
     NSLog(@"Scene: %ld sub textures",subTextureMap.size());
-    cullTree->dumpStats();
+    NSLog(@"CullTree: %d nodes",cullTree->getCount());
     memManager.dumpStats();
     for (GeneratorSet::iterator it = generators.begin();
          it != generators.end(); ++it)
@@ -621,6 +700,16 @@ AddTextureReq::~AddTextureReq()
     tex = NULL;
 }
     
+size_t AddTextureReq::estimatedSize()
+{
+    // Already in OpenGL, so there's not much to it
+    Texture *fullTex = dynamic_cast<Texture *>(tex);
+    if (!fullTex || fullTex->getGLId())
+        return 0;
+    
+    return 4 * fullTex->getWidth() * fullTex->getHeight();
+}
+    
 void AddTextureReq::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view)
 {
     if (!tex->getGLId())
@@ -653,6 +742,16 @@ AddDrawableReq::~AddDrawableReq()
     drawable = NULL;
 }
 
+size_t AddDrawableReq::estimatedSize()
+{
+    BasicDrawable *basicDraw = dynamic_cast<BasicDrawable *>(drawable);
+    if (!basicDraw)
+        return 0;
+    
+    // Point, normal, texture coordinate and color, plus the triangles
+    return basicDraw->getNumPoints() * (3+3+2+1) * sizeof(GLfloat) + basicDraw->getNumTris() * 3 * sizeof(GLushort);
+}
+
 void AddDrawableReq::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view)
 {
     // If this is an instance, deal with that madness
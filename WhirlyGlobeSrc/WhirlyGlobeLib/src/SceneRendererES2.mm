@@ -33,6 +33,21 @@ using namespace WhirlyKit;
 namespace WhirlyKit
 {
 
+// Spans and counters for the stages of a frame.  These are always recorded,
+// the perfInterval just controls how often they're logged.
+static const TelemetryID RenderFrameSpan = Telemetry::registerSpan("Render Frame");
+static const TelemetryID RenderSetupSpan = Telemetry::registerSpan("Render Setup");
+static const TelemetryID SceneProcessingSpan = Telemetry::registerSpan("Scene processing");
+static const TelemetryID CullingSpan = Telemetry::registerSpan("Culling");
+static const TelemetryID GeneratorsSpan = Telemetry::registerSpan("Generators - generate");
+static const TelemetryID DrawExecutionSpan = Telemetry::registerSpan("Draw Execution");
+static const TelemetryID Draw2DSpan = Telemetry::registerSpan("Generators - Draw 2D");
+static const TelemetryID PresentSpan = Telemetry::registerSpan("Present Renderbuffer");
+static const TelemetryID SceneChangesCounter = Telemetry::registerCounter("Scene changes");
+static const TelemetryID DrawablesConsideredCounter = Telemetry::registerCounter("Drawables considered");
+static const TelemetryID CullablesCounter = Telemetry::registerCounter("Cullables");
+static const TelemetryID DrawablesDrawnCounter = Telemetry::registerCounter("Drawables drawn");
+
 // Keep track of a drawable and the MVP we're supposed to use with it
 class DrawableContainer
 {
@@ -326,11 +341,9 @@ static const float ScreenOverlap = 0.1;
     
     lastDraw = now;
         
-    if (perfInterval > 0)
-        perfTimer.startTiming("Render Frame");
+    perfTimer.startTiming(RenderFrameSpan);
     	
-    if (perfInterval > 0)
-        perfTimer.startTiming("Render Setup");
+    perfTimer.startTiming(RenderSetupSpan);
     
     EAGLContext *context = super.context;
     EAGLContext *oldContext = [EAGLContext currentContext];
@@ -414,8 +427,7 @@ static const float ScreenOverlap = 0.1;
         CheckGLError("SceneRendererES2: glEnable(GL_CULL_FACE)");
     }
     
-    if (perfInterval > 0)
-        perfTimer.stopTiming("Render Setup");
+    perfTimer.stopTiming(RenderSetupSpan);
     
 	if (scene)
 	{
@@ -473,8 +485,7 @@ static const float ScreenOverlap = 0.1;
             baseFrameInfo.heightAboveSurface = globeView.heightAboveSurface;
         baseFrameInfo.eyePos = Vector3d(eyeVec4d.x(),eyeVec4d.y(),eyeVec4d.z()) * (1.0+baseFrameInfo.heightAboveSurface);
 
-        if (perfInterval > 0)
-            perfTimer.startTiming("Scene processing");
+        perfTimer.startTiming(SceneProcessingSpan);
         
         // Let the active models to their thing
         // That thing had better not take too long
@@ -484,18 +495,15 @@ static const float ScreenOverlap = 0.1;
             // Sometimes this gets reset
             [EAGLContext setCurrentContext:context];
         }
-        if (perfInterval > 0)
-            perfTimer.addCount("Scene changes", (int)scene->changeRequests.size());
+        perfTimer.addCount(SceneChangesCounter, scene->getNumPendingChanges());
         
 		// Merge any outstanding changes into the scenegraph
 		// Or skip it if we don't acquire the lock
 		scene->processChanges(super.theView,self,now);
         
-        if (perfInterval > 0)
-            perfTimer.stopTiming("Scene processing");
+        perfTimer.stopTiming(SceneProcessingSpan);
         
-        if (perfInterval > 0)
-            perfTimer.startTiming("Culling");
+        perfTimer.startTiming(CullingSpan);
         
         // Calculate a good center point for the generated drawables
         CGPoint screenPt = CGPointMake(frameSize.x(), frameSize.y());
@@ -516,8 +524,15 @@ static const float ScreenOverlap = 0.1;
 		      
         // Work through the available offset matrices (only 1 if we're not wrapping)
         std::vector<Matrix4d> &offsetMats = baseFrameInfo.offsetMatrices;
-        // Turn these drawables in to a vector
+        // The scene keeps the drawables sorted, we just tell it what's visible
+        DrawList *sceneDrawList = scene->getDrawList();
+        sceneDrawList->startFrame();
+        bool sortAlphaToEnd = super.sortAlphaToEnd;
+        // Containers for what's visible in the order we found them
         std::vector<DrawableContainer> drawList;
+        // And the order to draw them in
+        std::vector<int> drawOrder;
+        std::vector<int> toDraw;
         std::vector<DrawableRef> screenDrawables;
         std::vector<DrawableRef> generatedDrawables;
         std::vector<Matrix4d> mvpMats;
@@ -551,21 +566,24 @@ static const float ScreenOverlap = 0.1;
             int cullTreeCount = 0;
             if (self.doCulling)
             {
-                std::set<DrawableRef> toDraw;
+                toDraw.clear();
                 CullTree *cullTree = scene->getCullTree();
                 // Recursively search for the drawables that overlap the screen
                 Mbr screenMbr;
                 // Stretch the screen MBR a little for safety
                 screenMbr.addPoint(Point2f(-ScreenOverlap*framebufferWidth,-ScreenOverlap*framebufferHeight));
                 screenMbr.addPoint(Point2f((1+ScreenOverlap)*framebufferWidth,(1+ScreenOverlap)*framebufferHeight));
-                [self findDrawables:cullTree->getTopCullable() view:globeView frameSize:Point2f(framebufferWidth,framebufferHeight) modelTrans:&modelTrans4d eyeVec:eyeVec3 frameInfo:offFrameInfo screenMbr:screenMbr topLevel:true toDraw:&toDraw considered:&drawablesConsidered];
+                [self findDrawables:cullTree view:globeView frameSize:Point2f(framebufferWidth,framebufferHeight) modelTrans:&modelTrans4d eyeVec:eyeVec3 screenMbr:screenMbr toDraw:&toDraw considered:&drawablesConsidered];
                 
-                //		drawList.reserve(toDraw.size());
-                for (std::set<DrawableRef>::iterator it = toDraw.begin();
-                     it != toDraw.end(); ++it)
+                for (unsigned int ii=0;ii<toDraw.size();ii++)
                 {
-                    Drawable *theDrawable = it->get();
-                    if (theDrawable)
+                    int slot = toDraw[ii];
+                    Drawable *theDrawable = sceneDrawList->getDrawable(slot);
+                    if (!theDrawable || !theDrawable->isOn(offFrameInfo))
+                        continue;
+                    bool drawAlpha = sortAlphaToEnd && theDrawable->hasAlpha(baseFrameInfo);
+                    // Drawables can show up more than once from the cull tree, the draw list sorts that out
+                    if (sceneDrawList->addVisible(slot,off,theDrawable->getDrawListKey(),drawAlpha,(int)drawList.size()))
                     {
                         const Matrix4d *localMat = theDrawable->getMatrix();
                         if (localMat)
@@ -576,16 +594,17 @@ static const float ScreenOverlap = 0.1;
                             drawList.push_back(DrawableContainer(theDrawable,newMvpMat,newMvMat,newMvNormalMat));
                         } else
                             drawList.push_back(DrawableContainer(theDrawable,thisMvpMat,modelAndViewMat4d,modelAndViewNormalMat4d));
-                    } else
-                        NSLog(@"Bad drawable coming from cull tree.");
+                    }
                 }
                 cullTreeCount = cullTree->getCount();
             } else {
-                DrawableRefSet rawDrawables = scene->getDrawables();
-                for (DrawableRefSet::iterator it = rawDrawables.begin(); it != rawDrawables.end(); ++it)
+                const DrawableRefSet &rawDrawables = scene->getDrawables();
+                for (DrawableRefSet::const_iterator it = rawDrawables.begin(); it != rawDrawables.end(); ++it)
                 {
                     Drawable *theDrawable = it->get();
-                    if (theDrawable->isOn(offFrameInfo))
+                    bool drawAlpha = sortAlphaToEnd && theDrawable->hasAlpha(baseFrameInfo);
+                    if (theDrawable->isOn(offFrameInfo) &&
+                        sceneDrawList->addVisible(theDrawable->getDrawListSlot(),off,theDrawable->getDrawListKey(),drawAlpha,(int)drawList.size()))
                     {
                         const Matrix4d *localMat = theDrawable->getMatrix();
                         if (localMat)
@@ -601,11 +620,9 @@ static const float ScreenOverlap = 0.1;
             }
             
             
-            if (perfInterval > 0)
-                perfTimer.stopTiming("Culling");
+            perfTimer.stopTiming(CullingSpan);
             
-            if (perfInterval > 0)
-                perfTimer.startTiming("Generators - generate");
+            perfTimer.startTiming(GeneratorsSpan);
 
             // Run the generators only once, they have to be aware of multiple offset matrices
             if (off == offsetMats.size()-1)
@@ -618,36 +635,36 @@ static const float ScreenOverlap = 0.1;
                      it != generators->end(); ++it)
                     (*it)->generateDrawables(baseFrameInfo, generatedDrawables, screenDrawables);
                 
-                // Add the generated drawables and sort them all together
+                // Add the generated drawables for just this frame
                 for (unsigned int ii=0;ii<generatedDrawables.size();ii++)
                 {
                     Drawable *theDrawable = generatedDrawables[ii].get();
                     if (theDrawable)
+                    {
+                        bool drawAlpha = sortAlphaToEnd && theDrawable->hasAlpha(baseFrameInfo);
+                        sceneDrawList->addExtra(theDrawable->getDrawListKey(),drawAlpha,(int)drawList.size());
                         drawList.push_back(DrawableContainer(theDrawable,thisMvpMat,modelAndViewMat4d,modelAndViewNormalMat4d));
+                    }
                 }
-                bool sortLinesToEnd = (super.zBufferMode == zBufferOffDefault);
-                std::sort(drawList.begin(),drawList.end(),DrawListSortStruct2(super.sortAlphaToEnd,sortLinesToEnd,baseFrameInfo));
+                
+                // Everything comes out sorted by priority (and z buffer) with alpha optionally at the end
+                sceneDrawList->getDrawOrder(sortAlphaToEnd,drawOrder);
             }
             
-            if (perfInterval > 0)
-            {
-                perfTimer.addCount("Drawables considered", drawablesConsidered);
-                perfTimer.addCount("Cullables", cullTreeCount);
-            }
+            perfTimer.addCount(DrawablesConsideredCounter, drawablesConsidered);
+            perfTimer.addCount(CullablesCounter, cullTreeCount);
             
-            if (perfInterval > 0)
-                perfTimer.stopTiming("Generators - generate");
+            perfTimer.stopTiming(GeneratorsSpan);
         }
 
-        if (perfInterval > 0)
-        perfTimer.startTiming("Draw Execution");
+        perfTimer.startTiming(DrawExecutionSpan);
         
         SimpleIdentity curProgramId = EmptyIdentity;
         
         bool depthMaskOn = (super.zBufferMode == zBufferOn);
-        for (unsigned int ii=0;ii<drawList.size();ii++)
+        for (unsigned int ii=0;ii<drawOrder.size();ii++)
         {
-            DrawableContainer &drawContain = drawList[ii];
+            DrawableContainer &drawContain = drawList[drawOrder[ii]];
             
             // The first time we hit an explicitly alpha drawable
             //  turn off the depth buffer
@@ -733,18 +750,15 @@ static const float ScreenOverlap = 0.1;
             }
         }
         
-        if (perfInterval > 0)
-        perfTimer.addCount("Drawables drawn", numDrawables);
+        perfTimer.addCount(DrawablesDrawnCounter, numDrawables);
         
-        if (perfInterval > 0)
-        perfTimer.stopTiming("Draw Execution");
+        perfTimer.stopTiming(DrawExecutionSpan);
         
         // Anything generated needs to be cleaned up
         generatedDrawables.clear();
         drawList.clear();
         
-        if (perfInterval > 0)
-        perfTimer.startTiming("Generators - Draw 2D");
+        perfTimer.startTiming(Draw2DSpan);
         
         // Now for the 2D display
         if (!screenDrawables.empty())
@@ -811,8 +825,7 @@ static const float ScreenOverlap = 0.1;
         }
     }
 
-    if (perfInterval > 0)
-        perfTimer.stopTiming("Generators - Draw 2D");
+    perfTimer.stopTiming(Draw2DSpan);
 
 //    if (perfInterval > 0)
 //        perfTimer.startTiming("glFinish");
@@ -823,8 +836,7 @@ static const float ScreenOverlap = 0.1;
 //    if (perfInterval > 0)
 //        perfTimer.stopTiming("glFinish");
 
-    if (perfInterval > 0)
-        perfTimer.startTiming("Present Renderbuffer");
+    perfTimer.startTiming(PresentSpan);
 
     // Explicitly discard the depth buffer
     const GLenum discards[]  = {GL_DEPTH_ATTACHMENT};
@@ -899,11 +911,9 @@ static const float ScreenOverlap = 0.1;
     [context presentRenderbuffer:GL_RENDERBUFFER];
     CheckGLError("SceneRendererES2: presentRenderbuffer");
     
-    if (perfInterval > 0)
-        perfTimer.stopTiming("Present Renderbuffer");
+    perfTimer.stopTiming(PresentSpan);
     
-    if (perfInterval > 0)
-        perfTimer.stopTiming("Render Frame");
+    perfTimer.stopTiming(RenderFrameSpan);
     
 	// Update the frames per sec
 	if (super.perfInterval > 0 && frameCount > perfInterval)
@@ -918,6 +928,8 @@ static const float ScreenOverlap = 0.1;
         NSLog(@" Frames per sec = %.2f",super.framesPerSec);
         perfTimer.log();
         perfTimer.clear();
+        NSLog(@"---Telemetry---");
+        Telemetry::log();
 	}
     
     if (oldContext != context)
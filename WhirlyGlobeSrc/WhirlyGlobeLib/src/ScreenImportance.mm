@@ -524,4 +524,52 @@ double ScreenImportance(WhirlyKitViewState *viewState,WhirlyKit::Point2f frameSi
     return import;
 }
     
+// Tiles each worker scores at once
+static const int ImportanceChunkSize = 64;
+
+void ScreenImportance(WhirlyKitViewState *viewState,WhirlyKit::Point2f frameSize,int pixelsSquare,WhirlyKit::CoordSystem *srcSystem,WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,std::vector<WhirlyKit::Quadtree::ImportanceRequest> &requests)
+{
+    if (requests.empty())
+        return;
+    
+    // Make any missing display solids here, since the attributes aren't thread safe
+    std::vector<WhirlyKitDisplaySolid *> dispSolids(requests.size(),nil);
+    for (unsigned int ii=0;ii<requests.size();ii++)
+    {
+        Quadtree::ImportanceRequest &request = requests[ii];
+        WhirlyKitDisplaySolid *dispSolid = request.attrs[@"DisplaySolid"];
+        if (!dispSolid)
+        {
+            dispSolid = [WhirlyKitDisplaySolid displaySolidWithNodeIdent:request.ident mbr:request.mbr minZ:0.0 maxZ:0.0 srcSystem:srcSystem adapter:coordAdapter];
+            if (!dispSolid)
+                dispSolid = (WhirlyKitDisplaySolid *)[NSNull null];
+            request.attrs[@"DisplaySolid"] = dispSolid;
+        }
+        
+        // Degenerate tiles are left as nil
+        if (![dispSolid isKindOfClass:[NSNull class]])
+            dispSolids[ii] = dispSolid;
+    }
+    
+    // Then do the actual math in parallel.  It only reads the view state and solids.
+    Quadtree::ImportanceRequest *theRequests = &requests[0];
+    std::vector<WhirlyKitDisplaySolid *> *theSolids = &dispSolids;
+    double pixelArea = pixelsSquare * pixelsSquare;
+    size_t numRequests = requests.size();
+    void (^scoreChunk)(size_t) = ^(size_t chunk)
+    {
+        size_t end = std::min(numRequests,(chunk+1)*ImportanceChunkSize);
+        for (size_t ii=chunk*ImportanceChunkSize;ii<end;ii++)
+        {
+            WhirlyKitDisplaySolid *dispSolid = (*theSolids)[ii];
+            theRequests[ii].importance = dispSolid ? [dispSolid importanceForViewState:viewState frameSize:frameSize] / pixelArea : 0.0;
+        }
+    };
+    size_t numChunks = (numRequests + ImportanceChunkSize - 1) / ImportanceChunkSize;
+    if (numChunks > 1)
+        dispatch_apply(numChunks, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), scoreChunk);
+    else
+        scoreChunk(0);
+}
+    
 }
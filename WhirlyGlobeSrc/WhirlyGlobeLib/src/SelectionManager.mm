@@ -70,7 +70,7 @@ bool BillboardSelectable::operator < (const BillboardSelectable &that) const
 }
 
 SelectionManager::SelectionManager(Scene *scene,float viewScale)
-    : scene(scene), scale(viewScale)
+    : scene(scene), scale(viewScale), screenGeneration(0)
 {
     pthread_mutex_init(&mutex,NULL);
 }
@@ -80,6 +80,59 @@ SelectionManager::~SelectionManager()
     pthread_mutex_destroy(&mutex);
 }
 
+// Note: Call with the mutex held
+void SelectionManager::addToIndex(IndexType type,SimpleIdentity selectID,const Point3d &ll,const Point3d &ur)
+{
+    IndexEntry entry(type,selectID);
+    if (selectIndexHandles.find(entry) != selectIndexHandles.end())
+        return;
+    selectIndexHandles[entry] = selectIndex.insert(ll,ur,entry);
+}
+
+// Note: Call with the mutex held
+void SelectionManager::removeFromIndex(SimpleIdentity selectID)
+{
+    for (int type=0;type<IndexTypeMax;type++)
+    {
+        auto it = selectIndexHandles.find(IndexEntry((IndexType)type,selectID));
+        if (it != selectIndexHandles.end())
+        {
+            selectIndex.remove(it->second);
+            selectIndexHandles.erase(it);
+        }
+    }
+}
+
+// Bounding box of a bunch of points
+template<typename PointType>
+static void CalcBounds(const PointType *pts,int numPts,const Point3d &offset,Point3d &ll,Point3d &ur)
+{
+    ll = Point3d(MAXFLOAT,MAXFLOAT,MAXFLOAT);
+    ur = Point3d(-MAXFLOAT,-MAXFLOAT,-MAXFLOAT);
+    for (int ii=0;ii<numPts;ii++)
+    {
+        Point3d pt(pts[ii].x()+offset.x(),pts[ii].y()+offset.y(),pts[ii].z()+offset.z());
+        ll = ll.cwiseMin(pt);
+        ur = ur.cwiseMax(pt);
+    }
+}
+
+// Bounding box of a polytope
+static void CalcPolytopeBounds(const PolytopeSelectable &sel,Point3d &ll,Point3d &ur)
+{
+    ll = Point3d(MAXFLOAT,MAXFLOAT,MAXFLOAT);
+    ur = Point3d(-MAXFLOAT,-MAXFLOAT,-MAXFLOAT);
+    for (const std::vector<Point3f> &poly : sel.polys)
+    {
+        if (poly.empty())
+            continue;
+        Point3d polyLL,polyUR;
+        CalcBounds(&poly[0],(int)poly.size(),sel.centerPt,polyLL,polyUR);
+        ll = ll.cwiseMin(polyLL);
+        ur = ur.cwiseMax(polyUR);
+    }
+}
+
 // Add a rectangle (in 3-space) available for selection
 void SelectionManager::addSelectableRect(SimpleIdentity selectId,Point3f *pts,bool enable)
 {
@@ -94,8 +147,12 @@ void SelectionManager::addSelectableRect(SimpleIdentity selectId,Point3f *pts,bo
     for (unsigned int ii=0;ii<4;ii++)
         newSelect.pts[ii] = pts[ii];
 
+    Point3d ll,ur;
+    CalcBounds(pts,4,Point3d(0,0,0),ll,ur);
+
     pthread_mutex_lock(&mutex);
-    rect3Dselectables.insert(newSelect);
+    if (rect3Dselectables.insert(newSelect).second)
+        addToIndex(IndexRect3D,selectId,ll,ur);
     pthread_mutex_unlock(&mutex);
 }
 
@@ -113,8 +170,12 @@ void SelectionManager::addSelectableRect(SimpleIdentity selectId,Point3f *pts,fl
     for (unsigned int ii=0;ii<4;ii++)
         newSelect.pts[ii] = pts[ii];
     
+    Point3d ll,ur;
+    CalcBounds(pts,4,Point3d(0,0,0),ll,ur);
+
     pthread_mutex_lock(&mutex);
-    rect3Dselectables.insert(newSelect);
+    if (rect3Dselectables.insert(newSelect).second)
+        addToIndex(IndexRect3D,selectId,ll,ur);
     pthread_mutex_unlock(&mutex);
 }
 
@@ -135,6 +196,7 @@ void SelectionManager::addSelectableScreenRect(SimpleIdentity selectId,const Poi
     
     pthread_mutex_lock(&mutex);
     rect2Dselectables.insert(newSelect);
+    screenGeneration++;
     pthread_mutex_unlock(&mutex);
 }
 
@@ -192,8 +254,12 @@ void SelectionManager::addSelectableRectSolid(SimpleIdentity selectId,Point3f *p
         newSelect.polys.push_back(poly);
     }
     
+    Point3d ll,ur;
+    CalcPolytopeBounds(newSelect,ll,ur);
+    
     pthread_mutex_lock(&mutex);
-    polytopeSelectables.insert(newSelect);
+    if (polytopeSelectables.insert(newSelect).second)
+        addToIndex(IndexPolytope,selectId,ll,ur);
     pthread_mutex_unlock(&mutex);
 }
 
@@ -237,8 +303,12 @@ void SelectionManager::addPolytope(SimpleIdentity selectId,const std::vector<std
         newSelect.polys.push_back(surface3f);
     }
     
+    Point3d ll,ur;
+    CalcPolytopeBounds(newSelect,ll,ur);
+    
     pthread_mutex_lock(&mutex);
-    polytopeSelectables.insert(newSelect);
+    if (polytopeSelectables.insert(newSelect).second)
+        addToIndex(IndexPolytope,selectId,ll,ur);
     pthread_mutex_unlock(&mutex);
 }
 
@@ -369,8 +439,12 @@ void SelectionManager::addSelectableLinear(SimpleIdentity selectId,const std::ve
         newSelect.pts[ii] = Point3d(pt.x(),pt.y(),pt.z());
     }
 
+    Point3d ll,ur;
+    CalcBounds(newSelect.pts.data(),(int)newSelect.pts.size(),Point3d(0,0,0),ll,ur);
+
     pthread_mutex_lock(&mutex);
-    linearSelectables.insert(newSelect);
+    if (linearSelectables.insert(newSelect).second)
+        addToIndex(IndexLinear,selectId,ll,ur);
     pthread_mutex_unlock(&mutex);
 }
 
@@ -389,8 +463,13 @@ void SelectionManager::addSelectableBillboard(SimpleIdentity selectId,const Poin
     newSelect.minVis = minVis;
     newSelect.maxVis = maxVis;
     
+    // The billboard turns to face the viewer, so allow for any direction
+    double radius = size.x()/2.0 + size.y();
+    Point3d ll = center - Point3d(radius,radius,radius), ur = center + Point3d(radius,radius,radius);
+    
     pthread_mutex_lock(&mutex);
-    billboardSelectables.insert(newSelect);
+    if (billboardSelectables.insert(newSelect).second)
+        addToIndex(IndexBillboard,selectId,ll,ur);
     pthread_mutex_unlock(&mutex);
 }
 
@@ -462,6 +541,8 @@ void SelectionManager::enableSelectable(SimpleIdentity selectID,bool enable)
         billboardSelectables.insert(sel);
     }
     
+    screenGeneration++;
+    
     pthread_mutex_unlock(&mutex);
 }
 
@@ -537,6 +618,8 @@ void SelectionManager::enableSelectables(const SimpleIDSet &selectIDs,bool enabl
         }
     }
     
+    screenGeneration++;
+    
     pthread_mutex_unlock(&mutex);
 }
 
@@ -574,6 +657,9 @@ void SelectionManager::removeSelectable(SimpleIdentity selectID)
     if (it4 != billboardSelectables.end())
         billboardSelectables.erase(it4);
 
+    removeFromIndex(selectID);
+    screenGeneration++;
+
     pthread_mutex_unlock(&mutex);
 }
 
@@ -585,6 +671,7 @@ void SelectionManager::removeSelectables(const SimpleIDSet &selectIDs)
     for (SimpleIDSet::iterator sit = selectIDs.begin(); sit != selectIDs.end(); ++sit)
     {
         SimpleIdentity selectID = *sit;
+        removeFromIndex(selectID);
         RectSelectable3DSet::iterator it = rect3Dselectables.find(RectSelectable3D(selectID));
         
         if (it != rect3Dselectables.end())
@@ -639,10 +726,11 @@ void SelectionManager::removeSelectables(const SimpleIDSet &selectIDs)
 //    if (!found)
 //        NSLog(@"Tried to delete selectable that doesn't exist.");
     
+    screenGeneration++;
     pthread_mutex_unlock(&mutex);
 }
 
-void SelectionManager::getScreenSpaceObjects(const PlacementInfo &pInfo,std::vector<ScreenSpaceObjectLocation> &screenPts,NSTimeInterval now)
+void SelectionManager::getScreenSpaceObjects(const PlacementInfo &pInfo,std::vector<ScreenSpaceObjectLocation> &screenPts)
 {
     for (RectSelectable2DSet::iterator it = rect2Dselectables.begin();
          it != rect2Dselectables.end(); ++it)
@@ -667,7 +755,10 @@ void SelectionManager::getScreenSpaceObjects(const PlacementInfo &pInfo,std::vec
             }
         }
     }
+}
 
+void SelectionManager::getMovingScreenSpaceObjects(const PlacementInfo &pInfo,std::vector<ScreenSpaceObjectLocation> &screenPts,NSTimeInterval now)
+{
     for (MovingRectSelectable2DSet::iterator it = movingRect2Dselectables.begin();
          it != movingRect2Dselectables.end(); ++it)
     {
@@ -838,6 +929,141 @@ Matrix2d SelectionManager::calcScreenRot(float &screenRot,WhirlyKitViewState *vi
     return screenRotMat;
 }
 
+// Check one screen space object at each place it was projected to
+void SelectionManager::pickScreenSpaceObject(Point2f touchPt,float maxDist2,ScreenSpaceObjectLocation &screenObj,const std::vector<Point2d> &projPts,const PlacementInfo &pInfo,const Matrix4d &modelTrans,const Matrix4d &normalMat,const Point2f &frameBufferSize,std::vector<SelectedObject> &selObjs)
+{
+    float closeDist2 = MAXFLOAT;
+    // Work through the possible locations of the projected point
+    for (unsigned int jj=0;jj<projPts.size();jj++)
+    {
+        Point2d projPt = projPts[jj];
+        Mbr objMbr = screenObj.mbr;
+        objMbr.ll() += Point2f(projPt.x(),projPt.y());
+        objMbr.ur() += Point2f(projPt.x(),projPt.y());
+        
+        // Make sure it's on the screen at least
+        if (!pInfo.frameMbr.overlaps(objMbr))
+            continue;
+        
+        if (!screenObj.shapeIDs.empty())
+        {
+            Matrix2d screenRotMat;
+            float screenRot = 0.0;
+            CGPoint objPt;
+            objPt.x = projPt.x();  objPt.y = projPt.y();
+            if (screenObj.rotation != 0.0)
+                screenRotMat = calcScreenRot(screenRot,pInfo.viewState,pInfo.globeViewState,&screenObj,objPt,modelTrans,normalMat,frameBufferSize);
+
+            std::vector<Point2f> screenPts;
+            if (screenRot == 0.0)
+            {
+                for (unsigned int kk=0;kk<screenObj.pts.size();kk++)
+                {
+                    const Point2d &screenObjPt = screenObj.pts[kk];
+                    Point2d theScreenPt = Point2d(screenObjPt.x(),-screenObjPt.y()) + projPt + Point2d(screenObj.offset.x(),-screenObj.offset.y());
+                    screenPts.push_back(Point2f(theScreenPt.x(),theScreenPt.y()));
+                }
+            } else {
+                Point2d center(objPt.x,objPt.y);
+                for (unsigned int kk=0;kk<screenObj.pts.size();kk++)
+                {
+                    const Point2d screenObjPt = screenRotMat * (screenObj.pts[kk] + Point2d(screenObj.offset.x(),screenObj.offset.y()));
+                    Point2d theScreenPt = Point2d(screenObjPt.x(),-screenObjPt.y()) + projPt;
+                    screenPts.push_back(Point2f(theScreenPt.x(),theScreenPt.y()));
+                }
+            }
+            
+            // Note: Debugging
+//            {
+//                NSMutableString *str = [NSMutableString string];
+//                [str appendFormat:@"Selectable object %d pts: ",screenPts.size()];
+//                for (auto pt : screenPts)
+//                    [str appendFormat:@" [%d,%d]",(int)(pt.x()),(int)(pt.y())];
+//                NSLog(@"%@",str);
+//            }
+
+            
+            // See if we fall within that polygon
+            if (PointInPolygon(touchPt, screenPts))
+            {
+                for (auto shapeID : screenObj.shapeIDs)
+                {
+                    SelectedObject selObj(shapeID,0.0,0.0);
+                    selObj.isCluster = screenObj.isCluster;
+                    selObjs.push_back(selObj);
+                }
+                break;
+            }
+            
+            // Now for a proximity check around the edges
+            for (unsigned int ii=0;ii<screenObj.pts.size();ii++)
+            {
+                float t;
+                Point2f closePt = ClosestPointOnLineSegment(screenPts[ii],screenPts[(ii+1)%4],touchPt,t);
+                float dist2 = (closePt-touchPt).squaredNorm();
+                closeDist2 = std::min(dist2,closeDist2);
+            }
+        }
+    }
+    // Got close enough to this object to select it
+    if (closeDist2 < maxDist2)
+    {
+        for (auto shapeID : screenObj.shapeIDs)
+        {
+            SelectedObject selObj(shapeID,0.0,sqrtf(closeDist2));
+            selObj.isCluster = screenObj.isCluster;
+            selObjs.push_back(selObj);
+        }
+    }
+}
+
+// Project the screen space objects and put them in a grid, unless we already did for this view
+void SelectionManager::updateScreenSpaceCache(const PlacementInfo &pInfo,LayoutManager *layoutManager)
+{
+    unsigned int layoutGeneration = layoutManager ? layoutManager->getGeneration() : 0;
+    if (screenCache.valid && screenCache.generation == screenGeneration && screenCache.layoutGeneration == layoutGeneration &&
+        screenCache.heightAboveSurface == pInfo.heightAboveSurface && screenCache.frameSize == pInfo.frameSize &&
+        screenCache.viewMat == pInfo.viewMat && screenCache.modelMat == pInfo.modelMat && screenCache.projMat == pInfo.projMat)
+        return;
+    
+    screenCache.valid = true;
+    screenCache.generation = screenGeneration;
+    screenCache.layoutGeneration = layoutGeneration;
+    screenCache.heightAboveSurface = pInfo.heightAboveSurface;
+    screenCache.frameSize = pInfo.frameSize;
+    screenCache.viewMat = pInfo.viewMat;
+    screenCache.modelMat = pInfo.modelMat;
+    screenCache.projMat = pInfo.projMat;
+    
+    screenCache.objs.clear();
+    getScreenSpaceObjects(pInfo,screenCache.objs);
+    if (layoutManager)
+        layoutManager->getScreenSpaceObjects(pInfo,screenCache.objs);
+    
+    // Size the cells so there's about one object in each, within reason
+    int numObjs = (int)screenCache.objs.size();
+    Point2d frameSize(pInfo.frameSizeScale.x(),pInfo.frameSizeScale.y());
+    Point2d gridLL = -0.25 * frameSize, gridUR = 1.25 * frameSize;
+    double cellSize = sqrt((gridUR.x()-gridLL.x()) * (gridUR.y()-gridLL.y()) / std::max(numObjs,1));
+    screenCache.grid.reset(gridLL,gridUR,std::max(cellSize,16.0));
+    
+    screenCache.projPts.resize(numObjs);
+    for (int ii=0;ii<numObjs;ii++)
+    {
+        const ScreenSpaceObjectLocation &screenObj = screenCache.objs[ii];
+        std::vector<Point2d> &projPts = screenCache.projPts[ii];
+        projPts.clear();
+        projectWorldPointToScreen(screenObj.dispLoc, pInfo, projPts, scale);
+        
+        // The object can rotate around its location, so use the furthest point
+        double radius = 0.0;
+        for (const Point2d &pt : screenObj.pts)
+            radius = std::max(radius,(pt + screenObj.offset).norm());
+        for (const Point2d &projPt : projPts)
+            screenCache.grid.add(ii,projPt - Point2d(radius,radius),projPt + Point2d(radius,radius));
+    }
+}
+
 /// Pass in the screen point where the user touched.  This returns the closest hit within the given distance
 // Note: Should switch to a view state, rather than a view
 void SelectionManager::pickObjects(Point2f touchPt,float maxDist,WhirlyKitView *theView,bool multi,std::vector<SelectedObject> &selObjs)
@@ -867,104 +1093,32 @@ void SelectionManager::pickObjects(Point2f touchPt,float maxDist,WhirlyKitView *
     
     pthread_mutex_lock(&mutex);
 
-    // Figure out where the screen space objects are, both layout manager
-    //  controlled and other
-    std::vector<ScreenSpaceObjectLocation> ssObjs;
-    getScreenSpaceObjects(pInfo,ssObjs,now);
-    if (layoutManager)
-        layoutManager->getScreenSpaceObjects(pInfo,ssObjs);
+    // The screen space objects that hold still are projected once per view.
+    // Then we only need to look at the ones in the grid cells near the touch.
+    updateScreenSpaceCache(pInfo,layoutManager);
+    std::vector<int> nearbyObjs;
+    screenCache.grid.query(Point2d(touchPt.x()-maxDist,touchPt.y()-maxDist),Point2d(touchPt.x()+maxDist,touchPt.y()+maxDist),nearbyObjs);
+    for (int which : nearbyObjs)
+    {
+        pickScreenSpaceObject(touchPt,maxDist2,screenCache.objs[which],screenCache.projPts[which],pInfo,modelTrans,normalMat,frameBufferSize,selObjs);
+
+        if (!multi && !selObjs.empty())
+        {
+            pthread_mutex_unlock(&mutex);
+            return;
+        }
+    }
     
-    // Work through the 2D rectangles
+    // The moving ones are somewhere new every time
+    std::vector<ScreenSpaceObjectLocation> ssObjs;
+    getMovingScreenSpaceObjects(pInfo,ssObjs,now);
     for (unsigned int ii=0;ii<ssObjs.size();ii++)
     {
         ScreenSpaceObjectLocation &screenObj = ssObjs[ii];
         
         std::vector<Point2d> projPts;
         projectWorldPointToScreen(screenObj.dispLoc, pInfo, projPts,scale);
-        
-        float closeDist2 = MAXFLOAT;
-        // Work through the possible locations of the projected point
-        for (unsigned int jj=0;jj<projPts.size();jj++)
-        {
-            Point2d projPt = projPts[jj];
-            Mbr objMbr = screenObj.mbr;
-            objMbr.ll() += Point2f(projPt.x(),projPt.y());
-            objMbr.ur() += Point2f(projPt.x(),projPt.y());
-            
-            // Make sure it's on the screen at least
-            if (!pInfo.frameMbr.overlaps(objMbr))
-                continue;
-            
-            if (!screenObj.shapeIDs.empty())
-            {
-                Matrix2d screenRotMat;
-                float screenRot = 0.0;
-                CGPoint objPt;
-                objPt.x = projPt.x();  objPt.y = projPt.y();
-                if (screenObj.rotation != 0.0)
-                    screenRotMat = calcScreenRot(screenRot,pInfo.viewState,pInfo.globeViewState,&screenObj,objPt,modelTrans,normalMat,frameBufferSize);
-
-                std::vector<Point2f> screenPts;
-                if (screenRot == 0.0)
-                {
-                    for (unsigned int kk=0;kk<screenObj.pts.size();kk++)
-                    {
-                        const Point2d &screenObjPt = screenObj.pts[kk];
-                        Point2d theScreenPt = Point2d(screenObjPt.x(),-screenObjPt.y()) + projPt + Point2d(screenObj.offset.x(),-screenObj.offset.y());
-                        screenPts.push_back(Point2f(theScreenPt.x(),theScreenPt.y()));
-                    }
-                } else {
-                    Point2d center(objPt.x,objPt.y);
-                    for (unsigned int kk=0;kk<screenObj.pts.size();kk++)
-                    {
-                        const Point2d screenObjPt = screenRotMat * (screenObj.pts[kk] + Point2d(screenObj.offset.x(),screenObj.offset.y()));
-                        Point2d theScreenPt = Point2d(screenObjPt.x(),-screenObjPt.y()) + projPt;
-                        screenPts.push_back(Point2f(theScreenPt.x(),theScreenPt.y()));
-                    }
-                }
-                
-                // Note: Debugging
-//                {
-//                    NSMutableString *str = [NSMutableString string];
-//                    [str appendFormat:@"Selectable object %d pts: ",screenPts.size()];
-//                    for (auto pt : screenPts)
-//                        [str appendFormat:@" [%d,%d]",(int)(pt.x()),(int)(pt.y())];
-//                    NSLog(@"%@",str);
-//                }
-
-                
-                // See if we fall within that polygon
-                if (PointInPolygon(touchPt, screenPts))
-                {
-                    for (auto shapeID : screenObj.shapeIDs)
-                    {
-                        SelectedObject selObj(shapeID,0.0,0.0);
-                        selObj.isCluster = screenObj.isCluster;
-                        selObjs.push_back(selObj);
-                    }
-                    break;
-                }
-                
-                // Now for a proximity check around the edges
-                for (unsigned int ii=0;ii<screenObj.pts.size();ii++)
-                {
-                    float t;
-                    Point2f closePt = ClosestPointOnLineSegment(screenPts[ii],screenPts[(ii+1)%4],touchPt,t);
-                    float dist2 = (closePt-touchPt).squaredNorm();
-                    closeDist2 = std::min(dist2,closeDist2);
-                }
-            }
-        }
-        // Got close enough to this object to select it
-        if (closeDist2 < maxDist2)
-        {
-            for (auto shapeID : screenObj.shapeIDs)
-            {
-                SelectedObject selObj(shapeID,0.0,sqrtf(closeDist2));
-                selObj.isCluster = screenObj.isCluster;
-                selObjs.push_back(selObj);
-            }
-        }
+        pickScreenSpaceObject(touchPt,maxDist2,screenObj,projPts,pInfo,modelTrans,normalMat,frameBufferSize,selObjs);
         
         if (!multi && !selObjs.empty())
         {
@@ -978,14 +1132,34 @@ void SelectionManager::pickObjects(Point2f touchPt,float maxDist,WhirlyKitView *
         eyePos = pInfo.globeView.eyePos;
     else
         eyePos = pInfo.mapView.eyePos;
+    
+    // Only the world space objects inside the part of the view around the touch are worth projecting.
+    // Look them up in the index once for each copy of the world (if the map wraps).
+    std::vector<SimpleIdentity> nearbyIDs[IndexTypeMax];
+    Point2d frameSizeScale(pInfo.frameSizeScale.x(),pInfo.frameSizeScale.y());
+    for (const Matrix4d &offMat : pInfo.offsetMatrices)
+    {
+        PickFrustum pickFrustum(pInfo.projMat * pInfo.viewMat * offMat * pInfo.modelMat,frameSizeScale,
+                                Point2d(touchPt.x()-maxDist,touchPt.y()-maxDist),Point2d(touchPt.x()+maxDist,touchPt.y()+maxDist));
+        selectIndex.query([&pickFrustum](const Point3d &ll,const Point3d &ur) { return pickFrustum.overlaps(ll,ur); },
+                          [&nearbyIDs](const IndexEntry &entry) { nearbyIDs[entry.type].push_back(entry.selectID); });
+    }
+    // Go in the same order as the sets
+    for (unsigned int ii=0;ii<IndexTypeMax;ii++)
+    {
+        std::sort(nearbyIDs[ii].begin(),nearbyIDs[ii].end());
+        nearbyIDs[ii].erase(std::unique(nearbyIDs[ii].begin(),nearbyIDs[ii].end()),nearbyIDs[ii].end());
+    }
 
     if (!polytopeSelectables.empty())
     {
         // Work through the axis aligned rectangular solids
-        for (PolytopeSelectableSet::iterator it = polytopeSelectables.begin();
-             it != polytopeSelectables.end(); ++it)
+        for (SimpleIdentity selectID : nearbyIDs[IndexPolytope])
         {
-            PolytopeSelectable sel = *it;
+            PolytopeSelectableSet::iterator it = polytopeSelectables.find(PolytopeSelectable(selectID));
+            if (it == polytopeSelectables.end())
+                continue;
+            const PolytopeSelectable &sel = *it;
             if (sel.selectID != EmptyIdentity && sel.enable)
             {
                 if (sel.minVis == DrawVisibleInvalid ||
@@ -995,12 +1169,12 @@ void SelectionManager::pickObjects(Point2f touchPt,float maxDist,WhirlyKitView *
                     // Project each plane to the screen, including clipping
                     for (unsigned int ii=0;ii<sel.polys.size();ii++)
                     {
-                        std::vector<Point3f> &poly3f = sel.polys[ii];
+                        const std::vector<Point3f> &poly3f = sel.polys[ii];
                         std::vector<Point3d> poly;
                         poly.reserve(poly3f.size());
                         for (unsigned int jj=0;jj<poly3f.size();jj++)
                         {
-                            Point3f &pt = poly3f[jj];
+                            const Point3f &pt = poly3f[jj];
                             poly.push_back(Point3d(pt.x()+sel.centerPt.x(),pt.y()+sel.centerPt.y(),pt.z()+sel.centerPt.z()));
                         }
                         
@@ -1099,10 +1273,12 @@ void SelectionManager::pickObjects(Point2f touchPt,float maxDist,WhirlyKitView *
     
     if (!linearSelectables.empty())
     {
-        for (LinearSelectableSet::iterator it = linearSelectables.begin();
-             it != linearSelectables.end(); ++it)
+        for (SimpleIdentity selectID : nearbyIDs[IndexLinear])
         {
-            LinearSelectable sel = *it;
+            LinearSelectableSet::iterator it = linearSelectables.find(LinearSelectable(selectID));
+            if (it == linearSelectables.end())
+                continue;
+            const LinearSelectable &sel = *it;
             
             if (sel.selectID != EmptyIdentity && sel.enable)
             {
@@ -1152,10 +1328,12 @@ void SelectionManager::pickObjects(Point2f touchPt,float maxDist,WhirlyKitView *
     if (!rect3Dselectables.empty())
     {
         // Work through the 3D rectangles
-        for (RectSelectable3DSet::iterator it = rect3Dselectables.begin();
-             it != rect3Dselectables.end(); ++it)
+        for (SimpleIdentity selectID : nearbyIDs[IndexRect3D])
         {
-            RectSelectable3D sel = *it;
+            RectSelectable3DSet::iterator it = rect3Dselectables.find(RectSelectable3D(selectID));
+            if (it == rect3Dselectables.end())
+                continue;
+            const RectSelectable3D &sel = *it;
             if (sel.selectID != EmptyIdentity && sel.enable)
             {
                 if (sel.minVis == DrawVisibleInvalid ||
@@ -1217,10 +1395,12 @@ void SelectionManager::pickObjects(Point2f touchPt,float maxDist,WhirlyKitView *
     if (!billboardSelectables.empty())
     {
         // Work through the billboards
-        for (BillboardSelectableSet::iterator it = billboardSelectables.begin();
-             it != billboardSelectables.end(); ++it)
+        for (SimpleIdentity selectID : nearbyIDs[IndexBillboard])
         {
-            BillboardSelectable sel = *it;
+            BillboardSelectableSet::iterator it = billboardSelectables.find(BillboardSelectable(selectID));
+            if (it == billboardSelectables.end())
+                continue;
+            const BillboardSelectable &sel = *it;
             if (sel.selectID != EmptyIdentity && sel.enable)
             {
                 
@@ -1234,8 +1414,6 @@ void SelectionManager::pickObjects(Point2f touchPt,float maxDist,WhirlyKitView *
                 poly[3] = sel.size.x()/2.0 * axisX + center3d;
                 poly[2] = -sel.size.x()/2.0 * axisX + sel.size.y() * normal3d + center3d;
                 poly[1] = sel.size.x()/2.0 * axisX + sel.size.y() * normal3d + center3d;
-                
-                BillboardSelectable sel = *it;
 
                 std::vector<Point2f> screenPts;
                 ClipAndProjectPolygon(pInfo.viewAndModelMat,pInfo.projMat,pInfo.frameSizeScale,poly,screenPts);
@@ -117,6 +117,11 @@ void ShapeDrawableBuilder::addPoints(std::vector<Point3f> &pts,RGBAColor color,M
         }
     }
     drawMbr.expand(mbr);
+    // Make room for the whole ring at once, out of the shared vertex arenas
+    int totalPts = drawable->getNumPoints()+ptCount;
+    drawable->reserveNumPoints(ptCount);
+    drawable->reserveNumNorms(totalPts);
+    drawable->reserveNumColors(totalPts);
     
     Point3f prevPt,prevNorm,firstPt,firstNorm;
     for (unsigned int jj=0;jj<pts.size();jj++)
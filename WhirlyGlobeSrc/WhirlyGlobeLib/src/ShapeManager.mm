@@ -648,21 +648,17 @@ void ShapeManager::convertShape(WhirlyKitShape *shape,std::vector<WhirlyKit::Geo
         {
             outGeom.colors.reserve(draw->points.size());
             VertexAttribute *vertAttr = draw->vertexAttributes[draw->colorEntry];
-            for (int ii=0;ii<vertAttr->numElements();ii++)
-            {
-                RGBAColor *color = (RGBAColor *)vertAttr->addressForElement(ii);
-                outGeom.colors.push_back(*color);
-            }
+            const RGBAColor *colors = vertAttr->elements<RGBAColor>();
+            if (colors)
+                outGeom.colors.insert(outGeom.colors.end(),colors,colors+vertAttr->numElements());
         }
         if (draw->normalEntry >= 0)
         {
             outGeom.norms.reserve(draw->points.size());
             VertexAttribute *vertAttr = draw->vertexAttributes[draw->normalEntry];
-            for (int ii=0;ii<vertAttr->numElements();ii++)
-            {
-                Point3f *norm = (Point3f *)vertAttr->addressForElement(ii);
-                outGeom.norms.push_back(Point3d(norm->x(),norm->y(),norm->z()));
-            }
+            const Point3f *norms = vertAttr->elements<Point3f>();
+            for (int ii=0;norms && ii<vertAttr->numElements();ii++)
+                outGeom.norms.push_back(Point3d(norms[ii].x(),norms[ii].y(),norms[ii].z()));
         }
     }
 }
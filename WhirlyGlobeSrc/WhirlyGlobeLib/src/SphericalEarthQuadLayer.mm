@@ -88,6 +88,14 @@ using namespace WhirlyKit;
     return ScreenImportance(viewState, frameSize, viewState.eyeVec, pixelsSquare, &coordSystem, viewState.coordAdapter, tileMbr, ident, attrs);
 }
 
+- (void)importanceForTiles:(std::vector<WhirlyKit::Quadtree::ImportanceRequest> &)requests viewInfo:(WhirlyKitViewState *)viewState frameSize:(WhirlyKit::Point2f)frameSize
+{
+    ScreenImportance(viewState, frameSize, pixelsSquare, &coordSystem, viewState.coordAdapter, requests);
+    for (Quadtree::ImportanceRequest &request : requests)
+        if (request.ident.level == [self minZoom])
+            request.importance = MAXFLOAT;
+}
+
 /// Called when the layer is shutting down.  Clean up any drawable data and clear out caches.
 - (void)teardown
 {
@@ -128,6 +128,48 @@ Point3d SphericalMercatorCoordSystem::geocentricToLocal(Point3d geocPt)
     return Point3d(localPt.x(),localPt.y(),geoCoordPlus.z());
 }
     
+// Mercator Y for a latitude, clamped near the poles.
+// log((1+sin)/cos) is the same as atanh(sin), so we can skip the cos.
+static inline double MercatorLatToY(double lat)
+{
+    lat = std::min(std::max(lat,-PoleLimit),PoleLimit);
+    double sinLat = sin(lat);
+    return 0.5 * log((1.0+sinLat)/(1.0-sinLat));
+}
+
+void SphericalMercatorCoordSystem::localToGeographic(const Point3d *inPts,Point2d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = Point2d(inPts[ii].x() + originLon,atan(sinh(inPts[ii].y())));
+}
+
+void SphericalMercatorCoordSystem::geographicToLocal(const Point2d *inPts,Point3d *outPts,int count)
+{
+    for (int ii=0;ii<count;ii++)
+        outPts[ii] = Point3d(inPts[ii].x() - originLon,MercatorLatToY(inPts[ii].y()),0.0);
+}
+
+void SphericalMercatorCoordSystem::localToGeocentric(const Point3d *inPts,Point3d *outPts,int count)
+{
+    // Over to geographic, keeping the height, then one call for the rest
+    for (int ii=0;ii<count;ii++)
+    {
+        const Point3d &pt = inPts[ii];
+        outPts[ii] = Point3d(pt.x() + originLon,atan(sinh(pt.y())),pt.z());
+    }
+    GeoCoordSystem::LocalToGeocentric(outPts,outPts,count);
+}
+
+void SphericalMercatorCoordSystem::geocentricToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    GeoCoordSystem::GeocentricToLocal(inPts,outPts,count);
+    for (int ii=0;ii<count;ii++)
+    {
+        Point3d &pt = outPts[ii];
+        pt = Point3d(pt.x() - originLon,MercatorLatToY(pt.y()),pt.z());
+    }
+}
+    
 bool SphericalMercatorCoordSystem::isSameAs(CoordSystem *coordSys)
 {
     SphericalMercatorCoordSystem *other = dynamic_cast<SphericalMercatorCoordSystem *>(coordSys);
@@ -196,6 +238,21 @@ WhirlyKit::Point3d SphericalMercatorDisplayAdapter::displayToLocal(WhirlyKit::Po
     return localPt;
 }
     
+void SphericalMercatorDisplayAdapter::localToDisplay(const Point3f *inPts,Point3f *outPts,int count)
+{
+    ScaleOffsetPoints(inPts,outPts,count,Point3f(1.0,1.0,1.0),Point3f(-org.x(),-org.y(),0.0));
+}
+
+void SphericalMercatorDisplayAdapter::localToDisplay(const Point3d *inPts,Point3d *outPts,int count)
+{
+    ScaleOffsetPoints(inPts,outPts,count,Point3d(1.0,1.0,1.0),Point3d(-org.x(),-org.y(),0.0));
+}
+
+void SphericalMercatorDisplayAdapter::displayToLocal(const Point3d *inPts,Point3d *outPts,int count)
+{
+    ScaleOffsetPoints(inPts,outPts,count,Point3d(1.0,1.0,1.0),Point3d(org.x(),org.y(),0.0));
+}
+    
 /// For flat systems the normal is Z up.  For the globe, it's based on the location.
 Point3f SphericalMercatorDisplayAdapter::normalForLocal(Point3f)
 {
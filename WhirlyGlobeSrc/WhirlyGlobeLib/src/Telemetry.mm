@@ -0,0 +1,534 @@
+/*
+ *  Telemetry.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by Steve Gifford on 10/17/26.
+ *  Copyright 2011-2026 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <stdio.h>
+#import <mutex>
+#import <chrono>
+#import <algorithm>
+#import "Telemetry.h"
+#ifdef __OBJC__
+#import <Foundation/Foundation.h>
+#endif
+
+namespace WhirlyKit
+{
+
+TelemetryHistogram::TelemetryHistogram()
+{
+    clear();
+}
+
+// Only the owning thread writes, so there's no need for read-modify-write
+static inline void AddTo(std::atomic<uint64_t> &val,uint64_t amount)
+{
+    val.store(val.load(std::memory_order_relaxed) + amount,std::memory_order_relaxed);
+}
+
+void TelemetryHistogram::record(uint64_t value)
+{
+    AddTo(buckets[bucketForValue(value)],1);
+    AddTo(count,1);
+    AddTo(sum,value);
+    if (value < minValue.load(std::memory_order_relaxed))
+        minValue.store(value,std::memory_order_relaxed);
+    if (value > maxValue.load(std::memory_order_relaxed))
+        maxValue.store(value,std::memory_order_relaxed);
+}
+
+void TelemetryHistogram::clear()
+{
+    for (unsigned int ii=0;ii<NumBuckets;ii++)
+        buckets[ii].store(0,std::memory_order_relaxed);
+    count.store(0,std::memory_order_relaxed);
+    sum.store(0,std::memory_order_relaxed);
+    minValue.store(UINT64_MAX,std::memory_order_relaxed);
+    maxValue.store(0,std::memory_order_relaxed);
+}
+
+void TelemetryHistogram::add(const TelemetryHistogram &other)
+{
+    for (unsigned int ii=0;ii<NumBuckets;ii++)
+        AddTo(buckets[ii],other.buckets[ii].load(std::memory_order_relaxed));
+    AddTo(count,other.count.load(std::memory_order_relaxed));
+    AddTo(sum,other.sum.load(std::memory_order_relaxed));
+    uint64_t otherMin = other.minValue.load(std::memory_order_relaxed);
+    if (otherMin < minValue.load(std::memory_order_relaxed))
+        minValue.store(otherMin,std::memory_order_relaxed);
+    uint64_t otherMax = other.maxValue.load(std::memory_order_relaxed);
+    if (otherMax > maxValue.load(std::memory_order_relaxed))
+        maxValue.store(otherMax,std::memory_order_relaxed);
+}
+
+int TelemetryHistogram::bucketForValue(uint64_t value)
+{
+    if (value < NumSubBuckets)
+        return (int)value;
+
+    // Top bit picks the power of two, the next few pick the sub bucket
+    int topBit = 63 - __builtin_clzll(value);
+    int subBucket = (int)(value >> (topBit - SubBucketBits)) & (NumSubBuckets-1);
+    return (topBit - SubBucketBits + 1) * NumSubBuckets + subBucket;
+}
+
+uint64_t TelemetryHistogram::valueForBucket(int bucket)
+{
+    if (bucket < NumSubBuckets)
+        return bucket;
+
+    int topBit = bucket / NumSubBuckets + SubBucketBits - 1;
+    int subBucket = bucket % NumSubBuckets;
+    int shift = topBit - SubBucketBits;
+    uint64_t low = (uint64_t)(NumSubBuckets + subBucket) << shift;
+    return low + (((uint64_t)1 << shift) >> 1);
+}
+
+TelemetryStats::TelemetryStats()
+    : telemetryID(EmptyTelemetryID), isSpan(false), count(0), minValue(0), maxValue(0), mean(0.0), p50(0), p99(0), p999(0)
+{
+}
+
+// A span or counter happening on a thread
+class TelemetryEvent
+{
+public:
+    TelemetryID telemetryID;
+    uint64_t start;
+    // Duration for spans, the value for counters
+    uint64_t value;
+};
+
+// What one thread has recorded.  Only that thread writes to it.
+class TelemetryThread
+{
+public:
+    TelemetryThread(int threadID) : threadID(threadID), events(NULL), numEvents(0)
+    {
+        for (unsigned int ii=0;ii<Telemetry::MaxIDs;ii++)
+            histograms[ii].store(NULL,std::memory_order_relaxed);
+    }
+
+    TelemetryHistogram *getHistogram(TelemetryID telemetryID)
+    {
+        TelemetryHistogram *hist = histograms[telemetryID].load(std::memory_order_acquire);
+        if (!hist)
+        {
+            hist = new TelemetryHistogram();
+            histograms[telemetryID].store(hist,std::memory_order_release);
+        }
+        return hist;
+    }
+
+    void addEvent(TelemetryID telemetryID,uint64_t start,uint64_t value)
+    {
+        TelemetryEvent *theEvents = events.load(std::memory_order_acquire);
+        if (!theEvents)
+        {
+            theEvents = new TelemetryEvent[Telemetry::MaxTraceEvents];
+            events.store(theEvents,std::memory_order_release);
+        }
+        uint64_t which = numEvents.load(std::memory_order_relaxed);
+        TelemetryEvent &event = theEvents[which % Telemetry::MaxTraceEvents];
+        event.telemetryID = telemetryID;
+        event.start = start;
+        event.value = value;
+        numEvents.store(which+1,std::memory_order_release);
+    }
+
+    int threadID;
+    // Set and read with the registry locked
+    std::string name;
+    std::atomic<TelemetryHistogram *> histograms[Telemetry::MaxIDs];
+    // Ring of the most recent events, made when tracing first turns on
+    std::atomic<TelemetryEvent *> events;
+    std::atomic<uint64_t> numEvents;
+};
+
+// Names of what's registered and all the threads that have recorded something.
+// When a thread exits its numbers are folded into the retired totals and its
+//  record goes on the free list for the next new thread.
+class TelemetryRegistry
+{
+public:
+    TelemetryRegistry() : numIDs(0), tracing(false), startTime(Telemetry::now()), nextThreadID(1)
+    {
+        for (unsigned int ii=0;ii<Telemetry::MaxIDs;ii++)
+            retired[ii] = NULL;
+    }
+
+    std::mutex lock;
+    std::string names[Telemetry::MaxIDs];
+    bool isSpan[Telemetry::MaxIDs];
+    std::atomic<int> numIDs;
+    std::vector<TelemetryThread *> threads;
+    // Records from threads that have exited.  Their trace events stay until they're reused.
+    std::vector<TelemetryThread *> freeThreads;
+    // What exited threads recorded, by ID
+    TelemetryHistogram *retired[Telemetry::MaxIDs];
+    std::atomic<bool> tracing;
+    uint64_t startTime;
+    int nextThreadID;
+};
+
+static TelemetryRegistry &GetRegistry()
+{
+    static TelemetryRegistry *registry = new TelemetryRegistry();
+    return *registry;
+}
+
+// Hand a thread's record back when it exits.  The registry must be locked.
+static void RetireThread(TelemetryRegistry &registry,TelemetryThread *thread)
+{
+    for (unsigned int ii=0;ii<Telemetry::MaxIDs;ii++)
+    {
+        TelemetryHistogram *hist = thread->histograms[ii].load(std::memory_order_relaxed);
+        if (!hist || hist->count.load(std::memory_order_relaxed) == 0)
+            continue;
+        if (!registry.retired[ii])
+            registry.retired[ii] = new TelemetryHistogram();
+        registry.retired[ii]->add(*hist);
+        hist->clear();
+    }
+    registry.threads.erase(std::remove(registry.threads.begin(),registry.threads.end(),thread),registry.threads.end());
+    registry.freeThreads.push_back(thread);
+}
+
+static thread_local TelemetryThread *curThread = NULL;
+// Set once this thread's record has been handed back.  Anything recorded after that is dropped.
+static thread_local bool threadRetired = false;
+
+// Gives the record back when the thread exits
+class TelemetryThreadOwner
+{
+public:
+    ~TelemetryThreadOwner()
+    {
+        if (!curThread)
+            return;
+        TelemetryRegistry &registry = GetRegistry();
+        std::lock_guard<std::mutex> guard(registry.lock);
+        RetireThread(registry,curThread);
+        curThread = NULL;
+        threadRetired = true;
+    }
+};
+
+static TelemetryThread *GetThread()
+{
+    if (!curThread && !threadRetired)
+    {
+        static thread_local TelemetryThreadOwner owner;
+        TelemetryRegistry &registry = GetRegistry();
+        std::lock_guard<std::mutex> guard(registry.lock);
+        if (!registry.freeThreads.empty())
+        {
+            curThread = registry.freeThreads.back();
+            registry.freeThreads.pop_back();
+            curThread->threadID = registry.nextThreadID++;
+            curThread->name.clear();
+            curThread->numEvents.store(0,std::memory_order_relaxed);
+        } else
+            curThread = new TelemetryThread(registry.nextThreadID++);
+        registry.threads.push_back(curThread);
+    }
+    return curThread;
+}
+
+static TelemetryID RegisterID(const std::string &name,bool isSpan)
+{
+    TelemetryRegistry &registry = GetRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    int numIDs = registry.numIDs.load(std::memory_order_relaxed);
+    for (int ii=0;ii<numIDs;ii++)
+        if (registry.isSpan[ii] == isSpan && registry.names[ii] == name)
+            return ii;
+    if (numIDs >= Telemetry::MaxIDs)
+        return EmptyTelemetryID;
+    registry.names[numIDs] = name;
+    registry.isSpan[numIDs] = isSpan;
+    registry.numIDs.store(numIDs+1,std::memory_order_release);
+
+    return numIDs;
+}
+
+TelemetryID Telemetry::registerSpan(const std::string &name)
+{
+    return RegisterID(name,true);
+}
+
+TelemetryID Telemetry::registerCounter(const std::string &name)
+{
+    return RegisterID(name,false);
+}
+
+std::string Telemetry::getName(TelemetryID telemetryID)
+{
+    TelemetryRegistry &registry = GetRegistry();
+    if (telemetryID < 0 || telemetryID >= registry.numIDs.load(std::memory_order_acquire))
+        return "";
+    return registry.names[telemetryID];
+}
+
+uint64_t Telemetry::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Telemetry::recordSpan(TelemetryID spanID,uint64_t start,uint64_t end)
+{
+    if (spanID < 0 || spanID >= MaxIDs)
+        return;
+
+    TelemetryThread *thread = GetThread();
+    if (!thread)
+        return;
+    uint64_t dur = end > start ? end - start : 0;
+    thread->getHistogram(spanID)->record(dur);
+    if (GetRegistry().tracing.load(std::memory_order_relaxed))
+        thread->addEvent(spanID,start,dur);
+}
+
+void Telemetry::recordValue(TelemetryID counterID,uint64_t value)
+{
+    if (counterID < 0 || counterID >= MaxIDs)
+        return;
+
+    TelemetryThread *thread = GetThread();
+    if (!thread)
+        return;
+    thread->getHistogram(counterID)->record(value);
+    if (GetRegistry().tracing.load(std::memory_order_relaxed))
+        thread->addEvent(counterID,now(),value);
+}
+
+void Telemetry::setThreadName(const std::string &name)
+{
+    TelemetryThread *thread = GetThread();
+    if (!thread)
+        return;
+    TelemetryRegistry &registry = GetRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    thread->name = name;
+}
+
+void Telemetry::setTracing(bool tracing)
+{
+    GetRegistry().tracing.store(tracing,std::memory_order_relaxed);
+}
+
+bool Telemetry::isTracing()
+{
+    return GetRegistry().tracing.load(std::memory_order_relaxed);
+}
+
+// Merge a span or counter from all the threads, living and exited.  The registry must be locked.
+static bool MergeStats(TelemetryRegistry &registry,TelemetryID telemetryID,TelemetryStats &stats)
+{
+    std::vector<uint64_t> buckets(TelemetryHistogram::NumBuckets,0);
+    uint64_t count = 0,sum = 0,minValue = UINT64_MAX,maxValue = 0;
+    std::vector<TelemetryHistogram *> hists;
+    for (TelemetryThread *thread : registry.threads)
+        hists.push_back(thread->histograms[telemetryID].load(std::memory_order_acquire));
+    hists.push_back(registry.retired[telemetryID]);
+    for (TelemetryHistogram *hist : hists)
+    {
+        if (!hist)
+            continue;
+        for (unsigned int ii=0;ii<TelemetryHistogram::NumBuckets;ii++)
+            buckets[ii] += hist->buckets[ii].load(std::memory_order_relaxed);
+        count += hist->count.load(std::memory_order_relaxed);
+        sum += hist->sum.load(std::memory_order_relaxed);
+        minValue = std::min(minValue,hist->minValue.load(std::memory_order_relaxed));
+        maxValue = std::max(maxValue,hist->maxValue.load(std::memory_order_relaxed));
+    }
+    if (count == 0)
+        return false;
+
+    stats.telemetryID = telemetryID;
+    stats.name = registry.names[telemetryID];
+    stats.isSpan = registry.isSpan[telemetryID];
+    stats.count = count;
+    stats.minValue = minValue;
+    stats.maxValue = maxValue;
+    stats.mean = (double)sum / count;
+
+    // Walk up the buckets for the percentiles, clamped to what we actually saw
+    uint64_t *percentiles[3] = {&stats.p50,&stats.p99,&stats.p999};
+    double fractions[3] = {0.5,0.99,0.999};
+    uint64_t total = 0;
+    for (uint64_t bucket : buckets)
+        total += bucket;
+    uint64_t seen = 0;
+    int which = 0;
+    for (int ii=0;ii<TelemetryHistogram::NumBuckets && which < 3;ii++)
+    {
+        seen += buckets[ii];
+        while (which < 3 && seen > 0 && seen >= fractions[which] * total)
+        {
+            *percentiles[which] = std::max(minValue,std::min(maxValue,TelemetryHistogram::valueForBucket(ii)));
+            which++;
+        }
+    }
+
+    return true;
+}
+
+bool Telemetry::getStats(TelemetryID telemetryID,TelemetryStats &stats)
+{
+    TelemetryRegistry &registry = GetRegistry();
+    if (telemetryID < 0 || telemetryID >= registry.numIDs.load(std::memory_order_acquire))
+        return false;
+
+    std::lock_guard<std::mutex> guard(registry.lock);
+    return MergeStats(registry,telemetryID,stats);
+}
+
+void Telemetry::getAllStats(std::vector<TelemetryStats> &allStats)
+{
+    TelemetryRegistry &registry = GetRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    int numIDs = registry.numIDs.load(std::memory_order_acquire);
+    for (int ii=0;ii<numIDs;ii++)
+    {
+        TelemetryStats stats;
+        if (MergeStats(registry,ii,stats))
+            allStats.push_back(stats);
+    }
+}
+
+void Telemetry::clear()
+{
+    TelemetryRegistry &registry = GetRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    for (TelemetryThread *thread : registry.threads)
+    {
+        for (unsigned int ii=0;ii<MaxIDs;ii++)
+        {
+            TelemetryHistogram *hist = thread->histograms[ii].load(std::memory_order_acquire);
+            if (hist)
+                hist->clear();
+        }
+        thread->numEvents.store(0,std::memory_order_relaxed);
+    }
+    for (TelemetryThread *thread : registry.freeThreads)
+        thread->numEvents.store(0,std::memory_order_relaxed);
+    for (unsigned int ii=0;ii<MaxIDs;ii++)
+        if (registry.retired[ii])
+            registry.retired[ii]->clear();
+}
+
+// Quote a string for JSON
+static std::string JSONString(const std::string &str)
+{
+    std::string ret = "\"";
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            ret += '\\';
+            ret += c;
+        } else if ((unsigned char)c < 0x20)
+        {
+            char buf[8];
+            snprintf(buf,sizeof(buf),"\\u%04x",c);
+            ret += buf;
+        } else
+            ret += c;
+    }
+    ret += "\"";
+    return ret;
+}
+
+bool Telemetry::writeChromeTrace(const std::string &fileName)
+{
+    FILE *fp = fopen(fileName.c_str(),"w");
+    if (!fp)
+        return false;
+
+    TelemetryRegistry &registry = GetRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    std::vector<std::string> quotedNames;
+    int numIDs = registry.numIDs.load(std::memory_order_acquire);
+    for (int ii=0;ii<numIDs;ii++)
+        quotedNames.push_back(JSONString(registry.names[ii]));
+
+    fprintf(fp,"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    std::vector<TelemetryThread *> allThreads = registry.threads;
+    allThreads.insert(allThreads.end(),registry.freeThreads.begin(),registry.freeThreads.end());
+    for (TelemetryThread *thread : allThreads)
+    {
+        if (!thread->name.empty())
+        {
+            fprintf(fp,"%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":%s}}",
+                    first ? "" : ",\n",thread->threadID,JSONString(thread->name).c_str());
+            first = false;
+        }
+
+        // The writer may be adding more as we go, so we just take what was there when we started
+        TelemetryEvent *events = thread->events.load(std::memory_order_acquire);
+        uint64_t numEvents = thread->numEvents.load(std::memory_order_acquire);
+        if (!events)
+            continue;
+        uint64_t firstEvent = numEvents > MaxTraceEvents ? numEvents - MaxTraceEvents : 0;
+        for (uint64_t which = firstEvent;which < numEvents;which++)
+        {
+            const TelemetryEvent &event = events[which % MaxTraceEvents];
+            if (event.telemetryID < 0 || event.telemetryID >= numIDs)
+                continue;
+            double ts = (double)((int64_t)(event.start - registry.startTime)) / 1000.0;
+            if (registry.isSpan[event.telemetryID])
+                fprintf(fp,"%s{\"name\":%s,\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                        first ? "" : ",\n",quotedNames[event.telemetryID].c_str(),ts,event.value / 1000.0,thread->threadID);
+            else
+                fprintf(fp,"%s{\"name\":%s,\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"value\":%llu}}",
+                        first ? "" : ",\n",quotedNames[event.telemetryID].c_str(),ts,thread->threadID,(unsigned long long)event.value);
+            first = false;
+        }
+    }
+    fprintf(fp,"\n]}\n");
+
+    bool ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+}
+
+// NSLog on the device, stdout elsewhere
+#ifdef __OBJC__
+#define TelemetryLog(fmt,...) NSLog(@fmt,__VA_ARGS__)
+#else
+#define TelemetryLog(fmt,...) printf(fmt "\n",__VA_ARGS__)
+#endif
+
+void Telemetry::log()
+{
+    std::vector<TelemetryStats> allStats;
+    getAllStats(allStats);
+    for (const TelemetryStats &stats : allStats)
+    {
+        if (stats.isSpan)
+            TelemetryLog("  %s: %llu runs, p50, p99, p999, max = (%.3f,%.3f,%.3f,%.3f) ms",stats.name.c_str(),(unsigned long long)stats.count,
+                         stats.p50 / 1e6,stats.p99 / 1e6,stats.p999 / 1e6,stats.maxValue / 1e6);
+        else
+            TelemetryLog("  %s: %llu samples, p50, p99, p999, max = (%llu,%llu,%llu,%llu)",stats.name.c_str(),(unsigned long long)stats.count,
+                         (unsigned long long)stats.p50,(unsigned long long)stats.p99,(unsigned long long)stats.p999,(unsigned long long)stats.maxValue);
+    }
+}
+
+}
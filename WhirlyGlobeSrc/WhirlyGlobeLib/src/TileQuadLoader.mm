@@ -30,6 +30,9 @@
 using namespace Eigen;
 using namespace WhirlyKit;
 
+// Turning a loaded image into a tile
+static const TelemetryID TileBuildSpan = Telemetry::registerSpan("Quad tile loader - build tile");
+
 @interface WhirlyKitQuadTileLoader()
 {
 @public
@@ -453,7 +456,9 @@ using namespace WhirlyKit;
     else
         localFetches.insert(tileInfo->ident);
     
-    [dataSource quadTileLoader:self startFetchForLevel:tileInfo->ident.level col:tileInfo->ident.x row:tileInfo->ident.y frame:frame attrs:tileInfo->attrs];
+    NSMutableDictionary *attrs = layer.quadtree->getAttrs(tileInfo->ident);
+    attrs[kWKTileImportance] = @(tileInfo->importance);
+    [dataSource quadTileLoader:self startFetchForLevel:tileInfo->ident.level col:tileInfo->ident.x row:tileInfo->ident.y frame:frame attrs:attrs];
 }
 
 // Check if we're in the process of loading the given tile
@@ -517,6 +522,7 @@ using namespace WhirlyKit;
 
 - (void)dataSource:(NSObject<WhirlyKitQuadTileImageDataSource> *)dataSource loadedImage:(id)loadTile forLevel:(int)level col:(int)col row:(int)row frame:(int)frame
 {
+    TelemetrySpan span(TileBuildSpan);
     bool isPlaceholder = [self tileIsPlaceholder:loadTile];
     
     if (!isPlaceholder && !tileBuilder)
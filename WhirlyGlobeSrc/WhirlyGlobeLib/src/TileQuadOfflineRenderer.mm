@@ -84,7 +84,7 @@ typedef struct
     /// Comparison operator based on node identifier
     bool operator() (const OfflineTile *a,const OfflineTile *b)
     {
-        return a->ident < b->ident;
+        return a->ident.key() < b->ident.key();
     }
 } OfflineTileSorter;
 
@@ -570,7 +570,7 @@ typedef std::set<OfflineTile *,OfflineTileSorter> OfflineTileSet;
     theTile->numLoading++;
     
     numFetches++;
-    [_imageSource quadTileLoader:self startFetchForLevel:tileInfo->ident.level col:tileInfo->ident.x row:tileInfo->ident.y frame:frame attrs:tileInfo->attrs];
+    [_imageSource quadTileLoader:self startFetchForLevel:tileInfo->ident.level col:tileInfo->ident.x row:tileInfo->ident.y frame:frame attrs:layer.quadtree->getAttrs(tileInfo->ident)];
     somethingChanged = true;
 }
 
@@ -178,67 +178,87 @@ void SubdivideEdges(const VectorRing3d &inPts,VectorRing3d &outPts,bool closed,f
         outPts.push_back(inPts.back());
 }
 
-void subdivideToSurfaceRecurse(const Point2f &p0,const Point2f &p1,VectorRing &outPts,CoordSystemDisplayAdapter *adapter,float eps)
+// The end points come in already converted to display space, so each step only converts its midpoint
+void subdivideToSurfaceRecurse(const Point2f &p0,const Point2f &p1,const Point3f &dp0,const Point3f &dp1,VectorRing &outPts,CoordSystemDisplayAdapter *adapter,float eps)
 {
     // If the difference is greater than 180, then this is probably crossing the date line
     //  in which case we'll just leave it alone.
     if (std::abs(p0.x() - p1.x()) > M_PI)
         return;
     
-    Point3f dp0 = adapter->localToDisplay(adapter->getCoordSystem()->geographicToLocal(GeoCoord(p0.x(),p0.y())));
-    Point3f dp1 = adapter->localToDisplay(adapter->getCoordSystem()->geographicToLocal(GeoCoord(p1.x(),p1.y())));
     Point2f midPt = (p0+p1)/2.0;
     Point3f dMidPt = adapter->localToDisplay(adapter->getCoordSystem()->geographicToLocal(GeoCoord(midPt.x(),midPt.y())));
     Point3f halfPt = (dp0+dp1)/2.0;
     float dist2 = (halfPt-dMidPt).squaredNorm();
     if (dist2 > eps*eps)
     {
-        subdivideToSurfaceRecurse(p0, midPt, outPts, adapter, eps);
-        subdivideToSurfaceRecurse(midPt, p1, outPts, adapter, eps);
+        subdivideToSurfaceRecurse(p0, midPt, dp0, dMidPt, outPts, adapter, eps);
+        subdivideToSurfaceRecurse(midPt, p1, dMidPt, dp1, outPts, adapter, eps);
     }
     outPts.push_back(p1);
 }
 
-void subdivideToSurfaceRecurse(const Point3d &p0,const Point3d &p1,VectorRing3d &outPts,CoordSystemDisplayAdapter *adapter,float eps)
+void subdivideToSurfaceRecurse(const Point3d &p0,const Point3d &p1,const Point3d &dp0,const Point3d &dp1,VectorRing3d &outPts,CoordSystemDisplayAdapter *adapter,float eps)
 {
     // If the difference is greater than 180, then this is probably crossing the date line
     //  in which case we'll just leave it alone.
     if (std::abs(p0.x() - p1.x()) > M_PI)
         return;
     
-    Point3d dp0 = adapter->localToDisplay(adapter->getCoordSystem()->geographicToLocal3d(GeoCoord(p0.x(),p0.y())));
-    Point3d dp1 = adapter->localToDisplay(adapter->getCoordSystem()->geographicToLocal3d(GeoCoord(p1.x(),p1.y())));
     Point3d midPt = (p0+p1)/2.0;
-    Point3d dMidPt = adapter->localToDisplay(adapter->getCoordSystem()->geographicToLocal3d(GeoCoord(midPt.x(),midPt.y())));
+    Point3d dMidPt = adapter->localToDisplay(adapter->getCoordSystem()->geographicToLocal(Point2d(midPt.x(),midPt.y())));
     Point3d halfPt = (dp0+dp1)/2.0;
     float dist2 = (halfPt-dMidPt).squaredNorm();
     if (dist2 > eps*eps)
     {
-        subdivideToSurfaceRecurse(p0, midPt, outPts, adapter, eps);
-        subdivideToSurfaceRecurse(midPt, p1, outPts, adapter, eps);
+        subdivideToSurfaceRecurse(p0, midPt, dp0, dMidPt, outPts, adapter, eps);
+        subdivideToSurfaceRecurse(midPt, p1, dMidPt, dp1, outPts, adapter, eps);
     }
     outPts.push_back(p1);
 }
 
 void SubdivideEdgesToSurface(const VectorRing &inPts,VectorRing &outPts,bool closed,CoordSystemDisplayAdapter *adapter,float eps)
 {
+    if (inPts.empty())
+        return;
+    
+    // Every input point goes to display space once
+    CoordSystem *coordSys = adapter->getCoordSystem();
+    std::vector<Point3f> dispPts(inPts.size());
+    for (unsigned int ii=0;ii<inPts.size();ii++)
+        dispPts[ii] = coordSys->geographicToLocal(GeoCoord(inPts[ii].x(),inPts[ii].y()));
+    adapter->localToDisplay(&dispPts[0],&dispPts[0],(int)dispPts.size());
+    
     for (int ii=0;ii<(closed ? inPts.size() : inPts.size()-1);ii++)
     {
+        int next = (ii+1)%inPts.size();
         const Point2f &p0 = inPts[ii];
-        const Point2f &p1 = inPts[(ii+1)%inPts.size()];
+        const Point2f &p1 = inPts[next];
         outPts.push_back(p0);
-        subdivideToSurfaceRecurse(p0,p1,outPts,adapter,eps);
+        subdivideToSurfaceRecurse(p0,p1,dispPts[ii],dispPts[next],outPts,adapter,eps);
     }
 }
 
 void SubdivideEdgesToSurface(const VectorRing3d &inPts,VectorRing3d &outPts,bool closed,CoordSystemDisplayAdapter *adapter,float eps)
 {
+    if (inPts.empty())
+        return;
+    
+    // Every input point goes to display space once, as a batch
+    std::vector<Point2d> geoPts(inPts.size());
+    for (unsigned int ii=0;ii<inPts.size();ii++)
+        geoPts[ii] = Point2d(inPts[ii].x(),inPts[ii].y());
+    std::vector<Point3d> dispPts(inPts.size());
+    adapter->getCoordSystem()->geographicToLocal(&geoPts[0],&dispPts[0],(int)geoPts.size());
+    adapter->localToDisplay(&dispPts[0],&dispPts[0],(int)dispPts.size());
+    
     for (int ii=0;ii<(closed ? inPts.size() : inPts.size()-1);ii++)
     {
+        int next = (ii+1)%inPts.size();
         const Point3d &p0 = inPts[ii];
-        const Point3d &p1 = inPts[(ii+1)%inPts.size()];
+        const Point3d &p1 = inPts[next];
         outPts.push_back(p0);
-        subdivideToSurfaceRecurse(p0,p1,outPts,adapter,eps);
+        subdivideToSurfaceRecurse(p0,p1,dispPts[ii],dispPts[next],outPts,adapter,eps);
     }
 }
 
@@ -277,16 +297,21 @@ void SubdivideEdgesToSurfaceGC(const VectorRing &inPts,VectorRing3d &outPts,bool
         return;
     }
     
+    // Convert all the points at once, rather than twice per edge
+    std::vector<Point2d> geoPts(inPts.size());
+    for (unsigned int ii=0;ii<inPts.size();ii++)
+        geoPts[ii] = Point2d(inPts[ii].x(),inPts[ii].y());
+    std::vector<Point3d> dispPts(inPts.size());
+    adapter->getCoordSystem()->geographicToLocal(&geoPts[0],&dispPts[0],(int)geoPts.size());
+    adapter->localToDisplay(&dispPts[0],&dispPts[0],(int)dispPts.size());
+    if (!adapter->isFlat())
+        for (Point3d &dispPt : dispPts)
+            dispPt = dispPt.normalized() * (1.0 + surfOffset);
+    
     for (int ii=0;ii<(closed ? inPts.size() : inPts.size()-1);ii++)
     {
-        const Point2f &p0 = inPts[ii];
-        const Point2f &p1 = inPts[(ii+1)%inPts.size()];
-        Point3d dp0 = adapter->localToDisplay(adapter->getCoordSystem()->geographicToLocal3d(GeoCoord(p0.x(),p0.y())));
-        if (adapter && !adapter->isFlat())
-            dp0 = dp0.normalized() * (1.0 + surfOffset);
-        Point3d dp1 = adapter->localToDisplay(adapter->getCoordSystem()->geographicToLocal3d(GeoCoord(p1.x(),p1.y())));
-        if (adapter && !adapter->isFlat())
-            dp1 = dp1.normalized() * (1.0 + surfOffset);
+        const Point3d &dp0 = dispPts[ii];
+        const Point3d &dp1 = dispPts[(ii+1)%inPts.size()];
         outPts.push_back(dp0);
         subdivideToSurfaceRecurseGC(dp0,dp1,outPts,adapter,eps,surfOffset,minPts);
     }    
@@ -172,6 +172,12 @@ public:
             drawable->setLineWidth(vecInfo.lineWidth);
         }
         drawMbr.addPoints(pts);
+        // Make room for the whole ring at once, out of the shared vertex arenas
+        int totalPts = drawable->getNumPoints()+ptCount;
+        drawable->reserveNumPoints(ptCount);
+        drawable->reserveNumNorms(totalPts);
+        if (doColor)
+            drawable->reserveNumColors(totalPts);
         
         Point3f prevPt,prevNorm,firstPt,firstNorm;
         for (unsigned int jj=0;jj<pts.size();jj++)
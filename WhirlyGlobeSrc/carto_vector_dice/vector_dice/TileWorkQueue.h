@@ -0,0 +1,90 @@
+//
+//  TileWorkQueue.h
+//  vector_dice
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#ifndef __vector_dice__TileWorkQueue__
+#define __vector_dice__TileWorkQueue__
+
+#include <map>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+
+/** The Ordered Work Queue hands out numbered jobs to any number of workers
+    and gives the results back to a single consumer in job order.
+    That way the output comes out exactly the way it would in a serial run.
+    Workers are held back if they get too far ahead of the consumer,
+    which keeps the number of finished results in memory bounded.
+  */
+template<typename T> class OrderedWorkQueue
+{
+public:
+    OrderedWorkQueue(int numJobs,int maxAhead)
+    : numJobs(numJobs), maxAhead(std::max(maxAhead,1)), nextJob(0), nextResult(0), failed(false)
+    {
+    }
+
+    ~OrderedWorkQueue()
+    {
+        for (typename std::map<int,T *>::iterator it = results.begin(); it != results.end(); ++it)
+            delete it->second;
+    }
+
+    // Grab the next job.  Blocks if we're too far ahead.  Returns false when there's nothing left.
+    bool claim(int &which)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (nextJob >= numJobs || failed)
+            return false;
+        which = nextJob++;
+        notAhead.wait(lock, [&]{ return which < nextResult + maxAhead || failed; });
+
+        return !failed;
+    }
+
+    // Hand back the result for a job.  Queue takes ownership.
+    void finish(int which,T *result)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        results[which] = result;
+        if (which == nextResult)
+            ready.notify_one();
+    }
+
+    // Wait for the next result in job order.  Returns NULL when all the jobs are done.
+    T *next()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (nextResult >= numJobs || failed)
+            return NULL;
+        ready.wait(lock, [&]{ return results.find(nextResult) != results.end(); });
+        T *result = results[nextResult];
+        results.erase(nextResult);
+        nextResult++;
+        notAhead.notify_all();
+
+        return result;
+    }
+
+    // The consumer is bailing out.  Let the workers go.
+    void setFailed()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+        notAhead.notify_all();
+    }
+
+protected:
+    std::mutex mutex;
+    std::condition_variable notAhead,ready;
+    std::map<int,T *> results;
+    int numJobs,maxAhead;
+    int nextJob,nextResult;
+    bool failed;
+};
+
+#endif /* defined(__vector_dice__TileWorkQueue__) */
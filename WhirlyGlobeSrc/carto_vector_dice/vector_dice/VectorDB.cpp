@@ -15,7 +15,7 @@ namespace Maply
 {
     
 VectorDatabase::VectorDatabase()
-: db(NULL), valid(false)
+: db(NULL), valid(false), writer(NULL)
 {
 }
     
@@ -62,6 +62,23 @@ bool VectorDatabase::setupDatabase(Kompex::SQLiteDatabase *inDb,const char *dbSr
     return true;
 }
     
+void VectorDatabase::setLevels(int inMinLevel,int inMaxLevel)
+{
+    minLevel = inMinLevel;
+    maxLevel = inMaxLevel;
+    
+    try {
+        SQLiteStatement stmt(db);
+        stmt.SqlStatement((std::string)"UPDATE manifest SET minlevel=" + std::to_string(minLevel) + ",maxlevel=" + std::to_string(maxLevel) + ";");
+    }
+    catch (SQLiteException &exc)
+    {
+        std::string errorStr = (std::string)"Failed to update manifest:\n" + exc.GetString();
+        valid = false;
+        throw errorStr;
+    }
+}
+    
 void VectorDatabase::addStyle(const char *name,const char *styleStr)
 {
     try {
@@ -95,7 +112,7 @@ int VectorDatabase::addVectorLayer(const char *name)
         throw errorStr;
     }
     
-    insertStmts.push_back(NULL);
+    tableIDs.push_back(-1);
     return (int)layerNames.size()-1;
 }
     
@@ -536,78 +553,74 @@ void VectorDatabase::vectorToDBFormat(std::vector<OGRFeature *> &features,std::v
     retData.insert(retData.end(), vecData.begin(), vecData.end());
 }
 
-bool VectorDatabase::addVectorTile(int x,int y,int level,int layerID,const char *data,unsigned int dataLen)
+bool VectorDatabase::startWriter(int numThreads,int batchSize)
 {
-    // Calculate a quad index for later use
-    int quadIndex = 0;
-    for (int iq=0;iq<level;iq++)
-        quadIndex += (1<<iq)*(1<<iq);
-    quadIndex += y*(1<<level) + x;
-
-    try {
-        if (!insertStmts[layerID])
-        {
-            insertStmts[layerID] = new SQLiteStatement(db);
-            insertStmts[layerID]->Sql((std::string)"INSERT INTO " + layerNames[layerID] + "_table (data,level,x,y,quadindex) VALUES (@data,@level,@x,@y,@quadinex);");
-        }
-        SQLiteStatement *insertStmt = insertStmts[layerID];
-
-        // Compress if necessary
-        if (compress)
-        {
-            void *compressOut;
-            int compressSize=0;
-            if (CompressData((void *)data, dataLen, &compressOut, compressSize))
-            {
-                // Now insert the samples into the database as a blob
-                insertStmt->BindBlob(1, compressOut, compressSize);
-                insertStmt->BindInt(2, level);
-                insertStmt->BindInt(3, x);
-                insertStmt->BindInt(4, y);
-                insertStmt->BindInt(5, quadIndex);
-                insertStmt->Execute();
-                insertStmt->Reset();
+    if (writer)
+        return true;
+    
+    if (!TileDBWriter::tuneForBulkLoad(db))
+        return false;
+    writer = new TileDBWriter(db,(compress ? CompressData : NULL),numThreads,batchSize);
+    
+    return true;
+}
 
-                // Note: Eh?
-//                free(compressOut);
-            } else {
-                // Insert the uncompressed data
-                insertStmt->BindBlob(1, (void *)data, dataLen);
-                insertStmt->BindInt(2, level);
-                insertStmt->BindInt(3, x);
-                insertStmt->BindInt(4, y);
-                insertStmt->BindInt(5, quadIndex);
-                insertStmt->Execute();
-                insertStmt->Reset();
-            }
-        }
-    }
-    catch (SQLiteException &exc)
+bool VectorDatabase::addVectorTile(int x,int y,int level,int layerID,const char *data,unsigned int dataLen)
+{
+    if (!writer && !startWriter(0,1000))
     {
-        std::string errorStr = (std::string)"Failed to write to database:\n" + exc.GetString();
         valid = false;
-        throw errorStr;
+        throw (std::string)"Failed to set up tile writer";
     }
-    catch (...)
+    
+    if (tableIDs[layerID] < 0)
+    {
+        tableIDs[layerID] = writer->addTable(layerNames[layerID] + "_table");
+        if (tableIDs[layerID] < 0)
+        {
+            valid = false;
+            throw writer->getError();
+        }
+    }
+    
+    if (!writer->addTile(tableIDs[layerID], x, y, level, data, dataLen))
     {
-        std::string errorStr = "Unknown error";
         valid = false;
-        throw errorStr;
+        throw writer->getError();
     }
     
     return true;
 }
     
+void VectorDatabase::printStats(FILE *fp)
+{
+    if (writer)
+        writer->printStats(fp);
+}
+    
 void VectorDatabase::flush()
 {
+    if (!db)
+        return;
+    
     try {
-        for (unsigned int ii=0;ii<insertStmts.size();ii++)
-            if (insertStmts[ii])
+        if (writer)
+        {
+            bool ok = writer->flush();
+            std::string errorStr = writer->getError();
+            delete writer;
+            writer = NULL;
+            for (unsigned int ii=0;ii<tableIDs.size();ii++)
+                tableIDs[ii] = -1;
+            if (!ok)
             {
-                delete insertStmts[ii];
-                insertStmts[ii] = NULL;
+                valid = false;
+                throw errorStr;
             }
+            TileDBWriter::finishBulkLoad(db);
+        }
         db->Close();
+        db = NULL;
     }
     catch (SQLiteException &exc)
     {
@@ -615,12 +628,6 @@ void VectorDatabase::flush()
         valid = false;
         throw errorStr;
     }
-    catch (...)
-    {
-        std::string errorStr = (std::string)"Unknown error";
-        valid = false;
-        throw errorStr;
-    }
 }
     
 }
@@ -23,6 +23,7 @@
 #include "KompexSQLiteStreamRedirection.h"
 #include "KompexSQLiteBlob.h"
 #include "KompexSQLiteException.h"
+#include "TileDBWriter.h"
 
 namespace Maply
 {
@@ -39,6 +40,9 @@ public:
     // Set up the data structures we need in the SQLite database
     bool setupDatabase(Kompex::SQLiteDatabase *db,const char *dbSrs,const char *tileSrs,double minX,double minY,double maxX,double maxY,int minLevel,int maxLevel,bool compress);
     
+    // Update the level range in the manifest, once we know what it is
+    void setLevels(int minLevel,int maxLevel);
+    
     // Add a style definition (just json, basically)
     void addStyle(const char *name,const char *styleStr);
     
@@ -48,12 +52,19 @@ public:
     // Convert OGR vector data to our raw format
     void vectorToDBFormat(std::vector<OGRFeature *> &features,std::vector<unsigned char> &vecData);
     
+    // Tiles are compressed on numThreads threads and committed batchSize at a time.
+    // This puts the database in WAL mode until flush(), so don't hold a transaction open around it.
+    bool startWriter(int numThreads,int batchSize);
+    
     // Add the data for a vector tile
     bool addVectorTile(int x,int y,int level,int layerID,const char *data,unsigned int dataLen);
     
     // Create the quadIndex index
     void createIndex();
     
+    // Print out the tile writer's counters
+    void printStats(FILE *fp);
+    
     // Close any open statements and such
     void flush();
     
@@ -70,8 +81,9 @@ protected:
     bool compress;
     bool valid;
     
-    // Precompiled insert statement
-    std::vector<Kompex::SQLiteStatement *> insertStmts;
+    // Writes the tiles in batches, with one table per layer
+    TileDBWriter *writer;
+    std::vector<int> tableIDs;
 };
     
 // Simple compression routine.  Release data when done.
@@ -16,9 +16,16 @@
 #include "cpl_minixml.h"
 #include "tinyxml2.h"
 #include <dirent.h>
+#include <unistd.h>
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <list>
+#include <unordered_map>
 #include <boost/filesystem.hpp>
 #include <boost/geometry.hpp>
 #include <boost/geometry/geometries/point.hpp>
@@ -26,6 +33,7 @@
 #include <boost/geometry/index/rtree.hpp>
 #include "MapnikConfig.h"
 #include "VectorDB.h"
+#include "TileWorkQueue.h"
 
 namespace bg = boost::geometry;
 namespace bgi = boost::geometry::index;
@@ -34,61 +42,129 @@ using namespace tinyxml2;
 
 // A spatial index that uses the boost R-Tree
 // The way we're chopping things up, we need a fast indexing scheme
+// We only keep the FIDs and bounding boxes (in the target system) around.
+// The features themselves are read back from the source file by the workers as they need them.
 class LayerSpatialIndex
 {
 public:
     // Typedefs for the R-tree
     typedef bg::model::point<double, 2, bg::cs::cartesian> point;
     typedef bg::model::box<point> box;
-    typedef std::pair<box, unsigned> value;
+    // The second half is the position in our FID list
+    typedef std::pair<box, unsigned int> value;
     
-    LayerSpatialIndex(OGRLayer *layer)
-    : layer(layer)
+    // Stream through the layer once, keeping the features that fall within the clip envelope
+    LayerSpatialIndex(OGRLayer *layer,OGRCoordinateTransformation *transform,OGREnvelope *clipEnv)
     {
-        int numFeatures = layer->GetFeatureCount();
-        features.resize(numFeatures,NULL);
-        mbrs.resize(numFeatures);
-        for (unsigned int ii=0;ii<numFeatures;ii++)
+        layer->ResetReading();
+        OGRFeature *feature = NULL;
+        while ((feature = layer->GetNextFeature()))
         {
-            features[ii] = layer->GetFeature(ii);
-            OGRFeature *feature = features[ii];
-            OGREnvelope env;
             OGRGeometry *geom = feature->GetGeometryRef();
-            if (!geom)
-                continue;
-            geom->getEnvelope(&env);
-            mbrs[ii] = env;
-            double spanX = env.MaxX - env.MinX, spanY = env.MaxY - env.MinY;
-            // Note: This assumes meters-like numbers
-            if (spanX == 0)                spanX = 10.0;
-            if (spanY == 0)                spanY = 10.0;
-            env.MinX -= spanX/10;  env.MinY -= spanY/10;
-            env.MaxX += spanY/10;  env.MaxY += spanY/10;
-            box b(point(env.MinX,env.MinY), point(env.MaxX,env.MaxY));
-            rtree.insert(std::make_pair(b,ii));
+            if (geom)
+            {
+                // Transform the MBR
+                OGREnvelope mbr;
+                geom->getEnvelope(&mbr);
+                OGRLinearRing ring;
+                ring.addPoint(mbr.MinX, mbr.MinY);
+                ring.addPoint(mbr.MaxX, mbr.MinY);
+                ring.addPoint(mbr.MaxX, mbr.MaxY);
+                ring.addPoint(mbr.MinX, mbr.MaxY);
+                ring.transform(transform);
+                OGREnvelope env;
+                ring.getEnvelope(&env);
+                
+                // See if it's within the bounds we're building
+                if (!clipEnv || clipEnv->Contains(env) || clipEnv->Intersects(env))
+                {
+                    if (fids.empty())
+                        extent = env;
+                    else
+                        extent.Merge(env);
+
+                    double spanX = env.MaxX - env.MinX, spanY = env.MaxY - env.MinY;
+                    // Note: This assumes meters-like numbers
+                    if (spanX == 0)                spanX = 10.0;
+                    if (spanY == 0)                spanY = 10.0;
+                    env.MinX -= spanX/10;  env.MinY -= spanY/10;
+                    env.MaxX += spanX/10;  env.MaxY += spanY/10;
+                    box b(point(env.MinX,env.MinY), point(env.MaxX,env.MaxY));
+                    rtree.insert(std::make_pair(b,(unsigned int)fids.size()));
+                    fids.push_back(feature->GetFID());
+                }
+            }
+            OGRFeature::DestroyFeature(feature);
         }
     }
-    ~LayerSpatialIndex()
-    {
-        for (unsigned int ii=0;ii<features.size();ii++)
-            OGRFeature::DestroyFeature(features[ii]);
-    }
     
-    // Return all the features covering a given area
-    void findFeatures(double sx,double sy,double ex,double ey,std::vector<OGRFeature *> &retFeatures)
+    // Return the entries covering a given area
+    // The tree isn't changing, so this can be called from multiple threads
+    void findFeatures(double sx,double sy,double ex,double ey,std::vector<unsigned int> &rets) const
     {
         box query_box(point(sx,sy),point(ex,ey));
-        std::vector<value> rets;
-        rtree.query(bgi::intersects(query_box), std::back_inserter(rets));
-        for (unsigned int ii=0;ii<rets.size();ii++)
-            retFeatures.push_back(features[rets[ii].second]);
+        std::vector<value> vals;
+        rtree.query(bgi::intersects(query_box), std::back_inserter(vals));
+        for (unsigned int ii=0;ii<vals.size();ii++)
+            rets.push_back(vals[ii].second);
     }
     
-    OGRLayer *layer;
-    std::vector<OGRFeature *> features;
-    std::vector<OGREnvelope> mbrs;
+    // Number of features we're indexing
+    unsigned int numFeatures() const { return (unsigned int)fids.size(); }
+    
+    // FID in the source layer for an entry
+    long getFID(unsigned int which) const { return fids[which]; }
+    
+    // Bounds of everything we're indexing, in the target system
+    const OGREnvelope &getExtent() const { return extent; }
+    
+protected:
     // A max of sixteen elements per node, using a quadratic r-tree
     bgi::rtree< value, bgi::rstar<16> > rtree;
+    std::vector<long> fids;
+    OGREnvelope extent;
+};
+
+// One worker's own handle on a source file.
+// OGR data sources can't be shared between threads, so each worker opens the file for itself.
+// The worker's output shapefiles go through the driver we look up here too, nothing is global.
+class SourceReader
+{
+public:
+    SourceReader(const std::string &fileName,OGRSpatialReference *hTrgSRS)
+    {
+        shpDriver = OGRSFDriverRegistrar::GetRegistrar()->GetDriverByName("ESRI Shapefile");
+        if (!shpDriver)
+        {
+            fprintf(stderr, "Couldn't get shape file driver\n");
+            exit(-1);
+        }
+        poDS = shpDriver->Open(fileName.c_str(),FALSE);
+        if (!poDS)
+        {
+            fprintf(stderr, "Couldn't open file: %s\n",fileName.c_str());
+            exit(1);
+        }
+        layer = poDS->GetLayer(0);
+        transform = OGRCreateCoordinateTransformation(layer->GetSpatialRef(),hTrgSRS);
+        if (!transform)
+        {
+            fprintf(stderr,"Can't transform from coordinate system to destination for: %s\n",fileName.c_str());
+            exit(-1);
+        }
+    }
+    
+    ~SourceReader()
+    {
+        delete transform;
+        OGRDataSource::DestroyDataSource(poDS);
+    }
+    
+    OGRSFDriver *shpDriver;
+    OGRDataSource *poDS;
+    OGRLayer *layer;
+    // Source system to target system
+    OGRCoordinateTransformation *transform;
 };
 
 // Convert the given feature to the given data type
@@ -158,253 +234,342 @@ void ConvertGeometryType(OGRGeometry *inGeom,MapnikConfig::SymbolDataType dataTy
     }
 }
 
-// Transform all the geometry in the given layer into the new coordinate system
-void TransformLayer(OGRLayer *inLayer,std::vector<OGRFeature *> &inFeatures,OGRLayer *outLayer,OGRCoordinateTransformation *transform,std::vector<MapnikConfig::CompiledSymbolizerTable::SymbolizerGroup> &symGroups,MapnikConfig::SymbolDataType dataType,OGREnvelope *clipEnv,OGREnvelope &mbr)
+// Apply the rules to a source feature, convert it to the given data type and reproject it into the target system.
+// The results use the output definition, which has the style fields and the attributes the styles want.
+void ConvertFeature(OGRFeature *feature,OGRCoordinateTransformation *transform,std::vector<MapnikConfig::CompiledSymbolizerTable::SymbolizerGroup> &symGroups,MapnikConfig::SymbolDataType dataType,OGREnvelope *clipEnv,OGRFeatureDefn *outDefn,std::vector<OGRFeature *> &outFeatures)
 {
-    OGREnvelope blank;
-    mbr = blank;
+    // As we go through the styles and rules, these are the symbolizers that apply
+    std::vector<int> symbolizers;
+    std::set<std::string> attrsToKeep;
     
-    for (unsigned int ii=0;ii<inFeatures.size();ii++)
+    // If we've got rules to apply, let's do that here
+    bool approved = true;
+    if (!symGroups.empty())
     {
-        OGRFeature *feature = inFeatures[ii];
-        
-        // As we go through the styles and rules, these are the symbolizers that apply
-        std::vector<int> symbolizers;
-        std::set<std::string> attrsToKeep;
-        
-        // If we've got rules to apply, let's do that here
-        bool approved = true;
-        if (!symGroups.empty())
-        {
-            approved = false;
+        approved = false;
 
-            // Work through the groups, which have their own filters
-            for (unsigned int si=0;si<symGroups.size();si++)
+        // Work through the groups, which have their own filters
+        for (unsigned int si=0;si<symGroups.size();si++)
+        {
+            MapnikConfig::CompiledSymbolizerTable::SymbolizerGroup &symGroup = symGroups[si];
+            bool styleApproved = false;
+            MapnikConfig::Filter &filter = symGroup.filter;
+            // Work through the valid rules within this style
             {
-                MapnikConfig::CompiledSymbolizerTable::SymbolizerGroup &symGroup = symGroups[si];
-                bool styleApproved = false;
-                MapnikConfig::Filter &filter = symGroup.filter;
-                // Work through the valid rules within this style
+                bool ruleApproved = true;
+                // No filter means it all matches
+                if (filter.isEmpty())
                 {
-                    bool ruleApproved = true;
-                    // No filter means it all matches
-                    if (filter.isEmpty())
+                    ruleApproved = true;
+                } else {
+                    if (filter.logicalOp != MapnikConfig::Filter::OperatorAND)
                     {
-                        ruleApproved = true;
-                    } else {
-                        if (filter.logicalOp != MapnikConfig::Filter::OperatorAND)
-                        {
-                            fprintf(stderr,"Can only currently handle AND in logical operator rules");
-                            exit(-1);
-                        }
+                        fprintf(stderr,"Can only currently handle AND in logical operator rules");
+                        exit(-1);
+                    }
+                    
+                    // Work through the comparisons
+                    for (unsigned int ci=0;ci<filter.comparisons.size();ci++)
+                    {
+                        MapnikConfig::Filter::Comparison &comp = filter.comparisons[ci];
+                        bool clauseApproved = false;
                         
-                        // Work through the comparisons
-                        for (unsigned int ci=0;ci<filter.comparisons.size();ci++)
+                        // Look for the attribute we're comparing
+                        int idx = feature->GetFieldIndex(comp.attrName.c_str());
+                        if (idx >= 0)
                         {
-                            MapnikConfig::Filter::Comparison &comp = filter.comparisons[ci];
-                            bool clauseApproved = false;
-                            
-                            // Look for the attribute we're comparing
-                            int idx = feature->GetFieldIndex(comp.attrName.c_str());
-                            if (idx >= 0)
+                            // Compare the value.  Might be a string or a real
+                            switch (comp.compareValueType)
                             {
-                                // Compare the value.  Might be a string or a real
-                                switch (comp.compareValueType)
+                                case MapnikConfig::Filter::Comparison::CompareString:
                                 {
-                                    case MapnikConfig::Filter::Comparison::CompareString:
+                                    const char *strVal = feature->GetFieldAsString(idx);
+                                    switch (comp.compareType)
                                     {
-                                        const char *strVal = feature->GetFieldAsString(idx);
-                                        switch (comp.compareType)
-                                        {
-                                            case MapnikConfig::Filter::Comparison::CompareEqual:
-                                                if (!comp.attrValStr.compare(strVal))
-                                                    clauseApproved = true;
-                                                break;
-                                            case MapnikConfig::Filter::Comparison::CompareNotEqual:
-                                                if (comp.attrValStr.compare(strVal))
-                                                    clauseApproved = true;
-                                                break;
-                                            default:
-                                                fprintf(stderr,"Not expecting value comparison for string.  Giving up.");
-                                                exit(-1);
-                                                break;
-                                        }
+                                        case MapnikConfig::Filter::Comparison::CompareEqual:
+                                            if (!comp.attrValStr.compare(strVal))
+                                                clauseApproved = true;
+                                            break;
+                                        case MapnikConfig::Filter::Comparison::CompareNotEqual:
+                                            if (comp.attrValStr.compare(strVal))
+                                                clauseApproved = true;
+                                            break;
+                                        default:
+                                            fprintf(stderr,"Not expecting value comparison for string.  Giving up.");
+                                            exit(-1);
+                                            break;
                                     }
-                                        break;
-                                    case MapnikConfig::Filter::Comparison::CompareReal:
+                                }
+                                    break;
+                                case MapnikConfig::Filter::Comparison::CompareReal:
+                                {
+                                    double val = feature->GetFieldAsDouble(idx);
+                                    switch (comp.compareType)
                                     {
-                                        double val = feature->GetFieldAsDouble(idx);
-                                        switch (comp.compareType)
-                                        {
-                                            case MapnikConfig::Filter::Comparison::CompareEqual:
-                                                if (val == comp.attrValReal)
-                                                    clauseApproved = true;
-                                                break;
-                                            case MapnikConfig::Filter::Comparison::CompareNotEqual:
-                                                if (val != comp.attrValReal)
-                                                    clauseApproved = true;
-                                                break;
-                                            case MapnikConfig::Filter::Comparison::CompareMore:
-                                                if (val > comp.attrValReal)
-                                                    clauseApproved = true;
-                                                break;
-                                            case MapnikConfig::Filter::Comparison::CompareMoreEqual:
-                                                if (val >= comp.attrValReal)
-                                                    clauseApproved = true;
-                                                break;
-                                            case MapnikConfig::Filter::Comparison::CompareLess:
-                                                if (val < comp.attrValReal)
-                                                    clauseApproved = true;
-                                                break;
-                                            case MapnikConfig::Filter::Comparison::CompareLessEqual:
-                                                if (val <= comp.attrValReal)
-                                                    clauseApproved = true;
-                                                break;
-                                        }
+                                        case MapnikConfig::Filter::Comparison::CompareEqual:
+                                            if (val == comp.attrValReal)
+                                                clauseApproved = true;
+                                            break;
+                                        case MapnikConfig::Filter::Comparison::CompareNotEqual:
+                                            if (val != comp.attrValReal)
+                                                clauseApproved = true;
+                                            break;
+                                        case MapnikConfig::Filter::Comparison::CompareMore:
+                                            if (val > comp.attrValReal)
+                                                clauseApproved = true;
+                                            break;
+                                        case MapnikConfig::Filter::Comparison::CompareMoreEqual:
+                                            if (val >= comp.attrValReal)
+                                                clauseApproved = true;
+                                            break;
+                                        case MapnikConfig::Filter::Comparison::CompareLess:
+                                            if (val < comp.attrValReal)
+                                                clauseApproved = true;
+                                            break;
+                                        case MapnikConfig::Filter::Comparison::CompareLessEqual:
+                                            if (val <= comp.attrValReal)
+                                                clauseApproved = true;
+                                            break;
                                     }
-                                        break;
                                 }
+                                    break;
                             }
-                            
-                            ruleApproved &= clauseApproved;
                         }
+                        
+                        ruleApproved &= clauseApproved;
                     }
-                    
-                    // Add the symbolizers since we approved this rule
-                    if (ruleApproved)
-                    {
-                        attrsToKeep.insert(symGroup.attrs.begin(),symGroup.attrs.end());
-                    }
-                    styleApproved |= ruleApproved;
-                    
-                    approved |= styleApproved;
-
-                    // We may just match the first rule we find
-                    // Note: Everything is filter first now
-                    if (ruleApproved) // && styleInst.style->filterMode == MapnikConfig::FilterFirst)
-                        break;
                 }
+                
+                // Add the symbolizers since we approved this rule
+                if (ruleApproved)
+                {
+                    attrsToKeep.insert(symGroup.attrs.begin(),symGroup.attrs.end());
+                }
+                styleApproved |= ruleApproved;
+                
+                approved |= styleApproved;
+
+                // We may just match the first rule we find
+                // Note: Everything is filter first now
+                if (ruleApproved) // && styleInst.style->filterMode == MapnikConfig::FilterFirst)
+                    break;
             }
         }
+    }
 
-        if (approved)
+    if (!approved)
+        return;
+    
+    // Convert the geometry type, if needed
+    std::vector<OGRGeometry *> geoms;
+    ConvertGeometryType(feature->GetGeometryRef(), dataType,geoms);
+    
+    for (unsigned int igeom=0;igeom<geoms.size();igeom++)
+    {
+        OGRGeometry *geom = geoms[igeom];
+        if (!geom)
+            continue;
+        
+        OGRErr err = geom->transform(transform);
+        if (err != OGRERR_NONE)
         {
-            // Copy to the output
-            // Convert the geometry type, if needed
-            std::vector<OGRGeometry *> geoms;
-            ConvertGeometryType(feature->GetGeometryRef(), dataType,geoms);
-            if (geoms.empty())
-                continue;
+            fprintf(stderr, "Error transforming feature.");
+            exit(-1);
+        }
         
-            for (unsigned int igeom=0;igeom<geoms.size();igeom++)
-            {
-                OGRGeometry *geom = geoms[igeom];
-                OGREnvelope startEnv;
-                
-                if (!geom)
-                    continue;
-                geom->getEnvelope(&startEnv);
-                
-                OGRErr err = geom->transform(transform);
-                if (err != OGRERR_NONE)
-                {
-                    fprintf(stderr, "Error transforming feature.");
-                    exit(-1);
-                }
-                OGREnvelope thisEnv;
-                geom->getEnvelope(&thisEnv);
-                mbr.Merge(thisEnv);
-            }
+        // If there's a clip envelope, do an overlap test first
+        bool withinBounds = true;
+        if (clipEnv)
+        {
+            OGREnvelope geomEnv;
+            geom->getEnvelope(&geomEnv);
+            if (!clipEnv->Contains(geomEnv) && !clipEnv->Intersects(geomEnv))
+                withinBounds = false;
+        }
+        if (withinBounds)
+        {
+            OGRFeature *newFeature = new OGRFeature(outDefn);
+            newFeature->SetGeometryDirectly(geom);
+            geom = NULL;
             
-    //            int numFields = feature->GetFieldCount();
-
-            // Need attributes for the various styles
+            // Now apply the symbolizers (they'll be styles in the final output)
             for (unsigned int ig=0;ig<symGroups.size();ig++)
             {
                 std::string styleIndex = (std::string)"style" + std::to_string(ig);
-                // Make sure the field definition is there
-                OGRFieldDefn fieldDef(styleIndex.c_str(),OFTString);
-                if (outLayer->GetLayerDefn()->GetFieldIndex(styleIndex.c_str()) == -1)
-                    if (outLayer->CreateField(&fieldDef) != OGRERR_NONE)
-                    {
-                        fprintf(stderr,"Unable to create field in output file");
-                        exit(-1);
-                    }
+                std::string uuid = boost::uuids::to_string(symGroups[ig].uuid);
+                newFeature->SetField(styleIndex.c_str(), uuid.c_str());
             }
             
-            // And for the attributes the styles expect
+            // And don't forget the attributes they care about
             for (std::set<std::string>::iterator it = attrsToKeep.begin();
                  it != attrsToKeep.end(); ++it)
             {
-                // Note: Should check the type;
-                OGRFieldDefn fieldDef(it->c_str(),OFTString);
-                if (outLayer->GetLayerDefn()->GetFieldIndex(it->c_str()) == -1)
-                    if (outLayer->CreateField(&fieldDef) != OGRERR_NONE)
-                    {
-                        fprintf(stderr,"Unable to create field in output file");
-                        exit(-1);
-                    }
-            }
-            
-            for (unsigned int igeom=0;igeom<geoms.size();igeom++)
-            {
-                OGRGeometry *geom = geoms[igeom];
-                
-                // If there's a clip envelope, do an overlap test first
-                bool withinBounds = true;
-                if (clipEnv)
+                std::string fieldName = *it;
+                int idx = feature->GetFieldIndex(fieldName.c_str());
+                if (idx != -1)
                 {
-                    OGREnvelope geomEnv;
-                    geom->getEnvelope(&geomEnv);
-                    if (!clipEnv->Contains(geomEnv) && !clipEnv->Intersects(geomEnv))
-                        withinBounds = false;
+                    // Note: Should deal with other types
+                    const char *fieldVal = feature->GetFieldAsString(idx);
+                    if (fieldVal)
+                        newFeature->SetField(fieldName.c_str(), fieldVal);
                 }
-                if (withinBounds)
-                {
-                    
-        //            int whichFeature = outLayer->GetFeatureCount();
-        //            outLayer->CreateFeature(feature);
-        //            OGRFeature *newFeature = outLayer->GetFeature(whichFeature);
-                    OGRFeature *newFeature = new OGRFeature(outLayer->GetLayerDefn());
-                    newFeature->SetGeometry(geom);
-
-                    // Now apply the symbolizers (they'll be styles in the final output)
-        //            int numNewFields = newFeature->GetFieldCount();
-        //                std::string styleIndex = (std::string)"style" + std::to_string(si);
-                    for (unsigned int ig=0;ig<symGroups.size();ig++)
-                    {
-                        std::string styleIndex = (std::string)"style" + std::to_string(ig);
-                        std::string uuid = boost::uuids::to_string(symGroups[ig].uuid);
-                        newFeature->SetField(styleIndex.c_str(), uuid.c_str());
-                    }
-                    
-                    // And don't forget the attributes they care about
-                    for (std::set<std::string>::iterator it = attrsToKeep.begin();
-                         it != attrsToKeep.end(); ++it)
-                    {
-                        std::string fieldName = *it;
-                        int idx = feature->GetFieldIndex(fieldName.c_str());
-                        if (idx != -1)
-                        {
-                            // Note: Should deal with other types
-                            const char *fieldVal = feature->GetFieldAsString(idx);
-                            if (fieldVal)
-                                newFeature->SetField(fieldName.c_str(), fieldVal);
-                        }
-                    }
-                    
-                    outLayer->CreateFeature(newFeature);
-                    OGRFeature::DestroyFeature(newFeature);
-                }
-                delete geoms[igeom];
-                geoms[igeom] = NULL;
             }
+            
+            outFeatures.push_back(newFeature);
         }
+        delete geom;
     }
 }
 
+// One pass over a layer for a given set of styles and data type.
+// The workers share it.  Source features are converted the first time one of them asks and
+//  we hang on to the most recently used results.  The lock only covers the cache bookkeeping,
+//  the reading and converting happen on the worker's own source.
+class ChopPass
+{
+public:
+    // The converted version of a source feature, which may be nothing at all.
+    // These stay valid even if they fall out of the cache.
+    class ConvertedFeature
+    {
+    public:
+        ~ConvertedFeature()
+        {
+            for (unsigned int ii=0;ii<features.size();ii++)
+                OGRFeature::DestroyFeature(features[ii]);
+        }
+        
+        std::vector<OGRFeature *> features;
+    };
+    typedef std::shared_ptr<ConvertedFeature> FeatureRef;
+    
+    ChopPass(LayerSpatialIndex *layerIndex,const std::vector<MapnikConfig::CompiledSymbolizerTable::SymbolizerGroup> &symGroups,MapnikConfig::SymbolDataType dataType,OGREnvelope *clipEnv,unsigned int maxCachedFeatures)
+    : layerIndex(layerIndex), symGroups(symGroups), dataType(dataType), clipEnv(clipEnv),
+      maxCachedFeatures(std::max(maxCachedFeatures,1u)), converted(layerIndex->numFeatures(),false), copiedFeatures(0)
+    {
+        // Fields for the styles and for the attributes they care about
+        defn = new OGRFeatureDefn("layer");
+        defn->Reference();
+        for (unsigned int ig=0;ig<symGroups.size();ig++)
+        {
+            std::string styleIndex = (std::string)"style" + std::to_string(ig);
+            OGRFieldDefn fieldDef(styleIndex.c_str(),OFTString);
+            defn->AddFieldDefn(&fieldDef);
+        }
+        for (unsigned int ig=0;ig<symGroups.size();ig++)
+            for (std::set<std::string>::const_iterator it = symGroups[ig].attrs.begin(); it != symGroups[ig].attrs.end(); ++it)
+            {
+                // Note: Should check the type;
+                OGRFieldDefn fieldDef(it->c_str(),OFTString);
+                if (defn->GetFieldIndex(it->c_str()) == -1)
+                    defn->AddFieldDefn(&fieldDef);
+            }
+    }
+    
+    ~ChopPass()
+    {
+        cache.clear();
+        defn->Release();
+    }
+    
+    // Return the converted features covering a given area, reading any we don't have from the worker's source
+    void findFeatures(SourceReader *reader,double sx,double sy,double ex,double ey,std::vector<FeatureRef> &retFeatures)
+    {
+        std::vector<unsigned int> rets;
+        layerIndex->findFeatures(sx,sy,ex,ey,rets);
+        for (unsigned int ii=0;ii<rets.size();ii++)
+        {
+            FeatureRef feature = fetchFeature(reader,rets[ii]);
+            if (!feature->features.empty())
+                retFeatures.push_back(feature);
+        }
+    }
+    
+    // Number of converted features we've made, counting each source feature once
+    int getCopiedFeatures()
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        return copiedFeatures;
+    }
+    
+    // Definition for the features we produce
+    OGRFeatureDefn *defn;
+    
+protected:
+    typedef std::list<unsigned int> EntryList;
+    typedef std::pair<FeatureRef,EntryList::iterator> CacheEntry;
+    typedef std::unordered_map<unsigned int,CacheEntry> FeatureCache;
+    
+    // Look for a feature in the cache, if it's there.  Caller holds the lock.
+    FeatureRef findCached(unsigned int which)
+    {
+        FeatureCache::iterator it = cache.find(which);
+        if (it == cache.end())
+            return FeatureRef();
+        // Most recently used goes to the front
+        lru.splice(lru.begin(),lru,it->second.second);
+        return it->second.first;
+    }
+    
+    // Return the converted version of an index entry
+    FeatureRef fetchFeature(SourceReader *reader,unsigned int which)
+    {
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            FeatureRef ref = findCached(which);
+            if (ref)
+                return ref;
+        }
+        
+        // Read and convert it on our own source, outside the lock
+        FeatureRef ref(new ConvertedFeature());
+        OGRFeature *feature = reader->layer->GetFeature(layerIndex->getFID(which));
+        if (feature)
+        {
+            ConvertFeature(feature,reader->transform,symGroups,dataType,clipEnv,defn,ref->features);
+            OGRFeature::DestroyFeature(feature);
+        }
+        
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (!converted[which])
+        {
+            converted[which] = true;
+            copiedFeatures += (int)ref->features.size();
+        }
+        
+        // Someone else may have beaten us to it
+        FeatureRef otherRef = findCached(which);
+        if (otherRef)
+            return otherRef;
+        
+        // Kick out the oldest if we're full
+        if (cache.size() >= maxCachedFeatures)
+        {
+            cache.erase(lru.back());
+            lru.pop_back();
+        }
+        lru.push_front(which);
+        cache[which] = CacheEntry(ref,lru.begin());
+        
+        return ref;
+    }
+    
+    LayerSpatialIndex *layerIndex;
+    std::vector<MapnikConfig::CompiledSymbolizerTable::SymbolizerGroup> symGroups;
+    MapnikConfig::SymbolDataType dataType;
+    OGREnvelope *clipEnv;
+    
+    std::mutex cacheMutex;
+    unsigned int maxCachedFeatures;
+    FeatureCache cache;
+    EntryList lru;
+    // Entries we've converted at least once
+    std::vector<bool> converted;
+    int copiedFeatures;
+};
+
 // Clip the input layer to the given box
-void ClipInputToBox(LayerSpatialIndex *layer,double llX,double llY,double urX,double urY,OGRSpatialReference *out_srs,std::vector<OGRFeature *> &outFeatures,OGRCoordinateTransformation *tileTransform)
+void ClipInputToBox(ChopPass *pass,SourceReader *reader,double llX,double llY,double urX,double urY,std::vector<OGRFeature *> &outFeatures,OGRCoordinateTransformation *tileTransform)
 {
     // Set up the clipping layer
     OGRPolygon poly;
@@ -415,34 +580,31 @@ void ClipInputToBox(LayerSpatialIndex *layer,double llX,double llY,double urX,do
     ring.addPoint(urX,llY);
     ring.addPoint(llX,llY);
     poly.addRing(&ring);
-    OGREnvelope mbr;
-    mbr.MinX = llX;  mbr.MinY = llY;
-    mbr.MaxX = urX;  mbr.MaxY = urY;
     
-    std::vector<OGRFeature *> features;
-    layer->findFeatures(llX,llY,urX,urY,features);
+    std::vector<ChopPass::FeatureRef> features;
+    pass->findFeatures(reader,llX,llY,urX,urY,features);
     for (unsigned int ii=0;ii<features.size();ii++)
-    {
-        OGRFeature *inFeature = features[ii];
-//            int numFields = inFeature->GetFieldCount();
-        OGRGeometry *geom = inFeature->GetGeometryRef();
-        try {
-            OGRGeometry *clipGeom = geom->Intersection(&poly);
-            if (clipGeom && !clipGeom->IsEmpty())
-            {
-                if (tileTransform)
-                    clipGeom->transform(tileTransform);
-                OGRFeature *feature = inFeature->Clone();
-                feature->SetGeometryDirectly(clipGeom);
-                outFeatures.push_back(feature);
-            } else if (clipGeom)
-                delete clipGeom;
-        }
-        catch (...)
+        for (unsigned int fi=0;fi<features[ii]->features.size();fi++)
         {
-            fprintf(stderr,"Unhappy intersection call.  Punting geometry.");
+            OGRFeature *inFeature = features[ii]->features[fi];
+            OGRGeometry *geom = inFeature->GetGeometryRef();
+            try {
+                OGRGeometry *clipGeom = geom->Intersection(&poly);
+                if (clipGeom && !clipGeom->IsEmpty())
+                {
+                    if (tileTransform)
+                        clipGeom->transform(tileTransform);
+                    OGRFeature *feature = inFeature->Clone();
+                    feature->SetGeometryDirectly(clipGeom);
+                    outFeatures.push_back(feature);
+                } else if (clipGeom)
+                    delete clipGeom;
+            }
+            catch (...)
+            {
+                fprintf(stderr,"Unhappy intersection call.  Punting geometry.");
+            }
         }
-    }
 }
 
 /************************************************************************/
@@ -473,12 +635,9 @@ char *SanitizeSRS( const char *pszUserInput )
     return pszResult;
 }
 
-// Get the driver once to save time
-OGRSFDriver *shpDriver = NULL;
-OGRSFDriver *memDriver = NULL;
-
 // Merge the given features into an existing shapefile or create a new one
-bool MergeIntoShapeFile(std::vector<OGRFeature *> &features,OGRLayer *srcLayer,OGRSpatialReference *out_srs,const char *fileName)
+// Workers pass in their own driver handle
+bool MergeIntoShapeFile(OGRSFDriver *shpDriver,std::vector<OGRFeature *> &features,OGRFeatureDefn *featureDfn,OGRSpatialReference *out_srs,const char *fileName)
 {
     // Look for an existing shapefile
     OGRLayer *destLayer = NULL;
@@ -503,8 +662,7 @@ bool MergeIntoShapeFile(std::vector<OGRFeature *> &features,OGRLayer *srcLayer,O
         }
     }
     
-    // Add the various fields from one layer into another
-    OGRFeatureDefn *featureDfn = srcLayer->GetLayerDefn();
+    // Add the various fields from the source definition
     if (featureDfn)
         for (unsigned int ii=0;ii<featureDfn->GetFieldCount();ii++)
         {
@@ -550,6 +708,15 @@ public:
         numTiles = 0;
     }
     
+    // Fold in the stats from another worker
+    void merge(const BuildStats &that)
+    {
+        minFeat = std::min(minFeat,that.minFeat);
+        maxFeat = std::max(maxFeat,that.maxFeat);
+        featAvg += that.featAvg;
+        numTiles += that.numTiles;
+    }
+    
     int minFeat,maxFeat;
     double featAvg;
     int numTiles;
@@ -565,194 +732,362 @@ public:
     }
 };
 
-// Load the data and test it against the bounding box.
-// Return a copy that's just within the bounding box
-OGRDataSource *LoadAndCheck(const char *inputFile,OGREnvelope *clipEnv,OGRSpatialReference *hTrgSRS,std::vector<OGRFeature *> &validFeatures)
+// Merge vectors from the source into the dest
+void MergeDataIntoLayer(OGRLayer *destLayer,OGRLayer *srcLayer)
 {
-    OGRDataSource *poDS = shpDriver->Open(inputFile);
-    if( poDS == NULL )
-    {
-        fprintf(stderr, "Couldn't open file: %s\n",inputFile);
-        exit( 1 );
-    }
     
-    OGRSpatialReference *this_srs = poDS->GetLayer(0)->GetSpatialRef();
-    for (unsigned int jj=0;jj<poDS->GetLayerCount();jj++)
-    {
-        // Copy the input layer into memory and reproject it
-        OGRLayer *inLayer = poDS->GetLayer(jj);
-        //        fprintf(stdout,"            Layer: %s, %d features\n",inLayer->GetName(),inLayer->GetFeatureCount());
-        
-        OGREnvelope psExtent;
-        inLayer->GetExtent(&psExtent);
-        
-        // Transform and copy features
-        OGRCoordinateTransformation *transform = OGRCreateCoordinateTransformation(this_srs,hTrgSRS);
-        //        char *this_srs_out = NULL;
-        //        this_srs->exportToWkt(&this_srs_out);
-        //        char *trg_srs_out = NULL;
-        //        hTrgSRS->exportToWkt(&trg_srs_out);
-        if (!transform)
-        {
-            fprintf(stderr,"Can't transform from coordinate system to destination for: %s\n",inputFile);
-            exit(-1);
-        }
+}
 
-        // Work through the features
-        for (unsigned int fi=0;fi<inLayer->GetFeatureCount();fi++)
-        {
-            OGRFeature *feature = inLayer->GetFeature(fi);
-            
-            // Transform the MBR
-            OGREnvelope mbr;
-            feature->GetGeometryRef()->getEnvelope(&mbr);
-            OGRLinearRing *geom = new OGRLinearRing();
-            geom->addPoint(mbr.MinX, mbr.MinY);
-            geom->addPoint(mbr.MaxX, mbr.MinY);
-            geom->addPoint(mbr.MaxX, mbr.MaxY);
-            geom->addPoint(mbr.MinX, mbr.MaxY);
-            geom->transform(transform);
-            OGREnvelope finalMbr;
-            geom->getEnvelope(&finalMbr);
+// One layer's worth of a tile, encoded and ready to go into the database
+class EncodedTile
+{
+public:
+    EncodedTile() : x(0), layerID(0) { }
+    
+    int x;
+    int layerID;
+    std::string outLayerName;
+    std::vector<unsigned char> data;
+    // Set if the encoding failed
+    std::string error;
+};
 
-            // See if it's within the bounds we're building
-            bool withinBounds = true;
-            if (clipEnv)
+// All the tiles in a row, in the order they'll be written
+class EncodedRow
+{
+public:
+    EncodedRow() : level(0), y(0), hasData(false) { }
+    
+    int level,y;
+    // Set if any cell had features, even if there's no database to encode them for
+    bool hasData;
+    std::vector<EncodedTile> tiles;
+};
+
+// Where the encoded tiles end up
+class TileOutputInfo
+{
+public:
+    Maply::VectorDatabase *vectorDb;
+    bool mergeLayers;
+    // Layer name to vector database layer
+    std::map<std::string,int> layerIDs;
+    const char *webDbName,*webDbDir;
+};
+
+// Write a row of encoded tiles to the vector database and the web DB if there is one
+bool WriteEncodedRow(EncodedRow *row,TileOutputInfo *output)
+{
+    int level = row->level, iy = row->y;
+    for (unsigned int ti=0;ti<row->tiles.size();ti++)
+    {
+        EncodedTile &tile = row->tiles[ti];
+        int ix = tile.x;
+        try {
+            if (!tile.error.empty())
+                throw tile.error;
+            
+            std::vector<unsigned char> &vecData = tile.data;
+            if (vecData.empty())
+                continue;
+            output->vectorDb->addVectorTile(ix, iy, level, tile.layerID, (const char *)&vecData[0], (int)vecData.size());
+            
+            // Also write it out to the web DB if needed
+            if (output->webDbName)
             {
-                if (!clipEnv->Contains(finalMbr) && !clipEnv->Intersects(finalMbr))
-                    withinBounds = false;
+                std::string cellDir = (std::string)output->webDbDir + "/" + std::to_string(level) + "/" + std::to_string(ix) + "/";
+                std::string cellFileName = cellDir + std::to_string(iy) + tile.outLayerName + ".mvt";
+                void *compressOut;
+                int compressSize=0;
+                // Need to compress the tiles first
+                if (Maply::CompressData((void *)&vecData[0], (int)vecData.size(), &compressOut, compressSize))
+                {
+                    mkdir(cellDir.c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+                    FILE *fp = fopen(cellFileName.c_str(),"w");
+                    if (!fp)
+                    {
+                        fprintf(stderr,"Failed to open file for write: %s\n",cellFileName.c_str());
+                        exit(-1);
+                    }
+                    if (fwrite(compressOut,compressSize,1,fp) != 1)
+                    {
+                        fprintf(stderr,"Failed to write to file: %s\n",cellFileName.c_str());
+                        exit(-1);
+                    }
+                    fclose(fp);
+                } else {
+                    fprintf(stderr,"Tile compression failed for %d: (%d,%d)\n",level,ix,iy);
+                    exit(-1);
+                }
             }
-            
-            if (withinBounds)
-                validFeatures.push_back(feature);
-            else
-                delete feature;
         }
-        
-        delete transform;
+        catch (std::string &errorStr)
+        {
+            fprintf(stderr,"Unable to write tile %d: (%d,%d)\nBecause: %s\n",level,ix,iy,errorStr.c_str());
+            return false;
+        }
     }
     
-    return poDS;
+    return true;
 }
 
-// Chop up a shapefile into little bits
-void ChopShapefile(const char *layerName,OGRDataSource *poDS,std::vector<OGRFeature *> &inFeatures,std::vector<MapnikConfig::CompiledSymbolizerTable::SymbolizerGroup> &symGroups, MapnikConfig::SymbolDataType dataType,const char *targetDir,double xmin,double ymin,double xmax,double ymax,int level,OGRSpatialReference *hTrgSRS,OGRSpatialReference *hTileSRS,BuildStats &stats,OGREnvelope &totalEnv,OGREnvelope *clipEnv,int &copiedFeatures)
+// Features for one layer in one cell, by data type
+typedef std::vector<std::vector<OGRFeature *> > LayerFeatures;
+// All the layers in a cell, by name.  That's the order they get encoded in.
+typedef std::map<std::string,LayerFeatures> CellFeatures;
+
+// A layer from the config, its index and which of its styles are done
+class ChopLayer
 {
-    // Number of cells at this level
-    int numCells = 1<<level;
-    double cellSizeX = (xmax-xmin)/numCells;
-    double cellSizeY = (ymax-ymin)/numCells;
-    
-//    fprintf(stdout,"Input File: %s\n",inputFile);
-//    fprintf(stdout,"            %d layers\n",poDS->GetLayerCount());
+public:
+    ChopLayer(MapnikConfig *mapnikConfig,MapnikConfig::Layer &inLayer)
+    : inLayer(inLayer), sortedLayer(mapnikConfig,inLayer), layerIndex(NULL)
+    {
+        sortedStylesDone.resize(sortedLayer.sortStyles.size(),false);
+    }
     
-    // Work through the layers
-//    for (unsigned int jj=0;jj<poDS->GetLayerCount();jj++)
+    ~ChopLayer()
     {
-        // Copy the input layer into memory and reproject it
-        OGRLayer *inLayer = poDS->GetLayer(0);
-        OGRSpatialReference *this_srs = inLayer->GetSpatialRef();
-        //        fprintf(stdout,"            Layer: %s, %d features\n",inLayer->GetName(),inLayer->GetFeatureCount());
-        
-        OGREnvelope psExtent;
-        inLayer->GetExtent(&psExtent);
-        
-        // Transform and copy features
-        OGRCoordinateTransformation *transform = OGRCreateCoordinateTransformation(this_srs,hTrgSRS);
-        //        char *this_srs_out = NULL;
-        //        this_srs->exportToWkt(&this_srs_out);
-        //        char *trg_srs_out = NULL;
-        //        hTrgSRS->exportToWkt(&trg_srs_out);
-        if (!transform)
-        {
-            fprintf(stderr,"Can't transform from coordinate system to destination for input\n");
-            exit(-1);
-        }
-        OGRCoordinateTransformation *tileTransform = OGRCreateCoordinateTransformation(hTrgSRS,hTileSRS);
-        if (!tileTransform)
-        {
-            fprintf(stderr,"Can't transform from coordinate system to tile for input file\n");
-            exit(-1);
-        }
+        delete layerIndex;
+    }
+    
+    MapnikConfig::Layer &inLayer;
+    MapnikConfig::SortedLayer sortedLayer;
+    std::vector<bool> sortedStylesDone;
+    std::string srcFileName;
+    LayerSpatialIndex *layerIndex;
+};
 
-        OGRDataSource *memDS = memDriver->CreateDataSource("memory");
-        OGRLayer *layer = memDS->CreateLayer("layer",hTrgSRS);
+// One style pass over a layer for the level we're chopping
+class ChopLevelPass
+{
+public:
+    ChopLevelPass() : layer(0), pass(NULL) { }
+    
+    // Which layer in the group
+    int layer;
+    std::string layerName;
+    MapnikConfig::SymbolDataType dataType;
+    ChopPass *pass;
+};
 
-        // We'll also apply any rules and attribute changes at this point
-        TransformLayer(inLayer,inFeatures,layer,transform,symGroups,dataType,clipEnv,psExtent);
-        LayerSpatialIndex layerIndex(layer);
-        copiedFeatures += layer->GetFeatureCount();
-        
-        // Which cells might we be covering
-        int sx = floor((psExtent.MinX - xmin) / cellSizeX);
-        int sy = floor((psExtent.MinY - ymin) / cellSizeY);
-        int ex = ceil((psExtent.MaxX - xmin) / cellSizeX);
-        int ey = ceil((psExtent.MaxY - ymin) / cellSizeY);
-        sx = std::max(sx,0);  sy = std::max(sy,0);
-        ex = std::min(ex,numCells-1);  ey = std::min(ey,numCells-1);
+// Everything the chopping workers share for a group of layers at one level
+class ChopLevelInfo
+{
+public:
+    std::vector<ChopLayer *> *layers;
+    std::vector<ChopLevelPass> passes;
+    const char *targetDir;
+    int level;
+    double xmin,ymin,cellSizeX,cellSizeY;
+    int sx,sy,ex,ey;
+    OGRSpatialReference *hTrgSRS,*hTileSRS;
+    OGREnvelope *clipEnv;
+    // Encode tiles for this if we're building a database
+    TileOutputInfo *output;
+    // Write clipped features out to per-cell shapefiles
+    bool writeShapefiles;
+    // Finished rows go back to the main thread in order
+    OrderedWorkQueue<EncodedRow> *queue;
+};
+
+// What a single chopping worker produced
+class ChopRowsResult
+{
+public:
+    ChopRowsResult() : envSet(false) { }
+    
+    BuildStats stats;
+    OGREnvelope totalEnv;
+    bool envSet;
+};
+
+// Clip whole rows of cells for every pass until there are none left.
+// A row only goes to one worker, so each cell's shapefile only has one writer.
+// Each finished row is encoded and handed back, so we only ever hold a few rows of features.
+// The spatial indices are only read here.  The sources, intersections and tile transform are our own.
+void ChopRows(ChopLevelInfo *info,ChopRowsResult *result)
+{
+    // Our own handle on each of the sources
+    std::vector<SourceReader *> readers(info->layers->size(),NULL);
+    for (unsigned int pi=0;pi<info->passes.size();pi++)
+    {
+        int which = info->passes[pi].layer;
+        if (!readers[which])
+            readers[which] = new SourceReader(info->layers->at(which)->srcFileName,info->hTrgSRS);
+    }
+    
+    OGRCoordinateTransformation *tileTransform = OGRCreateCoordinateTransformation(info->hTrgSRS,info->hTileSRS);
+    if (!tileTransform)
+    {
+        fprintf(stderr,"Can't transform from coordinate system to tile for input file\n");
+        exit(-1);
+    }
+    
+    int which;
+    while (info->queue->claim(which))
+    {
+        int iy = info->sy + which;
+        EncodedRow *row = new EncodedRow();
+        row->level = info->level;
+        row->y = iy;
         
-        // Work through the possible cells
-        for (unsigned int iy=sy;iy<=ey;iy++)
+        for (int ix=info->sx;ix<=info->ex;ix++)
         {
-            for (unsigned int ix=sx;ix<=ex;ix++)
+            // Clip the input geometry to this cell
+            OGREnvelope cellEnv;
+            cellEnv.MinX = ix*info->cellSizeX+info->xmin;
+            cellEnv.MinY = iy*info->cellSizeY+info->ymin;
+            cellEnv.MaxX = (ix+1)*info->cellSizeX+info->xmin;
+            cellEnv.MaxY = (iy+1)*info->cellSizeY+info->ymin;
+            
+            // Check against clip bounds
+            OGREnvelope *clipEnv = info->clipEnv;
+            if (clipEnv && !(clipEnv->Intersects(cellEnv) || clipEnv->Contains(cellEnv)))
+                continue;
+            
+            // Make sure we include the clipping box
+            OGREnvelope toClipEnv = cellEnv;
+            if (clipEnv)
+                toClipEnv.Intersect(*clipEnv);
+            
+            if (result->envSet)
+                result->totalEnv.Merge(cellEnv);
+            else {
+                result->totalEnv = cellEnv;
+                result->envSet = true;
+            }
+            
+            CellFeatures cellFeatures;
+            for (unsigned int pi=0;pi<info->passes.size();pi++)
             {
-                std::string cellDir = (std::string)targetDir + "/" + std::to_string(iy) + "/";
-                std::string cellFileName = cellDir + std::to_string(ix) + ".shp";
-                
-                // Clip the input geometry to this cell
-                OGREnvelope cellEnv;
-                cellEnv.MinX = ix*cellSizeX+xmin;
-                cellEnv.MinY = iy*cellSizeY+ymin;
-                cellEnv.MaxX = (ix+1)*cellSizeX+xmin;
-                cellEnv.MaxY = (iy+1)*cellSizeY+ymin;
-                
-                // Check against clip bounds
-                if (clipEnv && !(clipEnv->Intersects(cellEnv) || clipEnv->Contains(cellEnv)))
-                    continue;
-                
-                // Make sure we include the clipping box
-                OGREnvelope toClipEnv = cellEnv;
-                if (clipEnv)
-                    toClipEnv.Intersect(*clipEnv);
-                
-                totalEnv.Merge(cellEnv);
-                
+                ChopLevelPass &levelPass = info->passes[pi];
                 std::vector<OGRFeature *> clippedFeatures;
-                ClipInputToBox(&layerIndex,toClipEnv.MinX,toClipEnv.MinY,toClipEnv.MaxX,toClipEnv.MaxY,hTrgSRS,clippedFeatures,tileTransform);
+                ClipInputToBox(levelPass.pass,readers[levelPass.layer],toClipEnv.MinX,toClipEnv.MinY,toClipEnv.MaxX,toClipEnv.MaxY,clippedFeatures,tileTransform);
                 
-                //                    fprintf(stdout, "            Cell (%d,%d):  %d features\n",ix,iy,cellLayer->GetFeatureCount());
-                
-                // Clean up and flush output data
+                BuildStats &stats = result->stats;
                 int numFeat = (int)clippedFeatures.size();
                 stats.minFeat = std::min(stats.minFeat,numFeat);
                 stats.maxFeat = std::max(stats.maxFeat,numFeat);
                 stats.numTiles++;
                 stats.featAvg += numFeat;
-                if (numFeat > 0)
+                if (numFeat == 0)
+                    continue;
+                
+                if (info->writeShapefiles)
                 {
-                    std::string cellDir = (std::string)targetDir + "/" + std::to_string(level) + "/" + std::to_string(iy) + "/";
+                    const char *typeName = (levelPass.dataType == MapnikConfig::SymbolDataPoint ? "_p" : ((levelPass.dataType == MapnikConfig::SymbolDataLinear) ? "_l" : ((levelPass.dataType == MapnikConfig::SymbolDataAreal) ? "_a" : "_u")));
+                    std::string cellDir = (std::string)info->targetDir + "/" + std::to_string(info->level) + "/" + std::to_string(iy) + "/";
                     mkdir(cellDir.c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
-                    const char *typeName = (dataType == MapnikConfig::SymbolDataPoint ? "_p" : ((dataType == MapnikConfig::SymbolDataLinear) ? "_l" : ((dataType == MapnikConfig::SymbolDataAreal) ? "_a" : "_u")));
-                    std::string cellFileName = cellDir + std::to_string(ix) + layerName + typeName + ".shp";
-                    if (!MergeIntoShapeFile(clippedFeatures,layer,hTileSRS,cellFileName.c_str()))
+                    std::string cellFileName = cellDir + std::to_string(ix) + levelPass.layerName + typeName + ".shp";
+                    if (!MergeIntoShapeFile(readers[levelPass.layer]->shpDriver,clippedFeatures,levelPass.pass->defn,info->hTileSRS,cellFileName.c_str()))
                         exit(-1);
                 }
                 
-                for (unsigned int ii=0;ii<clippedFeatures.size();ii++)
-                    OGRFeature::DestroyFeature(clippedFeatures[ii]);
+                // Hang on to them until the cell is encoded
+                LayerFeatures &layerFeatures = cellFeatures[levelPass.layerName];
+                if (layerFeatures.empty())
+                    layerFeatures.resize(MapnikConfig::SymbolDataUnknown);
+                std::vector<OGRFeature *> &dest = layerFeatures[levelPass.dataType];
+                dest.insert(dest.end(),clippedFeatures.begin(),clippedFeatures.end());
+            }
+            if (cellFeatures.empty())
+                continue;
+            row->hasData = true;
+            
+            // Layers are sorted by name and each one is sorted by data type
+            std::vector<OGRFeature *> layerFeatures;
+            for (CellFeatures::iterator lit = cellFeatures.begin(); lit != cellFeatures.end(); ++lit)
+            {
+                for (unsigned int di=0;di<lit->second.size();di++)
+                    layerFeatures.insert(layerFeatures.end(),lit->second[di].begin(),lit->second[di].end());
+                
+                CellFeatures::iterator nextLit = lit;  ++nextLit;
+                if (info->output && (!info->output->mergeLayers || nextLit == cellFeatures.end()))
+                {
+                    row->tiles.resize(row->tiles.size()+1);
+                    EncodedTile &tile = row->tiles.back();
+                    tile.x = ix;
+                    if (!info->output->mergeLayers)
+                    {
+                        tile.layerID = info->output->layerIDs[lit->first];
+                        tile.outLayerName = lit->first;
+                    } else {
+                        tile.layerID = 0;
+                        tile.outLayerName = "";
+                    }
+                    
+                    try {
+                        info->output->vectorDb->vectorToDBFormat(layerFeatures, tile.data);
+                    }
+                    catch (std::string &errorStr)
+                    {
+                        tile.error = errorStr;
+                    }
+                    layerFeatures.clear();
+                }
             }
+            
+            for (CellFeatures::iterator lit = cellFeatures.begin(); lit != cellFeatures.end(); ++lit)
+                for (unsigned int di=0;di<lit->second.size();di++)
+                    for (unsigned int fi=0;fi<lit->second[di].size();fi++)
+                        OGRFeature::DestroyFeature(lit->second[di][fi]);
         }
         
-        OGRDataSource::DestroyDataSource(memDS);
-        delete tileTransform;
-        delete transform;
+        info->queue->finish(which,row);
     }
+    
+    delete tileTransform;
+    for (unsigned int ri=0;ri<readers.size();ri++)
+        delete readers[ri];
 }
 
-// Merge vectors from the source into the dest
-void MergeDataIntoLayer(OGRLayer *destLayer,OGRLayer *srcLayer)
+// Chop a group of layers for one level.  That's one layer or, if we're merging, all of them.
+// The workers clip and encode whole rows and we write them out here, in row order, as they finish.
+// Rows with any data in them are added to rowsWithData.
+bool ChopLevel(ChopLevelInfo &chopInfo,int numThreads,BuildStats &stats,OGREnvelope &totalEnv,std::set<std::pair<int,int> > &rowsWithData)
 {
+    int numRows = chopInfo.ey-chopInfo.sy+1;
+    if (chopInfo.passes.empty() || numRows <= 0)
+        return true;
+    
+    OrderedWorkQueue<EncodedRow> rowQueue(numRows,4*numThreads);
+    chopInfo.queue = &rowQueue;
+    int numWorkers = std::max(1,std::min(numThreads,numRows));
+    std::vector<ChopRowsResult> results(numWorkers);
+    std::vector<std::thread> workers;
+    for (unsigned int ti=0;ti<numWorkers;ti++)
+        workers.push_back(std::thread(ChopRows,&chopInfo,&results[ti]));
+    
+    bool failed = false;
+    while (EncodedRow *row = rowQueue.next())
+    {
+        if (row->hasData)
+            rowsWithData.insert(std::make_pair(row->level,row->y));
+        if (chopInfo.output)
+            failed = !WriteEncodedRow(row,chopInfo.output);
+        delete row;
+        
+        if (failed)
+        {
+            rowQueue.setFailed();
+            break;
+        }
+    }
+    
+    for (unsigned int ti=0;ti<workers.size();ti++)
+        workers[ti].join();
+    chopInfo.queue = NULL;
+    
+    // Min/max merges, so the order doesn't matter
+    for (unsigned int ti=0;ti<numWorkers;ti++)
+    {
+        stats.merge(results[ti].stats);
+        if (results[ti].envSet)
+            totalEnv.Merge(results[ti].totalEnv);
+    }
     
+    return !failed;
 }
 
 // This is the map scale for the given level.
@@ -778,10 +1113,14 @@ int main(int argc, char * argv[])
     double clipXmin,clipYmin,clipXmax,clipYmax;
     int minLevel = -1,maxLevel = -1;
     bool mergeLayers = false;
+    bool keepShapefiles = false;
     const char *webDbName = NULL,*webDbDir = NULL,*webDbURL = NULL;
     std::vector<std::string> pathRedirect;
     float levelScale = 4;
     MapnikConfig::Symbolizer::TileGeometryType tileGeomType = MapnikConfig::Symbolizer::TileGeomAdd;
+    int numThreads = 1;
+    int maxCachedFeatures = 100000;
+    int dbBatchSize = 1000;
     
     GDALAllRegister();
     OGRRegisterAll();
@@ -904,6 +1243,10 @@ int main(int argc, char * argv[])
         {
             numArgs = 1;
             mergeLayers = true;
+        } else if (EQUAL(argv[ii],"-shapefiles"))
+        {
+            numArgs = 1;
+            keepShapefiles = true;
         } else if (EQUAL(argv[ii],"-webdb"))
         {
             numArgs = 4;
@@ -939,6 +1282,48 @@ int main(int argc, char * argv[])
                 fprintf(stderr,"Expecting non-zero number for -levelscale\n");
                 return -1;
             }
+        } else if (EQUAL(argv[ii],"-threads"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting one argument for -threads\n");
+                return -1;
+            }
+            numThreads = atoi(argv[ii+1]);
+            if (numThreads < 1)
+            {
+                fprintf(stderr,"Expecting at least one thread for -threads\n");
+                return -1;
+            }
+        } else if (EQUAL(argv[ii],"-featurecache"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting one argument for -featurecache\n");
+                return -1;
+            }
+            maxCachedFeatures = atoi(argv[ii+1]);
+            if (maxCachedFeatures < 1)
+            {
+                fprintf(stderr,"Expecting at least one feature for -featurecache\n");
+                return -1;
+            }
+        } else if (EQUAL(argv[ii],"-dbbatch"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting one argument for -dbbatch\n");
+                return -1;
+            }
+            dbBatchSize = atoi(argv[ii+1]);
+            if (dbBatchSize < 1)
+            {
+                fprintf(stderr,"Expecting at least one tile for -dbbatch\n");
+                return -1;
+            }
         } else if (EQUAL(argv[ii],"-tilegeom"))
         {
             numArgs = 1;
@@ -993,18 +1378,12 @@ int main(int argc, char * argv[])
         mkdir(shapeCacheDir,S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
     }
     
-    shpDriver = OGRSFDriverRegistrar::GetRegistrar()->GetDriverByName("ESRI Shapefile" );
-    if (!shpDriver)
+    // Workers look up their own, but make sure it's there before we start
+    if (!OGRSFDriverRegistrar::GetRegistrar()->GetDriverByName("ESRI Shapefile" ))
     {
         fprintf(stderr, "Couldn't get shape file driver");
         return -1;
     }
-    memDriver = OGRSFDriverRegistrar::GetRegistrar()->GetDriverByName("Memory");
-    if (!memDriver)
-    {
-        fprintf(stderr, "Couldn't get memory driver");
-        return -1;
-    }
     
     // If the XML config file is here, try to parse it
     MapnikConfig *mapnikConfig = NULL;
@@ -1038,6 +1417,9 @@ int main(int argc, char * argv[])
     {
         system(((std::string) "rm -rf " + webDbDir).c_str() );
         mkdir(webDbDir,S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+        // Tiles get written out as we go, so we need all the levels
+        for (int level = minLevel;level<=maxLevel;level++)
+            mkdir(((std::string)webDbDir+"/"+std::to_string(level)).c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
     }
     
     // Set up a coordinate transformation
@@ -1072,32 +1454,107 @@ int main(int argc, char * argv[])
 
     // Keep track of what we've built
     BuildStats buildStats;
-    std::set<std::string> layerNames;
     OGREnvelope fullExtents;
     
+    // If there's a target DB we'll encode the clipped features straight into it as we go
+    Kompex::SQLiteDatabase *sqliteDb = NULL;
+    Maply::VectorDatabase *vectorDb = NULL;
+    TileOutputInfo tileOutput;
+    std::vector<std::string> outLayerNames;
+    if (targetDb && mapnikConfig)
+    {
+        fprintf(stdout,"Writing to vector DB: %s\n",targetDb);
+
+        remove(targetDb);
+        sqliteDb = new Kompex::SQLiteDatabase(targetDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0);
+        if (!sqliteDb->GetDatabaseHandle())
+        {
+            fprintf(stderr, "Invalid sqlite database: %s\n",targetDb);
+            return -1;
+        }
+        
+        try {
+            // Set up the vector DB.  We'll fix the levels once we know what we've got.
+            vectorDb = new Maply::VectorDatabase();
+            vectorDb->setupDatabase(sqliteDb, destSRS, tileSRS, xmin, ymin, ymax, ymax, minLevel, maxLevel, true);
+            
+            // Set up the layer tables
+            std::set<std::string> configLayerNames;
+            for (unsigned int ii=0;ii<mapnikConfig->layers.size();ii++)
+                configLayerNames.insert(mapnikConfig->layers[ii].name);
+            if (!mergeLayers)
+            {
+                for (std::set<std::string>::iterator it = configLayerNames.begin();it != configLayerNames.end(); ++it)
+                {
+                    const std::string &layerName = *it;
+                    tileOutput.layerIDs[layerName] = vectorDb->addVectorLayer(layerName.c_str());
+                    outLayerNames.push_back(layerName);
+                }
+            } else {
+                vectorDb->addVectorLayer("all");
+                outLayerNames.push_back("");
+            }
+            
+            // Tiles are compressed in the background and committed in batches
+            if (!vectorDb->startWriter(numThreads, dbBatchSize))
+                throw (std::string)"Couldn't set up the tile writer";
+        }
+        catch (const std::string &what)
+        {
+            fprintf(stderr,"Failed to write to target DB because:\n%s\n",what.c_str());
+            return -1;
+        }
+        
+        tileOutput.vectorDb = vectorDb;
+        tileOutput.mergeLayers = mergeLayers;
+        tileOutput.webDbName = webDbName;
+        tileOutput.webDbDir = webDbDir;
+    }
+    // Without a database the shapefiles are the output
+    bool writeShapefiles = keepShapefiles || !vectorDb;
+    
     int minLevelSeen = 10000;
     int maxLevelSeen = 0;
+    // Rows (level,y) that have had data in them
+    std::set<std::pair<int,int> > rowsWithData;
     if (mapnikConfig)
     {
-        // Work through the layers
+        // Layers get chopped on their own unless we're merging them into the same tiles.
+        // In that case we chop all of them together, a row at a time.
+        std::vector<std::vector<int> > layerGroups;
         for (unsigned int ii=0;ii<mapnikConfig->layers.size();ii++)
         {
-            MapnikConfig::Layer &inLayer = mapnikConfig->layers[ii];
-            
-            fprintf(stdout,"Data Source: %s\n",inLayer.name.c_str());
-            fflush(stdout);
-
-            // Load the data into memory reprojected and bounds checked
-            std::vector<OGRFeature *> inFeatures;
-            OGRDataSource *inDataSource = LoadAndCheck(inLayer.dataSources[0]->getShapefileName(&inLayer,(shapeCacheDir ? shapeCacheDir : targetDir)).c_str(),(clipBoundsSet ? &clipBounds : NULL),hTrgSRS,inFeatures);
-            
-            MapnikConfig::SortedLayer layer(mapnikConfig,inLayer);
-            if (!layer.isValid())
+            if (!mergeLayers || layerGroups.empty())
+                layerGroups.resize(layerGroups.size()+1);
+            layerGroups.back().push_back(ii);
+        }
+        
+        // Work through the layers
+        for (unsigned int gi=0;gi<layerGroups.size();gi++)
+        {
+            std::vector<ChopLayer *> layers;
+            for (unsigned int li=0;li<layerGroups[gi].size();li++)
             {
-                fprintf(stderr,"Problem parsing layer definition: %s\n",inLayer.name.c_str());
-                exit(-1);
+                MapnikConfig::Layer &inLayer = mapnikConfig->layers[layerGroups[gi][li]];
+                
+                fprintf(stdout,"Data Source: %s\n",inLayer.name.c_str());
+                fflush(stdout);
+                
+                ChopLayer *chopLayer = new ChopLayer(mapnikConfig,inLayer);
+                if (!chopLayer->sortedLayer.isValid())
+                {
+                    fprintf(stderr,"Problem parsing layer definition: %s\n",inLayer.name.c_str());
+                    exit(-1);
+                }
+                
+                // Index what's within the bounds.  The features stay in the file until the workers need them.
+                chopLayer->srcFileName = inLayer.dataSources[0]->getShapefileName(&inLayer,(shapeCacheDir ? shapeCacheDir : targetDir));
+                {
+                    SourceReader reader(chopLayer->srcFileName,hTrgSRS);
+                    chopLayer->layerIndex = new LayerSpatialIndex(reader.layer,reader.transform,(clipBoundsSet ? &clipBounds : NULL));
+                }
+                layers.push_back(chopLayer);
             }
-            std::vector<bool> sortedStylesDone(layer.sortStyles.size(),false);
             
             // Work through the levels
             for (int li=minLevel;li<=maxLevel;li++)
@@ -1105,88 +1562,144 @@ int main(int argc, char * argv[])
                 int scale = ScaleForLevel(li,levelScale);
                 fprintf(stdout, "  Level %d;  Scale = %d\n",li,scale);
                 
-                // Look through the sorted styles that might apply and aren't done
-                for (unsigned int ssi=0;ssi<layer.sortStyles.size();ssi++)
+                ChopLevelInfo chopInfo;
+                chopInfo.layers = &layers;
+                
+                // Figure out all the passes we need to make over the data at this level
+                std::vector<std::vector<MapnikConfig::CompiledSymbolizerTable::SymbolizerGroup> > passSymGroups;
+                std::vector<const char *> passSymbolTypes;
+                OGREnvelope passExtent;
+                for (unsigned int ci=0;ci<layers.size();ci++)
                 {
-                    MapnikConfig::SortedLayer::SortedStyle *style = &layer.sortStyles[ssi];
-                    if (!sortedStylesDone[ssi] && (style->maxScale == 0 || style->maxScale >= scale))
+                    ChopLayer *chopLayer = layers[ci];
+                    MapnikConfig::SortedLayer &layer = chopLayer->sortedLayer;
+                    
+                    // Look through the sorted styles that might apply and aren't done
+                    for (unsigned int ssi=0;ssi<layer.sortStyles.size();ssi++)
                     {
-                        // If we're doing replace, we don't turn styles off since we repeat per level
-                        if (tileGeomType == MapnikConfig::Symbolizer::TileGeomAdd)
-                            sortedStylesDone[ssi] = true;
-                        // Compile these styles, which gives us the UUIDs we need below for the groups
-                        // Individual features point to these groups
-                        std::vector<MapnikConfig::CompiledSymbolizerTable::SymbolizerGroup> symGroups;
-                        mapnikConfig->compiledSymTable.addSymbolizerGroup(mapnikConfig, style, symGroups);
-                        
-                        // This is one specific filter, so we need to chop this version right here
-                        // We'll work through the data type.  Chop will actually merge, so we can hit the same layer multiple times.
-                        int totalFeatures = 0;
-                        for (unsigned int di=0;di<MapnikConfig::SymbolDataUnknown;di++)
+                        MapnikConfig::SortedLayer::SortedStyle *style = &layer.sortStyles[ssi];
+                        if (!chopLayer->sortedStylesDone[ssi] && (style->maxScale == 0 || style->maxScale >= scale))
                         {
-                            const char *symbolType = NULL;
-                            switch (di)
-                            {
-                                case MapnikConfig::SymbolDataPoint:
-                                    symbolType = "Point";
-                                    break;
-                                case MapnikConfig::SymbolDataLinear:
-                                    symbolType = "Linear";
-                                    break;
-                                case MapnikConfig::SymbolDataAreal:
-                                    symbolType = "Areal";
-                                    break;
-                            }
+                            // If we're doing replace, we don't turn styles off since we repeat per level
+                            if (tileGeomType == MapnikConfig::Symbolizer::TileGeomAdd)
+                                chopLayer->sortedStylesDone[ssi] = true;
+                            // Compile these styles, which gives us the UUIDs we need below for the groups
+                            // Individual features point to these groups
+                            std::vector<MapnikConfig::CompiledSymbolizerTable::SymbolizerGroup> symGroups;
+                            mapnikConfig->compiledSymTable.addSymbolizerGroup(mapnikConfig, style, symGroups);
                             
-                            // Make sure someone wants this data type
-                            bool wanted = false;
-                            for (unsigned int sgi=0;sgi<symGroups.size();sgi++)
-                                if (symGroups[sgi].dataType == di)
+                            // This is one specific filter, so we need to chop this version right here
+                            // We'll work through the data type.  Chop will actually merge, so we can hit the same layer multiple times.
+                            for (unsigned int di=0;di<MapnikConfig::SymbolDataUnknown;di++)
+                            {
+                                const char *symbolType = NULL;
+                                switch (di)
                                 {
-                                    wanted = true;
-                                    break;
+                                    case MapnikConfig::SymbolDataPoint:
+                                        symbolType = "Point";
+                                        break;
+                                    case MapnikConfig::SymbolDataLinear:
+                                        symbolType = "Linear";
+                                        break;
+                                    case MapnikConfig::SymbolDataAreal:
+                                        symbolType = "Areal";
+                                        break;
                                 }
-                            if (!wanted)
-                                continue;
-                            
-                            int numRules = 0;
-                            for (unsigned int si=0;si<style->styleInstances.size();si++)
-                                numRules += style->styleInstances[si].rules.size();
-                            if (style->filter.filter.empty())
-                                fprintf(stdout, "\tData Type = %s; Empty Filter, %d rules\n",symbolType,numRules);
-                            else
-                                fprintf(stdout,"\tData Type = %s; Filter = %s, %d rules\n",symbolType,style->filter.filter.c_str(),numRules);
-                            
-                            int copiedFeatures = 0;
-                            std::string thisLayerName = inLayer.name;
-                            ChopShapefile(thisLayerName.c_str(), inDataSource, inFeatures, symGroups, (MapnikConfig::SymbolDataType)di, targetDir, xmin, ymin, xmax, ymax, li, hTrgSRS, hTileSRS, buildStats,fullExtents, (clipBoundsSet ? &clipBounds : NULL),copiedFeatures);
-                            
-                            if (copiedFeatures > 0)
-                            {
-                                mapnikConfig->compiledSymTable.layerNames.insert(thisLayerName);
-
-                                fprintf(stdout,"\t\tChopped %d %s features\n",copiedFeatures,symbolType);
-                                totalFeatures += copiedFeatures;
                                 
-                                minLevelSeen = std::min(minLevelSeen,li);
-                                maxLevelSeen = std::max(maxLevelSeen,li);
+                                // Make sure someone wants this data type
+                                bool wanted = false;
+                                for (unsigned int sgi=0;sgi<symGroups.size();sgi++)
+                                    if (symGroups[sgi].dataType == di)
+                                    {
+                                        wanted = true;
+                                        break;
+                                    }
+                                if (!wanted)
+                                    continue;
+                                
+                                int numRules = 0;
+                                for (unsigned int si=0;si<style->styleInstances.size();si++)
+                                    numRules += style->styleInstances[si].rules.size();
+                                if (style->filter.filter.empty())
+                                    fprintf(stdout, "\tData Type = %s; Empty Filter, %d rules\n",symbolType,numRules);
+                                else
+                                    fprintf(stdout,"\tData Type = %s; Filter = %s, %d rules\n",symbolType,style->filter.filter.c_str(),numRules);
+                                
+                                if (chopLayer->layerIndex->numFeatures() == 0)
+                                    continue;
+                                if (chopInfo.passes.empty())
+                                    passExtent = chopLayer->layerIndex->getExtent();
+                                else
+                                    passExtent.Merge(chopLayer->layerIndex->getExtent());
+                                
+                                ChopLevelPass levelPass;
+                                levelPass.layer = ci;
+                                levelPass.layerName = chopLayer->inLayer.name;
+                                levelPass.dataType = (MapnikConfig::SymbolDataType)di;
+                                chopInfo.passes.push_back(levelPass);
+                                passSymGroups.push_back(symGroups);
+                                passSymbolTypes.push_back(symbolType);
                             }
                         }
+                    }
+                }
+                if (chopInfo.passes.empty())
+                    continue;
+                
+                // The passes share the feature cache budget
+                unsigned int passCachedFeatures = std::max(1,maxCachedFeatures/(int)chopInfo.passes.size());
+                for (unsigned int pi=0;pi<chopInfo.passes.size();pi++)
+                {
+                    ChopLevelPass &levelPass = chopInfo.passes[pi];
+                    levelPass.pass = new ChopPass(layers[levelPass.layer]->layerIndex,passSymGroups[pi],levelPass.dataType,(clipBoundsSet ? &clipBounds : NULL),passCachedFeatures);
+                }
+                
+                // Which cells might we be covering
+                int numCells = 1<<li;
+                double cellSizeX = (xmax-xmin)/numCells;
+                double cellSizeY = (ymax-ymin)/numCells;
+                int sx = floor((passExtent.MinX - xmin) / cellSizeX);
+                int sy = floor((passExtent.MinY - ymin) / cellSizeY);
+                int ex = ceil((passExtent.MaxX - xmin) / cellSizeX);
+                int ey = ceil((passExtent.MaxY - ymin) / cellSizeY);
+                sx = std::max(sx,0);  sy = std::max(sy,0);
+                ex = std::min(ex,numCells-1);  ey = std::min(ey,numCells-1);
+                
+                // Work through the possible cells, a row at a time per worker
+                chopInfo.targetDir = targetDir;
+                chopInfo.level = li;
+                chopInfo.xmin = xmin;  chopInfo.ymin = ymin;
+                chopInfo.cellSizeX = cellSizeX;  chopInfo.cellSizeY = cellSizeY;
+                chopInfo.sx = sx;  chopInfo.sy = sy;
+                chopInfo.ex = ex;  chopInfo.ey = ey;
+                chopInfo.hTrgSRS = hTrgSRS;
+                chopInfo.hTileSRS = hTileSRS;
+                chopInfo.clipEnv = (clipBoundsSet ? &clipBounds : NULL);
+                chopInfo.output = (vectorDb ? &tileOutput : NULL);
+                chopInfo.writeShapefiles = writeShapefiles;
+                chopInfo.queue = NULL;
+                if (!ChopLevel(chopInfo,numThreads,buildStats,fullExtents,rowsWithData))
+                    return -1;
+                
+                for (unsigned int pi=0;pi<chopInfo.passes.size();pi++)
+                {
+                    ChopLevelPass &levelPass = chopInfo.passes[pi];
+                    int copiedFeatures = levelPass.pass->getCopiedFeatures();
+                    if (copiedFeatures > 0)
+                    {
+                        mapnikConfig->compiledSymTable.layerNames.insert(levelPass.layerName);
                         
-                        // Something used this style, so writ it out
-                        if (totalFeatures > 0)
-                        {
-                        }
+                        fprintf(stdout,"\t\tChopped %d %s features from %s\n",copiedFeatures,passSymbolTypes[pi],levelPass.layerName.c_str());
+                        
+                        minLevelSeen = std::min(minLevelSeen,li);
+                        maxLevelSeen = std::max(maxLevelSeen,li);
                     }
-                    
-                    // We know something came over from this layer
-                    layerNames.insert(inLayer.name);
+                    delete levelPass.pass;
                 }
             }
             
-            for (unsigned int fi=0;fi<inFeatures.size();fi++)
-                delete inFeatures[fi];
-            delete inDataSource;
+            for (unsigned int ci=0;ci<layers.size();ci++)
+                delete layers[ci];
         }
         
         // Write the symbolizers out as JSON
@@ -1221,59 +1734,11 @@ int main(int argc, char * argv[])
     if (buildStats.numTiles > 0)
         fprintf(stdout,"Feature Count\n  Min = %d, Max = %d, Avg = %f\n",buildStats.minFeat,buildStats.maxFeat,buildStats.featAvg/buildStats.numTiles);
     
-    // Clear out the web DB and recreate it if we need it
-    if (webDbName)
-    {
-        for (int level = minLevelSeen;level<=maxLevelSeen;level++)
-            mkdir(((std::string)webDbDir+"/"+std::to_string(level)).c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
-    }
-
-    // If there's a target DB we'll build a sqlite database from the shapefiles
-    if (targetDb && mapnikConfig)
+    // Finish up the vector DB
+    if (vectorDb)
     {
-//        OGRSFDriver *memDriver = OGRSFDriverRegistrar::GetRegistrar()->GetDriverByName("Memory");
-
-        fprintf(stdout,"Compiling to vector DB: %s\n",targetDb);
-        GDALTermProgress(0.0,NULL,NULL);
-        
-        // Total number of chunks to process
-        int totalNumCells = 0;
-        for (unsigned int level = minLevelSeen; level <= maxLevelSeen; level++)
-        {
-            // We don't do the whole span of each level
-            int numCells = 1<<level;
-            double cellSizeX = (xmax-xmin)/numCells;
-            double cellSizeY = (ymax-ymin)/numCells;
-            int sx = floor((fullExtents.MinX - xmin) / cellSizeX);
-            int sy = floor((fullExtents.MinY - ymin) / cellSizeY);
-            int ex = ceil((fullExtents.MaxX - xmin) / cellSizeX);
-            int ey = ceil((fullExtents.MaxY - ymin) / cellSizeY);
-            sx = std::max(sx,0);  sy = std::max(sy,0);
-            ex = std::min(ex,numCells-1);  ey = std::min(ey,numCells-1);
-
-            totalNumCells += (ex-sx+1)*(ey-sy+1);
-        }
-        
-        remove(targetDb);
-        Kompex::SQLiteDatabase *sqliteDb = NULL;
-        sqliteDb = new Kompex::SQLiteDatabase(targetDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0);
-        if (!sqliteDb->GetDatabaseHandle())
-        {
-            fprintf(stderr, "Invalid sqlite database: %s\n",targetDb);
-            return -1;
-        }
-        
-        // Do one big transaction
-        {
-            Kompex::SQLiteStatement transactStmt(sqliteDb);
-            transactStmt.SqlStatement((std::string)"BEGIN TRANSACTION");
-        }
-        
-        int cellsProcessed = 0;
         try {
-            // Set up the vector DB
-            Maply::VectorDatabase *vectorDb = new Maply::VectorDatabase();
-            vectorDb->setupDatabase(sqliteDb, destSRS, tileSRS, xmin, ymin, ymax, ymax, minLevelSeen, maxLevelSeen, true);
+            vectorDb->setLevels(minLevelSeen, maxLevelSeen);
             
             // Write out the styles
             for (unsigned int ii=0;ii<mapnikConfig->compiledSymTable.symGroups.size();ii++)
@@ -1284,238 +1749,62 @@ int main(int argc, char * argv[])
                 std::string name = "style " + std::to_string(ii);
                 vectorDb->addStyle(name.c_str(), styleStr.c_str());
             }
-            
-            // Set up the layer tables
-            std::vector<int> layerIDs;
-            std::vector<std::string> localLayerNames;
-            if (!mergeLayers)
-            {
-                for (std::set<std::string>::iterator it = layerNames.begin();it != layerNames.end(); ++it)
-                {
-                    const std::string &layerName = *it;
-                    int layerID = vectorDb->addVectorLayer(layerName.c_str());
-                    localLayerNames.push_back(layerName);
-                    layerIDs.push_back(layerID);
-                }
-            } else {
-                int layerID = vectorDb->addVectorLayer("all");
-                layerIDs.push_back(layerID);
-                for (std::set<std::string>::iterator it = layerNames.begin();it != layerNames.end(); ++it)
-                {
-                    const std::string &layerName = *it;
-                    localLayerNames.push_back(layerName);
-                }
-            }
-            
-            // Work through the levels
-            for (unsigned int level = minLevel; level <= maxLevel; level++)
+        }
+        catch (const std::string &what)
+        {
+            fprintf(stderr,"Failed to write to target DB because:\n%s\n",what.c_str());
+            return -1;
+        }
+        
+        // If a tile is empty and we're writing a web DB we need to create an empty file
+        // This is dumb, yes.
+        if (webDbName)
+        {
+            for (std::set<std::pair<int,int> >::iterator it = rowsWithData.begin(); it != rowsWithData.end(); ++it)
             {
+                int level = it->first, iy = it->second;
+                if (level >= maxLevelSeen-1)
+                    continue;
+                
                 int numCells = 1<<level;
                 double cellSizeX = (xmax-xmin)/numCells;
-                double cellSizeY = (ymax-ymin)/numCells;
-
-                // Work through the cells
                 int sx = floor((fullExtents.MinX - xmin) / cellSizeX);
-                int sy = floor((fullExtents.MinY - ymin) / cellSizeY);
                 int ex = ceil((fullExtents.MaxX - xmin) / cellSizeX);
-                int ey = ceil((fullExtents.MaxY - ymin) / cellSizeY);
-                sx = std::max(sx,0);  sy = std::max(sy,0);
-                ex = std::min(ex,numCells-1);  ey = std::min(ey,numCells-1);
-                
-                for (unsigned int iy=sy;iy<=ey;iy++)
+                sx = std::max(sx,0);
+                ex = std::min(ex,numCells-1);
+                for (int ix=sx;ix<=ex;ix++)
                 {
-                    bool fileExists = true;
-                    // If there's nothing in the row we can skip that
-                    std::string yDir = (std::string)targetDir + "/" + std::to_string(level) + "/" + std::to_string(iy);
-                    boost::filesystem::path yDirPath(yDir);
-                    try
-                    {
-                        fileExists = boost::filesystem::exists(yDirPath);
-                    }
-                    catch (...)
-                    {
-                        // This tells us nothing
-                    }
-                    if (!fileExists)
-                    {
-                        cellsProcessed += (ex-sx+1);
-                        double done = cellsProcessed/((double)totalNumCells);
-                        GDALTermProgress(done,NULL,NULL);
-                        continue;
-                    }
-                    
-                    // Collect up all the filenames for the row, to save us from opening files one by one
-                    bool fileNameCache = false;
-                    std::set<std::string> yFileNames;
-                    try
-                    {
-                        for (boost::filesystem::directory_iterator dirIter = boost::filesystem::directory_iterator(yDir);
-                             dirIter != boost::filesystem::directory_iterator(); ++dirIter)
-                        {
-                            boost::filesystem::path p = dirIter->path();
-                            std::string ext = p.extension().string();
-                            if (!ext.compare(".shp"))
-                            {
-                                yFileNames.insert(p.string());
-                            }
-                        }
-                        fileNameCache = true;
-                    }
-                    catch (...)
-                    {
-                        fileNameCache = false;
-                    }
-
-                    for (unsigned int ix=sx;ix<=ex;ix++)
+                    std::string cellDir = (std::string)webDbDir + "/" + std::to_string(level) + "/" + std::to_string(ix) + "/";
+                    for (unsigned int li=0;li<outLayerNames.size();li++)
                     {
-                        // Set up an in memory data source
-//                        OGRDataSource *memDS = memDriver->CreateDataSource("memory");
-//                        OGRLayer *memLayer = memDS->CreateLayer("layer",hTileSRS);
-                        
-                        // Work through the layers at this level
-                        std::vector<OGRDataSource *> dataSources;
-                        std::vector<OGRFeature *> layerFeatures;
-                        for (unsigned int li=0;li<layerNames.size();li++)
+                        std::string cellFileName = cellDir + std::to_string(iy) + outLayerNames[li] + ".mvt";
+                        if (access(cellFileName.c_str(), F_OK) == 0)
+                            continue;
+                        mkdir(cellDir.c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+                        FILE *fp = fopen(cellFileName.c_str(),"w");
+                        if (!fp)
                         {
-                            // Load all the data types together into memory at once
-                            std::string layerName = localLayerNames[li];
-                            std::string cellDir = (std::string)targetDir + "/" + std::to_string(level) + "/" + std::to_string(iy) + "/";
-
-                            for (int di=0;di<MapnikConfig::SymbolDataUnknown;di++)
-                            {
-                                const char *typeName = (di == MapnikConfig::SymbolDataPoint ? "_p" : ((di == MapnikConfig::SymbolDataLinear) ? "_l" : ((di == MapnikConfig::SymbolDataAreal) ? "_a" : "_u")));
-                                std::string cellFileName = cellDir + std::to_string(ix) + layerName + typeName + ".shp";
-                                
-                                // Look for the filename in the name cache.  Faster.
-                                if (fileNameCache)
-                                    if (yFileNames.find(cellFileName) == yFileNames.end())
-                                        continue;
-
-                                // Open the shapefile and get pointers to the features
-                                OGRDataSource *poCDS = shpDriver->Open(cellFileName.c_str());
-                                if (poCDS)
-                                {
-                                    OGRLayer *srcLayer = poCDS->GetLayer(0);
-                                    for (unsigned int fi=0;fi<srcLayer->GetFeatureCount();fi++)
-                                        layerFeatures.push_back(srcLayer->GetFeature(fi));
-                                    dataSources.push_back(poCDS);
-                                }
-                            }
-                            
-                            // Write the data out in our custom format
-                            if (!mergeLayers || (li == layerNames.size()-1))
-                            {
-                                try {
-                                    int layerID = 0;
-                                    std::string outLayerName = "";
-                                    if (!mergeLayers)
-                                    {
-                                        layerID = layerIDs[li];
-                                        outLayerName = layerName;
-                                    } else {
-                                        layerID = layerIDs[0];
-                                        outLayerName = "";
-                                    }
-                                    // Also write it out to the web DB if needed
-                                    std::string cellDir = "";
-                                    std::string cellFileName = "";
-                                    if (webDbDir)
-                                    {
-                                        cellDir = (std::string)webDbDir + "/" + std::to_string(level) + "/" + std::to_string(ix) + "/";
-                                        cellFileName = cellDir + std::to_string(iy) + outLayerName + ".mvt";
-                                    }
-
-                                    if (!layerFeatures.empty())
-                                    {
-                                        std::vector<unsigned char> vecData;
-                                        vectorDb->vectorToDBFormat(layerFeatures, vecData);
-                                        if (!vecData.empty())
-                                        {
-                                            vectorDb->addVectorTile(ix, iy, level, layerID, (const char *)&vecData[0], (int)vecData.size());
-                                            
-                                            if (webDbName)
-                                            {
-                                                void *compressOut;
-                                                int compressSize=0;
-                                                // Need to compress the tiles first
-                                                if (Maply::CompressData((void *)&vecData[0], (int)vecData.size(), &compressOut, compressSize))
-                                                {
-                                                    mkdir(cellDir.c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
-                                                    FILE *fp = fopen(cellFileName.c_str(),"w");
-                                                    if (!fp)
-                                                    {
-                                                        fprintf(stderr,"Failed to open file for write: %s\n",cellFileName.c_str());
-                                                        exit(-1);
-                                                    }
-                                                    if (fwrite(compressOut,compressSize,1,fp) != 1)
-                                                    {
-                                                        fprintf(stderr,"Failed to write to file: %s\n",cellFileName.c_str());
-                                                        exit(-1);
-                                                    }
-                                                    fclose(fp);
-                                                } else {
-                                                    fprintf(stderr,"Tile compression failed for %d: (%d,%d)\n",level,ix,iy);
-                                                    exit(-1);
-                                                }
-                                            }
-                                        }
-                                    } else {
-                                        // If it is empty and we're writing a web DB we need to create an empty file
-                                        // This is dumb, yes.
-                                        if (level < maxLevelSeen-1)
-                                        {
-                                            if (webDbName)
-                                            {
-                                                mkdir(cellDir.c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
-                                                FILE *fp = fopen(cellFileName.c_str(),"w");
-                                                if (!fp)
-                                                {
-                                                    fprintf(stderr,"Failed to open file for write: %s\n",cellFileName.c_str());
-                                                    exit(-1);
-                                                }
-                                                fclose(fp);
-                                            }
-                                        }
-                                    }
-                                }
-                                catch (std::string &errorStr)
-                                {
-                                    fprintf(stderr,"Unable to write tile %d: (%d,%d)\nBecause: %s\n",level,ix,iy,errorStr.c_str());
-                                    return -1;
-                                }
-                                
-                                // Clean up the layer features
-                                for (unsigned int lf=0;lf<layerFeatures.size();lf++)
-                                    delete layerFeatures[lf];
-                                layerFeatures.clear();
-
-                                // Clean up the data sources
-                                for (unsigned int si=0;si<dataSources.size();si++)
-                                    OGRDataSource::DestroyDataSource(dataSources[si]);
-                                dataSources.clear();
-                            }
+                            fprintf(stderr,"Failed to open file for write: %s\n",cellFileName.c_str());
+                            exit(-1);
                         }
-                        
-                        cellsProcessed++;
-                        double done = cellsProcessed/((double)totalNumCells);
-                        GDALTermProgress(done,NULL,NULL);
+                        fclose(fp);
                     }
                 }
             }
         }
+        
+        try {
+            vectorDb->printStats(stdout);
+            vectorDb->flush();
+        }
         catch (const std::string &what)
         {
             fprintf(stderr,"Failed to write to target DB because:\n%s\n",what.c_str());
             return -1;
         }
         
-        // End the big transaction
-        {
-            Kompex::SQLiteStatement transactStmt(sqliteDb);
-            transactStmt.SqlStatement((std::string)"END TRANSACTION");
-        }
-
-        GDALTermProgress(1.0,NULL,NULL);
+        delete vectorDb;
+        delete sqliteDb;
     }
     
     if (mapnikConfig)
@@ -0,0 +1,265 @@
+//
+//  main.cpp
+//  change_queue_bench
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <deque>
+#include "ChangeQueue.h"
+
+using namespace WhirlyKit;
+
+typedef std::chrono::steady_clock Clock;
+
+// Stand in for a change request.  We just want to know when it was added.
+class FakeChange
+{
+public:
+    Clock::time_point added;
+};
+typedef std::vector<FakeChange> FakeChangeSet;
+
+// What we measured for one queue
+class BenchResults
+{
+public:
+    BenchResults() : totalTime(0.0), totalPushTime(0.0), maxPushTime(0.0), totalLatency(0.0), maxLatency(0.0), maxProcessTime(0.0), numChanges(0), numFrames(0), skippedFrames(0) { }
+
+    double totalTime;
+    double totalPushTime,maxPushTime;
+    double totalLatency,maxLatency;
+    // Longest the renderer spent on changes in one frame
+    double maxProcessTime;
+    long long numChanges;
+    int numFrames,skippedFrames;
+};
+
+// Busy wait, standing in for real work
+void Spin(double seconds)
+{
+    Clock::time_point endTime = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    while (Clock::now() < endTime) { }
+}
+
+// Run each change, which is where the renderer spends its time
+void ExecuteChanges(const FakeChangeSet &changes,double changeCost,BenchResults &results)
+{
+    for (const FakeChange &change : changes)
+    {
+        double latency = std::chrono::duration<double>(Clock::now() - change.added).count();
+        results.totalLatency += latency;
+        results.maxLatency = std::max(results.maxLatency,latency);
+        Spin(changeCost);
+    }
+    results.numChanges += changes.size();
+}
+
+// The old way: a mutex the producers lock and the renderer trylocks.
+// The renderer holds it while it runs the changes, like Scene::processChanges did.
+class MutexQueue
+{
+public:
+    void push(const FakeChangeSet &changes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.insert(pending.end(),changes.begin(),changes.end());
+    }
+
+    // Returns false if we lost the race for the lock.
+    // There was no budget back then, everything waiting runs.
+    bool process(double changeCost,double /*budget*/,BenchResults &results)
+    {
+        if (!mutex.try_lock())
+            return false;
+        ExecuteChanges(pending,changeCost,results);
+        pending.clear();
+        mutex.unlock();
+        return true;
+    }
+
+    std::mutex mutex;
+    FakeChangeSet pending;
+};
+
+// The new way: producers never wait and the renderer runs the changes on its own.
+// This follows Scene::processChanges.  We take what was there when the frame started
+//  and run whole groups until we're over the budget, leaving the rest for the next frame.
+class LockFreeQueue
+{
+public:
+    void push(const FakeChangeSet &changes)
+    {
+        queue.push(changes);
+    }
+
+    bool process(double changeCost,double budget,BenchResults &results)
+    {
+        std::vector<FakeChangeSet> newGroups;
+        queue.popAvailable(newGroups);
+        for (FakeChangeSet &changes : newGroups)
+            pending.push_back(std::move(changes));
+
+        Clock::time_point startTime = Clock::now();
+        bool firstGroup = true;
+        while (!pending.empty())
+        {
+            if (!firstGroup && budget > 0.0 && std::chrono::duration<double>(Clock::now() - startTime).count() >= budget)
+                break;
+            firstGroup = false;
+            ExecuteChanges(pending.front(),changeCost,results);
+            pending.pop_front();
+        }
+        return true;
+    }
+
+    MPSCQueue<FakeChangeSet> queue;
+    // Taken off the queue but not run yet.  Only the renderer touches this.
+    std::deque<FakeChangeSet> pending;
+};
+
+// Producers build groups of changes and a renderer runs them once per frame
+template<typename QueueType>
+BenchResults RunBench(int numProducers,int numGroups,int groupSize,double buildCost,double changeCost,double frameTime,double budget)
+{
+    QueueType queue;
+    BenchResults results;
+    std::vector<double> totalPushTimes(numProducers,0.0),maxPushTimes(numProducers,0.0);
+
+    Clock::time_point startTime = Clock::now();
+    std::vector<std::thread> producers;
+    for (int ii=0;ii<numProducers;ii++)
+        producers.push_back(std::thread([&,ii]
+        {
+            FakeChangeSet changes(groupSize);
+            for (int jj=0;jj<numGroups;jj++)
+            {
+                Spin(buildCost);
+                Clock::time_point pushStart = Clock::now();
+                for (FakeChange &change : changes)
+                    change.added = pushStart;
+                queue.push(changes);
+                double pushTime = std::chrono::duration<double>(Clock::now() - pushStart).count();
+                totalPushTimes[ii] += pushTime;
+                maxPushTimes[ii] = std::max(maxPushTimes[ii],pushTime);
+            }
+        }));
+
+    // The renderer
+    long long expected = (long long)numProducers * numGroups * groupSize;
+    while (results.numChanges < expected)
+    {
+        Clock::time_point frameStart = Clock::now();
+        results.numFrames++;
+        if (!queue.process(changeCost,budget,results))
+            results.skippedFrames++;
+        results.maxProcessTime = std::max(results.maxProcessTime,std::chrono::duration<double>(Clock::now() - frameStart).count());
+        double left = frameTime - std::chrono::duration<double>(Clock::now() - frameStart).count();
+        if (left > 0.0)
+            std::this_thread::sleep_for(std::chrono::duration<double>(left));
+    }
+    results.totalTime = std::chrono::duration<double>(Clock::now() - startTime).count();
+
+    for (std::thread &producer : producers)
+        producer.join();
+    for (int ii=0;ii<numProducers;ii++)
+    {
+        results.totalPushTime += totalPushTimes[ii];
+        results.maxPushTime = std::max(results.maxPushTime,maxPushTimes[ii]);
+    }
+
+    return results;
+}
+
+void PrintResults(const char *name,const BenchResults &results)
+{
+    fprintf(stdout,"%-10s %10.3f %12.2f %12.1f %12.3f %12.3f %12.3f %8d %8d\n",name,
+            results.totalTime,
+            results.totalPushTime * 1e3,
+            results.maxPushTime * 1e6,
+            results.numChanges > 0 ? results.totalLatency / results.numChanges * 1e3 : 0.0,
+            results.maxLatency * 1e3,
+            results.maxProcessTime * 1e3,
+            results.numFrames,results.skippedFrames);
+}
+
+int main(int argc, char * argv[])
+{
+    int numProducers = 8;
+    int numGroups = 2000;
+    int groupSize = 16;
+    int buildMicros = 200;
+    int changeNanos = 500;
+    int frameMicros = 16000;
+    int budgetMicros = 0;
+
+    for (int ii=1;ii<argc;ii++)
+    {
+        int *val = NULL;
+        if (!strcmp(argv[ii],"-producers"))
+            val = &numProducers;
+        else if (!strcmp(argv[ii],"-groups"))
+            val = &numGroups;
+        else if (!strcmp(argv[ii],"-groupsize"))
+            val = &groupSize;
+        else if (!strcmp(argv[ii],"-build"))
+            val = &buildMicros;
+        else if (!strcmp(argv[ii],"-cost"))
+            val = &changeNanos;
+        else if (!strcmp(argv[ii],"-frame"))
+            val = &frameMicros;
+        else if (!strcmp(argv[ii],"-budget"))
+            val = &budgetMicros;
+        else {
+            fprintf(stderr,"Unknown option: %s\n",argv[ii]);
+            fprintf(stderr,"%s: [-producers n] [-groups n] [-groupsize n] [-build us] [-cost ns] [-frame us] [-budget us]\n",argv[0]);
+            return -1;
+        }
+        if (ii+1 >= argc)
+        {
+            fprintf(stderr,"Expecting one argument for %s\n",argv[ii]);
+            return -1;
+        }
+        *val = atoi(argv[++ii]);
+        bool countArg = val == &numProducers || val == &numGroups || val == &groupSize;
+        if (*val < (countArg ? 1 : 0))
+        {
+            fprintf(stderr,"Bad value for %s\n",argv[ii-1]);
+            return -1;
+        }
+    }
+
+    fprintf(stdout,"%d producers, %d groups of %d changes each, %d us to build a group, %d ns per change, %d us frames, %d us budget\n",
+            numProducers,numGroups,groupSize,buildMicros,changeNanos,frameMicros,budgetMicros);
+    fprintf(stdout,"%-10s %10s %12s %12s %12s %12s %12s %8s %8s\n","queue","total s","blocked ms","max push us","avg lat ms","max lat ms","max frame ms","frames","skipped");
+    PrintResults("mutex",RunBench<MutexQueue>(numProducers,numGroups,groupSize,buildMicros*1e-6,changeNanos*1e-9,frameMicros*1e-6,budgetMicros*1e-6));
+    PrintResults("lock free",RunBench<LockFreeQueue>(numProducers,numGroups,groupSize,buildMicros*1e-6,changeNanos*1e-9,frameMicros*1e-6,budgetMicros*1e-6));
+
+    // Check the timer wheel gives things back in order and on time
+    TimerWheel<int> wheel;
+    std::vector<int> due;
+    for (int ii=0;ii<1000;ii++)
+        wheel.insert(100.0 + (ii * 7919 % 1000) * 0.01,ii * 7919 % 1000);
+    for (double now = 100.0;now < 112.0;now += 0.016)
+        wheel.advance(now,due);
+    bool inOrder = due.size() == 1000;
+    for (unsigned int ii=0;inOrder && ii<due.size();ii++)
+        inOrder = due[ii] == (int)ii;
+    if (!inOrder)
+    {
+        fprintf(stderr,"Timer wheel returned %d items out of order\n",(int)due.size());
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,277 @@
+//
+//  main.cpp
+//  cluster_index_bench
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include "ClusterIndex.h"
+
+using namespace Eigen;
+using namespace WhirlyKit;
+
+typedef std::chrono::steady_clock Clock;
+
+double SecondsSince(Clock::time_point startTime)
+{
+    return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+// A cluster from the brute force version.  Items are the indices of the input points.
+class SlowCluster
+{
+public:
+    int nodeID;
+    Vector2d center;
+    Vector2d ll,ur;
+    std::vector<int> items;
+};
+
+// What we expect at every level, worked out the obvious way.
+// This is the same greedy merge ClusterIndex does, but it checks every pair instead of using a grid.
+// Nodes are numbered the way the index numbers them so ties and sums come out the same.
+void SlowClusters(const std::vector<Vector2d> &pts,int numLevels,double rootRadius,std::vector<std::vector<SlowCluster> > &levels)
+{
+    levels.resize(numLevels+1);
+    std::vector<SlowCluster> current(pts.size());
+    for (unsigned int ii=0;ii<pts.size();ii++)
+    {
+        current[ii].nodeID = ii;
+        current[ii].center = current[ii].ll = current[ii].ur = pts[ii];
+        current[ii].items.push_back(ii);
+    }
+    levels[numLevels] = current;
+
+    int nextID = (int)pts.size();
+    for (int level=numLevels-1;level>=0;level--)
+    {
+        double radius = rootRadius / (double)(1LL << level);
+        std::vector<bool> taken(current.size(),false);
+        std::vector<SlowCluster> next;
+        for (unsigned int ii=0;ii<current.size();ii++)
+        {
+            if (taken[ii])
+                continue;
+            taken[ii] = true;
+            std::vector<const SlowCluster *> merge(1,&current[ii]);
+            for (unsigned int jj=0;jj<current.size();jj++)
+                if (!taken[jj] && (current[jj].center - current[ii].center).squaredNorm() <= radius*radius)
+                {
+                    taken[jj] = true;
+                    merge.push_back(&current[jj]);
+                }
+            if (merge.size() == 1)
+            {
+                next.push_back(current[ii]);
+                continue;
+            }
+
+            std::sort(merge.begin()+1,merge.end(),[](const SlowCluster *a,const SlowCluster *b) { return a->nodeID < b->nodeID; });
+            SlowCluster cluster;
+            cluster.nodeID = nextID++;
+            cluster.center = Vector2d(0,0);
+            cluster.ll = merge[0]->ll;
+            cluster.ur = merge[0]->ur;
+            for (const SlowCluster *child : merge)
+            {
+                cluster.center += child->center * (double)child->items.size();
+                cluster.ll = cluster.ll.cwiseMin(child->ll);
+                cluster.ur = cluster.ur.cwiseMax(child->ur);
+                cluster.items.insert(cluster.items.end(),child->items.begin(),child->items.end());
+            }
+            cluster.center /= (double)cluster.items.size();
+            next.push_back(cluster);
+        }
+        current.swap(next);
+        levels[level] = current;
+    }
+}
+
+// Clusters as sets of items, so the order we get them in doesn't matter
+typedef std::set<std::vector<int> > Grouping;
+
+Grouping SlowGrouping(const std::vector<SlowCluster> &clusters,const Vector2d &ll,const Vector2d &ur)
+{
+    Grouping grouping;
+    for (const SlowCluster &cluster : clusters)
+    {
+        if (cluster.ur.x() < ll.x() || cluster.ll.x() > ur.x() || cluster.ur.y() < ll.y() || cluster.ll.y() > ur.y())
+            continue;
+        std::vector<int> items = cluster.items;
+        std::sort(items.begin(),items.end());
+        grouping.insert(items);
+    }
+    return grouping;
+}
+
+Grouping IndexGrouping(const ClusterIndex<int> &index,int level,const Vector2d &ll,const Vector2d &ur,int &numVisited)
+{
+    Grouping grouping;
+    index.query(level,ll,ur,[&](const ClusterIndex<int>::Node &node)
+                {
+                    std::vector<int> items;
+                    for (int li=node.leafStart;li<node.leafEnd;li++)
+                        items.push_back(index.getLeaf(li));
+                    std::sort(items.begin(),items.end());
+                    grouping.insert(items);
+                    numVisited++;
+                });
+    return grouping;
+}
+
+int main(int argc, char * argv[])
+{
+    int numPoints = 4000;
+    int numBlobs = 40;
+    int numLevels = 20;
+    int numQueries = 1000;
+
+    for (int ii=1;ii<argc;ii++)
+    {
+        int *val = NULL;
+        if (!strcmp(argv[ii],"-points"))
+            val = &numPoints;
+        else if (!strcmp(argv[ii],"-blobs"))
+            val = &numBlobs;
+        else if (!strcmp(argv[ii],"-levels"))
+            val = &numLevels;
+        else if (!strcmp(argv[ii],"-queries"))
+            val = &numQueries;
+        else {
+            fprintf(stderr,"Unknown option: %s\n",argv[ii]);
+            fprintf(stderr,"%s: [-points n] [-blobs n] [-levels n] [-queries n]\n",argv[0]);
+            return -1;
+        }
+        if (ii+1 >= argc)
+        {
+            fprintf(stderr,"Expecting one argument for %s\n",argv[ii]);
+            return -1;
+        }
+        *val = atoi(argv[++ii]);
+        if (*val < 1 || (val == &numLevels && *val > 40))
+        {
+            fprintf(stderr,"Bad value for %s\n",argv[ii-1]);
+            return -1;
+        }
+    }
+
+    // Markers bunch up around cities, so we scatter blobs of them plus a few loners
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> unit(0.0,1.0);
+    std::vector<Vector2d> blobCenters(numBlobs);
+    std::vector<double> blobSizes(numBlobs);
+    for (int ii=0;ii<numBlobs;ii++)
+    {
+        blobCenters[ii] = Vector2d(unit(rng),unit(rng));
+        blobSizes[ii] = 0.001 * pow(100.0,unit(rng));
+    }
+    std::vector<Vector2d> pts(numPoints);
+    std::vector<Vector3d> dispPts(numPoints);
+    std::vector<int> items(numPoints);
+    for (int ii=0;ii<numPoints;ii++)
+    {
+        if (ii % 10 == 0)
+            pts[ii] = Vector2d(unit(rng),unit(rng));
+        else {
+            int blob = rng() % numBlobs;
+            std::normal_distribution<double> spread(0.0,blobSizes[blob]);
+            pts[ii] = blobCenters[blob] + Vector2d(spread(rng),spread(rng));
+        }
+        // Some markers sit right on top of each other
+        if (ii % 50 == 1)
+            pts[ii] = pts[ii-1];
+        dispPts[ii] = Vector3d(pts[ii].x(),pts[ii].y(),0.0);
+        items[ii] = ii;
+    }
+
+    Clock::time_point startTime = Clock::now();
+    ClusterIndex<int> index(numLevels);
+    index.build(pts,dispPts,items);
+    double buildTime = SecondsSince(startTime);
+
+    // Same extent the index works from
+    Vector2d ll = pts[0], ur = pts[0];
+    for (const Vector2d &pt : pts)
+    {
+        ll = ll.cwiseMin(pt);
+        ur = ur.cwiseMax(pt);
+    }
+    double rootRadius = std::max(ur.x()-ll.x(),ur.y()-ll.y());
+    startTime = Clock::now();
+    std::vector<std::vector<SlowCluster> > slowLevels;
+    SlowClusters(pts,numLevels,rootRadius,slowLevels);
+    double slowBuildTime = SecondsSince(startTime);
+
+    if (index.getNumLeaves() != numPoints || index.getNumNodes() > 2*numPoints)
+    {
+        fprintf(stderr,"Index has %d leaves and %d nodes for %d points\n",index.getNumLeaves(),index.getNumNodes(),numPoints);
+        return -1;
+    }
+
+    // Every level, everything
+    double inf = std::numeric_limits<double>::infinity();
+    for (int level=0;level<=numLevels;level++)
+    {
+        int numVisited = 0;
+        Grouping fast = IndexGrouping(index,level,Vector2d(-inf,-inf),Vector2d(inf,inf),numVisited);
+        Grouping slow = SlowGrouping(slowLevels[level],Vector2d(-inf,-inf),Vector2d(inf,inf));
+        if (fast != slow || numVisited != (int)slowLevels[level].size())
+        {
+            fprintf(stderr,"Level %d: index has %d clusters, brute force has %d\n",level,numVisited,(int)slowLevels[level].size());
+            return -1;
+        }
+    }
+
+    // Then random boxes at random levels, the way the layout manager asks
+    double indexQueryTime = 0.0, slowQueryTime = 0.0;
+    long long totalClusters = 0;
+    for (int qi=0;qi<numQueries;qi++)
+    {
+        int level = rng() % (numLevels+1);
+        Vector2d boxSize(unit(rng)*0.3,unit(rng)*0.3);
+        Vector2d boxLL(unit(rng) - boxSize.x()/2.0,unit(rng) - boxSize.y()/2.0);
+        Vector2d boxUR = boxLL + boxSize;
+
+        // Time just finding them, then check them
+        int numFound = 0;
+        startTime = Clock::now();
+        index.query(level,boxLL,boxUR,[&](const ClusterIndex<int>::Node &) { numFound++; });
+        indexQueryTime += SecondsSince(startTime);
+        int numSlowFound = 0;
+        startTime = Clock::now();
+        for (const SlowCluster &cluster : slowLevels[level])
+            if (!(cluster.ur.x() < boxLL.x() || cluster.ll.x() > boxUR.x() || cluster.ur.y() < boxLL.y() || cluster.ll.y() > boxUR.y()))
+                numSlowFound++;
+        slowQueryTime += SecondsSince(startTime);
+
+        int numVisited = 0;
+        Grouping fast = IndexGrouping(index,level,boxLL,boxUR,numVisited);
+        Grouping slow = SlowGrouping(slowLevels[level],boxLL,boxUR);
+        if (fast != slow || numVisited != (int)fast.size() || numFound != numSlowFound)
+        {
+            fprintf(stderr,"Query %d at level %d: index found %d clusters, brute force found %d\n",qi,level,numVisited,(int)slow.size());
+            return -1;
+        }
+        totalClusters += numVisited;
+    }
+
+    fprintf(stdout,"%d points, %d levels, %d nodes\n",numPoints,numLevels,index.getNumNodes());
+    for (int level=0;level<=numLevels;level+=std::max(1,numLevels/5))
+        fprintf(stdout,"  level %2d: %d clusters\n",level,(int)slowLevels[level].size());
+    fprintf(stdout,"Build: index %.3f ms, brute force %.3f ms\n",buildTime*1e3,slowBuildTime*1e3);
+    fprintf(stdout,"%d queries, %.1f clusters each: index %.3f ms, brute force %.3f ms\n",numQueries,
+            (double)totalClusters / numQueries,indexQueryTime*1e3,slowQueryTime*1e3);
+    fprintf(stdout,"Index matches brute force at every level\n");
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+//
+//  main.cpp
+//  coordsys_bench
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include "CoordSystem.h"
+#include "GlobeMath.h"
+#include "FlatMath.h"
+#include "SphericalMercator.h"
+#include "Proj4CoordSystem.h"
+
+using namespace WhirlyKit;
+
+// One conversion, done a point at a time and as a batch
+class BenchCase
+{
+public:
+    BenchCase(const std::string &name,std::function<void()> single,std::function<void()> batch,std::function<double()> maxDiff)
+    : name(name), single(single), batch(batch), maxDiff(maxDiff) { }
+
+    std::string name;
+    std::function<void()> single;
+    std::function<void()> batch;
+    std::function<double()> maxDiff;
+};
+
+// Best time of several runs
+double TimeRuns(const std::function<void()> &func,int reps)
+{
+    double best = 1e30;
+    for (int ii=0;ii<reps;ii++)
+    {
+        std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+        func();
+        best = std::min(best,std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+    }
+
+    return best;
+}
+
+template<typename T>
+double MaxDiff(const std::vector<T> &a,const std::vector<T> &b)
+{
+    double diff = 0.0;
+    for (unsigned int ii=0;ii<a.size();ii++)
+        diff = std::max(diff,(double)(a[ii]-b[ii]).cwiseAbs().maxCoeff());
+    return diff;
+}
+
+int main(int argc, char * argv[])
+{
+    int numPoints = 1000000;
+    int reps = 5;
+    bool skipProj = false;
+
+    for (int ii=1;ii<argc;ii++)
+    {
+        if (!strcmp(argv[ii],"-points"))
+        {
+            if (ii+1 >= argc)
+            {
+                fprintf(stderr,"Expecting one argument for -points\n");
+                return -1;
+            }
+            numPoints = atoi(argv[++ii]);
+            if (numPoints < 1)
+            {
+                fprintf(stderr,"Expecting at least one point for -points\n");
+                return -1;
+            }
+        } else if (!strcmp(argv[ii],"-reps"))
+        {
+            if (ii+1 >= argc)
+            {
+                fprintf(stderr,"Expecting one argument for -reps\n");
+                return -1;
+            }
+            reps = std::max(1,atoi(argv[++ii]));
+        } else if (!strcmp(argv[ii],"-noproj"))
+        {
+            skipProj = true;
+        } else {
+            fprintf(stderr,"Unknown option: %s\n",argv[ii]);
+            fprintf(stderr,"%s: [-points n] [-reps n] [-noproj]\n",argv[0]);
+            return -1;
+        }
+    }
+
+    // Random points over most of the world, in the forms the conversions want
+    srand48(1);
+    std::vector<Point2d> geoPts(numPoints);
+    std::vector<Point3d> geoPts3d(numPoints),geoPts3dZ(numPoints);
+    std::vector<Point3f> geoPts3f(numPoints);
+    for (int ii=0;ii<numPoints;ii++)
+    {
+        double lon = (drand48()*2.0-1.0) * M_PI, lat = (drand48()*2.0-1.0) * DegToRad(80.0);
+        double height = drand48() * 1000.0;
+        geoPts[ii] = Point2d(lon,lat);
+        geoPts3d[ii] = Point3d(lon,lat,0.0);
+        geoPts3dZ[ii] = Point3d(lon,lat,height);
+        geoPts3f[ii] = Point3f(lon,lat,0.0);
+    }
+
+    SphericalMercatorDisplayAdapter *mercAdapter = new SphericalMercatorDisplayAdapter(0.0,GeoCoord::CoordFromDegrees(-180,-85),GeoCoord::CoordFromDegrees(180,85));
+    CoordSystem *mercSys = mercAdapter->getCoordSystem();
+    FakeGeocentricDisplayAdapter *fakeGeoAdapter = new FakeGeocentricDisplayAdapter();
+    GeocentricDisplayAdapter *geocAdapter = new GeocentricDisplayAdapter();
+    CoordSystem *geoSys = fakeGeoAdapter->getCoordSystem();
+    PlateCarreeCoordSystem *plateSys = new PlateCarreeCoordSystem();
+    Proj4CoordSystem *utmSys = new Proj4CoordSystem("+proj=utm +zone=10 +datum=WGS84 +units=m +no_defs");
+    if (!utmSys->isValid())
+    {
+        fprintf(stderr,"Failed to set up proj.4 coordinate system.\n");
+        return -1;
+    }
+
+    // Local Mercator points for the things that start there
+    std::vector<Point3d> mercPts(numPoints);
+    mercSys->geographicToLocal(&geoPts[0],&mercPts[0],numPoints);
+    std::vector<Point3d> utmPts(numPoints);
+    for (int ii=0;ii<numPoints;ii++)
+        utmPts[ii] = Point3d(500000.0 + (drand48()*2.0-1.0) * 300000.0,drand48() * 9000000.0,0.0);
+
+    std::vector<Point3d> single3d(numPoints),batch3d(numPoints);
+    std::vector<Point2d> single2d(numPoints),batch2d(numPoints);
+    std::vector<Point3f> single3f(numPoints),batch3f(numPoints);
+
+    std::vector<BenchCase> cases;
+    cases.push_back(BenchCase("Mercator geographicToLocal",
+        [&]{ for (int ii=0;ii<numPoints;ii++) single3d[ii] = mercSys->geographicToLocal(geoPts[ii]); },
+        [&]{ mercSys->geographicToLocal(&geoPts[0],&batch3d[0],numPoints); },
+        [&]{ return MaxDiff(single3d,batch3d); }));
+    cases.push_back(BenchCase("Mercator localToGeographic",
+        [&]{ for (int ii=0;ii<numPoints;ii++) single2d[ii] = mercSys->localToGeographicD(mercPts[ii]); },
+        [&]{ mercSys->localToGeographic(&mercPts[0],&batch2d[0],numPoints); },
+        [&]{ return MaxDiff(single2d,batch2d); }));
+    cases.push_back(BenchCase("Mercator localToDisplay",
+        [&]{ for (int ii=0;ii<numPoints;ii++) single3d[ii] = mercAdapter->localToDisplay(mercPts[ii]); },
+        [&]{ mercAdapter->localToDisplay(&mercPts[0],&batch3d[0],numPoints); },
+        [&]{ return MaxDiff(single3d,batch3d); }));
+    cases.push_back(BenchCase("Globe localToDisplay",
+        [&]{ for (int ii=0;ii<numPoints;ii++) single3d[ii] = fakeGeoAdapter->localToDisplay(geoPts3dZ[ii]); },
+        [&]{ fakeGeoAdapter->localToDisplay(&geoPts3dZ[0],&batch3d[0],numPoints); },
+        [&]{ return MaxDiff(single3d,batch3d); }));
+    cases.push_back(BenchCase("Globe localToDisplay (float)",
+        [&]{ for (int ii=0;ii<numPoints;ii++) single3f[ii] = fakeGeoAdapter->localToDisplay(geoPts3f[ii]); },
+        [&]{ fakeGeoAdapter->localToDisplay(&geoPts3f[0],&batch3f[0],numPoints); },
+        [&]{ return MaxDiff(single3f,batch3f); }));
+    cases.push_back(BenchCase("Plate Carree geographicToLocal",
+        [&]{ for (int ii=0;ii<numPoints;ii++) single3d[ii] = plateSys->geographicToLocal(geoPts[ii]); },
+        [&]{ plateSys->geographicToLocal(&geoPts[0],&batch3d[0],numPoints); },
+        [&]{ return MaxDiff(single3d,batch3d); }));
+    // This is the tile builder's loop: tile coordinates to display coordinates on the globe
+    cases.push_back(BenchCase("Mercator to globe display",
+        [&]{ for (int ii=0;ii<numPoints;ii++) single3d[ii] = fakeGeoAdapter->localToDisplay(CoordSystemConvert3d(mercSys,geoSys,mercPts[ii])); },
+        [&]{ CoordSystemConvert3d(mercSys,geoSys,&mercPts[0],&batch3d[0],numPoints);  fakeGeoAdapter->localToDisplay(&batch3d[0],&batch3d[0],numPoints); },
+        [&]{ return MaxDiff(single3d,batch3d); }));
+    if (!skipProj)
+    {
+        cases.push_back(BenchCase("Geocentric localToDisplay",
+            [&]{ for (int ii=0;ii<numPoints;ii++) single3d[ii] = geocAdapter->localToDisplay(geoPts3dZ[ii]); },
+            [&]{ geocAdapter->localToDisplay(&geoPts3dZ[0],&batch3d[0],numPoints); },
+            [&]{ return MaxDiff(single3d,batch3d); }));
+        cases.push_back(BenchCase("Proj4 UTM localToGeographic",
+            [&]{ for (int ii=0;ii<numPoints;ii++) single2d[ii] = utmSys->localToGeographicD(utmPts[ii]); },
+            [&]{ utmSys->localToGeographic(&utmPts[0],&batch2d[0],numPoints); },
+            [&]{ return MaxDiff(single2d,batch2d); }));
+        cases.push_back(BenchCase("Proj4 UTM to Mercator",
+            [&]{ for (int ii=0;ii<numPoints;ii++) single3d[ii] = CoordSystemConvert3d(utmSys,mercSys,utmPts[ii]); },
+            [&]{ CoordSystemConvert3d(utmSys,mercSys,&utmPts[0],&batch3d[0],numPoints); },
+            [&]{ return MaxDiff(single3d,batch3d); }));
+    }
+
+    fprintf(stdout,"%d points, best of %d\n",numPoints,reps);
+    fprintf(stdout,"%-32s %12s %12s %8s %10s\n","conversion","single Mpt/s","batch Mpt/s","speedup","max diff");
+    for (BenchCase &bench : cases)
+    {
+        double singleTime = TimeRuns(bench.single,reps);
+        double batchTime = TimeRuns(bench.batch,reps);
+        fprintf(stdout,"%-32s %12.2f %12.2f %7.2fx %10.3g\n",bench.name.c_str(),numPoints/singleTime/1e6,numPoints/batchTime/1e6,singleTime/batchTime,bench.maxDiff());
+    }
+
+    delete utmSys;
+    delete plateSys;
+    delete geocAdapter;
+    delete fakeGeoAdapter;
+    delete mercAdapter;
+
+    return 0;
+}
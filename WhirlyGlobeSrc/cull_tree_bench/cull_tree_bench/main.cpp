@@ -0,0 +1,630 @@
+//
+//  main.cpp
+//  cull_tree_bench
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <set>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include "Identifiable.h"
+#include "Cullable.h"
+
+using namespace Eigen;
+using namespace WhirlyKit;
+
+typedef std::chrono::steady_clock Clock;
+
+double SecondsSince(Clock::time_point startTime)
+{
+    return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+// Unit sphere with lon/lat in radians, like the globe's display adapter
+class SphereDisplayAdapter : public CoordSystemDisplayAdapter
+{
+public:
+    SphereDisplayAdapter() : CoordSystemDisplayAdapter(NULL,Point3d(0,0,0)) { }
+    bool getBounds(Point3f & /*ll*/,Point3f & /*ur*/) { return false; }
+    Point3f localToDisplay(Point3f pt)
+    {
+        Point3d disp = localToDisplay(Point3d(pt.x(),pt.y(),pt.z()));
+        return Point3f(disp.x(),disp.y(),disp.z());
+    }
+    Point3d localToDisplay(Point3d pt)
+    {
+        double rad = 1.0 + pt.z();
+        return Point3d(cos(pt.y())*cos(pt.x())*rad,cos(pt.y())*sin(pt.x())*rad,sin(pt.y())*rad);
+    }
+    Point3f displayToLocal(Point3f pt)
+    {
+        Point3d loc = displayToLocal(Point3d(pt.x(),pt.y(),pt.z()));
+        return Point3f(loc.x(),loc.y(),loc.z());
+    }
+    Point3d displayToLocal(Point3d pt)
+    {
+        double rad = pt.norm();
+        return Point3d(atan2(pt.y(),pt.x()),asin(pt.z()/rad),rad-1.0);
+    }
+    Point3f normalForLocal(Point3f pt) { return localToDisplay(Point3f(pt.x(),pt.y(),0.0)); }
+    Point3d normalForLocal(Point3d pt) { return localToDisplay(Point3d(pt.x(),pt.y(),0.0)); }
+    CoordSystem *getCoordSystem() { return NULL; }
+    bool isFlat() { return false; }
+};
+
+// Looking straight down at the globe, set up the way WhirlyGlobeView does it
+class FakeGlobeView
+{
+public:
+    FakeGlobeView(double lon,double lat,double height,const Point2f &frameSize)
+    : frameSize(frameSize)
+    {
+        Vector3d up(cos(lat)*cos(lon),cos(lat)*sin(lon),sin(lat));
+        Vector3d north = Vector3d(0,0,1) - up * up.z();
+        if (north.norm() < 1e-6)
+            north = Vector3d(1,0,0);
+        north.normalize();
+        Vector3d east = north.cross(up);
+        Matrix4d rot = Matrix4d::Identity();
+        rot.block<1,3>(0,0) = east.transpose();
+        rot.block<1,3>(1,0) = north.transpose();
+        rot.block<1,3>(2,0) = up.transpose();
+        Matrix4d trans = Matrix4d::Identity();
+        trans(2,3) = -(1.0 + height);
+        modelTrans = trans * rot;
+        eyeVec = Vector3f(up.x(),up.y(),up.z());
+        eyePos = up * (1.0 + height);
+
+        // Same frustum as calcFrustumWidth
+        nearPlane = 0.000001;
+        double imagePlaneSize = nearPlane * tan(M_PI/8.0);
+        double ratio = frameSize.y() / frameSize.x();
+        frustLL = Point2d(-imagePlaneSize,-imagePlaneSize * ratio);
+        frustUR = Point2d(imagePlaneSize,imagePlaneSize * ratio);
+
+        // Stretch the screen MBR a little for safety, as the renderer does
+        screenMbr.addPoint(Point2f(-0.1*frameSize.x(),-0.1*frameSize.y()));
+        screenMbr.addPoint(Point2f(1.1*frameSize.x(),1.1*frameSize.y()));
+    }
+
+    // pointOnScreenFromSphere, more or less line for line
+    Point2f pointOnScreen(const Point3d &worldLoc) const
+    {
+        Vector4d screenPt = modelTrans * Vector4d(worldLoc.x(),worldLoc.y(),worldLoc.z(),1.0);
+        screenPt.x() /= screenPt.w();  screenPt.y() /= screenPt.w();  screenPt.z() /= screenPt.w();
+        Point3d ray;
+        ray.x() = screenPt.x() / screenPt.w();  ray.y() = screenPt.y() / screenPt.w();  ray.z() = screenPt.z() / screenPt.w();
+        ray *= -nearPlane/ray.z();
+        double u = (ray.x() - frustLL.x()) / (frustUR.x() - frustLL.x());
+        double v = (ray.y() - frustLL.y()) / (frustUR.y() - frustLL.y());
+        v = 1.0 - v;
+        return Point2f(u * frameSize.x(),v * frameSize.y());
+    }
+
+    // Really on the screen and facing us
+    bool isVisible(const Point3d &pt) const
+    {
+        if (pt.dot(eyePos) <= 1.0)
+            return false;
+        Point2f screenPt = pointOnScreen(pt);
+        return screenPt.x() >= 0.0 && screenPt.x() <= frameSize.x() && screenPt.y() >= 0.0 && screenPt.y() <= frameSize.y();
+    }
+
+    Point2f frameSize;
+    Matrix4d modelTrans;
+    Vector3f eyeVec;
+    Vector3d eyePos;
+    double nearPlane;
+    Point2d frustLL,frustUR;
+    Mbr screenMbr;
+};
+
+class FakeDrawable
+{
+public:
+    SimpleIdentity getId() const { return drawId; }
+    SimpleIdentity drawId;
+    Mbr localMbr;
+    bool canMove;
+    int slot;
+};
+typedef std::shared_ptr<FakeDrawable> FakeDrawableRef;
+
+class FakeDrawableSorter
+{
+public:
+    bool operator () (const FakeDrawableRef &a,const FakeDrawableRef &b) const { return a->getId() < b->getId(); }
+};
+typedef std::set<FakeDrawableRef,FakeDrawableSorter> FakeDrawableSet;
+
+class OldCullTree;
+
+// The cull tree as it was: pointers to children and a set of drawables at every level
+class OldCullable
+{
+public:
+    OldCullable(CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth)
+    : localMbr(localMbr), height(depth)
+    {
+        for (unsigned int ii=0;ii<4;ii++)
+            children[ii] = NULL;
+        Point3f pts[8];
+        pts[0] = coordAdapter->localToDisplay(Point3f(localMbr.ll().x(),localMbr.ll().y(),0.0));
+        pts[1] = coordAdapter->localToDisplay(Point3f(localMbr.ur().x(),localMbr.ll().y(),0.0));
+        pts[2] = coordAdapter->localToDisplay(Point3f(localMbr.ur().x(),localMbr.ur().y(),0.0));
+        pts[3] = coordAdapter->localToDisplay(Point3f(localMbr.ll().x(),localMbr.ur().y(),0.0));
+        Point2f halfBot = (localMbr.ll() + Point2f(localMbr.ur().x(),localMbr.ll().y()))/2.0;
+        pts[4] = coordAdapter->localToDisplay(Point3f(halfBot.x(),halfBot.y(),0.0));
+        Point2f halfTop = (Point2f(localMbr.ll().x(),localMbr.ur().y()) + localMbr.ur())/2.0;
+        pts[5] = coordAdapter->localToDisplay(Point3f(halfTop.x(),halfTop.y(),0.0));
+        Point2f halfLeft = (localMbr.ll() + Point2f(localMbr.ll().x(),localMbr.ur().y()))/2.0;
+        pts[6] = coordAdapter->localToDisplay(Point3f(halfLeft.x(),halfLeft.y(),0.0));
+        Point2f halfRight = (Point2f(localMbr.ur().x(),localMbr.ll().y()) + localMbr.ur())/2.0;
+        pts[7] = coordAdapter->localToDisplay(Point3f(halfRight.x(),halfRight.y(),0.0));
+        Point3f minPt = pts[0],maxPt = pts[0];
+        for (unsigned int ii=1;ii<8;ii++)
+        {
+            minPt = minPt.cwiseMin(pts[ii]);
+            maxPt = maxPt.cwiseMax(pts[ii]);
+        }
+        cornerPoints[0] = Point3f(minPt.x(),minPt.y(),minPt.z());
+        cornerPoints[1] = Point3f(maxPt.x(),minPt.y(),minPt.z());
+        cornerPoints[2] = Point3f(maxPt.x(),maxPt.y(),minPt.z());
+        cornerPoints[3] = Point3f(minPt.x(),maxPt.y(),minPt.z());
+        cornerPoints[4] = Point3f(minPt.x(),minPt.y(),maxPt.z());
+        cornerPoints[5] = Point3f(maxPt.x(),minPt.y(),maxPt.z());
+        cornerPoints[6] = Point3f(maxPt.x(),maxPt.y(),maxPt.z());
+        cornerPoints[7] = Point3f(minPt.x(),maxPt.y(),maxPt.z());
+        for (unsigned int ii=0;ii<4;ii++)
+            cornerNorms[ii] = pts[ii];
+        Point2f mid = (localMbr.ur()+localMbr.ll())/2.0;
+        childMbr[0] = Mbr(localMbr.ll(),mid);
+        childMbr[1] = Mbr(Point2f(mid.x(),localMbr.ll().y()),Point2f(localMbr.ur().x(),mid.y()));
+        childMbr[2] = Mbr(Point2f(localMbr.ll().x(),mid.y()),Point2f(mid.x(),localMbr.ur().y()));
+        childMbr[3] = Mbr(mid,localMbr.ur());
+    }
+    ~OldCullable()
+    {
+        for (unsigned int ii=0;ii<4;ii++)
+            delete children[ii];
+    }
+
+    bool hasChildren() { return children[0] || children[1] || children[2] || children[3]; }
+    bool isEmpty() { return drawables.empty() && childDrawables.empty(); }
+
+    OldCullable *getOrAddChild(int which,OldCullTree *tree);
+    void possibleRemoveChild(int which)
+    {
+        if (children[which] && !children[which]->hasChildren() && children[which]->isEmpty())
+        {
+            delete children[which];
+            children[which] = NULL;
+        }
+    }
+
+    void split(OldCullTree *tree)
+    {
+        for (const FakeDrawableRef &draw : drawables)
+            addDrawableToChildren(tree,draw->localMbr,draw);
+        drawables.clear();
+    }
+
+    void addDrawableToChildren(OldCullTree *tree,Mbr drawLocalMbr,FakeDrawableRef draw)
+    {
+        for (unsigned int ii=0;ii<4;ii++)
+            if (childMbr[ii].overlaps(drawLocalMbr))
+            {
+                OldCullable *child = getOrAddChild(ii,tree);
+                child->addDrawable(tree,drawLocalMbr,draw);
+            }
+    }
+
+    void addDrawable(OldCullTree *tree,Mbr drawLocalMbr,FakeDrawableRef draw);
+
+    void remDrawable(OldCullTree *tree,Mbr drawLocalMbr,FakeDrawableRef draw);
+
+    Point3f cornerPoints[8];
+    Vector3f cornerNorms[4];
+    Mbr localMbr;
+    int height;
+    Mbr childMbr[4];
+    OldCullable *children[4];
+    FakeDrawableSet drawables,childDrawables;
+};
+
+class OldCullTree
+{
+public:
+    OldCullTree(CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth)
+    : coordAdapter(coordAdapter), maxDrawPerNode(8)
+    {
+        top = new OldCullable(coordAdapter,localMbr,depth);
+    }
+    ~OldCullTree() { delete top; }
+
+    CoordSystemDisplayAdapter *coordAdapter;
+    int maxDrawPerNode;
+    OldCullable *top;
+};
+
+OldCullable *OldCullable::getOrAddChild(int which,OldCullTree *tree)
+{
+    if (height == 0)
+        return NULL;
+    if (!children[which])
+        children[which] = new OldCullable(tree->coordAdapter,childMbr[which],height-1);
+    return children[which];
+}
+
+void OldCullable::addDrawable(OldCullTree *tree,Mbr drawLocalMbr,FakeDrawableRef draw)
+{
+    childDrawables.insert(draw);
+    if (draw->canMove || !drawLocalMbr.valid())
+    {
+        drawables.insert(draw);
+        return;
+    }
+    if ((int)drawables.size() > tree->maxDrawPerNode && height > 0)
+    {
+        drawables.insert(draw);
+        split(tree);
+    }
+    if (localMbr.contained(drawLocalMbr))
+        drawables.insert(draw);
+    else {
+        if (hasChildren())
+            addDrawableToChildren(tree,drawLocalMbr,draw);
+        else
+            drawables.insert(draw);
+    }
+}
+
+void OldCullable::remDrawable(OldCullTree *tree,Mbr drawLocalMbr,FakeDrawableRef draw)
+{
+    childDrawables.erase(draw);
+    drawables.erase(draw);
+    if (height > 0)
+        for (unsigned int ii=0;ii<4;ii++)
+            if (children[ii] && childMbr[ii].overlaps(drawLocalMbr))
+            {
+                children[ii]->remDrawable(tree,drawLocalMbr,draw);
+                possibleRemoveChild(ii);
+            }
+    if ((int)childDrawables.size() < tree->maxDrawPerNode)
+    {
+        drawables = childDrawables;
+        for (unsigned int ii=0;ii<4;ii++)
+        {
+            delete children[ii];
+            children[ii] = NULL;
+        }
+    }
+}
+
+// The old renderer's walk, with the message sends turned into function calls
+class OldFinder
+{
+public:
+    OldFinder(const FakeGlobeView &view) : view(view) { }
+
+    Mbr calcCurvedMBR(Point3f *corners)
+    {
+        Mbr localScreenMbr;
+        for (unsigned int ii=0;ii<8;ii++)
+            localScreenMbr.addPoint(view.pointOnScreen(Point3d(corners[ii].x(),corners[ii].y(),corners[ii].z())));
+        return localScreenMbr;
+    }
+
+    void mergeDrawableSet(const FakeDrawableSet &newDrawables,std::vector<int> &toDraw,int *considered)
+    {
+        *considered += newDrawables.size();
+        for (const FakeDrawableRef &draw : newDrawables)
+            toDraw.push_back(draw->slot);
+    }
+
+    void findDrawables(OldCullable *cullable,bool isTopLevel,std::vector<int> &toDraw,int *considered)
+    {
+        bool inView = isTopLevel;
+        for (unsigned int ii=0;ii<4 && !inView;ii++)
+            if (cullable->cornerNorms[ii].dot(view.eyeVec) > 0)
+                inView = true;
+        if (!inView)
+            return;
+        Mbr localScreenMbr = calcCurvedMBR(&cullable->cornerPoints[0]);
+        if (!view.screenMbr.overlaps(localScreenMbr))
+            return;
+        float localScreenArea = localScreenMbr.area();
+        float screenArea = view.screenMbr.area();
+        if (isTopLevel || (localScreenArea > screenArea/4 && cullable->hasChildren()))
+        {
+            mergeDrawableSet(cullable->drawables,toDraw,considered);
+            for (unsigned int ii=0;ii<4;ii++)
+                if (cullable->children[ii])
+                    findDrawables(cullable->children[ii],false,toDraw,considered);
+        } else
+            mergeDrawableSet(cullable->childDrawables,toDraw,considered);
+    }
+
+    const FakeGlobeView &view;
+};
+
+// Features of all sizes scattered over the globe
+FakeDrawableRef MakeDrawable(std::mt19937 &rng,SimpleIdentity drawId)
+{
+    std::uniform_real_distribution<double> unit(0.0,1.0);
+    FakeDrawableRef draw(new FakeDrawable());
+    draw->drawId = drawId;
+    draw->canMove = unit(rng) < 0.005;
+    double size = 1e-4 * pow(5000.0,unit(rng));
+    double lon = (unit(rng) * 2.0 - 1.0) * M_PI;
+    double lat = asin(unit(rng) * 2.0 - 1.0);
+    double west = std::max(-M_PI,lon - size/2.0), east = std::min(M_PI,lon + size/2.0);
+    double south = std::max(-M_PI/2.0,lat - size/4.0), north = std::min(M_PI/2.0,lat + size/4.0);
+    draw->localMbr = Mbr(Point2f(west,south),Point2f(east,north));
+    if (unit(rng) < 0.002)
+        draw->localMbr = Mbr();
+    return draw;
+}
+
+// Somewhere on the globe at the given height
+FakeGlobeView MakeView(std::mt19937 &rng,double height,const Point2f &frameSize)
+{
+    std::uniform_real_distribution<double> unit(0.0,1.0);
+    double lon = (unit(rng) * 2.0 - 1.0) * M_PI;
+    double lat = asin((unit(rng) * 2.0 - 1.0) * 0.95);
+    return FakeGlobeView(lon,lat,height,frameSize);
+}
+
+CullView MakeCullView(const FakeGlobeView &view)
+{
+    return CullView(view.modelTrans,view.nearPlane,view.frustLL,view.frustUR,view.frameSize,view.screenMbr,view.eyeVec);
+}
+
+// Is any of the drawable really on the screen
+bool DrawableIsVisible(const FakeDrawable &draw,SphereDisplayAdapter &adapter,const FakeGlobeView &view)
+{
+    if (!draw.localMbr.valid())
+        return true;
+    for (unsigned int ix=0;ix<3;ix++)
+        for (unsigned int iy=0;iy<3;iy++)
+        {
+            Point3d loc(draw.localMbr.ll().x() + (draw.localMbr.ur().x() - draw.localMbr.ll().x()) * ix / 2.0,
+                        draw.localMbr.ll().y() + (draw.localMbr.ur().y() - draw.localMbr.ll().y()) * iy / 2.0,0.0);
+            if (view.isVisible(adapter.localToDisplay(loc)))
+                return true;
+        }
+    return false;
+}
+
+void AddDrawable(CullTree &tree,const FakeDrawableRef &draw)
+{
+    tree.addDrawable(draw->slot,draw->localMbr,draw->canMove);
+}
+
+void AddDrawable(OldCullTree &tree,const FakeDrawableRef &draw)
+{
+    tree.top->addDrawable(&tree,draw->localMbr,draw);
+}
+
+void RemDrawable(OldCullTree &tree,const FakeDrawableRef &draw)
+{
+    tree.top->remDrawable(&tree,draw->localMbr,draw);
+}
+
+std::set<int> Unique(const std::vector<int> &slots)
+{
+    return std::set<int>(slots.begin(),slots.end());
+}
+
+bool RunChecks(SphereDisplayAdapter &adapter,int depth,const Point2f &frameSize,std::mt19937 &rng)
+{
+    Mbr globeMbr(Point2f(-M_PI,-M_PI/2.0),Point2f(M_PI,M_PI/2.0));
+    CullTree tree(&adapter,globeMbr,depth);
+    OldCullTree oldTree(&adapter,globeMbr,depth);
+    std::vector<FakeDrawableRef> drawables;
+    for (int ii=0;ii<5000;ii++)
+    {
+        FakeDrawableRef draw = MakeDrawable(rng,ii+1);
+        draw->slot = ii;
+        drawables.push_back(draw);
+        AddDrawable(tree,draw);
+        AddDrawable(oldTree,draw);
+    }
+
+    // Take some out and put new ones in their slots
+    std::uniform_int_distribution<int> which(0,(int)drawables.size()-1);
+    for (int ii=0;ii<2000;ii++)
+    {
+        int pick = which(rng);
+        tree.remDrawable(drawables[pick]->slot);
+        RemDrawable(oldTree,drawables[pick]);
+        FakeDrawableRef draw = MakeDrawable(rng,drawables.size()+ii+1);
+        draw->slot = pick;
+        drawables[pick] = draw;
+        AddDrawable(tree,draw);
+        AddDrawable(oldTree,draw);
+    }
+
+    // Everything is in there once and nothing else is
+    std::vector<int> all;
+    tree.getAllDrawables(all);
+    std::set<int> allSlots = Unique(all);
+    if (allSlots.size() != drawables.size() || *allSlots.begin() != 0 || *allSlots.rbegin() != (int)drawables.size()-1)
+    {
+        fprintf(stderr,"Cull tree has %d drawables, expected %d\n",(int)allSlots.size(),(int)drawables.size());
+        return false;
+    }
+
+    // Anything the old tree found that's really on screen, the new one has to find too
+    double heights[4] = {3.0,0.3,0.01,0.00001};
+    int numOld = 0,numNew = 0;
+    for (double height : heights)
+        for (int ii=0;ii<50;ii++)
+        {
+            FakeGlobeView view = MakeView(rng,height,frameSize);
+            std::vector<int> found,oldFound;
+            int considered = 0;
+            tree.findDrawables(MakeCullView(view),found,&considered);
+            OldFinder(view).findDrawables(oldTree.top,true,oldFound,&considered);
+            std::set<int> foundSlots = Unique(found), oldSlots = Unique(oldFound);
+            numOld += oldSlots.size();
+            numNew += foundSlots.size();
+            for (int slot : oldSlots)
+                if (!foundSlots.count(slot) && DrawableIsVisible(*drawables[slot],adapter,view))
+                {
+                    fprintf(stderr,"Height %g: missed visible drawable in slot %d\n",height,slot);
+                    return false;
+                }
+        }
+    // It shouldn't get there by returning everything
+    if (numNew > 2*numOld)
+    {
+        fprintf(stderr,"Cull tree found %d drawables, the old one %d\n",numNew,numOld);
+        return false;
+    }
+
+    // Empty it out and it should collapse back to the top
+    for (const FakeDrawableRef &draw : drawables)
+        tree.remDrawable(draw->slot);
+    all.clear();
+    tree.getAllDrawables(all);
+    if (!all.empty() || tree.getCount() != 1)
+    {
+        fprintf(stderr,"Empty cull tree has %d drawables and %d nodes\n",(int)all.size(),tree.getCount());
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, const char * argv[])
+{
+    int numDrawables = 100000;
+    int numViews = 200;
+    int depth = 3;
+
+    for (int ii=1;ii<argc;ii++)
+    {
+        int *val = NULL;
+        if (!strcmp(argv[ii],"-drawables"))
+            val = &numDrawables;
+        else if (!strcmp(argv[ii],"-views"))
+            val = &numViews;
+        else if (!strcmp(argv[ii],"-depth"))
+            val = &depth;
+        if (!val || ii+1 >= argc)
+        {
+            fprintf(stderr,"usage: %s [-drawables n] [-views n] [-depth n]\n",argv[0]);
+            return -1;
+        }
+        *val = atoi(argv[++ii]);
+        if (*val < (val == &depth ? 0 : 1))
+        {
+            fprintf(stderr,"Bad value for %s\n",argv[ii-1]);
+            return -1;
+        }
+    }
+
+    SphereDisplayAdapter adapter;
+    Point2f frameSize(2048,1536);
+    std::mt19937 rng(1234);
+    if (!RunChecks(adapter,depth,frameSize,rng))
+    {
+        fprintf(stderr,"Checks failed\n");
+        return -1;
+    }
+    printf("Checks passed\n");
+
+    std::vector<FakeDrawableRef> drawables;
+    for (int ii=0;ii<numDrawables;ii++)
+    {
+        FakeDrawableRef draw = MakeDrawable(rng,ii+1);
+        draw->slot = ii;
+        drawables.push_back(draw);
+    }
+
+    // Build both
+    Mbr globeMbr(Point2f(-M_PI,-M_PI/2.0),Point2f(M_PI,M_PI/2.0));
+    Clock::time_point startTime = Clock::now();
+    OldCullTree oldTree(&adapter,globeMbr,depth);
+    for (const FakeDrawableRef &draw : drawables)
+        AddDrawable(oldTree,draw);
+    double oldBuildTime = SecondsSince(startTime);
+    startTime = Clock::now();
+    CullTree tree(&adapter,globeMbr,depth);
+    for (const FakeDrawableRef &draw : drawables)
+        AddDrawable(tree,draw);
+    double newBuildTime = SecondsSince(startTime);
+
+    printf("%d drawables, depth %d, %d nodes\n",numDrawables,depth,tree.getCount());
+    printf("%-12s %10s %10s %10s %10s %8s\n","","old found","new found","old ms","new ms","");
+    printf("%-12s %10s %10s %10.3f %10.3f %7.1fx\n","add all","","",oldBuildTime * 1e3,newBuildTime * 1e3,oldBuildTime / newBuildTime);
+
+    // Take drawables out and put them back, like tiles loading
+    int numChurn = std::min(numDrawables,5000);
+    std::uniform_int_distribution<int> which(0,numDrawables-1);
+    std::vector<int> churn;
+    for (int ii=0;ii<numChurn;ii++)
+        churn.push_back(which(rng));
+    startTime = Clock::now();
+    for (int pick : churn)
+    {
+        RemDrawable(oldTree,drawables[pick]);
+        AddDrawable(oldTree,drawables[pick]);
+    }
+    double oldChurnTime = SecondsSince(startTime);
+    startTime = Clock::now();
+    for (int pick : churn)
+    {
+        tree.remDrawable(drawables[pick]->slot);
+        AddDrawable(tree,drawables[pick]);
+    }
+    double newChurnTime = SecondsSince(startTime);
+    printf("%-12s %10s %10s %10.4f %10.4f %7.1fx\n","swap one","","",oldChurnTime / numChurn * 1e3,newChurnTime / numChurn * 1e3,oldChurnTime / newChurnTime);
+
+    // Cull from a range of heights
+    double heights[5] = {3.0,1.0,0.1,0.01,0.001};
+    std::vector<int> found;
+    for (double height : heights)
+    {
+        std::vector<FakeGlobeView> views;
+        for (int ii=0;ii<numViews;ii++)
+            views.push_back(MakeView(rng,height,frameSize));
+
+        int considered = 0;
+        size_t oldFound = 0,newFound = 0;
+        startTime = Clock::now();
+        for (const FakeGlobeView &view : views)
+        {
+            found.clear();
+            OldFinder(view).findDrawables(oldTree.top,true,found,&considered);
+            oldFound += found.size();
+        }
+        double oldTime = SecondsSince(startTime);
+
+        startTime = Clock::now();
+        for (const FakeGlobeView &view : views)
+        {
+            found.clear();
+            tree.findDrawables(MakeCullView(view),found,&considered);
+            newFound += found.size();
+        }
+        double newTime = SecondsSince(startTime);
+
+        char name[32];
+        sprintf(name,"height %g",height);
+        printf("%-12s %10d %10d %10.3f %10.3f %7.1fx\n",name,(int)(oldFound / numViews),(int)(newFound / numViews),
+               oldTime / numViews * 1e3,newTime / numViews * 1e3,oldTime / newTime);
+    }
+
+    return 0;
+}
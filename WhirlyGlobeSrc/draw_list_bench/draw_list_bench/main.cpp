@@ -0,0 +1,440 @@
+//
+//  main.cpp
+//  draw_list_bench
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include <set>
+#include <tuple>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include "DrawList.h"
+
+typedef std::chrono::steady_clock Clock;
+
+double SecondsSince(Clock::time_point startTime)
+{
+    return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+namespace WhirlyKit
+{
+
+// Stands in for the real drawable.  The draw list never looks inside, but
+//  the old sort did, so the calls are virtual like they are in the library.
+class Drawable
+{
+public:
+    Drawable(unsigned int priority,SimpleIdentity programID,SimpleIdentity texID,bool alpha,bool zBuffer)
+    : priority(priority), programID(programID), texID(texID), alpha(alpha), zBuffer(zBuffer), on(true), drawListSlot(-1) { }
+    virtual ~Drawable() { }
+
+    virtual unsigned int getDrawPriority() const { return priority; }
+    virtual SimpleIdentity getProgram() const { return programID; }
+    virtual SimpleIdentity getMainTexture() const { return texID; }
+    virtual bool hasAlpha() const { return alpha; }
+    virtual bool getRequestZBuffer() const { return zBuffer; }
+    virtual bool isOn() const { return on; }
+
+    uint64_t getDrawListKey() const { return DrawList::makeKey(getDrawPriority(),getRequestZBuffer(),getProgram(),getMainTexture()); }
+    int getDrawListSlot() const { return drawListSlot; }
+    void setDrawListSlot(int slot) { drawListSlot = slot; }
+
+    unsigned int priority;
+    SimpleIdentity programID,texID;
+    bool alpha,zBuffer,on;
+    int drawListSlot;
+    // Where it sits in the fake world
+    int x,y;
+};
+
+}
+
+using namespace WhirlyKit;
+
+typedef std::shared_ptr<Drawable> DrawableRef;
+
+// Same size as the renderer's container with its three matrices
+class DrawableContainer
+{
+public:
+    DrawableContainer(Drawable *drawable) : drawable(drawable) { mats[0] = 1.0; }
+    Drawable *drawable;
+    double mats[48];
+};
+
+// The sort the renderer used to do every frame
+class OldSort
+{
+public:
+    OldSort(bool useAlpha,bool useZBuffer) : useAlpha(useAlpha), useZBuffer(useZBuffer) { }
+    bool operator()(const DrawableContainer &conA, const DrawableContainer &conB) const
+    {
+        Drawable *a = conA.drawable;
+        Drawable *b = conB.drawable;
+        if (useAlpha)
+            if (a->hasAlpha() != b->hasAlpha())
+                return !a->hasAlpha();
+
+        if (a->getDrawPriority() == b->getDrawPriority())
+        {
+            if (useZBuffer)
+            {
+                bool bufferA = a->getRequestZBuffer();
+                bool bufferB = b->getRequestZBuffer();
+                if (bufferA != bufferB)
+                    return !bufferA;
+            }
+        }
+
+        return a->getDrawPriority() < b->getDrawPriority();
+    }
+
+    bool useAlpha,useZBuffer;
+};
+
+// A grid of drawables the way tiles and vectors cover a map.
+// Some are layered on top of each other at different priorities, the way overlays are.
+class World
+{
+public:
+    World(int numDrawables,std::mt19937 &rng) : rng(rng)
+    {
+        gridSize = 1;
+        while (gridSize*gridSize*4 < numDrawables)
+            gridSize++;
+        for (int ii=0;ii<numDrawables;ii++)
+            drawables.push_back(makeDrawable());
+    }
+
+    DrawableRef makeDrawable()
+    {
+        std::uniform_int_distribution<int> layerDist(0,7),progDist(1,4),posDist(0,gridSize-1),pct(0,99);
+        int layer = layerDist(rng);
+        DrawableRef draw(new Drawable(100+layer*10,progDist(rng),nextTexID++,pct(rng) < 10,pct(rng) < 30));
+        draw->x = posDist(rng);
+        draw->y = posDist(rng);
+        return draw;
+    }
+
+    // What the cull tree hands back for a window on the grid.
+    // Drawables near the edges show up more than once, like they do from the cull tree.
+    void cull(int x0,int y0,int size,std::vector<Drawable *> &found)
+    {
+        found.clear();
+        for (unsigned int ii=0;ii<drawables.size();ii++)
+        {
+            Drawable *draw = drawables[ii].get();
+            int dx = draw->x - x0, dy = draw->y - y0;
+            if (dx >= 0 && dx < size && dy >= 0 && dy < size)
+            {
+                found.push_back(draw);
+                if (dx == 0 || dy == 0)
+                    found.push_back(draw);
+            }
+        }
+        std::shuffle(found.begin(),found.end(),rng);
+    }
+
+    std::mt19937 &rng;
+    int gridSize;
+    SimpleIdentity nextTexID = 1;
+    std::vector<DrawableRef> drawables;
+};
+
+// The renderer before: a set per pass to weed out repeats, then sort the lot
+void OldFrame(const std::vector<std::vector<Drawable *> > &passes,std::vector<DrawableContainer> &drawList)
+{
+    drawList.clear();
+    for (unsigned int off=0;off<passes.size();off++)
+    {
+        std::set<Drawable *> toDraw;
+        for (Drawable *draw : passes[off])
+            if (toDraw.find(draw) == toDraw.end() && draw->isOn())
+                toDraw.insert(draw);
+        for (Drawable *draw : toDraw)
+            drawList.push_back(DrawableContainer(draw));
+    }
+    std::sort(drawList.begin(),drawList.end(),OldSort(true,false));
+}
+
+// And now: mark what's visible and ask for the order
+void NewFrame(DrawList &list,const std::vector<std::vector<Drawable *> > &passes,const std::vector<Drawable *> &extras,
+              std::vector<DrawableContainer> &drawList,std::vector<int> &drawOrder)
+{
+    drawList.clear();
+    list.startFrame();
+    for (unsigned int off=0;off<passes.size();off++)
+        for (Drawable *draw : passes[off])
+            if (draw->isOn() && list.addVisible(draw->getDrawListSlot(),off,draw->getDrawListKey(),draw->hasAlpha(),(int)drawList.size()))
+                drawList.push_back(DrawableContainer(draw));
+    for (Drawable *draw : extras)
+    {
+        list.addExtra(draw->getDrawListKey(),draw->hasAlpha(),(int)drawList.size());
+        drawList.push_back(DrawableContainer(draw));
+    }
+    list.getDrawOrder(true,drawOrder);
+}
+
+// Work out what the draw list should have come up with and compare
+bool CheckOrder(const std::vector<std::vector<Drawable *> > &passes,const std::vector<Drawable *> &extras,
+                const std::vector<DrawableContainer> &drawList,const std::vector<int> &drawOrder,const char *what)
+{
+    // Alpha, key, extras after drawables with the same key, then slot (or container) and pass
+    typedef std::tuple<bool,uint64_t,int,int,int> SortKey;
+    std::vector<std::pair<SortKey,Drawable *> > expected;
+    for (unsigned int off=0;off<passes.size();off++)
+    {
+        std::set<Drawable *> seen;
+        for (Drawable *draw : passes[off])
+            if (draw->isOn() && seen.insert(draw).second)
+                expected.push_back(std::make_pair(SortKey(draw->hasAlpha(),draw->getDrawListKey(),0,draw->getDrawListSlot(),off),draw));
+    }
+    for (unsigned int ii=0;ii<extras.size();ii++)
+        expected.push_back(std::make_pair(SortKey(extras[ii]->hasAlpha(),extras[ii]->getDrawListKey(),1,ii,0),extras[ii]));
+    std::sort(expected.begin(),expected.end(),
+              [](const std::pair<SortKey,Drawable *> &a,const std::pair<SortKey,Drawable *> &b) { return a.first < b.first; });
+
+    if (expected.size() != drawOrder.size())
+    {
+        fprintf(stderr,"%s: drew %d, expected %d\n",what,(int)drawOrder.size(),(int)expected.size());
+        return false;
+    }
+    for (unsigned int ii=0;ii<expected.size();ii++)
+        if (drawList[drawOrder[ii]].drawable != expected[ii].second)
+        {
+            fprintf(stderr,"%s: wrong drawable at %d of %d\n",what,ii,(int)expected.size());
+            return false;
+        }
+
+    // And it has to agree with the old sort where the old sort cared
+    OldSort oldSort(true,false);
+    for (unsigned int ii=1;ii<drawOrder.size();ii++)
+        if (oldSort(drawList[drawOrder[ii]],drawList[drawOrder[ii-1]]))
+        {
+            fprintf(stderr,"%s: out of order at %d\n",what,ii);
+            return false;
+        }
+
+    return true;
+}
+
+void AddToList(DrawList &list,const DrawableRef &draw)
+{
+    draw->setDrawListSlot(list.addDrawable(draw.get(),draw->getDrawListKey()));
+}
+
+void RemoveFromList(DrawList &list,const DrawableRef &draw)
+{
+    list.removeDrawable(draw->getDrawListSlot());
+    draw->setDrawListSlot(-1);
+}
+
+// Swap out some drawables for new ones
+void Churn(World &world,DrawList &list,int num)
+{
+    std::uniform_int_distribution<int> which(0,(int)world.drawables.size()-1);
+    for (int ii=0;ii<num;ii++)
+    {
+        int pick = which(world.rng);
+        RemoveFromList(list,world.drawables[pick]);
+        world.drawables[pick] = world.makeDrawable();
+        AddToList(list,world.drawables[pick]);
+    }
+}
+
+bool RunChecks(std::mt19937 &rng)
+{
+    std::vector<DrawableContainer> drawList;
+    std::vector<int> drawOrder;
+
+    // Small windows take the sorting path and big ones the walk through everything
+    int sizes[2] = {6,60};
+    for (int size : sizes)
+    {
+        World world(4000,rng);
+        DrawList list;
+        for (const DrawableRef &draw : world.drawables)
+            AddToList(list,draw);
+        std::uniform_int_distribution<int> pos(0,world.gridSize/2),pct(0,99);
+        char what[64];
+
+        for (int frame=0;frame<200;frame++)
+        {
+            sprintf(what,"Window %d, frame %d",size,frame);
+
+            // One to three passes, like a wrapped map
+            std::vector<std::vector<Drawable *> > passes((frame % 3) + 1);
+            for (unsigned int off=0;off<passes.size();off++)
+                world.cull(pos(rng),pos(rng),size,passes[off]);
+
+            // Priorities, programs and visibility change under us
+            for (int ii=0;ii<20;ii++)
+            {
+                Drawable *draw = world.drawables[rng() % world.drawables.size()].get();
+                switch (pct(rng) % 4)
+                {
+                    case 0: draw->priority = 100 + (pct(rng) % 8) * 10; break;
+                    case 1: draw->programID = 1 + pct(rng) % 4; break;
+                    case 2: draw->alpha = !draw->alpha; break;
+                    case 3: draw->on = !draw->on; break;
+                }
+            }
+
+            // Some generated drawables that aren't in the list
+            std::vector<DrawableRef> generated;
+            std::vector<Drawable *> extras;
+            for (int ii=0;ii<frame % 5;ii++)
+            {
+                generated.push_back(world.makeDrawable());
+                extras.push_back(generated.back().get());
+            }
+
+            NewFrame(list,passes,extras,drawList,drawOrder);
+            if (!CheckOrder(passes,extras,drawList,drawOrder,what))
+                return false;
+
+            // Swap some out so slots get reused
+            if (frame % 2)
+            {
+                Churn(world,list,50);
+            }
+        }
+
+        if (list.getNumDrawables() != (int)world.drawables.size())
+        {
+            fprintf(stderr,"Window %d: draw list has %d drawables, expected %d\n",size,list.getNumDrawables(),(int)world.drawables.size());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, const char * argv[])
+{
+    int numDrawables = 20000;
+    int numFrames = 300;
+    int churn = 50;
+
+    for (int ii=1;ii<argc;ii++)
+    {
+        int *val = NULL;
+        if (!strcmp(argv[ii],"-drawables"))
+            val = &numDrawables;
+        else if (!strcmp(argv[ii],"-frames"))
+            val = &numFrames;
+        else if (!strcmp(argv[ii],"-churn"))
+            val = &churn;
+        if (!val || ii+1 >= argc)
+        {
+            fprintf(stderr,"usage: %s [-drawables n] [-frames n] [-churn n]\n",argv[0]);
+            return -1;
+        }
+        *val = atoi(argv[++ii]);
+        if (*val < (val == &churn ? 0 : 1))
+        {
+            fprintf(stderr,"Bad value for %s\n",argv[ii-1]);
+            return -1;
+        }
+    }
+
+    std::mt19937 rng(1234);
+    if (!RunChecks(rng))
+    {
+        fprintf(stderr,"Checks failed\n");
+        return -1;
+    }
+    printf("Checks passed\n");
+
+    printf("%d drawables, %d frames\n",numDrawables,numFrames);
+    printf("%-34s %10s %10s %10s %8s\n","","visible","old ms","new ms","");
+
+    class Scenario
+    {
+    public:
+        const char *name;
+        // Fraction of the grid on screen, passes per frame, drawables swapped per frame
+        double window;
+        int numPasses;
+        int churn;
+    };
+    Scenario scenarios[] = {
+        {"whole map, still",1.0,1,0},
+        {"half the map, still",0.7,1,0},
+        {"half the map, tiles loading",0.7,1,churn},
+        {"half the map, wrapped 3 times",0.7,3,churn},
+        {"zoomed in, tiles loading",0.2,1,churn},
+    };
+
+    for (const Scenario &scenario : scenarios)
+    {
+        World world(numDrawables,rng);
+        int size = std::max(1,(int)(world.gridSize * scenario.window));
+        std::uniform_int_distribution<int> pos(0,world.gridSize-size);
+
+        // Cull ahead of time so we're only timing what changed
+        std::vector<std::vector<std::vector<Drawable *> > > frames(numFrames);
+        int x = pos(rng), y = pos(rng);
+        int numVisible = 0;
+        for (int frame=0;frame<numFrames;frame++)
+        {
+            if (frame % 10 == 0)
+            {
+                x = pos(rng);
+                y = pos(rng);
+            }
+            frames[frame].resize(scenario.numPasses);
+            for (int off=0;off<scenario.numPasses;off++)
+            {
+                world.cull(x,y,size,frames[frame][off]);
+                numVisible += frames[frame][off].size();
+            }
+        }
+
+        std::vector<DrawableContainer> drawList;
+        std::vector<int> drawOrder;
+        std::vector<Drawable *> extras;
+
+        // The old way didn't have anything to keep up as drawables came and went
+        Clock::time_point startTime = Clock::now();
+        for (int frame=0;frame<numFrames;frame++)
+            OldFrame(frames[frame],drawList);
+        double oldTime = SecondsSince(startTime);
+
+        // Drawables coming and going cost the new way, so take some out and put them back each frame.
+        // That keeps the culled frames good.
+        DrawList list;
+        for (const DrawableRef &draw : world.drawables)
+            AddToList(list,draw);
+        startTime = Clock::now();
+        for (int frame=0;frame<numFrames;frame++)
+        {
+            if (scenario.churn > 0)
+            {
+                std::uniform_int_distribution<int> which(0,(int)world.drawables.size()-1);
+                for (int ii=0;ii<scenario.churn;ii++)
+                {
+                    int pick = which(rng);
+                    RemoveFromList(list,world.drawables[pick]);
+                    AddToList(list,world.drawables[pick]);
+                }
+            }
+            NewFrame(list,frames[frame],extras,drawList,drawOrder);
+        }
+        double newTime = SecondsSince(startTime);
+
+        printf("%-34s %10d %10.3f %10.3f %7.1fx\n",scenario.name,numVisible / numFrames,
+               oldTime / numFrames * 1e3,newTime / numFrames * 1e3,oldTime / newTime);
+    }
+
+    return 0;
+}
@@ -12,7 +12,7 @@
 using namespace Kompex;
 
 ElevationPyramid::ElevationPyramid(Kompex::SQLiteDatabase *db,const char *srs,GDALDataType dataType,double minX,double minY,double maxX,double maxY,unsigned int tileSizeX,unsigned int tileSizeY,bool compress,int minLevel,int maxLevel)
-: db(db), dataType(dataType), compress(compress), tileSizeX(tileSizeX), tileSizeY(tileSizeY), insertStmt(NULL),
+: db(db), dataType(dataType), compress(compress), tileSizeX(tileSizeX), tileSizeY(tileSizeY), writer(NULL), tableID(-1),
     minLevel(minLevel), maxLevel(maxLevel), minx(minX), miny(minY), maxx(maxX), maxy(maxY), srs(srs)
 {
     SQLiteStatement stmt(db);
@@ -42,7 +42,7 @@ ElevationPyramid::ElevationPyramid(Kompex::SQLiteDatabase *db,const char *srs,GD
 }
 
 ElevationPyramid::ElevationPyramid(Kompex::SQLiteDatabase *db,int newMaxLevel)
-: db(db)
+: db(db), writer(NULL), tableID(-1)
 {
     SQLiteStatement stmt(db);
     
@@ -123,79 +123,52 @@ bool CompressData(void *data,int dataLen,void **retData,int &retDataLen)
     return true;
 }
 
-bool ElevationPyramid::addElevationTile(void *tileData,int x,int y,int level)
+bool ElevationPyramid::startWriter(int numThreads,int batchSize)
 {
-    // Calculate a quad index for later use
-    int quadIndex = 0;
-    for (int iq=0;iq<level;iq++)
-        quadIndex += (1<<iq)*(1<<iq);
-    quadIndex += y*(1<<level) + x;
-    
-    if (!insertStmt)
+    if (writer)
+        delete writer;
+    writer = new TileDBWriter(db,(compress ? CompressData : NULL),numThreads,batchSize);
+    tableID = writer->addTable("elevationtiles");
+    if (tableID < 0)
     {
-        insertStmt = new SQLiteStatement(db);
-        insertStmt->Sql("INSERT INTO elevationtiles (data,level,x,y,quadindex) VALUES (@data,@level,@x,@y,@quadinex);");
+        fprintf(stderr,"%s\n",writer->getError().c_str());
+        return false;
     }
     
-    // Here we've got data to insert
-    if (tileData)
+    return true;
+}
+
+bool ElevationPyramid::addElevationTile(void *tileData,int x,int y,int level)
+{
+    if (!writer && !startWriter(0,1000))
+        return false;
+    
+    // No data means an empty blob.  That means the tile is all at zero.
+    unsigned int dataSize = tileData ? sizeof(unsigned short)*tileSizeX*tileSizeY : 0;
+    if (!writer->addTile(tableID, x, y, level, tileData, dataSize))
     {
-        unsigned int dataSize = sizeof(unsigned short)*tileSizeX*tileSizeY;
-        
-        if (compress)
-        {
-            void *compressOut;
-            int compressSize=0;
-            if (CompressData((void *)tileData, dataSize, &compressOut, compressSize))
-            {
-                // Now insert the samples into the database as a blob
-                try {
-                    insertStmt->BindBlob(1, compressOut, compressSize);
-                    insertStmt->BindInt(2, level);
-                    insertStmt->BindInt(3, x);
-                    insertStmt->BindInt(4, y);
-                    insertStmt->BindInt(5, quadIndex);
-                    insertStmt->Execute();
-                    insertStmt->Reset();
-                }
-                catch (SQLiteException &except)
-                {
-                    fprintf(stderr,"Failed to write blob to database:\n%s\n",except.GetString().c_str());
-                    return false;
-                }            
-            } else
-                return false;
-        }
-    } else {
-        // No data, so leave the blob empty.  This means the tile is all at zero.
-        try {
-            insertStmt->BindBlob(1, NULL, 0);
-            insertStmt->BindInt(2, level);
-            insertStmt->BindInt(3, x);
-            insertStmt->BindInt(4, y);
-            insertStmt->BindInt(5, quadIndex);
-            insertStmt->Execute();
-            insertStmt->Reset();
-        }
-        catch (SQLiteException &except)
-        {
-            fprintf(stderr,"Failed to write blob to database:\n%s\n",except.GetString().c_str());
-            return false;
-        }
+        fprintf(stderr,"%s\n",writer->getError().c_str());
+        return false;
     }
     
-//    if (insertStmt)
-//        delete insertStmt;
-//    insertStmt = NULL;
-    
     return true;
 }
 
+void ElevationPyramid::printStats(FILE *fp)
+{
+    if (writer)
+        writer->printStats(fp);
+}
+
 void ElevationPyramid::flush()
 {
-    if (insertStmt)
-        delete insertStmt;
-    insertStmt = NULL;
+    if (writer)
+    {
+        if (!writer->flush())
+            fprintf(stderr,"%s\n",writer->getError().c_str());
+        delete writer;
+    }
+    writer = NULL;
 }
 
 void ElevationPyramid::createIndex()
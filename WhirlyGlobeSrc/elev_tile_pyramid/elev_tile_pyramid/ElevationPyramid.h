@@ -18,6 +18,7 @@
 #include "KompexSQLiteStreamRedirection.h"
 #include "KompexSQLiteBlob.h"
 #include "KompexSQLiteException.h"
+#include "TileDBWriter.h"
 
 /** Elevation Pyramid is used to construct the elevation pyramid in a sqlite database.
   */
@@ -29,9 +30,16 @@ public:
     // Construct from a database and update a bit of info
     ElevationPyramid(Kompex::SQLiteDatabase *db,int maxLevel);
     
+    // Compress and write tiles on numThreads threads, committing every batchSize tiles.
+    // Call before adding tiles, otherwise they're compressed inline.
+    bool startWriter(int numThreads,int batchSize);
+    
     // Load the elevaiton tile and add it to the sqlite db
     bool addElevationTile(void *tileData,int x,int y,int level);
     
+    // Print out the tile writer's counters
+    void printStats(FILE *fp);
+    
     // Create the quadIndex index
     void createIndex();
     
@@ -62,8 +70,9 @@ protected:
     GDALDataType dataType;
     bool compress;
     bool valid;
-    // Precompiled insert statement
-    Kompex::SQLiteStatement *insertStmt;
+    // Does the compression and inserts
+    TileDBWriter *writer;
+    int tableID;
 };
 
 #endif /* defined(__elev_assemble_pyramid__ElevationPyramid__) */
@@ -0,0 +1,466 @@
+//
+//  ElevationSampler.cpp
+//  elev_tile_pyramid
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include "cpl_conv.h"
+#include "ElevationSampler.h"
+
+// Maximum number of pixels we'll load at once
+static int const MaxPixelLoad = 1048576;
+
+ElevationSampler::ElevationSampler(const char *inputFile,const char *destSRS,int pixelsX,int pixelsY)
+: valid(false), pixelsX(pixelsX), pixelsY(pixelsY), hSrcDS(NULL), hBand(NULL), hCTBack(NULL),
+    rasterXSize(0), rasterYSize(0), sourcePixelsRead(0), blockSX(0), blockSY(0), blockWidth(0)
+{
+    hSrcDS = GDALOpen( inputFile, GA_ReadOnly );
+    if (!hSrcDS)
+        return;
+    if (GDALGetRasterCount(hSrcDS) != 1)
+        return;
+    hBand = GDALGetRasterBand(hSrcDS, 1);
+    if (!hBand)
+        return;
+
+    double adfGeoTransform[6];
+    if (GDALGetGeoTransform( hSrcDS, adfGeoTransform) != CE_None)
+        return;
+    GDALInvGeoTransform( adfGeoTransform, adfInvGeoTransform );
+    rasterXSize = GDALGetRasterXSize(hSrcDS);
+    rasterYSize = GDALGetRasterYSize(hSrcDS);
+
+    // We only need to go from the destination back to the source
+    if (destSRS)
+    {
+        OGRSpatialReferenceH hSrcSRS = OSRNewSpatialReference(GDALGetProjectionRef(hSrcDS));
+        OGRSpatialReferenceH hTrgSRS = OSRNewSpatialReference(destSRS);
+        hCTBack = OCTNewCoordinateTransformation(hTrgSRS,hSrcSRS);
+        OSRDestroySpatialReference(hSrcSRS);
+        OSRDestroySpatialReference(hTrgSRS);
+        if (!hCTBack)
+            return;
+    }
+
+    valid = true;
+}
+
+ElevationSampler::~ElevationSampler()
+{
+    if (hCTBack)
+        OCTDestroyCoordinateTransformation(hCTBack);
+    hCTBack = NULL;
+    if (hSrcDS)
+        GDALClose(hSrcDS);
+    hSrcDS = NULL;
+}
+
+bool ElevationSampler::sampleTile(const TileSampleInfo &tile,SamplingType sampleType,float *tileData)
+{
+    if (!valid)
+        return false;
+
+    switch (sampleType)
+    {
+        case SampleSingle:
+            return sampleSingle(tile,tileData);
+            break;
+        case SampleMax:
+            return sampleMax(tile,tileData);
+            break;
+    }
+
+    return false;
+}
+
+bool ElevationSampler::readBlock(int sx,int sy,int ex,int ey)
+{
+    int width = ex-sx+1, height = ey-sy+1;
+    block.resize(width*height);
+    if (GDALRasterIO( hBand, GF_Read, sx, sy, width, height, &block[0], width, height, GDT_Float32, 0,  0) != CE_None)
+    {
+        fprintf(stderr,"Query failure in GDALRasterIO");
+        return false;
+    }
+    blockSX = sx;  blockSY = sy;  blockWidth = width;
+    sourcePixelsRead += width*height;
+
+    return true;
+}
+
+bool ElevationSampler::sampleSingle(const TileSampleInfo &tile,float *tileData)
+{
+    int numPixels = pixelsX*pixelsY;
+    srcX.resize(numPixels);
+    srcY.resize(numPixels);
+    windows.resize(4*numPixels);
+
+    for (unsigned int cy=0;cy<pixelsY;cy++)
+        for (unsigned int cx=0;cx<pixelsX;cx++)
+        {
+            srcX[cy*pixelsX+cx] = tile.minX + tile.cellX*cx;
+            srcY[cy*pixelsX+cx] = tile.minY + tile.cellY*cy;
+        }
+
+    // Project the whole tile back to the original data file in one go
+    if (hCTBack)
+        OCTTransform(hCTBack, numPixels, &srcX[0], &srcY[0], NULL);
+
+    // Figure out which four pixels each sample needs and how much of the source that covers
+    int sx=rasterXSize,sy=rasterYSize,ex=-1,ey=-1;
+    for (unsigned int ii=0;ii<numPixels;ii++)
+    {
+        double pixX = adfInvGeoTransform[0] + adfInvGeoTransform[1] * srcX[ii] + adfInvGeoTransform[2] * srcY[ii];
+        double pixY = adfInvGeoTransform[3] + adfInvGeoTransform[4] * srcX[ii] + adfInvGeoTransform[5] * srcY[ii];
+        int pixXint = (int)pixX,pixYint = (int)pixY;
+
+        // Keep the interpolation values around in the source arrays
+        srcX[ii] = pixX-pixXint;
+        srcY[ii] = pixY-pixYint;
+
+        int *win = &windows[4*ii];
+        win[0] = MIN(MAX(pixXint,0),rasterXSize-1);
+        win[1] = MIN(MAX(pixYint,0),rasterYSize-1);
+        win[2] = MIN(MAX(pixXint+1,0),rasterXSize-1);
+        win[3] = MIN(MAX(pixYint+1,0),rasterYSize-1);
+        sx = MIN(sx,win[0]);  sy = MIN(sy,win[1]);
+        ex = MAX(ex,win[2]);  ey = MAX(ey,win[3]);
+    }
+
+    // Usually the tile's footprint is small enough to read in one go
+    bool oneBlock = ((ex-sx+1)*(ey-sy+1) <= MaxPixelLoad);
+    if (oneBlock && !readBlock(sx, sy, ex, ey))
+        return false;
+
+    for (unsigned int ii=0;ii<numPixels;ii++)
+    {
+        int *win = &windows[4*ii];
+        // Coarse levels over large sources fall back to reading just the pixels we need
+        if (!oneBlock && !readBlock(win[0], win[1], win[2], win[3]))
+            return false;
+
+        int x0 = win[0]-blockSX, y0 = win[1]-blockSY;
+        int x1 = win[2]-blockSX, y1 = win[3]-blockSY;
+        float pix0 = block[y0*blockWidth+x0];
+        float pix1 = block[y0*blockWidth+x1];
+        float pix2 = block[y1*blockWidth+x1];
+        float pix3 = block[y1*blockWidth+x0];
+
+        // Now do a bilinear interpolation
+        double ta = srcX[ii], tb = srcY[ii];
+        float pixA = (pix1-pix0)*ta + pix0;
+        float pixB = (pix2-pix3)*ta + pix3;
+        tileData[ii] = (pixB-pixA)*tb+pixA;
+    }
+
+    return true;
+}
+
+bool ElevationSampler::searchForMaxPixel(int sx, int sy, int ex, int ey, float &maxPix)
+{
+    maxPix = -MAXFLOAT;
+
+    int rowSize = ex-sx+1;
+
+    // Number of rows to load at once
+    int maxRows = MaxPixelLoad / rowSize;
+    maxRows = MAX(1,maxRows);
+
+    for (int iy=sy;iy<=ey;iy+=maxRows)
+    {
+        int numRows = maxRows;
+        if (ey-iy<=numRows)
+            numRows = ey-iy+1;
+        if (!readBlock(sx, iy, ex, iy+numRows-1))
+            return false;
+
+        for (int which = 0; which < rowSize*numRows; which++)
+            maxPix = MAX(block[which],maxPix);
+    }
+
+    return true;
+}
+
+bool ElevationSampler::sampleMax(const TileSampleInfo &tile,float *tileData)
+{
+    int numPixels = pixelsX*pixelsY;
+    srcX.resize(4*numPixels);
+    srcY.resize(4*numPixels);
+    windows.resize(4*numPixels);
+
+    // Make a bounding box around each sample
+    for (unsigned int cy=0;cy<pixelsY;cy++)
+        for (unsigned int cx=0;cx<pixelsX;cx++)
+        {
+            double thisX = tile.minX + tile.cellX*cx;
+            double thisY = tile.minY + tile.cellY*cy;
+            double *boxX = &srcX[4*(cy*pixelsX+cx)], *boxY = &srcY[4*(cy*pixelsX+cx)];
+            boxX[0] = thisX-tile.cellX/2.0;  boxY[0] = thisY-tile.cellY/2.0;
+            boxX[1] = thisX+tile.cellX/2.0;  boxY[1] = thisY-tile.cellY/2.0;
+            boxX[2] = thisX+tile.cellX/2.0;  boxY[2] = thisY+tile.cellY/2.0;
+            boxX[3] = thisX-tile.cellX/2.0;  boxY[3] = thisY+tile.cellY/2.0;
+        }
+
+    // Project all the boxes into the source data at once
+    if (hCTBack)
+        OCTTransform(hCTBack, 4*numPixels, &srcX[0], &srcY[0], NULL);
+
+    int tsx=rasterXSize,tsy=rasterYSize,tex=-1,tey=-1;
+    for (unsigned int ii=0;ii<numPixels;ii++)
+    {
+        int sx=1000000,sy=1000000,ex=-1000000,ey=-1000000;
+        for (unsigned int pi=0;pi<4;pi++)
+        {
+            double thisX = srcX[4*ii+pi], thisY = srcY[4*ii+pi];
+            double pixX = adfInvGeoTransform[0] + adfInvGeoTransform[1] * thisX + adfInvGeoTransform[2] * thisY;
+            double pixY = adfInvGeoTransform[3] + adfInvGeoTransform[4] * thisX + adfInvGeoTransform[5] * thisY;
+            sx = MIN(sx,(int)floor(pixX));
+            sy = MIN(sy,(int)floor(pixY));
+            ex = MAX(ex,(int)ceil(pixX));
+            ey = MAX(ey,(int)ceil(pixY));
+        }
+        int *win = &windows[4*ii];
+        win[0] = MIN(MAX(0,sx),rasterXSize-1);
+        win[1] = MIN(MAX(0,sy),rasterYSize-1);
+        win[2] = MIN(MAX(0,ex),rasterXSize-1);
+        win[3] = MIN(MAX(0,ey),rasterYSize-1);
+        tsx = MIN(tsx,win[0]);  tsy = MIN(tsy,win[1]);
+        tex = MAX(tex,win[2]);  tey = MAX(tey,win[3]);
+    }
+
+    // If the whole tile fits, read it once and search in memory
+    if ((tex-tsx+1)*(tey-tsy+1) <= MaxPixelLoad)
+    {
+        if (!readBlock(tsx, tsy, tex, tey))
+            return false;
+
+        for (unsigned int ii=0;ii<numPixels;ii++)
+        {
+            int *win = &windows[4*ii];
+            float maxPix = -MAXFLOAT;
+            for (int iy=win[1];iy<=win[3];iy++)
+            {
+                const float *row = &block[(iy-blockSY)*blockWidth];
+                for (int ix=win[0];ix<=win[2];ix++)
+                    maxPix = MAX(row[ix-blockSX],maxPix);
+            }
+            tileData[ii] = maxPix;
+        }
+    } else {
+        // Search each cell in pieces
+        for (unsigned int ii=0;ii<numPixels;ii++)
+        {
+            int *win = &windows[4*ii];
+            if (!searchForMaxPixel(win[0], win[1], win[2], win[3], tileData[ii]))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+PyramidLayout::PyramidLayout(double minX,double minY,double maxX,double maxY,int pixelsX,int pixelsY,int minLevel,int maxLevel)
+: minX(minX), minY(minY), maxX(maxX), maxY(maxY), pixelsX(pixelsX), pixelsY(pixelsY), minLevel(minLevel), maxLevel(maxLevel),
+    hasUpdateBounds(false), updateMinX(0.0), updateMinY(0.0), updateMaxX(0.0), updateMaxY(0.0)
+{
+}
+
+void PyramidLayout::setUpdateBounds(double inMinX,double inMinY,double inMaxX,double inMaxY)
+{
+    hasUpdateBounds = true;
+    updateMinX = inMinX;  updateMinY = inMinY;
+    updateMaxX = inMaxX;  updateMaxY = inMaxY;
+}
+
+TileSampleInfo PyramidLayout::tileInfo(int level,int x,int y) const
+{
+    int numChunks = 1<<level;
+    double sizeX = (maxX-minX)/numChunks;
+    double sizeY = (maxY-minY)/numChunks;
+
+    TileSampleInfo tile;
+    tile.level = level;  tile.x = x;  tile.y = y;
+    tile.cellX = sizeX/(pixelsX-1);
+    tile.cellY = sizeY/(pixelsY-1);
+    tile.minX = minX+x*sizeX;
+    tile.minY = minY+y*sizeY;
+    tile.maxX = tile.minX + pixelsX * tile.cellX;
+    tile.maxY = tile.minY + pixelsY * tile.cellY;
+
+    return tile;
+}
+
+void PyramidLayout::levelRange(int level,int &sx,int &sy,int &ex,int &ey) const
+{
+    int numChunks = 1<<level;
+    sx = 0;  sy = 0;  ex = numChunks-1;  ey = numChunks-1;
+    if (hasUpdateBounds)
+    {
+        double sizeX = (maxX-minX)/numChunks;
+        double sizeY = (maxY-minY)/numChunks;
+        sx = MAX(sx,(int)floor((updateMinX-minX)/sizeX));
+        sy = MAX(sy,(int)floor((updateMinY-minY)/sizeY));
+        ex = MIN(ex,(int)ceil((updateMaxX-minX)/sizeX));
+        ey = MIN(ey,(int)ceil((updateMaxY-minY)/sizeY));
+    }
+}
+
+int PyramidLayout::levelRangeSize(int level) const
+{
+    int sx,sy,ex,ey;
+    levelRange(level, sx, sy, ex, ey);
+    if (ex < sx || ey < sy)
+        return 0;
+
+    return (ex-sx+1)*(ey-sy+1);
+}
+
+TileSampleInfo PyramidLayout::levelRangeTile(int level,int which) const
+{
+    int sx,sy,ex,ey;
+    levelRange(level, sx, sy, ex, ey);
+    int numY = ey-sy+1;
+
+    return tileInfo(level, sx + which / numY, sy + which % numY);
+}
+
+bool PyramidLayout::isIncluded(const TileSampleInfo &tile) const
+{
+    if (includeBounds.empty())
+        return true;
+
+    OGREnvelope box;
+    box.MinX = tile.minX;
+    box.MinY = tile.minY;
+    box.MaxX = tile.maxX;
+    box.MaxY = tile.maxY;
+    for (unsigned si=0;si<includeBounds.size();si++)
+    {
+        const OGREnvelope &env = includeBounds[si];
+        if (env.Contains(box) || env.Intersects(box) || box.Contains(env))
+            return true;
+    }
+
+    return false;
+}
+
+bool PyramidLayout::shouldWrite(int level,int x,int y) const
+{
+    if (level < minLevel || level > maxLevel)
+        return false;
+
+    int sx,sy,ex,ey;
+    levelRange(level, sx, sy, ex, ey);
+    if (x < sx || y < sy || x > ex || y > ey)
+        return false;
+
+    return isIncluded(tileInfo(level, x, y));
+}
+
+// Look up a sample in the combined grid of four children.  Neighboring children share their edge samples.
+static inline float ChildSample(const float *children[4],int pixelsX,int pixelsY,int gx,int gy)
+{
+    int cx = (gx < pixelsX) ? 0 : 1;
+    int cy = (gy < pixelsY) ? 0 : 1;
+
+    return children[cy*2+cx][(gy-cy*(pixelsY-1))*pixelsX + gx-cx*(pixelsX-1)];
+}
+
+void DownsampleChildren(const float *children[4],int pixelsX,int pixelsY,SamplingType sampleType,float *tileData)
+{
+    static const float weights[3] = {1.0,2.0,1.0};
+
+    for (int cy=0;cy<pixelsY;cy++)
+        for (int cx=0;cx<pixelsX;cx++)
+        {
+            // Parent samples land exactly on every other child sample
+            int gx = 2*cx, gy = 2*cy;
+
+            // Only filter along the edges so the neighboring tile comes up with the same value
+            int dx = (cx == 0 || cx == pixelsX-1) ? 0 : 1;
+            int dy = (cy == 0 || cy == pixelsY-1) ? 0 : 1;
+
+            float pixVal = 0.0;
+            if (sampleType == SampleMax)
+            {
+                pixVal = -MAXFLOAT;
+                for (int iy=-dy;iy<=dy;iy++)
+                    for (int ix=-dx;ix<=dx;ix++)
+                        pixVal = MAX(ChildSample(children, pixelsX, pixelsY, gx+ix, gy+iy),pixVal);
+            } else {
+                float weightSum = 0.0;
+                for (int iy=-dy;iy<=dy;iy++)
+                    for (int ix=-dx;ix<=dx;ix++)
+                    {
+                        float weight = weights[ix+1]*weights[iy+1];
+                        pixVal += weight * ChildSample(children, pixelsX, pixelsY, gx+ix, gy+iy);
+                        weightSum += weight;
+                    }
+                pixVal /= weightSum;
+            }
+
+            tileData[cy*pixelsX+cx] = pixVal;
+        }
+}
+
+SampledTileQueue::SampledTileQueue(unsigned int maxTiles,unsigned int numProducers)
+: maxTiles(maxTiles), numProducers(numProducers), failed(false)
+{
+}
+
+SampledTileQueue::~SampledTileQueue()
+{
+    for (unsigned int ii=0;ii<tiles.size();ii++)
+        delete tiles[ii];
+    tiles.clear();
+}
+
+void SampledTileQueue::push(SampledTile *tile)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (tiles.size() >= maxTiles && !failed)
+        notFull.wait(lock);
+    tiles.push_back(tile);
+    notEmpty.notify_one();
+}
+
+SampledTile *SampledTileQueue::pop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (tiles.empty() && numProducers > 0)
+        notEmpty.wait(lock);
+    if (tiles.empty())
+        return NULL;
+
+    SampledTile *tile = tiles.front();
+    tiles.pop_front();
+    notFull.notify_one();
+
+    return tile;
+}
+
+void SampledTileQueue::producerDone()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (numProducers > 0)
+        numProducers--;
+    notEmpty.notify_all();
+}
+
+void SampledTileQueue::setFailed()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    failed = true;
+    notFull.notify_all();
+}
+
+bool SampledTileQueue::hasFailed()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return failed;
+}
@@ -0,0 +1,169 @@
+//
+//  ElevationSampler.h
+//  elev_tile_pyramid
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#ifndef __elev_tile_pyramid__ElevationSampler__
+#define __elev_tile_pyramid__ElevationSampler__
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include "gdal.h"
+#include "ogr_srs_api.h"
+#include "ogr_core.h"
+
+typedef enum {SampleSingle,SampleMax} SamplingType;
+
+/** Location and sample spacing for a single output tile.
+    Samples run from (minX,minY) in steps of (cellX,cellY).
+  */
+class TileSampleInfo
+{
+public:
+    int level,x,y;
+    double minX,minY,maxX,maxY;
+    double cellX,cellY;
+};
+
+/** Pyramid Layout describes where the tiles fall for each level and
+    which of them we're actually writing out.
+  */
+class PyramidLayout
+{
+public:
+    PyramidLayout(double minX,double minY,double maxX,double maxY,int pixelsX,int pixelsY,int minLevel,int maxLevel);
+
+    // Restrict output to the tiles overlapping the given area (update mode)
+    void setUpdateBounds(double minX,double minY,double maxX,double maxY);
+
+    // Only write tiles overlapping at least one of these (if there are any)
+    std::vector<OGREnvelope> includeBounds;
+
+    // Extents and sample spacing for the given tile
+    TileSampleInfo tileInfo(int level,int x,int y) const;
+
+    // Range of tiles we're covering at the given level
+    void levelRange(int level,int &minX,int &minY,int &maxX,int &maxY) const;
+
+    // Number of tiles in the range for the given level, included or not
+    int levelRangeSize(int level) const;
+
+    // The which'th tile in a level's range, running through y within x
+    TileSampleInfo levelRangeTile(int level,int which) const;
+
+    // Check the tile against the include bounds
+    bool isIncluded(const TileSampleInfo &tile) const;
+
+    // True if the tile is within our levels and area and passes the include check
+    bool shouldWrite(int level,int x,int y) const;
+
+    int pixelsX,pixelsY;
+    int minLevel,maxLevel;
+
+protected:
+    double minX,minY,maxX,maxY;
+    bool hasUpdateBounds;
+    double updateMinX,updateMinY,updateMaxX,updateMaxY;
+};
+
+/** Build a parent tile from its four children, already sampled one level down.
+    Children are ordered (0,0), (1,0), (0,1), (1,1) in x then y.
+    SampleMax takes the max over each parent cell, SampleSingle a [1 2 1] tent filter.
+    Samples along the tile edges are only filtered along the edge so neighbors match.
+  */
+void DownsampleChildren(const float *children[4],int pixelsX,int pixelsY,SamplingType sampleType,float *tileData);
+
+/** A tile full of samples, on its way from a worker to the writer.
+  */
+class SampledTile
+{
+public:
+    SampledTile(const TileSampleInfo &info,int numPixels) : info(info), data(numPixels,0.0) { }
+
+    TileSampleInfo info;
+    std::vector<float> data;
+};
+
+/** The Elevation Sampler fills in output tiles from the source raster.
+    Each one has its own GDAL dataset and coordinate transform, since neither
+    of those can be shared between threads.  Use one per worker.
+  */
+class ElevationSampler
+{
+public:
+    // Open the input file.  The destination SRS can be NULL if it's the same as the source.
+    ElevationSampler(const char *inputFile,const char *destSRS,int pixelsX,int pixelsY);
+    ~ElevationSampler();
+
+    // Check this after construction
+    bool isValid() { return valid; }
+
+    // Sample a whole tile's worth of data into tileData (pixelsX*pixelsY floats)
+    bool sampleTile(const TileSampleInfo &tile,SamplingType sampleType,float *tileData);
+
+    // Number of source pixels we've read so far
+    unsigned long long getSourcePixelsRead() { return sourcePixelsRead; }
+
+protected:
+    // Bilinear interpolation from a single block read covering the tile
+    bool sampleSingle(const TileSampleInfo &tile,float *tileData);
+    // Maximum pixel value within each output cell
+    bool sampleMax(const TileSampleInfo &tile,float *tileData);
+    // Read a window of the source raster into the block buffer
+    bool readBlock(int sx,int sy,int ex,int ey);
+    // Look for the maximum pixel in a window too big to read at once
+    bool searchForMaxPixel(int sx,int sy,int ex,int ey,float &maxPix);
+
+    bool valid;
+    int pixelsX,pixelsY;
+    GDALDatasetH hSrcDS;
+    GDALRasterBandH hBand;
+    OGRCoordinateTransformationH hCTBack;
+    double adfInvGeoTransform[6];
+    int rasterXSize,rasterYSize;
+    unsigned long long sourcePixelsRead;
+
+    // Scratch space, reused between tiles
+    std::vector<double> srcX,srcY;
+    std::vector<int> windows;
+    std::vector<float> block;
+    int blockSX,blockSY,blockWidth;
+};
+
+/** Bounded queue between the sampling workers and the single thread that writes tiles.
+    The writer pops until it gets back NULL, which means all the producers are done.
+  */
+class SampledTileQueue
+{
+public:
+    SampledTileQueue(unsigned int maxTiles,unsigned int numProducers);
+    ~SampledTileQueue();
+
+    // Add a tile, blocking if the writer has fallen behind.  Queue takes ownership.
+    void push(SampledTile *tile);
+
+    // Wait for the next tile.  Returns NULL when every producer has finished.
+    SampledTile *pop();
+
+    // Producers call this once they're out of work
+    void producerDone();
+
+    // Something went wrong in a producer.  Everyone should wrap up.
+    void setFailed();
+    bool hasFailed();
+
+protected:
+    std::mutex mutex;
+    std::condition_variable notEmpty,notFull;
+    std::deque<SampledTile *> tiles;
+    unsigned int maxTiles;
+    unsigned int numProducers;
+    bool failed;
+};
+
+#endif /* defined(__elev_tile_pyramid__ElevationSampler__) */
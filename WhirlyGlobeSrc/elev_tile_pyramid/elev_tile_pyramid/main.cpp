@@ -27,6 +27,11 @@
 #include "KompexSQLiteBlob.h"
 #include "KompexSQLiteException.h"
 #include "ElevationPyramid.h"
+#include "ElevationSampler.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <map>
 
 /************************************************************************/
 /*                             SanitizeSRS                              */
@@ -111,43 +116,252 @@ GDALDatasetH CreateOutputDataFile(const char *pszFormat,const char *pszFilename,
     return hDstDS;
 }
 
-// Maximum number of pixels we'll load at once
-static int const MaxPixelLoad = 1048576;
+/** Tile Output writes finished tiles to the directory, database and shapefile.
+    Only the main thread writes, so none of this needs locking.
+  */
+class TileOutput
+{
+public:
+    TileOutput()
+    : targetDir(NULL), flipY(false), outFileFormat(NULL), outFormat(NULL), trgSrsWKT(NULL), pixelsX(0), pixelsY(0),
+        elevPyr(NULL), outShapeLayer(NULL), totalTiles(0), zeroTiles(0)
+    {
+    }
+
+    // Write the tile to all the outputs we've got
+    bool writeTile(const TileSampleInfo &info,const float *tileData);
 
-// Look for the maximum pixel in a given area
-float searchForMaxPixel(GDALRasterBandH hBand, int sx, int sy, int ex, int ey)
+    const char *targetDir;
+    bool flipY;
+    const char *outFileFormat,*outFormat;
+    const char *trgSrsWKT;
+    int pixelsX,pixelsY;
+    ElevationPyramid *elevPyr;
+    OGRLayer *outShapeLayer;
+    int totalTiles,zeroTiles;
+};
+
+bool TileOutput::writeTile(const TileSampleInfo &info,const float *tileData)
 {
-    fprintf(stderr,"Sampling pixels: %d\n",(ex-sx+1)*(ey-sy+1));
-    
-    float maxPix = -MAXFLOAT;
+    int level = info.level, ix = info.x, iy = info.y;
+    double tileMinX = info.minX, tileMinY = info.minY;
+    double tileMaxX = info.maxX, tileMaxY = info.maxY;
+
+    // Output directory
+    if (targetDir)
+    {
+        std::stringstream levelDir,xDir,fileName;
+        levelDir << targetDir << "/" << level;
+        mkdir(levelDir.str().c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+        xDir << levelDir.str() << "/" << ix;
+        mkdir(xDir.str().c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+        int numChunks = 1<<level;
+        int outY = (flipY ? (numChunks-1-iy) : iy);
+        fileName << xDir.str() << "/" << outY << ".tif";
     
-    int rowSize = ex-sx+1;
-//    int colSize = ey-sy+1;
+        // Create the output file
+        GDALDatasetH hDestDS = CreateOutputDataFile(outFileFormat,fileName.str().c_str(),pixelsX,pixelsY,outFormat);
+        if (!hDestDS)
+            return false;
+        GDALRasterBandH hBandOut = GDALGetRasterBand(hDestDS, 1);
+        if (!hBandOut)
+        {
+            fprintf(stderr,"Failed to create output band.");
+            GDALClose(hDestDS);
+            return false;
+        }
+
+        // Write all the data at once
+        if (GDALRasterIO( hBandOut, GF_Write, 0, 0, pixelsX, pixelsY, (void *)tileData, pixelsX, pixelsX, GDT_Int16, 0, 0) != CE_None)
+        {
+            fprintf(stderr,"Failed to write output data");
+            GDALClose(hDestDS);
+            return false;
+        }
+
+        // Set projection and extents
+        GDALSetProjection(hDestDS, trgSrsWKT);
+        
+        double adfOutTransform[6];
+        adfOutTransform[0] = tileMinX;
+        adfOutTransform[1] = (tileMaxX-tileMinX)/pixelsX;
+        adfOutTransform[2] = 0;
+        adfOutTransform[3] = tileMinY;
+        adfOutTransform[4] = 0;
+        adfOutTransform[5] = (tileMaxY-tileMinY)/pixelsY;
+        GDALSetGeoTransform(hDestDS, adfOutTransform);
+        
+        // Close the output file
+        GDALClose(hDestDS);
+    }
     
-    // Number of rows to load at once
-    int maxRows = MaxPixelLoad / rowSize;
-    maxRows = MAX(1,maxRows);
+    // Output pyramid sqlite db
+    if (elevPyr)
+    {
+        // See if anything of is non-zero
+        bool nonZero = false;
+        for (unsigned int ip=0;ip<pixelsX*pixelsY;ip++)
+            if (tileData[ip] != 0)
+            {
+                nonZero = true;
+                break;
+            }
+        
+        totalTiles++;
+        if (nonZero)
+        {
+            // Need int16 data
+            std::vector<short> tileDataShort(pixelsX*pixelsY);
+            for (unsigned int ii=0;ii<pixelsX*pixelsY;ii++)
+                tileDataShort[ii] = tileData[ii];
+
+            if (!elevPyr->addElevationTile(&tileDataShort[0], ix, iy, level))
+            {
+                fprintf(stderr, "Failed to write tile %d: %d, %d",level,ix,iy);
+                return false;
+            }
+        } else {
+            if (!elevPyr->addElevationTile(NULL, ix, iy, level))
+            {
+                fprintf(stderr, "Failed to write empty tile %d: %d, %d",level,ix,iy);
+                return false;
+            }
+            zeroTiles++;
+        }                    
+    }
     
-    for (int iy=sy;iy<=ey;iy+=maxRows)
+    // Update the shape file for what we're... updating
+    if (outShapeLayer)
     {
-        int numRows = maxRows;
-        if (ey-iy<=numRows)
-            numRows = ey-iy+1;
-        float pixels[rowSize*numRows];
-        if (GDALRasterIO( hBand, GF_Read, sx, iy, rowSize, numRows, pixels, rowSize, numRows, GDT_Float32, 0,  0) != CE_None)
+        float minElev=MAXFLOAT,maxElev=-MAXFLOAT;
+        for (unsigned int it=0;it<pixelsX*pixelsY;it++)
         {
-            fprintf(stderr,"Query failure in GDALRasterIO");
-            return -1;
+            minElev = MIN(minElev,tileData[it]);
+            maxElev = MAX(maxElev,tileData[it]);
         }
-        
-        for (int which = 0; which < rowSize*numRows; which++)
-            maxPix = MAX(pixels[which],maxPix);
+        OGRPolygon *poly = new OGRPolygon();
+        OGRLinearRing ring;
+        ring.addPoint(tileMinX, tileMinY);
+        ring.addPoint(tileMaxX, tileMinY);
+        ring.addPoint(tileMaxX, tileMaxY);
+        ring.addPoint(tileMinX, tileMaxY);
+        ring.addPoint(tileMinX, tileMinY);
+        poly->addRing(&ring);
+        OGRFeature *feat = new OGRFeature(outShapeLayer->GetLayerDefn());
+        feat->SetGeometry(poly);
+        char cellName[1024];
+        sprintf(cellName,"cell: %d: (%d,%d)",level,ix,iy);
+        feat->SetField("cell",cellName);
+        feat->SetField("min", minElev);
+        feat->SetField("max", maxElev);
+        outShapeLayer->CreateFeature(feat);
+        OGRFeature::DestroyFeature( feat );
     }
-    
-    return maxPix;
+
+    return true;
+}
+
+// Sample tiles in the level's range until we run out, handing each one to the writer
+void SampleTilesWorker(ElevationSampler *sampler,const PyramidLayout *layout,int level,SamplingType sampleType,std::atomic<int> *nextTile,std::atomic<int> *skippedTiles,SampledTileQueue *tileQueue)
+{
+    int numTiles = layout->levelRangeSize(level);
+    int which;
+    while ((which = (*nextTile)++) < numTiles && !tileQueue->hasFailed())
+    {
+        // Let's check this against the inclusion polygons if we have them
+        TileSampleInfo tileInfo = layout->levelRangeTile(level, which);
+        if (!layout->isIncluded(tileInfo))
+        {
+            (*skippedTiles)++;
+            continue;
+        }
+
+        SampledTile *tile = new SampledTile(tileInfo,layout->pixelsX*layout->pixelsY);
+        if (!sampler->sampleTile(tile->info, sampleType, &tile->data[0]))
+        {
+            fprintf(stderr,"Failed to sample tile %d: %d, %d\n",tile->info.level,tile->info.x,tile->info.y);
+            delete tile;
+            tileQueue->setFailed();
+            break;
+        }
+        tileQueue->push(tile);
+    }
+
+    tileQueue->producerDone();
 }
 
-typedef enum {SampleSingle,SampleMax} SamplingType;
+// Per level timing for the bottom up mode.  Each worker keeps its own.
+class DeriveStats
+{
+public:
+    DeriveStats(int numLevels) : tiles(numLevels,0), secs(numLevels,0.0) { }
+
+    std::vector<int> tiles;
+    std::vector<double> secs;
+};
+
+// Build a tile from its four children, recursing down to the max level.
+// Tiles we're not writing out come straight from the source, as do the ones at the bottom.
+bool DeriveTile(const PyramidLayout *layout,ElevationSampler *sampler,SamplingType sampleType,int level,int ix,int iy,float *tileData,SampledTileQueue *tileQueue,DeriveStats *stats)
+{
+    int numPixels = layout->pixelsX*layout->pixelsY;
+    TileSampleInfo info = layout->tileInfo(level, ix, iy);
+    bool writeTile = layout->shouldWrite(level, ix, iy);
+
+    if (!writeTile || level >= layout->maxLevel)
+    {
+        std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+        if (!sampler->sampleTile(info, sampleType, tileData))
+        {
+            fprintf(stderr,"Failed to sample tile %d: %d, %d\n",level,ix,iy);
+            return false;
+        }
+        stats->secs[level] += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    } else {
+        std::vector<float> children(4*numPixels);
+        const float *childData[4];
+        for (unsigned int ci=0;ci<4;ci++)
+        {
+            if (!DeriveTile(layout, sampler, sampleType, level+1, 2*ix+(ci&1), 2*iy+(ci>>1), &children[ci*numPixels], tileQueue, stats))
+                return false;
+            childData[ci] = &children[ci*numPixels];
+        }
+        std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+        DownsampleChildren(childData, layout->pixelsX, layout->pixelsY, sampleType, tileData);
+        stats->secs[level] += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    if (writeTile)
+    {
+        SampledTile *tile = new SampledTile(info,numPixels);
+        std::copy(tileData, tileData+numPixels, tile->data.begin());
+        tileQueue->push(tile);
+        stats->tiles[level]++;
+    }
+
+    return !tileQueue->hasFailed();
+}
+
+// Build whole subtrees, one root tile at a time
+void DeriveTilesWorker(const PyramidLayout *layout,ElevationSampler *sampler,SamplingType sampleType,int rootLevel,std::atomic<int> *nextTile,SampledTileQueue *tileQueue,DeriveStats *stats)
+{
+    std::vector<float> tileData(layout->pixelsX*layout->pixelsY);
+    int numRoots = layout->levelRangeSize(rootLevel);
+    int which;
+    while ((which = (*nextTile)++) < numRoots && !tileQueue->hasFailed())
+    {
+        TileSampleInfo root = layout->levelRangeTile(rootLevel, which);
+        if (!layout->isIncluded(root))
+            continue;
+        if (!DeriveTile(layout, sampler, sampleType, root.level, root.x, root.y, &tileData[0], tileQueue, stats))
+        {
+            tileQueue->setFailed();
+            break;
+        }
+    }
+
+    tileQueue->producerDone();
+}
 
 int main(int argc, char * argv[])
 {
@@ -166,6 +380,10 @@ int main(int argc, char * argv[])
     double updateMinX = 0.0,updateMaxX = 0.0,updateMinY = 0.0,updateMaxY = 0.0;
     const char *updateShapeFile = NULL,*outShapeFile=NULL;
     SamplingType samplingtype = SampleSingle;
+    unsigned int numThreads = std::thread::hardware_concurrency();
+    int dbBatchSize = 1000;
+    bool benchMode = false;
+    bool bottomUp = false;
 
     GDALAllRegister();
     OGRRegisterAll();
@@ -307,6 +525,32 @@ int main(int argc, char * argv[])
                 fprintf(stderr,"Expecting single or max for sampling type.");
                 return -1;
             }
+        } else if (EQUAL(argv[ii],"-threads"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting number of threads for -threads");
+                return -1;
+            }
+            numThreads = atoi(argv[ii+1]);
+        } else if (EQUAL(argv[ii],"-dbbatch"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting number of tiles for -dbbatch");
+                return -1;
+            }
+            dbBatchSize = atoi(argv[ii+1]);
+        } else if (EQUAL(argv[ii],"-bottomup"))
+        {
+            numArgs = 1;
+            bottomUp = true;
+        } else if (EQUAL(argv[ii],"-bench"))
+        {
+            numArgs = 1;
+            benchMode = true;
         } else
         {
             if (inputFile)
@@ -323,7 +567,7 @@ int main(int argc, char * argv[])
         fprintf(stderr, "Need at least one input file.");
         return -1;
     }
-    if (!targetDir && !targetDb && !updateDb)
+    if (!targetDir && !targetDb && !updateDb && !benchMode)
     {
         fprintf(stderr, "Expecting output dir or output/update DB.");
         return -1;
@@ -400,13 +644,12 @@ int main(int argc, char * argv[])
     }
 
     // Fill in the bounding box (for the output) if we don't already have one
-    double adfGeoTransform[6], adfInvGeoTransform[6];
+    double adfGeoTransform[6];
     if (GDALGetGeoTransform( hSrcDS, adfGeoTransform) != CE_None)
     {
         fprintf(stderr, "Unable to get geo transform for data set.");
         return -1;
     }
-    GDALInvGeoTransform( adfGeoTransform, adfInvGeoTransform );
     int rasterXSize = GDALGetRasterXSize(hSrcDS);
     int rasterYSize = GDALGetRasterYSize(hSrcDS);
     if (!teSet && !elevPyr)
@@ -593,11 +836,6 @@ int main(int argc, char * argv[])
     char *trgSrsWKT = NULL;
     OSRExportToWkt( hTrgSRS, &trgSrsWKT );
 
-    if (targetDb)
-    {
-        Kompex::SQLiteStatement transactStmt(sqliteDb);
-        transactStmt.SqlStatement((std::string)"BEGIN TRANSACTION");
-    }
 
     // We might only be updating some of the levels
     int min_level = 0, max_level = levels-1;
@@ -607,317 +845,251 @@ int main(int argc, char * argv[])
         max_level = updateMaxLevel;
     }
 
-    // Work through the levels of detail, starting from the top
-    int totalTiles = 0,zeroTiles = 0, skippedTiles = 0;
-    for (int level=max_level;level>=min_level;level--)
+    numThreads = MAX(1,numThreads);
+
+    // Tiles get compressed on their own threads and committed in batches
+    if (elevPyr)
     {
-        printf("Level %d: ",level);
-        fflush(stdout);
-        GDALTermProgress(0.0,NULL,NULL);
+        TileDBWriter::tuneForBulkLoad(sqliteDb);
+        if (!elevPyr->startWriter(numThreads,dbBatchSize))
+            return -1;
+    }
 
-        std::stringstream levelDir;
-        if (targetDir)
+    // Each worker gets its own sampler, since GDAL datasets can't be shared between threads
+    std::vector<ElevationSampler *> samplers;
+    for (unsigned int ti=0;ti<numThreads;ti++)
+    {
+        ElevationSampler *sampler = new ElevationSampler(inputFile,destSRS,pixelsX,pixelsY);
+        if (!sampler->isValid())
         {
-            levelDir << targetDir << "/" << level;
-            mkdir(levelDir.str().c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
-        }
-        
-        int numChunks = 1<<level;
-        double sizeY = (ymax-ymin)/numChunks;
-        double cellY = sizeY/(pixelsY-1);
-        double sizeX = (xmax-xmin)/numChunks;
-        double cellX = sizeX/(pixelsX-1);
-
-        // We might only be updating some of the area
-        int min_ix = 0, min_iy = 0, max_ix = numChunks-1, max_iy=numChunks-1;        
-        if (updateMinX != updateMaxX)
-        {
-            min_ix = floor((updateMinX-xmin)/sizeX);
-            min_iy = floor((updateMinY-ymin)/sizeY);
-            max_ix = ceil((updateMaxX-xmin)/sizeX);
-            max_iy = ceil((updateMaxY-ymin)/sizeY);
+            fprintf(stderr, "Failed to open input file for sampling: %s\n",inputFile);
+            return -1;
         }
-        int numTilesToDo = (max_ix-min_ix+1)*(max_iy-min_iy+1);
-        int chunksProcessed = 0;
+        samplers.push_back(sampler);
+    }
+
+    // Where the tiles go and which ones we're writing
+    PyramidLayout layout(xmin,ymin,xmax,ymax,pixelsX,pixelsY,min_level,max_level);
+    if (updateMinX != updateMaxX)
+        layout.setUpdateBounds(updateMinX, updateMinY, updateMaxX, updateMaxY);
+    layout.includeBounds = includeBounds;
 
-        // Now through the individual files
-        for (unsigned int ix=min_ix;ix<=max_ix;ix++)
+    TileOutput tileOutput;
+    tileOutput.targetDir = targetDir;
+    tileOutput.flipY = flipY;
+    tileOutput.outFileFormat = outFileFormat;
+    tileOutput.outFormat = outFormat;
+    tileOutput.trgSrsWKT = trgSrsWKT;
+    tileOutput.pixelsX = pixelsX;
+    tileOutput.pixelsY = pixelsY;
+    tileOutput.elevPyr = elevPyr;
+    tileOutput.outShapeLayer = outShapeLayer;
+
+    std::atomic<int> skippedTiles(0);
+
+    if (!bottomUp)
+    {
+        // Work through the levels of detail, starting from the top
+        for (int level=max_level;level>=min_level;level--)
         {
-            std::stringstream xDir;
-            if (targetDir)
+            printf("Level %d: ",level);
+            fflush(stdout);
+            GDALTermProgress(0.0,NULL,NULL);
+            std::chrono::steady_clock::time_point levelStart = std::chrono::steady_clock::now();
+
+            int numTilesToDo = layout.levelRangeSize(level);
+            int chunksProcessed = 0;
+            int startSkipped = skippedTiles;
+
+            // Fan the sampling out to the workers.  This thread is the only one that writes.
+            unsigned long long startPixelsRead = 0;
+            for (unsigned int ti=0;ti<samplers.size();ti++)
+                startPixelsRead += samplers[ti]->getSourcePixelsRead();
+            SampledTileQueue tileQueue(4*numThreads,numThreads);
+            std::atomic<int> nextTile(0);
+            std::vector<std::thread> workers;
+            for (unsigned int ti=0;ti<numThreads;ti++)
+                workers.push_back(std::thread(SampleTilesWorker,samplers[ti],&layout,level,samplingtype,&nextTile,&skippedTiles,&tileQueue));
+
+            while (SampledTile *tile = tileQueue.pop())
             {
-                xDir << levelDir.str() << "/" << ix;
-                mkdir(xDir.str().c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+                // Tell the workers to stop, but keep draining so they can exit
+                if (!tileQueue.hasFailed() && !tileOutput.writeTile(tile->info, &tile->data[0]))
+                    tileQueue.setFailed();
+                delete tile;
+
+                chunksProcessed++;
+                double done = (chunksProcessed+skippedTiles-startSkipped)/((double)numTilesToDo);
+                GDALTermProgress(done,NULL,NULL);
             }
+
+            for (unsigned int ti=0;ti<workers.size();ti++)
+                workers[ti].join();
+            if (tileQueue.hasFailed())
+                return -1;
             
-            for (unsigned int iy=min_iy;iy<=max_iy;iy++)
+            GDALTermProgress(1.0,NULL,NULL);
+
+            if (benchMode)
             {
-                // Extents for this particular tile
-                double tileMinX = xmin+ix*sizeX;
-                double tileMinY = ymin+iy*sizeY;
-                double tileMaxX = tileMinX + pixelsX * cellX;
-                double tileMaxY = tileMinY + pixelsY * cellY;
-               
-                // Let's check this against the inclusion polygons if we have them
-                bool includeTile = true;
-                if (!includeBounds.empty())
+                double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - levelStart).count();
+                unsigned long long endPixelsRead = 0;
+                for (unsigned int ti=0;ti<samplers.size();ti++)
+                    endPixelsRead += samplers[ti]->getSourcePixelsRead();
+                unsigned long long numPixels = (unsigned long long)chunksProcessed*pixelsX*pixelsY;
+                secs = MAX(secs,1e-6);
+                fprintf(stdout,"Level %d: %d tiles in %.3fs (%d threads): %.1f tiles/sec, %.1f pixels/sec, %.1f source pixels/sec\n",
+                        level,chunksProcessed,secs,numThreads,chunksProcessed/secs,numPixels/secs,(endPixelsRead-startPixelsRead)/secs);
+            }
+        }
+    } else {
+        // Start the workers at a level with enough tiles to keep them all busy
+        int rootLevel = min_level;
+        while (rootLevel < max_level && layout.levelRangeSize(rootLevel) < 4*numThreads)
+            rootLevel++;
+
+        // Count up what we'll write, for progress
+        int numTilesToDo = 0;
+        for (int level=min_level;level<=max_level;level++)
+        {
+            int numTiles = layout.levelRangeSize(level);
+            if (includeBounds.empty())
+                numTilesToDo += numTiles;
+            else
+                for (int which=0;which<numTiles;which++)
                 {
-                    includeTile = false;
-                    OGREnvelope box;
-                    box.MinX = tileMinX;
-                    box.MinY = tileMinY;
-                    box.MaxX = tileMaxX;
-                    box.MaxY = tileMaxY;
-                    for (unsigned si=0;si<includeBounds.size();si++)
-                    {
-                        OGREnvelope &env = includeBounds[si];
-                        if (env.Contains(box) || env.Intersects(box) || box.Contains(env))
-                        {
-                            includeTile = true;
-                            break;
-                        }
-                    }
+                    if (layout.isIncluded(layout.levelRangeTile(level, which)))
+                        numTilesToDo++;
+                    else
+                        skippedTiles++;
                 }
-                
-                if (includeTile)
+        }
+        int chunksProcessed = 0;
+
+        printf("Levels %d-%d: ",max_level,min_level);
+        fflush(stdout);
+        GDALTermProgress(0.0,NULL,NULL);
+        std::chrono::steady_clock::time_point buildStart = std::chrono::steady_clock::now();
+        unsigned long long startPixelsRead = 0;
+        for (unsigned int ti=0;ti<samplers.size();ti++)
+            startPixelsRead += samplers[ti]->getSourcePixelsRead();
+
+        // Workers build whole subtrees from the source up.  We hang on to the roots to build the levels above.
+        std::map<std::pair<int,int>,std::vector<float> > builtTiles;
+        std::vector<DeriveStats> stats(numThreads+1,DeriveStats(max_level+1));
+        SampledTileQueue tileQueue(4*numThreads,numThreads);
+        std::atomic<int> nextTile(0);
+        std::vector<std::thread> workers;
+        for (unsigned int ti=0;ti<numThreads;ti++)
+            workers.push_back(std::thread(DeriveTilesWorker,&layout,samplers[ti],samplingtype,rootLevel,&nextTile,&tileQueue,&stats[ti]));
+
+        while (SampledTile *tile = tileQueue.pop())
+        {
+            if (!tileQueue.hasFailed())
+            {
+                if (!tileOutput.writeTile(tile->info, &tile->data[0]))
+                    tileQueue.setFailed();
+                else if (tile->info.level == rootLevel && rootLevel > min_level)
+                    builtTiles[std::make_pair(tile->info.x,tile->info.y)].swap(tile->data);
+            }
+            delete tile;
+
+            chunksProcessed++;
+            GDALTermProgress(chunksProcessed/((double)numTilesToDo),NULL,NULL);
+        }
+
+        for (unsigned int ti=0;ti<workers.size();ti++)
+            workers[ti].join();
+        if (tileQueue.hasFailed())
+            return -1;
+
+        // There aren't many tiles above the root level, so we just do them here
+        int numPixels = pixelsX*pixelsY;
+        DeriveStats &mainStats = stats[numThreads];
+        for (int level=rootLevel-1;level>=min_level;level--)
+        {
+            std::map<std::pair<int,int>,std::vector<float> > parentTiles;
+            std::vector<float> children(4*numPixels);
+            int numTiles = layout.levelRangeSize(level);
+            for (int which=0;which<numTiles;which++)
+            {
+                TileSampleInfo tileInfo = layout.levelRangeTile(level, which);
+                if (!layout.isIncluded(tileInfo))
+                    continue;
+                std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+                const float *childData[4];
+                for (unsigned int ci=0;ci<4;ci++)
                 {
-                    GDALDatasetH hDestDS = NULL;
-                    GDALRasterBandH hBandOut = NULL;
-                    if (targetDir)
-                    {
-                        std::stringstream fileName;
-                        int outY = (flipY ? (numChunks-1-iy) : iy);
-                        fileName << xDir.str() << "/" << outY << ".tif";
-                    
-                        // Create the output file
-                        hDestDS = CreateOutputDataFile(outFileFormat,fileName.str().c_str(),pixelsX,pixelsY,outFormat);
-                        if (!hDestDS)
+                    int cx = 2*tileInfo.x+(ci&1), cy = 2*tileInfo.y+(ci>>1);
+                    std::map<std::pair<int,int>,std::vector<float> >::iterator cit = builtTiles.find(std::make_pair(cx,cy));
+                    if (cit != builtTiles.end())
+                        childData[ci] = &cit->second[0];
+                    else {
+                        // Not one we wrote, so it comes from the source
+                        if (!samplers[0]->sampleTile(layout.tileInfo(level+1, cx, cy), samplingtype, &children[ci*numPixels]))
                             return -1;
-                        hBandOut = GDALGetRasterBand(hDestDS, 1);
-                        if (!hBandOut)
-                        {
-                            fprintf(stderr,"Failed to create output band.");
-                            return -1;
-                        }
+                        childData[ci] = &children[ci*numPixels];
                     }
-                    
-                    float tileData[pixelsX*pixelsY];
-                    
-                    // Run through and query the various cells
-                    for (unsigned int cy=0;cy<pixelsY;cy++)
-                        for (unsigned int cx=0;cx<pixelsX;cx++)
-                        {
-                            double thisX = tileMinX + cellX*cx;
-                            double thisY = tileMinY + cellY*cy;
-                            
-                            if (samplingtype == SampleSingle)
-                            {
-                                // Project back to the original data file
-                                if (hCT)
-                                    OCTTransform(hCTBack, 1, &thisX, &thisY, NULL);
-
-                                // Figure out which pixel this is
-                                double pixX = adfInvGeoTransform[0] + adfInvGeoTransform[1] * thisX + adfInvGeoTransform[2] * thisY;
-                                double pixY = adfInvGeoTransform[3] + adfInvGeoTransform[4] * thisX + adfInvGeoTransform[5] * thisY;
-                                
-                                // Note: Should do some interpolation
-                                int pixXint = (int)pixX,pixYint = (int)pixY;
-                                
-                                double ta = pixX-pixXint;
-                                double tb = pixY-pixYint;
-
-                                // Look up the four nearby pixels
-                                int pixXlookup[4],pixYlookup[4];
-                                pixXlookup[0] = pixXint;  pixYlookup[0] = pixYint;
-                                pixXlookup[1] = pixXint+1;  pixYlookup[1] = pixYint;
-                                pixXlookup[2] = pixXint+1;  pixYlookup[2] = pixYint+1;
-                                pixXlookup[3] = pixXint;  pixYlookup[3] = pixYint+1;
-                                float pixVals[4];
-                                for (unsigned int pi=0;pi<4;pi++)
-                                {
-                                    int pixXlook = pixXlookup[pi];
-                                    int pixYlook = pixYlookup[pi];
-                                    if (pixXlook < 0) pixXlook = 0;
-                                    if (pixYlook < 0) pixYlook = 0;
-                                    if (pixXlook >= rasterXSize)  pixXlook = rasterXSize-1;
-                                    if (pixYlook >= rasterYSize)  pixYlook = rasterYSize-1;
-                                
-                                    // Fetch the pixel
-                                    if (GDALRasterIO( hBand, GF_Read, pixXlook, pixYlook, 1, 1, &pixVals[pi], 1, 1, GDT_Float32, 0,  0) != CE_None)
-                                    {
-                                        fprintf(stderr,"Query failure in GDALRasterIO");
-                                        return -1;
-                                    }
-                                }
-                                
-                                // Now do a bilinear interpolation
-                                float pixA = (pixVals[1]-pixVals[0])*ta + pixVals[0];
-                                float pixB = (pixVals[2]-pixVals[3])*ta + pixVals[3];
-                                float pixVal = (pixB-pixA)*tb+pixA;
-                                
-                                tileData[cy*pixelsX+cx] = pixVal;
-                            } else if (samplingtype == SampleMax)
-                            {
-                                // Make a bounding box and project it into the source data
-                                double pixX[4],pixY[4];
-                                double srcX[4],srcY[4];
-                                srcX[0] = thisX-cellX/2.0;  srcY[0] = thisY-cellY/2.0;
-                                srcX[1] = thisX+cellX/2.0;  srcY[1] = thisY-cellY/2.0;
-                                srcX[2] = thisX+cellX/2.0;  srcY[2] = thisY+cellY/2.0;
-                                srcX[3] = thisX-cellX/2.0;  srcY[3] = thisY+cellY/2.0;
-                                
-                                // Convert the rectangle points individually, if needed
-                                if (hCT)
-                                    for (unsigned int pi=0;pi<4;pi++)
-                                        OCTTransform(hCTBack, 1, &srcX[pi], &srcY[pi], NULL);
-
-                                int sx=1000000,sy=1000000,ex=-1000000,ey=-1000000;
-                                for (unsigned int pi=0;pi<4;pi++)
-                                {
-                                    pixX[pi] = adfInvGeoTransform[0] + adfInvGeoTransform[1] * srcX[pi] + adfInvGeoTransform[2] * srcY[pi];
-                                    pixY[pi] = adfInvGeoTransform[3] + adfInvGeoTransform[4] * srcX[pi] + adfInvGeoTransform[5] * srcY[pi];
-                                    sx = MIN(sx,floor(pixX[pi]));
-                                    sy = MIN(sy,floor(pixY[pi]));
-                                    ex = MAX(ex,ceil(pixX[pi]));
-                                    ey = MAX(ey,ceil(pixY[pi]));
-                                }
-                                sx = MAX(0,sx);
-                                sy = MAX(0,sy);
-                                sx = MIN(sx,rasterXSize-1);
-                                sy = MIN(sy,rasterYSize-1);
-                                ex = MAX(0,ex);
-                                ey = MAX(0,ey);
-                                ex = MIN(ex,rasterXSize-1);
-                                ey = MIN(ey,rasterYSize-1);
-                                
-                                
-                                
-                                // Work through the pixels in the source looking for a max
-                                float maxPix = -MAXFLOAT;
-
-                                // Search for the maximum pixel in the area
-                                maxPix = searchForMaxPixel(hBand, sx, sy, ex, ey);
-                                
-                                tileData[cy*pixelsX+cx] = maxPix;
-                            }
-                        }
-                    
-                    // Output directory
-                    if (targetDir)
-                    {
-                        // Write all the data at once
-                        if (GDALRasterIO( hBandOut, GF_Write, 0, 0, pixelsX, pixelsY, tileData, pixelsX, pixelsX, GDT_Int16, 0, 0) != CE_None)
-                        {
-                            fprintf(stderr,"Failed to write output data");
-                            return -1;
-                        }
+                }
+                std::vector<float> &tileData = parentTiles[std::make_pair(tileInfo.x,tileInfo.y)];
+                tileData.resize(numPixels);
+                DownsampleChildren(childData, pixelsX, pixelsY, samplingtype, &tileData[0]);
+                mainStats.secs[level] += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+                mainStats.tiles[level]++;
 
-                        // Set projection and extents
-                        GDALSetProjection(hDestDS, trgSrsWKT);
-                        
-                        double adfOutTransform[6];
-                        adfOutTransform[0] = tileMinX;
-                        adfOutTransform[1] = (tileMaxX-tileMinX)/pixelsX;
-                        adfOutTransform[2] = 0;
-                        adfOutTransform[3] = tileMinY;
-                        adfOutTransform[4] = 0;
-                        adfOutTransform[5] = (tileMaxY-tileMinY)/pixelsY;
-                        GDALSetGeoTransform(hDestDS, adfOutTransform);
-                        
-                        // Close the output file
-                        GDALClose(hDestDS);
-                    }
-                    
-                    // Output pyramid sqlite db
-                    if (elevPyr)
-                    {
-                        // See if anything of is non-zero
-                        bool nonZero = false;
-                        for (unsigned int ip=0;ip<pixelsX*pixelsY;ip++)
-                            if (tileData[ip] != 0)
-                            {
-                                nonZero = true;
-                                break;
-                            }
-                        
-                        totalTiles++;
-                        if (nonZero)
-                        {
-                            // Need int16 data
-                            short tileDataShort[pixelsX*pixelsY];
-                            for (unsigned int ii=0;ii<pixelsX*pixelsY;ii++)
-                                tileDataShort[ii] = tileData[ii];
+                if (!tileOutput.writeTile(tileInfo, &tileData[0]))
+                    return -1;
 
-                            if (!elevPyr->addElevationTile(tileDataShort, ix, iy, level))
-                            {
-                                fprintf(stderr, "Failed to write tile %d: %d, %d",level,ix,iy);
-                                return -1;
-                            }
-                        } else {
-                            if (!elevPyr->addElevationTile(NULL, ix, iy, level))
-                            {
-                                fprintf(stderr, "Failed to write empty tile %d: %d, %d",level,ix,iy);
-                                return -1;
-                            }
-                            zeroTiles++;
-                        }                    
-                    }
-                    
-                    // Update the shape file for what we're... updating
-                    if (outShapeLayer)
-                    {
-                        float minElev=MAXFLOAT,maxElev=-MAXFLOAT;
-                        for (unsigned int it=0;it<pixelsX*pixelsY;it++)
-                        {
-                            minElev = MIN(minElev,tileData[it]);
-                            maxElev = MAX(maxElev,tileData[it]);
-                        }
-                        OGRPolygon *poly = new OGRPolygon();
-                        OGRLinearRing ring;
-                        ring.addPoint(tileMinX, tileMinY);
-                        ring.addPoint(tileMaxX, tileMinY);
-                        ring.addPoint(tileMaxX, tileMaxY);
-                        ring.addPoint(tileMinX, tileMaxY);
-                        ring.addPoint(tileMinX, tileMinY);
-                        poly->addRing(&ring);
-                        OGRFeature *feat = new OGRFeature(outShapeLayer->GetLayerDefn());
-                        feat->SetGeometry(poly);
-                        char cellName[1024];
-                        sprintf(cellName,"cell: %d: (%d,%d)",level,ix,iy);
-                        feat->SetField("cell",cellName);
-                        feat->SetField("min", minElev);
-                        feat->SetField("max", maxElev);
-                        outShapeLayer->CreateFeature(feat);
-                        OGRFeature::DestroyFeature( feat );
-                    }
-                    
-                } else
-                    skippedTiles++;
-                
                 chunksProcessed++;
-                double done = chunksProcessed/((double)numTilesToDo);
-                GDALTermProgress(done,NULL,NULL);
+                GDALTermProgress(chunksProcessed/((double)numTilesToDo),NULL,NULL);
             }
+            builtTiles.swap(parentTiles);
         }
-        
+        builtTiles.clear();
+
         GDALTermProgress(1.0,NULL,NULL);
+
+        if (benchMode)
+        {
+            // Levels are interleaved, so we report the worker time spent on each one
+            for (int level=max_level;level>=min_level;level--)
+            {
+                int numTiles = 0;
+                double secs = 0.0;
+                for (unsigned int si=0;si<stats.size();si++)
+                {
+                    numTiles += stats[si].tiles[level];
+                    secs += stats[si].secs[level];
+                }
+                secs = MAX(secs,1e-6);
+                fprintf(stdout,"Level %d: %d tiles in %.3f thread-secs: %.1f tiles/sec, %.1f pixels/sec per thread\n",
+                        level,numTiles,secs,numTiles/secs,((double)numTiles*numPixels)/secs);
+            }
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+            unsigned long long endPixelsRead = 0;
+            for (unsigned int ti=0;ti<samplers.size();ti++)
+                endPixelsRead += samplers[ti]->getSourcePixelsRead();
+            secs = MAX(secs,1e-6);
+            fprintf(stdout,"All levels: %d tiles in %.3fs (%d threads): %.1f tiles/sec, %.1f pixels/sec, %.1f source pixels/sec\n",
+                    numTilesToDo,secs,numThreads,numTilesToDo/secs,((double)numTilesToDo*numPixels)/secs,(endPixelsRead-startPixelsRead)/secs);
+        }
     }
+
+    int totalTiles = tileOutput.totalTiles, zeroTiles = tileOutput.zeroTiles;
+    for (unsigned int ti=0;ti<samplers.size();ti++)
+        delete samplers[ti];
+    samplers.clear();
     
     if (outShape)
         OGRDataSource::DestroyDataSource( outShape );
         
     printf("Flushing database...");  fflush(stdout);
-    // Flush out one big one
-    if (targetDb)
-    {
-        Kompex::SQLiteStatement transactStmt(sqliteDb);
-        transactStmt.SqlStatement((std::string)"END TRANSACTION");
-    }
-
     if (elevPyr)
     {
+        elevPyr->printStats(stdout);
         elevPyr->flush();
         elevPyr->createIndex();
+        TileDBWriter::finishBulkLoad(sqliteDb);
     }
     printf("done\n");
     
@@ -933,7 +1105,7 @@ int main(int argc, char * argv[])
         }
     }
     
-    fprintf(stdout,"Wrote %d tiles, of which %d were empty and %d were skipped.\n",totalTiles,zeroTiles,skippedTiles);
+    fprintf(stdout,"Wrote %d tiles, of which %d were empty and %d were skipped.\n",totalTiles,zeroTiles,(int)skippedTiles);
 
     return 0;
 }
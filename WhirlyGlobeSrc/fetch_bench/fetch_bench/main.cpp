@@ -0,0 +1,670 @@
+//
+//  main.cpp
+//  fetch_bench
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <vector>
+#include <string>
+#include <set>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include "FetchScheduler.h"
+
+using namespace WhirlyKit;
+
+typedef FetchScheduler<std::string> Scheduler;
+typedef std::chrono::steady_clock Clock;
+
+double SecondsSince(Clock::time_point startTime)
+{
+    return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+#define CHECK(cond) if (!(cond)) { fprintf(stderr,"Check failed (line %d): %s\n",__LINE__,#cond); return false; }
+
+// Runs the checks against a scheduler with no network under it
+class CheckHarness
+{
+public:
+    CheckHarness(int maxPerHost,int maxActive)
+    : sched(maxPerHost,maxActive)
+    {
+        sched.setCancelFunc([this](Scheduler::FetchID fetchID) { cancelled.push_back(fetchID); });
+    }
+
+    Scheduler::RequestID request(const std::string &url,const std::string &host,double importance)
+    {
+        return sched.request(url,host,importance,
+                             [this,url](Scheduler::FetchID fetchID) { started.push_back(std::pair<std::string,Scheduler::FetchID>(url,fetchID)); },
+                             [this,url](bool success,const std::string &data) { if (success && data == url) done.push_back(url); });
+    }
+
+    // Finish the fetch that was started for the given URL
+    void finish(const std::string &url)
+    {
+        for (auto &start : started)
+            if (start.first == url)
+            {
+                sched.finish(start.second,true,url);
+                return;
+            }
+    }
+
+    Scheduler::FetchID fetchFor(const std::string &url)
+    {
+        for (auto &start : started)
+            if (start.first == url)
+                return start.second;
+        return 0;
+    }
+
+    int numDone(const std::string &url)
+    {
+        return (int)std::count(done.begin(),done.end(),url);
+    }
+
+    Scheduler sched;
+    std::vector<std::pair<std::string,Scheduler::FetchID> > started;
+    std::vector<std::string> done;
+    std::vector<Scheduler::FetchID> cancelled;
+};
+
+bool RunChecks()
+{
+    // Same URL twice is one fetch and both hear back
+    {
+        CheckHarness check(4,4);
+        check.request("a","h",1.0);
+        check.request("a","h",2.0);
+        CHECK(check.started.size() == 1);
+        check.finish("a");
+        CHECK(check.numDone("a") == 2);
+        Scheduler::Stats stats = check.sched.getStats();
+        CHECK(stats.numRequests == 2 && stats.numFetches == 1 && stats.numCoalesced == 1);
+        CHECK(stats.numActive == 0 && stats.numQueued == 0);
+        // Once it's done, asking again is a new fetch
+        check.request("a","h",1.0);
+        CHECK(check.started.size() == 2);
+    }
+
+    // Most important goes first, ties go in order
+    {
+        CheckHarness check(1,1);
+        check.request("a","h",1.0);
+        check.request("b","h",1.0);
+        check.request("c","h",1.0);
+        check.request("d","h",5.0);
+        CHECK(check.started.size() == 1);
+        check.finish("a");
+        CHECK(check.started.size() == 2 && check.started[1].first == "d");
+        check.finish("d");
+        CHECK(check.started[2].first == "b");
+        // Asking for c again with more importance moves it up
+        auto reqE = check.request("e","h",2.0);
+        check.request("c","h",3.0);
+        check.finish("b");
+        CHECK(check.started[3].first == "c");
+        // As does changing the importance
+        check.request("f","h",0.5);
+        check.sched.setImportance(reqE,0.1);
+        check.finish("c");
+        CHECK(check.started[4].first == "f");
+    }
+
+    // Hosts have their own limits and the total is respected
+    {
+        CheckHarness check(2,3);
+        for (int ii=0;ii<5;ii++)
+            check.request("a" + std::to_string(ii),"h1",1.0);
+        check.request("b0","h2",0.1);
+        check.request("c0","h3",0.1);
+        CHECK(check.started.size() == 3);
+        CHECK(check.fetchFor("a0") && check.fetchFor("a1") && check.fetchFor("b0"));
+        check.finish("a0");
+        CHECK(check.started.size() == 4 && check.started[3].first == "a2");
+        // h1 is full up, so the next slot goes to h3 even though h1 has more important work
+        check.finish("b0");
+        CHECK(check.started.size() == 5 && check.started[4].first == "c0");
+    }
+
+    // Cancelling
+    {
+        CheckHarness check(1,1);
+        auto reqA1 = check.request("a","h",1.0);
+        auto reqA2 = check.request("a","h",1.0);
+        auto reqB = check.request("b","h",1.0);
+        check.request("c","h",1.0);
+        // Queued one just goes away
+        CHECK(check.sched.cancel(reqB));
+        CHECK(!check.sched.cancel(reqB));
+        // Someone else still wants this one
+        CHECK(check.sched.cancel(reqA1));
+        CHECK(check.cancelled.empty());
+        // Now no one does.  That frees up the slot.
+        Scheduler::FetchID fetchA = check.fetchFor("a");
+        CHECK(check.sched.cancel(reqA2));
+        CHECK(check.cancelled.size() == 1 && check.cancelled[0] == fetchA);
+        CHECK(check.started.size() == 2 && check.started[1].first == "c");
+        // Showing up late is ignored
+        check.sched.finish(fetchA,true,"a");
+        CHECK(check.numDone("a") == 0);
+        CHECK(!check.fetchFor("b"));
+        check.finish("c");
+        CHECK(check.numDone("c") == 1);
+        Scheduler::Stats stats = check.sched.getStats();
+        CHECK(stats.numCancelled == 3 && stats.numActive == 0 && stats.numQueued == 0);
+    }
+
+    return true;
+}
+
+// Tile body we can check on the other end.  Size depends on the tile.
+std::string MakeBody(const std::string &path)
+{
+    unsigned int val = 2166136261u;
+    for (char c : path)
+        val = (val ^ (unsigned char)c) * 16777619u;
+    size_t size = 4096 + val % 12288;
+    std::string body(size,' ');
+    for (size_t ii=0;ii<size;ii++)
+    {
+        val = val * 1664525 + 1013904223;
+        body[ii] = val >> 24;
+    }
+    return body;
+}
+
+/** Stands in for a tile server.  Each request takes latency milliseconds, plus or minus jitter, before we answer.
+  */
+class TileServer
+{
+public:
+    TileServer(int latency,int jitter) : latency(latency), jitter(jitter), listenFD(-1), port(0), running(false), numRequests(0) { }
+    ~TileServer() { stop(); }
+
+    bool start()
+    {
+        listenFD = socket(AF_INET,SOCK_STREAM,0);
+        if (listenFD < 0)
+        {
+            fprintf(stderr,"Couldn't make a socket\n");
+            return false;
+        }
+        int on = 1;
+        setsockopt(listenFD,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+        sockaddr_in addr;
+        memset(&addr,0,sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t addrLen = sizeof(addr);
+        if (bind(listenFD,(sockaddr *)&addr,sizeof(addr)) != 0 || listen(listenFD,256) != 0 ||
+            getsockname(listenFD,(sockaddr *)&addr,&addrLen) != 0)
+        {
+            fprintf(stderr,"Couldn't listen on the loopback\n");
+            return false;
+        }
+        port = ntohs(addr.sin_port);
+        running = true;
+        acceptThread = std::thread([this]() { acceptLoop(); });
+
+        return true;
+    }
+
+    void stop()
+    {
+        if (!running)
+            return;
+        running = false;
+        shutdown(listenFD,SHUT_RDWR);
+        close(listenFD);
+        acceptThread.join();
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock,[this]() { return numConnections == 0; });
+    }
+
+    int latency,jitter;
+    int listenFD,port;
+    bool running;
+    int numRequests;
+
+protected:
+    void acceptLoop()
+    {
+        std::mt19937 rng(port);
+        while (running)
+        {
+            int fd = accept(listenFD,NULL,NULL);
+            if (fd < 0)
+                continue;
+            int delay = latency + (int)(rng() % (2*jitter+1)) - jitter;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                numConnections++;
+                numRequests++;
+            }
+            std::thread([this,fd,delay]() {
+                handle(fd,delay);
+                std::lock_guard<std::mutex> lock(mutex);
+                numConnections--;
+                allDone.notify_all();
+            }).detach();
+        }
+    }
+
+    void handle(int fd,int delay)
+    {
+        std::string request;
+        char buf[1024];
+        while (request.find("\r\n\r\n") == std::string::npos)
+        {
+            ssize_t len = read(fd,buf,sizeof(buf));
+            if (len <= 0)
+            {
+                close(fd);
+                return;
+            }
+            request.append(buf,len);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+
+        std::string response;
+        size_t pathStart = request.find(' '),pathEnd = request.find(' ',pathStart+1);
+        if (request.compare(0,4,"GET ") != 0 || pathEnd == std::string::npos)
+            response = "HTTP/1.0 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+        else {
+            std::string body = MakeBody(request.substr(pathStart+1,pathEnd-pathStart-1));
+            response = "HTTP/1.0 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        }
+        size_t sent = 0;
+        while (sent < response.size())
+        {
+            ssize_t len = write(fd,response.data()+sent,response.size()-sent);
+            if (len <= 0)
+                break;
+            sent += len;
+        }
+        close(fd);
+    }
+
+    std::mutex mutex;
+    std::condition_variable allDone;
+    int numConnections = 0;
+    std::thread acceptThread;
+};
+
+/** Does the fetches the scheduler starts, with a blocking HTTP GET on a pool of threads.
+    Cancelling a fetch that's in progress shuts its socket down.
+  */
+class Fetcher
+{
+public:
+    Fetcher(Scheduler *sched,int numThreads) : sched(sched), stopping(false)
+    {
+        sched->setCancelFunc([this](Scheduler::FetchID fetchID) { cancel(fetchID); });
+        for (int ii=0;ii<numThreads;ii++)
+            threads.push_back(std::thread([this]() { workLoop(); }));
+    }
+
+    ~Fetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    // Start function for the scheduler
+    Scheduler::StartFunc starter(int port,const std::string &path)
+    {
+        return [this,port,path](Scheduler::FetchID fetchID) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                Job job;
+                job.fetchID = fetchID;
+                job.port = port;
+                job.path = path;
+                jobs.push_back(job);
+            }
+            wake.notify_one();
+        };
+    }
+
+protected:
+    class Job
+    {
+    public:
+        Scheduler::FetchID fetchID;
+        int port;
+        std::string path;
+    };
+
+    void cancel(Scheduler::FetchID fetchID)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = activeFDs.find(fetchID);
+        if (it != activeFDs.end())
+            shutdown(it->second,SHUT_RDWR);
+        else
+            cancelled.insert(fetchID);
+    }
+
+    void workLoop()
+    {
+        while (true)
+        {
+            Job job;
+            int fd = -1;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock,[this]() { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = jobs.front();
+                jobs.pop_front();
+                if (cancelled.erase(job.fetchID))
+                    continue;
+                fd = socket(AF_INET,SOCK_STREAM,0);
+                activeFDs[job.fetchID] = fd;
+            }
+
+            std::string body;
+            bool success = get(fd,job.port,job.path,body);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                activeFDs.erase(job.fetchID);
+            }
+            close(fd);
+            sched->finish(job.fetchID,success,body);
+        }
+    }
+
+    bool get(int fd,int port,const std::string &path,std::string &body)
+    {
+        sockaddr_in addr;
+        memset(&addr,0,sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (connect(fd,(sockaddr *)&addr,sizeof(addr)) != 0)
+            return false;
+        std::string request = "GET " + path + " HTTP/1.0\r\n\r\n";
+        if (write(fd,request.data(),request.size()) != (ssize_t)request.size())
+            return false;
+
+        std::string response;
+        char buf[16384];
+        ssize_t len;
+        while ((len = read(fd,buf,sizeof(buf))) > 0)
+            response.append(buf,len);
+        size_t headerEnd = response.find("\r\n\r\n");
+        if (headerEnd == std::string::npos || response.compare(0,12,"HTTP/1.0 200") != 0)
+            return false;
+        body = response.substr(headerEnd+4);
+        return body == MakeBody(path);
+    }
+
+    Scheduler *sched;
+    std::mutex mutex;
+    bool stopping;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    std::set<Scheduler::FetchID> cancelled;
+    std::map<Scheduler::FetchID,int> activeFDs;
+    std::vector<std::thread> threads;
+};
+
+class BenchParams
+{
+public:
+    int numViews,viewTime;
+    int viewWidth,viewHeight;
+    int maxPerHost,maxActive;
+    int latency,jitter;
+    int numHosts;
+};
+
+class BenchResults
+{
+public:
+    BenchResults() : p50(0.0), p99(0.0), settleTime(0.0), numTiles(0), numFetches(0), numServed(0), numFailed(0) { }
+    double p50,p99;
+    double settleTime;
+    int numTiles,numFetches,numServed;
+    int numFailed;
+};
+
+/** Pan a view across a grid of tiles and time how long it takes each tile to show up.
+    There are three layers.  Two of them show the same source, the way a multiplex source
+    with a repeated frame would.  Tiles are spread over the hosts the way a.tiles, b.tiles and
+    so on are.
+    When useScheduler is off every request is its own fetch, they go out first come first
+    served and nothing is cancelled when it leaves the view, which is what the tile sources
+    did on their own.
+  */
+bool RunBench(const BenchParams &params,bool useScheduler,BenchResults &results)
+{
+    std::vector<std::unique_ptr<TileServer> > servers;
+    for (int ii=0;ii<params.numHosts;ii++)
+    {
+        servers.push_back(std::unique_ptr<TileServer>(new TileServer(params.latency,params.jitter)));
+        if (!servers.back()->start())
+            return false;
+    }
+
+    Scheduler sched(params.maxPerHost,params.maxActive);
+    std::unique_ptr<Fetcher> fetcher(new Fetcher(&sched,params.maxActive));
+
+    // Requests for what's in view, by layer and tile
+    class Wanted
+    {
+    public:
+        Scheduler::RequestID requestID;
+        Clock::time_point startTime;
+        bool arrived;
+    };
+    std::mutex mutex;
+    std::map<std::string,Wanted> wanted;
+    std::vector<double> times;
+    int numFailed = 0;
+    unsigned long long requestNum = 0;
+
+    const int level = 14;
+    int viewX = 1000,viewY = 1000;
+    for (int view=0;view<params.numViews;view++)
+    {
+        // Mostly a steady pan, with the occasional fling
+        viewX += (view % 10 == 9) ? 4 : 1;
+        if (view % 3 == 0)
+            viewY++;
+        double centerX = viewX + params.viewWidth/2.0,centerY = viewY + params.viewHeight/2.0;
+
+        std::set<std::string> inView;
+        for (int layer=0;layer<3;layer++)
+            for (int iy=0;iy<params.viewHeight;iy++)
+                for (int ix=0;ix<params.viewWidth;ix++)
+                {
+                    int x = viewX + ix,y = viewY + iy;
+                    int host = (x+y) % params.numHosts;
+                    std::string path = "/" + std::to_string(layer == 1 ? 0 : layer) + "/" + std::to_string(level) + "/" + std::to_string(x) + "/" + std::to_string(y) + ".png";
+                    std::string key = std::to_string(layer) + path;
+                    inView.insert(key);
+                    double dist = sqrt((x+0.5-centerX)*(x+0.5-centerX) + (y+0.5-centerY)*(y+0.5-centerY));
+                    double importance = useScheduler ? 1.0 / (1.0 + dist) : 0.0;
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto it = wanted.find(key);
+                    if (it != wanted.end())
+                    {
+                        if (useScheduler && !it->second.arrived)
+                            sched.setImportance(it->second.requestID,importance);
+                        continue;
+                    }
+                    Wanted &want = wanted[key];
+                    want.startTime = Clock::now();
+                    want.arrived = false;
+                    // Without the scheduler, no one shares
+                    std::string url = useScheduler ? path : path + "#" + std::to_string(requestNum++);
+                    want.requestID = sched.request(url,"host" + std::to_string(host),importance,fetcher->starter(servers[host]->port,path),
+                                                   [&,key](bool success,const std::string & /*data*/)
+                                                   {
+                                                       std::lock_guard<std::mutex> lock(mutex);
+                                                       auto it = wanted.find(key);
+                                                       if (it == wanted.end() || it->second.arrived)
+                                                           return;
+                                                       if (!success)
+                                                           numFailed++;
+                                                       it->second.arrived = true;
+                                                       times.push_back(SecondsSince(it->second.startTime));
+                                                   });
+                }
+
+        // Forget about what's left the view
+        std::vector<Scheduler::RequestID> toCancel;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto it = wanted.begin();it != wanted.end();)
+                if (inView.find(it->first) == inView.end())
+                {
+                    if (!it->second.arrived)
+                        toCancel.push_back(it->second.requestID);
+                    it = wanted.erase(it);
+                } else
+                    ++it;
+        }
+        if (useScheduler)
+            for (auto requestID : toCancel)
+                sched.cancel(requestID);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(params.viewTime));
+    }
+
+    // Wait for the last view to fill in
+    Clock::time_point settleStart = Clock::now();
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bool allIn = true;
+            for (auto &it : wanted)
+                allIn &= it.second.arrived;
+            if (allIn)
+                break;
+        }
+        if (SecondsSince(settleStart) > 60.0)
+        {
+            fprintf(stderr,"Last view never filled in\n");
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    results.settleTime = SecondsSince(settleStart);
+
+    // Stragglers from views long gone still have to finish without the scheduler
+    while (true)
+    {
+        Scheduler::Stats stats = sched.getStats();
+        if (stats.numActive == 0 && stats.numQueued == 0)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    fetcher.reset();
+    for (auto &server : servers)
+        server->stop();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::sort(times.begin(),times.end());
+    results.numTiles = (int)times.size();
+    if (!times.empty())
+    {
+        results.p50 = times[std::min(times.size()/2,times.size()-1)];
+        results.p99 = times[std::min((size_t)(times.size()*0.99),times.size()-1)];
+    }
+    results.numFetches = sched.getStats().numFetches;
+    for (auto &server : servers)
+        results.numServed += server->numRequests;
+    results.numFailed = numFailed;
+
+    return true;
+}
+
+int main(int argc, const char * argv[])
+{
+    BenchParams params;
+    params.numViews = 60;
+    params.viewTime = 100;
+    params.viewWidth = 8;
+    params.viewHeight = 6;
+    params.maxPerHost = 4;
+    params.maxActive = 8;
+    params.latency = 40;
+    params.jitter = 20;
+    params.numHosts = 3;
+
+    for (int ii=1;ii<argc;ii++)
+    {
+        if (!strcmp(argv[ii],"-views") && ii+1 < argc)
+            params.numViews = atoi(argv[++ii]);
+        else if (!strcmp(argv[ii],"-viewtime") && ii+1 < argc)
+            params.viewTime = atoi(argv[++ii]);
+        else if (!strcmp(argv[ii],"-perhost") && ii+1 < argc)
+            params.maxPerHost = atoi(argv[++ii]);
+        else if (!strcmp(argv[ii],"-active") && ii+1 < argc)
+            params.maxActive = atoi(argv[++ii]);
+        else if (!strcmp(argv[ii],"-latency") && ii+1 < argc)
+            params.latency = atoi(argv[++ii]);
+        else if (!strcmp(argv[ii],"-hosts") && ii+1 < argc)
+            params.numHosts = atoi(argv[++ii]);
+        else {
+            fprintf(stderr,"usage: fetch_bench [-views n] [-viewtime ms] [-perhost n] [-active n] [-latency ms] [-hosts n]\n");
+            return -1;
+        }
+    }
+    if (params.numViews < 1 || params.viewTime < 0 || params.maxPerHost < 1 || params.maxActive < 1 || params.latency < 0 || params.numHosts < 1)
+    {
+        fprintf(stderr,"Bad parameters\n");
+        return -1;
+    }
+    params.jitter = params.latency/2;
+    signal(SIGPIPE,SIG_IGN);
+
+    if (!RunChecks())
+        return -1;
+    fprintf(stdout,"Checks passed\n");
+
+    BenchResults before,after;
+    if (!RunBench(params,false,before) || !RunBench(params,true,after))
+        return -1;
+    if (before.numFailed || after.numFailed)
+    {
+        fprintf(stderr,"Tiles failed: %d before, %d after\n",before.numFailed,after.numFailed);
+        return -1;
+    }
+
+    fprintf(stdout,"%d views, %d ms apart, %d hosts, %d ms latency, %d per host, %d at once\n",params.numViews,params.viewTime,params.numHosts,params.latency,params.maxPerHost,params.maxActive);
+    fprintf(stdout,"             p50 (ms)  p99 (ms)  settle (ms)  tiles  fetches  requests served\n");
+    fprintf(stdout,"first come   %8.1f  %8.1f  %11.1f  %5d  %7d  %15d\n",before.p50*1000,before.p99*1000,before.settleTime*1000,before.numTiles,before.numFetches,before.numServed);
+    fprintf(stdout,"scheduled    %8.1f  %8.1f  %11.1f  %5d  %7d  %15d\n",after.p50*1000,after.p99*1000,after.settleTime*1000,after.numTiles,after.numFetches,after.numServed);
+
+    return 0;
+}
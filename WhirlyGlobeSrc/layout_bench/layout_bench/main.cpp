@@ -0,0 +1,264 @@
+//
+//  main.cpp
+//  layout_bench
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include "OverlapHelper.h"
+
+using namespace Eigen;
+using namespace WhirlyKit;
+
+typedef std::chrono::steady_clock Clock;
+
+double SecondsSince(Clock::time_point startTime)
+{
+    return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+// Same as the layout manager uses
+static const int OverlapSampleX = 10;
+static const int OverlapSampleY = 60;
+static const float ScreenBuffer = 0.1;
+static const int LayoutChunkSize = 256;
+// The placement flags LayoutObject uses by default: left, right, above and below
+static const int DefaultPlacement = (1<<2) | (1<<3) | (1<<4) | (1<<5);
+
+// Stands in for a label or marker.  It lives on a flat map in [0,1].
+class FakeLabel
+{
+public:
+    Point2d loc;
+    float rotation;
+    float importance;
+    int labelID;
+    bool enable;
+    std::vector<Point2d> layoutPts;
+};
+
+// Where we're looking from for one frame
+class FakeCamera
+{
+public:
+    Point2d center;
+    // Pixels per unit of map
+    double zoom;
+    Point2f frameSize;
+};
+
+// Project the labels and note where they are, like ProjectLayoutObject does.
+// With more than one thread, it goes in chunks the way the layout manager hands them out.
+void UpdatePlacements(const std::vector<FakeLabel> &labels,std::vector<LayoutPlacement> &placements,const FakeCamera &camera,bool startOver,int numThreads)
+{
+    Mbr screenMbr(Point2f(-ScreenBuffer * camera.frameSize.x(),-ScreenBuffer * camera.frameSize.y()),camera.frameSize * (1.0 + ScreenBuffer));
+    auto doChunk = [&](size_t chunk)
+    {
+        size_t end = std::min((chunk+1) * LayoutChunkSize,labels.size());
+        for (size_t ii=chunk * LayoutChunkSize;ii<end;ii++)
+        {
+            const FakeLabel &label = labels[ii];
+            Point2d screenPt = (label.loc - camera.center) * camera.zoom + Point2d(camera.frameSize.x()/2.0,camera.frameSize.y()/2.0);
+            bool inside = screenMbr.inside(Point2f(screenPt.x(),screenPt.y()));
+            placements[ii].update(screenPt,inside ? label.rotation : 0.0,inside,startOver);
+        }
+    };
+    size_t numChunks = (labels.size() + LayoutChunkSize - 1) / LayoutChunkSize;
+    if (numThreads <= 1)
+    {
+        for (size_t chunk=0;chunk<numChunks;chunk++)
+            doChunk(chunk);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (int ti=0;ti<numThreads;ti++)
+        workers.push_back(std::thread([&,ti]
+        {
+            for (size_t chunk=ti;chunk<numChunks;chunk+=numThreads)
+                doChunk(chunk);
+        }));
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+// Turned on labels in importance order, ties by ID
+void BuildOrder(const std::vector<FakeLabel> &labels,std::vector<LayoutPlacement> &placements,std::vector<LayoutOverlapObject> &order)
+{
+    std::vector<int> which;
+    for (unsigned int ii=0;ii<labels.size();ii++)
+        if (labels[ii].enable)
+            which.push_back(ii);
+    std::sort(which.begin(),which.end(),[&](int a,int b)
+              {
+                  if (labels[a].importance == labels[b].importance)
+                      return labels[a].labelID > labels[b].labelID;
+                  return labels[a].importance > labels[b].importance;
+              });
+    order.resize(which.size());
+    for (unsigned int ii=0;ii<which.size();ii++)
+    {
+        order[ii].placement = &placements[which[ii]];
+        order[ii].layoutPts = &labels[which[ii]].layoutPts;
+        order[ii].acceptablePlacement = DefaultPlacement;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    int numLabels = 20000;
+    int numFrames = 600;
+    int numThreads = 4;
+    int maxDisplay = 0;
+
+    for (int ii=1;ii<argc;ii++)
+    {
+        int *val = NULL;
+        if (!strcmp(argv[ii],"-labels"))
+            val = &numLabels;
+        else if (!strcmp(argv[ii],"-frames"))
+            val = &numFrames;
+        else if (!strcmp(argv[ii],"-threads"))
+            val = &numThreads;
+        else if (!strcmp(argv[ii],"-maxdisplay"))
+            val = &maxDisplay;
+        else {
+            fprintf(stderr,"Unknown option: %s\n",argv[ii]);
+            fprintf(stderr,"%s: [-labels n] [-frames n] [-threads n] [-maxdisplay n]\n",argv[0]);
+            return -1;
+        }
+        if (ii+1 >= argc)
+        {
+            fprintf(stderr,"Expecting one argument for %s\n",argv[ii]);
+            return -1;
+        }
+        *val = atoi(argv[++ii]);
+        if (*val < (val == &maxDisplay ? 0 : 1))
+        {
+            fprintf(stderr,"Bad value for %s\n",argv[ii-1]);
+            return -1;
+        }
+    }
+
+    // Labels of about the size text comes out, some of them turned
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> unit(0.0,1.0);
+    std::vector<FakeLabel> labels(numLabels);
+    for (int ii=0;ii<numLabels;ii++)
+    {
+        FakeLabel &label = labels[ii];
+        label.loc = Point2d(unit(rng),unit(rng));
+        label.rotation = ii % 8 == 0 ? unit(rng) * 2.0 * M_PI : 0.0;
+        // Plenty of ties, like labels that all use the default importance
+        label.importance = (float)(rng() % 20);
+        label.labelID = ii;
+        label.enable = true;
+        Point2d size(40.0 + unit(rng) * 120.0,16.0);
+        label.layoutPts.push_back(Point2d(0,0));
+        label.layoutPts.push_back(Point2d(size.x(),0.0));
+        label.layoutPts.push_back(size);
+        label.layoutPts.push_back(Point2d(0.0,size.y()));
+    }
+
+    // The reused answers, a copy we lay out from scratch to check them,
+    //  and placements updated on one thread to check the workers against
+    std::vector<LayoutPlacement> placements(numLabels),checkPlacements,serialPlacements(numLabels);
+    std::vector<LayoutPlacement *> lastOrder,checkLastOrder;
+    std::vector<LayoutOverlapObject> order,checkOrder;
+
+    FakeCamera camera;
+    camera.center = Point2d(0.5,0.5);
+    camera.zoom = 4000.0;
+    camera.frameSize = Point2f(2048,1536);
+    Point2f lastFrameSize(0,0);
+    double updateTime = 0.0, serialUpdateTime = 0.0, reuseTime = 0.0, fullTime = 0.0;
+    long long numReused = 0, numLaidOut = 0, numActive = 0;
+    for (int frame=0;frame<numFrames;frame++)
+    {
+        // Mostly drifting by less than a pixel, sometimes a real pan or zoom, once in a while a rotation
+        int phase = frame % 120;
+        if (phase < 60)
+            camera.center += Point2d(0.3,0.1) / camera.zoom;
+        else if (phase < 70)
+            camera.center += Point2d(-25.0,12.0) / camera.zoom;
+        else if (phase < 80)
+            camera.zoom *= 1.01;
+        else if (phase == 100)
+            camera.frameSize = Point2f(camera.frameSize.y(),camera.frameSize.x());
+        // And some labels come and go
+        if (frame % 30 == 15)
+            for (int li=0;li<10;li++)
+            {
+                FakeLabel &label = labels[rng() % numLabels];
+                label.enable = !label.enable;
+            }
+
+        bool startOver = camera.frameSize != lastFrameSize;
+        lastFrameSize = camera.frameSize;
+
+        Clock::time_point startTime = Clock::now();
+        UpdatePlacements(labels,placements,camera,startOver,numThreads);
+        updateTime += SecondsSince(startTime);
+        startTime = Clock::now();
+        UpdatePlacements(labels,serialPlacements,camera,startOver,1);
+        serialUpdateTime += SecondsSince(startTime);
+        for (int li=0;li<numLabels;li++)
+        {
+            const LayoutPlacement &a = placements[li], &b = serialPlacements[li];
+            if (a.moved != b.moved || a.screenPt != b.screenPt || a.screenRot != b.screenRot || a.inside != b.inside)
+            {
+                fprintf(stderr,"Frame %d: label %d was placed differently on %d threads than on one\n",frame,li,numThreads);
+                return -1;
+            }
+        }
+
+        // Lay out from scratch with the same starting spots, then reusing last frame
+        checkPlacements = placements;
+        BuildOrder(labels,checkPlacements,checkOrder);
+        startTime = Clock::now();
+        LayoutOverlapPass(checkOrder,checkLastOrder,false,maxDisplay,1.0,
+                          Mbr(Point2f(-ScreenBuffer * camera.frameSize.x(),-ScreenBuffer * camera.frameSize.y()),camera.frameSize * (1.0 + ScreenBuffer)),OverlapSampleX,OverlapSampleY);
+        fullTime += SecondsSince(startTime);
+
+        BuildOrder(labels,placements,order);
+        int prefix = 0;
+        while (!startOver && prefix < (int)order.size() && prefix < (int)lastOrder.size() && lastOrder[prefix] == order[prefix].placement && !order[prefix].placement->moved)
+            prefix++;
+        startTime = Clock::now();
+        LayoutOverlapPass(order,lastOrder,!startOver,maxDisplay,1.0,
+                          Mbr(Point2f(-ScreenBuffer * camera.frameSize.x(),-ScreenBuffer * camera.frameSize.y()),camera.frameSize * (1.0 + ScreenBuffer)),OverlapSampleX,OverlapSampleY);
+        reuseTime += SecondsSince(startTime);
+        numReused += prefix;
+        numLaidOut += order.size();
+
+        for (unsigned int oi=0;oi<order.size();oi++)
+        {
+            const LayoutPlacement &a = *order[oi].placement, &b = *checkOrder[oi].placement;
+            if (a.active != b.active || (a.active && (a.offset != b.offset || a.footprint != b.footprint)))
+            {
+                fprintf(stderr,"Frame %d: object %d of %d came out differently with reuse (%s) and without (%s)\n",frame,oi,(int)order.size(),
+                        a.active ? "on" : "off",b.active ? "on" : "off");
+                return -1;
+            }
+            if (a.active)
+                numActive++;
+        }
+    }
+
+    fprintf(stdout,"%d labels, %d frames, %.1f on screen a frame\n",numLabels,numFrames,(double)numActive / numFrames);
+    fprintf(stdout,"Placement update: %d threads %.3f ms a frame, one thread %.3f ms\n",numThreads,updateTime / numFrames * 1e3,serialUpdateTime / numFrames * 1e3);
+    fprintf(stdout,"Overlap pass: reuse %.3f ms a frame, from scratch %.3f ms, %.1f%% of objects reused\n",reuseTime / numFrames * 1e3,fullTime / numFrames * 1e3,
+            numLaidOut > 0 ? 100.0 * numReused / numLaidOut : 0.0);
+    fprintf(stdout,"Same layout with and without reuse on every frame\n");
+
+    return 0;
+}
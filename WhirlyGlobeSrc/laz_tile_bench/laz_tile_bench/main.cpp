@@ -0,0 +1,238 @@
+//
+//  main.cpp
+//  laz_tile_bench
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include "sqlite3.h"
+#include "laszip_api.h"
+#include "MaplyLAZTileDecoder.h"
+
+// Numbers for one input file
+class BenchStats
+{
+public:
+    BenchStats() : tiles(0), points(0), seeks(0), secs(0.0) { }
+
+    void print(const char *what)
+    {
+        fprintf(stdout,"%s: %d tiles, %lld points, %lld seeks in %.3fs: %.1f points/sec\n",what,tiles,points,seeks,secs,(secs > 0.0 ? points/secs : 0.0));
+    }
+
+    int tiles;
+    long long points,seeks;
+    double secs;
+};
+
+// The old way of doing it, seeking for every point.  Useful for comparison.
+bool DecodeSeekEach(laszip_POINTER reader,long long start,int count,double colorScale,MaplyLAZPointBuffer &points,long long &seeks)
+{
+    laszip_header_struct *header;
+    laszip_point_struct *p;
+    laszip_get_header_pointer(reader,&header);
+    laszip_get_point_pointer(reader,&p);
+    points.hasColors = header->point_data_format > 1;
+    points.resize(count);
+    for (int ii=0;ii<count;ii++)
+    {
+        if (laszip_seek_point(reader,start+ii) || laszip_read_point(reader))
+            return false;
+        seeks++;
+        points.x[ii] = p->X * header->x_scale_factor + header->x_offset;
+        points.y[ii] = p->Y * header->y_scale_factor + header->y_offset;
+        points.z[ii] = p->Z * header->z_scale_factor + header->z_offset;
+        if (points.hasColors)
+        {
+            points.red[ii] = p->rgb[0] / colorScale;
+            points.green[ii] = p->rgb[1] / colorScale;
+            points.blue[ii] = p->rgb[2] / colorScale;
+        }
+    }
+
+    return true;
+}
+
+// Split a single LAZ file into runs of points and load those as tiles, in no particular order
+bool BenchLAZFile(const char *fileName,int tilePoints,bool seekEach,double colorScale,BenchStats &stats)
+{
+    laszip_POINTER reader;
+    laszip_BOOL isCompressed;
+    laszip_create(&reader);
+    if (laszip_open_reader(reader,fileName,&isCompressed))
+    {
+        fprintf(stderr,"Failed to open LAZ file: %s\n",fileName);
+        laszip_destroy(reader);
+        return false;
+    }
+    laszip_header_struct *header;
+    laszip_get_header_pointer(reader,&header);
+    long long numPoints = header->number_of_point_records ? header->number_of_point_records : header->extended_number_of_point_records;
+
+    // The viewer asks for tiles in whatever order it wants them
+    std::vector<long long> tileStarts;
+    for (long long start=0;start<numPoints;start+=tilePoints)
+        tileStarts.push_back(start);
+    std::mt19937 rng(0);
+    std::shuffle(tileStarts.begin(), tileStarts.end(), rng);
+
+    MaplyLAZTileDecoder decoder(reader);
+    MaplyLAZPointBuffer points;
+    bool ok = true;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    for (unsigned int ti=0;ti<tileStarts.size() && ok;ti++)
+    {
+        int count = (int)std::min((long long)tilePoints,numPoints-tileStarts[ti]);
+        if (seekEach)
+            ok = DecodeSeekEach(reader, tileStarts[ti], count, colorScale, points, stats.seeks);
+        else
+            ok = decoder.decode(tileStarts[ti], count, 0.0, colorScale, points);
+        stats.tiles++;
+        stats.points += points.size();
+    }
+    stats.secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    stats.seeks += decoder.getNumSeeks();
+    if (!ok)
+        fprintf(stderr,"Failed to decode points in %s\n",fileName);
+
+    laszip_close_reader(reader);
+    laszip_destroy(reader);
+
+    return ok;
+}
+
+// Load every tile in a LAZ quad database, the way MaplyLAZQuadReader does
+bool BenchLAZDatabase(const char *fileName,bool seekEach,double colorScale,BenchStats &stats)
+{
+    sqlite3 *db = NULL;
+    if (sqlite3_open_v2(fileName, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr,"Failed to open database: %s\n",fileName);
+        sqlite3_close(db);
+        return false;
+    }
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, "SELECT data FROM lidartiles;", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr,"No lidartiles table in %s\n",fileName);
+        sqlite3_close(db);
+        return false;
+    }
+
+    MaplyLAZPointBuffer points;
+    bool ok = true;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    while (ok && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        std::stringstream tileStream;
+        tileStream.write((const char *)sqlite3_column_blob(stmt, 0),sqlite3_column_bytes(stmt, 0));
+
+        laszip_POINTER reader;
+        laszip_BOOL isCompressed;
+        laszip_create(&reader);
+        if (laszip_open_stream_reader(reader,&tileStream,&isCompressed))
+        {
+            ok = false;
+        } else {
+            laszip_header_struct *header;
+            laszip_get_header_pointer(reader,&header);
+            int count = header->number_of_point_records;
+            if (seekEach)
+                ok = DecodeSeekEach(reader, 0, count, colorScale, points, stats.seeks);
+            else {
+                MaplyLAZTileDecoder decoder(reader);
+                ok = decoder.decode(0, count, 0.0, colorScale, points);
+                stats.seeks += decoder.getNumSeeks();
+            }
+            laszip_close_reader(reader);
+        }
+        laszip_destroy(reader);
+        stats.tiles++;
+        stats.points += points.size();
+    }
+    stats.secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!ok)
+        fprintf(stderr,"Failed to decode tile %d in %s\n",stats.tiles,fileName);
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    return ok;
+}
+
+int main(int argc, char * argv[])
+{
+    int tilePoints = 16384;
+    bool seekEach = false;
+    double colorScale = 255;
+    std::vector<const char *> inputFiles;
+
+    for (int ii=1;ii<argc;ii++)
+    {
+        if (!strcmp(argv[ii],"-tilepoints"))
+        {
+            if (ii+1 >= argc)
+            {
+                fprintf(stderr,"Expecting one argument for -tilepoints\n");
+                return -1;
+            }
+            tilePoints = atoi(argv[++ii]);
+            if (tilePoints < 1)
+            {
+                fprintf(stderr,"Expecting at least one point for -tilepoints\n");
+                return -1;
+            }
+        } else if (!strcmp(argv[ii],"-colorscale"))
+        {
+            if (ii+1 >= argc)
+            {
+                fprintf(stderr,"Expecting one argument for -colorscale\n");
+                return -1;
+            }
+            colorScale = atof(argv[++ii]);
+        } else if (!strcmp(argv[ii],"-seekeach"))
+        {
+            seekEach = true;
+        } else if (argv[ii][0] == '-')
+        {
+            fprintf(stderr,"Unknown option: %s\n",argv[ii]);
+            return -1;
+        } else
+            inputFiles.push_back(argv[ii]);
+    }
+
+    if (inputFiles.empty())
+    {
+        fprintf(stderr,"%s: [-tilepoints n] [-colorscale s] [-seekeach] file.laz|file.sqlite ...\n",argv[0]);
+        return -1;
+    }
+
+    BenchStats total;
+    for (unsigned int fi=0;fi<inputFiles.size();fi++)
+    {
+        const char *fileName = inputFiles[fi];
+        const char *ext = strrchr(fileName, '.');
+        bool isDatabase = ext && (!strcmp(ext,".sqlite") || !strcmp(ext,".db"));
+
+        BenchStats stats;
+        bool ok = isDatabase ? BenchLAZDatabase(fileName, seekEach, colorScale, stats) : BenchLAZFile(fileName, tilePoints, seekEach, colorScale, stats);
+        if (!ok)
+            return -1;
+        stats.print(fileName);
+        total.tiles += stats.tiles;  total.points += stats.points;  total.seeks += stats.seeks;  total.secs += stats.secs;
+    }
+    if (inputFiles.size() > 1)
+        total.print("All files");
+
+    return 0;
+}
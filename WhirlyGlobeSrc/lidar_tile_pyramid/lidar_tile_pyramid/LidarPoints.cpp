@@ -0,0 +1,262 @@
+//
+//  LidarPoints.cpp
+//  lidar_tile_pyramid
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include "LidarPoints.h"
+#include <algorithm>
+#include <float.h>
+
+// Splitmix64 finalizer
+unsigned long long LidarPointRank(unsigned long long val)
+{
+    val += 0x9E3779B97F4A7C15ULL;
+    val = (val ^ (val >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    val = (val ^ (val >> 27)) * 0x94D049BB133111EBULL;
+    return val ^ (val >> 31);
+}
+
+LidarFileSource::LidarFileSource(const std::vector<std::string> &fileNames)
+: minX(DBL_MAX), minY(DBL_MAX), minZ(DBL_MAX), maxX(-DBL_MAX), maxY(-DBL_MAX), maxZ(-DBL_MAX),
+    scaleX(DBL_MAX), scaleY(DBL_MAX), scaleZ(DBL_MAX), hasColors(false), maxColor(0),
+    fileNames(fileNames), totalPoints(0), curFile(0), curPoint(0), reader(NULL)
+{
+}
+
+LidarFileSource::~LidarFileSource()
+{
+    closeFile();
+}
+
+bool LidarFileSource::scanHeaders()
+{
+    totalPoints = 0;
+    fileCounts.clear();
+    for (unsigned int ii=0;ii<fileNames.size();ii++)
+    {
+        if (!openFile(ii))
+            return false;
+
+        laszip_header_struct *header;
+        laszip_get_header_pointer(reader,&header);
+        long long count = header->number_of_point_records ? header->number_of_point_records : header->extended_number_of_point_records;
+        fileCounts.push_back(count);
+        totalPoints += count;
+
+        minX = std::min(minX,header->min_x);  maxX = std::max(maxX,header->max_x);
+        minY = std::min(minY,header->min_y);  maxY = std::max(maxY,header->max_y);
+        minZ = std::min(minZ,header->min_z);  maxZ = std::max(maxZ,header->max_z);
+        scaleX = std::min(scaleX,header->x_scale_factor);
+        scaleY = std::min(scaleY,header->y_scale_factor);
+        scaleZ = std::min(scaleZ,header->z_scale_factor);
+        // Formats 2, 3, 5 and 7 and up have RGB
+        int format = header->point_data_format;
+        if (format == 2 || format == 3 || format == 5 || format >= 7)
+            hasColors = true;
+
+        closeFile();
+    }
+    curFile = 0;
+    curPoint = 0;
+
+    return true;
+}
+
+bool LidarFileSource::openFile(unsigned int which)
+{
+    closeFile();
+
+    laszip_BOOL isCompressed;
+    laszip_create(&reader);
+    if (laszip_open_reader(reader,fileNames[which].c_str(),&isCompressed))
+    {
+        fprintf(stderr,"Failed to open LAS file: %s\n",fileNames[which].c_str());
+        laszip_destroy(reader);
+        reader = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void LidarFileSource::closeFile()
+{
+    if (reader)
+    {
+        laszip_close_reader(reader);
+        laszip_destroy(reader);
+        reader = NULL;
+    }
+}
+
+bool LidarFileSource::read(std::vector<LidarPoint> &points,int maxPoints)
+{
+    points.clear();
+
+    while ((int)points.size() < maxPoints && curFile < fileNames.size())
+    {
+        if (!reader)
+        {
+            if (!openFile(curFile))
+                return false;
+            curPoint = 0;
+        }
+
+        laszip_header_struct *header;
+        laszip_point_struct *p;
+        laszip_get_header_pointer(reader,&header);
+        laszip_get_point_pointer(reader,&p);
+        long long fileCount = fileCounts[curFile];
+        // Each point gets a rank based on where it came from, so runs are repeatable
+        unsigned long long rankBase = (unsigned long long)curFile << 40;
+        while ((int)points.size() < maxPoints && curPoint < fileCount)
+        {
+            if (laszip_read_point(reader))
+            {
+                fprintf(stderr,"Failed to read point %lld from %s\n",curPoint,fileNames[curFile].c_str());
+                return false;
+            }
+
+            LidarPoint pt;
+            pt.x = p->X * header->x_scale_factor + header->x_offset;
+            pt.y = p->Y * header->y_scale_factor + header->y_offset;
+            pt.z = p->Z * header->z_scale_factor + header->z_offset;
+            pt.rank = LidarPointRank(rankBase + curPoint);
+            pt.intensity = p->intensity;
+            pt.classification = p->classification;
+            for (unsigned int ic=0;ic<3;ic++)
+            {
+                pt.rgb[ic] = hasColors ? p->rgb[ic] : 0;
+                maxColor = std::max(maxColor,(int)pt.rgb[ic]);
+            }
+            points.push_back(pt);
+            curPoint++;
+        }
+
+        if (curPoint >= fileCount)
+        {
+            closeFile();
+            curFile++;
+        }
+    }
+
+    return true;
+}
+
+LidarBucketSource::LidarBucketSource(const std::string &fileName,long long count,bool removeWhenDone)
+: fileName(fileName), count(count), removeWhenDone(removeWhenDone), fp(NULL)
+{
+}
+
+LidarBucketSource::~LidarBucketSource()
+{
+    if (fp)
+        fclose(fp);
+    if (removeWhenDone)
+        remove(fileName.c_str());
+}
+
+bool LidarBucketSource::read(std::vector<LidarPoint> &points,int maxPoints)
+{
+    points.clear();
+    if (count == 0)
+        return true;
+
+    if (!fp)
+    {
+        fp = fopen(fileName.c_str(),"rb");
+        if (!fp)
+        {
+            fprintf(stderr,"Failed to open bucket file: %s\n",fileName.c_str());
+            return false;
+        }
+    }
+
+    points.resize(maxPoints);
+    size_t numRead = fread(&points[0], sizeof(LidarPoint), maxPoints, fp);
+    points.resize(numRead);
+    if (numRead == 0 && ferror(fp))
+    {
+        fprintf(stderr,"Failed to read bucket file: %s\n",fileName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+LidarBucketWriter::LidarBucketWriter(const std::string &baseName,int numBuckets,int bufferPoints)
+: baseName(baseName), bufferPoints(std::max(bufferPoints,1)), files(numBuckets,(FILE *)NULL), buffers(numBuckets), counts(numBuckets,0), failed(false)
+{
+}
+
+LidarBucketWriter::~LidarBucketWriter()
+{
+    for (unsigned int ii=0;ii<files.size();ii++)
+        if (files[ii])
+            fclose(files[ii]);
+}
+
+std::string LidarBucketWriter::fileName(int which)
+{
+    return baseName + "_" + std::to_string(which) + ".pts";
+}
+
+bool LidarBucketWriter::addPoint(int which,const LidarPoint &pt)
+{
+    std::vector<LidarPoint> &buffer = buffers[which];
+    buffer.push_back(pt);
+    counts[which]++;
+    if ((int)buffer.size() >= bufferPoints)
+        return flushBucket(which);
+
+    return !failed;
+}
+
+bool LidarBucketWriter::flushBucket(int which)
+{
+    std::vector<LidarPoint> &buffer = buffers[which];
+    if (buffer.empty() || failed)
+        return !failed;
+
+    // Files are opened as needed, so empty buckets don't make files
+    if (!files[which])
+    {
+        files[which] = fopen(fileName(which).c_str(),"wb");
+        if (!files[which])
+        {
+            fprintf(stderr,"Failed to open bucket file for write: %s\n",fileName(which).c_str());
+            failed = true;
+            return false;
+        }
+    }
+
+    if (fwrite(&buffer[0], sizeof(LidarPoint), buffer.size(), files[which]) != buffer.size())
+    {
+        fprintf(stderr,"Failed to write to bucket file: %s\n",fileName(which).c_str());
+        failed = true;
+        return false;
+    }
+    buffer.clear();
+
+    return true;
+}
+
+bool LidarBucketWriter::finish()
+{
+    for (unsigned int ii=0;ii<buffers.size();ii++)
+    {
+        if (!flushBucket(ii))
+            return false;
+        std::vector<LidarPoint>().swap(buffers[ii]);
+        if (files[ii])
+        {
+            fclose(files[ii]);
+            files[ii] = NULL;
+        }
+    }
+
+    return !failed;
+}
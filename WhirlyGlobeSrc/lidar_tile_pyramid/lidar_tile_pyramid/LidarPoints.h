@@ -0,0 +1,134 @@
+//
+//  LidarPoints.h
+//  lidar_tile_pyramid
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#ifndef __lidar_tile_pyramid__LidarPoints__
+#define __lidar_tile_pyramid__LidarPoints__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "laszip_api.h"
+
+/** A single point as we pass it between passes.
+    This is what goes into the bucket files, so it needs to stay plain old data.
+  */
+class LidarPoint
+{
+public:
+    double x,y,z;
+    // Pseudo-random, but stable.  Used to pick the subsample for each level.
+    unsigned long long rank;
+    unsigned short intensity;
+    unsigned short rgb[3];
+    unsigned char classification;
+
+    bool operator < (const LidarPoint &that) const { return rank < that.rank; }
+};
+
+// Mix up a number into something that looks random
+unsigned long long LidarPointRank(unsigned long long val);
+
+/** Something we can pull points out of in batches.
+  */
+class LidarPointSource
+{
+public:
+    virtual ~LidarPointSource() { }
+
+    // Read up to maxPoints into points.  Returns false on an error.  An empty batch means we're done.
+    virtual bool read(std::vector<LidarPoint> &points,int maxPoints) = 0;
+
+    // Total number of points we'll return
+    virtual long long numPoints() = 0;
+};
+
+/** Reads points out of a list of LAS or LAZ files, one after the other.
+  */
+class LidarFileSource : public LidarPointSource
+{
+public:
+    LidarFileSource(const std::vector<std::string> &fileNames);
+    ~LidarFileSource();
+
+    // Read the headers for all the files.  Call this first.
+    bool scanHeaders();
+
+    bool read(std::vector<LidarPoint> &points,int maxPoints);
+    long long numPoints() { return totalPoints; }
+
+    // Extents over all the files, from the headers
+    double minX,minY,minZ,maxX,maxY,maxZ;
+    // Smallest scale factor we saw.  We'll use it for the output.
+    double scaleX,scaleY,scaleZ;
+    // Set if any of the inputs have color
+    bool hasColors;
+    // Largest color value we saw, which is how we guess 8 or 16 bit color
+    int maxColor;
+
+protected:
+    bool openFile(unsigned int which);
+    void closeFile();
+
+    std::vector<std::string> fileNames;
+    std::vector<long long> fileCounts;
+    long long totalPoints;
+    unsigned int curFile;
+    long long curPoint;
+    laszip_POINTER reader;
+};
+
+/** Reads points back out of a bucket file we wrote earlier.
+  */
+class LidarBucketSource : public LidarPointSource
+{
+public:
+    // Deletes the file when we're done, if asked
+    LidarBucketSource(const std::string &fileName,long long count,bool removeWhenDone);
+    ~LidarBucketSource();
+
+    bool read(std::vector<LidarPoint> &points,int maxPoints);
+    long long numPoints() { return count; }
+
+protected:
+    std::string fileName;
+    long long count;
+    bool removeWhenDone;
+    FILE *fp;
+};
+
+/** Sorts points into a grid of bucket files on disk.
+    Each bucket gets a small buffer, so memory is bounded by the number of buckets.
+  */
+class LidarBucketWriter
+{
+public:
+    LidarBucketWriter(const std::string &baseName,int numBuckets,int bufferPoints);
+    ~LidarBucketWriter();
+
+    // Add a point to the given bucket
+    bool addPoint(int which,const LidarPoint &pt);
+
+    // Write out whatever is buffered and close the files
+    bool finish();
+
+    // File name and count for a bucket, valid after finish()
+    std::string fileName(int which);
+    long long count(int which) { return counts[which]; }
+
+protected:
+    bool flushBucket(int which);
+
+    std::string baseName;
+    int bufferPoints;
+    std::vector<FILE *> files;
+    std::vector<std::vector<LidarPoint> > buffers;
+    std::vector<long long> counts;
+    bool failed;
+};
+
+#endif /* defined(__lidar_tile_pyramid__LidarPoints__) */
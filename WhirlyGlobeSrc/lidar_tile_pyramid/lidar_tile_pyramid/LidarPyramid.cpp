@@ -0,0 +1,388 @@
+//
+//  LidarPyramid.cpp
+//  lidar_tile_pyramid
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include "LidarPyramid.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+// How many points we read from a source at once
+static const int PointBatchSize = 1<<20;
+// Points buffered per bucket file while sorting
+static const int BucketBufferPoints = 4096;
+
+static std::string LAZTempDir = ".";
+static std::atomic<int> LAZTempCount(0);
+
+void SetLAZTempDir(const std::string &tempDir)
+{
+    LAZTempDir = tempDir;
+}
+
+bool EncodeLAZTile(void *data,int dataLen,void **retData,int &retDataLen)
+{
+    if (dataLen < (int)sizeof(LidarTileFormat))
+        return false;
+    LidarTileFormat format;
+    memcpy(&format, data, sizeof(LidarTileFormat));
+    int numPoints = (dataLen - sizeof(LidarTileFormat)) / sizeof(LidarPoint);
+    const LidarPoint *points = (const LidarPoint *)((const char *)data + sizeof(LidarTileFormat));
+    if (numPoints == 0)
+        return false;
+
+    // laszip wants to write to a file, so we'll give it one
+    std::string tempName = LAZTempDir + "/tile_" + std::to_string(LAZTempCount++) + ".laz";
+
+    laszip_POINTER lazWriter;
+    laszip_create(&lazWriter);
+    laszip_header_struct *header;
+    laszip_get_header_pointer(lazWriter,&header);
+    header->version_major = 1;
+    header->version_minor = 2;
+    header->header_size = 227;
+    header->offset_to_point_data = 227;
+    header->point_data_format = format.hasColors ? 2 : 0;
+    header->point_data_record_length = format.hasColors ? 26 : 20;
+    header->number_of_point_records = numPoints;
+    header->x_scale_factor = format.scaleX;
+    header->y_scale_factor = format.scaleY;
+    header->z_scale_factor = format.scaleZ;
+    header->min_x = DBL_MAX;  header->min_y = DBL_MAX;  header->min_z = DBL_MAX;
+    header->max_x = -DBL_MAX;  header->max_y = -DBL_MAX;  header->max_z = -DBL_MAX;
+    for (int ii=0;ii<numPoints;ii++)
+    {
+        const LidarPoint &pt = points[ii];
+        header->min_x = std::min(header->min_x,pt.x);  header->max_x = std::max(header->max_x,pt.x);
+        header->min_y = std::min(header->min_y,pt.y);  header->max_y = std::max(header->max_y,pt.y);
+        header->min_z = std::min(header->min_z,pt.z);  header->max_z = std::max(header->max_z,pt.z);
+    }
+    // Offsets at the corner of the tile keep the integers small
+    header->x_offset = header->min_x;
+    header->y_offset = header->min_y;
+    header->z_offset = header->min_z;
+
+    bool ok = !laszip_open_writer(lazWriter,tempName.c_str(),true);
+    if (ok)
+    {
+        laszip_point_struct *p;
+        laszip_get_point_pointer(lazWriter,&p);
+        for (int ii=0;ii<numPoints && ok;ii++)
+        {
+            const LidarPoint &pt = points[ii];
+            p->X = (laszip_I32)floor((pt.x - header->x_offset) / header->x_scale_factor + 0.5);
+            p->Y = (laszip_I32)floor((pt.y - header->y_offset) / header->y_scale_factor + 0.5);
+            p->Z = (laszip_I32)floor((pt.z - header->z_offset) / header->z_scale_factor + 0.5);
+            p->intensity = pt.intensity;
+            p->classification = pt.classification;
+            p->rgb[0] = pt.rgb[0];  p->rgb[1] = pt.rgb[1];  p->rgb[2] = pt.rgb[2];
+            ok = !laszip_write_point(lazWriter);
+        }
+        laszip_close_writer(lazWriter);
+    }
+    laszip_destroy(lazWriter);
+
+    // Now read it back in
+    *retData = NULL;
+    retDataLen = 0;
+    FILE *fp = ok ? fopen(tempName.c_str(),"rb") : NULL;
+    if (fp)
+    {
+        fseek(fp, 0, SEEK_END);
+        retDataLen = (int)ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        *retData = malloc(retDataLen);
+        ok = retDataLen > 0 && fread(*retData, 1, retDataLen, fp) == (size_t)retDataLen;
+        fclose(fp);
+    } else
+        ok = false;
+    remove(tempName.c_str());
+    if (!ok && *retData)
+    {
+        free(*retData);
+        *retData = NULL;
+    }
+
+    return ok;
+}
+
+LidarPyramid::LidarPyramid(double minX,double minY,double maxX,double maxY,int maxLevel,int tilePoints,long long maxMemoryPoints,const std::string &tempDir,int numThreads,TileDBWriter *writer,int tableID,const LidarTileFormat &format)
+: numTiles(0), minTilePoints(INT_MAX), maxTilePoints(0), minZ(DBL_MAX), maxZ(-DBL_MAX),
+    minX(minX), minY(minY), maxX(maxX), maxY(maxY), maxLevel(maxLevel), tilePoints(std::max(tilePoints,1)),
+    maxMemoryPoints(std::max(maxMemoryPoints,(long long)tilePoints)), tempDir(tempDir), numThreads(std::max(numThreads,1)),
+    writer(writer), tableID(tableID), format(format), failed(false)
+{
+}
+
+bool LidarPyramid::build(LidarPointSource *source)
+{
+    std::vector<LidarPoint> own;
+    if (!processCell(0, 0, 0, source, own, true))
+        return false;
+
+    // Nobody above the top to take points away
+    return writeTile(0, 0, 0, own) && !failed;
+}
+
+void LidarPyramid::cellForPoint(const LidarPoint &pt,int level,int &x,int &y)
+{
+    int numCells = 1<<level;
+    x = (int)floor((pt.x - minX) / (maxX - minX) * numCells);
+    y = (int)floor((pt.y - minY) / (maxY - minY) * numCells);
+    x = std::min(std::max(x,0),numCells-1);
+    y = std::min(std::max(y,0),numCells-1);
+}
+
+std::string LidarPyramid::spillFileName(int level,int x,int y)
+{
+    return tempDir + "/spill_" + std::to_string(level) + "_" + std::to_string(x) + "_" + std::to_string(y) + ".pts";
+}
+
+bool LidarPyramid::processCell(int level,int x,int y,LidarPointSource *source,std::vector<LidarPoint> &own,bool topLevel)
+{
+    long long numPoints = source->numPoints();
+    std::vector<LidarPoint> batch;
+
+    // Small enough to do in memory
+    if (numPoints <= maxMemoryPoints || level >= maxLevel)
+    {
+        if (numPoints > maxMemoryPoints)
+            fprintf(stderr,"Warning: Cell %d: (%d,%d) has %lld points at the bottom level.  Try more levels.\n",level,x,y,numPoints);
+
+        CellPointMap cells;
+        do {
+            if (!source->read(batch, PointBatchSize))
+                return false;
+            for (unsigned int ii=0;ii<batch.size();ii++)
+            {
+                const LidarPoint &pt = batch[ii];
+                if (level >= maxLevel)
+                    own.push_back(pt);
+                else {
+                    int cx,cy;
+                    cellForPoint(pt, maxLevel, cx, cy);
+                    cells[CellXY(cx,cy)].push_back(pt);
+                }
+            }
+        } while (!batch.empty());
+        std::vector<LidarPoint>().swap(batch);
+
+        if (level >= maxLevel)
+            std::sort(own.begin(), own.end());
+        else {
+            for (CellPointMap::iterator it = cells.begin(); it != cells.end(); ++it)
+                std::sort(it->second.begin(), it->second.end());
+            if (!buildSubtree(level, x, y, maxLevel, cells, own))
+                return false;
+        }
+
+        return trimOwn(level, x, y, own);
+    }
+
+    // Too big, so sort it into buckets a few levels down
+    int levelsDown = (int)ceil(log((double)numPoints / maxMemoryPoints) / log(4.0));
+    levelsDown = std::max(1,std::min(levelsDown,std::min(4,maxLevel-level)));
+    int bottomLevel = level + levelsDown;
+    int side = 1<<levelsDown;
+    std::string baseName = tempDir + "/cell_" + std::to_string(level) + "_" + std::to_string(x) + "_" + std::to_string(y);
+    LidarBucketWriter bucketWriter(baseName, side*side, BucketBufferPoints);
+    do {
+        if (!source->read(batch, PointBatchSize))
+            return false;
+        for (unsigned int ii=0;ii<batch.size();ii++)
+        {
+            int cx,cy;
+            cellForPoint(batch[ii], bottomLevel, cx, cy);
+            int bx = std::min(std::max(cx - (x<<levelsDown),0),side-1);
+            int by = std::min(std::max(cy - (y<<levelsDown),0),side-1);
+            if (!bucketWriter.addPoint(by*side+bx, batch[ii]))
+                return false;
+        }
+    } while (!batch.empty());
+    std::vector<LidarPoint>().swap(batch);
+    if (!bucketWriter.finish())
+        return false;
+
+    // Work through the buckets, in parallel if we're at the top
+    std::vector<int> buckets;
+    for (int ii=0;ii<side*side;ii++)
+        if (bucketWriter.count(ii) > 0)
+            buckets.push_back(ii);
+    std::vector<std::vector<LidarPoint> > bucketOwn(buckets.size());
+    std::atomic<int> nextBucket(0);
+    std::atomic<bool> bucketFailed(false);
+    auto processBuckets = [&]()
+    {
+        int which;
+        while (!bucketFailed && (which = nextBucket++) < (int)buckets.size())
+        {
+            int bucket = buckets[which];
+            int cx = (x<<levelsDown) + bucket % side, cy = (y<<levelsDown) + bucket / side;
+            LidarBucketSource bucketSource(bucketWriter.fileName(bucket), bucketWriter.count(bucket), true);
+            if (!processCell(bottomLevel, cx, cy, &bucketSource, bucketOwn[which], false))
+                bucketFailed = true;
+        }
+    };
+    if (topLevel && numThreads > 1)
+    {
+        std::vector<std::thread> threads;
+        for (int ti=0;ti<numThreads;ti++)
+            threads.push_back(std::thread(processBuckets));
+        for (unsigned int ti=0;ti<threads.size();ti++)
+            threads[ti].join();
+    } else
+        processBuckets();
+    if (bucketFailed)
+        return false;
+
+    CellPointMap cells;
+    for (unsigned int ii=0;ii<buckets.size();ii++)
+    {
+        int bucket = buckets[ii];
+        cells[CellXY((x<<levelsDown) + bucket % side,(y<<levelsDown) + bucket / side)].swap(bucketOwn[ii]);
+    }
+    if (!buildSubtree(level, x, y, bottomLevel, cells, own))
+        return false;
+
+    return trimOwn(level, x, y, own);
+}
+
+bool LidarPyramid::buildSubtree(int level,int x,int y,int bottomLevel,CellPointMap &cells,std::vector<LidarPoint> &own)
+{
+    for (int thisLevel = bottomLevel; thisLevel > level; thisLevel--)
+    {
+        // Group the cells by parent
+        std::map<CellXY,std::vector<CellPointMap::iterator> > families;
+        for (CellPointMap::iterator it = cells.begin(); it != cells.end(); ++it)
+            families[CellXY(it->first.first/2,it->first.second/2)].push_back(it);
+
+        CellPointMap parents;
+        for (auto &family : families)
+        {
+            // Children are sorted, so the parent takes the lowest ranks off the front
+            std::vector<CellPointMap::iterator> &children = family.second;
+            std::vector<unsigned int> taken(children.size(),0);
+            std::vector<LidarPoint> &parentPts = parents[family.first];
+            while ((int)parentPts.size() < tilePoints)
+            {
+                int best = -1;
+                for (unsigned int ci=0;ci<children.size();ci++)
+                {
+                    std::vector<LidarPoint> &childPts = children[ci]->second;
+                    if (taken[ci] < childPts.size() && (best < 0 || childPts[taken[ci]].rank < children[best]->second[taken[best]].rank))
+                        best = ci;
+                }
+                if (best < 0)
+                    break;
+                parentPts.push_back(children[best]->second[taken[best]++]);
+            }
+
+            // Whatever's left in the children is theirs
+            for (unsigned int ci=0;ci<children.size();ci++)
+            {
+                std::vector<LidarPoint> &childPts = children[ci]->second;
+                childPts.erase(childPts.begin(), childPts.begin()+taken[ci]);
+                if (!writeTile(thisLevel, children[ci]->first.first, children[ci]->first.second, childPts))
+                    return false;
+                std::vector<LidarPoint>().swap(childPts);
+            }
+        }
+        cells.swap(parents);
+    }
+
+    own.clear();
+    CellPointMap::iterator it = cells.find(CellXY(x,y));
+    if (it != cells.end())
+        own.swap(it->second);
+
+    return true;
+}
+
+bool LidarPyramid::trimOwn(int level,int x,int y,std::vector<LidarPoint> &own)
+{
+    if ((int)own.size() <= tilePoints)
+        return true;
+
+    // Only the front of the list is of any interest to the parent
+    std::string fileName = spillFileName(level, x, y);
+    FILE *fp = fopen(fileName.c_str(),"wb");
+    size_t count = own.size() - tilePoints;
+    if (!fp || fwrite(&own[tilePoints], sizeof(LidarPoint), count, fp) != count)
+    {
+        fprintf(stderr,"Failed to write spill file: %s\n",fileName.c_str());
+        if (fp)
+            fclose(fp);
+        return false;
+    }
+    fclose(fp);
+    own.resize(tilePoints);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    spills[std::make_pair(level,CellXY(x,y))] = count;
+
+    return true;
+}
+
+bool LidarPyramid::writeTile(int level,int x,int y,std::vector<LidarPoint> &points)
+{
+    // Pick up anything we put aside for this cell
+    long long spillCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = spills.find(std::make_pair(level,CellXY(x,y)));
+        if (it != spills.end())
+        {
+            spillCount = it->second;
+            spills.erase(it);
+        }
+    }
+    if (spillCount > 0)
+    {
+        LidarBucketSource spillSource(spillFileName(level, x, y), spillCount, true);
+        std::vector<LidarPoint> batch;
+        do {
+            if (!spillSource.read(batch, PointBatchSize))
+                return false;
+            points.insert(points.end(), batch.begin(), batch.end());
+        } while (!batch.empty());
+    }
+
+    if (points.empty())
+        return true;
+
+    double tileMinZ = DBL_MAX, tileMaxZ = -DBL_MAX;
+    for (unsigned int ii=0;ii<points.size();ii++)
+    {
+        tileMinZ = std::min(tileMinZ,points[ii].z);
+        tileMaxZ = std::max(tileMaxZ,points[ii].z);
+    }
+
+    // The writer's compression threads turn this into LAZ
+    std::vector<unsigned char> rawTile(sizeof(LidarTileFormat) + points.size() * sizeof(LidarPoint));
+    memcpy(&rawTile[0], &format, sizeof(LidarTileFormat));
+    memcpy(&rawTile[sizeof(LidarTileFormat)], &points[0], points.size() * sizeof(LidarPoint));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    numTiles++;
+    minTilePoints = std::min(minTilePoints,(int)points.size());
+    maxTilePoints = std::max(maxTilePoints,(int)points.size());
+    minZ = std::min(minZ,tileMinZ);
+    maxZ = std::max(maxZ,tileMaxZ);
+    if (!writer->addTile(tableID, x, y, level, &rawTile[0], (unsigned int)rawTile.size()))
+    {
+        fprintf(stderr,"Failed to write tile %d: (%d,%d) because:\n%s\n",level,x,y,writer->getError().c_str());
+        failed = true;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,93 @@
+//
+//  LidarPyramid.h
+//  lidar_tile_pyramid
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#ifndef __lidar_tile_pyramid__LidarPyramid__
+#define __lidar_tile_pyramid__LidarPyramid__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include "LidarPoints.h"
+#include "TileDBWriter.h"
+
+/** Shared info about how to encode LAZ tiles.
+  */
+class LidarTileFormat
+{
+public:
+    double scaleX,scaleY,scaleZ;
+    bool hasColors;
+};
+
+// Turn a raw tile (a LidarTileFormat followed by LidarPoints) into a LAZ file in memory.
+// This is the compression routine we hand to the TileDBWriter, so it runs on its threads.
+bool EncodeLAZTile(void *data,int dataLen,void **retData,int &retDataLen);
+
+// LAZ encoding goes through a temp file, which lives here
+void SetLAZTempDir(const std::string &tempDir);
+
+/** The Lidar Pyramid sorts an arbitrarily large point cloud into a quad tree of tiles.
+    Each point shows up in exactly one tile.  A tile gets the lowest ranked points
+    of everything underneath it, up to the tile size, and the rest go further down.
+    The bottom level gets whatever's left.
+    Points are sorted into bucket files on disk until a cell fits in memory.
+  */
+class LidarPyramid
+{
+public:
+    LidarPyramid(double minX,double minY,double maxX,double maxY,int maxLevel,int tilePoints,long long maxMemoryPoints,const std::string &tempDir,int numThreads,TileDBWriter *writer,int tableID,const LidarTileFormat &format);
+
+    // Build the whole pyramid from the given points
+    bool build(LidarPointSource *source);
+
+    // Filled in as we go
+    int numTiles;
+    int minTilePoints,maxTilePoints;
+    double minZ,maxZ;
+
+protected:
+    typedef std::pair<int,int> CellXY;
+    typedef std::map<CellXY,std::vector<LidarPoint> > CellPointMap;
+
+    // Sort out the points for a single cell and everything underneath it.
+    // Writes all the tiles below and returns the points that belong to the cell itself (sorted by rank).
+    bool processCell(int level,int x,int y,LidarPointSource *source,std::vector<LidarPoint> &own,bool topLevel);
+
+    // Work up from the cells at bottomLevel to the one at level, picking points for each level on the way
+    bool buildSubtree(int level,int x,int y,int bottomLevel,CellPointMap &cells,std::vector<LidarPoint> &own);
+
+    // Hang on to just the points a parent could want and spill the rest to disk
+    bool trimOwn(int level,int x,int y,std::vector<LidarPoint> &own);
+
+    // Which cell a point falls into at a given level
+    void cellForPoint(const LidarPoint &pt,int level,int &x,int &y);
+
+    // Encode and write a tile, along with anything we spilled earlier
+    bool writeTile(int level,int x,int y,std::vector<LidarPoint> &points);
+
+    std::string spillFileName(int level,int x,int y);
+
+    double minX,minY,maxX,maxY;
+    int maxLevel;
+    int tilePoints;
+    long long maxMemoryPoints;
+    std::string tempDir;
+    int numThreads;
+    TileDBWriter *writer;
+    int tableID;
+    LidarTileFormat format;
+
+    // Cells we've spilled extra points for, and how many
+    std::map<std::pair<int,CellXY>,long long> spills;
+    // Protects the writer, the spills and the counters
+    std::mutex mutex;
+    bool failed;
+};
+
+#endif /* defined(__lidar_tile_pyramid__LidarPyramid__) */
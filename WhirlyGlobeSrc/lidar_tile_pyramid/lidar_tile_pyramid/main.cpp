@@ -0,0 +1,285 @@
+//
+//  main.cpp
+//  lidar_tile_pyramid
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include "KompexSQLitePrerequisites.h"
+#include "KompexSQLiteDatabase.h"
+#include "KompexSQLiteStatement.h"
+#include "KompexSQLiteException.h"
+#include "TileDBWriter.h"
+#include "LidarPoints.h"
+#include "LidarPyramid.h"
+
+// Set up the tables MaplyLAZQuadReader is expecting
+bool SetupDatabase(Kompex::SQLiteDatabase *db)
+{
+    try {
+        Kompex::SQLiteStatement stmt(db);
+        stmt.SqlStatement((std::string)"CREATE TABLE manifest (minx REAL, miny REAL, minz REAL, maxx REAL, maxy REAL, maxz REAL, minlevel INTEGER, maxlevel INTEGER, minpoints INTEGER, maxpoints INTEGER, srs TEXT, pointtype INTEGER, maxcolor INTEGER);");
+        stmt.SqlStatement((std::string)"CREATE TABLE lidartiles (data BLOB,level INTEGER,x INTEGER,y INTEGER,quadindex INTEGER PRIMARY KEY);");
+    }
+    catch (Kompex::SQLiteException &exc)
+    {
+        fprintf(stderr,"Failed to set up database because:\n%s\n",exc.GetString().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Fill in the manifest once we know what we've got
+bool WriteManifest(Kompex::SQLiteDatabase *db,LidarFileSource &source,LidarPyramid &pyramid,int maxLevel,const char *srs,int pointType)
+{
+    try {
+        Kompex::SQLiteStatement stmt(db);
+        stmt.Sql("INSERT INTO manifest (minx,miny,minz,maxx,maxy,maxz,minlevel,maxlevel,minpoints,maxpoints,srs,pointtype,maxcolor) VALUES (@minx,@miny,@minz,@maxx,@maxy,@maxz,@minlevel,@maxlevel,@minpoints,@maxpoints,@srs,@pointtype,@maxcolor);");
+        stmt.BindDouble(1, source.minX);
+        stmt.BindDouble(2, source.minY);
+        stmt.BindDouble(3, pyramid.numTiles > 0 ? pyramid.minZ : source.minZ);
+        stmt.BindDouble(4, source.maxX);
+        stmt.BindDouble(5, source.maxY);
+        stmt.BindDouble(6, pyramid.numTiles > 0 ? pyramid.maxZ : source.maxZ);
+        stmt.BindInt(7, 0);
+        stmt.BindInt(8, maxLevel);
+        stmt.BindInt(9, pyramid.numTiles > 0 ? pyramid.minTilePoints : 0);
+        stmt.BindInt(10, pyramid.maxTilePoints);
+        stmt.BindString(11, srs ? srs : "");
+        stmt.BindInt(12, pointType);
+        stmt.BindInt(13, source.maxColor);
+        stmt.Execute();
+        stmt.FreeQuery();
+    }
+    catch (Kompex::SQLiteException &exc)
+    {
+        fprintf(stderr,"Failed to write manifest because:\n%s\n",exc.GetString().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char * argv[])
+{
+    const char *targetDb = NULL;
+    const char *srs = NULL;
+    const char *tempDir = NULL;
+    int levels = 0;
+    int tilePoints = 16384;
+    int memoryMB = 1024;
+    int numThreads = std::thread::hardware_concurrency();
+    int dbBatchSize = 1000;
+    std::vector<std::string> inputFiles;
+
+    int numArgs = 1;
+    for (int ii=1;ii<argc;ii+=numArgs)
+    {
+        numArgs = 1;
+        if (!strcmp(argv[ii],"-targetdb"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting one argument for -targetdb\n");
+                return -1;
+            }
+            targetDb = argv[ii+1];
+        } else if (!strcmp(argv[ii],"-srs"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting one argument for -srs\n");
+                return -1;
+            }
+            srs = argv[ii+1];
+        } else if (!strcmp(argv[ii],"-tmpdir"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting one argument for -tmpdir\n");
+                return -1;
+            }
+            tempDir = argv[ii+1];
+        } else if (!strcmp(argv[ii],"-levels"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting one argument for -levels\n");
+                return -1;
+            }
+            levels = atoi(argv[ii+1]);
+            if (levels < 1)
+            {
+                fprintf(stderr,"Expecting at least one level for -levels\n");
+                return -1;
+            }
+        } else if (!strcmp(argv[ii],"-tilepoints"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting one argument for -tilepoints\n");
+                return -1;
+            }
+            tilePoints = atoi(argv[ii+1]);
+            if (tilePoints < 1)
+            {
+                fprintf(stderr,"Expecting at least one point for -tilepoints\n");
+                return -1;
+            }
+        } else if (!strcmp(argv[ii],"-memory"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting one argument for -memory\n");
+                return -1;
+            }
+            memoryMB = atoi(argv[ii+1]);
+            if (memoryMB < 1)
+            {
+                fprintf(stderr,"Expecting at least one megabyte for -memory\n");
+                return -1;
+            }
+        } else if (!strcmp(argv[ii],"-threads"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting one argument for -threads\n");
+                return -1;
+            }
+            numThreads = atoi(argv[ii+1]);
+            if (numThreads < 1)
+            {
+                fprintf(stderr,"Expecting at least one thread for -threads\n");
+                return -1;
+            }
+        } else if (!strcmp(argv[ii],"-dbbatch"))
+        {
+            numArgs = 2;
+            if (ii+numArgs > argc)
+            {
+                fprintf(stderr,"Expecting one argument for -dbbatch\n");
+                return -1;
+            }
+            dbBatchSize = atoi(argv[ii+1]);
+            if (dbBatchSize < 1)
+            {
+                fprintf(stderr,"Expecting at least one tile for -dbbatch\n");
+                return -1;
+            }
+        } else if (argv[ii][0] == '-')
+        {
+            fprintf(stderr,"Unknown option: %s\n",argv[ii]);
+            return -1;
+        } else
+            inputFiles.push_back(argv[ii]);
+    }
+    numThreads = std::max(1,numThreads);
+
+    if (!targetDb || inputFiles.empty())
+    {
+        fprintf(stderr,"%s: -targetdb out.sqlite [-srs proj4] [-levels n] [-tilepoints n] [-memory MB] [-threads n] [-tmpdir dir] [-dbbatch n] in.laz ...\n",argv[0]);
+        return -1;
+    }
+
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    // Extents and counts come from the headers
+    LidarFileSource source(inputFiles);
+    if (!source.scanHeaders())
+        return -1;
+    if (source.numPoints() == 0)
+    {
+        fprintf(stderr,"No points in the input files.\n");
+        return -1;
+    }
+    if (source.maxX <= source.minX)
+        source.maxX = source.minX + 1.0;
+    if (source.maxY <= source.minY)
+        source.maxY = source.minY + 1.0;
+
+    // Deep enough that the bottom tiles are about the size of the rest
+    int maxLevel = levels-1;
+    if (levels == 0)
+        maxLevel = std::max(0,(int)ceil(log((double)source.numPoints() / tilePoints) / log(4.0)));
+    fprintf(stdout,"%lld points in %d file(s), building levels 0 through %d\n",source.numPoints(),(int)inputFiles.size(),maxLevel);
+
+    // Each thread works on its own cell, so split the memory between them.
+    // Sorting into cells takes about twice the space of the points themselves.
+    long long maxMemoryPoints = (long long)memoryMB * 1024 * 1024 / (2 * sizeof(LidarPoint) * numThreads);
+
+    std::string tempDirStr = tempDir ? tempDir : (std::string)targetDb + "_tmp";
+    mkdir(tempDirStr.c_str(),S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    SetLAZTempDir(tempDirStr);
+
+    remove(targetDb);
+    Kompex::SQLiteDatabase *sqliteDb = new Kompex::SQLiteDatabase(targetDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0);
+    if (!sqliteDb->GetDatabaseHandle())
+    {
+        fprintf(stderr, "Invalid sqlite database: %s\n",targetDb);
+        return -1;
+    }
+    if (!SetupDatabase(sqliteDb))
+        return -1;
+
+    // Tiles are encoded to LAZ on the writer's threads
+    TileDBWriter::tuneForBulkLoad(sqliteDb);
+    TileDBWriter *writer = new TileDBWriter(sqliteDb,EncodeLAZTile,numThreads,dbBatchSize);
+    int tableID = writer->addTable("lidartiles");
+    if (tableID < 0)
+    {
+        fprintf(stderr,"%s\n",writer->getError().c_str());
+        return -1;
+    }
+
+    LidarTileFormat format;
+    format.scaleX = source.scaleX;  format.scaleY = source.scaleY;  format.scaleZ = source.scaleZ;
+    format.hasColors = source.hasColors;
+    LidarPyramid pyramid(source.minX,source.minY,source.maxX,source.maxY,maxLevel,tilePoints,maxMemoryPoints,tempDirStr,numThreads,writer,tableID,format);
+    if (!pyramid.build(&source))
+    {
+        fprintf(stderr,"Failed to build point cloud pyramid.\n");
+        return -1;
+    }
+
+    printf("Flushing database...");  fflush(stdout);
+    if (!writer->flush())
+    {
+        fprintf(stderr,"Failed to write tiles because:\n%s\n",writer->getError().c_str());
+        return -1;
+    }
+    writer->printStats(stdout);
+    delete writer;
+    if (!WriteManifest(sqliteDb, source, pyramid, maxLevel, srs, format.hasColors ? 2 : 0))
+        return -1;
+    TileDBWriter::finishBulkLoad(sqliteDb);
+    sqliteDb->Close();
+    delete sqliteDb;
+    if (!tempDir)
+        rmdir(tempDirStr.c_str());
+    printf("done\n");
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    fprintf(stdout,"%d tiles, %d to %d points per tile, %.1fs: %.1f points/sec\n",pyramid.numTiles,pyramid.minTilePoints,pyramid.maxTilePoints,secs,source.numPoints()/secs);
+
+    return 0;
+}
@@ -0,0 +1,293 @@
+//
+//  TileDBWriter.cpp
+//  tile_db_writer
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include "TileDBWriter.h"
+#include <stdlib.h>
+#include "sqlite3.h"
+#include "QuadKey.h"
+
+using namespace Kompex;
+
+TileDBWriter::TileDBWriter(Kompex::SQLiteDatabase *db,CompressFunc compress,int numThreads,int batchSize)
+: db(db), compress(compress), batchSize(std::max(batchSize,1)), nextSeq(0), nextWrite(0), shutdown(false),
+    inTransaction(false), tilesInTransaction(0), compressMicros(0), started(false)
+{
+    if (!compress)
+        numThreads = 0;
+    // Enough to keep everyone busy without piling up too much data
+    maxPending = std::max(4*numThreads,1);
+    for (int ii=0;ii<numThreads;ii++)
+        threads.push_back(std::thread(&TileDBWriter::compressThread,this));
+}
+
+TileDBWriter::~TileDBWriter()
+{
+    flush();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutdown = true;
+    }
+    workReady.notify_all();
+    for (unsigned int ii=0;ii<threads.size();ii++)
+        threads[ii].join();
+
+    for (unsigned int ii=0;ii<insertStmts.size();ii++)
+        delete insertStmts[ii];
+}
+
+// Run a statement directly, ignoring any rows it returns
+static bool ExecSql(Kompex::SQLiteDatabase *db,const char *sql)
+{
+    char *errMsg = NULL;
+    if (sqlite3_exec(db->GetDatabaseHandle(), sql, NULL, NULL, &errMsg) != SQLITE_OK)
+    {
+        fprintf(stderr,"Failed to run (%s) because:\n%s\n",sql,(errMsg ? errMsg : ""));
+        sqlite3_free(errMsg);
+        return false;
+    }
+
+    return true;
+}
+
+bool TileDBWriter::tuneForBulkLoad(Kompex::SQLiteDatabase *db)
+{
+    // If we die halfway through, the database is junk anyway
+    return ExecSql(db, "PRAGMA journal_mode=WAL;") && ExecSql(db, "PRAGMA synchronous=OFF;");
+}
+
+bool TileDBWriter::finishBulkLoad(Kompex::SQLiteDatabase *db)
+{
+    // The devices open these read only, so we don't want a WAL file hanging around
+    return ExecSql(db, "PRAGMA wal_checkpoint(TRUNCATE);") && ExecSql(db, "PRAGMA journal_mode=DELETE;") && ExecSql(db, "PRAGMA synchronous=FULL;");
+}
+
+int TileDBWriter::addTable(const std::string &tableName)
+{
+    SQLiteStatement *stmt = new SQLiteStatement(db);
+    try {
+        stmt->Sql((std::string)"INSERT OR REPLACE INTO " + tableName + " (data,level,x,y,quadindex) VALUES (@data,@level,@x,@y,@quadindex);");
+    }
+    catch (SQLiteException &exc)
+    {
+        error = (std::string)"Failed to set up insert for " + tableName + ":\n" + exc.GetString();
+        delete stmt;
+        return -1;
+    }
+    insertStmts.push_back(stmt);
+
+    return (int)insertStmts.size()-1;
+}
+
+bool TileDBWriter::addTile(int tableID,int x,int y,int level,const void *data,unsigned int dataLen)
+{
+    if (!error.empty())
+        return false;
+    if (!started)
+    {
+        started = true;
+        startTime = std::chrono::steady_clock::now();
+    }
+
+    Tile *tile = new Tile();
+    tile->table = tableID;
+    tile->x = x;  tile->y = y;  tile->level = level;
+    if (data && dataLen > 0)
+        tile->data.assign((const unsigned char *)data,(const unsigned char *)data+dataLen);
+
+    if (threads.empty())
+    {
+        // Nobody to hand it off to
+        compressTile(tile);
+        std::lock_guard<std::mutex> lock(mutex);
+        compressed[nextSeq++] = tile;
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            toCompress.push_back(std::make_pair(nextSeq++,tile));
+        }
+        workReady.notify_one();
+    }
+
+    return writeReady(false);
+}
+
+bool TileDBWriter::flush()
+{
+    return writeReady(true) && commit();
+}
+
+void TileDBWriter::compressThread()
+{
+    while (true)
+    {
+        std::pair<unsigned long,Tile *> work;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workReady.wait(lock, [&]{ return shutdown || !toCompress.empty(); });
+            if (toCompress.empty())
+                return;
+            work = toCompress.front();
+            toCompress.pop_front();
+        }
+
+        compressTile(work.second);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            compressed[work.first] = work.second;
+        }
+        tileDone.notify_one();
+    }
+}
+
+void TileDBWriter::compressTile(Tile *tile)
+{
+    if (!compress || tile->data.empty())
+        return;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!compress((void *)&tile->data[0], (int)tile->data.size(), &tile->compressed, tile->compressedLen))
+        tile->failed = true;
+    compressMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool TileDBWriter::writeReady(bool wait)
+{
+    while (true)
+    {
+        Tile *tile = NULL;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (nextWrite == nextSeq)
+                return error.empty();
+            // We also wait if the compression threads have too much on their plate
+            if (wait || nextSeq - nextWrite > maxPending)
+                tileDone.wait(lock, [&]{ return compressed.find(nextWrite) != compressed.end(); });
+            std::map<unsigned long,Tile *>::iterator it = compressed.find(nextWrite);
+            if (it == compressed.end())
+                return error.empty();
+            tile = it->second;
+            compressed.erase(it);
+            nextWrite++;
+        }
+
+        bool ok = error.empty() && writeTile(tile);
+        if (tile->compressed)
+            free(tile->compressed);
+        delete tile;
+        if (!ok)
+            return false;
+    }
+}
+
+bool TileDBWriter::writeTile(Tile *tile)
+{
+    if (tile->failed)
+    {
+        error = "Tile compression failed for " + std::to_string(tile->level) + ": (" + std::to_string(tile->x) + "," + std::to_string(tile->y) + ")";
+        return false;
+    }
+    if (tile->table < 0 || (size_t)tile->table >= insertStmts.size() || !insertStmts[tile->table])
+    {
+        error = "Tile written to unknown table";
+        return false;
+    }
+
+    // Calculate a quad index for later use
+    long long quadIndex = WhirlyKit::QuadKey(tile->x,tile->y,tile->level).quadIndex();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try {
+        if (!inTransaction)
+        {
+            SQLiteStatement transactStmt(db);
+            transactStmt.SqlStatement((std::string)"BEGIN TRANSACTION");
+            inTransaction = true;
+            tilesInTransaction = 0;
+        }
+
+        SQLiteStatement *insertStmt = insertStmts[tile->table];
+        const void *data = NULL;
+        int dataLen = 0;
+        if (tile->compressed)
+        {
+            data = tile->compressed;
+            dataLen = tile->compressedLen;
+        } else if (!tile->data.empty())
+        {
+            data = &tile->data[0];
+            dataLen = (int)tile->data.size();
+        }
+        insertStmt->BindBlob(1, data, dataLen);
+        insertStmt->BindInt(2, tile->level);
+        insertStmt->BindInt(3, tile->x);
+        insertStmt->BindInt(4, tile->y);
+        insertStmt->BindInt64(5, quadIndex);
+        insertStmt->Execute();
+        insertStmt->Reset();
+
+        stats.tiles++;
+        if (dataLen == 0)
+            stats.emptyTiles++;
+        stats.bytesIn += tile->data.size();
+        stats.bytesOut += dataLen;
+    }
+    catch (SQLiteException &exc)
+    {
+        error = (std::string)"Failed to write blob to database:\n" + exc.GetString();
+        return false;
+    }
+    stats.insertSecs += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (++tilesInTransaction >= batchSize)
+        return commit();
+
+    return true;
+}
+
+bool TileDBWriter::commit()
+{
+    if (!inTransaction)
+        return error.empty();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try {
+        SQLiteStatement transactStmt(db);
+        transactStmt.SqlStatement((std::string)"COMMIT TRANSACTION");
+    }
+    catch (SQLiteException &exc)
+    {
+        error = (std::string)"Failed to commit tiles to database:\n" + exc.GetString();
+        return false;
+    }
+    inTransaction = false;
+    stats.transactions++;
+    stats.insertSecs += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return error.empty();
+}
+
+TileDBWriter::Stats TileDBWriter::getStats()
+{
+    Stats ret = stats;
+    ret.compressSecs = compressMicros / 1e6;
+    if (started)
+        ret.totalSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    return ret;
+}
+
+void TileDBWriter::printStats(FILE *fp)
+{
+    Stats theStats = getStats();
+    double secs = std::max(theStats.totalSecs,1e-6);
+    fprintf(fp,"Tile DB: %lu tiles (%lu empty) in %lu transactions, %.1f tiles/s\n",theStats.tiles,theStats.emptyTiles,theStats.transactions,theStats.tiles/secs);
+    fprintf(fp,"  %.1f MB in, %.1f MB stored, %.1f MB/s in\n",theStats.bytesIn/(1024.0*1024.0),theStats.bytesOut/(1024.0*1024.0),theStats.bytesIn/(1024.0*1024.0)/secs);
+    fprintf(fp,"  compress %.2fs (all threads), insert %.2fs, total %.2fs\n",theStats.compressSecs,theStats.insertSecs,theStats.totalSecs);
+}
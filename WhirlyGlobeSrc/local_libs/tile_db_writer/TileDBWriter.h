@@ -0,0 +1,133 @@
+//
+//  TileDBWriter.h
+//  tile_db_writer
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#ifndef __tile_db_writer__TileDBWriter__
+#define __tile_db_writer__TileDBWriter__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include "KompexSQLitePrerequisites.h"
+#include "KompexSQLiteDatabase.h"
+#include "KompexSQLiteStatement.h"
+#include "KompexSQLiteException.h"
+
+/** The Tile DB Writer is shared by the offline tools that build tile databases.
+    Tiles are compressed on a pool of threads and inserted in batches, each batch
+    in its own transaction.  All the sqlite calls happen on the thread calling in,
+    and tiles are inserted in the order they were added.
+    Tables need (data BLOB,level INTEGER,x INTEGER,y INTEGER,quadindex INTEGER PRIMARY KEY).
+    A tile replaces any existing one with the same quad index, which is what update runs want.
+  */
+class TileDBWriter
+{
+public:
+    // Compression routine.  Allocates the result with malloc().
+    typedef bool (*CompressFunc)(void *data,int dataLen,void **retData,int &retDataLen);
+
+    // Counters for the tiles we've written so far
+    class Stats
+    {
+    public:
+        Stats() : tiles(0), emptyTiles(0), bytesIn(0), bytesOut(0), transactions(0), compressSecs(0.0), insertSecs(0.0), totalSecs(0.0) { }
+
+        unsigned long tiles,emptyTiles;
+        unsigned long long bytesIn,bytesOut;
+        unsigned long transactions;
+        // Compression time is summed over all the threads
+        double compressSecs,insertSecs;
+        // Since the first tile came in
+        double totalSecs;
+    };
+
+    // Pass in NULL for compress to store the data as is.
+    // With zero threads compression happens inline.
+    TileDBWriter(Kompex::SQLiteDatabase *db,CompressFunc compress,int numThreads,int batchSize);
+    ~TileDBWriter();
+
+    // Switch the database over to WAL and relax syncing.  Good for building a database from scratch.
+    static bool tuneForBulkLoad(Kompex::SQLiteDatabase *db);
+    // Checkpoint the WAL and go back to a single file database
+    static bool finishBulkLoad(Kompex::SQLiteDatabase *db);
+
+    // Set up the insert for a given table.  Returns the ID to use with addTile().
+    int addTable(const std::string &tableName);
+
+    // Queue a tile for writing.  We copy the data.  No data means an empty blob, which isn't compressed.
+    // Blocks if too many tiles are waiting.  Returns false if an earlier write failed.
+    bool addTile(int tableID,int x,int y,int level,const void *data,unsigned int dataLen);
+
+    // Write everything that's queued and commit it
+    bool flush();
+
+    // Check this after flush() or addTile() returns false
+    const std::string &getError() { return error; }
+
+    Stats getStats();
+    // Print the counters in a human readable form
+    void printStats(FILE *fp);
+
+protected:
+    // A tile on its way through the pipeline
+    class Tile
+    {
+    public:
+        Tile() : table(0), x(0), y(0), level(0), compressed(NULL), compressedLen(0), failed(false) { }
+
+        int table;
+        int x,y,level;
+        std::vector<unsigned char> data;
+        void *compressed;
+        int compressedLen;
+        bool failed;
+    };
+
+    // Compression thread main loop
+    void compressThread();
+    // Compress a tile in place
+    void compressTile(Tile *tile);
+    // Insert whatever finished tiles are next in line.  Waits for all of them if wait is set.
+    bool writeReady(bool wait);
+    // Insert a single tile, starting and ending transactions as needed
+    bool writeTile(Tile *tile);
+    bool commit();
+
+    Kompex::SQLiteDatabase *db;
+    CompressFunc compress;
+    int batchSize;
+    std::vector<Kompex::SQLiteStatement *> insertStmts;
+
+    // Tiles waiting for compression and the ones done, by sequence number
+    std::mutex mutex;
+    std::condition_variable workReady,tileDone;
+    std::deque<std::pair<unsigned long,Tile *> > toCompress;
+    std::map<unsigned long,Tile *> compressed;
+    unsigned long nextSeq,nextWrite;
+    unsigned int maxPending;
+    bool shutdown;
+    std::vector<std::thread> threads;
+
+    // Current transaction
+    bool inTransaction;
+    int tilesInTransaction;
+
+    std::string error;
+    Stats stats;
+    std::atomic<long long> compressMicros;
+    bool started;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+#endif /* defined(__tile_db_writer__TileDBWriter__) */
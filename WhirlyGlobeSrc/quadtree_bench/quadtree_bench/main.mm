@@ -0,0 +1,462 @@
+//
+//  main.mm
+//  quadtree_bench
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <stdio.h>
+#import <string.h>
+#import <stdlib.h>
+#import <math.h>
+#import <vector>
+#import <deque>
+#import <chrono>
+#import <algorithm>
+#import "Quadtree.h"
+
+using namespace WhirlyKit;
+
+// Importance is the screen area of a tile, looking straight down at the unit square
+@interface QuadBenchImportance : NSObject<WhirlyKitQuadTreeImportanceDelegate>
+@property (nonatomic) double viewX,viewY,viewHeight;
+@end
+
+@implementation QuadBenchImportance
+
+- (double)importanceForTile:(WhirlyKit::Quadtree::Identifier)ident mbr:(WhirlyKit::Mbr)mbr tree:(WhirlyKit::Quadtree *)tree attrs:(NSMutableDictionary *)attrs
+{
+    // Cache something per tile, like the screen importance code does
+    NSNumber *tileSize = attrs[@"tileSize"];
+    if (!tileSize)
+    {
+        tileSize = @(mbr.ur().x() - mbr.ll().x());
+        attrs[@"tileSize"] = tileSize;
+    }
+
+    double dx = std::max(0.0,std::max(mbr.ll().x() - _viewX,_viewX - mbr.ur().x()));
+    double dy = std::max(0.0,std::max(mbr.ll().y() - _viewY,_viewY - mbr.ur().y()));
+    // Off the edge of the view
+    if (dx*dx + dy*dy > 4.0*_viewHeight*_viewHeight)
+        return 0.0;
+
+    double pixels = [tileSize doubleValue] / sqrt(dx*dx + dy*dy + _viewHeight*_viewHeight) * 512.0;
+    return pixels*pixels;
+}
+
+@end
+
+// Quad tree setup shared by the recording and the replay
+class TraceParams
+{
+public:
+    TraceParams() : maxLevel(20), maxTiles(256), minImportance(256*256) { }
+
+    int maxLevel;
+    int maxTiles;
+    float minImportance;
+};
+
+// A single call into the quad tree
+class TraceOp
+{
+public:
+    TraceOp() : type(0), level(0), x(0), y(0), arg0(0), arg1(0), viewX(0.0), viewY(0.0), viewHeight(0.0) { }
+
+    // v: view change, a: addTile, e: popLastEval, s: shouldLoadTile, p: setPhantom, l: setLoading,
+    // d: didLoad, u: leastImportantNode, r: removeTile, f: didFail, g: getNodeInfo, n: isFull
+    char type;
+    int level,x,y;
+    int arg0,arg1;
+    double viewX,viewY,viewHeight;
+};
+
+/** Forwards calls to a quad tree and records them as it goes.
+    The simulation talks to this instead of the tree.
+  */
+class RecordingQuadtree
+{
+public:
+    RecordingQuadtree(Quadtree *tree,QuadBenchImportance *importance,std::vector<TraceOp> &ops)
+    : tree(tree), importance(importance), ops(ops) { }
+
+    void setView(double viewX,double viewY,double viewHeight)
+    {
+        TraceOp op;
+        op.type = 'v';  op.viewX = viewX;  op.viewY = viewY;  op.viewHeight = viewHeight;
+        ops.push_back(op);
+        importance.viewX = viewX;  importance.viewY = viewY;  importance.viewHeight = viewHeight;
+        tree->clearEvals();
+        tree->reevaluateNodes();
+    }
+    void addTile(const Quadtree::Identifier &ident,bool newEval,bool checkImportance)
+    {
+        record('a',ident,newEval,checkImportance);
+        std::vector<Quadtree::Identifier> newlyCovered;
+        tree->addTile(ident,newEval,checkImportance,newlyCovered);
+    }
+    bool popLastEval(Quadtree::NodeInfo &nodeInfo)
+    {
+        record('e',Quadtree::Identifier(0,0,0));
+        return tree->popLastEval(nodeInfo);
+    }
+    bool shouldLoadTile(const Quadtree::Identifier &ident,int frame)
+    {
+        record('s',ident,frame);
+        return tree->shouldLoadTile(ident,frame);
+    }
+    void setPhantom(const Quadtree::Identifier &ident,bool newPhantom)
+    {
+        record('p',ident,newPhantom);
+        tree->setPhantom(ident,newPhantom);
+    }
+    void setLoading(const Quadtree::Identifier &ident,int frame,bool newLoading)
+    {
+        record('l',ident,frame,newLoading);
+        tree->setLoading(ident,frame,newLoading);
+    }
+    void didLoad(const Quadtree::Identifier &ident,int frame)
+    {
+        record('d',ident,frame);
+        tree->didLoad(ident,frame);
+    }
+    bool leastImportantNode(Quadtree::NodeInfo &nodeInfo,bool force)
+    {
+        record('u',Quadtree::Identifier(0,0,0),force);
+        return tree->leastImportantNode(nodeInfo,force);
+    }
+    void removeTile(const Quadtree::Identifier &ident)
+    {
+        record('r',ident);
+        tree->removeTile(ident);
+    }
+    bool didFail(const Quadtree::Identifier &ident)
+    {
+        record('f',ident);
+        return tree->didFail(ident);
+    }
+    const Quadtree::NodeInfo *getNodeInfo(const Quadtree::Identifier &ident)
+    {
+        record('g',ident);
+        return tree->getNodeInfo(ident);
+    }
+    bool isFull()
+    {
+        record('n',Quadtree::Identifier(0,0,0));
+        return tree->isFull();
+    }
+
+protected:
+    void record(char type,const Quadtree::Identifier &ident,int arg0=0,int arg1=0)
+    {
+        TraceOp op;
+        op.type = type;  op.level = ident.level;  op.x = ident.x;  op.y = ident.y;
+        op.arg0 = arg0;  op.arg1 = arg1;
+        ops.push_back(op);
+    }
+
+    Quadtree *tree;
+    QuadBenchImportance *importance;
+    std::vector<TraceOp> &ops;
+};
+
+// Fly down from the whole area to a small patch and wander around, driving the quad tree
+// the same way QuadDisplayLayer does.  Tiles take a few frames to load.
+void SimulateFlight(const TraceParams &params,int numFrames,std::vector<TraceOp> &ops)
+{
+    QuadBenchImportance *importance = [[QuadBenchImportance alloc] init];
+    Quadtree tree(Mbr(Point2f(0.0,0.0),Point2f(1.0,1.0)),0,params.maxLevel,params.maxTiles,params.minImportance,importance);
+    RecordingQuadtree rec(&tree,importance,ops);
+
+    const int ViewEvery = 4;
+    const int LoadsPerFrame = 8;
+    std::deque<Quadtree::Identifier> loading;
+    for (int frame=0;frame<numFrames;frame++)
+    {
+        if (frame % ViewEvery == 0)
+        {
+            double t = frame / (double)std::max(numFrames-1,1);
+            double viewHeight = pow(0.0005,std::min(1.0,2.0*t));
+            rec.setView(0.5 + 0.3*sin(2.0*M_PI*3.0*t),0.5 + 0.3*sin(2.0*M_PI*2.0*t),viewHeight);
+            rec.addTile(Quadtree::Identifier(0,0,0),true,false);
+        }
+
+        // Evaluate everything that's queued up
+        Quadtree::NodeInfo nodeInfo;
+        while (rec.popLastEval(nodeInfo))
+        {
+            bool shouldLoad = false;
+            bool addChildren = false;
+            if (!nodeInfo.isFrameLoading(-1))
+            {
+                if (nodeInfo.phantom)
+                    shouldLoad = nodeInfo.ident.level <= params.maxLevel && rec.shouldLoadTile(nodeInfo.ident,-1) && !nodeInfo.failed;
+                else if (nodeInfo.ident.level < params.maxLevel)
+                    addChildren = true;
+            }
+
+            if (addChildren)
+            {
+                std::vector<Quadtree::Identifier> childIdents;
+                tree.childrenForNode(nodeInfo.ident,childIdents);
+                for (const Quadtree::Identifier &childIdent : childIdents)
+                    if (!rec.didFail(childIdent))
+                        rec.addTile(childIdent,true,true);
+            }
+
+            if (shouldLoad)
+            {
+                if (rec.isFull())
+                {
+                    Quadtree::NodeInfo remNodeInfo;
+                    if (rec.leastImportantNode(remNodeInfo,true))
+                        rec.removeTile(remNodeInfo.ident);
+                }
+                rec.setPhantom(nodeInfo.ident,false);
+                rec.setLoading(nodeInfo.ident,-1,true);
+                loading.push_back(nodeInfo.ident);
+            }
+        }
+
+        // Clean out old nodes
+        Quadtree::NodeInfo remNodeInfo;
+        while (rec.leastImportantNode(remNodeInfo,false))
+            rec.removeTile(remNodeInfo.ident);
+
+        // Some of the outstanding loads come back
+        for (int ii=0;ii<LoadsPerFrame && !loading.empty();ii++)
+        {
+            Quadtree::Identifier ident = loading.front();
+            loading.pop_front();
+            if (!rec.getNodeInfo(ident))
+                continue;
+            rec.didLoad(ident,-1);
+            if (ident.level < params.maxLevel)
+            {
+                std::vector<Quadtree::Identifier> childIdents;
+                tree.childrenForNode(ident,childIdents);
+                for (const Quadtree::Identifier &childIdent : childIdents)
+                    if (!rec.didFail(childIdent))
+                        rec.addTile(childIdent,true,true);
+            }
+        }
+    }
+}
+
+bool WriteTrace(const char *fileName,const TraceParams &params,const std::vector<TraceOp> &ops)
+{
+    FILE *fp = fopen(fileName,"w");
+    if (!fp)
+    {
+        fprintf(stderr,"Failed to open trace file for write: %s\n",fileName);
+        return false;
+    }
+
+    fprintf(fp,"quadtree_trace %d %d %f\n",params.maxLevel,params.maxTiles,params.minImportance);
+    for (const TraceOp &op : ops)
+    {
+        if (op.type == 'v')
+            fprintf(fp,"v %.17g %.17g %.17g\n",op.viewX,op.viewY,op.viewHeight);
+        else
+            fprintf(fp,"%c %d %d %d %d %d\n",op.type,op.level,op.x,op.y,op.arg0,op.arg1);
+    }
+    fclose(fp);
+
+    return true;
+}
+
+bool ReadTrace(const char *fileName,TraceParams &params,std::vector<TraceOp> &ops)
+{
+    FILE *fp = fopen(fileName,"r");
+    if (!fp)
+    {
+        fprintf(stderr,"Failed to open trace file: %s\n",fileName);
+        return false;
+    }
+
+    bool ok = fscanf(fp,"quadtree_trace %d %d %f",&params.maxLevel,&params.maxTiles,&params.minImportance) == 3;
+    char type;
+    while (ok && fscanf(fp," %c",&type) == 1)
+    {
+        TraceOp op;
+        op.type = type;
+        if (type == 'v')
+            ok = fscanf(fp,"%lf %lf %lf",&op.viewX,&op.viewY,&op.viewHeight) == 3;
+        else
+            ok = fscanf(fp,"%d %d %d %d %d",&op.level,&op.x,&op.y,&op.arg0,&op.arg1) == 5;
+        ops.push_back(op);
+    }
+    fclose(fp);
+
+    if (!ok)
+        fprintf(stderr,"Bad trace file: %s\n",fileName);
+    return ok;
+}
+
+// Run the calls against a fresh quad tree and return how long it took
+double ReplayTrace(const TraceParams &params,const std::vector<TraceOp> &ops)
+{
+    QuadBenchImportance *importance = [[QuadBenchImportance alloc] init];
+    Quadtree tree(Mbr(Point2f(0.0,0.0),Point2f(1.0,1.0)),0,params.maxLevel,params.maxTiles,params.minImportance,importance);
+    std::vector<Quadtree::Identifier> newlyCovered;
+    Quadtree::NodeInfo nodeInfo;
+
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    for (const TraceOp &op : ops)
+    {
+        Quadtree::Identifier ident(op.x,op.y,op.level);
+        switch (op.type)
+        {
+            case 'v':
+                importance.viewX = op.viewX;  importance.viewY = op.viewY;  importance.viewHeight = op.viewHeight;
+                tree.clearEvals();
+                tree.reevaluateNodes();
+                break;
+            case 'a':
+                newlyCovered.clear();
+                tree.addTile(ident,op.arg0,op.arg1,newlyCovered);
+                break;
+            case 'e':
+                tree.popLastEval(nodeInfo);
+                break;
+            case 's':
+                tree.shouldLoadTile(ident,op.arg0);
+                break;
+            case 'p':
+                tree.setPhantom(ident,op.arg0);
+                break;
+            case 'l':
+                tree.setLoading(ident,op.arg0,op.arg1);
+                break;
+            case 'd':
+                tree.didLoad(ident,op.arg0);
+                break;
+            case 'u':
+                tree.leastImportantNode(nodeInfo,op.arg0);
+                break;
+            case 'r':
+                tree.removeTile(ident);
+                break;
+            case 'f':
+                tree.didFail(ident);
+                break;
+            case 'g':
+                tree.getNodeInfo(ident);
+                break;
+            case 'n':
+                tree.isFull();
+                break;
+        }
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void BenchTrace(const char *what,const TraceParams &params,const std::vector<TraceOp> &ops,int reps)
+{
+    int numViews = 0,numLoads = 0;
+    for (const TraceOp &op : ops)
+    {
+        if (op.type == 'v')
+            numViews++;
+        else if (op.type == 'l' && op.arg1)
+            numLoads++;
+    }
+
+    double bestSecs = 0.0;
+    for (int ii=0;ii<reps;ii++)
+    {
+        double secs = ReplayTrace(params,ops);
+        if (ii == 0 || secs < bestSecs)
+            bestSecs = secs;
+    }
+
+    fprintf(stdout,"%s: %d calls, %d view changes, %d loads in %.3fs (best of %d): %.1f ns/call, %.1f us/view\n",what,(int)ops.size(),numViews,numLoads,bestSecs,reps,
+            (ops.empty() ? 0.0 : bestSecs*1e9/ops.size()),(numViews ? bestSecs*1e6/numViews : 0.0));
+}
+
+int main(int argc, char * argv[])
+{
+    @autoreleasepool
+    {
+        TraceParams params;
+        int numFrames = 2000;
+        int reps = 5;
+        const char *recordFile = NULL;
+        std::vector<const char *> traceFiles;
+
+        for (int ii=1;ii<argc;ii++)
+        {
+            if (!strcmp(argv[ii],"-frames"))
+            {
+                if (ii+1 >= argc)
+                {
+                    fprintf(stderr,"Expecting one argument for -frames\n");
+                    return -1;
+                }
+                numFrames = atoi(argv[++ii]);
+            } else if (!strcmp(argv[ii],"-maxtiles"))
+            {
+                if (ii+1 >= argc)
+                {
+                    fprintf(stderr,"Expecting one argument for -maxtiles\n");
+                    return -1;
+                }
+                params.maxTiles = atoi(argv[++ii]);
+            } else if (!strcmp(argv[ii],"-maxlevel"))
+            {
+                if (ii+1 >= argc)
+                {
+                    fprintf(stderr,"Expecting one argument for -maxlevel\n");
+                    return -1;
+                }
+                params.maxLevel = atoi(argv[++ii]);
+            } else if (!strcmp(argv[ii],"-reps"))
+            {
+                if (ii+1 >= argc)
+                {
+                    fprintf(stderr,"Expecting one argument for -reps\n");
+                    return -1;
+                }
+                reps = std::max(1,atoi(argv[++ii]));
+            } else if (!strcmp(argv[ii],"-record"))
+            {
+                if (ii+1 >= argc)
+                {
+                    fprintf(stderr,"Expecting one argument for -record\n");
+                    return -1;
+                }
+                recordFile = argv[++ii];
+            } else if (argv[ii][0] == '-')
+            {
+                fprintf(stderr,"Unknown option: %s\n",argv[ii]);
+                fprintf(stderr,"%s: [-frames n] [-maxtiles n] [-maxlevel n] [-reps n] [-record out.trace] [in.trace ...]\n",argv[0]);
+                return -1;
+            } else
+                traceFiles.push_back(argv[ii]);
+        }
+
+        // Without any traces, we make one up
+        if (traceFiles.empty())
+        {
+            std::vector<TraceOp> ops;
+            SimulateFlight(params,numFrames,ops);
+            if (recordFile && !WriteTrace(recordFile,params,ops))
+                return -1;
+            BenchTrace("Simulated flight",params,ops,reps);
+        }
+
+        for (const char *traceFile : traceFiles)
+        {
+            TraceParams traceParams;
+            std::vector<TraceOp> ops;
+            if (!ReadTrace(traceFile,traceParams,ops))
+                return -1;
+            BenchTrace(traceFile,traceParams,ops,reps);
+        }
+    }
+
+    return 0;
+}
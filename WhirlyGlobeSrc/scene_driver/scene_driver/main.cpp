@@ -0,0 +1,891 @@
+//
+//  main.cpp
+//  scene_driver
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include "Identifiable.h"
+#include "Cullable.h"
+#include "DrawList.h"
+#include "ChangeQueue.h"
+#include "PerformanceTimer.h"
+#include "Telemetry.h"
+#include "RenderBackend.h"
+
+namespace WhirlyKit
+{
+
+// Stands in for the real drawable, which is Objective-C and tied to OpenGL.
+// The draw list and cull tree only see its slot.
+class Drawable
+{
+public:
+    Drawable() : priority(0), programID(EmptyIdentity), texID(0), alpha(false), zBuffer(false),
+                 vertBuf(0), elementBuf(0), count(0), type(RenderTriangles), drawListSlot(-1) { }
+
+    uint64_t getDrawListKey() const { return DrawList::makeKey(priority,zBuffer,programID,texID); }
+
+    unsigned int priority;
+    SimpleIdentity programID;
+    unsigned int texID;
+    bool alpha,zBuffer;
+    Mbr localMbr;
+    unsigned int vertBuf,elementBuf;
+    int count;
+    RenderPrimitiveType type;
+    int drawListSlot;
+};
+
+}
+
+using namespace Eigen;
+using namespace WhirlyKit;
+
+typedef std::shared_ptr<Drawable> DrawableRef;
+
+// Unit sphere with lon/lat in radians, like the globe's display adapter
+class SphereDisplayAdapter : public CoordSystemDisplayAdapter
+{
+public:
+    SphereDisplayAdapter() : CoordSystemDisplayAdapter(NULL,Point3d(0,0,0)) { }
+    bool getBounds(Point3f & /*ll*/,Point3f & /*ur*/) { return false; }
+    Point3f localToDisplay(Point3f pt)
+    {
+        Point3d disp = localToDisplay(Point3d(pt.x(),pt.y(),pt.z()));
+        return Point3f(disp.x(),disp.y(),disp.z());
+    }
+    Point3d localToDisplay(Point3d pt)
+    {
+        double rad = 1.0 + pt.z();
+        return Point3d(cos(pt.y())*cos(pt.x())*rad,cos(pt.y())*sin(pt.x())*rad,sin(pt.y())*rad);
+    }
+    Point3f displayToLocal(Point3f pt)
+    {
+        Point3d loc = displayToLocal(Point3d(pt.x(),pt.y(),pt.z()));
+        return Point3f(loc.x(),loc.y(),loc.z());
+    }
+    Point3d displayToLocal(Point3d pt)
+    {
+        double rad = pt.norm();
+        return Point3d(atan2(pt.y(),pt.x()),asin(pt.z()/rad),rad-1.0);
+    }
+    Point3f normalForLocal(Point3f pt) { return localToDisplay(Point3f(pt.x(),pt.y(),0.0)); }
+    Point3d normalForLocal(Point3d pt) { return localToDisplay(Point3d(pt.x(),pt.y(),0.0)); }
+    CoordSystem *getCoordSystem() { return NULL; }
+    bool isFlat() { return false; }
+};
+
+// Where the camera is.  Lon and lat are in degrees, height is in earth radii.
+class Camera
+{
+public:
+    Camera() : lon(0.0), lat(0.0), height(3.0) { }
+    Camera(double lon,double lat,double height) : lon(lon), lat(lat), height(height) { }
+    double lon,lat,height;
+};
+
+// Looking straight down, set up the way WhirlyGlobeView does it
+CullView MakeCullView(const Camera &camera,const Point2f &frameSize)
+{
+    double lon = camera.lon / 180.0 * M_PI, lat = camera.lat / 180.0 * M_PI;
+    Vector3d up(cos(lat)*cos(lon),cos(lat)*sin(lon),sin(lat));
+    Vector3d north = Vector3d(0,0,1) - up * up.z();
+    if (north.norm() < 1e-6)
+        north = Vector3d(1,0,0);
+    north.normalize();
+    Vector3d east = north.cross(up);
+    Matrix4d rot = Matrix4d::Identity();
+    rot.block<1,3>(0,0) = east.transpose();
+    rot.block<1,3>(1,0) = north.transpose();
+    rot.block<1,3>(2,0) = up.transpose();
+    Matrix4d trans = Matrix4d::Identity();
+    trans(2,3) = -(1.0 + camera.height);
+
+    // Same frustum as calcFrustumWidth
+    double nearPlane = 0.000001;
+    double imagePlaneSize = nearPlane * tan(M_PI/8.0);
+    double ratio = frameSize.y() / frameSize.x();
+    Mbr screenMbr;
+    screenMbr.addPoint(Point2f(-0.1*frameSize.x(),-0.1*frameSize.y()));
+    screenMbr.addPoint(Point2f(1.1*frameSize.x(),1.1*frameSize.y()));
+
+    return CullView(trans * rot,nearPlane,Point2d(-imagePlaneSize,-imagePlaneSize * ratio),Point2d(imagePlaneSize,imagePlaneSize * ratio),
+                    frameSize,screenMbr,Vector3f(up.x(),up.y(),up.z()));
+}
+
+// A tile in a quad tree over the whole globe
+class TileIdent
+{
+public:
+    TileIdent() : level(0), x(0), y(0) { }
+    TileIdent(int level,int x,int y) : level(level), x(x), y(y) { }
+    bool operator < (const TileIdent &that) const
+    {
+        if (level != that.level)
+            return level < that.level;
+        if (x != that.x)
+            return x < that.x;
+        return y < that.y;
+    }
+    Mbr localMbr() const
+    {
+        double lonSize = 2.0*M_PI / (1<<level), latSize = M_PI / (1<<level);
+        return Mbr(Point2f(-M_PI + x * lonSize,-M_PI/2.0 + y * latSize),Point2f(-M_PI + (x+1) * lonSize,-M_PI/2.0 + (y+1) * latSize));
+    }
+    int level,x,y;
+};
+
+// Geometry for one drawable, built on the loading side
+class DrawableData
+{
+public:
+    DrawableData() : priority(0), programID(EmptyIdentity), alpha(false), hasTexture(false), texSize(0), type(RenderTriangles) { }
+    unsigned int priority;
+    SimpleIdentity programID;
+    bool alpha,hasTexture;
+    int texSize;
+    RenderPrimitiveType type;
+    Mbr localMbr;
+    std::vector<float> verts;
+    std::vector<unsigned short> tris;
+};
+
+// What a loader thread hands the renderer
+class SceneChange
+{
+public:
+    SceneChange() : add(false) { }
+    bool add;
+    TileIdent ident;
+    std::shared_ptr<std::vector<DrawableData> > data;
+};
+
+// Program IDs, as the shader manager would have them
+static const SimpleIdentity TileProgram = 1, LineProgram = 2, LabelProgram = 3;
+static const int GridSize = 16;
+
+// Same spans and counters as the renderer, plus building tiles like the tile loader
+static const TelemetryID RenderFrameSpan = Telemetry::registerSpan("Render Frame");
+static const TelemetryID RenderSetupSpan = Telemetry::registerSpan("Render Setup");
+static const TelemetryID SceneProcessingSpan = Telemetry::registerSpan("Scene processing");
+static const TelemetryID CullingSpan = Telemetry::registerSpan("Culling");
+static const TelemetryID DrawExecutionSpan = Telemetry::registerSpan("Draw Execution");
+static const TelemetryID PresentSpan = Telemetry::registerSpan("Present Renderbuffer");
+static const TelemetryID SceneChangesCounter = Telemetry::registerCounter("Scene changes");
+static const TelemetryID DrawablesConsideredCounter = Telemetry::registerCounter("Drawables considered");
+static const TelemetryID CullablesCounter = Telemetry::registerCounter("Cullables");
+static const TelemetryID DrawablesDrawnCounter = Telemetry::registerCounter("Drawables drawn");
+static const TelemetryID TileBuildSpan = Telemetry::registerSpan("Quad tile loader - build tile");
+
+// Build a tile the way the loaders do: a textured grid, some vectors and some labels
+std::shared_ptr<std::vector<DrawableData> > BuildTile(const TileIdent &ident,int numFeatures,SphereDisplayAdapter &adapter)
+{
+    std::shared_ptr<std::vector<DrawableData> > tile(new std::vector<DrawableData>());
+    Mbr mbr = ident.localMbr();
+    Point2f span = mbr.ur() - mbr.ll();
+
+    DrawableData grid;
+    grid.programID = TileProgram;
+    grid.hasTexture = true;
+    grid.texSize = 256;
+    grid.localMbr = mbr;
+    grid.priority = ident.level;
+    for (int iy=0;iy<=GridSize;iy++)
+        for (int ix=0;ix<=GridSize;ix++)
+        {
+            Point3d loc(mbr.ll().x() + span.x() * ix / GridSize,mbr.ll().y() + span.y() * iy / GridSize,0.0);
+            Point3d pt = adapter.localToDisplay(loc);
+            float vert[8] = {(float)pt.x(),(float)pt.y(),(float)pt.z(),(float)ix / GridSize,(float)iy / GridSize,(float)pt.x(),(float)pt.y(),(float)pt.z()};
+            grid.verts.insert(grid.verts.end(),vert,vert+8);
+        }
+    for (int iy=0;iy<GridSize;iy++)
+        for (int ix=0;ix<GridSize;ix++)
+        {
+            unsigned short ll = iy*(GridSize+1)+ix, lr = ll+1, ul = ll+GridSize+1, ur = ul+1;
+            unsigned short tris[6] = {ll,lr,ur,ll,ur,ul};
+            grid.tris.insert(grid.tris.end(),tris,tris+6);
+        }
+    tile->push_back(grid);
+
+    // Vectors and labels scattered around the tile
+    std::mt19937 rng(ident.level * 1000003 + ident.x * 7919 + ident.y);
+    std::uniform_real_distribution<float> unit(0.0,1.0);
+    for (int ii=0;ii<numFeatures;ii++)
+    {
+        DrawableData feat;
+        Point2f ll(mbr.ll().x() + unit(rng) * span.x() * 0.75,mbr.ll().y() + unit(rng) * span.y() * 0.75);
+        Point2f size(span.x() * (0.05 + 0.2 * unit(rng)),span.y() * (0.05 + 0.2 * unit(rng)));
+        feat.localMbr = Mbr(ll,ll+size);
+        if (ii % 4 == 3)
+        {
+            // Label
+            feat.programID = LabelProgram;
+            feat.alpha = true;
+            feat.priority = 200;
+            feat.type = RenderTriangles;
+            for (int jj=0;jj<12;jj++)
+            {
+                Point3d pt = adapter.localToDisplay(Point3d(ll.x() + size.x() * jj / 12.0,ll.y(),0.0));
+                for (int kk=0;kk<4;kk++)
+                {
+                    float vert[5] = {(float)pt.x(),(float)pt.y(),(float)pt.z(),(float)(kk&1),(float)(kk>>1)};
+                    feat.verts.insert(feat.verts.end(),vert,vert+5);
+                }
+                unsigned short base = jj*4;
+                unsigned short tris[6] = {base,(unsigned short)(base+1),(unsigned short)(base+3),base,(unsigned short)(base+3),(unsigned short)(base+2)};
+                feat.tris.insert(feat.tris.end(),tris,tris+6);
+            }
+        } else {
+            // Vector
+            feat.programID = LineProgram;
+            feat.priority = 100 + ii % 3;
+            feat.type = RenderLines;
+            for (int jj=0;jj<64;jj++)
+            {
+                Point3d pt = adapter.localToDisplay(Point3d(ll.x() + size.x() * unit(rng),ll.y() + size.y() * unit(rng),0.0));
+                float vert[3] = {(float)pt.x(),(float)pt.y(),(float)pt.z()};
+                feat.verts.insert(feat.verts.end(),vert,vert+3);
+            }
+        }
+        tile->push_back(feat);
+    }
+
+    return tile;
+}
+
+// A stand-in for the scene and renderer.  It goes through the same stages as SceneRendererES2's
+//  frame, but with the drawables above.  The real Scene, renderer, layers, generators, layout and
+//  selection aren't involved.  What's real is the MPSCQueue, CullTree, DrawList and the timing.
+class FrameModel
+{
+public:
+    FrameModel(SphereDisplayAdapter *adapter,RenderBackend *backend,const Point2f &frameSize)
+    : adapter(adapter), backend(backend), frameSize(frameSize),
+      cullTree(adapter,Mbr(Point2f(-M_PI,-M_PI/2.0),Point2f(M_PI,M_PI/2.0)),4-1)
+    {
+        // Labels share a font texture
+        backend->startFrame((int)frameSize.x(),(int)frameSize.y());
+        std::vector<unsigned char> pixels(1024*1024,0);
+        fontTex = backend->createTexture(1024,1024,1,&pixels[0]);
+    }
+
+    ~FrameModel()
+    {
+        SceneChange change;
+        while (changes.pop(change)) { }
+    }
+
+    // From a loader thread
+    void addChange(const SceneChange &change)
+    {
+        changes.push(change);
+    }
+
+    // Run everything that's waiting
+    int processChanges()
+    {
+        int numChanges = 0;
+        SceneChange change;
+        while (changes.pop(change))
+        {
+            if (change.add)
+                addTile(change.ident,*change.data);
+            else
+                removeTile(change.ident);
+            numChanges++;
+        }
+        return numChanges;
+    }
+
+    void addTile(const TileIdent &ident,const std::vector<DrawableData> &data)
+    {
+        std::vector<DrawableRef> &tileDraws = tiles[ident];
+        for (const DrawableData &drawData : data)
+        {
+            DrawableRef draw(new Drawable());
+            draw->priority = drawData.priority;
+            draw->programID = drawData.programID;
+            draw->alpha = drawData.alpha;
+            draw->zBuffer = false;
+            draw->localMbr = drawData.localMbr;
+            draw->type = drawData.type;
+            draw->vertBuf = backend->createBuffer(&drawData.verts[0],drawData.verts.size()*sizeof(float));
+            if (!drawData.tris.empty())
+            {
+                draw->elementBuf = backend->createBuffer(&drawData.tris[0],drawData.tris.size()*sizeof(unsigned short));
+                draw->count = (int)drawData.tris.size();
+            } else
+                draw->count = (int)drawData.verts.size() / 3;
+            if (drawData.hasTexture)
+            {
+                std::vector<unsigned char> &pixels = texPixels;
+                pixels.resize(drawData.texSize*drawData.texSize*4);
+                draw->texID = backend->createTexture(drawData.texSize,drawData.texSize,4,&pixels[0]);
+            } else if (drawData.programID == LabelProgram)
+                draw->texID = fontTex;
+
+            // Same as GlobeScene::addDrawable
+            draw->drawListSlot = drawList.addDrawable(draw.get(),draw->getDrawListKey());
+            cullTree.addDrawable(draw->drawListSlot,draw->localMbr,false);
+            tileDraws.push_back(draw);
+        }
+    }
+
+    void removeTile(const TileIdent &ident)
+    {
+        std::map<TileIdent,std::vector<DrawableRef> >::iterator it = tiles.find(ident);
+        if (it == tiles.end())
+            return;
+        for (DrawableRef &draw : it->second)
+        {
+            cullTree.remDrawable(draw->drawListSlot);
+            drawList.removeDrawable(draw->drawListSlot);
+            backend->deleteBuffer(draw->vertBuf);
+            if (draw->elementBuf)
+                backend->deleteBuffer(draw->elementBuf);
+            if (draw->texID && draw->texID != fontTex)
+                backend->deleteTexture(draw->texID);
+        }
+        tiles.erase(it);
+    }
+
+    void removeAllTiles()
+    {
+        while (!tiles.empty())
+            removeTile(tiles.begin()->first);
+    }
+
+    // One frame, timed in the same stages as the renderer
+    void render(const Camera &camera,PerformanceTimer &perfTimer)
+    {
+        perfTimer.startTiming(RenderFrameSpan);
+
+        perfTimer.startTiming(RenderSetupSpan);
+        backend->startFrame((int)frameSize.x(),(int)frameSize.y());
+        CullView cullView = MakeCullView(camera,frameSize);
+        perfTimer.stopTiming(RenderSetupSpan);
+
+        perfTimer.startTiming(SceneProcessingSpan);
+        perfTimer.addCount(SceneChangesCounter,processChanges());
+        perfTimer.stopTiming(SceneProcessingSpan);
+
+        perfTimer.startTiming(CullingSpan);
+        int drawablesConsidered = 0;
+        toDraw.clear();
+        cullTree.findDrawables(cullView,toDraw,&drawablesConsidered);
+        drawList.startFrame();
+        for (int slot : toDraw)
+        {
+            Drawable *draw = drawList.getDrawable(slot);
+            if (draw)
+                drawList.addVisible(slot,0,draw->getDrawListKey(),draw->alpha,slot);
+        }
+        perfTimer.addCount(DrawablesConsideredCounter,drawablesConsidered);
+        perfTimer.addCount(CullablesCounter,cullTree.getCount());
+        perfTimer.stopTiming(CullingSpan);
+
+        perfTimer.startTiming(DrawExecutionSpan);
+        drawList.getDrawOrder(true,drawOrder);
+        for (int slot : drawOrder)
+        {
+            Drawable *draw = drawList.getDrawable(slot);
+            backend->useProgram(draw->programID);
+            if (draw->texID)
+                backend->bindTexture(0,draw->texID);
+            backend->draw(draw->type,draw->vertBuf,draw->elementBuf,draw->count,1);
+        }
+        perfTimer.addCount(DrawablesDrawnCounter,(int)drawOrder.size());
+        perfTimer.stopTiming(DrawExecutionSpan);
+
+        perfTimer.startTiming(PresentSpan);
+        backend->present();
+        perfTimer.stopTiming(PresentSpan);
+
+        perfTimer.stopTiming(RenderFrameSpan);
+    }
+
+    int getNumTiles() { return (int)tiles.size(); }
+    int getNumDrawables() { return drawList.getNumDrawables(); }
+    int getNumCullables() { return cullTree.getCount(); }
+
+protected:
+    SphereDisplayAdapter *adapter;
+    RenderBackend *backend;
+    Point2f frameSize;
+    MPSCQueue<SceneChange> changes;
+    DrawList drawList;
+    CullTree cullTree;
+    std::map<TileIdent,std::vector<DrawableRef> > tiles;
+    unsigned int fontTex;
+    std::vector<unsigned char> texPixels;
+    std::vector<int> toDraw,drawOrder;
+};
+
+// One line of a script
+class ScriptCommand
+{
+public:
+    typedef enum {SetCamera,FlyTo,LoadTile,UnloadTile,WaitFrames} Type;
+    ScriptCommand(Type type,double a0=0,double a1=0,double a2=0,double a3=0) : type(type)
+    {
+        args[0] = a0;  args[1] = a1;  args[2] = a2;  args[3] = a3;
+    }
+    Type type;
+    double args[4];
+};
+
+class Script
+{
+public:
+    Script() : frameSize(2048,1536) { }
+    Point2f frameSize;
+    std::vector<ScriptCommand> commands;
+};
+
+bool ReadScript(const char *fileName,Script &script)
+{
+    FILE *fp = fopen(fileName,"r");
+    if (!fp)
+    {
+        fprintf(stderr,"Can't open script %s\n",fileName);
+        return false;
+    }
+
+    char line[1024];
+    int lineNo = 0;
+    bool ok = true;
+    while (ok && fgets(line,sizeof(line),fp))
+    {
+        lineNo++;
+        char *hash = strchr(line,'#');
+        if (hash)
+            *hash = 0;
+        char cmd[64];
+        double a[4] = {0,0,0,0};
+        int num = sscanf(line,"%63s %lf %lf %lf %lf",cmd,&a[0],&a[1],&a[2],&a[3]);
+        if (num < 1)
+            continue;
+        num--;
+        if (!strcmp(cmd,"frame") && num == 2)
+            script.frameSize = Point2f(a[0],a[1]);
+        else if (!strcmp(cmd,"camera") && num == 3)
+            script.commands.push_back(ScriptCommand(ScriptCommand::SetCamera,a[0],a[1],a[2]));
+        else if (!strcmp(cmd,"fly") && num == 4 && a[3] >= 1)
+            script.commands.push_back(ScriptCommand(ScriptCommand::FlyTo,a[0],a[1],a[2],a[3]));
+        else if (!strcmp(cmd,"load") && num == 3)
+            script.commands.push_back(ScriptCommand(ScriptCommand::LoadTile,a[0],a[1],a[2]));
+        else if (!strcmp(cmd,"unload") && num == 3)
+            script.commands.push_back(ScriptCommand(ScriptCommand::UnloadTile,a[0],a[1],a[2]));
+        else if (!strcmp(cmd,"wait") && num == 1 && a[0] >= 1)
+            script.commands.push_back(ScriptCommand(ScriptCommand::WaitFrames,a[0]));
+        else {
+            fprintf(stderr,"%s:%d: can't make sense of %s",fileName,lineNo,line);
+            ok = false;
+        }
+    }
+    fclose(fp);
+
+    return ok;
+}
+
+bool WriteScript(const char *fileName,const Script &script)
+{
+    FILE *fp = fopen(fileName,"w");
+    if (!fp)
+    {
+        fprintf(stderr,"Can't write script %s\n",fileName);
+        return false;
+    }
+
+    fprintf(fp,"frame %g %g\n",script.frameSize.x(),script.frameSize.y());
+    for (const ScriptCommand &cmd : script.commands)
+    {
+        switch (cmd.type)
+        {
+            case ScriptCommand::SetCamera:
+                fprintf(fp,"camera %.8f %.8f %.8g\n",cmd.args[0],cmd.args[1],cmd.args[2]);
+                break;
+            case ScriptCommand::FlyTo:
+                fprintf(fp,"fly %.8f %.8f %.8g %d\n",cmd.args[0],cmd.args[1],cmd.args[2],(int)cmd.args[3]);
+                break;
+            case ScriptCommand::LoadTile:
+                fprintf(fp,"load %d %d %d\n",(int)cmd.args[0],(int)cmd.args[1],(int)cmd.args[2]);
+                break;
+            case ScriptCommand::UnloadTile:
+                fprintf(fp,"unload %d %d %d\n",(int)cmd.args[0],(int)cmd.args[1],(int)cmd.args[2]);
+                break;
+            case ScriptCommand::WaitFrames:
+                fprintf(fp,"wait %d\n",(int)cmd.args[0]);
+                break;
+        }
+    }
+    fclose(fp);
+
+    return true;
+}
+
+// Tiles a quad display layer would want for a camera: every level down to
+//  one that's about screen resolution, around the spot we're looking at
+void WantedTiles(const Camera &camera,const Point2f &frameSize,std::set<TileIdent> &tiles)
+{
+    const int MaxLevel = 16;
+    double lon = camera.lon / 180.0 * M_PI, lat = camera.lat / 180.0 * M_PI;
+    double radius = std::min(M_PI/2.0,camera.height * tan(M_PI/8.0) * frameSize.x() / frameSize.y() * 3.0);
+    int maxLevel = std::max(0,std::min(MaxLevel,(int)floor(log2(M_PI / radius))));
+    double lonRadius = std::min(M_PI,radius / std::max(0.1,cos(lat)));
+    for (int level=0;level<=maxLevel;level++)
+    {
+        int numTiles = 1<<level;
+        double lonSize = 2.0*M_PI / numTiles, latSize = M_PI / numTiles;
+        int x0 = std::max(0,(int)floor((lon - lonRadius + M_PI) / lonSize)), x1 = std::min(numTiles-1,(int)floor((lon + lonRadius + M_PI) / lonSize));
+        int y0 = std::max(0,(int)floor((lat - radius + M_PI/2.0) / latSize)), y1 = std::min(numTiles-1,(int)floor((lat + radius + M_PI/2.0) / latSize));
+        for (int x=x0;x<=x1;x++)
+            for (int y=y0;y<=y1;y++)
+                tiles.insert(TileIdent(level,x,y));
+    }
+}
+
+// Fly in, wander around and fly back out, loading tiles as we go
+void MakeDefaultScript(Script &script,int maxLoadsPerFrame)
+{
+    std::vector<std::pair<Camera,int> > path;
+    path.push_back(std::make_pair(Camera(-122.4,37.8,0.0005),600));
+    path.push_back(std::make_pair(Camera(-122.0,37.4,0.005),300));
+    path.push_back(std::make_pair(Camera(-73.9,40.7,0.05),600));
+    path.push_back(std::make_pair(Camera(-73.9,40.7,0.001),300));
+    path.push_back(std::make_pair(Camera(-30.0,20.0,2.0),300));
+
+    Camera camera(-122.4,37.8,3.0);
+    script.commands.push_back(ScriptCommand(ScriptCommand::SetCamera,camera.lon,camera.lat,camera.height));
+    std::set<TileIdent> loaded;
+    for (unsigned int leg=0;leg<path.size();leg++)
+    {
+        Camera start = camera, end = path[leg].first;
+        int numFrames = path[leg].second;
+        for (int frame=1;frame<=numFrames;frame++)
+        {
+            double t = (double)frame / numFrames;
+            camera.lon = start.lon + (end.lon - start.lon) * t;
+            camera.lat = start.lat + (end.lat - start.lat) * t;
+            camera.height = exp(log(start.height) + (log(end.height) - log(start.height)) * t);
+
+            // Unload what we don't need, then load what we do, a few at a time with the lowest levels first
+            std::set<TileIdent> wanted;
+            WantedTiles(camera,script.frameSize,wanted);
+            for (std::set<TileIdent>::iterator it = loaded.begin(); it != loaded.end();)
+            {
+                if (!wanted.count(*it))
+                {
+                    script.commands.push_back(ScriptCommand(ScriptCommand::UnloadTile,it->level,it->x,it->y));
+                    loaded.erase(it++);
+                } else
+                    ++it;
+            }
+            int numLoads = 0;
+            for (const TileIdent &ident : wanted)
+            {
+                if (numLoads >= maxLoadsPerFrame)
+                    break;
+                if (loaded.count(ident))
+                    continue;
+                script.commands.push_back(ScriptCommand(ScriptCommand::LoadTile,ident.level,ident.x,ident.y));
+                loaded.insert(ident);
+                numLoads++;
+            }
+
+            script.commands.push_back(ScriptCommand(ScriptCommand::FlyTo,camera.lon,camera.lat,camera.height,1));
+        }
+    }
+}
+
+// Per frame timings and counts for one run through the script
+class RunResults
+{
+public:
+    RunResults() : numFrames(0), badIDs(0), ok(true) { }
+    std::vector<PerformanceTimer::TimeEntry> times;
+    std::vector<PerformanceTimer::CountEntry> counts;
+    RenderBackendStats totalStats;
+    int numFrames;
+    int badIDs;
+    bool ok;
+};
+
+bool RunScript(const Script &script,int numFeatures,RunResults &results)
+{
+    SphereDisplayAdapter adapter;
+    NullRenderBackend backend;
+    PerformanceTimer perfTimer;
+    FrameModel renderer(&adapter,&backend,script.frameSize);
+
+    // The loader builds tiles off the clock, like a layer thread would
+    Camera camera;
+    for (const ScriptCommand &cmd : script.commands)
+    {
+        switch (cmd.type)
+        {
+            case ScriptCommand::SetCamera:
+                camera = Camera(cmd.args[0],cmd.args[1],cmd.args[2]);
+                break;
+            case ScriptCommand::LoadTile:
+            case ScriptCommand::UnloadTile:
+            {
+                SceneChange change;
+                change.add = cmd.type == ScriptCommand::LoadTile;
+                change.ident = TileIdent((int)cmd.args[0],(int)cmd.args[1],(int)cmd.args[2]);
+                if (change.add)
+                {
+                    TelemetrySpan span(TileBuildSpan);
+                    change.data = BuildTile(change.ident,numFeatures,adapter);
+                }
+                renderer.addChange(change);
+            }
+                break;
+            case ScriptCommand::FlyTo:
+            {
+                Camera start = camera, end(cmd.args[0],cmd.args[1],cmd.args[2]);
+                int numFrames = (int)cmd.args[3];
+                for (int frame=1;frame<=numFrames;frame++)
+                {
+                    double t = (double)frame / numFrames;
+                    camera.lon = start.lon + (end.lon - start.lon) * t;
+                    camera.lat = start.lat + (end.lat - start.lat) * t;
+                    camera.height = exp(log(start.height) + (log(end.height) - log(start.height)) * t);
+                    renderer.render(camera,perfTimer);
+                }
+            }
+                break;
+            case ScriptCommand::WaitFrames:
+                for (int frame=0;frame<(int)cmd.args[0];frame++)
+                    renderer.render(camera,perfTimer);
+                break;
+        }
+    }
+
+    perfTimer.getTimeEntries(results.times);
+    perfTimer.getCountEntries(results.counts);
+    results.totalStats = backend.getTotalStats();
+    results.numFrames = backend.getNumFrames();
+
+    // Take everything out and the scene and backend should be empty, apart from the font texture
+    PerformanceTimer cleanupTimer;
+    renderer.removeAllTiles();
+    renderer.render(camera,cleanupTimer);
+    if (renderer.getNumDrawables() != 0 || renderer.getNumCullables() != 1 ||
+        backend.getNumLiveBuffers() != 0 || backend.getNumLiveTextures() != 1)
+    {
+        fprintf(stderr,"Left over after unloading: %d drawables, %d cullables, %d buffers, %d textures\n",
+                renderer.getNumDrawables(),renderer.getNumCullables(),backend.getNumLiveBuffers(),backend.getNumLiveTextures());
+        results.ok = false;
+    }
+    results.badIDs = backend.getTotalStats().badIDs;
+    if (results.badIDs > 0)
+    {
+        fprintf(stderr,"%d backend calls used buffers or textures that weren't there\n",results.badIDs);
+        results.ok = false;
+    }
+
+    return results.ok;
+}
+
+// Average milliseconds per frame for each stage
+typedef std::map<std::string,double> StageTimes;
+
+void GetStageTimes(const RunResults &results,StageTimes &stageTimes)
+{
+    for (const PerformanceTimer::TimeEntry &entry : results.times)
+        if (entry.numRuns > 0)
+            stageTimes[entry.name] = 1000.0 * entry.avgDur / entry.numRuns;
+}
+
+bool ReadBaseline(const char *fileName,StageTimes &stageTimes)
+{
+    FILE *fp = fopen(fileName,"r");
+    if (!fp)
+    {
+        fprintf(stderr,"Can't open baseline %s\n",fileName);
+        return false;
+    }
+    char line[1024];
+    while (fgets(line,sizeof(line),fp))
+    {
+        double ms;
+        char name[1024];
+        if (sscanf(line,"%lf %1023[^\n]",&ms,name) == 2)
+            stageTimes[name] = ms;
+    }
+    fclose(fp);
+
+    return true;
+}
+
+bool WriteBaseline(const char *fileName,const StageTimes &stageTimes)
+{
+    FILE *fp = fopen(fileName,"w");
+    if (!fp)
+    {
+        fprintf(stderr,"Can't write baseline %s\n",fileName);
+        return false;
+    }
+    for (StageTimes::const_iterator it = stageTimes.begin(); it != stageTimes.end(); ++it)
+        fprintf(fp,"%.4f %s\n",it->second,it->first.c_str());
+    fclose(fp);
+
+    return true;
+}
+
+int main(int argc, const char * argv[])
+{
+    const char *scriptName = NULL,*writeName = NULL,*baselineName = NULL,*saveName = NULL,*traceName = NULL;
+    int reps = 3;
+    int numFeatures = 48;
+    int maxLoads = 8;
+    double tolerance = 25.0;
+
+    for (int ii=1;ii<argc;ii++)
+    {
+        bool ok = ii+1 < argc;
+        if (!ok)
+            ;
+        else if (!strcmp(argv[ii],"-script"))
+            scriptName = argv[++ii];
+        else if (!strcmp(argv[ii],"-write"))
+            writeName = argv[++ii];
+        else if (!strcmp(argv[ii],"-baseline"))
+            baselineName = argv[++ii];
+        else if (!strcmp(argv[ii],"-save"))
+            saveName = argv[++ii];
+        else if (!strcmp(argv[ii],"-trace"))
+            traceName = argv[++ii];
+        else if (!strcmp(argv[ii],"-reps"))
+            ok = (reps = atoi(argv[++ii])) > 0;
+        else if (!strcmp(argv[ii],"-features"))
+            ok = (numFeatures = atoi(argv[++ii])) >= 0;
+        else if (!strcmp(argv[ii],"-loads"))
+            ok = (maxLoads = atoi(argv[++ii])) > 0;
+        else if (!strcmp(argv[ii],"-tolerance"))
+            ok = (tolerance = atof(argv[++ii])) > 0.0;
+        else
+            ok = false;
+        if (!ok)
+        {
+            fprintf(stderr,"usage: %s [-script in.script] [-write out.script] [-reps n] [-features n] [-loads n] [-save out.baseline] [-baseline in.baseline] [-tolerance percent] [-trace out.json]\n",argv[0]);
+            return -1;
+        }
+    }
+
+    Script script;
+    if (scriptName)
+    {
+        if (!ReadScript(scriptName,script))
+            return -1;
+    } else
+        MakeDefaultScript(script,maxLoads);
+    if (writeName && !WriteScript(writeName,script))
+        return -1;
+
+    Telemetry::setThreadName("Renderer");
+    Telemetry::setTracing(traceName != NULL);
+
+    // Best of a few runs for each stage
+    StageTimes bestTimes;
+    RunResults results;
+    for (int rep=0;rep<reps;rep++)
+    {
+        // Percentiles and the trace are just for the last run
+        Telemetry::clear();
+        results = RunResults();
+        if (!RunScript(script,numFeatures,results))
+        {
+            fprintf(stderr,"Checks failed\n");
+            return -1;
+        }
+        StageTimes stageTimes;
+        GetStageTimes(results,stageTimes);
+        for (StageTimes::iterator it = stageTimes.begin(); it != stageTimes.end(); ++it)
+        {
+            StageTimes::iterator bit = bestTimes.find(it->first);
+            if (bit == bestTimes.end() || it->second < bit->second)
+                bestTimes[it->first] = it->second;
+        }
+    }
+    printf("Checks passed\n");
+
+    // Timings from the last run, with the best averages
+    printf("%d frames, best of %d runs\n",results.numFrames,reps);
+    printf("%-22s %10s %10s %10s %10s\n","","best avg","avg","p99","max");
+    for (const PerformanceTimer::TimeEntry &entry : results.times)
+        if (entry.numRuns > 0)
+        {
+            TelemetryStats stats;
+            Telemetry::getStats(Telemetry::registerSpan(entry.name),stats);
+            printf("%-22s %10.3f %10.3f %10.3f %10.3f ms\n",entry.name.c_str(),bestTimes[entry.name],1000.0 * entry.avgDur / entry.numRuns,stats.p99 / 1e6,1000.0 * entry.maxDur);
+        }
+    for (const PerformanceTimer::CountEntry &entry : results.counts)
+        if (entry.numRuns > 0)
+            printf("%-22s %10s %10.1f %10d\n",entry.name.c_str(),"",(double)entry.avgCount / entry.numRuns,entry.maxCount);
+    const RenderBackendStats &stats = results.totalStats;
+    double numFrames = std::max(1,results.numFrames);
+    printf("Backend per frame: %.1f draw calls, %.1f program changes, %.1f texture binds, %.0f primitives\n",
+           stats.drawCalls / numFrames,stats.programChanges / numFrames,stats.textureBinds / numFrames,stats.primitives / numFrames);
+    printf("Backend uploads: %d buffers (%.1f MB), %d textures (%.1f MB)\n",
+           stats.buffersCreated,stats.bufferBytes / (1024.0*1024.0),stats.texturesCreated,stats.textureBytes / (1024.0*1024.0));
+
+    TelemetryStats buildStats;
+    if (Telemetry::getStats(TileBuildSpan,buildStats))
+        printf("Tiles built off the clock: %llu, p50 %.3f ms, p99 %.3f ms\n",(unsigned long long)buildStats.count,buildStats.p50 / 1e6,buildStats.p99 / 1e6);
+
+    if (saveName && !WriteBaseline(saveName,bestTimes))
+        return -1;
+    if (traceName && !Telemetry::writeChromeTrace(traceName))
+    {
+        fprintf(stderr,"Can't write trace %s\n",traceName);
+        return -1;
+    }
+
+    // Anything that got slower than we'd like
+    if (baselineName)
+    {
+        StageTimes baseline;
+        if (!ReadBaseline(baselineName,baseline))
+            return -1;
+        int numSlower = 0;
+        for (StageTimes::iterator it = baseline.begin(); it != baseline.end(); ++it)
+        {
+            StageTimes::iterator bit = bestTimes.find(it->first);
+            if (bit == bestTimes.end())
+            {
+                printf("%s: not timed this run\n",it->first.c_str());
+                continue;
+            }
+            // Very short stages are mostly noise, so give them some slack
+            double allowed = std::max(it->second * (1.0 + tolerance / 100.0),it->second + 0.01);
+            if (bit->second > allowed)
+            {
+                printf("%s: %.3f ms, baseline %.3f ms (+%.0f%%)\n",it->first.c_str(),bit->second,it->second,100.0 * (bit->second / it->second - 1.0));
+                numSlower++;
+            }
+        }
+        if (numSlower > 0)
+        {
+            printf("%d stages slower than the baseline\n",numSlower);
+            return 1;
+        }
+        printf("No stages slower than the baseline\n");
+    }
+
+    return 0;
+}
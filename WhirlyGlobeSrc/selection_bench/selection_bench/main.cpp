@@ -0,0 +1,389 @@
+//
+//  main.cpp
+//  selection_bench
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <algorithm>
+#include "SelectionIndex.h"
+
+using namespace Eigen;
+using namespace WhirlyKit;
+
+typedef std::chrono::steady_clock Clock;
+
+double SecondsSince(Clock::time_point startTime)
+{
+    return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+// A camera over the globe, set up the way WhirlyKitView does it
+class FakeView
+{
+public:
+    FakeView(double lon,double lat,double height,const Vector2d &frameSize)
+    : frameSize(frameSize)
+    {
+        // Look straight down from above the given spot
+        Vector3d up(cos(lat)*cos(lon),cos(lat)*sin(lon),sin(lat));
+        Vector3d eye = up * (1.0 + height);
+        Vector3d north = Vector3d(0,0,1) - up * up.z();
+        if (north.norm() < 1e-6)
+            north = Vector3d(1,0,0);
+        north.normalize();
+        Vector3d east = north.cross(up);
+        Matrix4d viewMat = Matrix4d::Identity();
+        viewMat.block<1,3>(0,0) = east.transpose();
+        viewMat.block<1,3>(1,0) = north.transpose();
+        viewMat.block<1,3>(2,0) = up.transpose();
+        viewMat.block<3,1>(0,3) = -viewMat.block<3,3>(0,0) * eye;
+
+        // Same frustum as calcProjectionMatrix
+        double nearPlane = 0.000001, farPlane = 50.0, imagePlaneSize = nearPlane * tan(M_PI/8.0);
+        double ratio = frameSize.y() / frameSize.x();
+        Vector2d frustLL(-imagePlaneSize,-imagePlaneSize * ratio), frustUR(imagePlaneSize,imagePlaneSize * ratio);
+        Vector3d delta(frustUR.x()-frustLL.x(),frustUR.y()-frustLL.y(),farPlane-nearPlane);
+        Matrix4d projMat = Matrix4d::Zero();
+        projMat(0,0) = 2.0 * nearPlane / delta.x();
+        projMat(1,1) = 2.0 * nearPlane / delta.y();
+        projMat(0,2) = (frustUR.x()+frustLL.x()) / delta.x();
+        projMat(1,2) = (frustUR.y()+frustLL.y()) / delta.y();
+        projMat(2,2) = -(nearPlane + farPlane) / delta.z();
+        projMat(3,2) = -1.0;
+        projMat(2,3) = -2.0 * nearPlane * farPlane / delta.z();
+
+        projViewMat = projMat * viewMat;
+    }
+
+    // Project to the screen, upper left origin.  False if it's behind us.
+    bool project(const Vector3d &pt,Vector2d &screenPt) const
+    {
+        Vector4d clip = projViewMat * Vector4d(pt.x(),pt.y(),pt.z(),1.0);
+        if (clip.w() <= 0.0)
+            return false;
+        screenPt = Vector2d((clip.x() / clip.w() + 1.0) / 2.0 * frameSize.x(),(1.0 - clip.y() / clip.w()) / 2.0 * frameSize.y());
+        return true;
+    }
+
+    Vector2d frameSize;
+    Matrix4d projViewMat;
+};
+
+// A flat rectangle in display space, like RectSelectable3D
+class FakeRect
+{
+public:
+    Vector3d pts[4];
+};
+
+// A marker that's always the same size on the screen, like RectSelectable2D
+class FakeMarker
+{
+public:
+    Vector3d dispLoc;
+    Vector2d size;
+};
+
+// Random spot on the globe, concentrated in a patch like a fleet would be
+Vector3d RandomSpot(double lonCenter,double latCenter,double spread)
+{
+    double lon = lonCenter + (drand48()*2.0-1.0) * spread;
+    double lat = latCenter + (drand48()*2.0-1.0) * spread;
+    return Vector3d(cos(lat)*cos(lon),cos(lat)*sin(lon),sin(lat));
+}
+
+bool PointInPolygon(const Vector2d &pt,const Vector2d *poly,int numPts)
+{
+    bool inside = false;
+    for (int ii=0,jj=numPts-1;ii<numPts;jj=ii++)
+        if (((poly[ii].y() > pt.y()) != (poly[jj].y() > pt.y())) &&
+            (pt.x() < (poly[jj].x()-poly[ii].x()) * (pt.y()-poly[ii].y()) / (poly[jj].y()-poly[ii].y()) + poly[ii].x()))
+            inside = !inside;
+    return inside;
+}
+
+double DistToSegment2(const Vector2d &pt,const Vector2d &p0,const Vector2d &p1)
+{
+    Vector2d dir = p1 - p0;
+    double len2 = dir.squaredNorm();
+    double t = len2 > 0.0 ? std::max(0.0,std::min(1.0,(pt-p0).dot(dir) / len2)) : 0.0;
+    return (p0 + dir * t - pt).squaredNorm();
+}
+
+// The exact test for a rectangle, same as the selection manager does it
+bool PickRect(const FakeView &view,const FakeRect &rect,const Vector2d &touchPt,double maxDist2)
+{
+    Vector2d screenPts[4];
+    for (unsigned int ii=0;ii<4;ii++)
+        if (!view.project(rect.pts[ii],screenPts[ii]))
+            return false;
+    if (PointInPolygon(touchPt,screenPts,4))
+        return true;
+    for (unsigned int ii=0;ii<4;ii++)
+        if (DistToSegment2(touchPt,screenPts[ii],screenPts[(ii+1)%4]) < maxDist2)
+            return true;
+    return false;
+}
+
+bool PickMarker(const FakeMarker &marker,const Vector2d &projPt,const Vector2d &touchPt,double maxDist2)
+{
+    Vector2d ll = projPt - marker.size/2.0, ur = projPt + marker.size/2.0;
+    Vector2d closePt = touchPt.cwiseMax(ll).cwiseMin(ur);
+    return (closePt - touchPt).squaredNorm() < maxDist2;
+}
+
+// Make sure the box tree gives the same answers as checking everything, through a lot of adds and removes
+bool CheckBoxTree(int numBoxes)
+{
+    BoxTree<int> tree;
+    std::vector<Vector3d> lls(numBoxes),urs(numBoxes);
+    std::vector<int> handles(numBoxes,-1);
+    for (int round=0;round<4;round++)
+    {
+        for (int ii=0;ii<numBoxes;ii++)
+        {
+            if (handles[ii] >= 0 && drand48() < 0.5)
+            {
+                tree.remove(handles[ii]);
+                handles[ii] = -1;
+            }
+            if (handles[ii] < 0 && drand48() < 0.7)
+            {
+                Vector3d ll(drand48(),drand48(),drand48());
+                lls[ii] = ll;
+                urs[ii] = ll + Vector3d(drand48(),drand48(),drand48()) * 0.05;
+                handles[ii] = tree.insert(lls[ii],urs[ii],ii);
+            }
+        }
+
+        for (int qq=0;qq<200;qq++)
+        {
+            Vector3d qll(drand48(),drand48(),drand48());
+            Vector3d qur = qll + Vector3d(drand48(),drand48(),drand48()) * 0.2;
+            auto test = [&](const Vector3d &ll,const Vector3d &ur) { return (ll.array() <= qur.array()).all() && (ur.array() >= qll.array()).all(); };
+            std::vector<int> found,expected;
+            tree.query(test,[&](int which) { found.push_back(which); });
+            for (int ii=0;ii<numBoxes;ii++)
+                if (handles[ii] >= 0 && test(lls[ii],urs[ii]))
+                    expected.push_back(ii);
+            std::sort(found.begin(),found.end());
+            if (found != expected)
+            {
+                fprintf(stderr,"Box tree found %d boxes, expected %d\n",(int)found.size(),(int)expected.size());
+                return false;
+            }
+        }
+    }
+
+    int numIn = 0;
+    for (int handle : handles)
+        if (handle >= 0)
+            numIn++;
+    if (numIn != tree.size())
+    {
+        fprintf(stderr,"Box tree has %d boxes, expected %d\n",tree.size(),numIn);
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char * argv[])
+{
+    int numRects = 100000;
+    int numMarkers = 100000;
+    int numPicks = 200;
+    double height = 0.05;
+    double maxDist = 20.0;
+
+    for (int ii=1;ii<argc;ii++)
+    {
+        if (!strcmp(argv[ii],"-rects") || !strcmp(argv[ii],"-markers") || !strcmp(argv[ii],"-picks"))
+        {
+            if (ii+1 >= argc)
+            {
+                fprintf(stderr,"Expecting one argument for %s\n",argv[ii]);
+                return -1;
+            }
+            int val = atoi(argv[ii+1]);
+            if (val < 0 || (val < 1 && !strcmp(argv[ii],"-picks")))
+            {
+                fprintf(stderr,"Bad value for %s\n",argv[ii]);
+                return -1;
+            }
+            if (!strcmp(argv[ii],"-rects"))
+                numRects = val;
+            else if (!strcmp(argv[ii],"-markers"))
+                numMarkers = val;
+            else
+                numPicks = val;
+            ii++;
+        } else if (!strcmp(argv[ii],"-height"))
+        {
+            if (ii+1 >= argc)
+            {
+                fprintf(stderr,"Expecting one argument for -height\n");
+                return -1;
+            }
+            height = atof(argv[++ii]);
+            if (height <= 0.0)
+            {
+                fprintf(stderr,"Expecting a positive -height\n");
+                return -1;
+            }
+        } else {
+            fprintf(stderr,"Unknown option: %s\n",argv[ii]);
+            fprintf(stderr,"%s: [-rects n] [-markers n] [-picks n] [-height h]\n",argv[0]);
+            return -1;
+        }
+    }
+
+    srand48(1);
+    if (!CheckBoxTree(5000))
+        return -1;
+
+    // Fleet spread over a region, with the camera over the middle of it
+    double lonCenter = 2.1, latCenter = 0.6, spread = 0.2;
+    Vector2d frameSize(375,667);
+    FakeView view(lonCenter,latCenter,height,frameSize);
+
+    std::vector<FakeRect> rects(numRects);
+    for (FakeRect &rect : rects)
+    {
+        Vector3d center = RandomSpot(lonCenter,latCenter,spread);
+        Vector3d east = Vector3d(0,0,1).cross(center).normalized(), north = center.cross(east);
+        double size = 0.0001 + drand48() * 0.0005;
+        rect.pts[0] = center - east * size - north * size;
+        rect.pts[1] = center + east * size - north * size;
+        rect.pts[2] = center + east * size + north * size;
+        rect.pts[3] = center - east * size + north * size;
+    }
+    std::vector<FakeMarker> markers(numMarkers);
+    for (FakeMarker &marker : markers)
+    {
+        marker.dispLoc = RandomSpot(lonCenter,latCenter,spread);
+        marker.size = Vector2d(32,32);
+    }
+    std::vector<Vector2d> touches(numPicks);
+    for (Vector2d &touch : touches)
+        touch = Vector2d(drand48() * frameSize.x(),drand48() * frameSize.y());
+    double maxDist2 = maxDist * maxDist;
+
+    // Building the index happens as selectables are added
+    Clock::time_point startTime = Clock::now();
+    BoxTree<int> tree;
+    for (int ii=0;ii<numRects;ii++)
+    {
+        const FakeRect &rect = rects[ii];
+        Vector3d ll = rect.pts[0], ur = rect.pts[0];
+        for (unsigned int jj=1;jj<4;jj++)
+        {
+            ll = ll.cwiseMin(rect.pts[jj]);
+            ur = ur.cwiseMax(rect.pts[jj]);
+        }
+        tree.insert(ll,ur,ii);
+    }
+    double treeBuildTime = SecondsSince(startTime);
+
+    // Rectangles, checking every one
+    std::vector<std::vector<int> > scanHits(numPicks),indexHits(numPicks);
+    startTime = Clock::now();
+    for (int pp=0;pp<numPicks;pp++)
+        for (int ii=0;ii<numRects;ii++)
+            if (PickRect(view,rects[ii],touches[pp],maxDist2))
+                scanHits[pp].push_back(ii);
+    double rectScanTime = SecondsSince(startTime);
+
+    // Rectangles, through the index
+    int numCandidates = 0;
+    startTime = Clock::now();
+    for (int pp=0;pp<numPicks;pp++)
+    {
+        const Vector2d &touch = touches[pp];
+        PickFrustum pickFrustum(view.projViewMat,frameSize,touch - Vector2d(maxDist,maxDist),touch + Vector2d(maxDist,maxDist));
+        std::vector<int> candidates;
+        tree.query([&](const Vector3d &ll,const Vector3d &ur) { return pickFrustum.overlaps(ll,ur); },
+                   [&](int which) { candidates.push_back(which); });
+        std::sort(candidates.begin(),candidates.end());
+        numCandidates += (int)candidates.size();
+        for (int which : candidates)
+            if (PickRect(view,rects[which],touch,maxDist2))
+                indexHits[pp].push_back(which);
+    }
+    double rectIndexTime = SecondsSince(startTime);
+    if (scanHits != indexHits)
+    {
+        fprintf(stderr,"Index picked different rectangles than the full scan\n");
+        return -1;
+    }
+
+    // Markers, projecting every one for every pick
+    std::vector<std::vector<int> > markerScanHits(numPicks),markerGridHits(numPicks);
+    startTime = Clock::now();
+    for (int pp=0;pp<numPicks;pp++)
+        for (int ii=0;ii<numMarkers;ii++)
+        {
+            Vector2d projPt;
+            if (view.project(markers[ii].dispLoc,projPt) && PickMarker(markers[ii],projPt,touches[pp],maxDist2))
+                markerScanHits[pp].push_back(ii);
+        }
+    double markerScanTime = SecondsSince(startTime);
+
+    // Markers, projected once into a grid
+    startTime = Clock::now();
+    ScreenGrid grid;
+    double cellSize = sqrt(1.5*frameSize.x() * 1.5*frameSize.y() / std::max(numMarkers,1));
+    grid.reset(-0.25 * frameSize,1.25 * frameSize,std::max(cellSize,16.0));
+    std::vector<Vector2d> projPts(numMarkers);
+    std::vector<bool> onScreen(numMarkers);
+    for (int ii=0;ii<numMarkers;ii++)
+    {
+        onScreen[ii] = view.project(markers[ii].dispLoc,projPts[ii]);
+        if (onScreen[ii])
+            grid.add(ii,projPts[ii] - markers[ii].size/2.0,projPts[ii] + markers[ii].size/2.0);
+    }
+    double gridBuildTime = SecondsSince(startTime);
+    startTime = Clock::now();
+    std::vector<int> nearby;
+    for (int pp=0;pp<numPicks;pp++)
+    {
+        const Vector2d &touch = touches[pp];
+        grid.query(touch - Vector2d(maxDist,maxDist),touch + Vector2d(maxDist,maxDist),nearby);
+        for (int which : nearby)
+            if (onScreen[which] && PickMarker(markers[which],projPts[which],touch,maxDist2))
+                markerGridHits[pp].push_back(which);
+    }
+    double markerGridTime = SecondsSince(startTime);
+    if (markerScanHits != markerGridHits)
+    {
+        fprintf(stderr,"Grid picked different markers than the full scan\n");
+        return -1;
+    }
+
+    int numRectHits = 0, numMarkerHits = 0;
+    for (int pp=0;pp<numPicks;pp++)
+    {
+        numRectHits += (int)scanHits[pp].size();
+        numMarkerHits += (int)markerScanHits[pp].size();
+    }
+
+    fprintf(stdout,"%d rectangles, %d markers, %d picks, height %g\n",numRects,numMarkers,numPicks,height);
+    fprintf(stdout,"rectangles: index built in %.2f ms, height %d, %.1f candidates and %.2f hits per pick\n",
+            treeBuildTime * 1e3,tree.getHeight(),(double)numCandidates / numPicks,(double)numRectHits / numPicks);
+    fprintf(stdout,"  scan  %10.3f ms per pick\n",rectScanTime / numPicks * 1e3);
+    fprintf(stdout,"  index %10.3f ms per pick  %8.1fx\n",rectIndexTime / numPicks * 1e3,rectScanTime / rectIndexTime);
+    fprintf(stdout,"markers: grid built in %.2f ms, %.2f hits per pick\n",gridBuildTime * 1e3,(double)numMarkerHits / numPicks);
+    fprintf(stdout,"  scan  %10.3f ms per pick\n",markerScanTime / numPicks * 1e3);
+    fprintf(stdout,"  grid  %10.3f ms per pick  %8.1fx\n",markerGridTime / numPicks * 1e3,markerScanTime / markerGridTime);
+
+    return 0;
+}
@@ -0,0 +1,434 @@
+//
+//  main.cpp
+//  tile_cache_bench
+//
+//  Created by Steve Gifford on 10/17/26.
+//  Copyright (c) 2026 mousebird consulting. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include "PackedTileCache.h"
+
+using namespace WhirlyKit;
+
+typedef std::chrono::steady_clock Clock;
+
+double SecondsSince(Clock::time_point startTime)
+{
+    return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+class TileID
+{
+public:
+    TileID(int level,int x,int y) : level(level), x(x), y(y) { }
+    int level,x,y;
+};
+
+// Contents we can check a tile against later.  Different versions of the same tile differ.
+void MakeTile(const TileID &tile,int version,size_t size,std::vector<unsigned char> &data)
+{
+    data.resize(size);
+    unsigned int val = tile.level * 7919 + tile.x * 104729 + tile.y * 1299709 + version * 15485863;
+    for (size_t ii=0;ii<size;ii++)
+    {
+        val = val * 1664525 + 1013904223;
+        data[ii] = val >> 24;
+    }
+}
+
+bool CheckTile(PackedTileCache &cache,const TileID &tile,int version,size_t size)
+{
+    std::vector<unsigned char> data,expected;
+    if (!cache.read(tile.level,tile.x,tile.y,data))
+    {
+        fprintf(stderr,"Tile %d: (%d,%d) is missing\n",tile.level,tile.x,tile.y);
+        return false;
+    }
+    MakeTile(tile,version,size,expected);
+    if (data != expected)
+    {
+        fprintf(stderr,"Tile %d: (%d,%d) came back wrong\n",tile.level,tile.x,tile.y);
+        return false;
+    }
+    return true;
+}
+
+// A pyramid's worth of tiles, a few levels deep, in random order
+void MakeTiles(int numTiles,std::mt19937 &rng,std::vector<TileID> &tiles)
+{
+    tiles.clear();
+    for (int level=0;(int)tiles.size() < numTiles;level++)
+        for (int y=0;y<(1<<level) && (int)tiles.size() < numTiles;y++)
+            for (int x=0;x<(1<<level) && (int)tiles.size() < numTiles;x++)
+                tiles.push_back(TileID(level,x,y));
+    std::shuffle(tiles.begin(),tiles.end(),rng);
+}
+
+size_t TileSize(const TileID &tile,size_t avgSize)
+{
+    return avgSize/2 + (tile.x * 31 + tile.y * 17 + tile.level) % avgSize;
+}
+
+void RemoveDir(const std::string &dir)
+{
+    DIR *dirP = opendir(dir.c_str());
+    if (!dirP)
+        return;
+    struct dirent *dirEnt;
+    while ((dirEnt = readdir(dirP)))
+        if (strcmp(dirEnt->d_name,".") && strcmp(dirEnt->d_name,".."))
+            unlink((dir + "/" + dirEnt->d_name).c_str());
+    closedir(dirP);
+    rmdir(dir.c_str());
+}
+
+int CountFiles(const std::string &dir)
+{
+    int count = 0;
+    DIR *dirP = opendir(dir.c_str());
+    if (!dirP)
+        return 0;
+    struct dirent *dirEnt;
+    while ((dirEnt = readdir(dirP)))
+        if (strcmp(dirEnt->d_name,".") && strcmp(dirEnt->d_name,".."))
+            count++;
+    closedir(dirP);
+    return count;
+}
+
+#define CHECK(cond) if (!(cond)) { fprintf(stderr,"Failed: %s (line %d)\n",#cond,__LINE__); return false; }
+
+// Read back what we wrote, replace and remove some, and make sure it all survives closing
+bool TestBasics(const std::string &dir,const std::vector<TileID> &tiles,size_t avgSize)
+{
+    RemoveDir(dir);
+    {
+        PackedTileCache cache;
+        CHECK(cache.open(dir,1024*1024*1024,1024*1024));
+        std::vector<unsigned char> data;
+        for (const TileID &tile : tiles)
+        {
+            MakeTile(tile,0,TileSize(tile,avgSize),data);
+            CHECK(cache.write(tile.level,tile.x,tile.y,data.data(),data.size()));
+        }
+        CHECK(cache.getNumTiles() == tiles.size());
+        for (const TileID &tile : tiles)
+            CHECK(CheckTile(cache,tile,0,TileSize(tile,avgSize)));
+
+        // Replace the first tenth, remove the second
+        size_t tenth = tiles.size()/10;
+        for (size_t ii=0;ii<tenth;ii++)
+        {
+            MakeTile(tiles[ii],1,TileSize(tiles[ii],avgSize)+5,data);
+            CHECK(cache.write(tiles[ii].level,tiles[ii].x,tiles[ii].y,data.data(),data.size()));
+        }
+        for (size_t ii=tenth;ii<2*tenth;ii++)
+            CHECK(cache.remove(tiles[ii].level,tiles[ii].x,tiles[ii].y));
+        CHECK(!cache.contains(tiles[tenth].level,tiles[tenth].x,tiles[tenth].y));
+        CHECK(!cache.contains(31,0,0));
+        CHECK(cache.getNumTiles() == tiles.size()-tenth);
+    }
+
+    // Clean close, so the index is used as is
+    PackedTileCache cache;
+    CHECK(cache.open(dir,1024*1024*1024,1024*1024));
+    size_t tenth = tiles.size()/10;
+    CHECK(cache.getNumTiles() == tiles.size()-tenth);
+    for (size_t ii=0;ii<tiles.size();ii++)
+    {
+        bool good;
+        if (ii < tenth)
+            good = CheckTile(cache,tiles[ii],1,TileSize(tiles[ii],avgSize)+5);
+        else if (ii < 2*tenth)
+            good = !cache.contains(tiles[ii].level,tiles[ii].x,tiles[ii].y);
+        else
+            good = CheckTile(cache,tiles[ii],0,TileSize(tiles[ii],avgSize));
+        CHECK(good);
+    }
+
+    return true;
+}
+
+// Go down without closing, with half a tile at the end, and make sure the index gets rebuilt
+bool TestRecovery(const std::string &dir,const std::vector<TileID> &tiles,size_t avgSize)
+{
+    RemoveDir(dir);
+    size_t half = tiles.size()/2;
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        PackedTileCache cache;
+        if (!cache.open(dir,1024*1024*1024,1024*1024))
+            _exit(1);
+        std::vector<unsigned char> data;
+        for (size_t ii=0;ii<tiles.size();ii++)
+        {
+            MakeTile(tiles[ii],0,TileSize(tiles[ii],avgSize),data);
+            cache.write(tiles[ii].level,tiles[ii].x,tiles[ii].y,data.data(),data.size());
+        }
+        for (size_t ii=0;ii<half;ii++)
+            cache.remove(tiles[ii].level,tiles[ii].x,tiles[ii].y);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid,&status,0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // Tack some junk on the newest segment
+    std::string lastSeg;
+    DIR *dirP = opendir(dir.c_str());
+    struct dirent *dirEnt;
+    while ((dirEnt = readdir(dirP)))
+        if (strstr(dirEnt->d_name,".tiles") && (lastSeg.empty() || strcmp(dirEnt->d_name,lastSeg.c_str()) > 0))
+            lastSeg = dirEnt->d_name;
+    closedir(dirP);
+    CHECK(!lastSeg.empty());
+    int fd = open((dir + "/" + lastSeg).c_str(),O_WRONLY | O_APPEND);
+    CHECK(fd >= 0);
+    const char junk[] = "WGTR and then some";
+    CHECK(write(fd,junk,sizeof(junk)) == sizeof(junk));
+    close(fd);
+
+    PackedTileCache cache;
+    CHECK(cache.open(dir,1024*1024*1024,1024*1024));
+    CHECK(cache.getNumTiles() == tiles.size()-half);
+    for (size_t ii=0;ii<tiles.size();ii++)
+    {
+        bool good;
+        if (ii < half)
+            good = !cache.contains(tiles[ii].level,tiles[ii].x,tiles[ii].y);
+        else
+            good = CheckTile(cache,tiles[ii],0,TileSize(tiles[ii],avgSize));
+        CHECK(good);
+    }
+
+    return true;
+}
+
+// Tiles get too old
+bool TestExpiration(const std::string &dir)
+{
+    RemoveDir(dir);
+    PackedTileCache cache;
+    CHECK(cache.open(dir,1024*1024*1024));
+    std::vector<unsigned char> data;
+    MakeTile(TileID(3,1,2),0,1000,data);
+    CHECK(cache.write(3,1,2,data.data(),data.size()));
+    usleep(200000);
+    CHECK(cache.contains(3,1,2));
+    CHECK(cache.contains(3,1,2,10.0));
+    CHECK(!cache.contains(3,1,2,0.1));
+    CHECK(cache.read(3,1,2,data,10.0));
+    CHECK(!cache.read(3,1,2,data,0.1));
+
+    return true;
+}
+
+// Fill way past the budget while reading a few tiles over and over.  Those should stick around.
+bool TestEviction(const std::string &dir,size_t avgSize)
+{
+    RemoveDir(dir);
+    size_t maxBytes = 4*1024*1024, segmentSize = 256*1024;
+    PackedTileCache cache;
+    CHECK(cache.open(dir,maxBytes,segmentSize));
+
+    std::vector<TileID> hot;
+    for (int ii=0;ii<20;ii++)
+        hot.push_back(TileID(10,ii,0));
+    std::vector<unsigned char> data;
+    for (const TileID &tile : hot)
+    {
+        MakeTile(tile,0,avgSize,data);
+        CHECK(cache.write(tile.level,tile.x,tile.y,data.data(),data.size()));
+    }
+
+    int numTiles = (int)(8 * maxBytes / avgSize);
+    for (int ii=0;ii<numTiles;ii++)
+    {
+        TileID tile(12,ii%4096,ii/4096);
+        MakeTile(tile,0,avgSize,data);
+        CHECK(cache.write(tile.level,tile.x,tile.y,data.data(),data.size()));
+        CHECK(cache.getNumBytes() <= maxBytes);
+        if (ii % 10 == 0)
+            for (const TileID &hotTile : hot)
+                CHECK(CheckTile(cache,hotTile,0,avgSize));
+    }
+    CHECK(!cache.contains(12,0,0));
+    TileID last(12,(numTiles-1)%4096,(numTiles-1)/4096);
+    CHECK(CheckTile(cache,last,0,avgSize));
+    CHECK(CountFiles(dir) <= (int)(maxBytes / segmentSize) + 2);
+
+    return true;
+}
+
+// The old way: one file per tile, written to the side and renamed like writeToFile:atomically:
+void WriteFile(const std::string &dir,const TileID &tile,const std::vector<unsigned char> &data)
+{
+    char name[256];
+    snprintf(name,sizeof(name),"%s/%d_%d_%d.png",dir.c_str(),tile.level,tile.x,tile.y);
+    std::string tmpName = std::string(name) + ".tmp";
+    int fd = open(tmpName.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+    if (fd < 0)
+        return;
+    if (write(fd,data.data(),data.size()) != (ssize_t)data.size())
+        fprintf(stderr,"Short write on %s\n",tmpName.c_str());
+    close(fd);
+    rename(tmpName.c_str(),name);
+}
+
+bool FileIsLocal(const std::string &dir,const TileID &tile,double maxAge)
+{
+    char name[256];
+    snprintf(name,sizeof(name),"%s/%d_%d_%d.png",dir.c_str(),tile.level,tile.x,tile.y);
+    struct stat statBuf;
+    if (stat(name,&statBuf) != 0)
+        return false;
+    return maxAge <= 0.0 || PackedTileCache::currentTime() - statBuf.st_mtime <= maxAge;
+}
+
+bool ReadFile(const std::string &dir,const TileID &tile,std::vector<unsigned char> &data)
+{
+    char name[256];
+    snprintf(name,sizeof(name),"%s/%d_%d_%d.png",dir.c_str(),tile.level,tile.x,tile.y);
+    int fd = open(name,O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat statBuf;
+    fstat(fd,&statBuf);
+    data.resize(statBuf.st_size);
+    bool ret = read(fd,data.data(),data.size()) == (ssize_t)data.size();
+    close(fd);
+    return ret;
+}
+
+int main(int argc, const char * argv[])
+{
+    int numTiles = 20000;
+    size_t avgSize = 16*1024;
+    std::string baseDir = "/tmp";
+
+    for (int ii=1;ii<argc;ii++)
+    {
+        if (!strcmp(argv[ii],"-tiles") && ii+1 < argc)
+            numTiles = atoi(argv[++ii]);
+        else if (!strcmp(argv[ii],"-size") && ii+1 < argc)
+            avgSize = atoi(argv[++ii]);
+        else if (!strcmp(argv[ii],"-dir") && ii+1 < argc)
+            baseDir = argv[++ii];
+        else {
+            fprintf(stderr,"usage: %s [-tiles n] [-size bytes] [-dir path]\n",argv[0]);
+            return -1;
+        }
+    }
+    if (numTiles < 10 || avgSize < 16)
+    {
+        fprintf(stderr,"Need at least 10 tiles of 16 bytes\n");
+        return -1;
+    }
+    std::string packedDir = baseDir + "/tile_cache_bench_packed";
+    std::string filesDir = baseDir + "/tile_cache_bench_files";
+
+    std::mt19937 rng(1234);
+    std::vector<TileID> tiles;
+
+    // Correctness first, on a smaller set
+    MakeTiles(std::min(numTiles,5000),rng,tiles);
+    bool ok = TestBasics(packedDir,tiles,1024) && TestRecovery(packedDir,tiles,1024) &&
+              TestExpiration(packedDir) && TestEviction(packedDir,8*1024);
+    if (!ok)
+    {
+        fprintf(stderr,"Checks failed\n");
+        return -1;
+    }
+    printf("Checks passed\n");
+
+    // Now the timing
+    MakeTiles(numTiles,rng,tiles);
+    std::vector<TileID> readOrder = tiles;
+    std::shuffle(readOrder.begin(),readOrder.end(),rng);
+    std::vector<unsigned char> data;
+    RemoveDir(packedDir);
+    RemoveDir(filesDir);
+    mkdir(filesDir.c_str(),0755);
+
+    printf("%d tiles, %d bytes on average\n",numTiles,(int)avgSize);
+    printf("%-24s %12s %12s\n","","packed","file per tile");
+
+    Clock::time_point startTime = Clock::now();
+    PackedTileCache cache;
+    if (!cache.open(packedDir,(size_t)4*1024*1024*1024))
+        return -1;
+    for (const TileID &tile : tiles)
+    {
+        MakeTile(tile,0,TileSize(tile,avgSize),data);
+        cache.write(tile.level,tile.x,tile.y,data.data(),data.size());
+    }
+    cache.flush();
+    double packedWrite = SecondsSince(startTime);
+    startTime = Clock::now();
+    for (const TileID &tile : tiles)
+    {
+        MakeTile(tile,0,TileSize(tile,avgSize),data);
+        WriteFile(filesDir,tile,data);
+    }
+    double filesWrite = SecondsSince(startTime);
+    printf("%-24s %12.0f %12.0f tiles/s\n","write",numTiles/packedWrite,numTiles/filesWrite);
+
+    int found = 0;
+    startTime = Clock::now();
+    for (const TileID &tile : readOrder)
+        found += cache.contains(tile.level,tile.x,tile.y,3600.0);
+    double packedLocal = SecondsSince(startTime);
+    startTime = Clock::now();
+    for (const TileID &tile : readOrder)
+        found += FileIsLocal(filesDir,tile,3600.0);
+    double filesLocal = SecondsSince(startTime);
+    printf("%-24s %12.0f %12.0f tiles/s\n","is local",numTiles/packedLocal,numTiles/filesLocal);
+
+    size_t readBytes = 0;
+    startTime = Clock::now();
+    for (const TileID &tile : readOrder)
+        if (cache.read(tile.level,tile.x,tile.y,data,3600.0))
+            readBytes += data.size();
+    double packedRead = SecondsSince(startTime);
+    startTime = Clock::now();
+    for (const TileID &tile : readOrder)
+        if (ReadFile(filesDir,tile,data))
+            readBytes += data.size();
+    double filesRead = SecondsSince(startTime);
+    printf("%-24s %12.0f %12.0f tiles/s\n","read",numTiles/packedRead,numTiles/filesRead);
+
+    // Missing tiles are the common case when a cache is new
+    startTime = Clock::now();
+    for (const TileID &tile : readOrder)
+        found += cache.contains(tile.level+10,tile.x,tile.y);
+    double packedMiss = SecondsSince(startTime);
+    startTime = Clock::now();
+    for (const TileID &tile : readOrder)
+        found += FileIsLocal(filesDir,TileID(tile.level+10,tile.x,tile.y),0.0);
+    double filesMiss = SecondsSince(startTime);
+    printf("%-24s %12.0f %12.0f tiles/s\n","miss",numTiles/packedMiss,numTiles/filesMiss);
+
+    printf("%-24s %12d %12d\n","files",CountFiles(packedDir),CountFiles(filesDir));
+    if (found != 2*numTiles || readBytes == 0)
+        fprintf(stderr,"Expected to find %d tiles, found %d\n",2*numTiles,found);
+
+    cache.close();
+    RemoveDir(packedDir);
+    RemoveDir(filesDir);
+
+    return 0;
+}